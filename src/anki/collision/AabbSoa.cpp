@@ -0,0 +1,100 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/collision/AabbSoa.h>
+
+namespace anki
+{
+
+U32 cullAabbSoa(ConstWeakArray<Plane> planes, const AabbSoaView& aabbs, WeakArray<U32> visibleIndices)
+{
+	ANKI_ASSERT(visibleIndices.getSize() >= aabbs.m_count);
+	U32 visibleCount = 0;
+
+	// For every plane pick the corner of the AABB that is furthest along the normal (the positive vertex). If that is
+	// behind the plane the whole AABB is. The choice depends on the plane only so do it once per plane and batch
+	class PlaneInfo
+	{
+	public:
+		const F32* m_x;
+		const F32* m_y;
+		const F32* m_z;
+		F32 m_nx, m_ny, m_nz, m_offset;
+	};
+
+	Array<PlaneInfo, 8> planeInfos;
+	ANKI_ASSERT(planes.getSize() <= planeInfos.getSize());
+	for(U32 p = 0; p < planes.getSize(); ++p)
+	{
+		const Vec4& n = planes[p].getNormal();
+		PlaneInfo& info = planeInfos[p];
+		info.m_x = (n.x() >= 0.0f) ? aabbs.m_maxX : aabbs.m_minX;
+		info.m_y = (n.y() >= 0.0f) ? aabbs.m_maxY : aabbs.m_minY;
+		info.m_z = (n.z() >= 0.0f) ? aabbs.m_maxZ : aabbs.m_minZ;
+		info.m_nx = n.x();
+		info.m_ny = n.y();
+		info.m_nz = n.z();
+		info.m_offset = planes[p].getOffset();
+	}
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+	ANKI_ASSERT(isAligned(16, aabbs.m_minX) && isAligned(16, aabbs.m_minY) && isAligned(16, aabbs.m_minZ));
+	ANKI_ASSERT(isAligned(16, aabbs.m_maxX) && isAligned(16, aabbs.m_maxY) && isAligned(16, aabbs.m_maxZ));
+
+	for(U32 i = 0; i < aabbs.m_count; i += 4)
+	{
+		// All lanes start visible and every plane can kill some
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for(U32 p = 0; p < planes.getSize(); ++p)
+		{
+			const PlaneInfo& info = planeInfos[p];
+
+			__m128 dist = _mm_mul_ps(_mm_load_ps(info.m_x + i), _mm_set1_ps(info.m_nx));
+			dist = _mm_add_ps(dist, _mm_mul_ps(_mm_load_ps(info.m_y + i), _mm_set1_ps(info.m_ny)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(_mm_load_ps(info.m_z + i), _mm_set1_ps(info.m_nz)));
+			dist = _mm_sub_ps(dist, _mm_set1_ps(info.m_offset));
+
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(dist, _mm_setzero_ps()));
+		}
+
+		// Mask out the padding
+		U32 mask = _mm_movemask_ps(visible);
+		const U32 remaining = aabbs.m_count - i;
+		if(remaining < 4)
+		{
+			mask &= (1u << remaining) - 1u;
+		}
+
+		// Compact
+		while(mask)
+		{
+			const U32 lane = getLsb(mask);
+			mask &= mask - 1u;
+			visibleIndices[visibleCount++] = i + lane;
+		}
+	}
+#else
+	for(U32 i = 0; i < aabbs.m_count; ++i)
+	{
+		Bool visible = true;
+		for(U32 p = 0; p < planes.getSize() && visible; ++p)
+		{
+			const PlaneInfo& info = planeInfos[p];
+			const F32 dist = info.m_x[i] * info.m_nx + info.m_y[i] * info.m_ny + info.m_z[i] * info.m_nz - info.m_offset;
+			visible = dist >= 0.0f;
+		}
+
+		if(visible)
+		{
+			visibleIndices[visibleCount++] = i;
+		}
+	}
+#endif
+
+	return visibleCount;
+}
+
+} // end namespace anki
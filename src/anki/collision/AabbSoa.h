@@ -0,0 +1,93 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/collision/Aabb.h>
+#include <anki/collision/Plane.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+/// @addtogroup collision
+/// @{
+
+/// A view of a number of AABBs stored as a structure of arrays. Every stream should be 16 bytes aligned and padded to
+/// a multiple of 4 elements so it can be read in SIMD batches. The padding elements can be garbage.
+class AabbSoaView
+{
+public:
+	const F32* m_minX = nullptr;
+	const F32* m_minY = nullptr;
+	const F32* m_minZ = nullptr;
+	const F32* m_maxX = nullptr;
+	const F32* m_maxY = nullptr;
+	const F32* m_maxZ = nullptr;
+	U32 m_count = 0;
+};
+
+/// Fixed capacity storage of AABBs as a structure of arrays.
+template<U32 CAPACITY>
+class AabbSoaArray
+{
+public:
+	static constexpr U32 PADDED_CAPACITY = (CAPACITY + 3u) & ~3u;
+
+	void pushBack(const Aabb& aabb)
+	{
+		ANKI_ASSERT(m_count < CAPACITY);
+		m_minX[m_count] = aabb.getMin().x();
+		m_minY[m_count] = aabb.getMin().y();
+		m_minZ[m_count] = aabb.getMin().z();
+		m_maxX[m_count] = aabb.getMax().x();
+		m_maxY[m_count] = aabb.getMax().y();
+		m_maxZ[m_count] = aabb.getMax().z();
+		++m_count;
+	}
+
+	void clear()
+	{
+		m_count = 0;
+	}
+
+	U32 getSize() const
+	{
+		return m_count;
+	}
+
+	AabbSoaView getView() const
+	{
+		AabbSoaView view;
+		view.m_minX = &m_minX[0];
+		view.m_minY = &m_minY[0];
+		view.m_minZ = &m_minZ[0];
+		view.m_maxX = &m_maxX[0];
+		view.m_maxY = &m_maxY[0];
+		view.m_maxZ = &m_maxZ[0];
+		view.m_count = m_count;
+		return view;
+	}
+
+private:
+	alignas(16) Array<F32, PADDED_CAPACITY> m_minX;
+	alignas(16) Array<F32, PADDED_CAPACITY> m_minY;
+	alignas(16) Array<F32, PADDED_CAPACITY> m_minZ;
+	alignas(16) Array<F32, PADDED_CAPACITY> m_maxX;
+	alignas(16) Array<F32, PADDED_CAPACITY> m_maxY;
+	alignas(16) Array<F32, PADDED_CAPACITY> m_maxZ;
+	U32 m_count = 0;
+};
+
+/// Test a batch of AABBs against a number of planes. An AABB is visible if it's not totally behind any of the planes.
+/// It's the same test as testPlane(const Plane&, const Aabb&) but it processes 4 AABBs at once.
+/// @param planes The planes. Usually the 6 planes of a frustum.
+/// @param aabbs The AABBs to test.
+/// @param visibleIndices The indices of the visible AABBs. It should be at least aabbs.m_count long.
+/// @return The number of visible AABBs.
+U32 cullAabbSoa(ConstWeakArray<Plane> planes, const AabbSoaView& aabbs, WeakArray<U32> visibleIndices);
+/// @}
+
+} // end namespace anki
@@ -11,6 +11,7 @@
 #include <anki/util/System.h>
 #include <anki/util/ThreadHive.h>
 #include <anki/core/Trace.h>
+#include <anki/core/FramePipeline.h>
 
 #include <anki/core/NativeWindow.h>
 #include <anki/input/Input.h>
@@ -22,6 +23,8 @@
 #include <anki/script/ScriptManager.h>
 #include <anki/resource/ResourceFilesystem.h>
 #include <anki/resource/AsyncLoader.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/UnifiedGeometryMemoryPool.h>
 #include <anki/core/StagingGpuMemoryManager.h>
 #include <anki/ui/UiManager.h>
 #include <anki/ui/Canvas.h>
@@ -79,12 +82,15 @@ public:
 	PtrSize m_allocatedCpuMem = 0;
 	U64 m_allocCount = 0;
 	U64 m_freeCount = 0;
+	U64 m_threadCacheHitCount = 0;
+	U64 m_threadCacheMissCount = 0;
 
 	U64 m_vkCpuMem = 0;
 	U64 m_vkGpuMem = 0;
 	U32 m_vkCmdbCount = 0;
 
 	U32 m_drawableCount = 0;
+	U32 m_culledTriangleCount = 0;
 
 	static const U32 BUFFERED_FRAMES = 16;
 	U32 m_bufferedFrames = 0;
@@ -129,6 +135,8 @@ public:
 			labelBytes(m_allocatedCpuMem, "Total CPU");
 			labelUint(m_allocCount, "Total allocations");
 			labelUint(m_freeCount, "Total frees");
+			labelUint(m_threadCacheHitCount, "Thread cache hits");
+			labelUint(m_threadCacheMissCount, "Thread cache misses");
 			labelBytes(m_vkCpuMem, "Vulkan CPU");
 			labelBytes(m_vkGpuMem, "Vulkan GPU");
 
@@ -139,6 +147,7 @@ public:
 			ImGui::Text("----");
 			ImGui::Text("Other:");
 			labelUint(m_drawableCount, "Drawbles");
+			labelUint(m_culledTriangleCount, "Culled triangles");
 		}
 
 		ImGui::End();
@@ -251,6 +260,26 @@ void* App::MemStats::allocCallback(void* userData, void* ptr, PtrSize size, PtrS
 	return out;
 }
 
+void App::MemStats::gatherThreadCacheStats(SceneGraph& scene, ResourceManager& resources)
+{
+	// The pools that have a thread cache
+	const Array<const BaseMemoryPool*, 2> pools = {
+		{&scene.getAllocator().getMemoryPool(), &resources.getAllocator().getMemoryPool()}};
+
+	m_threadCacheStats = ThreadCacheStats();
+	for(const BaseMemoryPool* pool : pools)
+	{
+		const ThreadCacheStats stats = pool->getThreadCacheStats();
+		m_threadCacheStats.m_allocationCount += stats.m_allocationCount;
+		m_threadCacheStats.m_freeCount += stats.m_freeCount;
+		m_threadCacheStats.m_hitCount += stats.m_hitCount;
+		m_threadCacheStats.m_missCount += stats.m_missCount;
+		m_threadCacheStats.m_largeAllocationCount += stats.m_largeAllocationCount;
+		m_threadCacheStats.m_cachedMemory += stats.m_cachedMemory;
+		m_threadCacheStats.m_threadCount = max(m_threadCacheStats.m_threadCount, stats.m_threadCount);
+	}
+}
+
 App::App()
 {
 }
@@ -263,6 +292,8 @@ App::~App()
 void App::cleanup()
 {
 	m_heapAlloc.deleteInstance(m_scene);
+	m_heapAlloc.deleteInstance(m_sceneThreadHive);
+	m_heapAlloc.deleteInstance(m_framePipeline);
 	m_heapAlloc.deleteInstance(m_script);
 	m_heapAlloc.deleteInstance(m_renderer);
 	m_statsUi.reset(nullptr);
@@ -279,12 +310,22 @@ void App::cleanup()
 #if ANKI_ENABLE_TRACE
 	if(CoreTracerSingleton::get().isInitialized())
 	{
-		StringAuto fname(m_heapAlloc);
-		fname.sprintf("%s/trace", m_settingsDir.cstr());
-		ANKI_CORE_LOGI("Will dump trace files: %s", fname.cstr());
-		if(CoreTracerSingleton::get().flush(fname.toCString()))
+		if(CoreTracerSingleton::get().isStreaming())
 		{
-			ANKI_CORE_LOGE("Ignoring error from the tracer");
+			if(CoreTracerSingleton::get().endStreaming())
+			{
+				ANKI_CORE_LOGE("Ignoring error from the tracer");
+			}
+		}
+		else
+		{
+			StringAuto fname(m_heapAlloc);
+			fname.sprintf("%s/trace", m_settingsDir.cstr());
+			ANKI_CORE_LOGI("Will dump trace files: %s", fname.cstr());
+			if(CoreTracerSingleton::get().flush(fname.toCString()))
+			{
+				ANKI_CORE_LOGE("Ignoring error from the tracer");
+			}
 		}
 		CoreTracerSingleton::destroy();
 	}
@@ -321,6 +362,17 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 
 	ANKI_CHECK(initDirs(config));
 
+#if ANKI_ENABLE_TRACE
+	if(config.getNumber("core.traceStreaming"))
+	{
+		StringAuto fname(m_heapAlloc);
+		fname.sprintf("%s/trace", m_settingsDir.cstr());
+		ANKI_CORE_LOGI("Will stream trace file: %s.trace.bin", fname.cstr());
+		ANKI_CHECK(CoreTracerSingleton::get().beginStreaming(
+			fname.toCString(), U32(config.getNumber("core.traceStreamingChunks"))));
+	}
+#endif
+
 	// Print a message
 	const char* buildType =
 #if ANKI_OPTIMIZE
@@ -387,7 +439,17 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 	//
 	// ThreadPool
 	//
-	m_threadHive = m_heapAlloc.newInstance<ThreadHive>(config.getNumber("core.mainThreadCount"), m_heapAlloc, true);
+	m_threadHive = m_heapAlloc.newInstance<ThreadHive>(
+		config.getNumber("core.mainThreadCount"), m_heapAlloc, true, config.getNumber("core.workStealing"));
+
+#if ANKI_ENABLE_TRACE
+	ThreadHiveTraceCallbacks hiveTraceCallbacks;
+	hiveTraceCallbacks.m_beginEvent = [](void*) { return CoreTracerSingleton::get().beginEvent(); };
+	hiveTraceCallbacks.m_endEvent = [](void*, const char* eventName, TracerEventHandle event) {
+		CoreTracerSingleton::get().endEvent(eventName, event);
+	};
+	m_threadHive->setTraceCallbacks(hiveTraceCallbacks);
+#endif
 
 	//
 	// Graphics API
@@ -468,8 +530,28 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 	//
 	m_scene = m_heapAlloc.newInstance<SceneGraph>();
 
-	ANKI_CHECK(m_scene->init(
-		m_allocCb, m_allocCbData, m_threadHive, m_resources, m_input, m_script, &m_globalTimestamp, config));
+	const Bool pipelined = config.getNumber("core.pipelinedFrames");
+	if(pipelined)
+	{
+		// The renderer and the scene will run at the same time and they both wait on their hives
+		m_sceneThreadHive =
+			m_heapAlloc.newInstance<ThreadHive>(config.getNumber("core.mainThreadCount"), m_heapAlloc, false);
+#if ANKI_ENABLE_TRACE
+		m_sceneThreadHive->setTraceCallbacks(hiveTraceCallbacks);
+#endif
+	}
+
+	ANKI_CHECK(m_scene->init(m_allocCb,
+		m_allocCbData,
+		(pipelined) ? m_sceneThreadHive : m_threadHive,
+		m_resources,
+		m_input,
+		m_script,
+		&m_globalTimestamp,
+		config));
+	m_scene->setPipelinedFrames(pipelined);
+
+	m_framePipeline = m_heapAlloc.newInstance<FramePipeline>(m_heapAlloc, pipelined);
 
 	// Inform the script engine about some subsystems
 	m_script->setRenderer(m_renderer);
@@ -540,13 +622,76 @@ Error App::initDirs(const ConfigSet& cfg)
 	return Error::NONE;
 }
 
+/// The state of App::mainLoop() that the frame callbacks need.
+class App::MainLoopCtx
+{
+public:
+	App* m_app = nullptr;
+	Second m_prevUpdateTime = 0.0;
+	Second m_crntTime = 0.0;
+	Array<RenderQueue, FramePipeline::FRAME_SLOT_COUNT> m_renderQueues;
+	U32 m_drawableCount = 0;
+};
+
+Error App::simulateFrame(void* userData, U32 frameSlot)
+{
+	MainLoopCtx& ctx = *static_cast<MainLoopCtx*>(userData);
+	SceneGraph& scene = *ctx.m_app->m_scene;
+
+	ANKI_CHECK(scene.update(ctx.m_prevUpdateTime, ctx.m_crntTime));
+
+	RenderQueue& rqueue = ctx.m_renderQueues[frameSlot];
+	rqueue = RenderQueue();
+	scene.doVisibilityTests(rqueue);
+
+	return Error::NONE;
+}
+
+Error App::renderFrame(void* userData, U32 frameSlot)
+{
+	MainLoopCtx& ctx = *static_cast<MainLoopCtx*>(userData);
+	App& app = *ctx.m_app;
+	RenderQueue& rqueue = ctx.m_renderQueues[frameSlot];
+
+	// Inject stats UI
+	DynamicArrayAuto<UiQueueElement> newUiElementArr(app.m_heapAlloc);
+	app.injectStatsUiElement(newUiElementArr, rqueue);
+
+	// Render
+	TexturePtr presentableTex = app.m_gr->acquireNextPresentableTexture();
+	ANKI_CHECK(app.m_renderer->render(rqueue, presentableTex));
+
+	// Pause and sync async loader. That will force all tasks before the pause to finish in this frame.
+	app.m_resources->getAsyncLoader().pause();
+
+	app.m_gr->swapBuffers();
+	app.m_stagingMem->endFrame();
+
+	// Update the trace info with some async loader stats
+	U64 asyncTaskCount = app.m_resources->getAsyncLoader().getCompletedTaskCount();
+	ANKI_TRACE_INC_COUNTER(RESOURCE_ASYNC_TASKS, asyncTaskCount - app.m_resourceCompletedAsyncTaskCount);
+	app.m_resourceCompletedAsyncTaskCount = asyncTaskCount;
+
+	// Now resume the loader
+	app.m_resources->getAsyncLoader().resume();
+
+	if(app.m_displayStats)
+	{
+		ctx.m_drawableCount = rqueue.countAllRenderables();
+	}
+
+	return Error::NONE;
+}
+
 Error App::mainLoop()
 {
 	ANKI_CORE_LOGI("Entering main loop");
 	Bool quit = false;
 
-	Second prevUpdateTime = HighRezTimer::getCurrentTime();
-	Second crntTime = prevUpdateTime;
+	MainLoopCtx ctx;
+	ctx.m_app = this;
+	ctx.m_prevUpdateTime = HighRezTimer::getCurrentTime();
+	ctx.m_crntTime = ctx.m_prevUpdateTime;
 
 	while(!quit)
 	{
@@ -557,8 +702,8 @@ Error App::mainLoop()
 		ANKI_TRACE_START_EVENT(FRAME);
 		const Second startTime = HighRezTimer::getCurrentTime();
 
-		prevUpdateTime = crntTime;
-		crntTime = HighRezTimer::getCurrentTime();
+		ctx.m_prevUpdateTime = ctx.m_crntTime;
+		ctx.m_crntTime = HighRezTimer::getCurrentTime();
 
 		// Update
 		ANKI_CHECK(m_input->handleEvents());
@@ -566,32 +711,18 @@ Error App::mainLoop()
 		// User update
 		ANKI_CHECK(userMainLoop(quit));
 
-		ANKI_CHECK(m_scene->update(prevUpdateTime, crntTime));
-
-		RenderQueue rqueue;
-		m_scene->doVisibilityTests(rqueue);
-
-		// Inject stats UI
-		DynamicArrayAuto<UiQueueElement> newUiElementArr(m_heapAlloc);
-		injectStatsUiElement(newUiElementArr, rqueue);
-
-		// Render
-		TexturePtr presentableTex = m_gr->acquireNextPresentableTexture();
-		ANKI_CHECK(m_renderer->render(rqueue, presentableTex));
+		// Update the scene and render. If pipelined the previous frame is rendered while this one is updated
+		ANKI_CHECK(m_framePipeline->runFrame(simulateFrame, renderFrame, &ctx));
 
-		// Pause and sync async loader. That will force all tasks before the pause to finish in this frame.
-		m_resources->getAsyncLoader().pause();
-
-		m_gr->swapBuffers();
-		m_stagingMem->endFrame();
-
-		// Update the trace info with some async loader stats
-		U64 asyncTaskCount = m_resources->getAsyncLoader().getCompletedTaskCount();
-		ANKI_TRACE_INC_COUNTER(RESOURCE_ASYNC_TASKS, asyncTaskCount - m_resourceCompletedAsyncTaskCount);
-		m_resourceCompletedAsyncTaskCount = asyncTaskCount;
+		if(m_framePipeline->isPipelined())
+		{
+			// Nothing renders and the new RenderQueue doesn't reference nodes marked for deletion
+			m_scene->deleteNodesMarkedForDeletion();
+		}
 
-		// Now resume the loader
-		m_resources->getAsyncLoader().resume();
+		// Nothing renders so the streamed textures can change and the meshes can move
+		m_resources->getTextureStreamer().update();
+		m_resources->getUnifiedGeometryMemoryPool().update();
 
 		ANKI_TRACE_STOP_EVENT(FRAME);
 
@@ -614,16 +745,20 @@ Error App::mainLoop()
 			statsUi.m_sceneUpdateTime.set(m_scene->getStats().m_updateTime);
 			statsUi.m_visTestsTime.set(m_scene->getStats().m_visibilityTestsTime);
 			statsUi.m_physicsTime.set(m_scene->getStats().m_physicsUpdate);
+			statsUi.m_culledTriangleCount = m_scene->getStats().m_culledTriangleCount;
 			statsUi.m_allocatedCpuMem = m_memStats.m_allocatedMem.load();
 			statsUi.m_allocCount = m_memStats.m_allocCount.load();
 			statsUi.m_freeCount = m_memStats.m_freeCount.load();
+			m_memStats.gatherThreadCacheStats(*m_scene, *m_resources);
+			statsUi.m_threadCacheHitCount = m_memStats.m_threadCacheStats.m_hitCount;
+			statsUi.m_threadCacheMissCount = m_memStats.m_threadCacheStats.m_missCount;
 
 			GrManagerStats grStats = m_gr->getStats();
 			statsUi.m_vkCpuMem = grStats.m_cpuMemory;
 			statsUi.m_vkGpuMem = grStats.m_gpuMemory;
 			statsUi.m_vkCmdbCount = grStats.m_commandBufferCount;
 
-			statsUi.m_drawableCount = rqueue.countAllRenderables();
+			statsUi.m_drawableCount = ctx.m_drawableCount;
 		}
 
 		++m_globalTimestamp;
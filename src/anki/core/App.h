@@ -37,6 +37,7 @@ class StagingGpuMemoryManager;
 class UiManager;
 class UiQueueElement;
 class RenderQueue;
+class FramePipeline;
 
 /// The core class of the engine.
 class App
@@ -149,6 +150,7 @@ public:
 
 private:
 	class StatsUi;
+	class MainLoopCtx;
 
 	// Allocation
 	AllocAlignedCallback m_allocCb;
@@ -173,6 +175,8 @@ private:
 	Bool m_displayStats = false;
 	Timestamp m_globalTimestamp = 1;
 	ThreadHive* m_threadHive = nullptr;
+	ThreadHive* m_sceneThreadHive = nullptr; ///< The scene gets its own hive if the frames are pipelined.
+	FramePipeline* m_framePipeline = nullptr;
 	String m_settingsDir; ///< The path that holds the configuration
 	String m_cacheDir; ///< This is used as a cache
 	Second m_timerTick;
@@ -188,7 +192,12 @@ private:
 		void* m_originalUserData = nullptr;
 		AllocAlignedCallback m_originalAllocCallback = nullptr;
 
+		/// The sum of the per-thread stats of the pools that have a thread cache. It's updated once per frame.
+		ThreadCacheStats m_threadCacheStats;
+
 		static void* allocCallback(void* userData, void* ptr, PtrSize size, PtrSize alignment);
+
+		void gatherThreadCacheStats(SceneGraph& scene, ResourceManager& resources);
 	} m_memStats;
 
 	void initMemoryCallbacks(AllocAlignedCallback allocCb, void* allocCbUserData);
@@ -198,6 +207,12 @@ private:
 	ANKI_USE_RESULT Error initDirs(const ConfigSet& cfg);
 	void cleanup();
 
+	/// Update the scene and build the RenderQueue of a frame.
+	static ANKI_USE_RESULT Error simulateFrame(void* userData, U32 frameSlot);
+
+	/// Render the RenderQueue of a frame and present.
+	static ANKI_USE_RESULT Error renderFrame(void* userData, U32 frameSlot);
+
 	/// Inject a new UI element in the render queue for displaying stats.
 	void injectStatsUiElement(DynamicArrayAuto<UiQueueElement>& elements, RenderQueue& rqueue);
 };
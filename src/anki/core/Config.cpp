@@ -58,6 +58,8 @@ Config::Config()
 	newOption("scene.earlyZDistance", 10.0, "Objects with distance lower than that will be used in early Z");
 	newOption("scene.reflectionProbeEffectiveDistance", 256.0, "How far reflection probes can look");
 	newOption("scene.reflectionProbeShadowEffectiveDistance", 32.0, "How far to render shadows for reflection probes");
+	newOption("scene.bvh", false, "Use a BVH instead of an octree for the spatial queries");
+	newOption("scene.bvhFatMargin", 0.1, "How much the BVH leafs are enlarged so small movements don't touch the tree");
 
 	// Globals
 	newOption("width", 1280);
@@ -67,6 +69,16 @@ Config::Config()
 	newOption("rsrc.maxTextureSize", 1024 * 1024);
 	newOption("rsrc.dataPaths", ".", "The engine loads assets only in from these paths. Separate them with :");
 	newOption("rsrc.transferScratchMemorySize", 256_MB);
+	newOption("rsrc.asyncLoaderThreadCount", max(1u, getCpuCoresCount() / 4u), "Worker threads of the async loader");
+	newOption("rsrc.textureStreamingBudget", 512_MB, "GPU memory for the streamed textures. Zero disables streaming");
+	newOption("rsrc.textureMipTailSize", 128, "The texture mips that are that big or smaller are always resident");
+	newOption("rsrc.unifiedGeometryMemorySize",
+		128_MB,
+		"The buffer that keeps the vertices and indices of all meshes. Zero gives every mesh its own buffers");
+	newOption("rsrc.unifiedGeometryDefragmentSize", 4_MB, "The geometry memory that can move per frame to defragment");
+	newOption("rsrc.archiveDecompressionThreadCount",
+		max(1u, getCpuCoresCount() / 4u),
+		"Threads that decompress the archived files ahead of the reads");
 
 	// Window
 	newOption("window.fullscreen", false);
@@ -87,7 +99,14 @@ Config::Config()
 	newOption("core.vertexPerFrameMemorySize", 10_MB);
 	newOption("core.textureBufferPerFrameMemorySize", 1_MB);
 	newOption("core.mainThreadCount", max(2u, getCpuCoresCount() / 2u - 1u));
+	newOption("core.workStealing", false, "Use the work-stealing scheduler for the main threads");
+	newOption("core.pipelinedFrames",
+		false,
+		"Update the scene of the next frame while the current one renders. Draw callbacks might see the next frame's "
+		"node state");
 	newOption("core.displayStats", false);
+	newOption("core.traceStreaming", false, "Stream the trace to disk while running instead of dumping it at exit");
+	newOption("core.traceStreamingChunks", 256, "Number of trace chunks that will be preallocated when streaming");
 	newOption("core.clearCaches", false);
 }
 
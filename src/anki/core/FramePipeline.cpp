@@ -0,0 +1,82 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/core/FramePipeline.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+class FramePipeline::SimulateTask : public ThreadPoolTask
+{
+public:
+	Callback m_callback;
+	void* m_userData;
+	U32 m_frameSlot;
+
+	Error operator()(U32 taskId, PtrSize threadsCount)
+	{
+		ANKI_TRACE_SCOPED_EVENT(FRAME_PIPELINE_SIMULATE);
+		return m_callback(m_userData, m_frameSlot);
+	}
+};
+
+FramePipeline::FramePipeline(GenericMemoryPoolAllocator<U8> alloc, Bool pipelined)
+	: m_alloc(alloc)
+{
+	if(pipelined)
+	{
+		m_thread = m_alloc.newInstance<ThreadPool>(1);
+	}
+}
+
+FramePipeline::~FramePipeline()
+{
+	if(m_thread)
+	{
+		m_alloc.deleteInstance(m_thread);
+	}
+}
+
+Error FramePipeline::runFrame(Callback simulate, Callback render, void* userData)
+{
+	ANKI_ASSERT(simulate && render);
+	const U32 frameSlot = m_frame % FRAME_SLOT_COUNT;
+
+	Error err = Error::NONE;
+	if(!m_thread)
+	{
+		err = simulate(userData, frameSlot);
+		if(!err)
+		{
+			err = render(userData, frameSlot);
+		}
+	}
+	else
+	{
+		SimulateTask task;
+		task.m_callback = simulate;
+		task.m_userData = userData;
+		task.m_frameSlot = frameSlot;
+		m_thread->assignNewTask(0, &task);
+
+		// Render the previous frame while the new one is simulated
+		if(m_frame > 0)
+		{
+			err = render(userData, (m_frame - 1) % FRAME_SLOT_COUNT);
+		}
+
+		const Error simErr = m_thread->waitForAllThreadsToFinish();
+		if(!err)
+		{
+			err = simErr;
+		}
+	}
+
+	++m_frame;
+	return err;
+}
+
+} // end namespace anki
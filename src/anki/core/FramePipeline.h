@@ -0,0 +1,60 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/core/Common.h>
+#include <anki/util/ThreadPool.h>
+#include <anki/util/Allocator.h>
+
+namespace anki
+{
+
+/// @addtogroup core
+/// @{
+
+/// Drives the two halves of a frame: the simulation (scene update and visibility tests that build a RenderQueue) and
+/// the rendering of that RenderQueue. In serial mode both run back to back in the caller's thread. In pipelined mode
+/// the simulation of frame N+1 runs in a separate thread while the caller renders frame N. Everything that is produced
+/// by the simulation and consumed by the rendering should be allocated per frame slot (see FRAME_SLOT_COUNT).
+class FramePipeline : public NonCopyable
+{
+public:
+	static constexpr U32 FRAME_SLOT_COUNT = 2;
+
+	/// Callback for both halves of the frame.
+	/// @param userData The user data passed to runFrame().
+	/// @param frameSlot The slot of the frame's resources. It's less than FRAME_SLOT_COUNT.
+	using Callback = Error (*)(void* userData, U32 frameSlot);
+
+	FramePipeline(GenericMemoryPoolAllocator<U8> alloc, Bool pipelined);
+
+	~FramePipeline();
+
+	Bool isPipelined() const
+	{
+		return m_thread != nullptr;
+	}
+
+	/// Run the simulation of a new frame and the rendering of the current (serial) or the previous frame (pipelined).
+	/// When it returns both callbacks have finished so the caller is free to touch the scene.
+	ANKI_USE_RESULT Error runFrame(Callback simulate, Callback render, void* userData);
+
+	/// The number of frames that have been simulated so far.
+	U64 getSimulatedFrameCount() const
+	{
+		return m_frame;
+	}
+
+private:
+	class SimulateTask;
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	ThreadPool* m_thread = nullptr; ///< A single thread that runs the simulation in pipelined mode.
+	U64 m_frame = 0;
+};
+/// @}
+
+} // end namespace anki
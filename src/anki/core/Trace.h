@@ -76,6 +76,24 @@ public:
 	{
 		return m_tracer.flush(filename);
 	}
+
+	/// @copydoc Tracer::beginStreaming
+	ANKI_USE_RESULT Error beginStreaming(CString filename, U32 maxChunks)
+	{
+		return m_tracer.beginStreaming(filename, maxChunks);
+	}
+
+	/// @copydoc Tracer::endStreaming
+	ANKI_USE_RESULT Error endStreaming()
+	{
+		return m_tracer.endStreaming();
+	}
+
+	/// @copydoc Tracer::isStreaming
+	Bool isStreaming() const
+	{
+		return m_tracer.isStreaming();
+	}
 };
 
 using CoreTracerSingleton = Singleton<CoreTracer>;
@@ -9,6 +9,8 @@
 #include <anki/util/StringList.h>
 #include <anki/util/Filesystem.h>
 #include <anki/core/Trace.h>
+#include <algorithm>
+#include <cstdlib>
 
 #if defined(__GNUC__)
 #	pragma GCC diagnostic push
@@ -477,6 +479,213 @@ void ShaderCompiler::logShaderErrorCode(CString error, CString source, GenericMe
 		&error[0]);
 }
 
+ShaderBinaryArchive::~ShaderBinaryArchive()
+{
+	m_data.destroy(m_alloc);
+}
+
+Error ShaderBinaryArchive::open(CString filename)
+{
+	ANKI_ASSERT(!isOpen());
+
+	const Error err = openInternal(filename);
+	if(err)
+	{
+		ANKI_GR_LOGE("Failed to open shader binary archive: %s", filename.cstr());
+		m_file.close();
+		m_data.destroy(m_alloc);
+		m_mem = nullptr;
+		m_entries = {};
+	}
+	else
+	{
+		ANKI_GR_LOGI("Loaded shader binary archive with %u binaries", m_entries.getSize());
+	}
+
+	return err;
+}
+
+Error ShaderBinaryArchive::openInternal(CString filename)
+{
+	using File = ShaderBinaryArchiveFile;
+
+	ANKI_CHECK(m_file.open(filename, FileOpenFlag::READ | FileOpenFlag::BINARY));
+	const PtrSize size = m_file.getSize();
+
+	// Validate everything before touching the data so find() doesn't have to
+	if(size < sizeof(File::Header))
+	{
+		ANKI_GR_LOGE("Archive too small");
+		return Error::USER_DATA;
+	}
+
+	const void* mapped;
+	ANKI_CHECK(m_file.map(mapped));
+	if(mapped)
+	{
+		m_mem = static_cast<const U8*>(mapped);
+	}
+	else
+	{
+		m_data.create(m_alloc, (size + sizeof(U64) - 1) / sizeof(U64));
+		ANKI_CHECK(m_file.read(&m_data[0], size));
+		m_mem = reinterpret_cast<const U8*>(&m_data[0]);
+	}
+
+	const File::Header& header = *reinterpret_cast<const File::Header*>(m_mem);
+	if(memcmp(&header.m_magic[0], File::MAGIC, sizeof(header.m_magic)) != 0)
+	{
+		ANKI_GR_LOGE("Wrong magic word");
+		return Error::USER_DATA;
+	}
+
+	const PtrSize entriesEnd = sizeof(File::Header) + PtrSize(header.m_entryCount) * sizeof(File::Entry);
+	if(entriesEnd > size)
+	{
+		ANKI_GR_LOGE("Wrong entry count");
+		return Error::USER_DATA;
+	}
+
+	m_entries = ConstWeakArray<File::Entry>(
+		reinterpret_cast<const File::Entry*>(m_mem + sizeof(File::Header)), header.m_entryCount);
+
+	for(U32 i = 0; i < m_entries.getSize(); ++i)
+	{
+		const File::Entry& entry = m_entries[i];
+		if(entry.m_offset < entriesEnd || entry.m_size > size || entry.m_offset > size - entry.m_size)
+		{
+			ANKI_GR_LOGE("Entry out of bounds");
+			return Error::USER_DATA;
+		}
+
+		if(i > 0 && m_entries[i - 1].m_hash >= entry.m_hash)
+		{
+			ANKI_GR_LOGE("The entries are not sorted");
+			return Error::USER_DATA;
+		}
+	}
+
+	return Error::NONE;
+}
+
+Bool ShaderBinaryArchive::find(U64 hash, ConstWeakArray<U8>& binary) const
+{
+	using Entry = ShaderBinaryArchiveFile::Entry;
+
+	const Entry* end = m_entries.getEnd();
+	const Entry* it =
+		std::lower_bound(m_entries.getBegin(), end, hash, [](const Entry& a, U64 b) { return a.m_hash < b; });
+
+	if(it != end && it->m_hash == hash)
+	{
+		binary = ConstWeakArray<U8>(m_mem + it->m_offset, it->m_size);
+		return true;
+	}
+
+	return false;
+}
+
+Error ShaderBinaryArchive::pack(
+	GenericMemoryPoolAllocator<U8> alloc, CString cacheDir, CString archiveFilename, U32& binaryCount)
+{
+	using Entry = ShaderBinaryArchiveFile::Entry;
+	using Header = ShaderBinaryArchiveFile::Header;
+
+	// Gather the binaries. Their names are the hashes
+	class Ctx
+	{
+	public:
+		DynamicArrayAuto<Entry> m_entries;
+
+		Ctx(GenericMemoryPoolAllocator<U8> alloc)
+			: m_entries(alloc)
+		{
+		}
+	} ctx(alloc);
+
+	ANKI_CHECK(walkDirectoryTree(cacheDir, &ctx, [](const CString& fname, void* ud, Bool isDir) -> Error {
+		const CString ext = ".shdrbin";
+		if(isDir || fname.find("/") != CString::NPOS || fname.getLength() <= ext.getLength()
+			|| fname.find(ext) != fname.getLength() - ext.getLength())
+		{
+			return Error::NONE;
+		}
+
+		Ctx& ctx = *static_cast<Ctx*>(ud);
+		char* numEnd;
+		Entry entry;
+		entry.m_hash = std::strtoull(fname.cstr(), &numEnd, 10);
+		if(numEnd != fname.cstr() + fname.getLength() - ext.getLength())
+		{
+			return Error::NONE;
+		}
+
+		ctx.m_entries.emplaceBack(entry);
+		return Error::NONE;
+	}));
+
+	std::sort(ctx.m_entries.getBegin(), ctx.m_entries.getEnd(), [](const Entry& a, const Entry& b) {
+		return a.m_hash < b.m_hash;
+	});
+
+	// Compute the offsets
+	PtrSize offset = sizeof(Header) + ctx.m_entries.getSizeInBytes();
+	for(Entry& entry : ctx.m_entries)
+	{
+		StringAuto fname(alloc);
+		fname.sprintf("%s/%llu.shdrbin", cacheDir.cstr(), entry.m_hash);
+
+		File file;
+		ANKI_CHECK(file.open(fname.toCString(), FileOpenFlag::READ | FileOpenFlag::BINARY));
+		alignRoundUp(sizeof(U64), offset);
+		entry.m_offset = offset;
+		entry.m_size = file.getSize();
+		offset += entry.m_size;
+	}
+
+	// Write the archive
+	File file;
+	ANKI_CHECK(file.open(archiveFilename, FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+
+	Header header = {};
+	memcpy(&header.m_magic[0], ShaderBinaryArchiveFile::MAGIC, sizeof(header.m_magic));
+	header.m_entryCount = ctx.m_entries.getSize();
+	ANKI_CHECK(file.write(&header, sizeof(header)));
+	if(ctx.m_entries.getSize())
+	{
+		ANKI_CHECK(file.write(&ctx.m_entries[0], ctx.m_entries.getSizeInBytes()));
+	}
+
+	offset = sizeof(Header) + ctx.m_entries.getSizeInBytes();
+	DynamicArrayAuto<U8> bin(alloc);
+	for(const Entry& entry : ctx.m_entries)
+	{
+		const U64 zero = 0;
+		const PtrSize padding = entry.m_offset - offset;
+		if(padding)
+		{
+			ANKI_CHECK(file.write(&zero, padding));
+		}
+
+		StringAuto fname(alloc);
+		fname.sprintf("%s/%llu.shdrbin", cacheDir.cstr(), entry.m_hash);
+
+		File binFile;
+		ANKI_CHECK(binFile.open(fname.toCString(), FileOpenFlag::READ | FileOpenFlag::BINARY));
+		bin.resize(entry.m_size);
+		if(entry.m_size)
+		{
+			ANKI_CHECK(binFile.read(&bin[0], entry.m_size));
+			ANKI_CHECK(file.write(&bin[0], entry.m_size));
+		}
+
+		offset = entry.m_offset + entry.m_size;
+	}
+
+	binaryCount = ctx.m_entries.getSize();
+	return Error::NONE;
+}
+
 Error ShaderCompilerCache::compile(
 	CString source, U64* hash, const ShaderCompilerOptions& options, DynamicArrayAuto<U8>& bin) const
 {
@@ -508,7 +717,16 @@ Error ShaderCompilerCache::compileInternal(
 
 	fhash = appendHash(&options, sizeof(options), fhash);
 
-	// Search the cache
+	// Search the archive. It's read-only so there is no need to lock
+	ConstWeakArray<U8> archived;
+	if(m_archive.isOpen() && m_archive.find(fhash, archived))
+	{
+		bin.resize(archived.getSize());
+		memcpy(&bin[0], &archived[0], archived.getSize());
+		return Error::NONE;
+	}
+
+	// Search the loose files
 	StringAuto fname(m_alloc);
 	fname.sprintf("%s/%llu.shdrbin", m_cacheDir.cstr(), fhash);
 	if(fileExists(fname.toCString()))
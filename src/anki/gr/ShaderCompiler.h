@@ -7,6 +7,8 @@
 
 #include <anki/gr/Common.h>
 #include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+#include <anki/util/File.h>
 
 namespace anki
 {
@@ -76,14 +78,82 @@ private:
 	ANKI_USE_RESULT Error preprocessCommon(CString in, const ShaderCompilerOptions& options, StringAuto& out) const;
 };
 
+/// Information to decode shader binary archives. An archive is a Header followed by an array of Entry sorted by hash
+/// and then by the binaries. The hashes are the ones ShaderCompilerCache uses to name its .shdrbin files.
+class ShaderBinaryArchiveFile
+{
+public:
+	static constexpr const char* MAGIC = "ANKISBA1";
+
+	/// The name of the archive inside the cache directory.
+	static constexpr const char* DEFAULT_FILENAME = "shaders.ankisba";
+
+	struct Header
+	{
+		char m_magic[8];
+		U32 m_entryCount;
+		U32 _padding;
+	};
+
+	struct Entry
+	{
+		U64 m_hash;
+		U64 m_offset; ///< Offset of the binary from the start of the file.
+		U64 m_size;
+	};
+};
+
+/// A read-only archive of shader binaries. The file is memory mapped if possible.
+class ShaderBinaryArchive : public NonCopyable
+{
+public:
+	ShaderBinaryArchive(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~ShaderBinaryArchive();
+
+	ANKI_USE_RESULT Error open(CString filename);
+
+	Bool isOpen() const
+	{
+		return m_mem != nullptr;
+	}
+
+	U32 getBinaryCount() const
+	{
+		return m_entries.getSize();
+	}
+
+	/// Find a binary.
+	/// @note It's thread-safe and it doesn't lock.
+	Bool find(U64 hash, ConstWeakArray<U8>& binary) const;
+
+	/// Pack the .shdrbin files that ShaderCompilerCache writes in its cache directory to an archive.
+	static ANKI_USE_RESULT Error pack(
+		GenericMemoryPoolAllocator<U8> alloc, CString cacheDir, CString archiveFilename, U32& binaryCount);
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	File m_file;
+	DynamicArray<U64> m_data; ///< Holds the file if it can't be mapped. U64 to keep the entries aligned.
+	const U8* m_mem = nullptr;
+	ConstWeakArray<ShaderBinaryArchiveFile::Entry> m_entries;
+
+	ANKI_USE_RESULT Error openInternal(CString filename);
+};
+
 /// Like ShaderCompiler but on steroids. It uses a cache to avoid compiling shaders else it calls
-/// ShaderCompiler::compile
+/// ShaderCompiler::compile. The cache is an archive of precompiled binaries plus the binaries that are compiled at
+/// runtime.
 class ShaderCompilerCache
 {
 public:
 	ShaderCompilerCache(GenericMemoryPoolAllocator<U8> alloc, CString cacheDir)
 		: m_alloc(alloc)
 		, m_compiler(alloc)
+		, m_archive(alloc)
 	{
 		ANKI_ASSERT(!cacheDir.isEmpty());
 		m_cacheDir.create(alloc, cacheDir);
@@ -94,6 +164,12 @@ public:
 		m_cacheDir.destroy(m_alloc);
 	}
 
+	/// Load the archive with the precompiled binaries. Call it before any compile().
+	ANKI_USE_RESULT Error loadArchive(CString filename)
+	{
+		return m_archive.open(filename);
+	}
+
 	/// Compile a shader.
 	/// @param source The source in GLSL.
 	/// @param sourceHash Optional hash of the source. If it's nullptr then the @a source will be hashed.
@@ -105,6 +181,7 @@ public:
 private:
 	GenericMemoryPoolAllocator<U8> m_alloc;
 	ShaderCompiler m_compiler;
+	ShaderBinaryArchive m_archive;
 	String m_cacheDir;
 
 	ANKI_USE_RESULT Error compileInternal(
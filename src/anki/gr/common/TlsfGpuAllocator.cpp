@@ -0,0 +1,497 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/gr/common/TlsfGpuAllocator.h>
+#include <anki/util/Functions.h>
+
+namespace anki
+{
+
+TlsfGpuAllocator::~TlsfGpuAllocator()
+{
+	ANKI_ASSERT(m_allocatedMem == 0 && "Forgot to deallocate");
+	m_blocks.destroy(m_alloc);
+}
+
+void TlsfGpuAllocator::init(GenericMemoryPoolAllocator<U8> alloc, PtrSize size)
+{
+	ANKI_ASSERT(size >= GRANULARITY);
+	m_alloc = alloc;
+	m_size = size / GRANULARITY * GRANULARITY;
+
+	m_flBitmap = 0;
+	for(U32 fl = 0; fl < FL_COUNT; ++fl)
+	{
+		m_slBitmaps[fl] = 0;
+		for(U32 sl = 0; sl < SL_COUNT; ++sl)
+		{
+			m_freeLists[fl][sl] = MAX_U32;
+		}
+	}
+
+	// One free block that covers everything
+	m_firstBlock = newBlock();
+	Block& block = m_blocks[m_firstBlock];
+	block.m_offset = 0;
+	block.m_size = m_size;
+	insertFreeBlock(m_firstBlock);
+}
+
+U32 TlsfGpuAllocator::newBlock()
+{
+	U32 idx;
+	if(m_unusedBlocks != MAX_U32)
+	{
+		idx = m_unusedBlocks;
+		m_unusedBlocks = m_blocks[idx].m_nextFree;
+	}
+	else
+	{
+		idx = m_blocks.getSize();
+		m_blocks.emplaceBack(m_alloc);
+	}
+
+	Block& block = m_blocks[idx];
+	block.m_offset = 0;
+	block.m_size = 0;
+	block.m_userData = nullptr;
+	block.m_prevPhysical = MAX_U32;
+	block.m_nextPhysical = MAX_U32;
+	block.m_prevFree = MAX_U32;
+	block.m_nextFree = MAX_U32;
+	block.m_alignment = GRANULARITY;
+	block.m_free = true;
+	block.m_movable = false;
+	return idx;
+}
+
+void TlsfGpuAllocator::deleteBlock(U32 idx)
+{
+	m_blocks[idx].m_nextFree = m_unusedBlocks;
+	m_unusedBlocks = idx;
+}
+
+void TlsfGpuAllocator::mapping(PtrSize size, U32& fl, U32& sl)
+{
+	ANKI_ASSERT(size >= GRANULARITY && (size % GRANULARITY) == 0);
+	const PtrSize units = size / GRANULARITY;
+
+	if(units < SL_COUNT)
+	{
+		// The small sizes have a list each
+		fl = 0;
+		sl = U32(units);
+	}
+	else
+	{
+		const U32 msb = getMsb(U64(units));
+		fl = msb - SL_BITS + 1;
+		sl = U32(units >> (msb - SL_BITS)) - SL_COUNT;
+	}
+
+	ANKI_ASSERT(fl < FL_COUNT && sl < SL_COUNT);
+}
+
+void TlsfGpuAllocator::insertFreeBlock(U32 idx)
+{
+	Block& block = m_blocks[idx];
+	ANKI_ASSERT(block.m_free);
+
+	U32 fl, sl;
+	mapping(block.m_size, fl, sl);
+
+	const U32 head = m_freeLists[fl][sl];
+	block.m_prevFree = MAX_U32;
+	block.m_nextFree = head;
+	if(head != MAX_U32)
+	{
+		m_blocks[head].m_prevFree = idx;
+	}
+
+	m_freeLists[fl][sl] = idx;
+	m_slBitmaps[fl] |= 1u << sl;
+	m_flBitmap |= U64(1) << fl;
+}
+
+void TlsfGpuAllocator::removeFreeBlock(U32 idx)
+{
+	Block& block = m_blocks[idx];
+	ANKI_ASSERT(block.m_free);
+
+	U32 fl, sl;
+	mapping(block.m_size, fl, sl);
+
+	if(block.m_prevFree != MAX_U32)
+	{
+		m_blocks[block.m_prevFree].m_nextFree = block.m_nextFree;
+	}
+	else
+	{
+		ANKI_ASSERT(m_freeLists[fl][sl] == idx);
+		m_freeLists[fl][sl] = block.m_nextFree;
+
+		if(block.m_nextFree == MAX_U32)
+		{
+			m_slBitmaps[fl] &= ~(1u << sl);
+			if(m_slBitmaps[fl] == 0)
+			{
+				m_flBitmap &= ~(U64(1) << fl);
+			}
+		}
+	}
+
+	if(block.m_nextFree != MAX_U32)
+	{
+		m_blocks[block.m_nextFree].m_prevFree = block.m_prevFree;
+	}
+
+	block.m_prevFree = MAX_U32;
+	block.m_nextFree = MAX_U32;
+}
+
+U32 TlsfGpuAllocator::findFreeBlock(PtrSize size) const
+{
+	if(size > m_size)
+	{
+		return MAX_U32;
+	}
+
+	// Round the size up to the next size class. That way every block of the class fits
+	PtrSize units = size / GRANULARITY;
+	if(units >= SL_COUNT)
+	{
+		units += (PtrSize(1) << (getMsb(U64(units)) - SL_BITS)) - 1;
+	}
+
+	U32 fl, sl;
+	if(units * GRANULARITY <= m_size)
+	{
+		mapping(units * GRANULARITY, fl, sl);
+
+		// Search the same first level and then the bigger ones
+		U32 slBitmap = m_slBitmaps[fl] & (MAX_U32 << sl);
+		if(slBitmap == 0)
+		{
+			const U64 flBitmap = (fl + 1 < FL_COUNT) ? (m_flBitmap & (MAX_U64 << (fl + 1))) : 0;
+			if(flBitmap != 0)
+			{
+				fl = getLsb(flBitmap);
+				slBitmap = m_slBitmaps[fl];
+			}
+		}
+
+		if(slBitmap != 0)
+		{
+			sl = getLsb(slBitmap);
+			const U32 idx = m_freeLists[fl][sl];
+			ANKI_ASSERT(idx != MAX_U32 && m_blocks[idx].m_size >= size);
+			return idx;
+		}
+	}
+
+	// Nothing in the bigger classes. Some blocks of the class of the size might still fit
+	mapping(size, fl, sl);
+	for(U32 idx = m_freeLists[fl][sl]; idx != MAX_U32; idx = m_blocks[idx].m_nextFree)
+	{
+		if(m_blocks[idx].m_size >= size)
+		{
+			return idx;
+		}
+	}
+
+	return MAX_U32;
+}
+
+U32 TlsfGpuAllocator::splitBlock(U32 idx, PtrSize size)
+{
+	ANKI_ASSERT(size > 0 && size < m_blocks[idx].m_size && (size % GRANULARITY) == 0);
+
+	const U32 tailIdx = newBlock();
+	Block& block = m_blocks[idx];
+	Block& tail = m_blocks[tailIdx];
+
+	tail.m_offset = block.m_offset + size;
+	tail.m_size = block.m_size - size;
+	block.m_size = size;
+
+	tail.m_prevPhysical = idx;
+	tail.m_nextPhysical = block.m_nextPhysical;
+	if(block.m_nextPhysical != MAX_U32)
+	{
+		m_blocks[block.m_nextPhysical].m_prevPhysical = tailIdx;
+	}
+	block.m_nextPhysical = tailIdx;
+
+	return tailIdx;
+}
+
+void TlsfGpuAllocator::swapPhysical(U32 a, U32 b)
+{
+	// Swap the positions and then fix the links. If the blocks are neighbours the swapped links point to themselves
+	Block& blockA = m_blocks[a];
+	Block& blockB = m_blocks[b];
+	std::swap(blockA.m_offset, blockB.m_offset);
+	std::swap(blockA.m_size, blockB.m_size);
+	std::swap(blockA.m_prevPhysical, blockB.m_prevPhysical);
+	std::swap(blockA.m_nextPhysical, blockB.m_nextPhysical);
+
+	for(U32 idx : {a, b})
+	{
+		const U32 other = (idx == a) ? b : a;
+		Block& block = m_blocks[idx];
+
+		if(block.m_prevPhysical == idx)
+		{
+			block.m_prevPhysical = other;
+		}
+
+		if(block.m_nextPhysical == idx)
+		{
+			block.m_nextPhysical = other;
+		}
+	}
+
+	for(U32 idx : {a, b})
+	{
+		const Block& block = m_blocks[idx];
+
+		if(block.m_prevPhysical != MAX_U32)
+		{
+			m_blocks[block.m_prevPhysical].m_nextPhysical = idx;
+		}
+
+		if(block.m_nextPhysical != MAX_U32)
+		{
+			m_blocks[block.m_nextPhysical].m_prevPhysical = idx;
+		}
+	}
+
+	if(m_firstBlock == a)
+	{
+		m_firstBlock = b;
+	}
+	else if(m_firstBlock == b)
+	{
+		m_firstBlock = a;
+	}
+}
+
+Error TlsfGpuAllocator::allocate(PtrSize size, U32 alignment, void* userData, TlsfGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(size > 0);
+	ANKI_ASSERT(isPowerOfTwo(alignment));
+	ANKI_ASSERT(!handle && "Already allocated");
+
+	alignment = max(alignment, GRANULARITY);
+	size = getAlignedRoundUp(GRANULARITY, size);
+
+	// Any block of that size has enough space for the padding of the alignment
+	U32 idx = findFreeBlock(size + alignment - GRANULARITY);
+	if(idx == MAX_U32)
+	{
+		return Error::OUT_OF_MEMORY;
+	}
+
+	removeFreeBlock(idx);
+
+	// Leave the padding in the front free
+	const PtrSize padding = getAlignedRoundUp(alignment, m_blocks[idx].m_offset) - m_blocks[idx].m_offset;
+	if(padding > 0)
+	{
+		const U32 tailIdx = splitBlock(idx, padding);
+		insertFreeBlock(idx);
+		idx = tailIdx;
+	}
+
+	// And the remaining at the back
+	if(m_blocks[idx].m_size > size)
+	{
+		insertFreeBlock(splitBlock(idx, size));
+	}
+
+	Block& block = m_blocks[idx];
+	ANKI_ASSERT(block.m_size == size && (block.m_offset % alignment) == 0);
+	block.m_free = false;
+	block.m_movable = false;
+	block.m_alignment = alignment;
+	block.m_userData = userData;
+
+	m_allocatedMem += size;
+
+	handle.m_offset = block.m_offset;
+	handle.m_size = size;
+	handle.m_block = idx;
+
+	return Error::NONE;
+}
+
+void TlsfGpuAllocator::freeBlock(U32 idx)
+{
+	Block& block = m_blocks[idx];
+	ANKI_ASSERT(!block.m_free);
+	block.m_free = true;
+	block.m_movable = false;
+	block.m_userData = nullptr;
+
+	// Merge with the previous
+	const U32 prevIdx = block.m_prevPhysical;
+	if(prevIdx != MAX_U32 && m_blocks[prevIdx].m_free)
+	{
+		removeFreeBlock(prevIdx);
+
+		Block& prev = m_blocks[prevIdx];
+		prev.m_size += block.m_size;
+		prev.m_nextPhysical = block.m_nextPhysical;
+		if(block.m_nextPhysical != MAX_U32)
+		{
+			m_blocks[block.m_nextPhysical].m_prevPhysical = prevIdx;
+		}
+
+		deleteBlock(idx);
+		idx = prevIdx;
+	}
+
+	// Merge with the next
+	Block& merged = m_blocks[idx];
+	const U32 nextIdx = merged.m_nextPhysical;
+	if(nextIdx != MAX_U32 && m_blocks[nextIdx].m_free)
+	{
+		removeFreeBlock(nextIdx);
+
+		const Block& next = m_blocks[nextIdx];
+		merged.m_size += next.m_size;
+		merged.m_nextPhysical = next.m_nextPhysical;
+		if(next.m_nextPhysical != MAX_U32)
+		{
+			m_blocks[next.m_nextPhysical].m_prevPhysical = idx;
+		}
+
+		deleteBlock(nextIdx);
+	}
+
+	insertFreeBlock(idx);
+}
+
+void TlsfGpuAllocator::free(TlsfGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(handle);
+	ANKI_ASSERT(m_blocks[handle.m_block].m_size == handle.m_size);
+
+	m_allocatedMem -= handle.m_size;
+	freeBlock(handle.m_block);
+
+	handle = {};
+}
+
+void TlsfGpuAllocator::setMovable(const TlsfGpuAllocatorHandle& handle, Bool movable)
+{
+	ANKI_ASSERT(handle);
+	ANKI_ASSERT(!m_blocks[handle.m_block].m_free);
+	m_blocks[handle.m_block].m_movable = movable;
+}
+
+void TlsfGpuAllocator::defragment(PtrSize maxMoveSize, DynamicArrayAuto<TlsfGpuAllocatorMove>& moves)
+{
+	// Gather the movable blocks in the order of their offsets
+	DynamicArrayAuto<U32> candidates(m_alloc);
+	for(U32 idx = m_firstBlock; idx != MAX_U32; idx = m_blocks[idx].m_nextPhysical)
+	{
+		if(!m_blocks[idx].m_free && m_blocks[idx].m_movable)
+		{
+			candidates.emplaceBack(idx);
+		}
+	}
+
+	// Move the last blocks to the first free block that fits
+	PtrSize movedSize = 0;
+	for(U32 i = candidates.getSize(); i > 0 && movedSize < maxMoveSize; --i)
+	{
+		const U32 idx = candidates[i - 1];
+		const PtrSize srcOffset = m_blocks[idx].m_offset;
+		const PtrSize size = m_blocks[idx].m_size;
+		const U32 alignment = m_blocks[idx].m_alignment;
+
+		U32 dstIdx = MAX_U32;
+		PtrSize dstOffset = 0;
+		for(U32 fidx = m_firstBlock; fidx != MAX_U32 && m_blocks[fidx].m_offset < srcOffset;
+			fidx = m_blocks[fidx].m_nextPhysical)
+		{
+			const Block& freeBlock = m_blocks[fidx];
+			if(!freeBlock.m_free)
+			{
+				continue;
+			}
+
+			const PtrSize offset = getAlignedRoundUp(alignment, freeBlock.m_offset);
+			if(offset + size <= freeBlock.m_offset + freeBlock.m_size && offset + size <= srcOffset)
+			{
+				dstIdx = fidx;
+				dstOffset = offset;
+				break;
+			}
+		}
+
+		if(dstIdx == MAX_U32)
+		{
+			continue;
+		}
+
+		// Carve the new memory out of the free block
+		removeFreeBlock(dstIdx);
+		const PtrSize padding = dstOffset - m_blocks[dstIdx].m_offset;
+		if(padding > 0)
+		{
+			const U32 tailIdx = splitBlock(dstIdx, padding);
+			insertFreeBlock(dstIdx);
+			dstIdx = tailIdx;
+		}
+
+		if(m_blocks[dstIdx].m_size > size)
+		{
+			insertFreeBlock(splitBlock(dstIdx, size));
+		}
+
+		// The moved block takes the new place so its handle stays valid. The other block keeps the old memory
+		swapPhysical(idx, dstIdx);
+		Block& ghost = m_blocks[dstIdx];
+		ghost.m_free = false;
+		ghost.m_movable = false;
+		ghost.m_userData = nullptr;
+		ghost.m_alignment = GRANULARITY;
+		m_allocatedMem += size;
+
+		TlsfGpuAllocatorMove& move = *moves.emplaceBack();
+		move.m_userData = m_blocks[idx].m_userData;
+		move.m_srcOffset = srcOffset;
+		move.m_dstOffset = dstOffset;
+		move.m_size = size;
+		move.m_src.m_offset = srcOffset;
+		move.m_src.m_size = size;
+		move.m_src.m_block = dstIdx;
+
+		movedSize += size;
+	}
+}
+
+PtrSize TlsfGpuAllocator::getLargestFreeBlockSize() const
+{
+	if(m_flBitmap == 0)
+	{
+		return 0;
+	}
+
+	// The biggest blocks are in the last list but that list has blocks of different sizes
+	const U32 fl = getMsb(m_flBitmap);
+	const U32 sl = getMsb(m_slBitmaps[fl]);
+	PtrSize largest = 0;
+	for(U32 idx = m_freeLists[fl][sl]; idx != MAX_U32; idx = m_blocks[idx].m_nextFree)
+	{
+		largest = max(largest, m_blocks[idx].m_size);
+	}
+
+	return largest;
+}
+
+} // end namespace anki
@@ -0,0 +1,152 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/gr/Common.h>
+#include <anki/util/DynamicArray.h>
+
+namespace anki
+{
+
+/// @addtogroup graphics
+/// @{
+
+/// The output of an allocation.
+class TlsfGpuAllocatorHandle
+{
+	friend class TlsfGpuAllocator;
+
+public:
+	PtrSize m_offset = MAX_PTR_SIZE;
+	PtrSize m_size = 0;
+
+	operator Bool() const
+	{
+		return m_block != MAX_U32;
+	}
+
+private:
+	U32 m_block = MAX_U32;
+};
+
+/// A move of an allocation that TlsfGpuAllocator::defragment() did.
+class TlsfGpuAllocatorMove
+{
+public:
+	void* m_userData; ///< The user data of the allocation that moved.
+	PtrSize m_srcOffset;
+	PtrSize m_dstOffset;
+	PtrSize m_size;
+
+	/// The old memory of the allocation. It's still allocated so it can be read until the copy is done. Free it
+	/// afterwards.
+	TlsfGpuAllocatorHandle m_src;
+};
+
+/// Two level segregated fit allocator. It sub-allocates a range of memory (a big buffer for example) without touching
+/// it. The free blocks are kept in lists of size classes that are found with 2 bitmaps so allocate() and free() are
+/// O(1). It's not thread-safe.
+class TlsfGpuAllocator : public NonCopyable
+{
+public:
+	/// All offsets and sizes are multiple of that.
+	static const U32 GRANULARITY = 16;
+
+	TlsfGpuAllocator() = default;
+
+	~TlsfGpuAllocator();
+
+	/// @param size The size of the range to sub-allocate.
+	void init(GenericMemoryPoolAllocator<U8> alloc, PtrSize size);
+
+	/// Allocate memory.
+	/// @param alignment A power of two.
+	/// @param userData It will be returned in the moves of defragment().
+	ANKI_USE_RESULT Error allocate(PtrSize size, U32 alignment, void* userData, TlsfGpuAllocatorHandle& handle);
+
+	/// Free allocated memory.
+	void free(TlsfGpuAllocatorHandle& handle);
+
+	/// Allow defragment() to move an allocation. They are not movable by default.
+	void setMovable(const TlsfGpuAllocatorHandle& handle, Bool movable);
+
+	/// Move the movable allocations at the end of the range to free space at the beginning. An allocation moves only if
+	/// the old and new memory don't overlap. The handles of the moved allocations keep working but their m_offset is
+	/// stale, the user should update it. It walks all the blocks so don't call it very often.
+	/// @param maxMoveSize Stop after moving that many bytes.
+	/// @param[out] moves The moves that happened. The user should copy the memory of the allocations.
+	void defragment(PtrSize maxMoveSize, DynamicArrayAuto<TlsfGpuAllocatorMove>& moves);
+
+	PtrSize getSize() const
+	{
+		return m_size;
+	}
+
+	PtrSize getAllocatedMemory() const
+	{
+		return m_allocatedMem;
+	}
+
+	/// Get the size of the largest free block. If it's a lot smaller than the free memory the range is fragmented.
+	PtrSize getLargestFreeBlockSize() const;
+
+private:
+	static const U32 SL_BITS = 4;
+	static const U32 SL_COUNT = 1 << SL_BITS;
+	static const U32 FL_COUNT = 48;
+
+	class Block
+	{
+	public:
+		PtrSize m_offset;
+		PtrSize m_size;
+		void* m_userData;
+		U32 m_prevPhysical;
+		U32 m_nextPhysical;
+		U32 m_prevFree;
+		U32 m_nextFree;
+		U32 m_alignment;
+		Bool m_free;
+		Bool m_movable;
+	};
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+
+	DynamicArray<Block> m_blocks;
+	U32 m_firstBlock = MAX_U32; ///< The block at offset zero.
+	U32 m_unusedBlocks = MAX_U32; ///< A list of the recycled elements of m_blocks.
+
+	U64 m_flBitmap = 0;
+	Array<U32, FL_COUNT> m_slBitmaps;
+	Array2d<U32, FL_COUNT, SL_COUNT> m_freeLists; ///< The first block of every size class.
+
+	PtrSize m_size = 0;
+	PtrSize m_allocatedMem = 0;
+
+	U32 newBlock();
+	void deleteBlock(U32 idx);
+
+	static void mapping(PtrSize size, U32& fl, U32& sl);
+
+	void insertFreeBlock(U32 idx);
+	void removeFreeBlock(U32 idx);
+
+	/// Find a free block that fits size or MAX_U32.
+	U32 findFreeBlock(PtrSize size) const;
+
+	/// Split a block. The tail becomes a new block that is free but not in the free lists.
+	/// @return The tail.
+	U32 splitBlock(U32 idx, PtrSize size);
+
+	/// Swap the places of 2 blocks in the physical list.
+	void swapPhysical(U32 a, U32 b);
+
+	/// Free a block and merge it with its free neighbours.
+	void freeBlock(U32 idx);
+};
+/// @}
+
+} // end namespace anki
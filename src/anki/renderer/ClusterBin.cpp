@@ -6,7 +6,7 @@
 #include <anki/renderer/ClusterBin.h>
 #include <anki/renderer/RenderQueue.h>
 #include <anki/Collision.h>
-#include <anki/util/ThreadHive.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
 #include <anki/core/Config.h>
 #include <anki/core/Trace.h>
 
@@ -39,6 +39,75 @@ static Bool insideClusterFrustum(const Array<Plane, 4>& planeArr, const TShape&
 	return true;
 }
 
+/// Test if a typed object of the RenderQueue is inside the frustum of a tile.
+static Bool insideTileFrustum(const RenderQueue& rqueue, U32 type, U32 idx, const Array<Plane, 4>& frustumPlanes)
+{
+	switch(type)
+	{
+	case 0:
+	{
+		const PointLightQueueElement& plight = rqueue.m_pointLights[idx];
+		return insideClusterFrustum(frustumPlanes, Sphere(plight.m_worldPosition.xyz0(), plight.m_radius));
+	}
+	case 1:
+	{
+		const SpotLightQueueElement& slight = rqueue.m_spotLights[idx];
+		Array<Vec4, 5> lightEdges;
+		lightEdges[0] = Vec4(0.0f); // Eye
+		computeEdgesOfFrustum(slight.m_distance, slight.m_outerAngle, slight.m_outerAngle, &lightEdges[1]);
+		ConvexHullShape spotLightShape(&lightEdges[0], lightEdges.getSize());
+		spotLightShape.setTransform(Transform(slight.m_worldTransform));
+		return insideClusterFrustum(frustumPlanes, spotLightShape);
+	}
+	case 2:
+	{
+		const ReflectionProbeQueueElement& probe = rqueue.m_reflectionProbes[idx];
+		return insideClusterFrustum(frustumPlanes, Aabb(probe.m_aabbMin, probe.m_aabbMax));
+	}
+	case 3:
+	{
+		const DecalQueueElement& decal = rqueue.m_decals[idx];
+		const Obb decalBox(decal.m_obbCenter.xyz0(), Mat3x4(decal.m_obbRotation), decal.m_obbExtend.xyz0());
+		return insideClusterFrustum(frustumPlanes, decalBox);
+	}
+	default:
+	{
+		ANKI_ASSERT(type == 4);
+		const FogDensityQueueElement& fogVol = rqueue.m_fogDensityVolumes[idx];
+		return (fogVol.m_isBox)
+				   ? insideClusterFrustum(frustumPlanes, Aabb(fogVol.m_aabbMin, fogVol.m_aabbMax))
+				   : insideClusterFrustum(frustumPlanes, Sphere(fogVol.m_sphereCenter.xyz0(), fogVol.m_sphereRadius));
+	}
+	}
+}
+
+/// Compute the range of the distance from the camera plane of an AABB.
+static void computeDepthRange(const Mat4& viewMat, const Aabb& box, F32& minDepth, F32& maxDepth)
+{
+	const Vec4 center = ((box.getMin() + box.getMax()) / 2.0f).xyz1();
+	const Vec4 extend = (box.getMax() - box.getMin()).xyz0() / 2.0f;
+
+	const Vec4 zRow = viewMat.getRow(2);
+	const F32 depth = -zRow.dot(center);
+	const F32 halfRange = zRow.abs().xyz0().dot(extend);
+	minDepth = depth - halfRange;
+	maxDepth = depth + halfRange;
+}
+
+/// The tiles and the clusters in Z an object may touch.
+class ClusterBin::ObjectBounds
+{
+public:
+	U32 m_index; ///< The index of the object in the RenderQueue.
+	U16 m_tileBeginX;
+	U16 m_tileBeginY;
+	U16 m_tileEndX;
+	U16 m_tileEndY;
+	U16 m_clusterZBegin;
+	U16 m_clusterZEnd;
+	U8 m_type; ///< The type of the object. Same as the order of TYPED_OBJECT_COUNT.
+};
+
 /// Bin context.
 class ClusterBin::BinCtx
 {
@@ -55,7 +124,10 @@ public:
 	WeakArray<U32> m_lightIds;
 	WeakArray<U32> m_clusters;
 
-	Atomic<U32> m_tileIdxToProcess = {0};
+	WeakArray<ObjectBounds> m_objectBounds;
+	WeakArray<U32> m_tileObjectOffsets; ///< Where the objects of a tile start in m_tileObjects. [tileCount + 1]
+	WeakArray<U32> m_tileObjects; ///< Indices to m_objectBounds grouped per tile.
+
 	Atomic<U32> m_allocatedIndexCount = {TYPED_OBJECT_COUNT};
 
 	Vec4 m_unprojParams;
@@ -73,8 +145,6 @@ public:
 	};
 
 	DynamicArrayAuto<Vec4> m_clusterEdgesWSpace;
-	DynamicArrayAuto<Aabb> m_clusterBoxes;
-	DynamicArrayAuto<Sphere> m_clusterSpheres;
 
 	DynamicArrayAuto<ClusterMetaInfo> m_clusterInfos;
 	DynamicArrayAuto<U32> m_indices;
@@ -83,8 +153,6 @@ public:
 
 	TileCtx(StackAllocator<U8>& alloc)
 		: m_clusterEdgesWSpace(alloc)
-		, m_clusterBoxes(alloc)
-		, m_clusterSpheres(alloc)
 		, m_clusterInfos(alloc)
 		, m_indices(alloc)
 	{
@@ -134,6 +202,38 @@ void ClusterBin::bin(ClusterBinIn& in, ClusterBinOut& out)
 	ctx.m_in = &in;
 	ctx.m_out = &out;
 
+	// Allocate indices
+	U32* indices = static_cast<U32*>(ctx.m_in->m_stagingMem->allocateFrame(
+		m_indexCount * sizeof(U32), StagingGpuMemoryType::STORAGE, ctx.m_out->m_indicesToken));
+	ctx.m_lightIds = WeakArray<U32>(indices, m_indexCount);
+
+	// Allocate clusters
+	U32* clusters = static_cast<U32*>(ctx.m_in->m_stagingMem->allocateFrame(
+		sizeof(U32) * m_totalClusterCount, StagingGpuMemoryType::STORAGE, ctx.m_out->m_clustersToken));
+	ctx.m_clusters = WeakArray<U32>(clusters, m_totalClusterCount);
+
+	binToClusters(ctx, true);
+}
+
+void ClusterBin::bin(ClusterBinIn& in, ClusterBinOut& out, WeakArray<U32> clusters, WeakArray<U32> indices)
+{
+	ANKI_TRACE_SCOPED_EVENT(R_BIN_TO_CLUSTERS);
+	ANKI_ASSERT(clusters.getSize() == m_totalClusterCount && indices.getSize() == m_indexCount);
+
+	BinCtx ctx;
+	ctx.m_bin = this;
+	ctx.m_in = &in;
+	ctx.m_out = &out;
+	ctx.m_lightIds = indices;
+	ctx.m_clusters = clusters;
+
+	binToClusters(ctx, false);
+}
+
+void ClusterBin::binToClusters(BinCtx& ctx, Bool writeTypedObjects)
+{
+	ClusterBinIn& in = *ctx.m_in;
+
 	prepare(ctx);
 
 	if(ctx.m_unprojParams != m_prevUnprojParams)
@@ -146,67 +246,61 @@ void ClusterBin::bin(ClusterBinIn& in, ClusterBinOut& out)
 		ctx.m_clusterEdgesDirty = false;
 	}
 
-	// Allocate indices
-	U32* indices = static_cast<U32*>(ctx.m_in->m_stagingMem->allocateFrame(
-		m_indexCount * sizeof(U32), StagingGpuMemoryType::STORAGE, ctx.m_out->m_indicesToken));
-	ctx.m_lightIds = WeakArray<U32>(indices, m_indexCount);
-
 	// Reserve some indices for empty clusters
 	for(U i = 0; i < TYPED_OBJECT_COUNT; ++i)
 	{
-		indices[i] = 0;
+		ctx.m_lightIds[i] = 0;
 	}
 
-	// Allocate clusters
-	U32* clusters = static_cast<U32*>(ctx.m_in->m_stagingMem->allocateFrame(
-		sizeof(U32) * m_totalClusterCount, StagingGpuMemoryType::STORAGE, ctx.m_out->m_clustersToken));
-	ctx.m_clusters = WeakArray<U32>(clusters, m_totalClusterCount);
+	ThreadHiveTaskGraph graph(*in.m_threadHive);
 
 	// Create task for writing GPU buffers
-	Array<ThreadHiveTask, ThreadHive::MAX_THREADS + 1> tasks;
-	tasks[0] = ANKI_THREAD_HIVE_TASK(
-		{
-			ANKI_TRACE_SCOPED_EVENT(R_WRITE_LIGHT_BUFFERS);
-			self->m_bin->writeTypedObjectsToGpuBuffers(*self);
-		},
-		&ctx,
-		nullptr,
-		nullptr);
+	if(writeTypedObjects)
+	{
+		graph.newTask(
+			[&ctx](U32 threadId) { ctx.m_bin->writeTypedObjectsToGpuBuffers(ctx); }, "R_WRITE_LIGHT_BUFFERS");
+	}
 
-	// Create tasks for binning
-	tasks[1] = ANKI_THREAD_HIVE_TASK(
-		{
-			ANKI_TRACE_SCOPED_EVENT(R_BIN_TO_CLUSTERS);
-			BinCtx& ctx = *self;
-
-			TileCtx tileCtx(ctx.m_in->m_tempAlloc);
-			const U32 clusterCountZ = ctx.m_bin->m_clusterCounts[2];
-			tileCtx.m_clusterEdgesWSpace.create((clusterCountZ + 1) * 4);
-			tileCtx.m_clusterBoxes.create(clusterCountZ);
-			tileCtx.m_clusterSpheres.create(clusterCountZ);
-			tileCtx.m_indices.create(clusterCountZ * ctx.m_bin->m_avgObjectsPerCluster);
-			tileCtx.m_clusterInfos.create(clusterCountZ);
-			tileCtx.m_clusterCountZ = clusterCountZ;
-
-			const U tileCount = ctx.m_bin->m_clusterCounts[0] * ctx.m_bin->m_clusterCounts[1];
-			U tileIdx;
-			while((tileIdx = ctx.m_tileIdxToProcess.fetchAdd(1)) < tileCount)
+	// Find the tiles and the Z ranges of all objects once
+	ThreadHiveTaskGraphNode* binToTilesNode =
+		graph.newTask([&ctx](U32 threadId) { ctx.m_bin->binObjectsToTiles(ctx); }, "R_BIN_TO_TILES");
+
+	// Bin the tiles. Every thread lazily creates its own scratch TileCtx
+	Array<TileCtx*, ThreadHive::MAX_THREADS> tileCtxs = {};
+	const U32 tileCount = m_clusterCounts[0] * m_clusterCounts[1];
+	ThreadHiveTaskGraphNode* binTilesNode = graph.newParallelFor(0,
+		tileCount,
+		0,
+		[&](U32 begin, U32 end, U32 threadId) {
+			TileCtx*& tileCtx = tileCtxs[threadId];
+			if(tileCtx == nullptr)
+			{
+				tileCtx = ctx.m_in->m_tempAlloc.newInstance<TileCtx>(ctx.m_in->m_tempAlloc);
+				const U32 clusterCountZ = m_clusterCounts[2];
+				tileCtx->m_clusterEdgesWSpace.create((clusterCountZ + 1) * 4);
+				tileCtx->m_indices.create(clusterCountZ * m_avgObjectsPerCluster);
+				tileCtx->m_clusterInfos.create(clusterCountZ);
+				tileCtx->m_clusterCountZ = clusterCountZ;
+			}
+
+			for(U32 tileIdx = begin; tileIdx < end; ++tileIdx)
 			{
-				ctx.m_bin->binTile(tileIdx, ctx, tileCtx);
+				binTile(tileIdx, ctx, *tileCtx);
 			}
 		},
-		&ctx,
-		nullptr,
-		nullptr);
+		"R_BIN_TO_CLUSTERS");
+	graph.addDependency(binTilesNode, binToTilesNode);
+
+	// Submit and wait
+	graph.submitAndWait();
 
-	for(U threadIdx = 1; threadIdx < in.m_threadHive->getThreadCount(); ++threadIdx)
+	for(TileCtx* tileCtx : tileCtxs)
 	{
-		tasks[threadIdx + 1] = tasks[1];
+		if(tileCtx)
+		{
+			ctx.m_in->m_tempAlloc.deleteInstance(tileCtx);
+		}
 	}
-
-	// Submit and wait
-	in.m_threadHive->submitTasks(&tasks[0], in.m_threadHive->getThreadCount() + 1);
-	in.m_threadHive->waitAllTasks();
 }
 
 void ClusterBin::prepare(BinCtx& ctx)
@@ -311,201 +405,32 @@ void ClusterBin::binTile(U32 tileIdx, BinCtx& ctx, TileCtx& tileCtx)
 		clusterEdgesWSpace[beforeLastQuartet + 0],
 		clusterEdgesWSpace[lastQuartet + 0]);
 
-	// Compute the cluster AABBs and spheres
-	DynamicArrayAuto<Aabb>& clusterBoxes = tileCtx.m_clusterBoxes;
-	DynamicArrayAuto<Sphere>& clusterSpheres = tileCtx.m_clusterSpheres;
-	for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-	{
-		// Compute an AABB and a sphere that contains the cluster
-		Vec4 aabbMin(MAX_F32, MAX_F32, MAX_F32, 0.0f);
-		Vec4 aabbMax(MIN_F32, MIN_F32, MIN_F32, 0.0f);
-		for(U i = 0; i < 8; ++i)
-		{
-			aabbMin = aabbMin.min(clusterEdgesWSpace[clusterZ * 4 + i]);
-			aabbMax = aabbMax.max(clusterEdgesWSpace[clusterZ * 4 + i]);
-		}
-
-		clusterBoxes[clusterZ] = Aabb(aabbMin, aabbMax);
-
-		const Vec4 sphereCenter = (aabbMin + aabbMax) / 2.0f;
-		clusterSpheres[clusterZ] = Sphere(sphereCenter, (aabbMin - sphereCenter).getLength());
-	}
-
 	// Zero the infos
 	memset(&tileCtx.m_clusterInfos[0], 0, tileCtx.m_clusterInfos.getSizeInBytes());
 
-#define ANKI_SET_IDX(typeIdx) \
-	ClusterBin::TileCtx::ClusterMetaInfo& inf = tileCtx.m_clusterInfos[clusterZ]; \
-	if(ANKI_UNLIKELY(inf.m_offset + 1 >= m_avgObjectsPerCluster)) \
-	{ \
-		ANKI_R_LOGW("Out of cluster indices. Increase r.avgObjectsPerCluster"); \
-		continue; \
-	} \
-	tileCtx.getClusterIndices(clusterZ)[inf.m_offset++] = i; \
-	++inf.m_counts[typeIdx]; \
-	ANKI_ASSERT(inf.m_counts[typeIdx] <= m_avgObjectsPerCluster)
-
-	// Point lights
-	{
-		Sphere lightSphere;
-		for(U i = 0; i < ctx.m_in->m_renderQueue->m_pointLights.getSize(); ++i)
-		{
-			const PointLightQueueElement& plight = ctx.m_in->m_renderQueue->m_pointLights[i];
-			lightSphere.setCenter(plight.m_worldPosition.xyz0());
-			lightSphere.setRadius(plight.m_radius);
-
-			if(!insideClusterFrustum(frustumPlanes, lightSphere))
-			{
-				continue;
-			}
-
-			for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-			{
-				if(!testCollision(lightSphere, clusterBoxes[clusterZ]))
-				{
-					continue;
-				}
-
-				ANKI_SET_IDX(0);
-			}
-		}
-	}
-
-	// Spot lights
+	// Visit only the objects that binObjectsToTiles() found to touch the tile. They are sorted by type
+	const RenderQueue& rqueue = *ctx.m_in->m_renderQueue;
+	for(U32 i = ctx.m_tileObjectOffsets[tileIdx]; i < ctx.m_tileObjectOffsets[tileIdx + 1]; ++i)
 	{
-		Array<Vec4, 5> lightEdges;
-		lightEdges[0] = Vec4(0.0f); // Eye
-		ConvexHullShape spotLightShape(&lightEdges[0], lightEdges.getSize());
+		const ObjectBounds& bounds = ctx.m_objectBounds[ctx.m_tileObjects[i]];
 
-		for(U i = 0; i < ctx.m_in->m_renderQueue->m_spotLights.getSize(); ++i)
+		if(!insideTileFrustum(rqueue, bounds.m_type, bounds.m_index, frustumPlanes))
 		{
-			const SpotLightQueueElement& slight = ctx.m_in->m_renderQueue->m_spotLights[i];
-
-			computeEdgesOfFrustum(slight.m_distance, slight.m_outerAngle, slight.m_outerAngle, &lightEdges[1]);
-			spotLightShape.setTransform(Transform(slight.m_worldTransform));
-
-			if(!insideClusterFrustum(frustumPlanes, spotLightShape))
-			{
-				continue;
-			}
-
-			for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-			{
-				if(!testCollision(clusterSpheres[clusterZ],
-					   Cone(slight.m_worldTransform.getTranslationPart().xyz0(),
-						   -slight.m_worldTransform.getZAxis(),
-						   slight.m_distance,
-						   slight.m_outerAngle)))
-				{
-					continue;
-				}
-
-				ANKI_SET_IDX(1);
-			}
-		}
-	}
-
-	// Probes
-	{
-		Aabb probeBox;
-		for(U i = 0; i < ctx.m_in->m_renderQueue->m_reflectionProbes.getSize(); ++i)
-		{
-			const ReflectionProbeQueueElement& probe = ctx.m_in->m_renderQueue->m_reflectionProbes[i];
-			probeBox.setMin(probe.m_aabbMin);
-			probeBox.setMax(probe.m_aabbMax);
-
-			if(!insideClusterFrustum(frustumPlanes, probeBox))
-			{
-				continue;
-			}
-
-			for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-			{
-				if(!testCollision(probeBox, clusterBoxes[clusterZ]))
-				{
-					continue;
-				}
-
-				ANKI_SET_IDX(2);
-			}
+			continue;
 		}
-	}
 
-	// Decals
-	{
-		Obb decalBox;
-		for(U i = 0; i < ctx.m_in->m_renderQueue->m_decals.getSize(); ++i)
+		for(U clusterZ = bounds.m_clusterZBegin; clusterZ < bounds.m_clusterZEnd; ++clusterZ)
 		{
-			const DecalQueueElement& decal = ctx.m_in->m_renderQueue->m_decals[i];
-			decalBox.setCenter(decal.m_obbCenter.xyz0());
-			decalBox.setRotation(Mat3x4(decal.m_obbRotation));
-			decalBox.setExtend(decal.m_obbExtend.xyz0());
-
-			if(!insideClusterFrustum(frustumPlanes, decalBox))
+			ClusterBin::TileCtx::ClusterMetaInfo& inf = tileCtx.m_clusterInfos[clusterZ];
+			if(ANKI_UNLIKELY(inf.m_offset + 1 >= m_avgObjectsPerCluster))
 			{
+				ANKI_R_LOGW("Out of cluster indices. Increase r.avgObjectsPerCluster");
 				continue;
 			}
 
-			for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-			{
-				if(!testCollision(decalBox, clusterBoxes[clusterZ]))
-				{
-					continue;
-				}
-
-				ANKI_SET_IDX(3);
-			}
-		}
-	}
-
-	// Fog volumes
-	{
-		for(U i = 0; i < ctx.m_in->m_renderQueue->m_fogDensityVolumes.getSize(); ++i)
-		{
-			const FogDensityQueueElement& fogVol = ctx.m_in->m_renderQueue->m_fogDensityVolumes[i];
-
-			if(fogVol.m_isBox)
-			{
-				Aabb box;
-				box.setMin(fogVol.m_aabbMin);
-				box.setMax(fogVol.m_aabbMax);
-
-				if(!insideClusterFrustum(frustumPlanes, box))
-				{
-					continue;
-				}
-
-				for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-				{
-					if(!testCollision(box, clusterBoxes[clusterZ]))
-					{
-						continue;
-					}
-
-					ANKI_SET_IDX(4);
-				}
-			}
-			else
-			{
-				Sphere sphere;
-				sphere.setCenter(fogVol.m_sphereCenter.xyz0());
-				sphere.setRadius(fogVol.m_sphereRadius);
-
-				if(!insideClusterFrustum(frustumPlanes, sphere))
-				{
-					continue;
-				}
-
-				for(U clusterZ = 0; clusterZ < m_clusterCounts[2]; ++clusterZ)
-				{
-					if(!testCollision(sphere, clusterBoxes[clusterZ]))
-					{
-						continue;
-					}
-
-					ANKI_SET_IDX(4);
-				}
-			}
+			tileCtx.getClusterIndices(clusterZ)[inf.m_offset++] = bounds.m_index;
+			++inf.m_counts[bounds.m_type];
+			ANKI_ASSERT(inf.m_counts[bounds.m_type] <= m_avgObjectsPerCluster);
 		}
 	}
 
@@ -556,6 +481,185 @@ void ClusterBin::binTile(U32 tileIdx, BinCtx& ctx, TileCtx& tileCtx)
 	}
 }
 
+Bool ClusterBin::computeObjectBounds(
+	const BinCtx& ctx, const Aabb& box, F32 minDepth, F32 maxDepth, ObjectBounds& bounds) const
+{
+	const RenderQueue& rqueue = *ctx.m_in->m_renderQueue;
+	const F32 near = rqueue.m_cameraNear;
+	const F32 far = rqueue.m_cameraFar;
+	if(maxDepth < near || minDepth > far)
+	{
+		return false;
+	}
+
+	// The Z range of the clusters. Invert computeClusterNear()
+	const F32 calcNearOpt = ctx.m_out->m_shaderMagicValues.m_val1.x();
+	const U32 lastClusterZ = m_clusterCounts[2] - 1;
+	bounds.m_clusterZBegin = min(U32(sqrt(max(minDepth - near, 0.0f) / calcNearOpt)), lastClusterZ);
+	bounds.m_clusterZEnd = min(U32(sqrt(max(maxDepth - near, 0.0f) / calcNearOpt)), lastClusterZ) + 1;
+
+	// The tiles. If the box crosses the near plane the projection can't be trusted, use the whole screen then
+	Vec2 ndcMin(-1.0f);
+	Vec2 ndcMax(1.0f);
+	if(minDepth > near)
+	{
+		ndcMin = Vec2(MAX_F32);
+		ndcMax = Vec2(MIN_F32);
+		for(U i = 0; i < 8; ++i)
+		{
+			const Vec4 corner(((i & 1) ? box.getMax() : box.getMin()).x(),
+				((i & 2) ? box.getMax() : box.getMin()).y(),
+				((i & 4) ? box.getMax() : box.getMin()).z(),
+				1.0f);
+
+			const Vec4 clip = rqueue.m_viewProjectionMatrix * corner;
+			if(clip.w() <= near)
+			{
+				// The box is looser than the depth range
+				ndcMin = Vec2(-1.0f);
+				ndcMax = Vec2(1.0f);
+				break;
+			}
+
+			const Vec2 ndc = clip.xy() / clip.w();
+			ndcMin = ndcMin.min(ndc);
+			ndcMax = ndcMax.max(ndc);
+		}
+	}
+
+	const Vec2 tileCounts(m_clusterCounts[0], m_clusterCounts[1]);
+	const Vec2 tileBegin = (ndcMin * 0.5f + 0.5f) * tileCounts;
+	const Vec2 tileEnd = (ndcMax * 0.5f + 0.5f) * tileCounts;
+
+	bounds.m_tileBeginX = U16(clamp(floorf(tileBegin.x()), 0.0f, tileCounts.x()));
+	bounds.m_tileBeginY = U16(clamp(floorf(tileBegin.y()), 0.0f, tileCounts.y()));
+	bounds.m_tileEndX = U16(clamp(floorf(tileEnd.x()) + 1.0f, 0.0f, tileCounts.x()));
+	bounds.m_tileEndY = U16(clamp(floorf(tileEnd.y()) + 1.0f, 0.0f, tileCounts.y()));
+
+	return bounds.m_tileBeginX < bounds.m_tileEndX && bounds.m_tileBeginY < bounds.m_tileEndY;
+}
+
+void ClusterBin::binObjectsToTiles(BinCtx& ctx) const
+{
+	const RenderQueue& rqueue = *ctx.m_in->m_renderQueue;
+	StackAllocator<U8>& alloc = ctx.m_in->m_tempAlloc;
+	const Mat4& viewMat = rqueue.m_viewMatrix;
+
+	const U32 objectCount = rqueue.m_pointLights.getSize() + rqueue.m_spotLights.getSize()
+							+ rqueue.m_reflectionProbes.getSize() + rqueue.m_decals.getSize()
+							+ rqueue.m_fogDensityVolumes.getSize();
+	ObjectBounds* bounds = (objectCount) ? alloc.newArray<ObjectBounds>(objectCount) : nullptr;
+	U32 boundsCount = 0;
+
+	// Compute the bounds of the objects. Keep them sorted by type
+	auto appendObject = [&](const Aabb& box, F32 minDepth, F32 maxDepth, U32 type, U32 idx) {
+		ObjectBounds& b = bounds[boundsCount];
+		if(computeObjectBounds(ctx, box, minDepth, maxDepth, b))
+		{
+			b.m_type = U8(type);
+			b.m_index = idx;
+			++boundsCount;
+		}
+	};
+
+	auto appendSphere = [&](const Sphere& sphere, U32 type, U32 idx) {
+		const F32 depth = -viewMat.getRow(2).dot(sphere.getCenter().xyz1());
+		appendObject(computeAabb(sphere), depth - sphere.getRadius(), depth + sphere.getRadius(), type, idx);
+	};
+
+	auto appendBox = [&](const Aabb& box, U32 type, U32 idx) {
+		F32 minDepth, maxDepth;
+		computeDepthRange(viewMat, box, minDepth, maxDepth);
+		appendObject(box, minDepth, maxDepth, type, idx);
+	};
+
+	for(U32 i = 0; i < rqueue.m_pointLights.getSize(); ++i)
+	{
+		const PointLightQueueElement& plight = rqueue.m_pointLights[i];
+		appendSphere(Sphere(plight.m_worldPosition.xyz0(), plight.m_radius), 0, i);
+	}
+
+	Array<Vec4, 5> lightEdges;
+	lightEdges[0] = Vec4(0.0f); // Eye
+	ConvexHullShape spotLightShape(&lightEdges[0], lightEdges.getSize());
+	for(U32 i = 0; i < rqueue.m_spotLights.getSize(); ++i)
+	{
+		const SpotLightQueueElement& slight = rqueue.m_spotLights[i];
+		computeEdgesOfFrustum(slight.m_distance, slight.m_outerAngle, slight.m_outerAngle, &lightEdges[1]);
+		spotLightShape.setTransform(Transform(slight.m_worldTransform));
+		appendBox(computeAabb(spotLightShape), 1, i);
+	}
+
+	for(U32 i = 0; i < rqueue.m_reflectionProbes.getSize(); ++i)
+	{
+		const ReflectionProbeQueueElement& probe = rqueue.m_reflectionProbes[i];
+		appendBox(Aabb(probe.m_aabbMin, probe.m_aabbMax), 2, i);
+	}
+
+	for(U32 i = 0; i < rqueue.m_decals.getSize(); ++i)
+	{
+		const DecalQueueElement& decal = rqueue.m_decals[i];
+		const Obb decalBox(decal.m_obbCenter.xyz0(), Mat3x4(decal.m_obbRotation), decal.m_obbExtend.xyz0());
+		appendBox(computeAabb(decalBox), 3, i);
+	}
+
+	for(U32 i = 0; i < rqueue.m_fogDensityVolumes.getSize(); ++i)
+	{
+		const FogDensityQueueElement& fogVol = rqueue.m_fogDensityVolumes[i];
+		if(fogVol.m_isBox)
+		{
+			appendBox(Aabb(fogVol.m_aabbMin, fogVol.m_aabbMax), 4, i);
+		}
+		else
+		{
+			appendSphere(Sphere(fogVol.m_sphereCenter.xyz0(), fogVol.m_sphereRadius), 4, i);
+		}
+	}
+
+	ctx.m_objectBounds = WeakArray<ObjectBounds>(bounds, boundsCount);
+
+	// Count the objects per tile
+	const U32 tileCount = m_clusterCounts[0] * m_clusterCounts[1];
+	U32* offsets = alloc.newArray<U32>(tileCount + 1, 0u);
+	for(const ObjectBounds& b : ctx.m_objectBounds)
+	{
+		for(U32 y = b.m_tileBeginY; y < b.m_tileEndY; ++y)
+		{
+			for(U32 x = b.m_tileBeginX; x < b.m_tileEndX; ++x)
+			{
+				++offsets[y * m_clusterCounts[0] + x + 1];
+			}
+		}
+	}
+
+	for(U32 t = 0; t < tileCount; ++t)
+	{
+		offsets[t + 1] += offsets[t];
+	}
+
+	ctx.m_tileObjectOffsets = WeakArray<U32>(offsets, tileCount + 1);
+
+	// Scatter the objects to the tiles
+	const U32 tileObjectCount = offsets[tileCount];
+	U32* tileObjects = (tileObjectCount) ? alloc.newArray<U32>(tileObjectCount) : nullptr;
+	U32* cursors = alloc.newArray<U32>(tileCount);
+	memcpy(cursors, offsets, sizeof(U32) * tileCount);
+	for(U32 i = 0; i < boundsCount; ++i)
+	{
+		const ObjectBounds& b = bounds[i];
+		for(U32 y = b.m_tileBeginY; y < b.m_tileEndY; ++y)
+		{
+			for(U32 x = b.m_tileBeginX; x < b.m_tileEndX; ++x)
+			{
+				tileObjects[cursors[y * m_clusterCounts[0] + x]++] = i;
+			}
+		}
+	}
+
+	ctx.m_tileObjects = WeakArray<U32>(tileObjects, tileObjectCount);
+	alloc.deleteArray(cursors, tileCount);
+}
+
 void ClusterBin::writeTypedObjectsToGpuBuffers(BinCtx& ctx) const
 {
 	const RenderQueue& rqueue = *ctx.m_in->m_renderQueue;
@@ -14,6 +14,7 @@ namespace anki
 // Forward
 class ThreadHiveSemaphore;
 class Config;
+class Aabb;
 
 /// @addtogroup renderer
 /// @{
@@ -60,9 +61,26 @@ public:
 
 	void bin(ClusterBinIn& in, ClusterBinOut& out);
 
+	/// Same as bin() but the clusters and the indices are written to CPU memory and the typed objects are not written
+	/// at all. ClusterBinIn::m_stagingMem is not used. Useful for testing and benchmarking.
+	/// @param clusters It should be getTotalClusterCount() long.
+	/// @param indices It should be getIndexCount() long.
+	void bin(ClusterBinIn& in, ClusterBinOut& out, WeakArray<U32> clusters, WeakArray<U32> indices);
+
+	U32 getTotalClusterCount() const
+	{
+		return m_totalClusterCount;
+	}
+
+	U32 getIndexCount() const
+	{
+		return m_indexCount;
+	}
+
 private:
 	class BinCtx;
 	class TileCtx;
+	class ObjectBounds;
 
 	HeapAllocator<U8> m_alloc;
 
@@ -76,6 +94,14 @@ private:
 
 	void prepare(BinCtx& ctx);
 
+	void binToClusters(BinCtx& ctx, Bool writeTypedObjects);
+
+	/// Compute the screen space and depth bounds of all objects once and find the objects that touch every tile.
+	void binObjectsToTiles(BinCtx& ctx) const;
+
+	Bool computeObjectBounds(
+		const BinCtx& ctx, const Aabb& box, F32 minDepth, F32 maxDepth, ObjectBounds& bounds) const;
+
 	void binTile(U32 tileIdx, BinCtx& ctx, TileCtx& tileCtx);
 
 	void writeTypedObjectsToGpuBuffers(BinCtx& ctx) const;
@@ -31,7 +31,13 @@ public:
 /// Check if the drawcalls can be merged.
 static Bool canMergeRenderableQueueElements(const RenderableQueueElement& a, const RenderableQueueElement& b)
 {
-	return a.m_callback == b.m_callback && a.m_mergeKey != 0 && a.m_mergeKey == b.m_mergeKey;
+	if(a.m_callback != b.m_callback || a.m_drawRangeCount != 0 || b.m_drawRangeCount != 0)
+	{
+		return false;
+	}
+
+	// Same geometry (instancing) or different geometry in the same buffers (one draw per geometry)
+	return (a.m_mergeKey != 0 && a.m_mergeKey == b.m_mergeKey) || (a.m_batchKey != 0 && a.m_batchKey == b.m_batchKey);
 }
 
 RenderableDrawer::~RenderableDrawer()
@@ -76,6 +82,8 @@ void RenderableDrawer::flushDrawcall(DrawContext& ctx)
 {
 	ctx.m_queueCtx.m_key.m_lod = ctx.m_cachedRenderElementLods[0];
 	ctx.m_queueCtx.m_key.m_instanceCount = ctx.m_cachedRenderElementCount;
+	ctx.m_queueCtx.m_drawRanges = ConstWeakArray<RenderableDrawRange>(
+		ctx.m_cachedRenderElements[0].m_drawRanges, ctx.m_cachedRenderElements[0].m_drawRangeCount);
 
 	ctx.m_cachedRenderElements[0].m_callback(
 		ctx.m_queueCtx, ConstWeakArray<void*>(const_cast<void**>(&ctx.m_userData[0]), ctx.m_cachedRenderElementCount));
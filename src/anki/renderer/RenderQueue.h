@@ -34,6 +34,14 @@ enum class RenderQueueDebugDrawFlag : U32
 	COUNT
 };
 
+/// A range of the indices of a renderable.
+class RenderableDrawRange final
+{
+public:
+	U32 m_firstIndex;
+	U32 m_indexCount;
+};
+
 /// Context that contains variables for drawing and will be passed to RenderQueueDrawCallback.
 class RenderQueueDrawContext final : public RenderingMatrices
 {
@@ -44,6 +52,9 @@ public:
 	StagingGpuMemoryManager* m_stagingGpuAllocator ANKI_DEBUG_CODE(= nullptr);
 	Bool m_debugDraw; ///< If true the drawcall should be drawing some kind of debug mesh.
 	BitSet<U(RenderQueueDebugDrawFlag::COUNT), U32> m_debugDrawFlags = {false};
+
+	/// The visible parts of a single instance. If it's empty draw everything. See RenderableQueueElement::m_drawRanges.
+	ConstWeakArray<RenderableDrawRange> m_drawRanges;
 };
 
 /// Draw callback for drawing.
@@ -55,8 +66,21 @@ class RenderableQueueElement final
 public:
 	RenderQueueDrawCallback m_callback;
 	const void* m_userData;
+
+	/// The elements with the same non-zero merge key have the same geometry and they are drawn instanced.
 	U64 m_mergeKey;
+
+	/// The elements with the same non-zero batch key have different geometry in the same index and vertex buffers and
+	/// their callback can draw them all with one draw per merge key. The callback should bind the shared state once.
+	U64 m_batchKey;
+
 	F32 m_distanceFromCamera; ///< Don't set this
+	U64 m_sortKey; ///< The lists are sorted on that. Don't set this
+
+	/// If the visibility tests culled some meshlets it points to the ranges of the indices of the rest. These ranges
+	/// refer to the first LOD. The element is not merged with others then. Don't set this.
+	const RenderableDrawRange* m_drawRanges;
+	U32 m_drawRangeCount; ///< Don't set this
 
 	RenderableQueueElement()
 	{
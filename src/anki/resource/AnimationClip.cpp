@@ -0,0 +1,701 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/AnimationClip.h>
+#include <anki/resource/ResourceFilesystem.h>
+#include <anki/util/File.h>
+#include <algorithm>
+
+namespace anki
+{
+
+/// The inputs and the outputs of the interpolation of 4 channels. Every array has one value per channel so the
+/// interpolation can work on all the channels at once.
+class alignas(16) AnimationSampleBatch
+{
+public:
+	using Lanes = Array<F32, 4>;
+
+	/// The times of the keys around the sampling time for the positions, the rotations and the scales.
+	Array<Lanes, 3> m_leftTimes;
+	Array<Lanes, 3> m_rightTimes;
+
+	Array<Lanes, 3> m_positionLeft; ///< The positions before the min and the scale. It's the output as well.
+	Array<Lanes, 3> m_positionRight;
+	Array<Lanes, 3> m_positionMin;
+	Array<Lanes, 3> m_positionScale;
+
+	Array<Lanes, 4> m_rotationLeft; ///< The quantized rotations. It's the output as well.
+	Array<Lanes, 4> m_rotationRight;
+
+	Lanes m_scaleLeft; ///< It's the output as well.
+	Lanes m_scaleRight;
+};
+
+/// Remove the keys of a track that the interpolation of the keys around them can reproduce. The first and the last
+/// keys are always kept unless the track is constant.
+/// @param interpolate A functor with signature T(const T& left, const T& right, F32 factor).
+/// @param error A functor with signature F32(const T& a, const T& b).
+/// @param[out] kept The indices of the keys that remain.
+template<typename T, typename TInterpolateFunc, typename TErrorFunc>
+static void reduceKeys(ConstWeakArray<Second> times,
+	ConstWeakArray<T> values,
+	F32 tolerance,
+	TInterpolateFunc interpolate,
+	TErrorFunc error,
+	DynamicArrayAuto<U32>& kept)
+{
+	ANKI_ASSERT(times.getSize() == values.getSize() && values.getSize() > 0);
+	const U32 keyCount = U32(values.getSize());
+
+	kept.destroy();
+	kept.emplaceBack(0u);
+
+	// Grow a segment from the last kept key until a key in between can't be interpolated
+	U32 left = 0;
+	for(U32 right = left + 2; right < keyCount; ++right)
+	{
+		const Second range = times[right] - times[left];
+		Bool fits = true;
+		for(U32 k = left + 1; k < right && fits; ++k)
+		{
+			const F32 factor = (range > 0.0) ? F32((times[k] - times[left]) / range) : 0.0f;
+			fits = error(interpolate(values[left], values[right], factor), values[k]) <= tolerance;
+		}
+
+		if(!fits)
+		{
+			left = right - 1;
+			kept.emplaceBack(left);
+		}
+	}
+
+	if(keyCount > 1)
+	{
+		kept.emplaceBack(keyCount - 1);
+	}
+
+	if(kept.getSize() == 2 && error(values[kept[0]], values[kept[1]]) <= tolerance)
+	{
+		kept.resize(1);
+	}
+}
+
+static Vec4 nlerp(const Vec4& left, const Vec4& right, F32 factor)
+{
+	const Vec4 v = linearInterpolate(left, right, factor);
+	return v / sqrt(v.dot(v));
+}
+
+/// Get the interpolation factor between a key and the next one.
+static void computeFactor(const F32* times, U32 keyCount, F32 time, U32 left, U32& right, F32& factor)
+{
+	right = min(left + 1, keyCount - 1);
+	const F32 range = times[right] - times[left];
+	factor = (range > 0.0f) ? clamp((time - times[left]) / range, 0.0f, 1.0f) : 0.0f;
+}
+
+/// Find the key before the time with a binary search.
+static void findKey(const F32* times, U32 keyCount, F32 time, U32& left, U32& right, F32& factor)
+{
+	const PtrSize after = PtrSize(std::upper_bound(times, times + keyCount, time) - times);
+	left = U32(max<PtrSize>(after, 1) - 1);
+	computeFactor(times, keyCount, time, left, right, factor);
+}
+
+/// Move the key of a cursor forward until the next key is after the time.
+static void advanceKey(const F32* times, U32 keyCount, F32 time, U16& key, U32& right)
+{
+	U32 left = key;
+	while(left + 1 < keyCount && times[left + 1] <= time)
+	{
+		++left;
+	}
+
+	key = U16(left);
+	right = min(left + 1, keyCount - 1);
+}
+
+AnimationClip::~AnimationClip()
+{
+	destroy();
+}
+
+void AnimationClip::destroy()
+{
+	m_channels.destroy(m_alloc);
+	m_positionTimes.destroy(m_alloc);
+	m_positions.destroy(m_alloc);
+	m_rawPositions.destroy(m_alloc);
+	m_rotationTimes.destroy(m_alloc);
+	m_rotations.destroy(m_alloc);
+	m_scaleTimes.destroy(m_alloc);
+	m_scales.destroy(m_alloc);
+}
+
+Error AnimationClip::compress(
+	ConstWeakArray<AnimationChannel> channels, F32 positionTolerance, F32 rotationTolerance, F32 scaleTolerance)
+{
+	destroy();
+
+	if(channels.getSize() == 0)
+	{
+		ANKI_RESOURCE_LOGE("Didn't found any channels");
+		return Error::USER_DATA;
+	}
+
+	// Find the time range
+	Second minTime = MAX_SECOND;
+	Second maxTime = MIN_SECOND;
+	auto updateTimeRange = [&](Second time) {
+		minTime = min(minTime, time);
+		maxTime = max(maxTime, time);
+	};
+
+	for(const AnimationChannel& in : channels)
+	{
+		for(const AnimationKeyframe<Vec3>& key : in.m_positions)
+		{
+			updateTimeRange(key.getTime());
+		}
+
+		for(const AnimationKeyframe<Quat>& key : in.m_rotations)
+		{
+			updateTimeRange(key.getTime());
+		}
+
+		for(const AnimationKeyframe<F32>& key : in.m_scales)
+		{
+			updateTimeRange(key.getTime());
+		}
+	}
+
+	if(minTime > maxTime)
+	{
+		minTime = maxTime = 0.0;
+	}
+
+	m_startTime = minTime;
+	m_duration = maxTime - minTime;
+
+	m_channels.create(m_alloc, channels.getSize());
+	DynamicArrayAuto<Second> times(m_alloc);
+	DynamicArrayAuto<U32> kept(m_alloc);
+	for(U32 channelIdx = 0; channelIdx < channels.getSize(); ++channelIdx)
+	{
+		const AnimationChannel& in = channels[channelIdx];
+		AnimationBinaryFile::Channel& out = m_channels[channelIdx];
+
+		// Name
+		const PtrSize nameLength = (in.m_name.isEmpty()) ? 0 : in.m_name.getLength();
+		if(nameLength > AnimationBinaryFile::MAX_CHANNEL_NAME_LENGTH)
+		{
+			ANKI_RESOURCE_LOGE("Channel name too long: %s", in.m_name.cstr());
+			return Error::USER_DATA;
+		}
+
+		memset(&out.m_name[0], 0, sizeof(out.m_name));
+		if(nameLength)
+		{
+			memcpy(&out.m_name[0], in.m_name.cstr(), nameLength);
+		}
+
+		// Positions. Quantize them in their bounding box if the quantization error leaves enough of the tolerance for
+		// the key reduction. The interpolation of the quantized keys is off by the reduction error plus the
+		// quantization error at most
+		{
+			DynamicArrayAuto<Vec3> values(m_alloc);
+			times.destroy();
+			for(const AnimationKeyframe<Vec3>& key : in.m_positions)
+			{
+				times.emplaceBack(key.getTime());
+				values.emplaceBack(key.getValue());
+			}
+
+			if(values.getSize() == 0)
+			{
+				times.emplaceBack(m_startTime);
+				values.emplaceBack(0.0f);
+			}
+
+			Vec3 aabbMin(MAX_F32);
+			Vec3 aabbMax(MIN_F32);
+			for(const Vec3& v : values)
+			{
+				aabbMin = aabbMin.min(v);
+				aabbMax = aabbMax.max(v);
+			}
+
+			const Vec3 quantizationStep = (aabbMax - aabbMin) / F32(MAX_U16);
+			const F32 quantizationError = quantizationStep.getLength() * 0.5f;
+			const Bool quantize = quantizationError <= positionTolerance * 0.5f;
+
+			reduceKeys<Vec3>(times,
+				values,
+				(quantize) ? positionTolerance - quantizationError : positionTolerance,
+				[](const Vec3& a, const Vec3& b, F32 factor) { return linearInterpolate(a, b, factor); },
+				[](const Vec3& a, const Vec3& b) { return (a - b).getLength(); },
+				kept);
+
+			out.m_firstPositionKey = U32(m_positionTimes.getSize());
+			out.m_positionKeyCount = U32(kept.getSize());
+			out.m_rawPositions = !quantize;
+			out.m_firstPositionValue = U32((quantize) ? m_positions.getSize() : m_rawPositions.getSize());
+			out.m_positionMin = (quantize) ? aabbMin : Vec3(0.0f);
+			out.m_positionScale = (quantize) ? quantizationStep : Vec3(1.0f);
+
+			for(U32 k : kept)
+			{
+				m_positionTimes.emplaceBack(m_alloc, F32(times[k]));
+
+				if(quantize)
+				{
+					AnimationBinaryFile::QuantizedPosition q;
+					for(U32 c = 0; c < 3; ++c)
+					{
+						F32 f = 0.0f;
+						if(quantizationStep[c] > 0.0f)
+						{
+							f = (values[k][c] - aabbMin[c]) / quantizationStep[c] + 0.5f;
+						}
+
+						q[c] = U16(clamp(f, 0.0f, F32(MAX_U16)));
+					}
+
+					m_positions.emplaceBack(m_alloc, q);
+				}
+				else
+				{
+					m_rawPositions.emplaceBack(m_alloc, values[k]);
+				}
+			}
+		}
+
+		// Rotations. Keep the neighbours in the same hemisphere so nlerp takes the short path
+		{
+			DynamicArrayAuto<Vec4> values(m_alloc);
+			times.destroy();
+			for(const AnimationKeyframe<Quat>& key : in.m_rotations)
+			{
+				Vec4 v(key.getValue().x(), key.getValue().y(), key.getValue().z(), key.getValue().w());
+				v = v / sqrt(v.dot(v));
+				if(values.getSize() && values.getBack().dot(v) < 0.0f)
+				{
+					v = -v;
+				}
+
+				times.emplaceBack(key.getTime());
+				values.emplaceBack(v);
+			}
+
+			if(values.getSize() == 0)
+			{
+				times.emplaceBack(m_startTime);
+				values.emplaceBack(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+
+			// The SNORM quantization moves every component half a step at most
+			const F32 quantizationError = 1.0f / F32(MAX_I16);
+			reduceKeys<Vec4>(times,
+				values,
+				max(rotationTolerance - quantizationError, 0.0f),
+				nlerp,
+				[](const Vec4& a, const Vec4& b) { return (a - b).getLength(); },
+				kept);
+
+			out.m_firstRotationKey = U32(m_rotationTimes.getSize());
+			out.m_rotationKeyCount = U32(kept.getSize());
+
+			for(U32 k : kept)
+			{
+				AnimationBinaryFile::QuantizedRotation q;
+				for(U32 c = 0; c < 4; ++c)
+				{
+					const F32 f = values[k][c] * F32(MAX_I16);
+					q[c] = I16(clamp(f + ((f < 0.0f) ? -0.5f : 0.5f), -F32(MAX_I16), F32(MAX_I16)));
+				}
+
+				m_rotationTimes.emplaceBack(m_alloc, F32(times[k]));
+				m_rotations.emplaceBack(m_alloc, q);
+			}
+		}
+
+		// Scales
+		{
+			DynamicArrayAuto<F32> values(m_alloc);
+			times.destroy();
+			for(const AnimationKeyframe<F32>& key : in.m_scales)
+			{
+				times.emplaceBack(key.getTime());
+				values.emplaceBack(key.getValue());
+			}
+
+			if(values.getSize() == 0)
+			{
+				times.emplaceBack(m_startTime);
+				values.emplaceBack(1.0f);
+			}
+
+			reduceKeys<F32>(times,
+				values,
+				scaleTolerance,
+				[](F32 a, F32 b, F32 factor) { return linearInterpolate(a, b, factor); },
+				[](F32 a, F32 b) { return absolute(a - b); },
+				kept);
+
+			out.m_firstScaleKey = U32(m_scaleTimes.getSize());
+			out.m_scaleKeyCount = U32(kept.getSize());
+
+			for(U32 k : kept)
+			{
+				m_scaleTimes.emplaceBack(m_alloc, F32(times[k]));
+				m_scales.emplaceBack(m_alloc, values[k]);
+			}
+		}
+
+		if(out.m_positionKeyCount > AnimationBinaryFile::MAX_TRACK_KEY_COUNT
+			|| out.m_rotationKeyCount > AnimationBinaryFile::MAX_TRACK_KEY_COUNT
+			|| out.m_scaleKeyCount > AnimationBinaryFile::MAX_TRACK_KEY_COUNT)
+		{
+			ANKI_RESOURCE_LOGE("Too many keys in channel %s", &out.m_name[0]);
+			return Error::USER_DATA;
+		}
+	}
+
+	return Error::NONE;
+}
+
+Error AnimationClip::checkHeader(const AnimationBinaryFile::Header& header) const
+{
+	if(memcmp(&header.m_magic[0], AnimationBinaryFile::MAGIC, 8) != 0)
+	{
+		ANKI_RESOURCE_LOGE("Wrong magic word");
+		return Error::USER_DATA;
+	}
+
+	if(header.m_channelCount == 0)
+	{
+		ANKI_RESOURCE_LOGE("Didn't found any channels");
+		return Error::USER_DATA;
+	}
+
+	if(header.m_positionKeyCount < header.m_channelCount || header.m_rotationKeyCount < header.m_channelCount
+		|| header.m_scaleKeyCount < header.m_channelCount)
+	{
+		ANKI_RESOURCE_LOGE("Every track should have at least one key");
+		return Error::USER_DATA;
+	}
+
+	if(PtrSize(header.m_quantizedPositionCount) + header.m_rawPositionCount != header.m_positionKeyCount)
+	{
+		ANKI_RESOURCE_LOGE("Wrong position count");
+		return Error::USER_DATA;
+	}
+
+	if(!(header.m_duration >= 0.0f))
+	{
+		ANKI_RESOURCE_LOGE("Wrong duration");
+		return Error::USER_DATA;
+	}
+
+	return Error::NONE;
+}
+
+Error AnimationClip::load(ResourceFile& file)
+{
+	destroy();
+
+	AnimationBinaryFile::Header header;
+	ANKI_CHECK(file.read(&header, sizeof(header)));
+	ANKI_CHECK(checkHeader(header));
+
+	m_startTime = header.m_startTime;
+	m_duration = header.m_duration;
+
+	m_channels.create(m_alloc, header.m_channelCount);
+	ANKI_CHECK(file.read(&m_channels[0], m_channels.getSizeInBytes()));
+
+	m_positionTimes.create(m_alloc, header.m_positionKeyCount);
+	ANKI_CHECK(file.read(&m_positionTimes[0], m_positionTimes.getSizeInBytes()));
+	if(header.m_quantizedPositionCount)
+	{
+		m_positions.create(m_alloc, header.m_quantizedPositionCount);
+		ANKI_CHECK(file.read(&m_positions[0], m_positions.getSizeInBytes()));
+	}
+	if(header.m_rawPositionCount)
+	{
+		m_rawPositions.create(m_alloc, header.m_rawPositionCount);
+		ANKI_CHECK(file.read(&m_rawPositions[0], m_rawPositions.getSizeInBytes()));
+	}
+
+	m_rotationTimes.create(m_alloc, header.m_rotationKeyCount);
+	ANKI_CHECK(file.read(&m_rotationTimes[0], m_rotationTimes.getSizeInBytes()));
+	m_rotations.create(m_alloc, header.m_rotationKeyCount);
+	ANKI_CHECK(file.read(&m_rotations[0], m_rotations.getSizeInBytes()));
+
+	m_scaleTimes.create(m_alloc, header.m_scaleKeyCount);
+	ANKI_CHECK(file.read(&m_scaleTimes[0], m_scaleTimes.getSizeInBytes()));
+	m_scales.create(m_alloc, header.m_scaleKeyCount);
+	ANKI_CHECK(file.read(&m_scales[0], m_scales.getSizeInBytes()));
+
+	// Check the channels
+	auto checkTrack = [](U32 first, U32 count, U32 totalCount) {
+		return count > 0 && count <= AnimationBinaryFile::MAX_TRACK_KEY_COUNT && first <= totalCount
+			   && count <= totalCount - first;
+	};
+
+	for(const AnimationBinaryFile::Channel& ch : m_channels)
+	{
+		if(ch.m_name.getBack() != '\0')
+		{
+			ANKI_RESOURCE_LOGE("Wrong channel name");
+			return Error::USER_DATA;
+		}
+
+		const U32 positionValueCount = (ch.m_rawPositions) ? header.m_rawPositionCount : header.m_quantizedPositionCount;
+		if(!checkTrack(ch.m_firstPositionKey, ch.m_positionKeyCount, header.m_positionKeyCount)
+			|| !checkTrack(ch.m_firstPositionValue, ch.m_positionKeyCount, positionValueCount)
+			|| ch.m_rawPositions > 1 || !checkTrack(ch.m_firstRotationKey, ch.m_rotationKeyCount, header.m_rotationKeyCount)
+			|| !checkTrack(ch.m_firstScaleKey, ch.m_scaleKeyCount, header.m_scaleKeyCount))
+		{
+			ANKI_RESOURCE_LOGE("Incorrect keys of channel %s", &ch.m_name[0]);
+			return Error::USER_DATA;
+		}
+	}
+
+	return Error::NONE;
+}
+
+Error AnimationClip::save(File& file) const
+{
+	AnimationBinaryFile::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header.m_magic[0], AnimationBinaryFile::MAGIC, 8);
+	header.m_channelCount = U32(m_channels.getSize());
+	header.m_positionKeyCount = U32(m_positionTimes.getSize());
+	header.m_quantizedPositionCount = U32(m_positions.getSize());
+	header.m_rawPositionCount = U32(m_rawPositions.getSize());
+	header.m_rotationKeyCount = U32(m_rotations.getSize());
+	header.m_scaleKeyCount = U32(m_scales.getSize());
+	header.m_startTime = F32(m_startTime);
+	header.m_duration = F32(m_duration);
+
+	ANKI_CHECK(file.write(&header, sizeof(header)));
+	ANKI_CHECK(file.write(&m_channels[0], m_channels.getSizeInBytes()));
+	ANKI_CHECK(file.write(&m_positionTimes[0], m_positionTimes.getSizeInBytes()));
+	if(m_positions.getSize())
+	{
+		ANKI_CHECK(file.write(&m_positions[0], m_positions.getSizeInBytes()));
+	}
+	if(m_rawPositions.getSize())
+	{
+		ANKI_CHECK(file.write(&m_rawPositions[0], m_rawPositions.getSizeInBytes()));
+	}
+	ANKI_CHECK(file.write(&m_rotationTimes[0], m_rotationTimes.getSizeInBytes()));
+	ANKI_CHECK(file.write(&m_rotations[0], m_rotations.getSizeInBytes()));
+	ANKI_CHECK(file.write(&m_scaleTimes[0], m_scaleTimes.getSizeInBytes()));
+	ANKI_CHECK(file.write(&m_scales[0], m_scales.getSizeInBytes()));
+
+	return Error::NONE;
+}
+
+F32 AnimationClip::adjustTime(Second time) const
+{
+	if(time > m_startTime + m_duration)
+	{
+		time = (m_duration > 0.0) ? mod(time - m_startTime, m_duration) + m_startTime : m_startTime;
+	}
+
+	return F32(max(time, m_startTime));
+}
+
+void AnimationClip::sample(U32 channelIdx, Second time, Vec3& position, Quat& rotation, F32& scale) const
+{
+	const F32 t = adjustTime(time);
+	const AnimationBinaryFile::Channel& ch = m_channels[channelIdx];
+	U32 leftKey, rightKey;
+	F32 factor;
+
+	// Position. The quantization is linear so interpolate the quantized values
+	findKey(&m_positionTimes[ch.m_firstPositionKey], ch.m_positionKeyCount, t, leftKey, rightKey, factor);
+	const Vec3 left = getPositionValue(ch, leftKey);
+	const Vec3 right = getPositionValue(ch, rightKey);
+	position = ch.m_positionMin + linearInterpolate(left, right, factor) * ch.m_positionScale;
+
+	// Rotation. The normalization removes the scale of the quantization
+	findKey(&m_rotationTimes[ch.m_firstRotationKey], ch.m_rotationKeyCount, t, leftKey, rightKey, factor);
+	const AnimationBinaryFile::QuantizedRotation& rl = m_rotations[ch.m_firstRotationKey + leftKey];
+	const AnimationBinaryFile::QuantizedRotation& rr = m_rotations[ch.m_firstRotationKey + rightKey];
+	const Vec4 rotLeft = Vec4(F32(rl[0]), F32(rl[1]), F32(rl[2]), F32(rl[3]));
+	const Vec4 rotRight = Vec4(F32(rr[0]), F32(rr[1]), F32(rr[2]), F32(rr[3]));
+	rotation = Quat(nlerp(rotLeft, rotRight, factor));
+
+	// Scale
+	findKey(&m_scaleTimes[ch.m_firstScaleKey], ch.m_scaleKeyCount, t, leftKey, rightKey, factor);
+	scale = linearInterpolate(m_scales[ch.m_firstScaleKey + leftKey], m_scales[ch.m_firstScaleKey + rightKey], factor);
+}
+
+void AnimationClip::sampleAll(Second time,
+	AnimationCursor& cursor,
+	WeakArray<Vec3> positions,
+	WeakArray<Quat> rotations,
+	WeakArray<F32> scales) const
+{
+	const U32 channelCount = getChannelCount();
+	ANKI_ASSERT(cursor.m_keys.getSize() == channelCount);
+	ANKI_ASSERT(positions.getSize() >= channelCount && rotations.getSize() >= channelCount);
+	ANKI_ASSERT(scales.getSize() >= channelCount);
+
+	const F32 t = adjustTime(time);
+	if(t < cursor.m_time)
+	{
+		cursor.reset();
+	}
+	cursor.m_time = t;
+
+	for(U32 base = 0; base < channelCount; base += 4)
+	{
+		const U32 laneCount = min(4u, channelCount - base);
+		AnimationSampleBatch batch;
+
+		// Gather. The lanes after the last channel repeat it
+		for(U32 lane = 0; lane < 4; ++lane)
+		{
+			const U32 channelIdx = base + min(lane, laneCount - 1);
+			const AnimationBinaryFile::Channel& ch = m_channels[channelIdx];
+			Array<U16, 3>& keys = cursor.m_keys[channelIdx];
+			U32 right;
+
+			const F32* times = &m_positionTimes[ch.m_firstPositionKey];
+			advanceKey(times, ch.m_positionKeyCount, t, keys[0], right);
+			batch.m_leftTimes[0][lane] = times[keys[0]];
+			batch.m_rightTimes[0][lane] = times[right];
+			const Vec3 pl = getPositionValue(ch, keys[0]);
+			const Vec3 pr = getPositionValue(ch, right);
+			for(U32 c = 0; c < 3; ++c)
+			{
+				batch.m_positionLeft[c][lane] = pl[c];
+				batch.m_positionRight[c][lane] = pr[c];
+				batch.m_positionMin[c][lane] = ch.m_positionMin[c];
+				batch.m_positionScale[c][lane] = ch.m_positionScale[c];
+			}
+
+			times = &m_rotationTimes[ch.m_firstRotationKey];
+			advanceKey(times, ch.m_rotationKeyCount, t, keys[1], right);
+			batch.m_leftTimes[1][lane] = times[keys[1]];
+			batch.m_rightTimes[1][lane] = times[right];
+			const AnimationBinaryFile::QuantizedRotation& rl = m_rotations[ch.m_firstRotationKey + keys[1]];
+			const AnimationBinaryFile::QuantizedRotation& rr = m_rotations[ch.m_firstRotationKey + right];
+			for(U32 c = 0; c < 4; ++c)
+			{
+				batch.m_rotationLeft[c][lane] = rl[c];
+				batch.m_rotationRight[c][lane] = rr[c];
+			}
+
+			times = &m_scaleTimes[ch.m_firstScaleKey];
+			advanceKey(times, ch.m_scaleKeyCount, t, keys[2], right);
+			batch.m_leftTimes[2][lane] = times[keys[2]];
+			batch.m_rightTimes[2][lane] = times[right];
+			batch.m_scaleLeft[lane] = m_scales[ch.m_firstScaleKey + keys[2]];
+			batch.m_scaleRight[lane] = m_scales[ch.m_firstScaleKey + right];
+		}
+
+		// Interpolate
+#if ANKI_SIMD == ANKI_SIMD_SSE
+		// The factors of the tracks with one key are zero
+		const __m128 time = _mm_set1_ps(t);
+		Array<__m128, 3> factors;
+		for(U32 i = 0; i < 3; ++i)
+		{
+			const __m128 left = _mm_load_ps(&batch.m_leftTimes[i][0]);
+			const __m128 range = _mm_sub_ps(_mm_load_ps(&batch.m_rightTimes[i][0]), left);
+			__m128 factor = _mm_div_ps(_mm_sub_ps(time, left), range);
+			factor = _mm_min_ps(_mm_max_ps(factor, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+			factors[i] = _mm_and_ps(factor, _mm_cmpgt_ps(range, _mm_setzero_ps()));
+		}
+
+		for(U32 c = 0; c < 3; ++c)
+		{
+			const __m128 left = _mm_load_ps(&batch.m_positionLeft[c][0]);
+			const __m128 right = _mm_load_ps(&batch.m_positionRight[c][0]);
+			__m128 q = _mm_add_ps(left, _mm_mul_ps(_mm_sub_ps(right, left), factors[0]));
+			q = _mm_mul_ps(q, _mm_load_ps(&batch.m_positionScale[c][0]));
+			q = _mm_add_ps(q, _mm_load_ps(&batch.m_positionMin[c][0]));
+			_mm_store_ps(&batch.m_positionLeft[c][0], q);
+		}
+
+		Array<__m128, 4> rot;
+		__m128 lengthSquared = _mm_setzero_ps();
+		for(U32 c = 0; c < 4; ++c)
+		{
+			const __m128 left = _mm_load_ps(&batch.m_rotationLeft[c][0]);
+			const __m128 right = _mm_load_ps(&batch.m_rotationRight[c][0]);
+			rot[c] = _mm_add_ps(left, _mm_mul_ps(_mm_sub_ps(right, left), factors[1]));
+			lengthSquared = _mm_add_ps(lengthSquared, _mm_mul_ps(rot[c], rot[c]));
+		}
+
+		const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared));
+		for(U32 c = 0; c < 4; ++c)
+		{
+			_mm_store_ps(&batch.m_rotationLeft[c][0], _mm_mul_ps(rot[c], invLength));
+		}
+
+		const __m128 scaleLeft = _mm_load_ps(&batch.m_scaleLeft[0]);
+		const __m128 scaleRight = _mm_load_ps(&batch.m_scaleRight[0]);
+		const __m128 scale = _mm_add_ps(scaleLeft, _mm_mul_ps(_mm_sub_ps(scaleRight, scaleLeft), factors[2]));
+		_mm_store_ps(&batch.m_scaleLeft[0], scale);
+#else
+		for(U32 lane = 0; lane < 4; ++lane)
+		{
+			// The factors of the tracks with one key are zero
+			Array<F32, 3> factors;
+			for(U32 i = 0; i < 3; ++i)
+			{
+				const F32 left = batch.m_leftTimes[i][lane];
+				const F32 range = batch.m_rightTimes[i][lane] - left;
+				factors[i] = (range > 0.0f) ? clamp((t - left) / range, 0.0f, 1.0f) : 0.0f;
+			}
+
+			for(U32 c = 0; c < 3; ++c)
+			{
+				const F32 q =
+					linearInterpolate(batch.m_positionLeft[c][lane], batch.m_positionRight[c][lane], factors[0]);
+				batch.m_positionLeft[c][lane] = batch.m_positionMin[c][lane] + q * batch.m_positionScale[c][lane];
+			}
+
+			F32 lengthSquared = 0.0f;
+			for(U32 c = 0; c < 4; ++c)
+			{
+				const F32 r =
+					linearInterpolate(batch.m_rotationLeft[c][lane], batch.m_rotationRight[c][lane], factors[1]);
+				batch.m_rotationLeft[c][lane] = r;
+				lengthSquared += r * r;
+			}
+
+			const F32 invLength = 1.0f / sqrt(lengthSquared);
+			for(U32 c = 0; c < 4; ++c)
+			{
+				batch.m_rotationLeft[c][lane] *= invLength;
+			}
+
+			batch.m_scaleLeft[lane] = linearInterpolate(batch.m_scaleLeft[lane], batch.m_scaleRight[lane], factors[2]);
+		}
+#endif
+
+		// Scatter
+		for(U32 lane = 0; lane < laneCount; ++lane)
+		{
+			positions[base + lane] =
+				Vec3(batch.m_positionLeft[0][lane], batch.m_positionLeft[1][lane], batch.m_positionLeft[2][lane]);
+			rotations[base + lane] = Quat(batch.m_rotationLeft[0][lane],
+				batch.m_rotationLeft[1][lane],
+				batch.m_rotationLeft[2][lane],
+				batch.m_rotationLeft[3][lane]);
+			scales[base + lane] = batch.m_scaleLeft[lane];
+		}
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,277 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/Math.h>
+#include <anki/util/String.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+// Forward
+class ResourceFile;
+class File;
+class AnimationClip;
+
+/// @addtogroup resource
+/// @{
+
+/// A keyframe
+template<typename T>
+class AnimationKeyframe
+{
+	friend class AnimationResource;
+
+public:
+	AnimationKeyframe() = default;
+
+	AnimationKeyframe(Second time, const T& value)
+		: m_time(time)
+		, m_value(value)
+	{
+	}
+
+	Second getTime() const
+	{
+		return m_time;
+	}
+
+	const T& getValue() const
+	{
+		return m_value;
+	}
+
+private:
+	Second m_time;
+	T m_value;
+};
+
+/// Animation channel. It's the uncompressed form of the channel that the exporters and the XML loader produce.
+class AnimationChannel
+{
+public:
+	String m_name;
+
+	I32 m_boneIndex = -1; ///< For skeletal animations
+
+	DynamicArray<AnimationKeyframe<Vec3>> m_positions;
+	DynamicArray<AnimationKeyframe<Quat>> m_rotations;
+	DynamicArray<AnimationKeyframe<F32>> m_scales;
+	DynamicArray<AnimationKeyframe<F32>> m_cameraFovs;
+
+	void destroy(ResourceAllocator<U8> alloc)
+	{
+		m_name.destroy(alloc);
+		m_positions.destroy(alloc);
+		m_rotations.destroy(alloc);
+		m_scales.destroy(alloc);
+		m_cameraFovs.destroy(alloc);
+	}
+};
+
+/// Information to decode animation binary files. The file is the header, the channels, the position key times, the
+/// quantized and the raw position key values and then the key times and the key values of the rotations and the scales.
+class AnimationBinaryFile
+{
+public:
+	static constexpr const char* MAGIC = "ANKIANI2";
+
+	static const U32 MAX_CHANNEL_NAME_LENGTH = 63;
+
+	/// The max number of keys of a single track.
+	static const U32 MAX_TRACK_KEY_COUNT = MAX_U16;
+
+	/// A position quantized in the bounding box of the positions of its channel.
+	using QuantizedPosition = Array<U16, 3>;
+
+	/// A rotation with its components in [-1, 1] stored as SNORM.
+	using QuantizedRotation = Array<I16, 4>;
+
+	struct Channel
+	{
+		Array<char, MAX_CHANNEL_NAME_LENGTH + 1> m_name;
+
+		/// The keys of the tracks. Every track has at least one key.
+		U32 m_firstPositionKey;
+		U32 m_positionKeyCount;
+		U32 m_firstRotationKey;
+		U32 m_rotationKeyCount;
+		U32 m_firstScaleKey;
+		U32 m_scaleKeyCount;
+
+		/// The position values are in the raw positions if it's 1 and in the quantized ones if it's 0.
+		U32 m_rawPositions;
+		U32 m_firstPositionValue; ///< The first of the m_positionKeyCount position values.
+
+		Vec3 m_positionMin; ///< Position = m_positionMin + value * m_positionScale.
+		Vec3 m_positionScale;
+	};
+
+	struct Header
+	{
+		char m_magic[8]; ///< Magic word.
+		U32 m_channelCount;
+		U32 m_positionKeyCount;
+		U32 m_quantizedPositionCount;
+		U32 m_rawPositionCount;
+		U32 m_rotationKeyCount;
+		U32 m_scaleKeyCount;
+		F32 m_startTime;
+		F32 m_duration;
+	};
+};
+
+/// The keys an AnimationClip sampled last for every track of some instance of the clip. Sampling with the cursor
+/// continues from those keys so playing a clip forward costs O(1) per frame instead of a search.
+class AnimationCursor
+{
+	friend class AnimationClip;
+
+public:
+	template<typename TAllocator>
+	void create(TAllocator alloc, const AnimationClip& clip);
+
+	template<typename TAllocator>
+	void destroy(TAllocator alloc)
+	{
+		m_keys.destroy(alloc);
+	}
+
+	/// Start from the first keys again.
+	void reset()
+	{
+		for(Array<U16, 3>& keys : m_keys)
+		{
+			keys = {{0, 0, 0}};
+		}
+		m_time = MIN_F32;
+	}
+
+private:
+	DynamicArray<Array<U16, 3>> m_keys; ///< The position, rotation and scale key of every channel.
+	F32 m_time = MIN_F32; ///< The time of the last sampling.
+};
+
+/// A compressed animation. The key values are quantized, the keys that the interpolation of their neighbours can
+/// reproduce are removed and the times and values of each kind of track are stored in separate arrays. Positions and
+/// scales are interpolated linearly and rotations with nlerp.
+///
+/// The positions of a channel are quantized in their bounding box and the quantization error counts towards the
+/// position tolerance. The channels that move so far that the quantization error would be more than half of the
+/// tolerance (about 6.5 units with the default tolerance) keep F32 positions.
+class AnimationClip : public NonCopyable
+{
+public:
+	/// The default max errors of compress(). The rotation error is the distance of the unit quaternions.
+	static constexpr F32 DEFAULT_POSITION_TOLERANCE = 0.0001f;
+	static constexpr F32 DEFAULT_ROTATION_TOLERANCE = 0.0005f;
+	static constexpr F32 DEFAULT_SCALE_TOLERANCE = 0.0001f;
+
+	AnimationClip(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~AnimationClip();
+
+	/// Create the clip from uncompressed channels. The missing tracks become identity.
+	ANKI_USE_RESULT Error compress(ConstWeakArray<AnimationChannel> channels,
+		F32 positionTolerance = DEFAULT_POSITION_TOLERANCE,
+		F32 rotationTolerance = DEFAULT_ROTATION_TOLERANCE,
+		F32 scaleTolerance = DEFAULT_SCALE_TOLERANCE);
+
+	/// Load the clip from a file in the AnimationBinaryFile format.
+	ANKI_USE_RESULT Error load(ResourceFile& file);
+
+	/// Write the clip to a file in the AnimationBinaryFile format.
+	ANKI_USE_RESULT Error save(File& file) const;
+
+	U32 getChannelCount() const
+	{
+		return U32(m_channels.getSize());
+	}
+
+	CString getChannelName(U32 channelIdx) const
+	{
+		return &m_channels[channelIdx].m_name[0];
+	}
+
+	Second getStartingTime() const
+	{
+		return m_startTime;
+	}
+
+	Second getDuration() const
+	{
+		return m_duration;
+	}
+
+	/// The number of position, rotation and scale keys of all the channels.
+	U32 getKeyCount() const
+	{
+		return U32(m_positionTimes.getSize() + m_rotationTimes.getSize() + m_scaleTimes.getSize());
+	}
+
+	/// Sample a single channel. It searches the keys.
+	void sample(U32 channelIdx, Second time, Vec3& position, Quat& rotation, F32& scale) const;
+
+	/// Sample all the channels. It continues from the keys of the cursor and resets it when the time goes back. The
+	/// channels are interpolated 4 at a time.
+	void sampleAll(Second time,
+		AnimationCursor& cursor,
+		WeakArray<Vec3> positions,
+		WeakArray<Quat> rotations,
+		WeakArray<F32> scales) const;
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+
+	DynamicArray<AnimationBinaryFile::Channel> m_channels;
+
+	DynamicArray<F32> m_positionTimes;
+	DynamicArray<AnimationBinaryFile::QuantizedPosition> m_positions;
+	DynamicArray<Vec3> m_rawPositions;
+	DynamicArray<F32> m_rotationTimes;
+	DynamicArray<AnimationBinaryFile::QuantizedRotation> m_rotations;
+	DynamicArray<F32> m_scaleTimes;
+	DynamicArray<F32> m_scales;
+
+	Second m_startTime = 0.0;
+	Second m_duration = 0.0;
+
+	void destroy();
+
+	/// Wrap the time inside the clip.
+	F32 adjustTime(Second time) const;
+
+	/// Get a position value before m_positionMin and m_positionScale are applied.
+	Vec3 getPositionValue(const AnimationBinaryFile::Channel& ch, U32 key) const
+	{
+		const U32 idx = ch.m_firstPositionValue + key;
+		if(ch.m_rawPositions)
+		{
+			return m_rawPositions[idx];
+		}
+
+		const AnimationBinaryFile::QuantizedPosition& q = m_positions[idx];
+		return Vec3(F32(q[0]), F32(q[1]), F32(q[2]));
+	}
+
+	ANKI_USE_RESULT Error checkHeader(const AnimationBinaryFile::Header& header) const;
+};
+
+template<typename TAllocator>
+inline void AnimationCursor::create(TAllocator alloc, const AnimationClip& clip)
+{
+	m_keys.create(alloc, clip.getChannelCount());
+	reset();
+}
+/// @}
+
+} // end namespace anki
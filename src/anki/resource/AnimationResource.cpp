@@ -4,207 +4,114 @@
 // http://www.anki3d.org/LICENSE
 
 #include <anki/resource/AnimationResource.h>
+#include <anki/resource/ResourceFilesystem.h>
 #include <anki/misc/Xml.h>
 
 namespace anki
 {
 
-AnimationResource::AnimationResource(ResourceManager* manager)
-	: ResourceObject(manager)
+/// Parse the keys of an XML track.
+/// @param readValue A functor with signature Error(const XmlElement& valueEl, T& value).
+template<typename T, typename TReadValueFunc>
+static ANKI_USE_RESULT Error parseXmlKeys(const XmlElement& keysEl,
+	ResourceAllocator<U8> alloc,
+	TReadValueFunc readValue,
+	DynamicArray<AnimationKeyframe<T>>& keys)
 {
-}
+	XmlElement keyEl, el;
+	ANKI_CHECK(keysEl.getChildElement("key", keyEl));
 
-AnimationResource::~AnimationResource()
-{
-	for(AnimationChannel& ch : m_channels)
+	U32 count = 0;
+	ANKI_CHECK(keyEl.getSiblingElementsCount(count));
+	++count;
+	keys.create(alloc, count);
+
+	count = 0;
+	do
 	{
-		ch.destroy(getAllocator());
-	}
+		// <time>
+		Second time;
+		ANKI_CHECK(keyEl.getChildElement("time", el));
+		ANKI_CHECK(el.getNumber(time));
 
-	m_channels.destroy(getAllocator());
-}
+		// <value>
+		T value;
+		ANKI_CHECK(keyEl.getChildElement("value", el));
+		ANKI_CHECK(readValue(el, value));
 
-Error AnimationResource::load(const ResourceFilename& filename, Bool async)
-{
-	XmlElement el;
-	I64 tmp;
-	Second ftmp;
+		keys[count++] = AnimationKeyframe<T>(time, value);
 
-	m_startTime = MAX_SECOND;
-	Second maxTime = MIN_SECOND;
+		// Move to next
+		ANKI_CHECK(keyEl.getNextSiblingElement("key", keyEl));
+	} while(keyEl);
 
-	// Document
-	XmlDocument doc;
-	ANKI_CHECK(openFileParseXml(filename, doc));
-	XmlElement rootel;
-	ANKI_CHECK(doc.getChildElement("animation", rootel));
+	return Error::NONE;
+}
 
-	// Count the number of identity keys. If all of the keys are identities drop a vector
-	U identPosCount = 0;
-	U identRotCount = 0;
-	U identScaleCount = 0;
+/// Parse the channels of an XML animation.
+static ANKI_USE_RESULT Error parseXmlChannels(
+	const XmlElement& rootEl, ResourceAllocator<U8> alloc, DynamicArrayAuto<AnimationChannel>& channels)
+{
+	XmlElement el;
 
 	// <channels>
 	XmlElement channelsEl;
-	ANKI_CHECK(rootel.getChildElement("channels", channelsEl));
+	ANKI_CHECK(rootEl.getChildElement("channels", channelsEl));
 	XmlElement chEl;
 	ANKI_CHECK(channelsEl.getChildElement("channel", chEl));
 
 	U32 channelCount = 0;
 	ANKI_CHECK(chEl.getSiblingElementsCount(channelCount));
 	++channelCount;
-	if(channelCount == 0)
-	{
-		ANKI_RESOURCE_LOGE("Didn't found any channels");
-		return Error::USER_DATA;
-	}
-	m_channels.create(getAllocator(), channelCount);
+	channels.create(channelCount);
 
 	// For all channels
 	channelCount = 0;
 	do
 	{
-		AnimationChannel& ch = m_channels[channelCount];
+		AnimationChannel& ch = channels[channelCount];
 
 		// <name>
 		ANKI_CHECK(chEl.getChildElement("name", el));
 		CString strtmp;
 		ANKI_CHECK(el.getText(strtmp));
-		ch.m_name.create(getAllocator(), strtmp);
+		ch.m_name.create(alloc, strtmp);
 
-		XmlElement keysEl, keyEl;
+		XmlElement keysEl;
 
 		// <positionKeys>
 		ANKI_CHECK(chEl.getChildElementOptional("positionKeys", keysEl));
 		if(keysEl)
 		{
-			ANKI_CHECK(keysEl.getChildElement("key", keyEl));
-
-			U32 count = 0;
-			ANKI_CHECK(keyEl.getSiblingElementsCount(count));
-			++count;
-			ch.m_positions.create(getAllocator(), count);
-
-			count = 0;
-			do
-			{
-				AnimationKeyframe<Vec3>& key = ch.m_positions[count++];
-
-				// <time>
-				ANKI_CHECK(keyEl.getChildElement("time", el));
-				ANKI_CHECK(el.getNumber(ftmp));
-				key.m_time = ftmp;
-				m_startTime = std::min(m_startTime, key.m_time);
-				maxTime = std::max(maxTime, key.m_time);
-
-				// <value>
-				ANKI_CHECK(keyEl.getChildElement("value", el));
-				ANKI_CHECK(el.getVec3(key.m_value));
-
-				// Check ident
-				if(key.m_value == Vec3(0.0))
-				{
-					++identPosCount;
-				}
-
-				// Move to next
-				ANKI_CHECK(keyEl.getNextSiblingElement("key", keyEl));
-			} while(keyEl);
+			ANKI_CHECK(parseXmlKeys<Vec3>(keysEl,
+				alloc,
+				[](const XmlElement& valueEl, Vec3& value) -> Error { return valueEl.getVec3(value); },
+				ch.m_positions));
 		}
 
 		// <rotationKeys>
-		ANKI_CHECK(chEl.getChildElement("rotationKeys", keysEl));
+		ANKI_CHECK(chEl.getChildElementOptional("rotationKeys", keysEl));
 		if(keysEl)
 		{
-			ANKI_CHECK(keysEl.getChildElement("key", keyEl));
-
-			U32 count = 0;
-			ANKI_CHECK(keyEl.getSiblingElementsCount(count));
-			++count;
-			ch.m_rotations.create(getAllocator(), count);
-
-			count = 0;
-			do
-			{
-				AnimationKeyframe<Quat>& key = ch.m_rotations[count++];
-
-				// <time>
-				ANKI_CHECK(keyEl.getChildElement("time", el));
-				ANKI_CHECK(el.getNumber(ftmp));
-				key.m_time = ftmp;
-				m_startTime = std::min(m_startTime, key.m_time);
-				maxTime = std::max(maxTime, key.m_time);
-
-				// <value>
-				Vec4 tmp2;
-				ANKI_CHECK(keyEl.getChildElement("value", el));
-				ANKI_CHECK(el.getVec4(tmp2));
-				key.m_value = Quat(tmp2);
-
-				// Check ident
-				if(key.m_value == Quat::getIdentity())
-				{
-					++identRotCount;
-				}
-
-				// Move to next
-				ANKI_CHECK(keyEl.getNextSiblingElement("key", keyEl));
-			} while(keyEl);
+			ANKI_CHECK(parseXmlKeys<Quat>(keysEl,
+				alloc,
+				[](const XmlElement& valueEl, Quat& value) -> Error {
+					Vec4 tmp;
+					ANKI_CHECK(valueEl.getVec4(tmp));
+					value = Quat(tmp);
+					return Error::NONE;
+				},
+				ch.m_rotations));
 		}
 
 		// <scalingKeys>
 		ANKI_CHECK(chEl.getChildElementOptional("scalingKeys", keysEl));
 		if(keysEl)
 		{
-			ANKI_CHECK(keysEl.getChildElement("key", keyEl));
-
-			U32 count = 0;
-			ANKI_CHECK(keyEl.getSiblingElementsCount(count));
-			++count;
-			ch.m_scales.create(getAllocator(), count);
-
-			count = 0;
-			do
-			{
-				AnimationKeyframe<F32>& key = ch.m_scales[count++];
-
-				// <time>
-				ANKI_CHECK(keyEl.getChildElement("time", el));
-				ANKI_CHECK(el.getNumber(ftmp));
-				key.m_time = ftmp;
-				m_startTime = std::min(m_startTime, key.m_time);
-				maxTime = std::max(maxTime, key.m_time);
-
-				// <value>
-				ANKI_CHECK(keyEl.getChildElement("value", el));
-				ANKI_CHECK(el.getNumber(ftmp));
-				key.m_value = ftmp;
-
-				// Check ident
-				if(isZero(key.m_value - 1.0))
-				{
-					++identScaleCount;
-				}
-
-				// Move to next
-				ANKI_CHECK(keyEl.getNextSiblingElement("key", keyEl));
-			} while(keyEl);
-		}
-
-		// Remove identity vectors
-		if(identPosCount == ch.m_positions.getSize())
-		{
-			ch.m_positions.destroy(getAllocator());
-		}
-
-		if(identRotCount == ch.m_rotations.getSize())
-		{
-			ch.m_rotations.destroy(getAllocator());
-		}
-
-		if(identScaleCount == ch.m_scales.getSize())
-		{
-			ch.m_scales.destroy(getAllocator());
+			ANKI_CHECK(parseXmlKeys<F32>(keysEl,
+				alloc,
+				[](const XmlElement& valueEl, F32& value) -> Error { return valueEl.getNumber(value); },
+				ch.m_scales));
 		}
 
 		// Move to next channel
@@ -212,55 +119,60 @@ Error AnimationResource::load(const ResourceFilename& filename, Bool async)
 		ANKI_CHECK(chEl.getNextSiblingElement("channel", chEl));
 	} while(chEl);
 
-	m_duration = maxTime - m_startTime;
-
 	return Error::NONE;
 }
 
-void AnimationResource::interpolate(U channelIndex, Second time, Vec3& pos, Quat& rot, F32& scale) const
+AnimationResource::AnimationResource(ResourceManager* manager)
+	: ResourceObject(manager)
+	, m_clip(getAllocator())
 {
-	// Audjust time
-	if(time > m_startTime + m_duration)
-	{
-		time = mod(time - m_startTime, m_duration) + m_startTime;
-	}
+}
 
-	ANKI_ASSERT(time >= m_startTime && time <= m_startTime + m_duration);
-	ANKI_ASSERT(channelIndex < m_channels.getSize());
+AnimationResource::~AnimationResource()
+{
+}
 
-	const AnimationChannel& channel = m_channels[channelIndex];
+Error AnimationResource::load(const ResourceFilename& filename, Bool async)
+{
+	// Check the magic to find the format
+	ResourceFilePtr file;
+	ANKI_CHECK(openFile(filename, file));
 
-	// Position
-	if(channel.m_positions.getSize() > 1)
+	Array<char, 8> magic;
+	if(file->getSize() >= sizeof(AnimationBinaryFile::Header))
 	{
-		for(U i = 0; i < channel.m_positions.getSize() - 1; ++i)
+		ANKI_CHECK(file->read(&magic[0], sizeof(magic)));
+		if(memcmp(&magic[0], AnimationBinaryFile::MAGIC, sizeof(magic)) == 0)
 		{
-			const AnimationKeyframe<Vec3>& left = channel.m_positions[i];
-			const AnimationKeyframe<Vec3>& right = channel.m_positions[i + 1];
-			if(time >= left.m_time && time <= right.m_time)
-			{
-				const Second u = (time - left.m_time) / (right.m_time - left.m_time);
-				pos = linearInterpolate(left.m_value, right.m_value, u);
-				break;
-			}
+			ANKI_CHECK(file->seek(0, ResourceFile::SeekOrigin::BEGINNING));
+			return m_clip.load(*file);
 		}
 	}
 
-	// Rotation
-	if(channel.m_rotations.getSize() > 1)
+	return loadXml(filename);
+}
+
+Error AnimationResource::loadXml(const ResourceFilename& filename)
+{
+	// Document
+	XmlDocument doc;
+	ANKI_CHECK(openFileParseXml(filename, doc));
+	XmlElement rootEl;
+	ANKI_CHECK(doc.getChildElement("animation", rootEl));
+
+	DynamicArrayAuto<AnimationChannel> channels(getAllocator());
+	Error err = parseXmlChannels(rootEl, getAllocator(), channels);
+	if(!err)
+	{
+		err = m_clip.compress(channels);
+	}
+
+	for(AnimationChannel& ch : channels)
 	{
-		for(U i = 0; i < channel.m_rotations.getSize() - 1; ++i)
-		{
-			const AnimationKeyframe<Quat>& left = channel.m_rotations[i];
-			const AnimationKeyframe<Quat>& right = channel.m_rotations[i + 1];
-			if(time >= left.m_time && time <= right.m_time)
-			{
-				const Second u = (time - left.m_time) / (right.m_time - left.m_time);
-				rot = left.m_value.slerp(right.m_value, u);
-				break;
-			}
-		}
+		ch.destroy(getAllocator());
 	}
+
+	return err;
 }
 
 } // end namespace anki
@@ -6,12 +6,12 @@
 #include <anki/resource/AsyncLoader.h>
 #include <anki/util/Logger.h>
 #include <anki/core/Trace.h>
+#include <anki/util/HighRezTimer.h>
 
 namespace anki
 {
 
 AsyncLoader::AsyncLoader()
-	: m_thread("anki_asyload")
 {
 }
 
@@ -19,54 +19,76 @@ AsyncLoader::~AsyncLoader()
 {
 	stop();
 
-	if(!m_taskQueue.isEmpty())
+	if(m_pendingTaskCount > 0)
 	{
 		ANKI_RESOURCE_LOGW("Stoping loading thread while there is work to do");
 
-		while(!m_taskQueue.isEmpty())
+		for(IntrusiveList<AsyncLoaderTask>& queue : m_taskQueues)
 		{
-			AsyncLoaderTask* task = &m_taskQueue.getFront();
-			m_taskQueue.popFront();
-			m_alloc.deleteInstance(task);
+			while(!queue.isEmpty())
+			{
+				AsyncLoaderTask* task = &queue.getFront();
+				queue.popFront();
+				m_alloc.deleteInstance(task);
+			}
 		}
 	}
 }
 
-void AsyncLoader::init(const HeapAllocator<U8>& alloc)
+void AsyncLoader::init(const HeapAllocator<U8>& alloc, U32 threadCount)
 {
+	ANKI_ASSERT(threadCount > 0);
 	m_alloc = alloc;
-	m_thread.start(this, threadCallback);
+	m_threadCount = threadCount;
+
+	m_threads = reinterpret_cast<Thread*>(m_alloc.allocate(sizeof(Thread) * threadCount));
+	for(U32 i = 0; i < threadCount; ++i)
+	{
+		::new(&m_threads[i]) Thread("anki_asyload");
+		m_threads[i].start(this, threadCallback);
+	}
 }
 
 void AsyncLoader::stop()
 {
+	if(m_threads == nullptr)
+	{
+		return;
+	}
+
 	{
 		LockGuard<Mutex> lock(m_mtx);
 		m_quit = true;
-		m_condVar.notifyOne();
+		m_condVar.notifyAll();
+	}
+
+	for(U32 i = 0; i < m_threadCount; ++i)
+	{
+		Error err = m_threads[i].join();
+		(void)err;
+		m_threads[i].~Thread();
 	}
 
-	Error err = m_thread.join();
-	(void)err;
+	m_alloc.deallocate(m_threads, sizeof(Thread) * m_threadCount);
+	m_threads = nullptr;
 }
 
 void AsyncLoader::pause()
 {
+	LockGuard<Mutex> lock(m_mtx);
+	m_paused = true;
+
+	while(m_runningTaskCount > 0)
 	{
-		LockGuard<Mutex> lock(m_mtx);
-		m_paused = true;
-		m_sync = true;
-		m_condVar.notifyOne();
+		m_idleCondVar.wait(m_mtx);
 	}
-
-	m_barrier.wait();
 }
 
 void AsyncLoader::resume()
 {
 	LockGuard<Mutex> lock(m_mtx);
 	m_paused = false;
-	m_condVar.notifyOne();
+	m_condVar.notifyAll();
 }
 
 Error AsyncLoader::threadCallback(ThreadCallbackInfo& info)
@@ -75,6 +97,25 @@ Error AsyncLoader::threadCallback(ThreadCallbackInfo& info)
 	return self.threadWorker();
 }
 
+AsyncLoaderTask* AsyncLoader::popTask()
+{
+	ANKI_ASSERT(m_pendingTaskCount > 0);
+
+	for(AsyncLoaderTaskPriority prio = AsyncLoaderTaskPriority::FIRST; prio < AsyncLoaderTaskPriority::COUNT; ++prio)
+	{
+		if(!m_taskQueues[prio].isEmpty())
+		{
+			AsyncLoaderTask* task = &m_taskQueues[prio].getFront();
+			m_taskQueues[prio].popFront();
+			--m_pendingTaskCount;
+			return task;
+		}
+	}
+
+	ANKI_ASSERT(0);
+	return nullptr;
+}
+
 Error AsyncLoader::threadWorker()
 {
 	Error err = Error::NONE;
@@ -82,96 +123,113 @@ Error AsyncLoader::threadWorker()
 	while(!err)
 	{
 		AsyncLoaderTask* task = nullptr;
-		Bool quit = false;
-		Bool sync = false;
 
 		{
 			// Wait for something
 			LockGuard<Mutex> lock(m_mtx);
-			while((m_taskQueue.isEmpty() || m_paused) && !m_quit && !m_sync)
+			while((m_pendingTaskCount == 0 || m_paused) && !m_quit)
 			{
 				m_condVar.wait(m_mtx);
 			}
 
-			// Do some work
 			if(m_quit)
 			{
-				quit = true;
-			}
-			else if(m_sync)
-			{
-				sync = true;
-				m_sync = false;
-			}
-			else
-			{
-				task = &m_taskQueue.getFront();
-				m_taskQueue.popFront();
+				break;
 			}
+
+			task = popTask();
+			++m_runningTaskCount;
 		}
 
-		if(quit)
+		// Exec the task
+		ANKI_ASSERT(task);
+		AsyncLoaderTaskContext ctx;
+		const AsyncLoaderTaskPriority prio = task->m_priority;
+		const Second startTime = HighRezTimer::getCurrentTime();
+
 		{
-			break;
+			ANKI_TRACE_SCOPED_EVENT(RSRC_ASYNC_TASK);
+			err = (*task)(ctx);
 		}
-		else if(sync)
+
+		const Second endTime = HighRezTimer::getCurrentTime();
+
+		if(!err)
 		{
-			m_barrier.wait();
+			m_completedTaskCount.fetchAdd(1);
 		}
 		else
 		{
-			// Exec the task
-			ANKI_ASSERT(task);
-			AsyncLoaderTaskContext ctx;
+			ANKI_RESOURCE_LOGE("Async loader task failed");
+		}
 
-			{
-				ANKI_TRACE_SCOPED_EVENT(RSRC_ASYNC_TASK);
-				err = (*task)(ctx);
-			}
+		// Delete the task before the loader becomes idle. Users that pause() expect the tasks to be gone
+		const Second waitTime = startTime - task->m_submitTime;
+		if(!ctx.m_resubmitTask)
+		{
+			m_alloc.deleteInstance(task);
+			task = nullptr;
+		}
 
-			if(!err)
-			{
-				m_completedTaskCount.fetchAdd(1);
-			}
-			else
-			{
-				ANKI_RESOURCE_LOGE("Async loader task failed");
-			}
+		// Do other stuff
+		LockGuard<Mutex> lock(m_mtx);
 
-			// Do other stuff
-			if(ctx.m_resubmitTask)
-			{
-				LockGuard<Mutex> lock(m_mtx);
-				m_taskQueue.pushBack(task);
-			}
-			else
-			{
-				// Delete the task
-				m_alloc.deleteInstance(task);
-			}
+		AsyncLoaderPriorityStats& stats = m_stats[prio];
+		stats.m_totalWaitTime += waitTime;
+		stats.m_totalExecutionTime += endTime - startTime;
+		if(!err)
+		{
+			++stats.m_completedCount;
+		}
+		else
+		{
+			++stats.m_failedCount;
+		}
 
-			if(ctx.m_pause)
-			{
-				LockGuard<Mutex> lock(m_mtx);
-				m_paused = true;
-			}
+		if(ctx.m_resubmitTask)
+		{
+			task->m_submitTime = endTime;
+			m_taskQueues[prio].pushBack(task);
+			++m_pendingTaskCount;
+		}
+
+		if(ctx.m_pause)
+		{
+			m_paused = true;
+		}
+
+		if(!m_paused && ctx.m_resubmitTask)
+		{
+			m_condVar.notifyOne();
+		}
+
+		ANKI_ASSERT(m_runningTaskCount > 0);
+		--m_runningTaskCount;
+		if(m_runningTaskCount == 0)
+		{
+			m_idleCondVar.notifyAll();
 		}
 	}
 
 	return err;
 }
 
-void AsyncLoader::submitTask(AsyncLoaderTask* task)
+void AsyncLoader::submitTask(AsyncLoaderTask* task, AsyncLoaderTaskPriority priority)
 {
 	ANKI_ASSERT(task);
+	ANKI_ASSERT(priority < AsyncLoaderTaskPriority::COUNT);
+	task->m_priority = priority;
+	task->m_submitTime = HighRezTimer::getCurrentTime();
 
 	// Append task to the list
 	LockGuard<Mutex> lock(m_mtx);
-	m_taskQueue.pushBack(task);
+	m_taskQueues[priority].pushBack(task);
+	++m_pendingTaskCount;
+	++m_stats[priority].m_submittedCount;
 
 	if(!m_paused)
 	{
-		// Wake up the thread if it's not paused
+		// Wake up a thread if it's not paused
 		m_condVar.notifyOne();
 	}
 }
@@ -18,6 +18,18 @@ class AsyncLoader;
 /// @addtogroup resource
 /// @{
 
+/// The priority of an AsyncLoaderTask. Tasks with higher priority are executed first.
+enum class AsyncLoaderTaskPriority : U8
+{
+	HIGH,
+	MEDIUM,
+	LOW,
+
+	COUNT,
+	FIRST = 0
+};
+ANKI_ENUM_ALLOW_NUMERIC_OPERATIONS(AsyncLoaderTaskPriority, inline)
+
 class AsyncLoaderTaskContext
 {
 public:
@@ -31,15 +43,39 @@ public:
 /// Interface for tasks for the AsyncLoader.
 class AsyncLoaderTask : public IntrusiveListEnabled<AsyncLoaderTask>
 {
+	friend class AsyncLoader;
+
 public:
 	virtual ~AsyncLoaderTask()
 	{
 	}
 
 	virtual ANKI_USE_RESULT Error operator()(AsyncLoaderTaskContext& ctx) = 0;
+
+	AsyncLoaderTaskPriority getPriority() const
+	{
+		return m_priority;
+	}
+
+private:
+	AsyncLoaderTaskPriority m_priority = AsyncLoaderTaskPriority::MEDIUM;
+	Second m_submitTime = 0.0;
 };
 
-/// Asynchronous resource loader.
+/// AsyncLoader statistics of a single priority.
+class AsyncLoaderPriorityStats
+{
+public:
+	U64 m_submittedCount = 0; ///< Resubmitted tasks are not counted.
+	U64 m_completedCount = 0;
+	U64 m_failedCount = 0;
+	U64 m_cancelledCount = 0;
+	Second m_totalWaitTime = 0.0; ///< Total time the tasks spent in the queue.
+	Second m_totalExecutionTime = 0.0;
+};
+
+/// Asynchronous resource loader. It has a number of worker threads that execute tasks in priority order. Tasks of the
+/// same priority are executed in submission order but with more than one thread they may overlap.
 class AsyncLoader
 {
 public:
@@ -47,10 +83,10 @@ public:
 
 	~AsyncLoader();
 
-	void init(const HeapAllocator<U8>& alloc);
+	void init(const HeapAllocator<U8>& alloc, U32 threadCount = 1);
 
 	/// Submit a task.
-	void submitTask(AsyncLoaderTask* task);
+	void submitTask(AsyncLoaderTask* task, AsyncLoaderTaskPriority priority = AsyncLoaderTaskPriority::MEDIUM);
 
 	/// Create a new asynchronous loading task.
 	template<typename TTask, typename... TArgs>
@@ -66,7 +102,19 @@ public:
 		submitTask(newTask<TTask>(std::forward<TArgs>(args)...));
 	}
 
-	/// Pause the loader. This method will block the main thread for the current async task to finish. The rest of the
+	/// Change the priority of the tasks that haven't started executing. Running tasks are not affected.
+	/// @param func A functor with signature: AsyncLoaderTaskPriority(const AsyncLoaderTask& task). It returns the new
+	///             priority of the task.
+	template<typename TFunc>
+	void reprioritizePendingTasks(TFunc func);
+
+	/// Cancel tasks that haven't started executing. The cancelled tasks are deleted. Running tasks are not affected.
+	/// @param func A functor with signature: Bool(const AsyncLoaderTask& task). Return true to cancel the task.
+	/// @return The number of cancelled tasks.
+	template<typename TFunc>
+	U32 cancelPendingTasks(TFunc func);
+
+	/// Pause the loader. This method will block the main thread for the current async tasks to finish. The rest of the
 	/// tasks in the queue will not be executed until resume is called.
 	void pause();
 
@@ -84,17 +132,34 @@ public:
 		return m_completedTaskCount.load();
 	}
 
+	/// Get the number of tasks that wait in the queue.
+	U32 getPendingTaskCount() const
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		return m_pendingTaskCount;
+	}
+
+	/// Get the stats of a priority.
+	AsyncLoaderPriorityStats getStats(AsyncLoaderTaskPriority priority) const
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		return m_stats[priority];
+	}
+
 private:
 	HeapAllocator<U8> m_alloc;
-	Thread m_thread;
-	Barrier m_barrier = {2};
-
-	Mutex m_mtx;
-	ConditionVariable m_condVar;
-	IntrusiveList<AsyncLoaderTask> m_taskQueue;
+	Thread* m_threads = nullptr;
+	U32 m_threadCount = 0;
+
+	mutable Mutex m_mtx;
+	ConditionVariable m_condVar; ///< Wakes up the workers.
+	ConditionVariable m_idleCondVar; ///< Signaled when there are no running tasks.
+	Array<IntrusiveList<AsyncLoaderTask>, U(AsyncLoaderTaskPriority::COUNT)> m_taskQueues;
+	Array<AsyncLoaderPriorityStats, U(AsyncLoaderTaskPriority::COUNT)> m_stats;
+	U32 m_pendingTaskCount = 0;
+	U32 m_runningTaskCount = 0;
 	Bool m_quit = false;
 	Bool m_paused = false;
-	Bool m_sync = false;
 
 	Atomic<U64> m_completedTaskCount = {0};
 
@@ -104,7 +169,76 @@ private:
 	Error threadWorker();
 
 	void stop();
+
+	/// Pop the task with the highest priority. Needs to be called with m_mtx locked.
+	AsyncLoaderTask* popTask();
 };
+
+template<typename TFunc>
+void AsyncLoader::reprioritizePendingTasks(TFunc func)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Move the tasks to temporary lists first so they won't be visited twice
+	Array<IntrusiveList<AsyncLoaderTask>, U(AsyncLoaderTaskPriority::COUNT)> moved;
+	for(AsyncLoaderTaskPriority prio = AsyncLoaderTaskPriority::FIRST; prio < AsyncLoaderTaskPriority::COUNT; ++prio)
+	{
+		auto it = m_taskQueues[prio].getBegin();
+		while(it != m_taskQueues[prio].getEnd())
+		{
+			AsyncLoaderTask& task = *it;
+			++it;
+
+			const AsyncLoaderTaskPriority newPrio = func(static_cast<const AsyncLoaderTask&>(task));
+			ANKI_ASSERT(newPrio < AsyncLoaderTaskPriority::COUNT);
+			if(newPrio != prio)
+			{
+				m_taskQueues[prio].erase(&task);
+				task.m_priority = newPrio;
+				moved[newPrio].pushBack(&task);
+			}
+		}
+	}
+
+	for(AsyncLoaderTaskPriority prio = AsyncLoaderTaskPriority::FIRST; prio < AsyncLoaderTaskPriority::COUNT; ++prio)
+	{
+		while(!moved[prio].isEmpty())
+		{
+			AsyncLoaderTask* task = &moved[prio].getFront();
+			moved[prio].popFront();
+			m_taskQueues[prio].pushBack(task);
+		}
+	}
+}
+
+template<typename TFunc>
+U32 AsyncLoader::cancelPendingTasks(TFunc func)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	U32 count = 0;
+	for(AsyncLoaderTaskPriority prio = AsyncLoaderTaskPriority::FIRST; prio < AsyncLoaderTaskPriority::COUNT; ++prio)
+	{
+		auto it = m_taskQueues[prio].getBegin();
+		while(it != m_taskQueues[prio].getEnd())
+		{
+			AsyncLoaderTask& task = *it;
+			++it;
+
+			if(func(static_cast<const AsyncLoaderTask&>(task)))
+			{
+				m_taskQueues[prio].erase(&task);
+				m_alloc.deleteInstance(&task);
+				++m_stats[prio].m_cancelledCount;
+				++count;
+			}
+		}
+	}
+
+	ANKI_ASSERT(m_pendingTaskCount >= count);
+	m_pendingTaskCount -= count;
+	return count;
+}
 /// @}
 
 } // end namespace anki
@@ -182,22 +182,7 @@ static ANKI_USE_RESULT Error loadTga(ResourceFilePtr fs,
 	return Error::NONE;
 }
 
-class AnkiTextureHeader
-{
-public:
-	Array<U8, 8> m_magic;
-	U32 m_width;
-	U32 m_height;
-	U32 m_depthOrLayerCount;
-	ImageLoader::TextureType m_type;
-	ImageLoader::ColorFormat m_colorFormat;
-	ImageLoader::DataCompression m_compressionFormats;
-	U32 m_normal;
-	U32 m_mipLevels;
-	U8 m_padding[88];
-};
-
-static_assert(sizeof(AnkiTextureHeader) == 128, "Check sizeof AnkiTextureHeader");
+using AnkiTextureHeader = AnkiTextureFile::Header;
 
 /// Get the size in bytes of a single surface
 static PtrSize calcSurfaceSize(
@@ -252,62 +237,85 @@ static PtrSize calcVolumeSize(const U width,
 	return out;
 }
 
+/// Get the size in bytes of all the faces or layers (or of the volume) of a mip of the file.
+static PtrSize calcMipSize(const AnkiTextureHeader& header, U mip, ImageLoader::DataCompression comp)
+{
+	const U width = header.m_width >> mip;
+	const U height = header.m_height >> mip;
+
+	switch(header.m_type)
+	{
+	case ImageLoader::TextureType::_2D:
+		return calcSurfaceSize(width, height, comp, header.m_colorFormat);
+	case ImageLoader::TextureType::CUBE:
+		return calcSurfaceSize(width, height, comp, header.m_colorFormat) * 6;
+	case ImageLoader::TextureType::_2D_ARRAY:
+		return calcSurfaceSize(width, height, comp, header.m_colorFormat) * header.m_depthOrLayerCount;
+	case ImageLoader::TextureType::_3D:
+		return calcVolumeSize(width, height, header.m_depthOrLayerCount >> mip, comp, header.m_colorFormat);
+	default:
+		ANKI_ASSERT(0);
+		return 0;
+	}
+}
+
 /// Calculate the size of a compressed or uncomressed color data
 static PtrSize calcSizeOfSegment(const AnkiTextureHeader& header, ImageLoader::DataCompression comp)
 {
+	ANKI_ASSERT(header.m_mipLevels > 0);
 	PtrSize out = 0;
-	U width = header.m_width;
-	U height = header.m_height;
-	U mips = header.m_mipLevels;
-	ANKI_ASSERT(mips > 0);
-
-	if(header.m_type != ImageLoader::TextureType::_3D)
+	for(U mip = 0; mip < header.m_mipLevels; ++mip)
 	{
-		U surfCountPerMip = 0;
+		out += calcMipSize(header, mip, comp);
+	}
 
-		switch(header.m_type)
-		{
-		case ImageLoader::TextureType::_2D:
-			surfCountPerMip = 1;
-			break;
-		case ImageLoader::TextureType::CUBE:
-			surfCountPerMip = 6;
-			break;
-		case ImageLoader::TextureType::_2D_ARRAY:
-			surfCountPerMip = header.m_depthOrLayerCount;
-			break;
-		default:
-			ANKI_ASSERT(0);
-			break;
-		}
+	return out;
+}
 
-		while(mips-- != 0)
-		{
-			out += calcSurfaceSize(width, height, comp, header.m_colorFormat) * surfCountPerMip;
+/// Get the biggest dimension of a mip of the file.
+static U getMipMaxSize(const AnkiTextureHeader& header, U mip)
+{
+	U size = max(header.m_width, header.m_height);
+	if(header.m_type == ImageLoader::TextureType::_3D)
+	{
+		size = max<U>(size, header.m_depthOrLayerCount);
+	}
 
-			width /= 2;
-			height /= 2;
-		}
+	return size >> mip;
+}
+
+/// Read all the faces or layers (or the volume) of a mip.
+static ANKI_USE_RESULT Error readMip(ResourceFilePtr& file,
+	U mip,
+	U surfCountPerMip,
+	ImageLoader::DataCompression comp,
+	ImageLoader::ColorFormat cf,
+	DynamicArray<ImageLoader::Surface>& surfaces,
+	DynamicArray<ImageLoader::Volume>& volumes,
+	GenericMemoryPoolAllocator<U8>& alloc)
+{
+	if(volumes.getSize() > 0)
+	{
+		ImageLoader::Volume& vol = volumes[mip];
+		vol.m_data.create(alloc, calcVolumeSize(vol.m_width, vol.m_height, vol.m_depth, comp, cf));
+		ANKI_CHECK(file->read(&vol.m_data[0], vol.m_data.getSize()));
 	}
 	else
 	{
-		U depth = header.m_depthOrLayerCount;
-
-		while(mips-- != 0)
+		for(U i = 0; i < surfCountPerMip; ++i)
 		{
-			out += calcVolumeSize(width, height, depth, comp, header.m_colorFormat);
-
-			width /= 2;
-			height /= 2;
-			depth /= 2;
+			ImageLoader::Surface& surf = surfaces[mip * surfCountPerMip + i];
+			surf.m_data.create(alloc, calcSurfaceSize(surf.m_width, surf.m_height, comp, cf));
+			ANKI_CHECK(file->read(&surf.m_data[0], surf.m_data.getSize()));
 		}
 	}
 
-	return out;
+	return Error::NONE;
 }
 
 static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 	U32 maxTextureSize,
+	U32 maxLoadedMipSize,
 	ImageLoader::DataCompression& preferredCompression,
 	DynamicArray<ImageLoader::Surface>& surfaces,
 	DynamicArray<ImageLoader::Volume>& volumes,
@@ -317,6 +325,7 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 	U32& depth,
 	U32& layerCount,
 	U8& toLoadMipCount,
+	U8& firstLoadedMip,
 	ImageLoader::TextureType& textureType,
 	ImageLoader::ColorFormat& colorFormat)
 {
@@ -326,7 +335,16 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 	AnkiTextureHeader header;
 	ANKI_CHECK(file->read(&header, sizeof(AnkiTextureHeader)));
 
-	if(std::memcmp(&header.m_magic[0], "ANKITEX1", 8) != 0)
+	Bool hasMipInfos;
+	if(std::memcmp(&header.m_magic[0], AnkiTextureFile::MAGIC, 8) == 0)
+	{
+		hasMipInfos = true;
+	}
+	else if(std::memcmp(&header.m_magic[0], AnkiTextureFile::MAGIC_V1, 8) == 0)
+	{
+		hasMipInfos = false;
+	}
+	else
 	{
 		ANKI_RESOURCE_LOGE("Wrong magic word");
 		return Error::USER_DATA;
@@ -377,40 +395,44 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 		return Error::USER_DATA;
 	}
 
-	width = header.m_width;
-	height = header.m_height;
-
 	// Check mip levels
 	U size = min(header.m_width, header.m_height);
-	U maxSize = max(header.m_width, header.m_height);
 	if(header.m_type == ImageLoader::TextureType::_3D)
 	{
-		maxSize = max<U>(maxSize, header.m_depthOrLayerCount);
 		size = min<U>(size, header.m_depthOrLayerCount);
 	}
-	toLoadMipCount = 0;
 	U tmpMipLevels = 0;
 	while(size >= 4) // The minimum size is 4x4
 	{
 		++tmpMipLevels;
-
-		if(maxSize <= maxTextureSize)
-		{
-			++toLoadMipCount;
-		}
-
 		size /= 2;
-		maxSize /= 2;
 	}
 
-	if(header.m_mipLevels > tmpMipLevels)
+	if(header.m_mipLevels == 0 || header.m_mipLevels > tmpMipLevels)
 	{
 		ANKI_RESOURCE_LOGE("Incorrect number of mip levels");
 		return Error::USER_DATA;
 	}
 
-	toLoadMipCount = min<U>(toLoadMipCount, header.m_mipLevels);
+	// Drop the mips that are bigger than the max texture size but keep at least one
+	U firstFileMip = 0;
+	while(firstFileMip + 1 < header.m_mipLevels && getMipMaxSize(header, firstFileMip) > maxTextureSize)
+	{
+		++firstFileMip;
+	}
+	toLoadMipCount = header.m_mipLevels - firstFileMip;
 
+	// The mips that are bigger than maxLoadedMipSize are part of the image but they are not read. Only 2D textures
+	// have a mip tail
+	firstLoadedMip = 0;
+	while(header.m_type == ImageLoader::TextureType::_2D && firstLoadedMip + 1 < toLoadMipCount
+		&& getMipMaxSize(header, firstFileMip + firstLoadedMip) > maxLoadedMipSize)
+	{
+		++firstLoadedMip;
+	}
+
+	width = header.m_width >> firstFileMip;
+	height = header.m_height >> firstFileMip;
 	colorFormat = header.m_colorFormat;
 
 	U faceCount = 1;
@@ -426,7 +448,7 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 		faceCount = 6;
 		break;
 	case ImageLoader::TextureType::_3D:
-		depth = header.m_depthOrLayerCount;
+		depth = header.m_depthOrLayerCount >> firstFileMip;
 		layerCount = 1;
 		break;
 	case ImageLoader::TextureType::_2D_ARRAY:
@@ -440,121 +462,118 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 	textureType = header.m_type;
 
 	//
-	// Move file pointer
+	// Allocate the surfaces or the volumes of all mips. The ones that won't be loaded will have no data
 	//
-
-	if(preferredCompression == ImageLoader::DataCompression::RAW)
-	{
-		// Do nothing
-	}
-	else if(preferredCompression == ImageLoader::DataCompression::S3TC)
+	const U surfCountPerMip = layerCount * faceCount;
+	if(header.m_type != ImageLoader::TextureType::_3D)
 	{
-		if((header.m_compressionFormats & ImageLoader::DataCompression::RAW) != ImageLoader::DataCompression::NONE)
+		surfaces.create(alloc, toLoadMipCount * surfCountPerMip);
+
+		for(U mip = 0; mip < toLoadMipCount; ++mip)
 		{
-			// If raw compression is present then skip it
-			ANKI_CHECK(file->seek(
-				calcSizeOfSegment(header, ImageLoader::DataCompression::RAW), ResourceFile::SeekOrigin::CURRENT));
+			for(U i = 0; i < surfCountPerMip; ++i)
+			{
+				ImageLoader::Surface& surf = surfaces[mip * surfCountPerMip + i];
+				surf.m_width = width >> mip;
+				surf.m_height = height >> mip;
+				surf.m_mipLevel = mip;
+			}
 		}
 	}
-	else if(preferredCompression == ImageLoader::DataCompression::ETC)
+	else
 	{
-		if((header.m_compressionFormats & ImageLoader::DataCompression::RAW) != ImageLoader::DataCompression::NONE)
-		{
-			// If raw compression is present then skip it
-			ANKI_CHECK(file->seek(
-				calcSizeOfSegment(header, ImageLoader::DataCompression::RAW), ResourceFile::SeekOrigin::CURRENT));
-		}
+		volumes.create(alloc, toLoadMipCount);
 
-		if((header.m_compressionFormats & ImageLoader::DataCompression::S3TC) != ImageLoader::DataCompression::NONE)
+		for(U mip = 0; mip < toLoadMipCount; ++mip)
 		{
-			// If s3tc compression is present then skip it
-			ANKI_CHECK(file->seek(
-				calcSizeOfSegment(header, ImageLoader::DataCompression::S3TC), ResourceFile::SeekOrigin::CURRENT));
+			ImageLoader::Volume& vol = volumes[mip];
+			vol.m_width = width >> mip;
+			vol.m_height = height >> mip;
+			vol.m_depth = depth >> mip;
+			vol.m_mipLevel = mip;
 		}
 	}
 
 	//
 	// It's time to read
 	//
-
-	// Allocate the surfaces
-	if(header.m_type != ImageLoader::TextureType::_3D)
+	if(hasMipInfos)
 	{
-		surfaces.create(alloc, toLoadMipCount * layerCount * faceCount);
+		const U mipInfoCount = header.m_mipLevels * AnkiTextureFile::COMPRESSION_COUNT;
+		DynamicArrayAuto<AnkiTextureFile::MipInfo> mipInfos(alloc);
+		mipInfos.create(mipInfoCount);
+		ANKI_CHECK(file->read(&mipInfos[0], mipInfos.getSizeInBytes()));
+
+		const PtrSize fileSize = file->getSize();
+		const PtrSize dataBegin = sizeof(AnkiTextureHeader) + mipInfos.getSizeInBytes();
+		const U compressionIdx = AnkiTextureFile::getCompressionIndex(preferredCompression);
 
-		// Read all surfaces
-		U mipWidth = header.m_width;
-		U mipHeight = header.m_height;
-		U index = 0;
-		for(U mip = 0; mip < header.m_mipLevels; mip++)
+		// Go coarse to fine so the reads follow the layout of the file and the seeks are skipped
+		PtrSize offset = dataBegin;
+		for(I mip = toLoadMipCount - 1; mip >= I(firstLoadedMip); --mip)
 		{
-			for(U l = 0; l < layerCount; l++)
+			const U fileMip = mip + firstFileMip;
+			const AnkiTextureFile::MipInfo& inf = mipInfos[compressionIdx * header.m_mipLevels + fileMip];
+
+			if(inf.m_size != calcMipSize(header, fileMip, preferredCompression) || inf.m_offset < dataBegin
+				|| inf.m_offset + inf.m_size > fileSize)
 			{
+				ANKI_RESOURCE_LOGE("Incorrect mip offset or size");
+				return Error::USER_DATA;
+			}
 
-				for(U f = 0; f < faceCount; ++f)
-				{
-					U dataSize = calcSurfaceSize(mipWidth, mipHeight, preferredCompression, header.m_colorFormat);
-
-					// Check if this mipmap can be skipped because of size
-					if(maxSize <= maxTextureSize)
-					{
-						ImageLoader::Surface& surf = surfaces[index++];
-						surf.m_width = mipWidth;
-						surf.m_height = mipHeight;
-
-						surf.m_data.create(alloc, dataSize);
-
-						ANKI_CHECK(file->read(&surf.m_data[0], dataSize));
-					}
-					else
-					{
-						ANKI_CHECK(file->seek(dataSize, ResourceFile::SeekOrigin::CURRENT));
-					}
-				}
+			if(inf.m_offset > offset)
+			{
+				ANKI_CHECK(file->seek(inf.m_offset - offset, ResourceFile::SeekOrigin::CURRENT));
+			}
+			else if(inf.m_offset < offset)
+			{
+				ANKI_CHECK(file->seek(inf.m_offset, ResourceFile::SeekOrigin::BEGINNING));
 			}
 
-			mipWidth /= 2;
-			mipHeight /= 2;
+			ANKI_CHECK(readMip(
+				file, mip, surfCountPerMip, preferredCompression, colorFormat, surfaces, volumes, alloc));
+			offset = inf.m_offset + inf.m_size;
 		}
 	}
 	else
 	{
-		volumes.create(alloc, toLoadMipCount);
-
-		U mipWidth = header.m_width;
-		U mipHeight = header.m_height;
-		U mipDepth = header.m_depthOrLayerCount;
-		for(U mip = 0; mip < header.m_mipLevels; mip++)
+		// Skip the compressions that are before the preferred one
+		for(ImageLoader::DataCompression comp = ImageLoader::DataCompression::RAW; comp < preferredCompression;
+			comp = comp << 1)
 		{
-			U dataSize = calcVolumeSize(mipWidth, mipHeight, mipDepth, preferredCompression, header.m_colorFormat);
-
-			// Check if this mipmap can be skipped because of size
-			if(maxSize <= maxTextureSize)
+			if((header.m_compressionFormats & comp) != ImageLoader::DataCompression::NONE)
 			{
-				ImageLoader::Volume& vol = volumes[mip];
-				vol.m_width = mipWidth;
-				vol.m_height = mipHeight;
-				vol.m_depth = mipDepth;
-
-				vol.m_data.create(alloc, dataSize);
+				ANKI_CHECK(file->seek(calcSizeOfSegment(header, comp), ResourceFile::SeekOrigin::CURRENT));
+			}
+		}
 
-				ANKI_CHECK(file->read(&vol.m_data[0], dataSize));
+		// The mips are fine to coarse
+		for(U fileMip = 0; fileMip < header.m_mipLevels; ++fileMip)
+		{
+			if(fileMip >= firstFileMip + firstLoadedMip)
+			{
+				ANKI_CHECK(readMip(file,
+					fileMip - firstFileMip,
+					surfCountPerMip,
+					preferredCompression,
+					colorFormat,
+					surfaces,
+					volumes,
+					alloc));
 			}
 			else
 			{
-				ANKI_CHECK(file->seek(dataSize, ResourceFile::SeekOrigin::CURRENT));
+				ANKI_CHECK(file->seek(
+					calcMipSize(header, fileMip, preferredCompression), ResourceFile::SeekOrigin::CURRENT));
 			}
-
-			mipWidth /= 2;
-			mipHeight /= 2;
-			mipDepth /= 2;
 		}
 	}
 
 	return Error::NONE;
 }
 
-Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTextureSize)
+Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTextureSize, U32 maxLoadedMipSize)
 {
 	// get the extension
 	StringAuto ext(m_alloc);
@@ -608,6 +627,7 @@ Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTe
 
 		ANKI_CHECK(loadAnkiTexture(file,
 			maxTextureSize,
+			maxLoadedMipSize,
 			m_compression,
 			m_surfaces,
 			m_volumes,
@@ -617,6 +637,7 @@ Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTe
 			m_depth,
 			m_layerCount,
 			m_mipLevels,
+			m_firstLoadedMip,
 			m_textureType,
 			m_colorFormat));
 	}
@@ -631,7 +652,7 @@ Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTe
 
 const ImageLoader::Surface& ImageLoader::getSurface(U level, U face, U layer) const
 {
-	ANKI_ASSERT(level < m_mipLevels);
+	ANKI_ASSERT(level >= m_firstLoadedMip && level < m_mipLevels);
 
 	U idx = 0;
 
@@ -660,6 +681,7 @@ const ImageLoader::Surface& ImageLoader::getSurface(U level, U face, U layer) co
 const ImageLoader::Volume& ImageLoader::getVolume(U level) const
 {
 	ANKI_ASSERT(m_textureType == TextureType::_3D);
+	ANKI_ASSERT(level >= m_firstLoadedMip && level < m_mipLevels);
 	return m_volumes[level];
 }
 
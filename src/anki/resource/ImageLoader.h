@@ -94,6 +94,12 @@ public:
 		return m_mipLevels;
 	}
 
+	/// The mips before that one were not loaded because of the maxLoadedMipSize of load().
+	U getFirstLoadedMipLevel() const
+	{
+		return m_firstLoadedMip;
+	}
+
 	U getWidth() const
 	{
 		return m_width;
@@ -132,7 +138,12 @@ public:
 	}
 
 	/// Load an image file.
-	ANKI_USE_RESULT Error load(ResourceFilePtr file, const CString& filename, U32 maxTextureSize = MAX_U32);
+	/// @param maxTextureSize The mips that are bigger than that are dropped and the image appears smaller.
+	/// @param maxLoadedMipSize The mips that are bigger than that are part of the image but their data are not loaded.
+	///                         It's used to load a mip tail. The last mip is always loaded. It's ignored for textures
+	///                         that are not 2D.
+	ANKI_USE_RESULT Error load(
+		ResourceFilePtr file, const CString& filename, U32 maxTextureSize = MAX_U32, U32 maxLoadedMipSize = MAX_U32);
 
 	Atomic<I32>& getRefcount()
 	{
@@ -150,6 +161,7 @@ private:
 	DynamicArray<Volume> m_volumes;
 
 	U8 m_mipLevels = 0;
+	U8 m_firstLoadedMip = 0;
 	U32 m_width = 0;
 	U32 m_height = 0;
 	U32 m_depth = 0;
@@ -161,4 +173,57 @@ private:
 	void destroy();
 };
 
+/// Information to decode AnKi texture files. A file starts with a Header. Version 2 files continue with a MipInfo per
+/// compression and mip (all the compressions have entries) and then with the data of the mips. The data are laid out
+/// coarse to fine so the mip tail of a texture can be read at once and the finer mips can be streamed in later. The
+/// data of a mip contain all its faces or layers. Version 1 files have no MipInfo and the mips are laid out fine to
+/// coarse.
+class AnkiTextureFile
+{
+public:
+	static constexpr const char* MAGIC_V1 = "ANKITEX1";
+	static constexpr const char* MAGIC = "ANKITEX2";
+
+	static const U32 COMPRESSION_COUNT = 3; ///< RAW, S3TC and ETC.
+
+	struct Header
+	{
+		Array<U8, 8> m_magic;
+		U32 m_width;
+		U32 m_height;
+		U32 m_depthOrLayerCount;
+		ImageLoader::TextureType m_type;
+		ImageLoader::ColorFormat m_colorFormat;
+		ImageLoader::DataCompression m_compressionFormats;
+		U32 m_normal;
+		U32 m_mipLevels;
+		U64 m_contentHash; ///< Hash of the sources and the options of the converter. Zero if it's not known.
+		U8 m_padding[80];
+	};
+
+	struct MipInfo
+	{
+		U64 m_offset; ///< Offset from the start of the file. Zero if the compression is not present.
+		U64 m_size;
+	};
+
+	/// Get the index of a compression in the MipInfo table.
+	static U getCompressionIndex(ImageLoader::DataCompression compression)
+	{
+		switch(compression)
+		{
+		case ImageLoader::DataCompression::RAW:
+			return 0;
+		case ImageLoader::DataCompression::S3TC:
+			return 1;
+		default:
+			ANKI_ASSERT(compression == ImageLoader::DataCompression::ETC);
+			return 2;
+		}
+	}
+};
+
+static_assert(sizeof(AnkiTextureFile::Header) == 128, "Check sizeof AnkiTextureFile::Header");
+static_assert(sizeof(AnkiTextureFile::MipInfo) == 16, "Check sizeof AnkiTextureFile::MipInfo");
+
 } // end namespace anki
@@ -487,7 +487,7 @@ Error MaterialResource::parseInputs(XmlElement inputsEl, Bool async)
 				{
 					CString texfname;
 					ANKI_CHECK(inputEl.getAttributeText("value", texfname));
-					ANKI_CHECK(getManager().loadResource(texfname, mtlVar.m_tex, async));
+					ANKI_CHECK(getManager().loadStreamedTexture(texfname, mtlVar.m_tex, async));
 					break;
 				}
 
@@ -517,7 +517,19 @@ Error MaterialResource::parseInputs(XmlElement inputsEl, Bool async)
 	return Error::NONE;
 }
 
-const MaterialVariant& MaterialResource::getOrCreateVariant(const RenderingKey& key_) const
+const MaterialVariant& MaterialResource::getOrCreateVariant(const RenderingKey& key) const
+{
+	const MaterialVariant* variant = getOrCreateVariantInternal(key, false);
+	ANKI_ASSERT(variant);
+	return *variant;
+}
+
+const MaterialVariant* MaterialResource::getOrCreateVariantAsync(const RenderingKey& key) const
+{
+	return getOrCreateVariantInternal(key, true);
+}
+
+const MaterialVariant* MaterialResource::getOrCreateVariantInternal(const RenderingKey& key_, Bool async) const
 {
 	RenderingKey key = key_;
 	key.m_lod = min<U>(m_lodCount - 1, key.m_lod);
@@ -584,14 +596,70 @@ const MaterialVariant& MaterialResource::getOrCreateVariant(const RenderingKey&
 			++count;
 		}
 
-		m_prog->getOrCreateVariant(
-			ConstWeakArray<ShaderProgramResourceMutation>(mutations.getSize() ? &mutations[0] : nullptr, count),
-			ConstWeakArray<ShaderProgramResourceConstantValue>(
-				(m_constValues.getSize()) ? &m_constValues[0] : nullptr, m_constValues.getSize()),
-			variant.m_variant);
+		const ConstWeakArray<ShaderProgramResourceMutation> mutationsArr(
+			mutations.getSize() ? &mutations[0] : nullptr, count);
+		const ConstWeakArray<ShaderProgramResourceConstantValue> constantsArr(
+			(m_constValues.getSize()) ? &m_constValues[0] : nullptr, m_constValues.getSize());
+		if(async)
+		{
+			m_prog->getOrCreateVariantAsync(mutationsArr, constantsArr, variant.m_variant);
+			if(variant.m_variant == nullptr)
+			{
+				return nullptr;
+			}
+		}
+		else
+		{
+			m_prog->getOrCreateVariant(mutationsArr, constantsArr, variant.m_variant);
+		}
+	}
+
+	return &variant;
+}
+
+void MaterialResource::createAllVariants() const
+{
+	const U skinCount = (m_bonesMutator) ? 2 : 1;
+	for(U skinned = 0; skinned < skinCount; ++skinned)
+	{
+		getOrCreateAllVariantsInternal(skinned, false);
+	}
+}
+
+Bool MaterialResource::getOrCreateAllVariantsAsync(Bool skinned) const
+{
+	return getOrCreateAllVariantsInternal(skinned, true);
+}
+
+Bool MaterialResource::getOrCreateAllVariantsInternal(Bool skinned, Bool async) const
+{
+	ANKI_ASSERT(!skinned || m_bonesMutator);
+
+	// Without a mutator the pass and the velocity don't change the program
+	const U passCount = (m_passMutator) ? U(Pass::COUNT) : 1;
+	const U instanceGroupCount = (isInstanced()) ? MAX_INSTANCE_GROUPS : 1;
+
+	// Request all of them before returning so they compile at the same time
+	Bool allReady = true;
+	for(U pass = 0; pass < passCount; ++pass)
+	{
+		// Only the GBuffer pass writes velocity
+		const U velocityCount = (m_velocityMutator && Pass(pass) == Pass::GB) ? 2 : 1;
+
+		for(U lod = 0; lod < m_lodCount; ++lod)
+		{
+			for(U instanceGroup = 0; instanceGroup < instanceGroupCount; ++instanceGroup)
+			{
+				for(U velocity = 0; velocity < velocityCount; ++velocity)
+				{
+					const RenderingKey key(Pass(pass), lod, 1 << instanceGroup, skinned, velocity);
+					allReady = getOrCreateVariantInternal(key, async) != nullptr && allReady;
+				}
+			}
+		}
 	}
 
-	return variant;
+	return allReady;
 }
 
 U MaterialResource::getInstanceGroupIdx(U instanceCount)
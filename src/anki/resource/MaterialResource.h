@@ -245,6 +245,16 @@ public:
 
 	const MaterialVariant& getOrCreateVariant(const RenderingKey& key) const;
 
+	/// Same as getOrCreateVariant but it doesn't wait for the shaders to compile. It returns nullptr until they are.
+	const MaterialVariant* getOrCreateVariantAsync(const RenderingKey& key) const;
+
+	/// Create every variant the material can have. Used to precompile its shaders.
+	void createAllVariants() const;
+
+	/// Request every variant of every pass, LOD and instance count without waiting for the shaders to compile. It
+	/// returns true when all of them are ready. Renderables use it to start drawing in all passes at the same frame.
+	Bool getOrCreateAllVariantsAsync(Bool skinned) const;
+
 	const DynamicArray<MaterialVariable>& getVariables() const
 	{
 		return m_vars;
@@ -285,6 +295,10 @@ private:
 
 	static U getInstanceGroupIdx(U instanceCount);
 
+	const MaterialVariant* getOrCreateVariantInternal(const RenderingKey& key, Bool async) const;
+
+	Bool getOrCreateAllVariantsInternal(Bool skinned, Bool async) const;
+
 	/// Parse whatever is inside the <inputs> tag.
 	ANKI_USE_RESULT Error parseInputs(XmlElement inputsEl, Bool async);
 
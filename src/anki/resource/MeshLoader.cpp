@@ -18,6 +18,7 @@ MeshLoader::MeshLoader(ResourceManager* manager)
 MeshLoader::~MeshLoader()
 {
 	m_subMeshes.destroy(m_alloc);
+	m_meshlets.destroy(m_alloc);
 }
 
 Error MeshLoader::load(const ResourceFilename& filename)
@@ -65,6 +66,12 @@ Error MeshLoader::load(const ResourceFilename& filename)
 		}
 	}
 
+	// Read the meshlets
+	if(!!(m_header.m_flags & MeshBinaryFile::Flag::MESHLETS))
+	{
+		ANKI_CHECK(loadMeshlets());
+	}
+
 	// Read vert buffer info
 	{
 		U32 vertBufferMask = 0;
@@ -98,6 +105,10 @@ Error MeshLoader::load(const ResourceFilename& filename)
 		U32 totalSize = sizeof(m_header);
 
 		totalSize += sizeof(MeshBinaryFile::SubMesh) * m_header.m_subMeshCount;
+		if(!!(m_header.m_flags & MeshBinaryFile::Flag::MESHLETS))
+		{
+			totalSize += sizeof(U32) + m_meshlets.getSizeInBytes();
+		}
 		totalSize += getIndexBufferSize();
 
 		for(U i = 0; i < m_header.m_vertexBufferCount; ++i)
@@ -115,6 +126,69 @@ Error MeshLoader::load(const ResourceFilename& filename)
 	return Error::NONE;
 }
 
+Error MeshLoader::loadMeshlets()
+{
+	if(!!(m_header.m_flags & MeshBinaryFile::Flag::QUAD))
+	{
+		ANKI_RESOURCE_LOGE("Meshlets are not supported for quads");
+		return Error::USER_DATA;
+	}
+
+	U32 meshletCount;
+	ANKI_CHECK(m_file->readU32(meshletCount));
+	if(meshletCount == 0 || meshletCount > m_header.m_totalIndexCount / 3)
+	{
+		ANKI_RESOURCE_LOGE("Wrong meshlet count");
+		return Error::USER_DATA;
+	}
+
+	m_meshlets.create(m_alloc, meshletCount);
+	ANKI_CHECK(m_file->read(&m_meshlets[0], m_meshlets.getSizeInBytes()));
+
+	// Checks. The meshlets should cover the indices in order and not cross the sub meshes
+	U32 idxSum = 0;
+	U32 subMeshIdx = 0;
+	for(const MeshBinaryFile::Meshlet& m : m_meshlets)
+	{
+		if(m.m_firstIndex != idxSum || m.m_indexCount == 0 || (m.m_indexCount % 3) != 0
+			|| m.m_indexCount > MeshBinaryFile::MAX_MESHLET_TRIANGLE_COUNT * 3)
+		{
+			ANKI_RESOURCE_LOGE("Incorrect meshlet info");
+			return Error::USER_DATA;
+		}
+
+		while(subMeshIdx < m_subMeshes.getSize()
+			  && m.m_firstIndex >= m_subMeshes[subMeshIdx].m_firstIndex + m_subMeshes[subMeshIdx].m_indexCount)
+		{
+			++subMeshIdx;
+		}
+
+		if(subMeshIdx == m_subMeshes.getSize()
+			|| m.m_firstIndex + m.m_indexCount
+				   > m_subMeshes[subMeshIdx].m_firstIndex + m_subMeshes[subMeshIdx].m_indexCount)
+		{
+			ANKI_RESOURCE_LOGE("A meshlet crosses the sub mesh boundaries");
+			return Error::USER_DATA;
+		}
+
+		if(m.m_sphereRadius < 0.0f || m.m_coneCutoff < 0.0f || m.m_coneCutoff > 1.0f)
+		{
+			ANKI_RESOURCE_LOGE("Wrong meshlet bounds");
+			return Error::USER_DATA;
+		}
+
+		idxSum += m.m_indexCount;
+	}
+
+	if(idxSum != m_header.m_totalIndexCount)
+	{
+		ANKI_RESOURCE_LOGE("Incorrect meshlet info");
+		return Error::USER_DATA;
+	}
+
+	return Error::NONE;
+}
+
 Error MeshLoader::checkFormat(VertexAttributeLocation type, ConstWeakArray<Format> supportedFormats) const
 {
 	const MeshBinaryFile::VertexAttribute& attrib = m_header.m_vertexAttributes[type];
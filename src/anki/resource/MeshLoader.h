@@ -28,8 +28,9 @@ public:
 		NONE = 0,
 		QUAD = 1 << 0,
 		CONVEX = 1 << 1,
+		MESHLETS = 1 << 2, ///< The meshlet section follows the sub meshes.
 
-		ALL = QUAD | CONVEX,
+		ALL = QUAD | CONVEX | MESHLETS,
 	};
 	ANKI_ENUM_ALLOW_NUMERIC_OPERATIONS(Flag, friend)
 
@@ -54,6 +55,28 @@ public:
 		Vec3 m_aabbMax; ///< Bounding box max.
 	};
 
+	/// The max number of unique vertices of a meshlet.
+	static const U32 MAX_MESHLET_VERTEX_COUNT = 64;
+
+	/// The max number of triangles of a meshlet.
+	static const U32 MAX_MESHLET_TRIANGLE_COUNT = 124;
+
+	/// A small cluster of triangles that can be culled on its own. The meshlets are stored in the same order as the
+	/// indices and each one is a range of the index buffer inside a sub mesh.
+	struct Meshlet
+	{
+		U32 m_firstIndex;
+		U32 m_indexCount;
+		Vec3 m_sphereCenter; ///< Bounding sphere center.
+		F32 m_sphereRadius; ///< Bounding sphere radius.
+		Vec3 m_coneAxis; ///< The average direction of the normals of the triangles.
+
+		/// The sine of the normal cone's half angle. All the triangles face away from a camera position if
+		/// dot(m_sphereCenter - position, m_coneAxis) >= m_coneCutoff * length(m_sphereCenter - position) + radius.
+		/// It's 1.0 if the triangles can't be culled that way.
+		F32 m_coneCutoff;
+	};
+
 	struct Header
 	{
 		char m_magic[8]; ///< Magic word.
@@ -116,6 +139,12 @@ public:
 		return ConstWeakArray<MeshBinaryFile::SubMesh>(m_subMeshes);
 	}
 
+	/// Get the meshlets. It's empty if the file doesn't have the MeshBinaryFile::Flag::MESHLETS.
+	ConstWeakArray<MeshBinaryFile::Meshlet> getMeshlets() const
+	{
+		return ConstWeakArray<MeshBinaryFile::Meshlet>(m_meshlets);
+	}
+
 private:
 	ResourceManager* m_manager;
 	GenericMemoryPoolAllocator<U8> m_alloc;
@@ -125,6 +154,7 @@ private:
 	MeshBinaryFile::Header m_header;
 
 	DynamicArray<MeshBinaryFile::SubMesh> m_subMeshes;
+	DynamicArray<MeshBinaryFile::Meshlet> m_meshlets;
 
 	U32 m_loadedChunk = 0; ///< Because the store methods need to be called in sequence.
 
@@ -139,6 +169,7 @@ private:
 	}
 
 	ANKI_USE_RESULT Error checkHeader() const;
+	ANKI_USE_RESULT Error loadMeshlets();
 	ANKI_USE_RESULT Error checkFormat(VertexAttributeLocation type, ConstWeakArray<Format> supportedFormats) const;
 };
 /// @}
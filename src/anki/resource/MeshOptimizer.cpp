@@ -0,0 +1,851 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/MeshOptimizer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace anki
+{
+
+/// The overdraw optimization can make the ACMR that much worse.
+static const F32 OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+/// The cosine of the half angle of the widest normal cone that the meshlets can be backface culled with.
+static const F32 MESHLET_MIN_CONE_COSINE = 0.1f;
+
+/// For every vertex the triangles that use it.
+class Adjacency
+{
+public:
+	DynamicArrayAuto<U32> m_offsets;
+	DynamicArrayAuto<U32> m_triangles;
+
+	Adjacency(GenericMemoryPoolAllocator<U8> alloc)
+		: m_offsets(alloc)
+		, m_triangles(alloc)
+	{
+	}
+
+	U32 getTriangleCount(U32 vertex) const
+	{
+		return m_offsets[vertex + 1] - m_offsets[vertex];
+	}
+
+	const U32* getTriangles(U32 vertex) const
+	{
+		return &m_triangles[m_offsets[vertex]];
+	}
+};
+
+static void buildAdjacency(ConstWeakArray<U32> indices, U32 vertexCount, Adjacency& adj)
+{
+	adj.m_offsets.destroy();
+	adj.m_offsets.create(vertexCount + 1, 0);
+	for(U32 idx : indices)
+	{
+		ANKI_ASSERT(idx < vertexCount);
+		++adj.m_offsets[idx + 1];
+	}
+
+	for(U32 v = 0; v < vertexCount; ++v)
+	{
+		adj.m_offsets[v + 1] += adj.m_offsets[v];
+	}
+
+	// Use the offsets as cursors and then shift them back
+	adj.m_triangles.destroy();
+	adj.m_triangles.create(indices.getSize());
+	for(U32 i = 0; i < indices.getSize(); ++i)
+	{
+		adj.m_triangles[adj.m_offsets[indices[i]]++] = i / 3;
+	}
+
+	for(U32 v = vertexCount; v > 0; --v)
+	{
+		adj.m_offsets[v] = adj.m_offsets[v - 1];
+	}
+	adj.m_offsets[0] = 0;
+}
+
+/// A FIFO cache that is simulated with the time every vertex was inserted.
+class FifoCache
+{
+public:
+	DynamicArrayAuto<U32> m_insertTimes;
+	U32 m_time = 0;
+	U32 m_size;
+
+	FifoCache(GenericMemoryPoolAllocator<U8> alloc, U32 entryCount, U32 cacheSize)
+		: m_insertTimes(alloc)
+		, m_size(cacheSize)
+	{
+		m_insertTimes.create(entryCount, MAX_U32);
+	}
+
+	/// Access an entry.
+	/// @return True if it's a miss.
+	Bool access(U32 entry)
+	{
+		if(m_insertTimes[entry] != MAX_U32 && m_time - m_insertTimes[entry] < m_size)
+		{
+			return false;
+		}
+
+		m_insertTimes[entry] = m_time++;
+		return true;
+	}
+
+	void flush()
+	{
+		m_time += m_size;
+	}
+};
+
+void MeshOptimizer::optimizeVertexCache(WeakArray<U32> indices, U32 vertexCount)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	const U32 triangleCount = indices.getSize() / 3;
+	if(triangleCount == 0)
+	{
+		return;
+	}
+
+	Adjacency adj(m_alloc);
+	buildAdjacency(indices, vertexCount, adj);
+
+	DynamicArrayAuto<U32> liveTriangles(m_alloc);
+	liveTriangles.create(vertexCount);
+	for(U32 v = 0; v < vertexCount; ++v)
+	{
+		liveTriangles[v] = adj.getTriangleCount(v);
+	}
+
+	DynamicArrayAuto<U32> cacheTimes(m_alloc);
+	cacheTimes.create(vertexCount, 0);
+	DynamicArrayAuto<Bool> emitted(m_alloc);
+	emitted.create(triangleCount, false);
+	DynamicArrayAuto<U32> deadEnds(m_alloc);
+	deadEnds.create(indices.getSize());
+	U32 deadEndCount = 0;
+	DynamicArrayAuto<U32> candidates(m_alloc);
+	candidates.create(indices.getSize());
+	DynamicArrayAuto<U32> out(m_alloc);
+	out.create(indices.getSize());
+	U32 outCount = 0;
+
+	const I32 cacheSize = VERTEX_CACHE_SIZE;
+	I32 time = cacheSize + 1;
+	U32 cursor = 0;
+	U32 fanning = indices[0];
+	while(fanning != MAX_U32)
+	{
+		// Emit the triangles around the fanning vertex
+		U32 candidateCount = 0;
+		for(U32 i = 0; i < adj.getTriangleCount(fanning); ++i)
+		{
+			const U32 tri = adj.getTriangles(fanning)[i];
+			if(emitted[tri])
+			{
+				continue;
+			}
+
+			emitted[tri] = true;
+			for(U32 j = 0; j < 3; ++j)
+			{
+				const U32 v = indices[tri * 3 + j];
+				out[outCount++] = v;
+				deadEnds[deadEndCount++] = v;
+				candidates[candidateCount++] = v;
+				--liveTriangles[v];
+
+				if(time - I32(cacheTimes[v]) > cacheSize)
+				{
+					cacheTimes[v] = time++;
+				}
+			}
+		}
+
+		// Pick the oldest vertex that will still be in the cache after its triangles are emitted
+		fanning = MAX_U32;
+		I32 bestPriority = -1;
+		for(U32 i = 0; i < candidateCount; ++i)
+		{
+			const U32 v = candidates[i];
+			if(liveTriangles[v] == 0)
+			{
+				continue;
+			}
+
+			I32 priority = 0;
+			if(time - I32(cacheTimes[v]) + 2 * I32(liveTriangles[v]) <= cacheSize)
+			{
+				priority = time - I32(cacheTimes[v]);
+			}
+
+			if(priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+
+		// Dead end, try the recently used vertices and then any vertex
+		while(fanning == MAX_U32 && deadEndCount > 0)
+		{
+			const U32 v = deadEnds[--deadEndCount];
+			if(liveTriangles[v] > 0)
+			{
+				fanning = v;
+			}
+		}
+
+		while(fanning == MAX_U32 && cursor < vertexCount)
+		{
+			if(liveTriangles[cursor] > 0)
+			{
+				fanning = cursor;
+			}
+			++cursor;
+		}
+	}
+
+	ANKI_ASSERT(outCount == indices.getSize());
+	memcpy(&indices[0], &out[0], indices.getSizeInBytes());
+}
+
+void MeshOptimizer::optimizeOverdraw(WeakArray<U32> indices, ConstWeakArray<Vec3> positions)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	const U32 triangleCount = indices.getSize() / 3;
+	if(triangleCount == 0)
+	{
+		return;
+	}
+
+	const F32 meshAcmr = computeStats(indices, positions.getSize(), 1).m_acmr;
+
+	// Split to clusters. A new cluster starts where the cache misses all the vertices of a triangle (there is nothing
+	// to lose) or when the current cluster has an ACMR close to the ACMR of the mesh
+	DynamicArrayAuto<U32> clusterOffsets(m_alloc);
+	{
+		FifoCache meshCache(m_alloc, positions.getSize(), VERTEX_CACHE_SIZE);
+		FifoCache clusterCache(m_alloc, positions.getSize(), VERTEX_CACHE_SIZE);
+		U32 clusterMisses = 0;
+		U32 clusterTriangles = 0;
+		for(U32 tri = 0; tri < triangleCount; ++tri)
+		{
+			U32 meshMisses = 0;
+			for(U32 j = 0; j < 3; ++j)
+			{
+				meshMisses += meshCache.access(indices[tri * 3 + j]);
+			}
+
+			const Bool clusterDone = clusterTriangles > 0 && F32(clusterMisses) <= meshAcmr * OVERDRAW_ACMR_THRESHOLD
+				* F32(clusterTriangles);
+			if(tri == 0 || meshMisses == 3 || clusterDone)
+			{
+				clusterOffsets.emplaceBack(tri);
+				clusterCache.flush();
+				clusterMisses = 0;
+				clusterTriangles = 0;
+			}
+
+			for(U32 j = 0; j < 3; ++j)
+			{
+				clusterMisses += clusterCache.access(indices[tri * 3 + j]);
+			}
+			++clusterTriangles;
+		}
+	}
+
+	const U32 clusterCount = clusterOffsets.getSize();
+	clusterOffsets.emplaceBack(triangleCount);
+	if(clusterCount == 1)
+	{
+		return;
+	}
+
+	// Compute the area weighted centers and normals of the clusters and the mesh
+	DynamicArrayAuto<Vec3> centers(m_alloc);
+	centers.create(clusterCount, Vec3(0.0f));
+	DynamicArrayAuto<Vec3> normals(m_alloc);
+	normals.create(clusterCount, Vec3(0.0f));
+	Vec3 meshCenter(0.0f);
+	F32 meshArea = 0.0f;
+	for(U32 c = 0; c < clusterCount; ++c)
+	{
+		F32 clusterArea = 0.0f;
+		for(U32 tri = clusterOffsets[c]; tri < clusterOffsets[c + 1]; ++tri)
+		{
+			const Vec3& p0 = positions[indices[tri * 3 + 0]];
+			const Vec3& p1 = positions[indices[tri * 3 + 1]];
+			const Vec3& p2 = positions[indices[tri * 3 + 2]];
+			const Vec3 normal = (p1 - p0).cross(p2 - p0);
+			const F32 area = normal.getLength();
+
+			centers[c] += (p0 + p1 + p2) * (area / 3.0f);
+			normals[c] += normal;
+			clusterArea += area;
+		}
+
+		meshCenter += centers[c];
+		meshArea += clusterArea;
+		centers[c] = (clusterArea > EPSILON) ? centers[c] / clusterArea : positions[indices[clusterOffsets[c] * 3]];
+	}
+	meshCenter = (meshArea > EPSILON) ? meshCenter / meshArea : Vec3(0.0f);
+
+	// The clusters that face away from the center are drawn first
+	class Cluster
+	{
+	public:
+		F32 m_sortKey;
+		U32 m_idx;
+	};
+
+	DynamicArrayAuto<Cluster> clusters(m_alloc);
+	clusters.create(clusterCount);
+	for(U32 c = 0; c < clusterCount; ++c)
+	{
+		const F32 normalLength = normals[c].getLength();
+		const Vec3 normal = (normalLength > EPSILON) ? normals[c] / normalLength : Vec3(0.0f);
+		clusters[c].m_sortKey = (centers[c] - meshCenter).dot(normal);
+		clusters[c].m_idx = c;
+	}
+
+	std::sort(clusters.getBegin(), clusters.getEnd(), [](const Cluster& a, const Cluster& b) {
+		return a.m_sortKey > b.m_sortKey || (a.m_sortKey == b.m_sortKey && a.m_idx < b.m_idx);
+	});
+
+	DynamicArrayAuto<U32> out(m_alloc);
+	out.create(indices.getSize());
+	U32 outCount = 0;
+	for(const Cluster& cluster : clusters)
+	{
+		const U32 begin = clusterOffsets[cluster.m_idx] * 3;
+		const U32 end = clusterOffsets[cluster.m_idx + 1] * 3;
+		memcpy(&out[outCount], &indices[begin], (end - begin) * sizeof(U32));
+		outCount += end - begin;
+	}
+
+	memcpy(&indices[0], &out[0], indices.getSizeInBytes());
+}
+
+void MeshOptimizer::optimizeVertexFetch(WeakArray<U32> indices, U32 vertexCount, DynamicArrayAuto<U32>& newToOld)
+{
+	DynamicArrayAuto<U32> oldToNew(m_alloc);
+	oldToNew.create(vertexCount, MAX_U32);
+	newToOld.destroy();
+
+	for(U32& idx : indices)
+	{
+		ANKI_ASSERT(idx < vertexCount);
+		if(oldToNew[idx] == MAX_U32)
+		{
+			oldToNew[idx] = newToOld.getSize();
+			newToOld.emplaceBack(idx);
+		}
+
+		idx = oldToNew[idx];
+	}
+}
+
+void MeshOptimizer::optimize(WeakArray<U32> indices, ConstWeakArray<Vec3> positions, DynamicArrayAuto<U32>& newToOld)
+{
+	optimizeVertexCache(indices, positions.getSize());
+	optimizeOverdraw(indices, positions);
+	optimizeVertexFetch(indices, positions.getSize(), newToOld);
+}
+
+/// A quadric error metric. It's the sum of the squared distances from some planes weighted by the area.
+class Quadric
+{
+public:
+	Array<F64, 10> m_q = {};
+	F64 m_area = 0.0;
+
+	void addPlane(const Vec3& normal, F32 d, F32 area)
+	{
+		const F64 a = normal.x();
+		const F64 b = normal.y();
+		const F64 c = normal.z();
+		const F64 w = area;
+		m_q[0] += w * a * a;
+		m_q[1] += w * a * b;
+		m_q[2] += w * a * c;
+		m_q[3] += w * a * d;
+		m_q[4] += w * b * b;
+		m_q[5] += w * b * c;
+		m_q[6] += w * b * d;
+		m_q[7] += w * c * c;
+		m_q[8] += w * c * d;
+		m_q[9] += w * F64(d) * d;
+		m_area += w;
+	}
+
+	Quadric& operator+=(const Quadric& b)
+	{
+		for(U32 i = 0; i < m_q.getSize(); ++i)
+		{
+			m_q[i] += b.m_q[i];
+		}
+		m_area += b.m_area;
+		return *this;
+	}
+
+	/// The average squared distance of a point from the planes.
+	F64 evaluate(const Vec3& p) const
+	{
+		const F64 x = p.x();
+		const F64 y = p.y();
+		const F64 z = p.z();
+		const F64 err = m_q[0] * x * x + 2.0 * m_q[1] * x * y + 2.0 * m_q[2] * x * z + 2.0 * m_q[3] * x
+			+ m_q[4] * y * y + 2.0 * m_q[5] * y * z + 2.0 * m_q[6] * y + m_q[7] * z * z + 2.0 * m_q[8] * z + m_q[9];
+		return (m_area > 0.0) ? max(err, 0.0) / m_area : 0.0;
+	}
+};
+
+F32 MeshOptimizer::simplify(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	U32 targetIndexCount,
+	F32 maxError,
+	DynamicArrayAuto<U32>& out)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	const U32 vertexCount = positions.getSize();
+
+	// Copy the triangles that are not degenerate
+	out.destroy();
+	for(U32 i = 0; i < indices.getSize(); i += 3)
+	{
+		const U32 a = indices[i + 0];
+		const U32 b = indices[i + 1];
+		const U32 c = indices[i + 2];
+		if(a != b && b != c && c != a)
+		{
+			out.emplaceBack(a);
+			out.emplaceBack(b);
+			out.emplaceBack(c);
+		}
+	}
+
+	// Lock the vertices of the edges that don't have exactly 2 triangles. Those are the borders, the seams of the
+	// attributes (the vertices are split there) and the non-manifold edges
+	DynamicArrayAuto<Bool> locked(m_alloc);
+	locked.create(vertexCount, false);
+	{
+		DynamicArrayAuto<U64> edges(m_alloc);
+		edges.create(out.getSize());
+		for(U32 i = 0; i < out.getSize(); ++i)
+		{
+			const U32 a = out[i];
+			const U32 b = out[(i % 3 == 2) ? i - 2 : i + 1];
+			edges[i] = (U64(min(a, b)) << 32u) | U64(max(a, b));
+		}
+
+		std::sort(edges.getBegin(), edges.getEnd());
+		for(U32 i = 0; i < edges.getSize();)
+		{
+			U32 j = i + 1;
+			while(j < edges.getSize() && edges[j] == edges[i])
+			{
+				++j;
+			}
+
+			if(j - i != 2)
+			{
+				locked[U32(edges[i] >> 32u)] = true;
+				locked[U32(edges[i] & MAX_U32)] = true;
+			}
+			i = j;
+		}
+	}
+
+	// Compute the quadrics of the vertices
+	DynamicArrayAuto<Quadric> quadrics(m_alloc);
+	quadrics.create(vertexCount);
+	for(U32 i = 0; i < out.getSize(); i += 3)
+	{
+		const Vec3& p0 = positions[out[i + 0]];
+		const Vec3& p1 = positions[out[i + 1]];
+		const Vec3& p2 = positions[out[i + 2]];
+		Vec3 normal = (p1 - p0).cross(p2 - p0);
+		const F32 length = normal.getLength();
+		if(length <= EPSILON)
+		{
+			continue;
+		}
+
+		normal /= length;
+		const F32 d = -normal.dot(p0);
+		for(U32 j = 0; j < 3; ++j)
+		{
+			quadrics[out[i + j]].addPlane(normal, d, length * 0.5f);
+		}
+	}
+
+	class Collapse
+	{
+	public:
+		F64 m_error;
+		U32 m_from;
+		U32 m_to;
+	};
+
+	const F64 maxSquaredError = F64(maxError) * maxError;
+	F64 maxCollapseError = 0.0;
+	Adjacency adj(m_alloc);
+	DynamicArrayAuto<Collapse> collapses(m_alloc);
+	DynamicArrayAuto<Bool> touched(m_alloc);
+	touched.create(vertexCount);
+	DynamicArrayAuto<Bool> dead(m_alloc);
+	DynamicArrayAuto<U32> marks(m_alloc);
+	marks.create(vertexCount, MAX_U32);
+	U32 markId = 0;
+
+	// Every pass collapses the cheapest edges that are independent of each other
+	while(out.getSize() > targetIndexCount)
+	{
+		const U32 triangleCount = out.getSize() / 3;
+		buildAdjacency(out, vertexCount, adj);
+
+		collapses.destroy();
+		for(U32 i = 0; i < out.getSize(); ++i)
+		{
+			const U32 a = out[i];
+			const U32 b = out[(i % 3 == 2) ? i - 2 : i + 1];
+			for(U32 dir = 0; dir < 2; ++dir)
+			{
+				const U32 from = (dir == 0) ? a : b;
+				const U32 to = (dir == 0) ? b : a;
+				if(locked[from])
+				{
+					continue;
+				}
+
+				Quadric q = quadrics[from];
+				q += quadrics[to];
+				const F64 error = q.evaluate(positions[to]);
+				if(error <= maxSquaredError)
+				{
+					collapses.emplaceBack(Collapse{error, from, to});
+				}
+			}
+		}
+
+		std::sort(collapses.getBegin(), collapses.getEnd(), [](const Collapse& a, const Collapse& b) {
+			return a.m_error < b.m_error || (a.m_error == b.m_error && (a.m_from < b.m_from || (a.m_from == b.m_from
+				&& a.m_to < b.m_to)));
+		});
+
+		std::fill(touched.getBegin(), touched.getEnd(), false);
+		dead.destroy();
+		dead.create(triangleCount, false);
+		U32 liveIndexCount = out.getSize();
+		U32 collapseCount = 0;
+		for(const Collapse& collapse : collapses)
+		{
+			if(liveIndexCount <= targetIndexCount)
+			{
+				break;
+			}
+
+			const U32 from = collapse.m_from;
+			const U32 to = collapse.m_to;
+			if(touched[from] || touched[to])
+			{
+				continue;
+			}
+
+			// The vertices that are connected to both must be the ones of the triangles that will be removed or the
+			// mesh will fold
+			++markId;
+			U32 sharedTriangleCount = 0;
+			for(U32 i = 0; i < adj.getTriangleCount(from); ++i)
+			{
+				const U32* tri = &out[adj.getTriangles(from)[i] * 3];
+				sharedTriangleCount += tri[0] == to || tri[1] == to || tri[2] == to;
+				for(U32 j = 0; j < 3; ++j)
+				{
+					marks[tri[j]] = markId;
+				}
+			}
+
+			U32 sharedVertexCount = 0;
+			for(U32 i = 0; i < adj.getTriangleCount(to); ++i)
+			{
+				const U32* tri = &out[adj.getTriangles(to)[i] * 3];
+				for(U32 j = 0; j < 3; ++j)
+				{
+					if(tri[j] != from && tri[j] != to && marks[tri[j]] == markId)
+					{
+						marks[tri[j]] = MAX_U32;
+						++sharedVertexCount;
+					}
+				}
+			}
+
+			if(sharedVertexCount != sharedTriangleCount)
+			{
+				continue;
+			}
+
+			// The triangles that remain shouldn't flip or become degenerate
+			Bool flips = false;
+			for(U32 i = 0; i < adj.getTriangleCount(from) && !flips; ++i)
+			{
+				const U32* tri = &out[adj.getTriangles(from)[i] * 3];
+				if(tri[0] == to || tri[1] == to || tri[2] == to)
+				{
+					continue;
+				}
+
+				Array<Vec3, 3> p;
+				for(U32 j = 0; j < 3; ++j)
+				{
+					p[j] = positions[tri[j]];
+				}
+				const Vec3 oldNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+				for(U32 j = 0; j < 3; ++j)
+				{
+					p[j] = positions[(tri[j] == from) ? to : tri[j]];
+				}
+				const Vec3 newNormal = (p[1] - p[0]).cross(p[2] - p[0]);
+
+				flips = oldNormal.dot(newNormal) <= 0.25f * oldNormal.getLength() * newNormal.getLength()
+					|| newNormal.getLength() <= EPSILON;
+			}
+
+			if(flips)
+			{
+				continue;
+			}
+
+			// Collapse
+			for(U32 i = 0; i < adj.getTriangleCount(from); ++i)
+			{
+				const U32 triIdx = adj.getTriangles(from)[i];
+				U32* tri = &out[triIdx * 3];
+				Bool degenerate = false;
+				for(U32 j = 0; j < 3; ++j)
+				{
+					degenerate = degenerate || tri[j] == to;
+					tri[j] = (tri[j] == from) ? to : tri[j];
+					touched[tri[j]] = true;
+				}
+
+				if(degenerate)
+				{
+					dead[triIdx] = true;
+					liveIndexCount -= 3;
+				}
+			}
+
+			touched[from] = true;
+			quadrics[to] += quadrics[from];
+			maxCollapseError = max(maxCollapseError, collapse.m_error);
+			++collapseCount;
+		}
+
+		// Remove the dead triangles
+		U32 outCount = 0;
+		for(U32 tri = 0; tri < triangleCount; ++tri)
+		{
+			if(!dead[tri])
+			{
+				memmove(&out[outCount], &out[tri * 3], 3 * sizeof(U32));
+				outCount += 3;
+			}
+		}
+		ANKI_ASSERT(outCount == liveIndexCount);
+		out.resize(outCount);
+
+		if(collapseCount == 0)
+		{
+			break;
+		}
+	}
+
+	return F32(sqrt(maxCollapseError));
+}
+
+/// Compute the bounding sphere and the normal cone of a meshlet.
+static void computeMeshletBounds(
+	ConstWeakArray<U32> indices, ConstWeakArray<Vec3> positions, MeshBinaryFile::Meshlet& meshlet)
+{
+	const U32 begin = meshlet.m_firstIndex;
+	const U32 end = begin + meshlet.m_indexCount;
+
+	// The sphere is around the center of the AABB
+	Vec3 aabbMin(MAX_F32);
+	Vec3 aabbMax(MIN_F32);
+	for(U32 i = begin; i < end; ++i)
+	{
+		aabbMin = aabbMin.min(positions[indices[i]]);
+		aabbMax = aabbMax.max(positions[indices[i]]);
+	}
+
+	const Vec3 center = (aabbMin + aabbMax) / 2.0f;
+	F32 radiusSquared = 0.0f;
+	for(U32 i = begin; i < end; ++i)
+	{
+		radiusSquared = max(radiusSquared, (positions[indices[i]] - center).getLengthSquared());
+	}
+
+	meshlet.m_sphereCenter = center;
+	meshlet.m_sphereRadius = sqrt(radiusSquared);
+
+	// The cone axis is the average of the normals and the cone contains all the normals
+	Vec3 axis(0.0f);
+	for(U32 i = begin; i < end; i += 3)
+	{
+		const Vec3& p0 = positions[indices[i + 0]];
+		const Vec3 normal = (positions[indices[i + 1]] - p0).cross(positions[indices[i + 2]] - p0);
+		const F32 length = normal.getLength();
+		if(length > EPSILON)
+		{
+			axis += normal / length;
+		}
+	}
+
+	const F32 axisLength = axis.getLength();
+	axis = (axisLength > EPSILON) ? axis / axisLength : Vec3(0.0f, 0.0f, 1.0f);
+
+	F32 minDot = (axisLength > EPSILON) ? 1.0f : -1.0f;
+	for(U32 i = begin; i < end; i += 3)
+	{
+		const Vec3& p0 = positions[indices[i + 0]];
+		const Vec3 normal = (positions[indices[i + 1]] - p0).cross(positions[indices[i + 2]] - p0);
+		const F32 length = normal.getLength();
+		if(length > EPSILON)
+		{
+			minDot = min(minDot, normal.dot(axis) / length);
+		}
+	}
+
+	meshlet.m_coneAxis = axis;
+
+	// Widening the cone by 90 degrees gives the directions that see the back of all the triangles. The test is against
+	// the sphere so the cutoff is the sine of the half angle. Cones that are too wide are not worth testing
+	meshlet.m_coneCutoff = (minDot > MESHLET_MIN_CONE_COSINE) ? sqrt(1.0f - minDot * minDot) : 1.0f;
+}
+
+void MeshOptimizer::buildMeshlets(
+	ConstWeakArray<U32> indices, ConstWeakArray<Vec3> positions, DynamicArrayAuto<MeshBinaryFile::Meshlet>& meshlets)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	meshlets.destroy();
+
+	// The index of the last meshlet that used a vertex
+	DynamicArrayAuto<U32> vertexMeshlet(m_alloc);
+	vertexMeshlet.create(positions.getSize(), MAX_U32);
+
+	U32 vertexCount = 0;
+	for(U32 i = 0; i < indices.getSize(); i += 3)
+	{
+		U32 newVertexCount = 0;
+		if(meshlets.getSize())
+		{
+			const U32 crntMeshlet = meshlets.getSize() - 1;
+			for(U32 j = 0; j < 3; ++j)
+			{
+				const U32 idx = indices[i + j];
+				newVertexCount += vertexMeshlet[idx] != crntMeshlet
+					&& (j < 1 || idx != indices[i]) && (j < 2 || idx != indices[i + 1]);
+			}
+		}
+
+		if(meshlets.getSize() == 0 || vertexCount + newVertexCount > MeshBinaryFile::MAX_MESHLET_VERTEX_COUNT
+			|| meshlets.getBack().m_indexCount == MeshBinaryFile::MAX_MESHLET_TRIANGLE_COUNT * 3)
+		{
+			MeshBinaryFile::Meshlet& meshlet = *meshlets.emplaceBack();
+			meshlet.m_firstIndex = i;
+			meshlet.m_indexCount = 0;
+			vertexCount = 0;
+		}
+
+		const U32 crntMeshlet = meshlets.getSize() - 1;
+		for(U32 j = 0; j < 3; ++j)
+		{
+			const U32 idx = indices[i + j];
+			ANKI_ASSERT(idx < positions.getSize());
+			if(vertexMeshlet[idx] != crntMeshlet)
+			{
+				vertexMeshlet[idx] = crntMeshlet;
+				++vertexCount;
+			}
+		}
+
+		meshlets.getBack().m_indexCount += 3;
+	}
+
+	for(MeshBinaryFile::Meshlet& meshlet : meshlets)
+	{
+		computeMeshletBounds(indices, positions, meshlet);
+	}
+}
+
+MeshOptimizerStats MeshOptimizer::computeStats(ConstWeakArray<U32> indices, U32 vertexCount, U32 vertexSize)
+{
+	MeshOptimizerStats stats;
+	if(indices.getSize() == 0)
+	{
+		return stats;
+	}
+
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// A small cache of lines for the vertex fetch
+	const U32 fetchCacheLineCount = 16;
+	const U32 lineCount = (vertexCount * vertexSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE;
+
+	FifoCache vertexCache(alloc, vertexCount, VERTEX_CACHE_SIZE);
+	FifoCache fetchCache(alloc, lineCount, fetchCacheLineCount);
+	DynamicArrayAuto<Bool> used(alloc);
+	used.create(vertexCount, false);
+	U32 misses = 0;
+	U32 usedCount = 0;
+	U32 fetchedLines = 0;
+	for(U32 idx : indices)
+	{
+		ANKI_ASSERT(idx < vertexCount);
+		usedCount += !used[idx];
+		used[idx] = true;
+
+		if(vertexCache.access(idx))
+		{
+			++misses;
+
+			const U32 firstLine = idx * vertexSize / CACHE_LINE_SIZE;
+			const U32 lastLine = ((idx + 1) * vertexSize - 1) / CACHE_LINE_SIZE;
+			for(U32 line = firstLine; line <= lastLine; ++line)
+			{
+				fetchedLines += fetchCache.access(line);
+			}
+		}
+	}
+
+	stats.m_acmr = F32(misses) / F32(indices.getSize() / 3);
+	stats.m_atvr = F32(misses) / F32(usedCount);
+	stats.m_overfetch = F32(fetchedLines * CACHE_LINE_SIZE) / F32(vertexCount * vertexSize);
+	return stats;
+}
+
+Format MeshOptimizer::choosePositionFormat(const Vec3& aabbMin, const Vec3& aabbMax, F32 maxError)
+{
+	const Vec3 dist = aabbMin.abs().max(aabbMax.abs());
+	const F32 maxDist = max(max(dist.x(), dist.y()), dist.z());
+
+	// The rounding error of a half float is half of the distance between 2 values. A half float has 10 bits of
+	// mantissa so for x in [2^(e-1), 2^e) the error is 2^(e-12)
+	const F32 halfFloatMax = 65504.0f;
+	I32 exponent;
+	frexp(maxDist, &exponent);
+	const F32 error = ldexp(1.0f, exponent - 12);
+
+	return (maxDist < halfFloatMax && error <= maxError) ? Format::R16G16B16A16_SFLOAT : Format::R32G32B32_SFLOAT;
+}
+
+} // end namespace anki
@@ -0,0 +1,98 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/resource/MeshLoader.h>
+#include <anki/Math.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+/// @addtogroup resource
+/// @{
+
+/// Statistics of an index buffer measured by simulating the GPU caches.
+class MeshOptimizerStats
+{
+public:
+	/// Average cache miss ratio. The vertex shader invocations per triangle. It's between 0.5 and 3.
+	F32 m_acmr = 0.0f;
+
+	/// Average transform to vertex ratio. The vertex shader invocations per vertex. 1 is the best.
+	F32 m_atvr = 0.0f;
+
+	/// The bytes of vertex data fetched divided by the size of the vertex buffer. 1 is the best.
+	F32 m_overfetch = 0.0f;
+};
+
+/// Offline optimizations of triangle lists for the mesh exporters. The indices are U32 and the vertices are referenced
+/// by their index. The output is the same triangles in a different order, or fewer triangles for the LODs.
+class MeshOptimizer
+{
+public:
+	/// The FIFO cache that the optimizations and the statistics assume.
+	static const U32 VERTEX_CACHE_SIZE = 16;
+
+	/// The cache line of the vertex fetch statistics.
+	static const U32 CACHE_LINE_SIZE = 64;
+
+	MeshOptimizer(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	/// Reorder the triangles so they reuse the vertices of the post-transform cache. It's Tipsify.
+	void optimizeVertexCache(WeakArray<U32> indices, U32 vertexCount);
+
+	/// Split the triangles into clusters where the vertex cache restarts and reorder the clusters so the ones that face
+	/// outwards are drawn first and occlude the rest. Call it after optimizeVertexCache().
+	void optimizeOverdraw(WeakArray<U32> indices, ConstWeakArray<Vec3> positions);
+
+	/// Renumber the vertices in the order the triangles use them so the vertex fetch reads memory in order. The
+	/// vertices that no triangle uses are dropped.
+	/// @param[out] newToOld The old index of every new vertex. Use it to reorder the vertex attributes.
+	void optimizeVertexFetch(WeakArray<U32> indices, U32 vertexCount, DynamicArrayAuto<U32>& newToOld);
+
+	/// Run all the optimizations above.
+	void optimize(WeakArray<U32> indices, ConstWeakArray<Vec3> positions, DynamicArrayAuto<U32>& newToOld);
+
+	/// Remove triangles by collapsing edges. The error of every collapse is measured with quadrics. The vertices on the
+	/// borders (and the seams of the attributes) don't move.
+	/// @param targetIndexCount Stop when the indices are that many or less.
+	/// @param maxError Don't collapse edges that move the surface more than that.
+	/// @param[out] out The indices of the new triangles. They reference the same vertices.
+	/// @return The max error of the collapses.
+	F32 simplify(ConstWeakArray<U32> indices,
+		ConstWeakArray<Vec3> positions,
+		U32 targetIndexCount,
+		F32 maxError,
+		DynamicArrayAuto<U32>& out);
+
+	/// Split the triangles to meshlets in the order they are. Call it after optimize() since that keeps the triangles
+	/// that share vertices close. A meshlet has MeshBinaryFile::MAX_MESHLET_VERTEX_COUNT unique vertices and
+	/// MeshBinaryFile::MAX_MESHLET_TRIANGLE_COUNT triangles at most.
+	/// @param[out] meshlets The new meshlets. Their first index is relative to the first of the indices.
+	void buildMeshlets(ConstWeakArray<U32> indices,
+		ConstWeakArray<Vec3> positions,
+		DynamicArrayAuto<MeshBinaryFile::Meshlet>& meshlets);
+
+	/// Measure how the triangles use the post-transform cache and the vertex fetch.
+	/// @param vertexSize The size of the vertices in the vertex buffer.
+	static MeshOptimizerStats computeStats(ConstWeakArray<U32> indices, U32 vertexCount, U32 vertexSize);
+
+	/// Choose the smallest format of the positions that MeshLoader accepts and doesn't move the vertices more than
+	/// maxError. It's R16G16B16A16_SFLOAT or R32G32B32_SFLOAT.
+	static Format choosePositionFormat(const Vec3& aabbMin, const Vec3& aabbMax, F32 maxError);
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+};
+/// @}
+
+} // end namespace anki
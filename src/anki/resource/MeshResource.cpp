@@ -51,7 +51,19 @@ MeshResource::MeshResource(ResourceManager* manager)
 MeshResource::~MeshResource()
 {
 	m_subMeshes.destroy(getAllocator());
+	m_meshlets.destroy(getAllocator());
 	m_vertBufferInfos.destroy(getAllocator());
+
+	UnifiedGeometryMemoryPool& pool = getManager().getUnifiedGeometryMemoryPool();
+	if(m_indexRange)
+	{
+		pool.free(m_indexRange);
+	}
+
+	if(m_vertRange)
+	{
+		pool.free(m_vertRange);
+	}
 }
 
 Bool MeshResource::isCompatible(const MeshResource& other) const
@@ -94,37 +106,45 @@ Error MeshResource::load(const ResourceFilename& filename, Bool async)
 		m_subMeshes[i].m_obb = Obb(obbCenter.xyz0(), Mat3x4::getIdentity(), obbExtend.xyz0());
 	}
 
+	// Get meshlets
+	if(loader.getMeshlets().getSize())
+	{
+		m_meshlets.create(getAllocator(), loader.getMeshlets().getSize());
+		for(U i = 0; i < m_meshlets.getSize(); ++i)
+		{
+			const MeshBinaryFile::Meshlet& in = loader.getMeshlets()[i];
+			Meshlet& out = m_meshlets[i];
+
+			out.m_sphere = Vec4(in.m_sphereCenter, in.m_sphereRadius);
+			out.m_cone = Vec4(in.m_coneAxis, in.m_coneCutoff);
+			out.m_firstIndex = in.m_firstIndex;
+			out.m_indexCount = in.m_indexCount;
+		}
+	}
+
 	// Index stuff
 	m_indexCount = header.m_totalIndexCount;
 	ANKI_ASSERT((m_indexCount % 3) == 0 && "Expecting triangles");
 	m_indexType = header.m_indexType;
 
-	const PtrSize indexBuffSize = m_indexCount * ((m_indexType == IndexType::U32) ? 4 : 2);
-
-	m_indexBuff = getManager().getGrManager().newBuffer(BufferInitInfo(indexBuffSize,
-		BufferUsageBit::INDEX | BufferUsageBit::BUFFER_UPLOAD_DESTINATION | BufferUsageBit::FILL,
-		BufferMapAccessBit::NONE,
-		"MeshIdx"));
+	m_indexBuffSize = m_indexCount * ((m_indexType == IndexType::U32) ? 4 : 2);
 
 	// Vertex stuff
 	m_vertCount = header.m_totalVertexCount;
 	m_vertBufferInfos.create(getAllocator(), header.m_vertexBufferCount);
 
-	PtrSize totalVertexBuffSize = 0;
+	m_vertBuffSize = 0;
 	for(U i = 0; i < header.m_vertexBufferCount; ++i)
 	{
-		alignRoundUp(VERTEX_BUFFER_ALIGNMENT, totalVertexBuffSize);
+		alignRoundUp(VERTEX_BUFFER_ALIGNMENT, m_vertBuffSize);
 
-		m_vertBufferInfos[i].m_offset = totalVertexBuffSize;
+		m_vertBufferInfos[i].m_offset = m_vertBuffSize;
 		m_vertBufferInfos[i].m_stride = header.m_vertexBuffers[i].m_vertexStride;
 
-		totalVertexBuffSize += m_vertCount * m_vertBufferInfos[i].m_stride;
+		m_vertBuffSize += m_vertCount * m_vertBufferInfos[i].m_stride;
 	}
 
-	m_vertBuff = getManager().getGrManager().newBuffer(BufferInitInfo(totalVertexBuffSize,
-		BufferUsageBit::VERTEX | BufferUsageBit::BUFFER_UPLOAD_DESTINATION | BufferUsageBit::FILL,
-		BufferMapAccessBit::NONE,
-		"MeshVert"));
+	createBuffers();
 
 	m_texChannelCount = !!header.m_vertexAttributes[VertexAttributeLocation::UV2].m_format ? 2 : 1;
 
@@ -153,11 +173,16 @@ Error MeshResource::load(const ResourceFilename& filename, Bool async)
 	cmdbinit.m_flags = CommandBufferFlag::SMALL_BATCH;
 	CommandBufferPtr cmdb = getManager().getGrManager().newCommandBuffer(cmdbinit);
 
-	cmdb->fillBuffer(m_vertBuff, 0, MAX_PTR_SIZE, 0);
-	cmdb->fillBuffer(m_indexBuff, 0, MAX_PTR_SIZE, 0);
+	const PtrSize vertOffset = (m_vertRange) ? m_vertRange.getOffset() : 0;
+	const PtrSize vertRange = (m_vertRange) ? m_vertRange.getSize() : MAX_PTR_SIZE;
+	const PtrSize indexOffset = (m_indexRange) ? m_indexRange.getOffset() : 0;
+	const PtrSize indexRange = (m_indexRange) ? m_indexRange.getSize() : MAX_PTR_SIZE;
+
+	cmdb->fillBuffer(m_vertBuff, vertOffset, vertRange, 0);
+	cmdb->fillBuffer(m_indexBuff, indexOffset, indexRange, 0);
 
-	cmdb->setBufferBarrier(m_vertBuff, BufferUsageBit::FILL, BufferUsageBit::VERTEX, 0, MAX_PTR_SIZE);
-	cmdb->setBufferBarrier(m_indexBuff, BufferUsageBit::FILL, BufferUsageBit::INDEX, 0, MAX_PTR_SIZE);
+	cmdb->setBufferBarrier(m_vertBuff, BufferUsageBit::FILL, BufferUsageBit::VERTEX, vertOffset, vertRange);
+	cmdb->setBufferBarrier(m_indexBuff, BufferUsageBit::FILL, BufferUsageBit::INDEX, indexOffset, indexRange);
 
 	cmdb->flush();
 
@@ -174,36 +199,71 @@ Error MeshResource::load(const ResourceFilename& filename, Bool async)
 	return Error::NONE;
 }
 
-Error MeshResource::loadAsync(MeshLoader& loader) const
+void MeshResource::createBuffers()
+{
+	UnifiedGeometryMemoryPool& pool = getManager().getUnifiedGeometryMemoryPool();
+	if(pool.isEnabled())
+	{
+		// Running out of space is not an error, the mesh will have its own buffers
+		if(!pool.allocate(m_indexBuffSize, sizeof(U32), m_indexRange))
+		{
+			if(!pool.allocate(m_vertBuffSize, VERTEX_BUFFER_ALIGNMENT, m_vertRange))
+			{
+				m_indexBuff = pool.getBuffer();
+				m_vertBuff = pool.getBuffer();
+				return;
+			}
+
+			pool.free(m_indexRange);
+		}
+	}
+
+	m_indexBuff = getManager().getGrManager().newBuffer(BufferInitInfo(m_indexBuffSize,
+		BufferUsageBit::INDEX | BufferUsageBit::BUFFER_UPLOAD_DESTINATION | BufferUsageBit::FILL,
+		BufferMapAccessBit::NONE,
+		"MeshIdx"));
+
+	m_vertBuff = getManager().getGrManager().newBuffer(BufferInitInfo(m_vertBuffSize,
+		BufferUsageBit::VERTEX | BufferUsageBit::BUFFER_UPLOAD_DESTINATION | BufferUsageBit::FILL,
+		BufferMapAccessBit::NONE,
+		"MeshVert"));
+}
+
+Error MeshResource::loadAsync(MeshLoader& loader)
 {
 	GrManager& gr = getManager().getGrManager();
 	TransferGpuAllocator& transferAlloc = getManager().getTransferGpuAllocator();
 	Array<TransferGpuAllocatorHandle, 2> handles;
 
+	// The ranges don't move until the upload is done
+	const PtrSize vertOffset = (m_vertRange) ? m_vertRange.getOffset() : 0;
+	const PtrSize indexOffset = (m_indexRange) ? m_indexRange.getOffset() : 0;
+
 	CommandBufferInitInfo cmdbinit;
 	cmdbinit.m_flags = CommandBufferFlag::SMALL_BATCH | CommandBufferFlag::TRANSFER_WORK;
 	CommandBufferPtr cmdb = gr.newCommandBuffer(cmdbinit);
 
 	// Set barriers
 	cmdb->setBufferBarrier(
-		m_vertBuff, BufferUsageBit::VERTEX, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, 0, MAX_PTR_SIZE);
+		m_vertBuff, BufferUsageBit::VERTEX, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, vertOffset, m_vertBuffSize);
 	cmdb->setBufferBarrier(
-		m_indexBuff, BufferUsageBit::INDEX, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, 0, MAX_PTR_SIZE);
+		m_indexBuff, BufferUsageBit::INDEX, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, indexOffset, m_indexBuffSize);
 
 	// Write index buffer
 	{
-		ANKI_CHECK(transferAlloc.allocate(m_indexBuff->getSize(), handles[1]));
+		ANKI_CHECK(transferAlloc.allocate(m_indexBuffSize, handles[1]));
 		void* data = handles[1].getMappedMemory();
 		ANKI_ASSERT(data);
 
-		ANKI_CHECK(loader.storeIndexBuffer(data, m_indexBuff->getSize()));
+		ANKI_CHECK(loader.storeIndexBuffer(data, m_indexBuffSize));
 
-		cmdb->copyBufferToBuffer(handles[1].getBuffer(), handles[1].getOffset(), m_indexBuff, 0, handles[1].getRange());
+		cmdb->copyBufferToBuffer(
+			handles[1].getBuffer(), handles[1].getOffset(), m_indexBuff, indexOffset, handles[1].getRange());
 	}
 
 	// Write vert buff
 	{
-		ANKI_CHECK(transferAlloc.allocate(m_vertBuff->getSize(), handles[0]));
+		ANKI_CHECK(transferAlloc.allocate(m_vertBuffSize, handles[0]));
 		U8* data = static_cast<U8*>(handles[0].getMappedMemory());
 		ANKI_ASSERT(data);
 
@@ -217,17 +277,18 @@ Error MeshResource::loadAsync(MeshLoader& loader) const
 			offset += m_vertBufferInfos[i].m_stride * m_vertCount;
 		}
 
-		ANKI_ASSERT(offset == m_vertBuff->getSize());
+		ANKI_ASSERT(offset == m_vertBuffSize);
 
 		// Copy
-		cmdb->copyBufferToBuffer(handles[0].getBuffer(), handles[0].getOffset(), m_vertBuff, 0, handles[0].getRange());
+		cmdb->copyBufferToBuffer(
+			handles[0].getBuffer(), handles[0].getOffset(), m_vertBuff, vertOffset, handles[0].getRange());
 	}
 
 	// Set barriers
 	cmdb->setBufferBarrier(
-		m_vertBuff, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, BufferUsageBit::VERTEX, 0, MAX_PTR_SIZE);
+		m_vertBuff, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, BufferUsageBit::VERTEX, vertOffset, m_vertBuffSize);
 	cmdb->setBufferBarrier(
-		m_indexBuff, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, BufferUsageBit::INDEX, 0, MAX_PTR_SIZE);
+		m_indexBuff, BufferUsageBit::BUFFER_UPLOAD_DESTINATION, BufferUsageBit::INDEX, indexOffset, m_indexBuffSize);
 
 	// Finalize
 	FencePtr fence;
@@ -236,6 +297,13 @@ Error MeshResource::loadAsync(MeshLoader& loader) const
 	transferAlloc.release(handles[0], fence);
 	transferAlloc.release(handles[1], fence);
 
+	if(m_vertRange)
+	{
+		UnifiedGeometryMemoryPool& pool = getManager().getUnifiedGeometryMemoryPool();
+		pool.setUploadFence(m_vertRange, fence);
+		pool.setUploadFence(m_indexRange, fence);
+	}
+
 	return Error::NONE;
 }
 
@@ -6,9 +6,11 @@
 #pragma once
 
 #include <anki/resource/ResourceObject.h>
+#include <anki/resource/UnifiedGeometryMemoryPool.h>
 #include <anki/Math.h>
 #include <anki/Gr.h>
 #include <anki/collision/Obb.h>
+#include <anki/util/WeakArray.h>
 
 namespace anki
 {
@@ -19,10 +21,22 @@ class MeshLoader;
 /// @addtogroup resource
 /// @{
 
-/// Mesh Resource. It contains the geometry packed in GPU buffers.
+/// Mesh Resource. It contains the geometry packed in GPU buffers. The buffers are ranges of the
+/// UnifiedGeometryMemoryPool if it has space so different meshes share buffers. Don't keep the offsets of the buffers
+/// between frames since the ranges may move.
 class MeshResource : public ResourceObject
 {
 public:
+	/// A small part of the mesh that the visibility tests can cull on its own. See MeshBinaryFile::Meshlet.
+	class Meshlet
+	{
+	public:
+		Vec4 m_sphere; ///< The center of the bounding sphere and its radius in w.
+		Vec4 m_cone; ///< The axis of the normal cone and the cutoff in w.
+		U32 m_firstIndex;
+		U32 m_indexCount;
+	};
+
 	/// Default constructor
 	MeshResource(ResourceManager* manager);
 
@@ -54,15 +68,32 @@ public:
 		return m_subMeshes.getSize();
 	}
 
+	/// Get the meshlets. It's empty if the mesh file doesn't have them.
+	ConstWeakArray<Meshlet> getMeshlets() const
+	{
+		return ConstWeakArray<Meshlet>(m_meshlets);
+	}
+
 	/// Get all info around vertex indices.
 	void getIndexBufferInfo(BufferPtr& buff, PtrSize& buffOffset, U32& indexCount, IndexType& indexType) const
 	{
 		buff = m_indexBuff;
-		buffOffset = 0;
+		buffOffset = (m_indexRange) ? m_indexRange.getOffset() : 0;
 		indexCount = m_indexCount;
 		indexType = m_indexType;
 	}
 
+	/// Return true if the indices and the vertices are ranges of the UnifiedGeometryMemoryPool.
+	Bool isInUnifiedGeometryMemoryPool() const
+	{
+		return m_indexRange && m_vertRange;
+	}
+
+	IndexType getIndexType() const
+	{
+		return m_indexType;
+	}
+
 	/// Get the number of logical vertex buffers.
 	U32 getVertexBufferCount() const
 	{
@@ -73,7 +104,7 @@ public:
 	void getVertexBufferInfo(const U32 buffIdx, BufferPtr& buff, PtrSize& offset, PtrSize& stride) const
 	{
 		buff = m_vertBuff;
-		offset = m_vertBufferInfos[buffIdx].m_offset;
+		offset = ((m_vertRange) ? m_vertRange.getOffset() : 0) + m_vertBufferInfos[buffIdx].m_offset;
 		stride = m_vertBufferInfos[buffIdx].m_stride;
 	}
 
@@ -119,10 +150,13 @@ protected:
 		Obb m_obb;
 	};
 	DynamicArray<SubMesh> m_subMeshes;
+	DynamicArray<Meshlet> m_meshlets;
 
 	// Index stuff
 	U32 m_indexCount = 0;
 	BufferPtr m_indexBuff;
+	UnifiedGeometryMemoryPoolHandle m_indexRange; ///< If it's valid m_indexBuff is the buffer of the pool.
+	PtrSize m_indexBuffSize = 0;
 	IndexType m_indexType = IndexType::COUNT;
 
 	// Vertex stuff
@@ -130,7 +164,7 @@ protected:
 
 	struct VertBuffInfo
 	{
-		U32 m_offset; ///< Offset from the base of m_vertBuff.
+		U32 m_offset; ///< Offset from the base of the vertex data.
 		U32 m_stride;
 	};
 	DynamicArray<VertBuffInfo> m_vertBufferInfos;
@@ -144,12 +178,17 @@ protected:
 	Array<AttribInfo, U(VertexAttributeLocation::COUNT)> m_attribs;
 
 	BufferPtr m_vertBuff;
+	UnifiedGeometryMemoryPoolHandle m_vertRange; ///< If it's valid m_vertBuff is the buffer of the pool.
+	PtrSize m_vertBuffSize = 0;
 	U8 m_texChannelCount = 0;
 
 	// Other
 	Obb m_obb;
 
-	ANKI_USE_RESULT Error loadAsync(MeshLoader& loader) const;
+	ANKI_USE_RESULT Error loadAsync(MeshLoader& loader);
+
+	/// Allocate the buffers from the UnifiedGeometryMemoryPool or create new ones if it doesn't have space.
+	void createBuffers();
 };
 /// @}
 
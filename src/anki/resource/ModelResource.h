@@ -100,6 +100,11 @@ public:
 		return *m_meshes[key.m_lod];
 	}
 
+	U32 getMeshCount() const
+	{
+		return m_meshCount;
+	}
+
 	const ModelResource& getModel() const
 	{
 		ANKI_ASSERT(m_model);
@@ -7,7 +7,9 @@
 #include <anki/util/Filesystem.h>
 #include <anki/misc/ConfigSet.h>
 #include <anki/core/Trace.h>
-#include <contrib/minizip/unzip.h>
+#include <anki/resource/ZipArchive.h>
+#include <anki/util/System.h>
+#include <cstring>
 
 namespace anki
 {
@@ -56,88 +58,160 @@ public:
 	{
 		return m_file.getSize();
 	}
+
+	ANKI_USE_RESULT Error map(const void*& data) override
+	{
+		return m_file.map(data);
+	}
 };
 
-/// ZIP file
-class ZipResourceFile final : public ResourceFile
+/// A file of a ZipArchive. The stored files are read from the mapped archive. The compressed files are decompressed in
+/// chunks. The decompression threads decompress them ahead of the reads and the reads decompress the chunks they need
+/// if no thread did yet.
+class ZipArchiveResourceFile final : public ResourceFile
 {
 public:
-	unzFile m_archive = nullptr;
+	const ZipArchive* m_archive = nullptr;
+	U32 m_entryIdx = MAX_U32;
 	PtrSize m_size = 0;
+	PtrSize m_pos = 0;
+	const U8* m_data = nullptr; ///< All the contents. If it's compressed they are valid as the chunks decompress.
 
-	ZipResourceFile(GenericMemoryPoolAllocator<U8> alloc)
+	// The decompression state
+	enum class ChunkState : U8
+	{
+		PENDING,
+		DECOMPRESSING,
+		DONE,
+		FAILED
+	};
+
+	DynamicArray<ChunkState> m_chunkStates;
+	U32 m_nextPendingChunk = 0; ///< All the chunks before that are not pending.
+	Mutex m_mtx; ///< Protects the decompression state.
+	ConditionVariable m_condVar;
+
+	ZipArchiveResourceFile(GenericMemoryPoolAllocator<U8> alloc)
 		: ResourceFile(alloc)
 	{
 	}
 
-	~ZipResourceFile()
+	~ZipArchiveResourceFile()
 	{
-		if(m_archive)
+		if(m_chunkStates.getSize())
 		{
-			// It's open
-			unzClose(m_archive);
-			m_archive = nullptr;
-			m_size = 0;
+			getAllocator().getMemoryPool().free(const_cast<U8*>(m_data));
+			m_chunkStates.destroy(getAllocator());
 		}
 	}
 
-	ANKI_USE_RESULT Error open(const CString& archive, const CString& archivedFname)
+	void open(const ZipArchive& archive, U32 entryIdx)
 	{
-		// Open archive
-		m_archive = unzOpen(&archive[0]);
-		if(m_archive == nullptr)
-		{
-			ANKI_RESOURCE_LOGE("Failed to open archive");
-			return Error::FILE_ACCESS;
-		}
+		m_archive = &archive;
+		m_entryIdx = entryIdx;
+
+		const ZipArchiveEntry& entry = archive.getEntry(entryIdx);
+		m_size = entry.m_uncompressedSize;
 
-		// Locate archived
-		const int caseSensitive = 1;
-		if(unzLocateFile(m_archive, &archivedFname[0], caseSensitive) != UNZ_OK)
+		if(!entry.m_compressed)
 		{
-			ANKI_RESOURCE_LOGE("Failed to locate file in archive");
-			return Error::FILE_ACCESS;
+			// Zero copy
+			m_data = archive.getEntryData(entryIdx);
 		}
-
-		// Open file
-		if(unzOpenCurrentFile(m_archive) != UNZ_OK)
+		else
 		{
-			ANKI_RESOURCE_LOGE("unzOpenCurrentFile() failed");
-			return Error::FILE_ACCESS;
+			m_data = static_cast<U8*>(getAllocator().getMemoryPool().allocate(m_size, 16));
+			m_chunkStates.create(getAllocator(), entry.m_chunkCount, ChunkState::PENDING);
 		}
+	}
 
-		// Get size just in case
-		unz_file_info zinfo;
-		zinfo.uncompressed_size = 0;
-		unzGetCurrentFileInfo(m_archive, &zinfo, nullptr, 0, nullptr, 0, nullptr, 0);
-		m_size = zinfo.uncompressed_size;
-		ANKI_ASSERT(m_size != 0);
+	Bool isCompressed() const
+	{
+		return m_chunkStates.getSize() > 0;
+	}
 
-		return Error::NONE;
+	/// Decompress a chunk in this thread or wait for another thread to do it.
+	ANKI_USE_RESULT Error waitChunk(U32 chunk)
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		while(1)
+		{
+			switch(m_chunkStates[chunk])
+			{
+			case ChunkState::PENDING:
+				return decompressChunk(chunk);
+			case ChunkState::DECOMPRESSING:
+				m_condVar.wait(m_mtx);
+				break;
+			case ChunkState::DONE:
+				return Error::NONE;
+			default:
+				return Error::FUNCTION_FAILED;
+			}
+		}
 	}
 
-	void close()
+	/// Decompress the pending chunks in order. The decompression threads call it.
+	void decompressPendingChunks()
 	{
-		if(m_archive)
+		LockGuard<Mutex> lock(m_mtx);
+		while(1)
 		{
-			unzClose(m_archive);
-			m_archive = nullptr;
-			m_size = 0;
+			while(m_nextPendingChunk < m_chunkStates.getSize()
+				  && m_chunkStates[m_nextPendingChunk] != ChunkState::PENDING)
+			{
+				++m_nextPendingChunk;
+			}
+
+			if(m_nextPendingChunk == m_chunkStates.getSize())
+			{
+				break;
+			}
+
+			// On failure the reader will get the error from the chunk state
+			const Error err = decompressChunk(m_nextPendingChunk);
+			(void)err;
 		}
 	}
 
+	/// Decompress a pending chunk. The lock should be held and it will be released while decompressing.
+	ANKI_USE_RESULT Error decompressChunk(U32 chunk)
+	{
+		ANKI_ASSERT(m_chunkStates[chunk] == ChunkState::PENDING);
+		m_chunkStates[chunk] = ChunkState::DECOMPRESSING;
+
+		m_mtx.unlock();
+		const U32 chunkSize = m_archive->getEntry(m_entryIdx).m_chunkSize;
+		U8* out = const_cast<U8*>(m_data) + PtrSize(chunk) * chunkSize;
+		const Error err = m_archive->decompressChunk(m_entryIdx, chunk, out);
+		m_mtx.lock();
+
+		m_chunkStates[chunk] = (err) ? ChunkState::FAILED : ChunkState::DONE;
+		m_condVar.notifyAll();
+		return err;
+	}
+
 	ANKI_USE_RESULT Error read(void* buff, PtrSize size) override
 	{
 		ANKI_TRACE_SCOPED_EVENT(RSRC_FILE_READ);
 
-		I64 readSize = unzReadCurrentFile(m_archive, buff, size);
-
-		if(I64(size) != readSize)
+		if(m_pos + size > m_size)
 		{
 			ANKI_RESOURCE_LOGE("File read failed");
 			return Error::FILE_ACCESS;
 		}
 
+		if(isCompressed() && size > 0)
+		{
+			const U32 chunkSize = m_archive->getEntry(m_entryIdx).m_chunkSize;
+			for(U32 chunk = U32(m_pos / chunkSize); chunk <= U32((m_pos + size - 1) / chunkSize); ++chunk)
+			{
+				ANKI_CHECK(waitChunk(chunk));
+			}
+		}
+
+		memcpy(buff, m_data + m_pos, size);
+		m_pos += size;
 		return Error::NONE;
 	}
 
@@ -164,41 +238,73 @@ public:
 
 	ANKI_USE_RESULT Error seek(PtrSize offset, SeekOrigin origin) override
 	{
-		// Rewind if needed
-		if(origin == SeekOrigin::BEGINNING)
+		PtrSize pos;
+		switch(origin)
 		{
-			if(unzCloseCurrentFile(m_archive) || unzOpenCurrentFile(m_archive))
-			{
-				ANKI_RESOURCE_LOGE("Rewind failed");
-				return Error::FUNCTION_FAILED;
-			}
+		case SeekOrigin::BEGINNING:
+			pos = offset;
+			break;
+		case SeekOrigin::CURRENT:
+			pos = m_pos + offset;
+			break;
+		default:
+			pos = m_size + offset;
 		}
 
-		// Move forward by reading dummy data
-		Array<char, 128> buff;
-		while(offset != 0)
+		if(pos > m_size)
 		{
-			PtrSize toRead = min(offset, sizeof(buff));
-			ANKI_CHECK(read(&buff[0], toRead));
-			offset -= toRead;
+			ANKI_RESOURCE_LOGE("Seek failed");
+			return Error::FUNCTION_FAILED;
 		}
 
+		m_pos = pos;
 		return Error::NONE;
 	}
 
 	PtrSize getSize() const override
 	{
-		ANKI_ASSERT(m_size > 0);
 		return m_size;
 	}
+
+	ANKI_USE_RESULT Error map(const void*& data) override
+	{
+		for(U32 chunk = 0; chunk < m_chunkStates.getSize(); ++chunk)
+		{
+			ANKI_CHECK(waitChunk(chunk));
+		}
+
+		data = m_data;
+		return Error::NONE;
+	}
 };
 
 ResourceFilesystem::~ResourceFilesystem()
 {
+	// Stop the threads
+	{
+		LockGuard<Mutex> lock(m_decompressionMtx);
+		m_quitDecompressionThreads = true;
+		m_decompressionCondVar.notifyAll();
+	}
+
+	for(Thread* thread : m_decompressionThreads)
+	{
+		if(thread->join())
+		{
+			ANKI_RESOURCE_LOGE("Decompression thread failed");
+		}
+
+		m_alloc.deleteInstance(thread);
+	}
+
+	m_decompressionThreads.destroy(m_alloc);
+	m_decompressionQueue.destroy(m_alloc);
+
 	for(Path& p : m_paths)
 	{
 		p.m_files.destroy(m_alloc);
 		p.m_path.destroy(m_alloc);
+		m_alloc.deleteInstance(p.m_archive);
 	}
 
 	m_paths.destroy(m_alloc);
@@ -223,6 +329,63 @@ Error ResourceFilesystem::init(const ConfigSet& config, const CString& cacheDir)
 
 	addCachePath(cacheDir);
 
+	// Start the decompression threads
+	const U32 threadCount = U32(config.getNumber("rsrc.archiveDecompressionThreadCount"));
+	m_decompressionThreads.create(m_alloc, threadCount);
+	for(U32 i = 0; i < threadCount; ++i)
+	{
+		m_decompressionThreads[i] = m_alloc.newInstance<Thread>("Decompression");
+		m_decompressionThreads[i]->start(this, decompressionThreadMain);
+	}
+
+	return Error::NONE;
+}
+
+void ResourceFilesystem::queueDecompression(ResourceFile* file, U32 chunkCount)
+{
+	// The thread that reads the file decompresses too so one chunk doesn't need help
+	const U32 jobCount = min<U32>(chunkCount - 1, m_decompressionThreads.getSize());
+	if(jobCount == 0)
+	{
+		return;
+	}
+
+	LockGuard<Mutex> lock(m_decompressionMtx);
+	for(U32 i = 0; i < jobCount; ++i)
+	{
+		m_decompressionQueue.emplaceBack(m_alloc, ResourceFilePtr(file));
+	}
+
+	m_decompressionCondVar.notifyAll();
+}
+
+Error ResourceFilesystem::decompressionThreadMain(ThreadCallbackInfo& info)
+{
+	ResourceFilesystem& self = *static_cast<ResourceFilesystem*>(info.m_userData);
+
+	while(1)
+	{
+		ResourceFilePtr file;
+
+		{
+			LockGuard<Mutex> lock(self.m_decompressionMtx);
+			while(self.m_decompressionQueue.isEmpty() && !self.m_quitDecompressionThreads)
+			{
+				self.m_decompressionCondVar.wait(self.m_decompressionMtx);
+			}
+
+			if(self.m_quitDecompressionThreads)
+			{
+				break;
+			}
+
+			file = self.m_decompressionQueue.getFront();
+			self.m_decompressionQueue.popFront(self.m_alloc);
+		}
+
+		static_cast<ZipArchiveResourceFile&>(*file).decompressPendingChunks();
+	}
+
 	return Error::NONE;
 }
 
@@ -244,49 +407,21 @@ Error ResourceFilesystem::addNewPath(const CString& path)
 	if(pos != CString::NPOS && pos == path.getLength() - extension.getLength())
 	{
 		// It's an archive
-
-		// Open
-		unzFile zfile = unzOpen(&path[0]);
-		if(!zfile)
+		ZipArchive* archive = m_alloc.newInstance<ZipArchive>(m_alloc);
+		const Error err = archive->open(path);
+		if(err)
 		{
-			ANKI_RESOURCE_LOGE("Failed to open archive");
-			return Error::FILE_ACCESS;
-		}
-
-		// List files
-		if(unzGoToFirstFile(zfile) != UNZ_OK)
-		{
-			unzClose(zfile);
-			ANKI_RESOURCE_LOGE("unzGoToFirstFile() failed. Empty archive?");
-			return Error::FILE_ACCESS;
+			m_alloc.deleteInstance(archive);
+			return err;
 		}
 
 		Path p;
 		p.m_isArchive = true;
+		p.m_archive = archive;
 		p.m_path.sprintf(m_alloc, "%s", &path[0]);
-
-		do
-		{
-			Array<char, 1024> filename;
-
-			unz_file_info info;
-			if(unzGetCurrentFileInfo(zfile, &info, &filename[0], filename.getSize(), nullptr, 0, nullptr, 0) != UNZ_OK)
-			{
-				unzClose(zfile);
-				ANKI_RESOURCE_LOGE("unzGetCurrentFileInfo() failed");
-				return Error::FILE_ACCESS;
-			}
-
-			// If compressed size is zero then it's a dir
-			if(info.uncompressed_size > 0)
-			{
-				p.m_files.pushBackSprintf(m_alloc, "%s", &filename[0]);
-				++fileCount;
-			}
-		} while(unzGoToNextFile(zfile) == UNZ_OK);
+		fileCount = archive->getEntryCount();
 
 		m_paths.emplaceFront(m_alloc, std::move(p));
-		unzClose(zfile);
 	}
 	else
 	{
@@ -333,6 +468,7 @@ Error ResourceFilesystem::addNewPath(const CString& path)
 Error ResourceFilesystem::openFile(const ResourceFilename& filename, ResourceFilePtr& filePtr)
 {
 	ResourceFile* rfile = nullptr;
+	U32 chunkCount = 0; ///< The chunks of a compressed archived file.
 	Error err = Error::NONE;
 
 	// Search for the fname in reverse order
@@ -358,23 +494,31 @@ Error ResourceFilesystem::openFile(const ResourceFilename& filename, ResourceFil
 		{
 			// In data path or archive
 
-			for(const String& pfname : p.m_files)
+			if(p.m_isArchive)
 			{
-				if(pfname != filename)
-				{
-					continue;
-				}
-
-				// Found
-				if(p.m_isArchive)
+				const U32 entryIdx = p.m_archive->findEntry(filename);
+				if(entryIdx != MAX_U32)
 				{
-					ZipResourceFile* file = m_alloc.newInstance<ZipResourceFile>(m_alloc);
+					ZipArchiveResourceFile* file = m_alloc.newInstance<ZipArchiveResourceFile>(m_alloc);
 					rfile = file;
 
-					err = file->open(p.m_path.toCString(), filename);
+					file->open(*p.m_archive, entryIdx);
+					if(file->isCompressed())
+					{
+						chunkCount = p.m_archive->getEntry(entryIdx).m_chunkCount;
+					}
 				}
-				else
+			}
+			else
+			{
+				for(const String& pfname : p.m_files)
 				{
+					if(pfname != filename)
+					{
+						continue;
+					}
+
+					// Found
 					StringAuto newFname(m_alloc);
 					newFname.sprintf("%s/%s", &p.m_path[0], &filename[0]);
 
@@ -410,6 +554,12 @@ Error ResourceFilesystem::openFile(const ResourceFilename& filename, ResourceFil
 
 	// Done
 	filePtr.reset(rfile);
+
+	if(chunkCount)
+	{
+		queueDecompression(rfile, chunkCount);
+	}
+
 	return Error::NONE;
 }
 
@@ -10,12 +10,15 @@
 #include <anki/util/StringList.h>
 #include <anki/util/File.h>
 #include <anki/util/Ptr.h>
+#include <anki/util/Thread.h>
+#include <anki/util/DynamicArray.h>
 
 namespace anki
 {
 
 // Forward
 class ConfigSet;
+class ZipArchive;
 
 /// @addtogroup resource
 /// @{
@@ -55,6 +58,15 @@ public:
 	/// Get the size of the file.
 	virtual PtrSize getSize() const = 0;
 
+	/// Map the whole file to memory. Not all files can be mapped.
+	/// @param[out] data The contents of the file or nullptr if the file can't be mapped. It's valid while the file is
+	///                  alive.
+	virtual ANKI_USE_RESULT Error map(const void*& data)
+	{
+		data = nullptr;
+		return Error::NONE;
+	}
+
 	Atomic<I32>& getRefcount()
 	{
 		return m_refcount;
@@ -89,6 +101,12 @@ public:
 	/// Search the path list to find the file. Then open the file for reading. It's thread-safe.
 	ANKI_USE_RESULT Error openFile(const ResourceFilename& filename, ResourceFilePtr& file);
 
+	/// The number of threads that decompress the compressed files of the archives ahead of the reads.
+	U32 getDecompressionThreadCount() const
+	{
+		return m_decompressionThreads.getSize();
+	}
+
 #if !ANKI_TESTS
 private:
 #endif
@@ -97,6 +115,7 @@ private:
 	public:
 		StringList m_files; ///< Files inside the directory.
 		String m_path; ///< A directory or an archive.
+		ZipArchive* m_archive = nullptr;
 		Bool m_isArchive = false;
 		Bool m_isCache = false;
 
@@ -105,17 +124,21 @@ private:
 		Path(Path&& b)
 			: m_files(std::move(b.m_files))
 			, m_path(std::move(b.m_path))
+			, m_archive(b.m_archive)
 			, m_isArchive(std::move(b.m_isArchive))
 			, m_isCache(std::move(b.m_isCache))
 		{
+			b.m_archive = nullptr;
 		}
 
 		Path& operator=(Path&& b)
 		{
 			m_files = std::move(b.m_files);
 			m_path = std::move(b.m_path);
+			m_archive = b.m_archive;
 			m_isArchive = std::move(b.m_isArchive);
 			m_isCache = std::move(b.m_isCache);
+			b.m_archive = nullptr;
 			return *this;
 		}
 	};
@@ -124,10 +147,21 @@ private:
 	List<Path> m_paths;
 	String m_cacheDir;
 
+	DynamicArray<Thread*> m_decompressionThreads;
+	Mutex m_decompressionMtx;
+	ConditionVariable m_decompressionCondVar;
+	List<ResourceFilePtr> m_decompressionQueue; ///< Compressed files that have chunks to decompress.
+	Bool m_quitDecompressionThreads = false;
+
 	/// Add a filesystem path or an archive. The path is read-only.
 	ANKI_USE_RESULT Error addNewPath(const CString& path);
 
 	void addCachePath(const CString& path);
+
+	/// Queue a compressed file so the decompression threads decompress its chunks.
+	void queueDecompression(ResourceFile* file, U32 chunkCount);
+
+	static Error decompressionThreadMain(ThreadCallbackInfo& info);
 };
 /// @}
 
@@ -13,12 +13,15 @@
 #include <anki/resource/DummyResource.h>
 #include <anki/resource/ParticleEmitterResource.h>
 #include <anki/resource/TextureResource.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/UnifiedGeometryMemoryPool.h>
 #include <anki/resource/GenericResource.h>
 #include <anki/resource/TextureAtlasResource.h>
 #include <anki/resource/ShaderProgramResource.h>
 #include <anki/util/Logger.h>
 #include <anki/misc/ConfigSet.h>
 #include <anki/gr/ShaderCompiler.h>
+#include <anki/util/Filesystem.h>
 
 namespace anki
 {
@@ -33,6 +36,10 @@ ResourceManager::~ResourceManager()
 	m_alloc.deleteInstance(m_asyncLoader);
 	m_alloc.deleteInstance(m_transferGpuAlloc);
 	m_alloc.deleteInstance(m_shaderCompiler);
+
+	// After the async loader since its tasks might hold textures and meshes
+	m_alloc.deleteInstance(m_textureStreamer);
+	m_alloc.deleteInstance(m_geometryPool);
 }
 
 Error ResourceManager::init(ResourceManagerInitInfo& init)
@@ -40,7 +47,7 @@ Error ResourceManager::init(ResourceManagerInitInfo& init)
 	m_gr = init.m_gr;
 	m_physics = init.m_physics;
 	m_fs = init.m_resourceFs;
-	m_alloc = ResourceAllocator<U8>(init.m_allocCallback, init.m_allocCallbackData);
+	m_alloc = ResourceAllocator<U8>(init.m_allocCallback, init.m_allocCallbackData, true);
 
 	m_tmpAlloc = TempResourceAllocator<U8>(init.m_allocCallback, init.m_allocCallbackData, 10 * 1024 * 1024);
 
@@ -60,16 +67,56 @@ Error ResourceManager::init(ResourceManagerInitInfo& init)
 
 	// Init the thread
 	m_asyncLoader = m_alloc.newInstance<AsyncLoader>();
-	m_asyncLoader->init(m_alloc);
+	m_asyncLoader->init(m_alloc, U32(init.m_config->getNumber("rsrc.asyncLoaderThreadCount")));
 
 	m_transferGpuAlloc = m_alloc.newInstance<TransferGpuAllocator>();
 	ANKI_CHECK(m_transferGpuAlloc->init(init.m_config->getNumber("rsrc.transferScratchMemorySize"), m_gr, m_alloc));
 
 	m_shaderCompiler = m_alloc.newInstance<ShaderCompilerCache>(m_alloc, m_cacheDir.toCString());
 
+	m_textureStreamer = m_alloc.newInstance<TextureStreamer>(this);
+	m_textureStreamer->init(*init.m_config);
+
+	m_geometryPool = m_alloc.newInstance<UnifiedGeometryMemoryPool>(this);
+	ANKI_CHECK(m_geometryPool->init(*init.m_config));
+
+	// Use the precompiled shaders if there are any
+	StringAuto archiveFname(m_alloc);
+	archiveFname.sprintf("%s/%s", m_cacheDir.cstr(), ShaderBinaryArchiveFile::DEFAULT_FILENAME);
+	if(fileExists(archiveFname.toCString()))
+	{
+		ANKI_CHECK(m_shaderCompiler->loadArchive(archiveFname.toCString()));
+	}
+
 	return Error::NONE;
 }
 
+Error ResourceManager::loadStreamedTexture(const CString& filename, TextureResourcePtr& out, Bool async)
+{
+	return loadResourceInternal(filename, out, async, [](TextureResource& tex) { tex.m_streamingAllowed = true; });
+}
+
+void ResourceManager::beginTempPoolUse()
+{
+	LockGuard<Mutex> lock(m_tmpPoolMtx);
+	++m_tmpPoolUserCount;
+}
+
+void ResourceManager::endTempPoolUse()
+{
+	LockGuard<Mutex> lock(m_tmpPoolMtx);
+	ANKI_ASSERT(m_tmpPoolUserCount > 0);
+	--m_tmpPoolUserCount;
+
+	// Reset the memory pool if no-one is using it. The loads should have freed all their temp memory by then
+	StackMemoryPool& pool = m_tmpAlloc.getMemoryPool();
+	ANKI_ASSERT((m_tmpPoolUserCount > 0 || pool.getAllocationsCount() == 0) && "Forgot to deallocate");
+	if(m_tmpPoolUserCount == 0 && pool.getAllocationsCount() == 0)
+	{
+		pool.reset();
+	}
+}
+
 U64 ResourceManager::getAsyncTaskCompletedCount() const
 {
 	return m_asyncLoader->getCompletedTaskCount();
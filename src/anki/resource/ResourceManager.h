@@ -6,7 +6,9 @@
 #pragma once
 
 #include <anki/resource/TransferGpuAllocator.h>
-#include <anki/util/List.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/Thread.h>
 #include <anki/util/Functions.h>
 #include <anki/util/String.h>
 
@@ -21,11 +23,14 @@ class ResourceManager;
 class AsyncLoader;
 class ResourceManagerModel;
 class ShaderCompilerCache;
+class TextureStreamer;
+class UnifiedGeometryMemoryPool;
 
 /// @addtogroup resource
 /// @{
 
-/// Manage resources of a certain type
+/// Manage resources of a certain type. The resources are indexed by the hash of their filename.
+/// @note It's thread-safe.
 template<typename Type>
 class TypeResourceManager
 {
@@ -36,28 +41,63 @@ protected:
 
 	~TypeResourceManager()
 	{
-		ANKI_ASSERT(m_ptrs.isEmpty() && "Forgot to delete some resources");
-		m_ptrs.destroy(m_alloc);
+		ANKI_ASSERT(m_map.isEmpty() && m_overflow.isEmpty() && "Forgot to delete some resources");
+		m_map.destroy(m_alloc);
+		m_overflow.destroy(m_alloc);
 	}
 
-	Type* findLoadedResource(const CString& filename)
+	/// Find a loaded resource and take a reference to it. The caller needs to release that reference.
+	/// @return nullptr if it's not loaded or if it's about to be deleted.
+	Type* findLoadedResource(const CString& filename, U64 filenameHash)
 	{
-		auto it = find(filename);
-		return (it != m_ptrs.end()) ? *it : nullptr;
+		LockGuard<Mutex> lock(m_mtx);
+		Type* ptr = find(filename, filenameHash);
+		return (ptr && tryRetain(ptr)) ? ptr : nullptr;
 	}
 
+	/// Register a new resource.
+	/// @note If two threads load the same resource at the same time both copies will be registered. That's wasteful but
+	///       rare and harmless.
 	void registerResource(Type* ptr)
 	{
 		ANKI_ASSERT(ptr->getRefcount().load() == 0);
-		ANKI_ASSERT(find(ptr->getFilename()) == m_ptrs.getEnd());
-		m_ptrs.pushBack(m_alloc, ptr);
+		LockGuard<Mutex> lock(m_mtx);
+
+		// The slot of the map might be taken by a hash collision, by a resource that is about to be deleted or by
+		// another copy of the same resource
+		auto it = m_map.find(ptr->getFilenameHash());
+		if(it == m_map.getEnd())
+		{
+			m_map.emplace(m_alloc, ptr->getFilenameHash(), ptr);
+		}
+		else
+		{
+			m_overflow.emplaceBack(m_alloc, ptr);
+		}
 	}
 
 	void unregisterResource(Type* ptr)
 	{
-		auto it = find(ptr->getFilename());
-		ANKI_ASSERT(it != m_ptrs.end());
-		m_ptrs.erase(m_alloc, it);
+		LockGuard<Mutex> lock(m_mtx);
+
+		auto it = m_map.find(ptr->getFilenameHash());
+		if(it != m_map.getEnd() && *it == ptr)
+		{
+			m_map.erase(m_alloc, it);
+			return;
+		}
+
+		for(U32 i = 0; i < m_overflow.getSize(); ++i)
+		{
+			if(m_overflow[i] == ptr)
+			{
+				m_overflow[i] = m_overflow.getBack();
+				m_overflow.resize(m_alloc, m_overflow.getSize() - 1);
+				return;
+			}
+		}
+
+		ANKI_ASSERT(!"Resource not registered");
 	}
 
 	void init(ResourceAllocator<U8> alloc)
@@ -66,24 +106,45 @@ protected:
 	}
 
 private:
-	using Container = List<Type*>;
-
 	ResourceAllocator<U8> m_alloc;
-	Container m_ptrs;
+	HashMap<U64, Type*> m_map;
+	DynamicArray<Type*> m_overflow; ///< Resources that couldn't go to m_map. It's almost always empty.
+	Mutex m_mtx;
 
-	typename Container::Iterator find(const CString& filename)
+	/// Find a resource. It may return a resource that is about to be deleted.
+	Type* find(const CString& filename, U64 filenameHash)
 	{
-		typename Container::Iterator it;
+		auto it = m_map.find(filenameHash);
+		if(it != m_map.getEnd() && (*it)->getFilename() == filename && (*it)->getRefcount().load() > 0)
+		{
+			return *it;
+		}
+
+		for(Type* ptr : m_overflow)
+		{
+			if(ptr->getFilenameHash() == filenameHash && ptr->getFilename() == filename
+				&& ptr->getRefcount().load() > 0)
+			{
+				return ptr;
+			}
+		}
 
-		for(it = m_ptrs.getBegin(); it != m_ptrs.getEnd(); ++it)
+		return nullptr;
+	}
+
+	/// Increase the refcount only if the resource is not about to be deleted.
+	static Bool tryRetain(Type* ptr)
+	{
+		I32 refcount = ptr->getRefcount().load();
+		while(refcount > 0)
 		{
-			if((*it)->getFilename() == filename)
+			if(ptr->getRefcount().compareExchange(refcount, refcount + 1))
 			{
-				break;
+				return true;
 			}
 		}
 
-		return it;
+		return false;
 	}
 };
 
@@ -123,9 +184,17 @@ public:
 
 	ANKI_USE_RESULT Error init(ResourceManagerInitInfo& init);
 
-	/// Load a resource.
+	/// Load a resource. It's thread-safe.
 	template<typename T>
-	ANKI_USE_RESULT Error loadResource(const CString& filename, ResourcePtr<T>& out, Bool async = true);
+	ANKI_USE_RESULT Error loadResource(const CString& filename, ResourcePtr<T>& out, Bool async = true)
+	{
+		return loadResourceInternal(filename, out, async, [](T&) {});
+	}
+
+	/// Load a texture that the TextureStreamer can stream. A streamed texture stays at its mip tail until its users
+	/// call TextureResource::reportScreenSpaceUsage() so only those users should load textures that way. If the
+	/// texture is already loaded it's returned as it is. It's thread-safe.
+	ANKI_USE_RESULT Error loadStreamedTexture(const CString& filename, TextureResourcePtr& out, Bool async = true);
 
 anki_internal:
 	U32 getMaxTextureSize() const
@@ -172,9 +241,9 @@ anki_internal:
 	}
 
 	template<typename T>
-	T* findLoadedResource(const CString& filename)
+	T* findLoadedResource(const CString& filename, U64 filenameHash)
 	{
-		return TypeResourceManager<T>::findLoadedResource(filename);
+		return TypeResourceManager<T>::findLoadedResource(filename, filenameHash);
 	}
 
 	template<typename T>
@@ -200,15 +269,32 @@ anki_internal:
 		return *m_shaderCompiler;
 	}
 
+	TextureStreamer& getTextureStreamer()
+	{
+		ANKI_ASSERT(m_textureStreamer);
+		return *m_textureStreamer;
+	}
+
+	UnifiedGeometryMemoryPool& getUnifiedGeometryMemoryPool()
+	{
+		ANKI_ASSERT(m_geometryPool);
+		return *m_geometryPool;
+	}
+
 	/// Get the number of times loadResource() was called.
 	U64 getLoadingRequestCount() const
 	{
-		return m_loadRequestCount;
+		return m_loadRequestCount.load();
 	}
 
 	/// Get the total number of completed async tasks.
 	U64 getAsyncTaskCompletedCount() const;
 
+	/// Loads may run in parallel so the temp pool can only be reset by the last one that stops using it. Code that
+	/// uses the temp allocator outside of loadResource() should be wrapped with these as well.
+	void beginTempPoolUse();
+	void endTempPoolUse();
+
 private:
 	GrManager* m_gr = nullptr;
 	PhysicsWorld* m_physics = nullptr;
@@ -217,11 +303,20 @@ private:
 	TempResourceAllocator<U8> m_tmpAlloc;
 	String m_cacheDir;
 	U32 m_maxTextureSize;
-	AsyncLoader* m_asyncLoader = nullptr; ///< Async loading thread
-	U64 m_uuid = 0;
-	U64 m_loadRequestCount = 0;
+	AsyncLoader* m_asyncLoader = nullptr; ///< Async loading threads
+	Atomic<U64> m_uuid = {0};
+	Atomic<U64> m_loadRequestCount = {0};
+	Mutex m_tmpPoolMtx;
+	U32 m_tmpPoolUserCount = 0; ///< The loads that use the m_tmpAlloc. Protected by m_tmpPoolMtx.
 	TransferGpuAllocator* m_transferGpuAlloc = nullptr;
 	ShaderCompilerCache* m_shaderCompiler = nullptr;
+	TextureStreamer* m_textureStreamer = nullptr;
+	UnifiedGeometryMemoryPool* m_geometryPool = nullptr;
+
+	/// @param preLoad A functor with signature void(T& rsrc). It's called before a new resource is loaded.
+	template<typename T, typename TPreLoadFunc>
+	ANKI_USE_RESULT Error loadResourceInternal(
+		const CString& filename, ResourcePtr<T>& out, Bool async, TPreLoadFunc preLoad);
 };
 /// @}
 
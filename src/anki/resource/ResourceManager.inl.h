@@ -8,54 +8,46 @@
 namespace anki
 {
 
-template<typename T>
-Error ResourceManager::loadResource(const CString& filename, ResourcePtr<T>& out, Bool async)
+template<typename T, typename TPreLoadFunc>
+Error ResourceManager::loadResourceInternal(
+	const CString& filename, ResourcePtr<T>& out, Bool async, TPreLoadFunc preLoad)
 {
 	ANKI_ASSERT(!out.isCreated() && "Already loaded");
 
 	Error err = Error::NONE;
-	++m_loadRequestCount;
+	m_loadRequestCount.fetchAdd(1);
 
-	T* const other = findLoadedResource<T>(filename);
+	const U64 filenameHash = T::computeFilenameHash(filename);
+	T* const other = findLoadedResource<T>(filename, filenameHash);
 
 	if(other)
 	{
-		// Found
+		// Found. Drop the reference findLoadedResource() took, out holds one now
 		out.reset(other);
+		other->getRefcount().fetchSub(1);
 	}
 	else
 	{
 		// Allocate ptr
 		T* ptr = m_alloc.newInstance<T>(this);
 		ANKI_ASSERT(ptr->getRefcount().load() == 0);
+		preLoad(*ptr);
 
-		// Populate the ptr. Use a block to cleanup temp_pool allocations
-		auto& pool = m_tmpAlloc.getMemoryPool();
+		// Populate the ptr. Resources load other resources and other threads might be loading as well so the temp
+		// pool is reset when all of them are done
+		beginTempPoolUse();
+		err = ptr->load(filename, async);
+		endTempPoolUse();
 
+		if(err)
 		{
-			U allocsCountBefore = pool.getAllocationsCount();
-			(void)allocsCountBefore;
-
-			err = ptr->load(filename, async);
-			if(err)
-			{
-				ANKI_RESOURCE_LOGE("Failed to load resource: %s", &filename[0]);
-				m_alloc.deleteInstance(ptr);
-				return err;
-			}
-
-			ANKI_ASSERT(pool.getAllocationsCount() == allocsCountBefore && "Forgot to deallocate");
+			ANKI_RESOURCE_LOGE("Failed to load resource: %s", &filename[0]);
+			m_alloc.deleteInstance(ptr);
+			return err;
 		}
 
 		ptr->setFilename(filename);
-		ptr->setUuid(++m_uuid);
-
-		// Reset the memory pool if no-one is using it.
-		// NOTE: Check because resources load other resources
-		if(pool.getAllocationsCount() == 0)
-		{
-			pool.reset();
-		}
+		ptr->setUuid(m_uuid.fetchAdd(1) + 1);
 
 		// Register resource
 		registerResource(ptr);
@@ -5,6 +5,7 @@
 
 #include <anki/resource/ShaderProgramResource.h>
 #include <anki/resource/ResourceManager.h>
+#include <anki/resource/AsyncLoader.h>
 #include <anki/util/Filesystem.h>
 #include <tinyexpr.h>
 
@@ -134,24 +135,75 @@ Bool ShaderProgramResourceInputVariable::acceptAllMutations(
 	return false;
 }
 
+/// Compiles a variant in the AsyncLoader.
+class ShaderProgramResource::CompileVariantTask : public AsyncLoaderTask
+{
+public:
+	ShaderProgramResourcePtr m_prog; ///< Keep the program alive while the task is pending.
+	Variant* m_variant;
+	DynamicArrayAuto<ShaderProgramResourceMutation> m_mutations;
+	DynamicArrayAuto<ShaderProgramResourceConstantValue> m_constants;
+
+	CompileVariantTask(const ShaderProgramResource* prog,
+		Variant* variant,
+		ConstWeakArray<ShaderProgramResourceMutation> mutations,
+		ConstWeakArray<ShaderProgramResourceConstantValue> constants)
+		: m_prog(const_cast<ShaderProgramResource*>(prog))
+		, m_variant(variant)
+		, m_mutations(prog->getAllocator())
+		, m_constants(prog->getAllocator())
+	{
+		if(mutations.getSize())
+		{
+			m_mutations.create(mutations.getSize());
+			memcpy(&m_mutations[0], &mutations[0], mutations.getSizeInBytes());
+		}
+
+		if(constants.getSize())
+		{
+			m_constants.create(constants.getSize());
+			memcpy(&m_constants[0], &constants[0], constants.getSizeInBytes());
+		}
+	}
+
+	Error operator()(AsyncLoaderTaskContext& ctx) final
+	{
+		m_prog->tryCompileVariant(
+			ConstWeakArray<ShaderProgramResourceMutation>(
+				(m_mutations.getSize()) ? &m_mutations[0] : nullptr, m_mutations.getSize()),
+			ConstWeakArray<ShaderProgramResourceConstantValue>(
+				(m_constants.getSize()) ? &m_constants[0] : nullptr, m_constants.getSize()),
+			*m_variant);
+		return Error::NONE;
+	}
+};
+
 ShaderProgramResource::ShaderProgramResource(ResourceManager* manager)
 	: ResourceObject(manager)
 {
+	for(Atomic<Variant*>& bucket : m_variantBuckets)
+	{
+		bucket.set(nullptr);
+	}
 }
 
 ShaderProgramResource::~ShaderProgramResource()
 {
 	auto alloc = getAllocator();
 
-	while(!m_variants.isEmpty())
+	for(Atomic<Variant*>& bucket : m_variantBuckets)
 	{
-		auto it = m_variants.getBegin();
-		ShaderProgramResourceVariant* variant = *it;
-		m_variants.erase(getAllocator(), it);
+		Variant* variant = bucket.get();
+		while(variant)
+		{
+			Variant* next = variant->m_next;
+
+			variant->m_blockInfos.destroy(alloc);
+			variant->m_bindings.destroy(alloc);
+			alloc.deleteInstance(variant);
 
-		variant->m_blockInfos.destroy(alloc);
-		variant->m_bindings.destroy(alloc);
-		alloc.deleteInstance(variant);
+			variant = next;
+		}
 	}
 
 	for(Input& var : m_inputVars)
@@ -257,17 +309,14 @@ U64 ShaderProgramResource::computeVariantHash(ConstWeakArray<ShaderProgramResour
 	return hash;
 }
 
-void ShaderProgramResource::getOrCreateVariant(ConstWeakArray<ShaderProgramResourceMutation> mutation,
-	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
-	const ShaderProgramResourceVariant*& variant) const
+void ShaderProgramResource::validateMutation(ConstWeakArray<ShaderProgramResourceMutation> mutation) const
 {
-	// Sanity checks
+#if ANKI_EXTRA_CHECKS
 	ANKI_ASSERT(mutation.getSize() == m_mutators.getSize());
 	ANKI_ASSERT(mutation.getSize() <= 128 && "Wrong assumption");
 	BitSet<128> mutatorPresent = {false};
 	for(const ShaderProgramResourceMutation& m : mutation)
 	{
-		(void)m;
 		ANKI_ASSERT(m.m_mutator);
 		ANKI_ASSERT(m.m_mutator->valueExists(m.m_value));
 
@@ -277,33 +326,130 @@ void ShaderProgramResource::getOrCreateVariant(ConstWeakArray<ShaderProgramResou
 		ANKI_ASSERT(!mutatorPresent.get(idx) && "Appeared 2 times in 'mutation'");
 		mutatorPresent.set(idx);
 
-#if ANKI_EXTRA_CHECKS
 		if(m_instancingMutator == m.m_mutator)
 		{
 			ANKI_ASSERT(m.m_value > 0 && "Instancing value can't be negative");
 		}
+	}
 #endif
+}
+
+const ShaderProgramResourceVariant* ShaderProgramResource::tryFindVariant(U64 hash) const
+{
+	// The acquire pairs with the release in findOrInsertVariant and makes the whole variant visible
+	const Variant* variant = m_variantBuckets[hash % VARIANT_BUCKET_COUNT].load(AtomicMemoryOrder::ACQUIRE);
+	while(variant && variant->m_hash != hash)
+	{
+		variant = variant->m_next;
 	}
 
-	// Compute hash
-	U64 hash = computeVariantHash(mutation, constants);
+	return variant;
+}
 
+ShaderProgramResourceVariant& ShaderProgramResource::findOrInsertVariant(U64 hash, Bool& inserted) const
+{
 	LockGuard<Mutex> lock(m_mtx);
 
-	auto it = m_variants.find(hash);
-	if(it != m_variants.getEnd())
+	// Someone might have inserted it while we were waiting for the lock
+	const Variant* found = tryFindVariant(hash);
+	if(found)
 	{
-		variant = *it;
+		inserted = false;
+		return *const_cast<Variant*>(found);
 	}
-	else
+
+	Variant* variant = getAllocator().newInstance<Variant>();
+	variant->m_hash = hash;
+
+	Atomic<Variant*>& bucket = m_variantBuckets[hash % VARIANT_BUCKET_COUNT];
+	variant->m_next = bucket.load();
+	bucket.store(variant, AtomicMemoryOrder::RELEASE);
+
+	inserted = true;
+	return *variant;
+}
+
+void ShaderProgramResource::tryCompileVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
+	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+	Variant& variant) const
+{
+	Variant::State expected = Variant::State::QUEUED;
+	while(!variant.m_state.compareExchange(expected, Variant::State::COMPILING, AtomicMemoryOrder::SEQ_CST))
 	{
-		// Create one
-		ShaderProgramResourceVariant* v = getAllocator().newInstance<ShaderProgramResourceVariant>();
-		initVariant(mutation, constants, *v);
+		if(expected != Variant::State::QUEUED)
+		{
+			// Someone else got it
+			return;
+		}
+	}
+
+	getManager().beginTempPoolUse();
+	initVariant(mutations, constants, variant);
+	getManager().endTempPoolUse();
+
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		variant.m_state.store(Variant::State::READY, AtomicMemoryOrder::RELEASE);
+	}
+	m_variantReadyCondVar.notifyAll();
+}
 
-		m_variants.emplace(getAllocator(), hash, v);
-		variant = v;
+void ShaderProgramResource::getOrCreateVariant(ConstWeakArray<ShaderProgramResourceMutation> mutation,
+	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+	const ShaderProgramResourceVariant*& variant) const
+{
+	validateMutation(mutation);
+	const U64 hash = computeVariantHash(mutation, constants);
+
+	// Fast path
+	const Variant* found = tryFindVariant(hash);
+	if(found && found->m_state.load(AtomicMemoryOrder::ACQUIRE) == Variant::State::READY)
+	{
+		variant = found;
+		return;
 	}
+
+	// Compile it here unless a task already compiles it
+	Bool inserted;
+	Variant& v = findOrInsertVariant(hash, inserted);
+	tryCompileVariant(mutation, constants, v);
+
+	if(v.m_state.load(AtomicMemoryOrder::ACQUIRE) != Variant::State::READY)
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		while(v.m_state.load(AtomicMemoryOrder::ACQUIRE) != Variant::State::READY)
+		{
+			m_variantReadyCondVar.wait(m_mtx);
+		}
+	}
+
+	variant = &v;
+}
+
+void ShaderProgramResource::getOrCreateVariantAsync(ConstWeakArray<ShaderProgramResourceMutation> mutation,
+	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+	const ShaderProgramResourceVariant*& variant) const
+{
+	validateMutation(mutation);
+	const U64 hash = computeVariantHash(mutation, constants);
+
+	const Variant* found = tryFindVariant(hash);
+	if(found)
+	{
+		variant = (found->m_state.load(AtomicMemoryOrder::ACQUIRE) == Variant::State::READY) ? found : nullptr;
+		return;
+	}
+
+	Bool inserted;
+	Variant& v = findOrInsertVariant(hash, inserted);
+	if(inserted)
+	{
+		AsyncLoader& loader = getManager().getAsyncLoader();
+		loader.submitTask(loader.newTask<CompileVariantTask>(this, &v, mutation, constants),
+			AsyncLoaderTaskPriority::HIGH);
+	}
+
+	variant = nullptr;
 }
 
 void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
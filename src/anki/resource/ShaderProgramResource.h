@@ -9,6 +9,7 @@
 #include <anki/resource/ShaderProgramPreProcessor.h>
 #include <anki/Gr.h>
 #include <anki/util/BitSet.h>
+#include <anki/util/Thread.h>
 
 // Forward
 struct te_variable;
@@ -202,8 +203,19 @@ public:
 	}
 
 private:
+	enum class State : U32
+	{
+		QUEUED, ///< Waiting for someone to compile it.
+		COMPILING,
+		READY
+	};
+
 	ShaderProgramPtr m_prog;
 
+	ShaderProgramResourceVariant* m_next = nullptr; ///< The next variant of the same hash bucket.
+	U64 m_hash = 0;
+	Atomic<State> m_state = {State::QUEUED};
+
 	BitSet<128, U64> m_activeInputVars = {false};
 	DynamicArray<ShaderVariableBlockInfo> m_blockInfos;
 	DynamicArray<I16> m_bindings;
@@ -300,6 +312,13 @@ public:
 		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
 		const ShaderProgramResourceVariant*& variant) const;
 
+	/// Same as getOrCreateVariant but it doesn't wait for the variant to be compiled. The compilation happens in the
+	/// AsyncLoader and @a variant is nullptr until it's done.
+	/// @note It's thread-safe.
+	void getOrCreateVariantAsync(ConstWeakArray<ShaderProgramResourceMutation> mutation,
+		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+		const ShaderProgramResourceVariant*& variant) const;
+
 	/// Get or create a graphics shader program variant.
 	/// @note It's thread-safe.
 	void getOrCreateVariant(ConstWeakArray<ShaderProgramResourceConstantValue> constants,
@@ -352,14 +371,21 @@ public:
 private:
 	using Mutator = ShaderProgramResourceMutator;
 	using Input = ShaderProgramResourceInputVariable;
+	using Variant = ShaderProgramResourceVariant;
+
+	class CompileVariantTask;
+
+	static const U32 VARIANT_BUCKET_COUNT = 64;
 
 	DynamicArray<Input> m_inputVars;
 	DynamicArray<Mutator> m_mutators;
 
 	String m_source;
 
-	mutable HashMap<U64, ShaderProgramResourceVariant*> m_variants;
-	mutable Mutex m_mtx;
+	/// A hash table of the variants. The variants are never removed so the readers walk the lists without locking.
+	mutable Array<Atomic<Variant*>, VARIANT_BUCKET_COUNT> m_variantBuckets;
+	mutable Mutex m_mtx; ///< Protects the insertions.
+	mutable ConditionVariable m_variantReadyCondVar; ///< Goes with m_mtx.
 
 	U8 m_descriptorSet = 0;
 	ShaderTypeBit m_shaderStages = ShaderTypeBit::NONE;
@@ -371,6 +397,18 @@ private:
 	void initVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
 		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
 		ShaderProgramResourceVariant& variant) const;
+
+	void validateMutation(ConstWeakArray<ShaderProgramResourceMutation> mutation) const;
+
+	const Variant* tryFindVariant(U64 hash) const;
+
+	/// Find a variant or insert one that is not compiled yet.
+	Variant& findOrInsertVariant(U64 hash, Bool& inserted) const;
+
+	/// Compile the variant if no one else has started compiling it.
+	void tryCompileVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
+		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+		Variant& variant) const;
 };
 
 /// Smart initializer of multiple ShaderProgramResourceConstantValue.
@@ -0,0 +1,695 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/TextureConverter.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/Hash.h>
+#include <anki/math/Vec.h>
+#include <anki/math/Simd.h>
+#include <cmath>
+
+namespace anki
+{
+
+/// Tables to convert from and to sRGB.
+class SrgbTables
+{
+public:
+	Array<F32, 256> m_toLinear; ///< sRGB to linear.
+	Array<U8, 4096> m_fromLinear; ///< Linear (in 12 bits) to sRGB.
+
+	SrgbTables()
+	{
+		for(U i = 0; i < m_toLinear.getSize(); ++i)
+		{
+			const F32 c = F32(i) / 255.0f;
+			m_toLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		for(U i = 0; i < m_fromLinear.getSize(); ++i)
+		{
+			const F32 c = F32(i) / F32(m_fromLinear.getSize() - 1);
+			const F32 s = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+			m_fromLinear[i] = U8(s * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const SrgbTables& getSrgbTables()
+{
+	static SrgbTables tables;
+	return tables;
+}
+
+/// Average 2x2 texels of some rows with integer math.
+static void downsampleRows(const U8* in, U32 width, U32 yBegin, U32 yEnd, U8* out)
+{
+	const U32 outWidth = width / 2;
+
+	for(U32 y = yBegin; y < yEnd; ++y)
+	{
+		const U8* row0 = in + 2 * y * width * 4;
+		const U8* row1 = row0 + width * 4;
+		U8* dst = out + y * outWidth * 4;
+		U32 x = 0;
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+		// 4 texels of each row give 2 texels
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		for(; x + 2 <= outWidth; x += 2)
+		{
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+			const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+			const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+			__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, sum));
+		}
+#endif
+
+		for(; x < outWidth; ++x)
+		{
+			for(U c = 0; c < 4; ++c)
+			{
+				const U sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+				dst[x * 4 + c] = U8((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+/// Average 2x2 texels of some rows in linear space.
+static void downsampleRowsLinear(const U8* in, U32 width, U32 yBegin, U32 yEnd, Bool sRgb, Bool normal, U8* out)
+{
+	const SrgbTables& tables = getSrgbTables();
+	const U32 outWidth = width / 2;
+
+	auto load = [&](const U8* texel) -> Vec4 {
+		if(sRgb)
+		{
+			return Vec4(tables.m_toLinear[texel[0]],
+				tables.m_toLinear[texel[1]],
+				tables.m_toLinear[texel[2]],
+				F32(texel[3]) / 255.0f);
+		}
+		else
+		{
+			return Vec4(F32(texel[0]), F32(texel[1]), F32(texel[2]), F32(texel[3])) / 255.0f;
+		}
+	};
+
+	for(U32 y = yBegin; y < yEnd; ++y)
+	{
+		const U8* row0 = in + 2 * y * width * 4;
+		const U8* row1 = row0 + width * 4;
+		U8* dst = out + y * outWidth * 4;
+
+		for(U32 x = 0; x < outWidth; ++x)
+		{
+			Vec4 avg = (load(row0 + x * 8) + load(row0 + x * 8 + 4) + load(row1 + x * 8) + load(row1 + x * 8 + 4));
+			avg *= 0.25f;
+
+			if(normal)
+			{
+				Vec3 n = avg.xyz() * 2.0f - 1.0f;
+				const F32 length = n.getLength();
+				n = (length > EPSILON) ? n / length : Vec3(0.0f, 0.0f, 1.0f);
+				avg = Vec4(n * 0.5f + 0.5f, avg.w());
+			}
+
+			if(sRgb)
+			{
+				const Vec4 scaled = avg * Vec4(4095.0f, 4095.0f, 4095.0f, 255.0f) + 0.5f;
+				dst[x * 4 + 0] = tables.m_fromLinear[min<U32>(U32(scaled.x()), 4095)];
+				dst[x * 4 + 1] = tables.m_fromLinear[min<U32>(U32(scaled.y()), 4095)];
+				dst[x * 4 + 2] = tables.m_fromLinear[min<U32>(U32(scaled.z()), 4095)];
+				dst[x * 4 + 3] = U8(min<U32>(U32(scaled.w()), 255));
+			}
+			else
+			{
+				const Vec4 scaled = avg * 255.0f + 0.5f;
+				for(U c = 0; c < 4; ++c)
+				{
+					dst[x * 4 + c] = U8(min<U32>(U32(max(scaled[c], 0.0f)), 255));
+				}
+			}
+		}
+	}
+}
+
+/// Quantize a color in [0, 255] to RGB565.
+static U16 packRgb565(const Vec3& c)
+{
+	const U32 r = U32(clamp(c.x(), 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	const U32 g = U32(clamp(c.y(), 0.0f, 255.0f) * (63.0f / 255.0f) + 0.5f);
+	const U32 b = U32(clamp(c.z(), 0.0f, 255.0f) * (31.0f / 255.0f) + 0.5f);
+	return U16((r << 11) | (g << 5) | b);
+}
+
+static Vec3 unpackRgb565(U16 c)
+{
+	const U32 r = (c >> 11) & 31;
+	const U32 g = (c >> 5) & 63;
+	const U32 b = c & 31;
+	return Vec3(F32((r << 3) | (r >> 2)), F32((g << 2) | (g >> 4)), F32((b << 3) | (b >> 2)));
+}
+
+/// Pick the indices of a BC1 color block.
+/// @return The error.
+static F32 pickColorIndices(const Array<Vec3, 16>& colors, U16 c0, U16 c1, U32& indices)
+{
+	Array<Vec3, 4> palette;
+	palette[0] = unpackRgb565(c0);
+	palette[1] = unpackRgb565(c1);
+	palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+	palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+
+	F32 error = 0.0f;
+	indices = 0;
+	for(U i = 0; i < 16; ++i)
+	{
+		U32 best = 0;
+		F32 bestDist = MAX_F32;
+		for(U32 p = 0; p < 4; ++p)
+		{
+			const Vec3 diff = colors[i] - palette[p];
+			const F32 dist = diff.dot(diff);
+			if(dist < bestDist)
+			{
+				bestDist = dist;
+				best = p;
+			}
+		}
+
+		indices |= best << (i * 2);
+		error += bestDist;
+	}
+
+	return error;
+}
+
+/// Find better endpoints for some indices with least squares.
+/// @return False if it's not possible.
+static Bool refineEndpoints(const Array<Vec3, 16>& colors, U32 indices, U16& c0, U16& c1)
+{
+	static const Array<F32, 4> WEIGHTS = {{1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f}};
+
+	F32 aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	Vec3 ax(0.0f), bx(0.0f);
+	for(U i = 0; i < 16; ++i)
+	{
+		const F32 a = WEIGHTS[(indices >> (i * 2)) & 3];
+		const F32 b = 1.0f - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		ax += colors[i] * a;
+		bx += colors[i] * b;
+	}
+
+	const F32 det = aa * bb - ab * ab;
+	if(absolute(det) < EPSILON)
+	{
+		return false;
+	}
+
+	const F32 invDet = 1.0f / det;
+	c0 = packRgb565((ax * bb - bx * ab) * invDet);
+	c1 = packRgb565((bx * aa - ax * ab) * invDet);
+	return true;
+}
+
+void TextureConverter::encodeBc1Block(const U8* texels, U8* block)
+{
+	Array<Vec3, 16> colors;
+	Vec3 mean(0.0f);
+	Vec3 minColor(MAX_F32);
+	Vec3 maxColor(MIN_F32);
+	for(U i = 0; i < 16; ++i)
+	{
+		colors[i] = Vec3(F32(texels[i * 4]), F32(texels[i * 4 + 1]), F32(texels[i * 4 + 2]));
+		mean += colors[i];
+		minColor = minColor.min(colors[i]);
+		maxColor = maxColor.max(colors[i]);
+	}
+	mean /= 16.0f;
+
+	// Find the principal axis of the colors with a few power iterations on the covariance matrix
+	F32 cxx = 0.0f, cxy = 0.0f, cxz = 0.0f, cyy = 0.0f, cyz = 0.0f, czz = 0.0f;
+	for(const Vec3& color : colors)
+	{
+		const Vec3 d = color - mean;
+		cxx += d.x() * d.x();
+		cxy += d.x() * d.y();
+		cxz += d.x() * d.z();
+		cyy += d.y() * d.y();
+		cyz += d.y() * d.z();
+		czz += d.z() * d.z();
+	}
+
+	Vec3 axis = maxColor - minColor;
+	for(U i = 0; i < 4; ++i)
+	{
+		axis = Vec3(axis.x() * cxx + axis.y() * cxy + axis.z() * cxz,
+			axis.x() * cxy + axis.y() * cyy + axis.z() * cyz,
+			axis.x() * cxz + axis.y() * cyz + axis.z() * czz);
+
+		const F32 length = axis.getLength();
+		if(length < EPSILON)
+		{
+			break;
+		}
+		axis /= length;
+	}
+
+	// The endpoints are the extremes of the colors along the axis
+	U16 c0, c1;
+	if(axis.getLength() < EPSILON)
+	{
+		c0 = c1 = packRgb565(mean);
+	}
+	else
+	{
+		F32 minT = MAX_F32, maxT = MIN_F32;
+		for(const Vec3& color : colors)
+		{
+			const F32 t = (color - mean).dot(axis);
+			minT = min(minT, t);
+			maxT = max(maxT, t);
+		}
+
+		c0 = packRgb565(mean + axis * maxT);
+		c1 = packRgb565(mean + axis * minT);
+	}
+
+	U32 indices;
+	F32 error = pickColorIndices(colors, c0, c1, indices);
+
+	// Try to improve it
+	U16 refinedC0, refinedC1;
+	if(c0 != c1 && refineEndpoints(colors, indices, refinedC0, refinedC1))
+	{
+		U32 refinedIndices;
+		const F32 refinedError = pickColorIndices(colors, refinedC0, refinedC1, refinedIndices);
+		if(refinedError < error)
+		{
+			c0 = refinedC0;
+			c1 = refinedC1;
+			indices = refinedIndices;
+			error = refinedError;
+		}
+	}
+
+	// The 4 color mode needs c0 > c1
+	if(c0 < c1)
+	{
+		std::swap(c0, c1);
+		indices ^= 0x55555555;
+	}
+	else if(c0 == c1)
+	{
+		indices = 0;
+	}
+
+	memcpy(block, &c0, sizeof(c0));
+	memcpy(block + 2, &c1, sizeof(c1));
+	memcpy(block + 4, &indices, sizeof(indices));
+}
+
+void TextureConverter::encodeBc3Block(const U8* texels, U8* block)
+{
+	U8 a0 = 0, a1 = 255;
+	for(U i = 0; i < 16; ++i)
+	{
+		a0 = max(a0, texels[i * 4 + 3]);
+		a1 = min(a1, texels[i * 4 + 3]);
+	}
+
+	// Use the 8 alpha mode that needs a0 > a1
+	U64 indices = 0;
+	if(a0 > a1)
+	{
+		Array<I32, 8> palette;
+		palette[0] = a0;
+		palette[1] = a1;
+		for(I32 i = 2; i < 8; ++i)
+		{
+			palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+		}
+
+		for(U i = 0; i < 16; ++i)
+		{
+			U64 best = 0;
+			I32 bestDist = MAX_I32;
+			for(U p = 0; p < 8; ++p)
+			{
+				const I32 dist = absolute(I32(texels[i * 4 + 3]) - palette[p]);
+				if(dist < bestDist)
+				{
+					bestDist = dist;
+					best = p;
+				}
+			}
+
+			indices |= best << (i * 3);
+		}
+	}
+
+	block[0] = a0;
+	block[1] = a1;
+	for(U i = 0; i < 6; ++i)
+	{
+		block[2 + i] = U8(indices >> (i * 8));
+	}
+
+	encodeBc1Block(texels, block + 8);
+}
+
+template<typename TFunc>
+void TextureConverter::parallelFor(U32 count, TFunc func)
+{
+	if(m_hive)
+	{
+		anki::parallelFor(*m_hive, 0, count, 0, [&](U32 begin, U32 end, U32 threadId) { func(begin, end); });
+	}
+	else
+	{
+		func(0, count);
+	}
+}
+
+void TextureConverter::generateMip(
+	ConstWeakArray<U8> in, U32 width, U32 height, U32 surfaceCount, Bool sRgb, Bool normal, WeakArray<U8> out)
+{
+	ANKI_ASSERT(width >= 2 && (width % 2) == 0 && height >= 2 && (height % 2) == 0);
+	ANKI_ASSERT(in.getSize() == width * height * 4 * surfaceCount);
+	ANKI_ASSERT(out.getSize() == in.getSize() / 4);
+
+	const U32 outHeight = height / 2;
+	const PtrSize inSurfaceSize = width * height * 4;
+	const PtrSize outSurfaceSize = inSurfaceSize / 4;
+
+	// Split the rows of all surfaces
+	parallelFor(outHeight * surfaceCount, [&](U32 begin, U32 end) {
+		while(begin < end)
+		{
+			const U32 surface = begin / outHeight;
+			const U32 yBegin = begin % outHeight;
+			const U32 yEnd = min(outHeight, yBegin + (end - begin));
+			const U8* src = &in[0] + surface * inSurfaceSize;
+			U8* dst = &out[0] + surface * outSurfaceSize;
+
+			if(sRgb || normal)
+			{
+				downsampleRowsLinear(src, width, yBegin, yEnd, sRgb, normal, dst);
+			}
+			else
+			{
+				downsampleRows(src, width, yBegin, yEnd, dst);
+			}
+
+			begin += yEnd - yBegin;
+		}
+	});
+}
+
+void TextureConverter::encodeS3tc(
+	ConstWeakArray<U8> in, U32 width, U32 height, U32 surfaceCount, Bool alpha, WeakArray<U8> out)
+{
+	ANKI_ASSERT((width % 4) == 0 && (height % 4) == 0);
+	ANKI_ASSERT(in.getSize() == width * height * 4 * surfaceCount);
+	const U32 blockSize = (alpha) ? 16 : 8;
+	const U32 blocksX = width / 4;
+	const U32 blocksY = height / 4;
+	ANKI_ASSERT(out.getSize() == blocksX * blocksY * blockSize * surfaceCount);
+
+	// Split the block rows of all surfaces
+	parallelFor(blocksY * surfaceCount, [&](U32 begin, U32 end) {
+		Array<U8, 16 * 4> texels;
+		for(U32 blockRow = begin; blockRow < end; ++blockRow)
+		{
+			const U32 surface = blockRow / blocksY;
+			const U32 by = blockRow % blocksY;
+			const U8* src = &in[0] + surface * width * height * 4;
+
+			for(U32 bx = 0; bx < blocksX; ++bx)
+			{
+				for(U32 y = 0; y < 4; ++y)
+				{
+					memcpy(&texels[y * 16], src + ((by * 4 + y) * width + bx * 4) * 4, 16);
+				}
+
+				U8* block = &out[0] + blockRow * blocksX * blockSize + bx * blockSize;
+				if(alpha)
+				{
+					encodeBc3Block(&texels[0], block);
+				}
+				else
+				{
+					encodeBc1Block(&texels[0], block);
+				}
+			}
+		}
+	});
+}
+
+U64 TextureConverter::computeContentHash(
+	ConstWeakArray<TextureConverterImage> images, const TextureConverterConfig& config)
+{
+	const Array<U32, 9> options = {{VERSION,
+		U32(config.m_type),
+		U32(config.m_compressions),
+		config.m_sRgb,
+		config.m_toLinearRgb,
+		config.m_normal,
+		config.m_noAlpha,
+		config.m_maxMipCount,
+		U32(images.getSize())}};
+	U64 hash = computeHash(&options[0], sizeof(options));
+
+	for(const TextureConverterImage& image : images)
+	{
+		const Array<U32, 3> info = {{image.m_width, image.m_height, U32(image.m_colorFormat)}};
+		hash = appendHash(&info[0], sizeof(info), hash);
+		if(image.m_data.getSize())
+		{
+			hash = appendHash(&image.m_data[0], image.m_data.getSize(), hash);
+		}
+	}
+
+	// Zero means that there is no hash
+	return (hash) ? hash : 1;
+}
+
+Error TextureConverter::convert(ConstWeakArray<TextureConverterImage> images,
+	const TextureConverterConfig& config,
+	DynamicArrayAuto<U8>& ankitex)
+{
+	using DataCompression = ImageLoader::DataCompression;
+	using ColorFormat = ImageLoader::ColorFormat;
+	using TextureType = ImageLoader::TextureType;
+
+	// Check the input
+	if(images.getSize() == 0 || (config.m_type == TextureType::_2D && images.getSize() != 1)
+		|| (config.m_type == TextureType::CUBE && images.getSize() != 6))
+	{
+		ANKI_RESOURCE_LOGE("Wrong number of images for the texture type");
+		return Error::USER_DATA;
+	}
+
+	if(config.m_type != TextureType::_2D && config.m_type != TextureType::CUBE
+		&& config.m_type != TextureType::_2D_ARRAY)
+	{
+		ANKI_RESOURCE_LOGE("Only 2D, cube and 2D array textures are supported");
+		return Error::USER_DATA;
+	}
+
+	if(!(config.m_compressions & (DataCompression::RAW | DataCompression::S3TC))
+		|| !!(config.m_compressions & ~(DataCompression::RAW | DataCompression::S3TC)))
+	{
+		ANKI_RESOURCE_LOGE("Only RAW and S3TC can be stored");
+		return Error::USER_DATA;
+	}
+
+	if(config.m_toLinearRgb && !config.m_sRgb)
+	{
+		ANKI_RESOURCE_LOGE("Only sRGB images can be converted to linear RGB");
+		return Error::USER_DATA;
+	}
+
+	const U32 width = images[0].m_width;
+	const U32 height = images[0].m_height;
+	const ColorFormat inColorFormat = images[0].m_colorFormat;
+	for(const TextureConverterImage& image : images)
+	{
+		if(image.m_width != width || image.m_height != height || image.m_colorFormat != inColorFormat)
+		{
+			ANKI_RESOURCE_LOGE("The images don't have the same size and color format");
+			return Error::USER_DATA;
+		}
+
+		const U32 bpp = (image.m_colorFormat == ColorFormat::RGB8) ? 3 : 4;
+		if(image.m_data.getSize() != width * height * bpp)
+		{
+			ANKI_RESOURCE_LOGE("Wrong image data size");
+			return Error::USER_DATA;
+		}
+	}
+
+	if(!isPowerOfTwo(width) || !isPowerOfTwo(height) || width < 4 || height < 4)
+	{
+		ANKI_RESOURCE_LOGE("The width and the height should be a power of 2 and at least 4");
+		return Error::USER_DATA;
+	}
+
+	const ColorFormat colorFormat = (config.m_noAlpha) ? ColorFormat::RGB8 : inColorFormat;
+	const Bool alpha = colorFormat == ColorFormat::RGBA8;
+	const U32 surfaceCount = images.getSize();
+
+	// The mips stop at the block size
+	U32 mipCount = 0;
+	while(mipCount < config.m_maxMipCount && (width >> mipCount) >= 4 && (height >> mipCount) >= 4)
+	{
+		++mipCount;
+	}
+	mipCount = max(mipCount, 1u);
+
+	// Create the RGBA8 mip chain. The surfaces of a mip are one after the other
+	DynamicArrayAuto<PtrSize> mipOffsets(m_alloc);
+	mipOffsets.create(mipCount + 1);
+	mipOffsets[0] = 0;
+	for(U32 mip = 0; mip < mipCount; ++mip)
+	{
+		mipOffsets[mip + 1] = mipOffsets[mip] + (width >> mip) * (height >> mip) * 4 * surfaceCount;
+	}
+
+	DynamicArrayAuto<U8> mips(m_alloc);
+	mips.create(mipOffsets[mipCount]);
+
+	const SrgbTables& tables = getSrgbTables();
+	const U32 inBpp = (inColorFormat == ColorFormat::RGB8) ? 3 : 4;
+	for(U32 surface = 0; surface < surfaceCount; ++surface)
+	{
+		const U8* src = &images[surface].m_data[0];
+		U8* dst = &mips[surface * width * height * 4];
+		for(U32 texel = 0; texel < width * height; ++texel)
+		{
+			for(U32 c = 0; c < 3; ++c)
+			{
+				const U8 value = src[texel * inBpp + c];
+				dst[texel * 4 + c] = (config.m_toLinearRgb) ? U8(tables.m_toLinear[value] * 255.0f + 0.5f) : value;
+			}
+
+			dst[texel * 4 + 3] = (alpha) ? src[texel * inBpp + 3] : 255;
+		}
+	}
+
+	const Bool sRgbFiltering = config.m_sRgb && !config.m_toLinearRgb && !config.m_normal;
+	for(U32 mip = 1; mip < mipCount; ++mip)
+	{
+		generateMip(ConstWeakArray<U8>(&mips[mipOffsets[mip - 1]], mipOffsets[mip] - mipOffsets[mip - 1]),
+			width >> (mip - 1),
+			height >> (mip - 1),
+			surfaceCount,
+			sRgbFiltering,
+			config.m_normal,
+			WeakArray<U8>(&mips[mipOffsets[mip]], mipOffsets[mip + 1] - mipOffsets[mip]));
+	}
+
+	// Write the header and make room for the mip infos
+	AnkiTextureFile::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header.m_magic[0], AnkiTextureFile::MAGIC, sizeof(header.m_magic));
+	header.m_width = width;
+	header.m_height = height;
+	header.m_depthOrLayerCount = surfaceCount;
+	header.m_type = config.m_type;
+	header.m_colorFormat = colorFormat;
+	header.m_compressionFormats = config.m_compressions;
+	header.m_normal = config.m_normal;
+	header.m_mipLevels = mipCount;
+	header.m_contentHash = computeContentHash(images, config);
+
+	// Compute the size of the file
+	auto computeMipSize = [&](DataCompression compression, U32 mip) -> PtrSize {
+		const U32 mipWidth = width >> mip;
+		const U32 mipHeight = height >> mip;
+		if(compression == DataCompression::RAW)
+		{
+			return mipWidth * mipHeight * ((alpha) ? 4 : 3) * surfaceCount;
+		}
+		else
+		{
+			return (mipWidth / 4) * (mipHeight / 4) * ((alpha) ? 16 : 8) * surfaceCount;
+		}
+	};
+
+	const PtrSize mipInfosSize = sizeof(AnkiTextureFile::MipInfo) * AnkiTextureFile::COMPRESSION_COUNT * mipCount;
+	PtrSize fileSize = sizeof(header) + mipInfosSize;
+	for(DataCompression compression : {DataCompression::RAW, DataCompression::S3TC})
+	{
+		for(U32 mip = 0; mip < mipCount && !!(config.m_compressions & compression); ++mip)
+		{
+			fileSize += computeMipSize(compression, mip);
+		}
+	}
+
+	ankitex.destroy();
+	ankitex.create(fileSize);
+	memcpy(&ankitex[0], &header, sizeof(header));
+
+	DynamicArrayAuto<AnkiTextureFile::MipInfo> mipInfos(m_alloc);
+	mipInfos.create(AnkiTextureFile::COMPRESSION_COUNT * mipCount);
+	memset(&mipInfos[0], 0, mipInfos.getSizeInBytes());
+
+	// Write the data of every compression coarse to fine
+	PtrSize offset = sizeof(header) + mipInfosSize;
+	for(DataCompression compression : {DataCompression::RAW, DataCompression::S3TC})
+	{
+		if(!(config.m_compressions & compression))
+		{
+			continue;
+		}
+
+		for(I32 mip = mipCount - 1; mip >= 0; --mip)
+		{
+			const U32 mipWidth = width >> mip;
+			const U32 mipHeight = height >> mip;
+			const ConstWeakArray<U8> mipData(&mips[mipOffsets[mip]], mipOffsets[mip + 1] - mipOffsets[mip]);
+			const PtrSize size = computeMipSize(compression, mip);
+
+			if(compression == DataCompression::S3TC)
+			{
+				encodeS3tc(mipData, mipWidth, mipHeight, surfaceCount, alpha, WeakArray<U8>(&ankitex[offset], size));
+			}
+			else if(alpha)
+			{
+				memcpy(&ankitex[offset], &mipData[0], size);
+			}
+			else
+			{
+				for(U32 texel = 0; texel < mipWidth * mipHeight * surfaceCount; ++texel)
+				{
+					memcpy(&ankitex[offset + texel * 3], &mipData[texel * 4], 3);
+				}
+			}
+
+			AnkiTextureFile::MipInfo& info =
+				mipInfos[AnkiTextureFile::getCompressionIndex(compression) * mipCount + mip];
+			info.m_offset = offset;
+			info.m_size = size;
+			offset += size;
+		}
+	}
+
+	ANKI_ASSERT(offset == fileSize);
+	memcpy(&ankitex[sizeof(header)], &mipInfos[0], mipInfosSize);
+
+	return Error::NONE;
+}
+
+} // end namespace anki
@@ -0,0 +1,108 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/ImageLoader.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+// Forward
+class ThreadHive;
+
+/// @addtogroup resource
+/// @{
+
+/// The options of TextureConverter.
+class TextureConverterConfig
+{
+public:
+	/// 2D, CUBE or 2D_ARRAY.
+	ImageLoader::TextureType m_type = ImageLoader::TextureType::_2D;
+
+	/// RAW and/or S3TC. S3TC is BC1 for RGB8 textures and BC3 for RGBA8 ones.
+	ImageLoader::DataCompression m_compressions = ImageLoader::DataCompression::S3TC;
+
+	/// The input is sRGB. The mips are filtered in linear space and stored in sRGB.
+	Bool m_sRgb = true;
+
+	/// Convert the sRGB input to linear RGB.
+	Bool m_toLinearRgb = false;
+
+	/// The input is a normal map. The mips will be renormalized.
+	Bool m_normal = false;
+
+	/// Drop the alpha channel.
+	Bool m_noAlpha = false;
+
+	U32 m_maxMipCount = MAX_U32;
+};
+
+/// An input image of the TextureConverter.
+class TextureConverterImage
+{
+public:
+	U32 m_width = 0;
+	U32 m_height = 0;
+	ImageLoader::ColorFormat m_colorFormat = ImageLoader::ColorFormat::NONE;
+	ConstWeakArray<U8> m_data; ///< The rows are in the order of the texture data (the order of the TGA files).
+};
+
+/// Creates AnKi textures (see AnkiTextureFile) out of images. It generates the mips and encodes the S3TC blocks in
+/// parallel if it has a ThreadHive.
+class TextureConverter
+{
+public:
+	/// Increase it when the output changes for the same input.
+	static const U32 VERSION = 1;
+
+	TextureConverter(GenericMemoryPoolAllocator<U8> alloc, ThreadHive* hive = nullptr)
+		: m_alloc(alloc)
+		, m_hive(hive)
+	{
+	}
+
+	/// Create the contents of an ankitex file.
+	ANKI_USE_RESULT Error convert(ConstWeakArray<TextureConverterImage> images,
+		const TextureConverterConfig& config,
+		DynamicArrayAuto<U8>& ankitex);
+
+	/// Compute the hash of some images and the options. It's stored in the AnkiTextureFile::Header so the textures
+	/// that didn't change don't need to be converted again.
+	static U64 computeContentHash(ConstWeakArray<TextureConverterImage> images, const TextureConverterConfig& config);
+
+	/// Create the next mip of some RGBA8 surfaces that are one after the other.
+	/// @param width The width of the input. It should be even.
+	/// @param height The height of the input. It should be even.
+	/// @param sRgb Filter in linear space.
+	/// @param normal Renormalize the RGB.
+	void generateMip(
+		ConstWeakArray<U8> in, U32 width, U32 height, U32 surfaceCount, Bool sRgb, Bool normal, WeakArray<U8> out);
+
+	/// Encode RGBA8 surfaces that are one after the other to BC1 or BC3 blocks.
+	/// @param width The width of the input. It should be a multiple of 4.
+	/// @param height The height of the input. It should be a multiple of 4.
+	void encodeS3tc(ConstWeakArray<U8> in, U32 width, U32 height, U32 surfaceCount, Bool alpha, WeakArray<U8> out);
+
+	/// Encode 16 RGBA8 texels to a BC1 block of 8 bytes. The alpha is ignored.
+	static void encodeBc1Block(const U8* texels, U8* block);
+
+	/// Encode 16 RGBA8 texels to a BC3 block of 16 bytes.
+	static void encodeBc3Block(const U8* texels, U8* block);
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	ThreadHive* m_hive;
+
+	/// Run func(begin, end) for a range of iterations in the hive or in this thread.
+	template<typename TFunc>
+	void parallelFor(U32 count, TFunc func);
+};
+/// @}
+
+} // end namespace anki
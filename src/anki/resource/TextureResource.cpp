@@ -7,6 +7,8 @@
 #include <anki/resource/ImageLoader.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/resource/AsyncLoader.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/util/Filesystem.h>
 
 namespace anki
 {
@@ -45,8 +47,31 @@ public:
 	}
 };
 
+/// Streaming async task.
+class TextureResource::StreamTask : public AsyncLoaderTask
+{
+public:
+	TextureResourcePtr m_tex; ///< Keep it alive.
+	U32 m_firstResidentMip;
+
+	StreamTask(TextureResource* tex, U32 firstResidentMip)
+		: m_tex(tex)
+		, m_firstResidentMip(firstResidentMip)
+	{
+	}
+
+	Error operator()(AsyncLoaderTaskContext& ctx) final
+	{
+		return m_tex->stream(m_firstResidentMip);
+	}
+};
+
 TextureResource::~TextureResource()
 {
+	if(isStreamed())
+	{
+		getManager().getTextureStreamer().unregisterTexture(this);
+	}
 }
 
 Error TextureResource::load(const ResourceFilename& filename, Bool async)
@@ -67,19 +92,77 @@ Error TextureResource::load(const ResourceFilename& filename, Bool async)
 	}
 	ImageLoader& loader = ctx->m_loader;
 
-	TextureInitInfo init("RsrcTex");
-	init.m_usage = TextureUsageBit::SAMPLED_ALL | TextureUsageBit::TRANSFER_DESTINATION;
-	init.m_initialUsage = TextureUsageBit::SAMPLED_ALL;
-	U faces = 0;
-
 	ResourceFilePtr file;
 	ANKI_CHECK(openFile(filename, file));
 
-	ANKI_CHECK(loader.load(file, filename, getManager().getMaxTextureSize()));
+	// Streamed AnKi textures load only their mip tail. The loader ignores the mip tail of non 2D textures
+	TextureStreamer& streamer = getManager().getTextureStreamer();
+	StringAuto ext(getTempAllocator());
+	getFilepathExtension(filename, ext);
+	const Bool stream = m_streamingAllowed && streamer.isEnabled() && ext == "ankitex";
+
+	ANKI_CHECK(loader.load(
+		file, filename, getManager().getMaxTextureSize(), (stream) ? streamer.getMipTailSize() : MAX_U32));
 
-	// Various sizes
-	init.m_width = loader.getWidth();
-	init.m_height = loader.getHeight();
+	// Create the texture
+	ctx->m_gr = &getManager().getGrManager();
+	ctx->m_trfAlloc = &getManager().getTransferGpuAllocator();
+	newTexture("RsrcTex", *ctx);
+	m_tex = ctx->m_tex;
+
+	// Upload the data
+	if(async)
+	{
+		getManager().getAsyncLoader().submitTask(task);
+	}
+	else
+	{
+		ANKI_CHECK(load(*ctx));
+	}
+
+	m_size = UVec3(loader.getWidth(), loader.getHeight(), (ctx->m_texType == TextureType::_3D) ? loader.getDepth() : 1);
+	m_layerCount = ctx->m_layerCount;
+
+	// Create the texture view
+	TextureViewInitInfo viewInit(m_tex, "Rsrc");
+	m_texView = getManager().getGrManager().newTextureView(viewInit);
+
+	// Start streaming. Textures that are smaller than the mip tail don't need it
+	if(loader.getFirstLoadedMipLevel() > 0)
+	{
+		Streaming& s = m_streaming;
+		ANKI_ASSERT(loader.getMipLevelsCount() <= s.m_mipSizes.getSize());
+		s.m_mipCount = loader.getMipLevelsCount();
+		s.m_firstTailMip = loader.getFirstLoadedMipLevel();
+		s.m_firstResidentMip = s.m_firstTailMip;
+		s.m_wantedMip = s.m_firstTailMip;
+
+		ANKI_ASSERT(ctx->m_texType == TextureType::_2D);
+		const Format format = m_tex->getFormat();
+		for(U mip = 0; mip < s.m_mipCount; ++mip)
+		{
+			s.m_mipSizes[mip] = computeSurfaceSize(m_size.x() >> mip, m_size.y() >> mip, format);
+		}
+
+		streamer.registerTexture(this);
+	}
+
+	return Error::NONE;
+}
+
+void TextureResource::newTexture(CString name, LoadingContext& ctx)
+{
+	const ImageLoader& loader = ctx.m_loader;
+	const U firstMip = loader.getFirstLoadedMipLevel();
+
+	TextureInitInfo init(name);
+	init.m_usage = TextureUsageBit::SAMPLED_ALL | TextureUsageBit::TRANSFER_DESTINATION;
+	init.m_initialUsage = TextureUsageBit::SAMPLED_ALL;
+	U faces = 0;
+
+	// Various sizes. The texture holds only the loaded mips
+	init.m_width = loader.getWidth() >> firstMip;
+	init.m_height = loader.getHeight() >> firstMip;
 
 	switch(loader.getTextureType())
 	{
@@ -103,7 +186,7 @@ Error TextureResource::load(const ResourceFilename& filename, Bool async)
 		break;
 	case ImageLoader::TextureType::_3D:
 		init.m_type = TextureType::_3D;
-		init.m_depth = loader.getDepth();
+		init.m_depth = loader.getDepth() >> firstMip;
 		init.m_layerCount = 1;
 		faces = 1;
 		break;
@@ -158,42 +241,99 @@ Error TextureResource::load(const ResourceFilename& filename, Bool async)
 	}
 
 	// mipmapsCount
-	init.m_mipmapCount = loader.getMipLevelsCount();
+	init.m_mipmapCount = loader.getMipLevelsCount() - firstMip;
+
+	// Create the texture and set the context
+	ANKI_ASSERT(ctx.m_gr);
+	ctx.m_tex = ctx.m_gr->newTexture(init);
+	ctx.m_faces = faces;
+	ctx.m_layerCount = init.m_layerCount;
+	ctx.m_texType = init.m_type;
+}
 
-	// Create the texture
-	m_tex = getManager().getGrManager().newTexture(init);
+void TextureResource::reportScreenSpaceUsage(F32 screenSpaceSize) const
+{
+	if(!isStreamed())
+	{
+		return;
+	}
 
-	// Set the context
-	ctx->m_faces = faces;
-	ctx->m_layerCount = init.m_layerCount;
-	ctx->m_gr = &getManager().getGrManager();
-	ctx->m_trfAlloc = &getManager().getTransferGpuAllocator();
-	ctx->m_texType = init.m_type;
-	ctx->m_tex = m_tex;
+	// Assume that the texture is mapped once over the object. The mip that has about one texel per pixel is enough
+	const F32 pixels = max(1.0f, screenSpaceSize * getManager().getTextureStreamer().getScreenHeight());
+	const F32 texels = F32(max(m_size.x(), m_size.y()));
+	const U32 mip = (pixels >= texels) ? 0 : U32(log2(texels / pixels));
+	m_streaming.m_reportedMip.min(min<U32>(mip, m_streaming.m_firstTailMip));
+}
 
-	// Upload the data
-	if(async)
+void TextureResource::submitStreamTask(U firstResidentMip)
+{
 	{
-		getManager().getAsyncLoader().submitTask(task);
+		LockGuard<SpinLock> lock(m_streaming.m_lock);
+		ANKI_ASSERT(m_streaming.m_state == StreamingState::IDLE);
+		m_streaming.m_state = StreamingState::STREAMING;
 	}
-	else
+
+	AsyncLoader& loader = getManager().getAsyncLoader();
+	loader.submitTask(loader.newTask<StreamTask>(this, firstResidentMip), AsyncLoaderTaskPriority::LOW);
+}
+
+Error TextureResource::stream(U firstResidentMip)
+{
+	LoadingContext ctx(getManager().getAsyncLoader().getAllocator());
+	ctx.m_gr = &getManager().getGrManager();
+	ctx.m_trfAlloc = &getManager().getTransferGpuAllocator();
+
+	// Load the mips from firstResidentMip and after
+	ResourceFilePtr file;
+	Error err = openFile(getFilename(), file);
+	if(!err)
 	{
-		ANKI_CHECK(load(*ctx));
+		const U32 maxLoadedMipSize = max(max(m_size.x(), m_size.y()), m_size.z()) >> firstResidentMip;
+		err = ctx.m_loader.load(file, getFilename(), getManager().getMaxTextureSize(), maxLoadedMipSize);
 	}
 
-	m_size = UVec3(init.m_width, init.m_height, init.m_depth);
-	m_layerCount = init.m_layerCount;
+	if(!err && ctx.m_loader.getFirstLoadedMipLevel() != firstResidentMip)
+	{
+		ANKI_RESOURCE_LOGE("The file changed");
+		err = Error::USER_DATA;
+	}
 
-	// Create the texture view
-	TextureViewInitInfo viewInit(m_tex, "Rsrc");
-	m_texView = getManager().getGrManager().newTextureView(viewInit);
+	if(!err)
+	{
+		newTexture("RsrcTexStream", ctx);
+		err = load(ctx);
+	}
 
-	return Error::NONE;
+	TextureViewPtr view;
+	if(!err)
+	{
+		view = ctx.m_gr->newTextureView(TextureViewInitInfo(ctx.m_tex, "RsrcStream"));
+	}
+
+	LockGuard<SpinLock> lock(m_streaming.m_lock);
+	ANKI_ASSERT(m_streaming.m_state == StreamingState::STREAMING);
+	if(err)
+	{
+		ANKI_RESOURCE_LOGE("Failed to stream texture: %s", getFilename().cstr());
+		m_streaming.m_state = StreamingState::FAILED;
+	}
+	else
+	{
+		m_streaming.m_pendingTex = ctx.m_tex;
+		m_streaming.m_pendingTexView = view;
+		m_streaming.m_pendingFirstResidentMip = firstResidentMip;
+		m_streaming.m_state = StreamingState::PENDING;
+	}
+
+	return err;
 }
 
 Error TextureResource::load(LoadingContext& ctx)
 {
-	const U copyCount = ctx.m_layerCount * ctx.m_faces * ctx.m_loader.getMipLevelsCount();
+	// The texture holds only the mips that the loader loaded
+	const U firstMip = ctx.m_loader.getFirstLoadedMipLevel();
+	const U mipCount = ctx.m_loader.getMipLevelsCount() - firstMip;
+	const U copyCount = ctx.m_layerCount * ctx.m_faces * mipCount;
 
 	for(U b = 0; b < copyCount; b += MAX_COPIES_BEFORE_FLUSH)
 	{
@@ -208,7 +348,7 @@ Error TextureResource::load(LoadingContext& ctx)
 		for(U i = begin; i < end; ++i)
 		{
 			U mip, layer, face;
-			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, ctx.m_loader.getMipLevelsCount(), i, layer, face, mip);
+			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, mipCount, i, layer, face, mip);
 
 			if(ctx.m_texType == TextureType::_3D)
 			{
@@ -230,7 +370,7 @@ Error TextureResource::load(LoadingContext& ctx)
 		for(U i = begin; i < end; ++i)
 		{
 			U mip, layer, face;
-			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, ctx.m_loader.getMipLevelsCount(), i, layer, face, mip);
+			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, mipCount, i, layer, face, mip);
 
 			PtrSize surfOrVolSize;
 			const void* surfOrVolData;
@@ -238,7 +378,7 @@ Error TextureResource::load(LoadingContext& ctx)
 
 			if(ctx.m_texType == TextureType::_3D)
 			{
-				const auto& vol = ctx.m_loader.getVolume(mip);
+				const auto& vol = ctx.m_loader.getVolume(mip + firstMip);
 				surfOrVolSize = vol.m_data.getSize();
 				surfOrVolData = &vol.m_data[0];
 
@@ -249,7 +389,7 @@ Error TextureResource::load(LoadingContext& ctx)
 			}
 			else
 			{
-				const auto& surf = ctx.m_loader.getSurface(mip, face, layer);
+				const auto& surf = ctx.m_loader.getSurface(mip + firstMip, face, layer);
 				surfOrVolSize = surf.m_data.getSize();
 				surfOrVolData = &surf.m_data[0];
 
@@ -285,7 +425,7 @@ Error TextureResource::load(LoadingContext& ctx)
 		for(U i = begin; i < end; ++i)
 		{
 			U mip, layer, face;
-			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, ctx.m_loader.getMipLevelsCount(), i, layer, face, mip);
+			unflatten3dArrayIndex(ctx.m_layerCount, ctx.m_faces, mipCount, i, layer, face, mip);
 
 			if(ctx.m_texType == TextureType::_3D)
 			{
@@ -7,19 +7,28 @@
 
 #include <anki/resource/ResourceObject.h>
 #include <anki/Gr.h>
+#include <anki/util/Thread.h>
 
 namespace anki
 {
 
+// Forward
+class ImageLoader;
+
 /// @addtogroup resource
 /// @{
 
 /// Texture resource class.
 ///
 /// It loads or creates an image and then loads it in the GPU. It supports compressed and uncompressed TGAs and AnKi's
-/// texture format.
+/// texture format. 2D AnKi textures that are loaded with ResourceManager::loadStreamedTexture() are streamed: Only
+/// their mip tail is loaded at first and the TextureStreamer changes the resident mips later. All other textures are
+/// fully resident.
 class TextureResource : public ResourceObject
 {
+	friend class TextureStreamer;
+	friend class ResourceManager;
+
 public:
 	TextureResource(ResourceManager* manager)
 		: ResourceObject(manager)
@@ -31,13 +40,13 @@ public:
 	/// Load a texture
 	ANKI_USE_RESULT Error load(const ResourceFilename& filename, Bool async);
 
-	/// Get the texture.
+	/// Get the texture. If the texture is streamed it will change between frames.
 	const TexturePtr& getGrTexture() const
 	{
 		return m_tex;
 	}
 
-	/// Get the texture view.
+	/// Get the texture view. If the texture is streamed it will change between frames.
 	const TextureViewPtr& getGrTextureView() const
 	{
 		return m_texView;
@@ -67,18 +76,75 @@ public:
 		return m_layerCount;
 	}
 
+	Bool isStreamed() const
+	{
+		return m_streaming.m_mipCount > 0;
+	}
+
+	/// Get the finest mip that is in the GPU. Zero if the texture is not streamed.
+	U getFirstResidentMipLevel() const
+	{
+		return m_streaming.m_firstResidentMip;
+	}
+
+	/// Let the streaming know how big something that uses the texture is on the screen. It's thread-safe.
+	/// @param screenSpaceSize The size of the object relative to the height of the screen.
+	void reportScreenSpaceUsage(F32 screenSpaceSize) const;
+
 private:
 	static constexpr U MAX_COPIES_BEFORE_FLUSH = 4;
 
 	class TexUploadTask;
+	class StreamTask;
 	class LoadingContext;
 
+	enum class StreamingState : U8
+	{
+		IDLE,
+		STREAMING, ///< A StreamTask is in flight.
+		PENDING, ///< A StreamTask finished and the new texture waits for the TextureStreamer to pick it.
+		FAILED ///< Don't try to stream it again.
+	};
+
+	/// The streaming state. Most of it is owned by the TextureStreamer.
+	class Streaming
+	{
+	public:
+		Array<PtrSize, 16> m_mipSizes; ///< The GPU memory of the mips.
+		U8 m_mipCount = 0; ///< The mips of the full texture. Zero if the texture is not streamed.
+		U8 m_firstTailMip = 0; ///< The mip tail is always resident.
+		U8 m_firstResidentMip = 0;
+		U8 m_wantedMip = 0; ///< The finest mip the renderer asked for lately.
+		U64 m_wantedMipFrame = 0; ///< The frame that m_wantedMip was last confirmed.
+		U32 m_streamerIndex = MAX_U32; ///< Index in the TextureStreamer's array.
+
+		mutable Atomic<U32> m_reportedMip = {MAX_U32}; ///< The finest mip reported this frame.
+
+		SpinLock m_lock; ///< Protects the members bellow.
+		StreamingState m_state = StreamingState::IDLE;
+		TexturePtr m_pendingTex;
+		TextureViewPtr m_pendingTexView;
+		U8 m_pendingFirstResidentMip = 0;
+	};
+
 	TexturePtr m_tex;
 	TextureViewPtr m_texView;
 	UVec3 m_size = UVec3(0u);
 	U32 m_layerCount = 0;
+	Streaming m_streaming;
+	Bool m_streamingAllowed = false; ///< Set by ResourceManager::loadStreamedTexture().
 
 	ANKI_USE_RESULT static Error load(LoadingContext& ctx);
+
+	/// Create a texture that can hold the mips that the loader of the context loaded and set the context.
+	static void newTexture(CString name, LoadingContext& ctx);
+
+	/// Load the mips up to firstResidentMip in a new texture and leave it for the TextureStreamer. Called by the
+	/// StreamTask.
+	ANKI_USE_RESULT Error stream(U firstResidentMip);
+
+	/// The TextureStreamer should have made sure that the texture is not about to be deleted.
+	void submitStreamTask(U firstResidentMip);
 };
 /// @}
 
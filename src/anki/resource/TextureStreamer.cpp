@@ -0,0 +1,279 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/TextureResource.h>
+#include <anki/resource/ResourceManager.h>
+#include <anki/misc/ConfigSet.h>
+#include <algorithm>
+
+namespace anki
+{
+
+TextureStreamer::TextureStreamer(ResourceManager* manager)
+	: m_manager(manager)
+{
+	ANKI_ASSERT(manager);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	ANKI_ASSERT(m_textures.getSize() == 0 && "Some textures are still alive");
+	m_textures.destroy(m_manager->getAllocator());
+}
+
+void TextureStreamer::init(const ConfigSet& config)
+{
+	m_budget = PtrSize(config.getNumber("rsrc.textureStreamingBudget"));
+	m_mipTailSize = U32(config.getNumber("rsrc.textureMipTailSize"));
+	m_screenHeight = F32(config.getNumber("height"));
+}
+
+void TextureStreamer::registerTexture(TextureResource* tex)
+{
+	ANKI_ASSERT(tex && tex->isStreamed());
+	LockGuard<Mutex> lock(m_mtx);
+
+	ANKI_ASSERT(tex->m_streaming.m_streamerIndex == MAX_U32);
+	tex->m_streaming.m_streamerIndex = m_textures.getSize();
+	m_textures.emplaceBack(m_manager->getAllocator(), tex);
+}
+
+void TextureStreamer::unregisterTexture(TextureResource* tex)
+{
+	ANKI_ASSERT(tex);
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Move the last texture in its place
+	const U32 idx = tex->m_streaming.m_streamerIndex;
+	ANKI_ASSERT(idx < m_textures.getSize() && m_textures[idx] == tex);
+	m_textures[idx] = m_textures.getBack();
+	m_textures[idx]->m_streaming.m_streamerIndex = idx;
+	m_textures.resize(m_manager->getAllocator(), m_textures.getSize() - 1);
+
+	tex->m_streaming.m_streamerIndex = MAX_U32;
+}
+
+Bool TextureStreamer::tryRetain(TextureResource* tex)
+{
+	I32 refcount = tex->getRefcount().load();
+	while(refcount > 0)
+	{
+		if(tex->getRefcount().compareExchange(refcount, refcount + 1))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void TextureStreamer::update()
+{
+	if(!isEnabled())
+	{
+		return;
+	}
+
+	m_manager->beginTempPoolUse();
+
+	{
+		GenericMemoryPoolAllocator<U8> alloc = m_manager->getTempAllocator();
+		DynamicArrayAuto<TextureResource*> retained(alloc);
+
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			updateInternal(alloc, retained);
+		}
+
+		// Drop the references of updateInternal(). Do it without holding the lock because it might delete textures
+		for(TextureResource* tex : retained)
+		{
+			TextureResourcePtr ptr(tex);
+			tex->getRefcount().fetchSub(1);
+		}
+	}
+
+	m_manager->endTempPoolUse();
+}
+
+void TextureStreamer::updateInternal(
+	GenericMemoryPoolAllocator<U8> alloc, DynamicArrayAuto<TextureResource*>& retainedTextures)
+{
+	++m_frame;
+
+	const U32 textureCount = m_textures.getSize();
+	if(textureCount == 0)
+	{
+		m_residentMemory = 0;
+		return;
+	}
+
+	DynamicArrayAuto<TextureStreamingRequest> requests(alloc);
+	requests.create(textureCount);
+	DynamicArrayAuto<U32> firstResidentMips(alloc);
+	firstResidentMips.create(textureCount);
+
+	for(U32 i = 0; i < textureCount; ++i)
+	{
+		TextureResource& tex = *m_textures[i];
+		TextureResource::Streaming& s = tex.m_streaming;
+
+		// Pick the texture a StreamTask left. Nothing renders so it's safe to change it
+		{
+			LockGuard<SpinLock> lock(s.m_lock);
+			if(s.m_state == TextureResource::StreamingState::PENDING)
+			{
+				tex.m_tex = s.m_pendingTex;
+				tex.m_texView = s.m_pendingTexView;
+				s.m_firstResidentMip = s.m_pendingFirstResidentMip;
+
+				s.m_pendingTex.reset(nullptr);
+				s.m_pendingTexView.reset(nullptr);
+				s.m_state = TextureResource::StreamingState::IDLE;
+			}
+		}
+
+		// Finer mips are taken at once. Coarser ones after a while so the mips don't go back and forth
+		const U32 reportedMip = s.m_reportedMip.exchange(MAX_U32);
+		if(reportedMip <= s.m_wantedMip)
+		{
+			s.m_wantedMip = reportedMip;
+			s.m_wantedMipFrame = m_frame;
+		}
+		else if(m_frame - s.m_wantedMipFrame > KEEP_FRAME_COUNT)
+		{
+			s.m_wantedMip = min<U32>(reportedMip, s.m_firstTailMip);
+			s.m_wantedMipFrame = m_frame;
+		}
+
+		TextureStreamingRequest& req = requests[i];
+		req.m_mipSizes = ConstWeakArray<PtrSize>(&s.m_mipSizes[0], s.m_mipCount);
+		req.m_firstTailMip = s.m_firstTailMip;
+		req.m_wantedMip = s.m_wantedMip;
+	}
+
+	m_residentMemory = computeResidentMips(requests, m_budget, alloc, WeakArray<U32>(firstResidentMips));
+
+	// Stream in or out
+	for(U32 i = 0; i < textureCount; ++i)
+	{
+		TextureResource& tex = *m_textures[i];
+		TextureResource::Streaming& s = tex.m_streaming;
+
+		if(firstResidentMips[i] == s.m_firstResidentMip)
+		{
+			continue;
+		}
+
+		{
+			LockGuard<SpinLock> lock(s.m_lock);
+			if(s.m_state != TextureResource::StreamingState::IDLE)
+			{
+				continue;
+			}
+		}
+
+		// Skip the textures that are about to be deleted. The task will hold a reference as well
+		if(tryRetain(&tex))
+		{
+			retainedTextures.emplaceBack(&tex);
+			tex.submitStreamTask(firstResidentMips[i]);
+		}
+	}
+}
+
+PtrSize TextureStreamer::computeResidentMips(ConstWeakArray<TextureStreamingRequest> requests,
+	PtrSize budget,
+	GenericMemoryPoolAllocator<U8> alloc,
+	WeakArray<U32> firstResidentMips)
+{
+	ANKI_ASSERT(requests.getSize() == firstResidentMips.getSize());
+
+	/// A texture that wants a finer mip.
+	class Candidate
+	{
+	public:
+		U32 m_idx;
+		U32 m_blur; ///< How many mips it's missing.
+		PtrSize m_cost; ///< The memory of the next mip.
+
+		/// The blurriest textures go first. Then the cheapest.
+		Bool operator<(const Candidate& b) const
+		{
+			if(m_blur != b.m_blur)
+			{
+				return m_blur < b.m_blur;
+			}
+			else if(m_cost != b.m_cost)
+			{
+				return m_cost > b.m_cost;
+			}
+			else
+			{
+				return m_idx > b.m_idx;
+			}
+		}
+	};
+
+	DynamicArrayAuto<Candidate> heap(alloc);
+	if(requests.getSize())
+	{
+		heap.create(requests.getSize());
+	}
+	U32 heapSize = 0;
+
+	// The mip tails are always resident
+	PtrSize memory = 0;
+	for(U32 i = 0; i < requests.getSize(); ++i)
+	{
+		const TextureStreamingRequest& req = requests[i];
+		ANKI_ASSERT(req.m_firstTailMip < req.m_mipSizes.getSize());
+
+		firstResidentMips[i] = req.m_firstTailMip;
+		for(U32 mip = req.m_firstTailMip; mip < req.m_mipSizes.getSize(); ++mip)
+		{
+			memory += req.m_mipSizes[mip];
+		}
+
+		if(req.m_wantedMip < req.m_firstTailMip)
+		{
+			Candidate& c = heap[heapSize++];
+			c.m_idx = i;
+			c.m_blur = req.m_firstTailMip - req.m_wantedMip;
+			c.m_cost = req.m_mipSizes[req.m_firstTailMip - 1];
+		}
+	}
+
+	// Give one mip at a time to the texture that needs it the most
+	std::make_heap(heap.getBegin(), heap.getBegin() + heapSize);
+	while(heapSize > 0)
+	{
+		std::pop_heap(heap.getBegin(), heap.getBegin() + heapSize);
+		Candidate c = heap[--heapSize];
+
+		if(memory + c.m_cost > budget)
+		{
+			// It doesn't fit. The ones after it might since they are cheaper or they need less
+			continue;
+		}
+
+		memory += c.m_cost;
+		const TextureStreamingRequest& req = requests[c.m_idx];
+		const U32 mip = --firstResidentMips[c.m_idx];
+
+		if(mip > req.m_wantedMip)
+		{
+			c.m_blur = mip - req.m_wantedMip;
+			c.m_cost = req.m_mipSizes[mip - 1];
+			heap[heapSize++] = c;
+			std::push_heap(heap.getBegin(), heap.getBegin() + heapSize);
+		}
+	}
+
+	return memory;
+}
+
+} // end namespace anki
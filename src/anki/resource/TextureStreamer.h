@@ -0,0 +1,111 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class ConfigSet;
+
+/// @addtogroup resource
+/// @{
+
+/// The input of TextureStreamer::computeResidentMips().
+class TextureStreamingRequest
+{
+public:
+	ConstWeakArray<PtrSize> m_mipSizes; ///< The memory of each mip.
+	U32 m_firstTailMip = 0; ///< That mip and the coarser ones are always resident.
+	U32 m_wantedMip = 0; ///< The finest mip the texture needs.
+};
+
+/// Manages the memory budget of the streamed textures. The renderer reports how big the textures are on the screen and
+/// once per frame the streamer picks the resident mips of every texture and streams them in or out.
+class TextureStreamer
+{
+public:
+	/// The frames a texture keeps its mips after it stops needing them.
+	static const U32 KEEP_FRAME_COUNT = 60;
+
+	TextureStreamer(ResourceManager* manager);
+
+	~TextureStreamer();
+
+	void init(const ConfigSet& config);
+
+	/// If it's false all the textures will be fully resident.
+	Bool isEnabled() const
+	{
+		return m_budget > 0;
+	}
+
+	PtrSize getBudget() const
+	{
+		return m_budget;
+	}
+
+	/// The mips that are this size or smaller are always resident.
+	U32 getMipTailSize() const
+	{
+		return m_mipTailSize;
+	}
+
+	F32 getScreenHeight() const
+	{
+		return m_screenHeight;
+	}
+
+	/// Get the memory that the streamed textures will need when the streaming started by the last update() is done.
+	PtrSize getResidentMemory() const
+	{
+		return m_residentMemory;
+	}
+
+	/// Pick the resident mips and start streaming. Call it once per frame when nothing is rendering since it changes
+	/// the textures of the TextureResources.
+	void update();
+
+	/// Pick the resident mips of some textures so they fit in a budget. The mip tails are always resident even if they
+	/// don't fit. The textures that are the blurriest compared to what they need get finer mips first.
+	/// @param[out] firstResidentMips The finest resident mip of each texture.
+	/// @return The memory of all the resident mips.
+	static PtrSize computeResidentMips(ConstWeakArray<TextureStreamingRequest> requests,
+		PtrSize budget,
+		GenericMemoryPoolAllocator<U8> alloc,
+		WeakArray<U32> firstResidentMips);
+
+anki_internal:
+	void registerTexture(TextureResource* tex);
+
+	void unregisterTexture(TextureResource* tex);
+
+private:
+	ResourceManager* m_manager;
+	PtrSize m_budget = 0;
+	U32 m_mipTailSize = 0;
+	F32 m_screenHeight = 0.0f;
+	U64 m_frame = 0;
+	PtrSize m_residentMemory = 0;
+
+	Mutex m_mtx; ///< Protects m_textures.
+	DynamicArray<TextureResource*> m_textures;
+
+	/// Increase the refcount only if the resource is not about to be deleted.
+	static Bool tryRetain(TextureResource* tex);
+
+	/// The part of update() that runs with the lock held.
+	/// @param[out] retainedTextures The textures that got a reference that should be dropped without the lock.
+	void updateInternal(GenericMemoryPoolAllocator<U8> alloc, DynamicArrayAuto<TextureResource*>& retainedTextures);
+};
+/// @}
+
+} // end namespace anki
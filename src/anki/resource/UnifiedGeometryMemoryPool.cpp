@@ -0,0 +1,211 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/UnifiedGeometryMemoryPool.h>
+#include <anki/resource/ResourceManager.h>
+#include <anki/gr/GrManager.h>
+#include <anki/gr/CommandBuffer.h>
+#include <anki/misc/ConfigSet.h>
+
+namespace anki
+{
+
+UnifiedGeometryMemoryPool::UnifiedGeometryMemoryPool(ResourceManager* manager)
+	: m_manager(manager)
+{
+	ANKI_ASSERT(manager);
+}
+
+UnifiedGeometryMemoryPool::~UnifiedGeometryMemoryPool()
+{
+	ANKI_ASSERT(m_uploadingHandles.getSize() == 0 && "Some meshes are still alive");
+	releaseGarbage(true);
+
+	m_uploadingHandles.destroy(m_manager->getAllocator());
+	m_garbage.destroy(m_manager->getAllocator());
+}
+
+Error UnifiedGeometryMemoryPool::init(const ConfigSet& config)
+{
+	const PtrSize size = PtrSize(config.getNumber("rsrc.unifiedGeometryMemorySize"));
+	m_maxDefragmentSize = PtrSize(config.getNumber("rsrc.unifiedGeometryDefragmentSize"));
+
+	if(size == 0)
+	{
+		return Error::NONE;
+	}
+
+	m_buffer = m_manager->getGrManager().newBuffer(BufferInitInfo(size,
+		BufferUsageBit::INDEX | BufferUsageBit::VERTEX | BufferUsageBit::BUFFER_UPLOAD_SOURCE
+			| BufferUsageBit::BUFFER_UPLOAD_DESTINATION | BufferUsageBit::FILL,
+		BufferMapAccessBit::NONE,
+		"UnifiedGeometry"));
+
+	m_tlsf.init(m_manager->getAllocator(), size);
+
+	return Error::NONE;
+}
+
+Error UnifiedGeometryMemoryPool::allocate(PtrSize size, U32 alignment, UnifiedGeometryMemoryPoolHandle& handle)
+{
+	ANKI_ASSERT(isEnabled());
+	ANKI_ASSERT(!handle);
+
+	LockGuard<Mutex> lock(m_mtx);
+	return m_tlsf.allocate(size, alignment, &handle, handle.m_tlsf);
+}
+
+void UnifiedGeometryMemoryPool::free(UnifiedGeometryMemoryPoolHandle& handle)
+{
+	ANKI_ASSERT(handle);
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Stop tracking the upload
+	for(U32 i = 0; i < m_uploadingHandles.getSize(); ++i)
+	{
+		if(m_uploadingHandles[i] == &handle)
+		{
+			m_uploadingHandles[i] = m_uploadingHandles.getBack();
+			m_uploadingHandles.resize(m_manager->getAllocator(), m_uploadingHandles.getSize() - 1);
+			break;
+		}
+	}
+
+	// The frames in flight might still use it
+	m_tlsf.setMovable(handle.m_tlsf, false);
+
+	Garbage& garbage = *m_garbage.emplaceBack(m_manager->getAllocator());
+	garbage.m_tlsf = handle.m_tlsf;
+	garbage.m_fence = handle.m_uploadFence;
+	garbage.m_frame = m_frame;
+
+	handle.m_tlsf = {};
+	handle.m_uploadFence.reset(nullptr);
+}
+
+void UnifiedGeometryMemoryPool::setUploadFence(UnifiedGeometryMemoryPoolHandle& handle, FencePtr fence)
+{
+	ANKI_ASSERT(handle && fence);
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	if(!handle.m_uploadFence)
+	{
+		m_uploadingHandles.emplaceBack(m_manager->getAllocator(), &handle);
+	}
+
+	handle.m_uploadFence = fence;
+}
+
+void UnifiedGeometryMemoryPool::releaseGarbage(Bool force)
+{
+	U32 i = 0;
+	while(i < m_garbage.getSize())
+	{
+		Garbage& garbage = m_garbage[i];
+
+		const Bool release = force
+			|| (garbage.m_frame + MAX_FRAMES_IN_FLIGHT <= m_frame
+				   && (!garbage.m_fence || garbage.m_fence->clientWait(0.0)));
+
+		if(release)
+		{
+			m_tlsf.free(garbage.m_tlsf);
+
+			// Move the last in its place
+			m_garbage[i] = m_garbage.getBack();
+			m_garbage.resize(m_manager->getAllocator(), m_garbage.getSize() - 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void UnifiedGeometryMemoryPool::update()
+{
+	if(!isEnabled())
+	{
+		return;
+	}
+
+	LockGuard<Mutex> lock(m_mtx);
+	++m_frame;
+
+	releaseGarbage(false);
+
+	// The ranges that are uploaded can move
+	U32 i = 0;
+	while(i < m_uploadingHandles.getSize())
+	{
+		UnifiedGeometryMemoryPoolHandle& handle = *m_uploadingHandles[i];
+		if(handle.m_uploadFence->clientWait(0.0))
+		{
+			handle.m_uploadFence.reset(nullptr);
+			m_tlsf.setMovable(handle.m_tlsf, true);
+
+			m_uploadingHandles[i] = m_uploadingHandles.getBack();
+			m_uploadingHandles.resize(m_manager->getAllocator(), m_uploadingHandles.getSize() - 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	defragment();
+}
+
+void UnifiedGeometryMemoryPool::defragment()
+{
+	// Don't bother if there is a free block that is most of the free memory
+	const PtrSize freeMem = m_tlsf.getSize() - m_tlsf.getAllocatedMemory();
+	if(m_maxDefragmentSize == 0 || m_tlsf.getLargestFreeBlockSize() >= freeMem / 2)
+	{
+		return;
+	}
+
+	DynamicArrayAuto<TlsfGpuAllocatorMove> moves(m_manager->getAllocator());
+	m_tlsf.defragment(m_maxDefragmentSize, moves);
+	if(moves.getSize() == 0)
+	{
+		return;
+	}
+
+	// Copy the ranges. The old and the new ranges don't overlap so they can be in the same buffer
+	CommandBufferInitInfo cmdbinit;
+	cmdbinit.m_flags = CommandBufferFlag::SMALL_BATCH | CommandBufferFlag::TRANSFER_WORK;
+	CommandBufferPtr cmdb = m_manager->getGrManager().newCommandBuffer(cmdbinit);
+
+	const BufferUsageBit geometryUsage = BufferUsageBit::INDEX | BufferUsageBit::VERTEX;
+	const BufferUsageBit copyUsage = BufferUsageBit::BUFFER_UPLOAD_SOURCE | BufferUsageBit::BUFFER_UPLOAD_DESTINATION;
+	cmdb->setBufferBarrier(m_buffer, geometryUsage, copyUsage, 0, MAX_PTR_SIZE);
+
+	for(const TlsfGpuAllocatorMove& move : moves)
+	{
+		cmdb->copyBufferToBuffer(m_buffer, move.m_srcOffset, m_buffer, move.m_dstOffset, move.m_size);
+	}
+
+	cmdb->setBufferBarrier(m_buffer, copyUsage, geometryUsage, 0, MAX_PTR_SIZE);
+
+	FencePtr fence;
+	cmdb->flush(&fence);
+
+	// The new frames use the new ranges and the frames in flight the old
+	for(TlsfGpuAllocatorMove& move : moves)
+	{
+		UnifiedGeometryMemoryPoolHandle& handle = *static_cast<UnifiedGeometryMemoryPoolHandle*>(move.m_userData);
+		handle.m_tlsf.m_offset = move.m_dstOffset;
+
+		Garbage& garbage = *m_garbage.emplaceBack(m_manager->getAllocator());
+		garbage.m_tlsf = move.m_src;
+		garbage.m_fence = fence;
+		garbage.m_frame = m_frame;
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,131 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/gr/common/TlsfGpuAllocator.h>
+#include <anki/gr/Buffer.h>
+#include <anki/gr/Fence.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class ConfigSet;
+
+/// @addtogroup resource
+/// @{
+
+/// A range of UnifiedGeometryMemoryPool.
+class UnifiedGeometryMemoryPoolHandle : public NonCopyable
+{
+	friend class UnifiedGeometryMemoryPool;
+
+public:
+	UnifiedGeometryMemoryPoolHandle() = default;
+
+	~UnifiedGeometryMemoryPoolHandle()
+	{
+		ANKI_ASSERT(!m_tlsf && "Forgot to free");
+	}
+
+	/// The offset in the buffer of the pool. It may change in UnifiedGeometryMemoryPool::update().
+	PtrSize getOffset() const
+	{
+		ANKI_ASSERT(m_tlsf);
+		return m_tlsf.m_offset;
+	}
+
+	PtrSize getSize() const
+	{
+		ANKI_ASSERT(m_tlsf);
+		return m_tlsf.m_size;
+	}
+
+	operator Bool() const
+	{
+		return m_tlsf;
+	}
+
+private:
+	TlsfGpuAllocatorHandle m_tlsf;
+	FencePtr m_uploadFence; ///< The range can't move until that signals.
+};
+
+/// One big buffer that keeps the vertices and indices of all the meshes. The meshes sub-allocate it so the draws of
+/// different meshes bind the same buffer. When the free memory gets fragmented update() moves the meshes at the end of
+/// the buffer to the gaps at the beginning.
+class UnifiedGeometryMemoryPool : public NonCopyable
+{
+public:
+	UnifiedGeometryMemoryPool(ResourceManager* manager);
+
+	~UnifiedGeometryMemoryPool();
+
+	ANKI_USE_RESULT Error init(const ConfigSet& config);
+
+	/// If it's false the meshes should create their own buffers.
+	Bool isEnabled() const
+	{
+		return m_buffer.isCreated();
+	}
+
+	/// The buffer of all the ranges. It's an index and vertex buffer.
+	const BufferPtr& getBuffer() const
+	{
+		return m_buffer;
+	}
+
+	/// Allocate a range. The range is not initialized.
+	/// @note It's thread-safe.
+	ANKI_USE_RESULT Error allocate(PtrSize size, U32 alignment, UnifiedGeometryMemoryPoolHandle& handle);
+
+	/// Free a range. The memory will be reused when the GPU stops using it.
+	/// @note It's thread-safe.
+	void free(UnifiedGeometryMemoryPoolHandle& handle);
+
+	/// Set the fence of the command buffer that writes the range. The range won't move until that is done.
+	/// @note It's thread-safe.
+	void setUploadFence(UnifiedGeometryMemoryPoolHandle& handle, FencePtr fence);
+
+	/// Release the memory that the GPU stopped using and defragment a bit. Call it once per frame when nothing is
+	/// rendering since it changes the offsets of the handles.
+	void update();
+
+	PtrSize getAllocatedMemory() const
+	{
+		return m_tlsf.getAllocatedMemory();
+	}
+
+private:
+	/// A range that the GPU might still use.
+	class Garbage
+	{
+	public:
+		TlsfGpuAllocatorHandle m_tlsf;
+		FencePtr m_fence;
+		U64 m_frame;
+	};
+
+	ResourceManager* m_manager;
+	BufferPtr m_buffer;
+	PtrSize m_maxDefragmentSize = 0;
+	U64 m_frame = 0;
+
+	Mutex m_mtx;
+	TlsfGpuAllocator m_tlsf;
+	DynamicArray<UnifiedGeometryMemoryPoolHandle*> m_uploadingHandles;
+	DynamicArray<Garbage> m_garbage;
+
+	void releaseGarbage(Bool force);
+
+	void defragment();
+};
+/// @}
+
+} // end namespace anki
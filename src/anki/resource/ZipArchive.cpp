@@ -0,0 +1,333 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/ZipArchive.h>
+#include <anki/util/Hash.h>
+#include <anki/core/Trace.h>
+#include <zlib.h>
+#include <cstring>
+
+namespace anki
+{
+
+static const U32 END_OF_CENTRAL_DIRECTORY_SIGNATURE = 0x06054b50;
+static const U32 END_OF_CENTRAL_DIRECTORY_SIZE = 22;
+static const U32 CENTRAL_DIRECTORY_HEADER_SIGNATURE = 0x02014b50;
+static const U32 CENTRAL_DIRECTORY_HEADER_SIZE = 46;
+static const U32 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const U32 LOCAL_HEADER_SIZE = 30;
+static const U32 MAX_COMMENT_SIZE = 0xFFFF;
+static const U16 STORED_METHOD = 0;
+static const U16 DEFLATED_METHOD = 8;
+
+/// The zip fields are little endian and unaligned. Assume that the machine is little endian.
+template<typename T>
+static T readField(const U8* ptr)
+{
+	T out;
+	memcpy(&out, ptr, sizeof(T));
+	return out;
+}
+
+ZipArchive::~ZipArchive()
+{
+	m_entries.destroy(m_alloc);
+	m_index.destroy(m_alloc);
+}
+
+Error ZipArchive::open(const CString& filename)
+{
+	ANKI_TRACE_SCOPED_EVENT(RSRC_FILE_READ);
+
+	ANKI_CHECK(m_file.open(filename, FileOpenFlag::READ | FileOpenFlag::BINARY));
+	m_size = m_file.getSize();
+	if(m_size < END_OF_CENTRAL_DIRECTORY_SIZE)
+	{
+		ANKI_RESOURCE_LOGE("Not a zip file: %s", &filename[0]);
+		return Error::USER_DATA;
+	}
+
+	const void* data;
+	ANKI_CHECK(m_file.map(data));
+	m_data = static_cast<const U8*>(data);
+	if(m_data == nullptr)
+	{
+		ANKI_RESOURCE_LOGE("Can't map the archive: %s", &filename[0]);
+		return Error::FILE_ACCESS;
+	}
+
+	const Error err = readCentralDirectory();
+	if(err)
+	{
+		ANKI_RESOURCE_LOGE("Failed to read the archive: %s", &filename[0]);
+	}
+
+	return err;
+}
+
+Error ZipArchive::readCentralDirectory()
+{
+	// Find the end of the central directory. It's at the end of the file before the comment
+	const U8* eocd = nullptr;
+	const PtrSize searchEnd = (m_size > END_OF_CENTRAL_DIRECTORY_SIZE + MAX_COMMENT_SIZE)
+								  ? m_size - END_OF_CENTRAL_DIRECTORY_SIZE - MAX_COMMENT_SIZE
+								  : 0;
+	for(PtrSize offset = m_size - END_OF_CENTRAL_DIRECTORY_SIZE + 1; offset > searchEnd; --offset)
+	{
+		if(readField<U32>(m_data + offset - 1) == END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+		{
+			eocd = m_data + offset - 1;
+			break;
+		}
+	}
+
+	if(eocd == nullptr)
+	{
+		ANKI_RESOURCE_LOGE("Not a zip file");
+		return Error::USER_DATA;
+	}
+
+	const U32 entryCount = readField<U16>(eocd + 10);
+	const PtrSize cdSize = readField<U32>(eocd + 12);
+	const PtrSize cdOffset = readField<U32>(eocd + 16);
+	if(entryCount == 0xFFFF || cdOffset == 0xFFFFFFFF)
+	{
+		ANKI_RESOURCE_LOGE("Zip64 is not supported");
+		return Error::USER_DATA;
+	}
+
+	if(cdOffset + cdSize > m_size)
+	{
+		ANKI_RESOURCE_LOGE("Wrong central directory");
+		return Error::USER_DATA;
+	}
+
+	// Read the entries
+	m_entries.create(m_alloc, entryCount);
+	U32 count = 0;
+	const U8* header = m_data + cdOffset;
+	const U8* cdEnd = header + cdSize;
+	for(U32 i = 0; i < entryCount; ++i)
+	{
+		if(header + CENTRAL_DIRECTORY_HEADER_SIZE > cdEnd
+			|| readField<U32>(header) != CENTRAL_DIRECTORY_HEADER_SIGNATURE)
+		{
+			ANKI_RESOURCE_LOGE("Wrong central directory header");
+			return Error::USER_DATA;
+		}
+
+		const U16 flags = readField<U16>(header + 8);
+		const U16 method = readField<U16>(header + 10);
+		const PtrSize compressedSize = readField<U32>(header + 20);
+		const PtrSize uncompressedSize = readField<U32>(header + 24);
+		const U32 nameLength = readField<U16>(header + 28);
+		const U32 extraLength = readField<U16>(header + 30);
+		const U32 commentLength = readField<U16>(header + 32);
+		const PtrSize localHeaderOffset = readField<U32>(header + 42);
+		const U8* name = header + CENTRAL_DIRECTORY_HEADER_SIZE;
+		const U8* extra = name + nameLength;
+
+		header = extra + extraLength + commentLength;
+		if(header > cdEnd)
+		{
+			ANKI_RESOURCE_LOGE("Wrong central directory header");
+			return Error::USER_DATA;
+		}
+
+		// Skip the directories. The empty files too since they can't be told apart
+		if(uncompressedSize == 0)
+		{
+			continue;
+		}
+
+		if(flags & 1)
+		{
+			ANKI_RESOURCE_LOGE("Encryption is not supported");
+			return Error::USER_DATA;
+		}
+
+		if(method != STORED_METHOD && method != DEFLATED_METHOD)
+		{
+			ANKI_RESOURCE_LOGE("Compression method not supported: %u", method);
+			return Error::USER_DATA;
+		}
+
+		// The data start after the local header
+		const U8* localHeader = m_data + localHeaderOffset;
+		if(localHeaderOffset + LOCAL_HEADER_SIZE > m_size || readField<U32>(localHeader) != LOCAL_HEADER_SIGNATURE)
+		{
+			ANKI_RESOURCE_LOGE("Wrong local header");
+			return Error::USER_DATA;
+		}
+
+		Entry& entry = m_entries[count];
+		entry.m_dataOffset = localHeaderOffset + LOCAL_HEADER_SIZE + readField<U16>(localHeader + 26)
+							 + readField<U16>(localHeader + 28);
+		entry.m_compressedSize = compressedSize;
+		entry.m_uncompressedSize = uncompressedSize;
+		entry.m_compressed = method == DEFLATED_METHOD;
+		entry.m_name = reinterpret_cast<const char*>(name);
+		entry.m_nameLength = nameLength;
+		entry.m_nextSameHash = MAX_U32;
+
+		if(entry.m_dataOffset + compressedSize > m_size
+			|| (!entry.m_compressed && compressedSize != uncompressedSize))
+		{
+			ANKI_RESOURCE_LOGE("Wrong file size");
+			return Error::USER_DATA;
+		}
+
+		ANKI_CHECK(readChunks(extra, extraLength, entry));
+
+		// Index it. Chain the files with the same hash
+		const U64 hash = computeHash(name, nameLength);
+		auto it = m_index.find(hash);
+		if(it == m_index.getEnd())
+		{
+			m_index.emplace(m_alloc, hash, count);
+		}
+		else
+		{
+			U32 last = *it;
+			while(m_entries[last].m_nextSameHash != MAX_U32)
+			{
+				last = m_entries[last].m_nextSameHash;
+			}
+
+			m_entries[last].m_nextSameHash = count;
+		}
+
+		++count;
+	}
+
+	m_entries.resize(m_alloc, count);
+	return Error::NONE;
+}
+
+Error ZipArchive::readChunks(const U8* extra, U32 extraSize, Entry& entry) const
+{
+	entry.m_chunkSize = U32(entry.m_uncompressedSize);
+	entry.m_chunkCount = 1;
+	entry.m_chunkOffsets = nullptr;
+
+	if(!entry.m_compressed)
+	{
+		return Error::NONE;
+	}
+
+	// Find the field
+	const U8* end = extra + extraSize;
+	while(extra + 4 <= end)
+	{
+		const U16 id = readField<U16>(extra);
+		const U16 size = readField<U16>(extra + 2);
+		extra += 4;
+
+		if(extra + size > end)
+		{
+			break;
+		}
+
+		if(id == CHUNKS_EXTRA_FIELD_ID)
+		{
+			const U32 chunkSize = (size >= 4) ? readField<U32>(extra) : 0;
+			const U32 chunkCount = (chunkSize) ? U32((entry.m_uncompressedSize + chunkSize - 1) / chunkSize) : 0;
+			if(chunkSize == 0 || size != 4 + chunkCount * sizeof(U32))
+			{
+				ANKI_RESOURCE_LOGE("Wrong chunks extra field");
+				return Error::USER_DATA;
+			}
+
+			for(U32 i = 0; i < chunkCount; ++i)
+			{
+				const U32 offset = readField<U32>(extra + 4 + i * sizeof(U32));
+				if(offset >= entry.m_compressedSize || (i == 0 && offset != 0)
+					|| (i > 0 && offset <= readField<U32>(extra + i * sizeof(U32))))
+				{
+					ANKI_RESOURCE_LOGE("Wrong chunk offsets");
+					return Error::USER_DATA;
+				}
+			}
+
+			entry.m_chunkSize = chunkSize;
+			entry.m_chunkCount = chunkCount;
+			entry.m_chunkOffsets = extra + 4;
+			break;
+		}
+
+		extra += size;
+	}
+
+	return Error::NONE;
+}
+
+U32 ZipArchive::findEntry(const CString& filename) const
+{
+	const U32 length = filename.getLength();
+	auto it = m_index.find(computeHash(&filename[0], length));
+	if(it == m_index.getEnd())
+	{
+		return MAX_U32;
+	}
+
+	for(U32 idx = *it; idx != MAX_U32; idx = m_entries[idx].m_nextSameHash)
+	{
+		const Entry& entry = m_entries[idx];
+		if(entry.m_nameLength == length && memcmp(entry.m_name, &filename[0], length) == 0)
+		{
+			return idx;
+		}
+	}
+
+	return MAX_U32;
+}
+
+Error ZipArchive::decompressChunk(U32 idx, U32 chunk, void* out) const
+{
+	ANKI_TRACE_SCOPED_EVENT(RSRC_FILE_READ);
+
+	const Entry& entry = m_entries[idx];
+	ANKI_ASSERT(entry.m_compressed && chunk < entry.m_chunkCount);
+
+	// Find the compressed and the uncompressed range
+	PtrSize begin = 0;
+	PtrSize end = entry.m_compressedSize;
+	if(entry.m_chunkOffsets)
+	{
+		begin = readField<U32>(entry.m_chunkOffsets + chunk * sizeof(U32));
+		if(chunk + 1 < entry.m_chunkCount)
+		{
+			end = readField<U32>(entry.m_chunkOffsets + (chunk + 1) * sizeof(U32));
+		}
+	}
+
+	const PtrSize outSize = min<PtrSize>(entry.m_chunkSize, entry.m_uncompressedSize - chunk * entry.m_chunkSize);
+
+	// Inflate the raw deflate data. A chunk starts after a full flush so it doesn't need the previous chunks
+	z_stream stream = {};
+	if(inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+	{
+		ANKI_RESOURCE_LOGE("inflateInit2() failed");
+		return Error::FUNCTION_FAILED;
+	}
+
+	stream.next_in = const_cast<Bytef*>(getEntryData(idx) + begin);
+	stream.avail_in = uInt(end - begin);
+	stream.next_out = static_cast<Bytef*>(out);
+	stream.avail_out = uInt(outSize);
+
+	const int ret = inflate(&stream, Z_SYNC_FLUSH);
+	inflateEnd(&stream);
+
+	if((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) || stream.avail_out != 0)
+	{
+		ANKI_RESOURCE_LOGE("Failed to decompress file");
+		return Error::FUNCTION_FAILED;
+	}
+
+	return Error::NONE;
+}
+
+} // end namespace anki
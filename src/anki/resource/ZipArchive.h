@@ -0,0 +1,102 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/util/File.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/HashMap.h>
+
+namespace anki
+{
+
+/// @addtogroup resource
+/// @{
+
+/// A file of a ZipArchive.
+class ZipArchiveEntry
+{
+public:
+	PtrSize m_dataOffset; ///< Where the (compressed) data start in the archive.
+	PtrSize m_compressedSize;
+	PtrSize m_uncompressedSize;
+	U32 m_chunkSize; ///< The uncompressed size of the chunks. The last chunk may be smaller.
+	U32 m_chunkCount;
+	Bool m_compressed; ///< If false it's stored.
+};
+
+/// A reader of .ankizip archives. They are plain zip files. The archive is mapped once and the central directory is
+/// indexed with a hash map so finding a file doesn't search and opening a file doesn't read anything.
+///
+/// The deflated files can be split in chunks that decompress independently. A chunked file is compressed with a full
+/// flush every N uncompressed bytes and its central directory entry has an extra field with the ID
+/// CHUNKS_EXTRA_FIELD_ID that contains N (U32) and the offsets of the chunks in the compressed data (U32 each). The
+/// deflated files without that field have one chunk.
+class ZipArchive : public NonCopyable
+{
+public:
+	static const U16 CHUNKS_EXTRA_FIELD_ID = 0x4B41; // "AK"
+
+	ZipArchive(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~ZipArchive();
+
+	/// Map the archive and index its files.
+	ANKI_USE_RESULT Error open(const CString& filename);
+
+	/// Find a file. The directories and the empty files are not in the index.
+	/// @note It's thread-safe.
+	/// @return The index of the file or MAX_U32 if it's not in the archive.
+	U32 findEntry(const CString& filename) const;
+
+	U32 getEntryCount() const
+	{
+		return m_entries.getSize();
+	}
+
+	const ZipArchiveEntry& getEntry(U32 idx) const
+	{
+		return m_entries[idx];
+	}
+
+	/// Get the data of a file as they are in the archive. The stored files can be read from there.
+	const U8* getEntryData(U32 idx) const
+	{
+		return m_data + m_entries[idx].m_dataOffset;
+	}
+
+	/// Decompress a chunk of a deflated file.
+	/// @note It's thread-safe.
+	/// @param[out] out The memory of the chunk. It's ZipArchiveEntry::m_chunkSize big or less for the last chunk.
+	ANKI_USE_RESULT Error decompressChunk(U32 idx, U32 chunk, void* out) const;
+
+private:
+	class Entry : public ZipArchiveEntry
+	{
+	public:
+		const char* m_name; ///< Not null terminated.
+		U32 m_nameLength;
+		U32 m_nextSameHash; ///< The next entry with the same hash of the name.
+		const U8* m_chunkOffsets; ///< The extra field array. nullptr if it's one chunk.
+	};
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	File m_file;
+	const U8* m_data = nullptr;
+	PtrSize m_size = 0;
+	DynamicArray<Entry> m_entries;
+	HashMap<U64, U32> m_index; ///< The hash of the name to the first entry with that hash.
+
+	ANKI_USE_RESULT Error readCentralDirectory();
+
+	ANKI_USE_RESULT Error readChunks(const U8* extra, U32 extraSize, Entry& entry) const;
+};
+/// @}
+
+} // end namespace anki
@@ -70,7 +70,7 @@ Error BodyNode::init(const CString& resourceFname)
 	newComponent<FeedbackComponent>();
 
 	// Move component
-	newComponent<MoveComponent>(MoveComponentFlag::IGNORE_PARENT_TRANSFORM);
+	newComponent<MoveComponent>(this, MoveComponentFlag::IGNORE_PARENT_TRANSFORM);
 
 	return Error::NONE;
 }
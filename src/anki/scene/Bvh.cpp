@@ -0,0 +1,533 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/Bvh.h>
+#include <anki/collision/Functions.h>
+
+namespace anki
+{
+
+Bvh::~Bvh()
+{
+	ANKI_ASSERT(m_placeableCount == 0);
+	ANKI_ASSERT(m_dirtyList.load() == nullptr);
+	m_nodes.destroy(m_alloc);
+}
+
+void Bvh::init(F32 fatMargin)
+{
+	ANKI_ASSERT(fatMargin >= 0.0f);
+	m_fatMargin = fatMargin;
+}
+
+U32 Bvh::newNode()
+{
+	if(m_freeList == MAX_U32)
+	{
+		// Grow the storage and put the new nodes in the free list
+		const U32 oldSize = m_nodes.getSize();
+		const U32 newSize = max(64u, oldSize * 2);
+		m_nodes.resize(m_alloc, newSize);
+
+		for(U32 i = oldSize; i < newSize; ++i)
+		{
+			m_nodes[i].m_parent = (i + 1 < newSize) ? (i + 1) : MAX_U32;
+		}
+		m_freeList = oldSize;
+	}
+
+	const U32 idx = m_freeList;
+	Node& node = m_nodes[idx];
+	m_freeList = node.m_parent;
+
+	node.m_parent = MAX_U32;
+	node.m_left = MAX_U32;
+	node.m_right = MAX_U32;
+	node.m_placeable = nullptr;
+	return idx;
+}
+
+void Bvh::releaseNode(U32 idx)
+{
+	Node& node = m_nodes[idx];
+	node.m_placeable = nullptr;
+	node.m_parent = m_freeList;
+	m_freeList = idx;
+}
+
+void Bvh::place(const Aabb& volume, BvhPlaceable* placeable, Bool updateActualSceneBounds)
+{
+	ANKI_ASSERT(placeable);
+
+	placeable->m_aabbMin = volume.getMin().xyz();
+	placeable->m_aabbMax = volume.getMax().xyz();
+	placeable->m_updateActualSceneBounds = updateActualSceneBounds;
+
+	// Push it to the dirty list once
+	if(placeable->m_dirty.exchange(1) == 0)
+	{
+		BvhPlaceable* head = m_dirtyList.load();
+		do
+		{
+			placeable->m_nextDirty = head;
+		} while(!m_dirtyList.compareExchange(head, placeable));
+	}
+}
+
+void Bvh::remove(BvhPlaceable& placeable)
+{
+	// Unlink it from the dirty list
+	if(placeable.m_dirty.load())
+	{
+		BvhPlaceable* prev = nullptr;
+		BvhPlaceable* it = m_dirtyList.load();
+		while(it != &placeable)
+		{
+			ANKI_ASSERT(it);
+			prev = it;
+			it = it->m_nextDirty;
+		}
+
+		if(prev)
+		{
+			prev->m_nextDirty = placeable.m_nextDirty;
+		}
+		else
+		{
+			m_dirtyList.store(placeable.m_nextDirty);
+		}
+
+		placeable.m_nextDirty = nullptr;
+		placeable.m_dirty.store(0);
+	}
+
+	if(placeable.m_leaf != MAX_U32)
+	{
+		removeLeaf(placeable.m_leaf);
+		releaseNode(placeable.m_leaf);
+		placeable.m_leaf = MAX_U32;
+
+		ANKI_ASSERT(m_placeableCount > 0);
+		--m_placeableCount;
+	}
+}
+
+void Bvh::refit()
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_BVH_REFIT);
+
+	BvhPlaceable* placeable = m_dirtyList.exchange(nullptr);
+	U32 refitCount = 0;
+	U32 insertCount = 0;
+
+	while(placeable)
+	{
+		BvhPlaceable* next = placeable->m_nextDirty;
+		placeable->m_nextDirty = nullptr;
+		placeable->m_dirty.store(0);
+
+		const Vec3& aabbMin = placeable->m_aabbMin;
+		const Vec3& aabbMax = placeable->m_aabbMax;
+
+		if(placeable->m_updateActualSceneBounds)
+		{
+			m_actualSceneAabbMin = m_actualSceneAabbMin.min(aabbMin);
+			m_actualSceneAabbMax = m_actualSceneAabbMax.max(aabbMax);
+		}
+
+		if(placeable->m_leaf == MAX_U32)
+		{
+			// New placeable, insert it
+			const U32 leaf = newNode();
+			Node& node = m_nodes[leaf];
+			node.m_aabbMin = aabbMin - m_fatMargin;
+			node.m_aabbMax = aabbMax + m_fatMargin;
+			node.m_placeable = placeable;
+			placeable->m_leaf = leaf;
+
+			insertLeaf(leaf);
+			++m_placeableCount;
+			++insertCount;
+		}
+		else
+		{
+			const U32 leaf = placeable->m_leaf;
+			Node& node = m_nodes[leaf];
+
+			const Bool inside = aabbMin >= node.m_aabbMin && aabbMax <= node.m_aabbMax;
+			if(!inside)
+			{
+				const Vec3 newMin = aabbMin - m_fatMargin;
+				const Vec3 newMax = aabbMax + m_fatMargin;
+				const Bool overlaps = newMin <= node.m_aabbMax && newMax >= node.m_aabbMin;
+
+				node.m_aabbMin = newMin;
+				node.m_aabbMax = newMax;
+
+				if(overlaps)
+				{
+					// Moved a bit, refit the ancestors
+					refitAncestors(node.m_parent);
+					++refitCount;
+				}
+				else
+				{
+					// Teleported, re-insert
+					removeLeaf(leaf);
+					insertLeaf(leaf);
+					++insertCount;
+				}
+			}
+		}
+
+		placeable = next;
+	}
+
+	ANKI_TRACE_INC_COUNTER(SCENE_BVH_REFITS, refitCount);
+	ANKI_TRACE_INC_COUNTER(SCENE_BVH_INSERTS, insertCount);
+}
+
+U32 Bvh::findBestSibling(const Vec3& aabbMin, const Vec3& aabbMax) const
+{
+	// Greedy descent. The cost of a sibling is the area of the new parent plus the area increase of the ancestors.
+	// Stop when pushing the leaf further down costs more than making the current node the sibling
+
+	U32 idx = m_root;
+	F32 inheritedCost = 0.0f;
+	while(!m_nodes[idx].isLeaf())
+	{
+		const Node& node = m_nodes[idx];
+		const F32 area = surfaceArea(node.m_aabbMin, node.m_aabbMax);
+		const F32 unionArea = surfaceArea(node.m_aabbMin.min(aabbMin), node.m_aabbMax.max(aabbMax));
+
+		// Cost of making this node the sibling
+		const F32 cost = unionArea + inheritedCost;
+
+		// Cost of pushing the leaf down
+		const F32 childInheritedCost = inheritedCost + unionArea - area;
+		auto childCost = [&](const Node& child) {
+			const F32 childUnionArea = surfaceArea(child.m_aabbMin.min(aabbMin), child.m_aabbMax.max(aabbMax));
+			return (child.isLeaf()) ? childUnionArea + childInheritedCost
+									: childUnionArea - surfaceArea(child.m_aabbMin, child.m_aabbMax)
+										  + childInheritedCost;
+		};
+
+		const F32 costLeft = childCost(m_nodes[node.m_left]);
+		const F32 costRight = childCost(m_nodes[node.m_right]);
+
+		if(cost < costLeft && cost < costRight)
+		{
+			break;
+		}
+
+		idx = (costLeft < costRight) ? node.m_left : node.m_right;
+		inheritedCost = childInheritedCost;
+	}
+
+	return idx;
+}
+
+void Bvh::insertLeaf(U32 leaf)
+{
+	ANKI_ASSERT(m_nodes[leaf].isLeaf());
+
+	if(m_root == MAX_U32)
+	{
+		m_root = leaf;
+		m_nodes[leaf].m_parent = MAX_U32;
+		return;
+	}
+
+	const U32 sibling = findBestSibling(m_nodes[leaf].m_aabbMin, m_nodes[leaf].m_aabbMax);
+	const U32 oldParent = m_nodes[sibling].m_parent;
+
+	// Create a new parent for the sibling and the leaf
+	const U32 newParent = newNode();
+	Node& parent = m_nodes[newParent];
+	parent.m_parent = oldParent;
+	parent.m_left = sibling;
+	parent.m_right = leaf;
+	unionChildren(newParent);
+
+	if(oldParent != MAX_U32)
+	{
+		Node& op = m_nodes[oldParent];
+		if(op.m_left == sibling)
+		{
+			op.m_left = newParent;
+		}
+		else
+		{
+			op.m_right = newParent;
+		}
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	m_nodes[sibling].m_parent = newParent;
+	m_nodes[leaf].m_parent = newParent;
+
+	refitAncestors(oldParent);
+}
+
+void Bvh::removeLeaf(U32 leaf)
+{
+	ANKI_ASSERT(m_nodes[leaf].isLeaf());
+
+	if(leaf == m_root)
+	{
+		m_root = MAX_U32;
+		return;
+	}
+
+	const U32 parent = m_nodes[leaf].m_parent;
+	const U32 grandParent = m_nodes[parent].m_parent;
+	const U32 sibling = (m_nodes[parent].m_left == leaf) ? m_nodes[parent].m_right : m_nodes[parent].m_left;
+
+	if(grandParent != MAX_U32)
+	{
+		Node& gp = m_nodes[grandParent];
+		if(gp.m_left == parent)
+		{
+			gp.m_left = sibling;
+		}
+		else
+		{
+			gp.m_right = sibling;
+		}
+
+		m_nodes[sibling].m_parent = grandParent;
+		releaseNode(parent);
+		refitAncestors(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].m_parent = MAX_U32;
+		releaseNode(parent);
+	}
+
+	m_nodes[leaf].m_parent = MAX_U32;
+}
+
+void Bvh::refitAncestors(U32 idx)
+{
+	while(idx != MAX_U32)
+	{
+		unionChildren(idx);
+		rotate(idx);
+		idx = m_nodes[idx].m_parent;
+	}
+}
+
+void Bvh::rotate(U32 idx)
+{
+	// The node A has children B and C. Try swapping B with one of the children of C (F or G) or C with one of the
+	// children of B (D or E). The swap changes the area of one child only so compare that
+	Node& a = m_nodes[idx];
+	const U32 b = a.m_left;
+	const U32 c = a.m_right;
+	const Node& nodeB = m_nodes[b];
+	const Node& nodeC = m_nodes[c];
+
+	enum class Rotation : U8
+	{
+		NONE,
+		B_F,
+		B_G,
+		C_D,
+		C_E
+	};
+
+	Rotation best = Rotation::NONE;
+	F32 bestDiff = 0.0f;
+
+	if(!nodeC.isLeaf())
+	{
+		const F32 areaC = surfaceArea(nodeC.m_aabbMin, nodeC.m_aabbMax);
+		const Node& f = m_nodes[nodeC.m_left];
+		const Node& g = m_nodes[nodeC.m_right];
+
+		const F32 diffBF = unionSurfaceArea(nodeB, g) - areaC;
+		if(diffBF < bestDiff)
+		{
+			best = Rotation::B_F;
+			bestDiff = diffBF;
+		}
+
+		const F32 diffBG = unionSurfaceArea(nodeB, f) - areaC;
+		if(diffBG < bestDiff)
+		{
+			best = Rotation::B_G;
+			bestDiff = diffBG;
+		}
+	}
+
+	if(!nodeB.isLeaf())
+	{
+		const F32 areaB = surfaceArea(nodeB.m_aabbMin, nodeB.m_aabbMax);
+		const Node& d = m_nodes[nodeB.m_left];
+		const Node& e = m_nodes[nodeB.m_right];
+
+		const F32 diffCD = unionSurfaceArea(nodeC, e) - areaB;
+		if(diffCD < bestDiff)
+		{
+			best = Rotation::C_D;
+			bestDiff = diffCD;
+		}
+
+		const F32 diffCE = unionSurfaceArea(nodeC, d) - areaB;
+		if(diffCE < bestDiff)
+		{
+			best = Rotation::C_E;
+			bestDiff = diffCE;
+		}
+	}
+
+	switch(best)
+	{
+	case Rotation::NONE:
+		break;
+	case Rotation::B_F:
+	{
+		const U32 f = nodeC.m_left;
+		a.m_left = f;
+		m_nodes[c].m_left = b;
+		m_nodes[b].m_parent = c;
+		m_nodes[f].m_parent = idx;
+		unionChildren(c);
+		break;
+	}
+	case Rotation::B_G:
+	{
+		const U32 g = nodeC.m_right;
+		a.m_left = g;
+		m_nodes[c].m_right = b;
+		m_nodes[b].m_parent = c;
+		m_nodes[g].m_parent = idx;
+		unionChildren(c);
+		break;
+	}
+	case Rotation::C_D:
+	{
+		const U32 d = nodeB.m_left;
+		a.m_right = d;
+		m_nodes[b].m_left = c;
+		m_nodes[c].m_parent = b;
+		m_nodes[d].m_parent = idx;
+		unionChildren(b);
+		break;
+	}
+	case Rotation::C_E:
+	{
+		const U32 e = nodeB.m_right;
+		a.m_right = e;
+		m_nodes[b].m_right = c;
+		m_nodes[c].m_parent = b;
+		m_nodes[e].m_parent = idx;
+		unionChildren(b);
+		break;
+	}
+	}
+}
+
+void Bvh::gatherVisible(const Plane frustumPlanes[6],
+	U32 testId,
+	BvhNodeVisibilityTestCallback testCallback,
+	void* testCallbackUserData,
+	DynamicArrayAuto<void*>& out) const
+{
+	walkTree(testId,
+		[&](const Aabb& box) {
+			for(U i = 0; i < 6; ++i)
+			{
+				if(testPlane(frustumPlanes[i], box) < 0.0f)
+				{
+					return false;
+				}
+			}
+
+			return (testCallback) ? testCallback(testCallbackUserData, box) : true;
+		},
+		[&](void* placeableUserData) { out.emplaceBack(placeableUserData); });
+}
+
+U32 Bvh::testRayPacket(const RayPacket& packet,
+	U32 activeMask,
+	const Vec3& aabbMin,
+	const Vec3& aabbMax,
+	Array<F32, RAY_PACKET_SIZE>& tEnters)
+{
+	U32 hitMask = 0;
+	while(activeMask)
+	{
+		const U32 i = getLsb(activeMask);
+		activeMask &= activeMask - 1u;
+
+		// Slab test
+		const Vec3 t0 = (aabbMin - packet.m_origins[i]) * packet.m_invDirs[i];
+		const Vec3 t1 = (aabbMax - packet.m_origins[i]) * packet.m_invDirs[i];
+		const Vec3 tMin = t0.min(t1);
+		const Vec3 tMax = t0.max(t1);
+
+		const F32 tEnter = max(max(tMin.x(), tMin.y()), max(tMin.z(), 0.0f));
+		const F32 tExit = min(min(tMax.x(), tMax.y()), min(tMax.z(), packet.m_maxTs[i]));
+
+		if(tEnter <= tExit)
+		{
+			hitMask |= 1u << i;
+			tEnters[i] = tEnter;
+		}
+	}
+
+	return hitMask;
+}
+
+F32 Bvh::computeSahCost() const
+{
+	F32 cost = 0.0f;
+	if(m_root == MAX_U32)
+	{
+		return cost;
+	}
+
+	// Iterate the live internal nodes by walking down from the root
+	DynamicArrayAuto<U32> stack(m_alloc);
+	stack.emplaceBack(m_root);
+	while(stack.getSize())
+	{
+		const Node& node = m_nodes[stack.getBack()];
+		stack.resize(stack.getSize() - 1);
+
+		if(!node.isLeaf())
+		{
+			cost += surfaceArea(node.m_aabbMin, node.m_aabbMax);
+			stack.emplaceBack(node.m_left);
+			stack.emplaceBack(node.m_right);
+		}
+	}
+
+	return cost;
+}
+
+U32 Bvh::computeHeight() const
+{
+	return (m_root != MAX_U32) ? computeHeightRecursive(m_root) : 0;
+}
+
+U32 Bvh::computeHeightRecursive(U32 idx) const
+{
+	const Node& node = m_nodes[idx];
+	if(node.isLeaf())
+	{
+		return 1;
+	}
+
+	return 1 + max(computeHeightRecursive(node.m_left), computeHeightRecursive(node.m_right));
+}
+
+} // end namespace anki
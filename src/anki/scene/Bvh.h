@@ -0,0 +1,412 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/Math.h>
+#include <anki/collision/Aabb.h>
+#include <anki/collision/Plane.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+#include <anki/util/Atomic.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+// Forward
+class BvhPlaceable;
+
+/// @addtogroup scene
+/// @{
+
+/// Callback to determine if a BVH node is visible.
+using BvhNodeVisibilityTestCallback = Bool (*)(void* userData, const Aabb& box);
+
+/// A ray or a line segment for Bvh::castRays.
+class BvhRay
+{
+public:
+	Vec3 m_origin = Vec3(0.0f);
+
+	/// It doesn't have to be normalized. For a segment set it to (end - origin) and set m_maxT to 1.0.
+	Vec3 m_direction = Vec3(0.0f, 0.0f, -1.0f);
+
+	/// The ray is origin + direction * t for t in [0, m_maxT].
+	F32 m_maxT = MAX_F32;
+};
+
+/// A dynamic bounding volume hierarchy for visibility and ray queries. It's an alternative to the Octree. Every
+/// placeable lives in a single leaf so, unlike the Octree, there is no fan-out and no visited masks. Leafs are
+/// inserted using the surface area heuristic and the tree is kept in shape with tree rotations while refitting.
+///
+/// Placing is deferred: place() only records the new volume in a lock-free list and refit() applies all of them at
+/// once. Objects that move a little only cause a refit of their ancestors, objects that jump get re-inserted.
+class Bvh : public NonCopyable
+{
+public:
+	Bvh(SceneAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~Bvh();
+
+	/// @param fatMargin The leaf boxes are enlarged by that much so small movements don't touch the tree at all.
+	void init(F32 fatMargin = 0.1f);
+
+	/// Place or re-place an element in the tree. The tree will be updated in the next refit().
+	/// @note It's thread-safe and lock-free against other place() calls. Don't call it concurrently with the other
+	///       methods.
+	void place(const Aabb& volume, BvhPlaceable* placeable, Bool updateActualSceneBounds);
+
+	/// Remove an element from the tree.
+	/// @note It's not thread-safe.
+	void remove(BvhPlaceable& placeable);
+
+	/// Apply all the pending place() calls.
+	/// @note It's not thread-safe.
+	void refit();
+
+	/// Gather visible placeables.
+	/// @param frustumPlanes The frustum planes to test against.
+	/// @param testId Unused. Kept for compatibility with the Octree. A placeable is never visited twice.
+	/// @param testCallback A ptr to a function that will be used to perform an additional test to the box of the
+	///                     BVH node. Can be nullptr.
+	/// @param testCallbackUserData Parameter to the testCallback. Can be nullptr.
+	/// @param out The output of the tests.
+	/// @note It's thread-safe against other query calls.
+	void gatherVisible(const Plane frustumPlanes[6],
+		U32 testId,
+		BvhNodeVisibilityTestCallback testCallback,
+		void* testCallbackUserData,
+		DynamicArrayAuto<void*>& out) const;
+
+	/// Walk the tree.
+	/// @tparam TTestAabbFunc The lambda that will test an Aabb. Signature of lambda: Bool(*)(const Aabb& nodeBox)
+	/// @tparam TNewPlaceableFunc The lambda to do something with a visible placeable.
+	///                           Signature: void(*)(void* placeableUserData).
+	/// @param testId Unused. Kept for compatibility with the Octree.
+	/// @param testFunc See TTestAabbFunc.
+	/// @param newPlaceableFunc See TNewPlaceableFunc.
+	/// @note It's thread-safe against other query calls.
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTree(U32 testId, TTestAabbFunc testFunc, TNewPlaceableFunc newPlaceableFunc) const
+	{
+		(void)testId;
+		if(m_root != MAX_U32)
+		{
+			U32 visibleNodes = 0;
+			walkTreeInternal(m_root, testFunc, newPlaceableFunc, visibleNodes);
+			ANKI_TRACE_INC_COUNTER(BVH_VISIBLE_NODES, visibleNodes);
+		}
+	}
+
+	/// Walk the tree once for many tests. See Octree::walkTreeMulti for the details.
+	/// @param firstTestId Unused. Kept for compatibility with the Octree.
+	/// @note It's thread-safe against other query calls.
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTreeMulti(
+		U32 firstTestId, U64 testMask, TTestAabbFunc testFunc, TNewPlaceableFunc newPlaceableFunc) const
+	{
+		(void)firstTestId;
+		ANKI_ASSERT(testMask != 0);
+		if(m_root != MAX_U32)
+		{
+			U32 visibleNodes = 0;
+			walkTreeMultiInternal(m_root, testMask, 0, testFunc, newPlaceableFunc, visibleNodes);
+			ANKI_TRACE_INC_COUNTER(BVH_VISIBLE_NODES, visibleNodes);
+		}
+	}
+
+	/// Cast a batch of rays or segments. The rays are traversed in packets so the nodes are fetched once per packet.
+	/// @tparam THitFunc The lambda that will be called for every placeable whose box is hit by a ray. It should do the
+	///                  exact test and return the new maximum t of the ray. Return the hit's t to get the closest hit
+	///                  or the old maximum to gather all of them.
+	///                  Signature: F32(*)(U32 rayIdx, void* placeableUserData, F32 tEnter, F32 crntMaxT).
+	/// @note It's thread-safe against other query calls.
+	template<typename THitFunc>
+	void castRays(ConstWeakArray<BvhRay> rays, THitFunc hitFunc) const;
+
+	/// Get the bounds of the scene as calculated by the objects that were placed inside the tree. Only the placements
+	/// up to the last refit() count.
+	void getActualSceneBounds(Vec3& min, Vec3& max) const
+	{
+		ANKI_ASSERT(m_actualSceneAabbMin.x() < MAX_F32);
+		ANKI_ASSERT(m_actualSceneAabbMax.x() > MIN_F32);
+		min = m_actualSceneAabbMin;
+		max = m_actualSceneAabbMax;
+	}
+
+	U32 getPlaceableCount() const
+	{
+		return m_placeableCount;
+	}
+
+	/// Get the SAH cost of the tree. It's the sum of the surface areas of the internal nodes. Useful for profiling.
+	F32 computeSahCost() const;
+
+	/// Get the height of the tree. Useful for profiling. It's O(N).
+	U32 computeHeight() const;
+
+private:
+	static const U32 RAY_PACKET_SIZE = 32;
+
+	/// Tree node. A leaf if m_left is MAX_U32.
+	class Node
+	{
+	public:
+		Vec3 m_aabbMin;
+		Vec3 m_aabbMax;
+		U32 m_parent; ///< The next free node if it's in the free list.
+		U32 m_left;
+		U32 m_right;
+		BvhPlaceable* m_placeable;
+
+		Bool isLeaf() const
+		{
+			return m_left == MAX_U32;
+		}
+	};
+
+	/// Ray packet used in castRays.
+	class RayPacket
+	{
+	public:
+		Array<Vec3, RAY_PACKET_SIZE> m_origins;
+		Array<Vec3, RAY_PACKET_SIZE> m_invDirs;
+		Array<F32, RAY_PACKET_SIZE> m_maxTs;
+		U32 m_firstRay;
+	};
+
+	SceneAllocator<U8> m_alloc;
+	F32 m_fatMargin = 0.1f;
+
+	DynamicArray<Node> m_nodes;
+	U32 m_freeList = MAX_U32;
+	U32 m_root = MAX_U32;
+	U32 m_placeableCount = 0;
+
+	/// Lock-free list of the placeables that were placed since the last refit.
+	Atomic<BvhPlaceable*> m_dirtyList = {nullptr};
+
+	Vec3 m_actualSceneAabbMin = Vec3(MAX_F32);
+	Vec3 m_actualSceneAabbMax = Vec3(MIN_F32);
+
+	U32 newNode();
+	void releaseNode(U32 idx);
+
+	void insertLeaf(U32 leaf);
+	void removeLeaf(U32 leaf);
+
+	/// Find the sibling of a new leaf that minimizes the surface area of the tree.
+	U32 findBestSibling(const Vec3& aabbMin, const Vec3& aabbMax) const;
+
+	/// Walk to the root recomputing the boxes and rotating.
+	void refitAncestors(U32 idx);
+
+	/// Try to swap a child with a grandchild if it reduces the surface area.
+	void rotate(U32 idx);
+
+	void unionChildren(U32 idx)
+	{
+		Node& node = m_nodes[idx];
+		node.m_aabbMin = m_nodes[node.m_left].m_aabbMin.min(m_nodes[node.m_right].m_aabbMin);
+		node.m_aabbMax = m_nodes[node.m_left].m_aabbMax.max(m_nodes[node.m_right].m_aabbMax);
+	}
+
+	static F32 surfaceArea(const Vec3& aabbMin, const Vec3& aabbMax)
+	{
+		const Vec3 d = aabbMax - aabbMin;
+		return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+	}
+
+	static F32 unionSurfaceArea(const Node& a, const Node& b)
+	{
+		return surfaceArea(a.m_aabbMin.min(b.m_aabbMin), a.m_aabbMax.max(b.m_aabbMax));
+	}
+
+	const Aabb getNodeAabb(const Node& node) const;
+
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTreeInternal(
+		U32 idx, TTestAabbFunc& testFunc, TNewPlaceableFunc& newPlaceableFunc, U32& visibleNodes) const;
+
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTreeMultiInternal(U32 idx,
+		U64 testMask,
+		U64 insideMask,
+		TTestAabbFunc& testFunc,
+		TNewPlaceableFunc& newPlaceableFunc,
+		U32& visibleNodes) const;
+
+	/// Test a packet of rays against a box.
+	/// @return A mask with the rays that hit the box.
+	static U32 testRayPacket(const RayPacket& packet,
+		U32 activeMask,
+		const Vec3& aabbMin,
+		const Vec3& aabbMax,
+		Array<F32, RAY_PACKET_SIZE>& tEnters);
+
+	template<typename THitFunc>
+	void castRayPacket(U32 idx, RayPacket& packet, U32 activeMask, THitFunc& hitFunc) const;
+
+	U32 computeHeightRecursive(U32 idx) const;
+};
+
+/// An entity that can be placed in a Bvh.
+class BvhPlaceable : public NonCopyable
+{
+	friend class Bvh;
+
+public:
+	void* m_userData = nullptr;
+
+	/// Get the volume that was last given to Bvh::place.
+	Aabb getAabb() const
+	{
+		return Aabb(m_aabbMin, m_aabbMax);
+	}
+
+private:
+	Vec3 m_aabbMin = Vec3(0.0f);
+	Vec3 m_aabbMax = Vec3(0.0f);
+	BvhPlaceable* m_nextDirty = nullptr;
+	U32 m_leaf = MAX_U32;
+	Atomic<U32> m_dirty = {0};
+	Bool m_updateActualSceneBounds = false;
+};
+
+inline const Aabb Bvh::getNodeAabb(const Node& node) const
+{
+	// Leafs are fat, use the actual volume of the placeable instead
+	return (node.isLeaf()) ? node.m_placeable->getAabb() : Aabb(node.m_aabbMin, node.m_aabbMax);
+}
+
+template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+inline void Bvh::walkTreeInternal(
+	U32 idx, TTestAabbFunc& testFunc, TNewPlaceableFunc& newPlaceableFunc, U32& visibleNodes) const
+{
+	const Node& node = m_nodes[idx];
+	if(!testFunc(getNodeAabb(node)))
+	{
+		return;
+	}
+
+	++visibleNodes;
+	if(node.isLeaf())
+	{
+		ANKI_ASSERT(node.m_placeable->m_userData);
+		newPlaceableFunc(node.m_placeable->m_userData);
+	}
+	else
+	{
+		walkTreeInternal(node.m_left, testFunc, newPlaceableFunc, visibleNodes);
+		walkTreeInternal(node.m_right, testFunc, newPlaceableFunc, visibleNodes);
+	}
+}
+
+template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+inline void Bvh::walkTreeMultiInternal(U32 idx,
+	U64 testMask,
+	U64 insideMask,
+	TTestAabbFunc& testFunc,
+	TNewPlaceableFunc& newPlaceableFunc,
+	U32& visibleNodes) const
+{
+	const Node& node = m_nodes[idx];
+
+	// The tests that see the whole parent see the node too
+	U64 visibleMask = insideMask;
+	U64 nodeInsideMask = 0;
+	if(testMask & ~insideMask)
+	{
+		visibleMask |= testFunc(testMask & ~insideMask, getNodeAabb(node), nodeInsideMask);
+	}
+
+	if(!visibleMask)
+	{
+		return;
+	}
+
+	++visibleNodes;
+	if(node.isLeaf())
+	{
+		ANKI_ASSERT(node.m_placeable->m_userData);
+		newPlaceableFunc(visibleMask, node.m_placeable->m_userData);
+	}
+	else
+	{
+		insideMask |= nodeInsideMask & visibleMask;
+		walkTreeMultiInternal(node.m_left, visibleMask, insideMask, testFunc, newPlaceableFunc, visibleNodes);
+		walkTreeMultiInternal(node.m_right, visibleMask, insideMask, testFunc, newPlaceableFunc, visibleNodes);
+	}
+}
+
+template<typename THitFunc>
+inline void Bvh::castRays(ConstWeakArray<BvhRay> rays, THitFunc hitFunc) const
+{
+	if(m_root == MAX_U32)
+	{
+		return;
+	}
+
+	RayPacket packet;
+	for(U32 first = 0; first < rays.getSize(); first += RAY_PACKET_SIZE)
+	{
+		const U32 count = min<U32>(RAY_PACKET_SIZE, rays.getSize() - first);
+		packet.m_firstRay = first;
+
+		for(U32 i = 0; i < count; ++i)
+		{
+			const BvhRay& ray = rays[first + i];
+			packet.m_origins[i] = ray.m_origin;
+			packet.m_maxTs[i] = ray.m_maxT;
+
+			for(U32 c = 0; c < 3; ++c)
+			{
+				const F32 d = ray.m_direction[c];
+				packet.m_invDirs[i][c] = (absolute(d) > EPSILON) ? 1.0f / d : ((d < 0.0f) ? MIN_F32 : MAX_F32);
+			}
+		}
+
+		const U32 activeMask = (count == RAY_PACKET_SIZE) ? MAX_U32 : ((1u << count) - 1u);
+		castRayPacket(m_root, packet, activeMask, hitFunc);
+	}
+}
+
+template<typename THitFunc>
+inline void Bvh::castRayPacket(U32 idx, RayPacket& packet, U32 activeMask, THitFunc& hitFunc) const
+{
+	const Node& node = m_nodes[idx];
+	Array<F32, RAY_PACKET_SIZE> tEnters;
+
+	if(node.isLeaf())
+	{
+		const BvhPlaceable& placeable = *node.m_placeable;
+		U32 mask = testRayPacket(packet, activeMask, placeable.m_aabbMin, placeable.m_aabbMax, tEnters);
+		while(mask)
+		{
+			const U32 i = getLsb(mask);
+			mask &= mask - 1u;
+
+			ANKI_ASSERT(placeable.m_userData);
+			packet.m_maxTs[i] = hitFunc(packet.m_firstRay + i, placeable.m_userData, tEnters[i], packet.m_maxTs[i]);
+		}
+	}
+	else
+	{
+		const U32 mask = testRayPacket(packet, activeMask, node.m_aabbMin, node.m_aabbMax, tEnters);
+		if(mask)
+		{
+			castRayPacket(node.m_left, packet, mask, hitFunc);
+			castRayPacket(node.m_right, packet, mask, hitFunc);
+		}
+	}
+}
+/// @}
+
+} // end namespace anki
@@ -71,7 +71,7 @@ CameraNode::~CameraNode()
 Error CameraNode::init(FrustumType frustumType)
 {
 	// Move component
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Feedback component
 	newComponent<MoveFeedbackComponent>();
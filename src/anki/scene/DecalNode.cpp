@@ -65,7 +65,7 @@ DecalNode::~DecalNode()
 
 Error DecalNode::init()
 {
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 	newComponent<MoveFeedbackComponent>();
 	DecalComponent* decalc = newComponent<DecalComponent>(this);
 	newComponent<ShapeFeedbackComponent>();
@@ -37,7 +37,7 @@ FogDensityNode::FogDensityNode(SceneGraph* scene, CString name)
 	: SceneNode(scene, name)
 {
 	// Create components
-	newComponent<MoveComponent>(MoveComponentFlag::NONE);
+	newComponent<MoveComponent>(this, MoveComponentFlag::NONE);
 	newComponent<FeedbackComponent>();
 	newComponent<FogDensityComponent>();
 	newComponent<SpatialComponent>(this, &m_spatialBox);
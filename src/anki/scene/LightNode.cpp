@@ -139,7 +139,7 @@ PointLightNode::~PointLightNode()
 Error PointLightNode::init()
 {
 	// Move component
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Feedback component
 	newComponent<MovedFeedbackComponent>();
@@ -238,7 +238,7 @@ SpotLightNode::SpotLightNode(SceneGraph* scene, CString name)
 Error SpotLightNode::init()
 {
 	// Move component
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Feedback component
 	newComponent<MovedFeedbackComponent>();
@@ -322,7 +322,7 @@ DirectionalLightNode::DirectionalLightNode(SceneGraph* scene, CString name)
 
 Error DirectionalLightNode::init()
 {
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 	newComponent<FeedbackComponent>();
 	newComponent<LightComponent>(LightComponentType::DIRECTIONAL, getSceneGraph().getNewUuid());
 	SpatialComponent* spatialc = newComponent<SpatialComponent>(this, &m_boundingBox);
@@ -46,12 +46,45 @@ public:
 	MyRenderComponent(ModelNode* node)
 		: MaterialRenderComponent(node, node->m_model->getModelPatches()[node->m_modelPatchIdx]->getMaterial())
 	{
+		m_readyForRendering = false;
+	}
+
+	ANKI_USE_RESULT Error update(SceneNode& node, Second prevTime, Second crntTime, Bool& updated) override
+	{
+		updated = false;
+
+		// Don't stall the frame on new shader variants. Wait for the variants of all passes to compile in the
+		// background because a node that draws in some passes only will flicker
+		if(!m_readyForRendering)
+		{
+			const ModelNode& mnode = static_cast<const ModelNode&>(node);
+			m_readyForRendering = getMaterial().getOrCreateAllVariantsAsync(mnode.m_model->getSkeleton().isCreated());
+		}
+
+		return Error::NONE;
 	}
 
 	void setupRenderableQueueElement(RenderableQueueElement& el) const override
 	{
 		static_cast<const ModelNode&>(getSceneNode()).setupRenderableQueueElement(el);
 	}
+
+	Bool getMeshlets(ConstWeakArray<MeshResource::Meshlet>& meshlets, Transform& worldTransform) const override
+	{
+		const ModelNode& node = static_cast<const ModelNode&>(getSceneNode());
+
+		// The skinned meshes move away from their meshlets
+		if(node.m_model->getSkeleton().isCreated())
+		{
+			return false;
+		}
+
+		RenderingKey key;
+		key.m_lod = 0;
+		meshlets = node.m_model->getModelPatches()[node.m_modelPatchIdx]->getMesh(key).getMeshlets();
+		worldTransform = node.getComponent<MoveComponent>().getWorldTransform();
+		return meshlets.getSize() > 0;
+	}
 };
 
 ModelNode::ModelNode(SceneGraph* scene, CString name)
@@ -77,12 +110,34 @@ Error ModelNode::init(ModelResourcePtr resource, U32 modelPatchIdx)
 	toHash[1] = resource->getUuid();
 	m_mergeKey = computeHash(&toHash[0], sizeof(toHash));
 
+	// Batch key. The patches with the same material and all their meshes in the UnifiedGeometryMemoryPool can be drawn
+	// together without rebinding the index buffer
+	const ModelPatch& patch = *resource->getModelPatches()[modelPatchIdx];
+	RenderingKey meshKey;
+	const IndexType indexType = patch.getMesh(meshKey).getIndexType();
+	Bool canBatch = true;
+	for(U lod = 0; lod < patch.getMeshCount(); ++lod)
+	{
+		meshKey.m_lod = lod;
+		const MeshResource& mesh = patch.getMesh(meshKey);
+		canBatch = canBatch && mesh.isInUnifiedGeometryMemoryPool() && mesh.getIndexType() == indexType;
+	}
+
+	if(canBatch)
+	{
+		Array<U64, 3> batchHash;
+		batchHash[0] = patch.getMaterial()->getUuid();
+		batchHash[1] = U64(indexType);
+		batchHash[2] = resource->getSkeleton().isCreated();
+		m_batchKey = computeHash(&batchHash[0], sizeof(batchHash));
+	}
+
 	// Components
 	if(m_model->getSkeleton().isCreated())
 	{
 		newComponent<SkinComponent>(this, m_model->getSkeleton());
 	}
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 	newComponent<MoveFeedbackComponent>();
 	newComponent<SpatialComponent>(this, &m_obb);
 	newComponent<MyRenderComponent>(this);
@@ -119,92 +174,219 @@ void ModelNode::onMoveComponentUpdate(const MoveComponent& move)
 	sp.setSpatialOrigin(move.getWorldTransform().getOrigin());
 }
 
-void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData) const
+void ModelNode::setupRenderableQueueElement(RenderableQueueElement& el) const
+{
+	el.m_mergeKey = m_mergeKey;
+	el.m_batchKey = m_batchKey;
+
+	// Serial frames can read the node itself because nothing updates it until the frame is rendered
+	if(!getSceneGraph().getPipelinedFrames())
+	{
+		el.m_callback = drawCallback;
+		el.m_userData = this;
+		return;
+	}
+
+	SceneFrameAllocator<U8> alloc = getSceneGraph().getFrameAllocator();
+
+	RenderSnapshot* snapshot = alloc.newInstance<RenderSnapshot>();
+	snapshot->m_node = this;
+	const MoveComponent& movec = getComponent<MoveComponent>();
+	snapshot->m_worldTransform = Mat4(movec.getWorldTransform());
+	snapshot->m_prevWorldTransform = Mat4(movec.getPreviousWorldTransform());
+	snapshot->m_obb = m_obb;
+
+	if(m_model->getSkeleton())
+	{
+		const DynamicArray<Mat4>& boneTrfs = getComponentAt<SkinComponent>(0).getBoneTransforms();
+		Mat4* bones = alloc.newArray<Mat4>(boneTrfs.getSize());
+		memcpy(bones, &boneTrfs[0], boneTrfs.getSizeInBytes());
+		snapshot->m_boneTransforms = ConstWeakArray<Mat4>(bones, boneTrfs.getSize());
+	}
+
+	el.m_callback = drawSnapshotCallback;
+	el.m_userData = snapshot;
+}
+
+void ModelNode::drawInstances(
+	RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData, Bool fromSnapshots, Bool batched) const
 {
-	ANKI_ASSERT(userData.getSize() > 0 && userData.getSize() <= MAX_INSTANCES);
 	ANKI_ASSERT(ctx.m_key.m_instanceCount == userData.getSize());
 
 	CommandBufferPtr& cmdb = ctx.m_commandBuffer;
+	const ModelPatch* patch = m_model->getModelPatches()[m_modelPatchIdx];
 
-	if(!ctx.m_debugDraw)
+	// That will not work on multi-draw and instanced at the same time. Make sure that there is no multi-draw
+	// anywhere
+	ANKI_ASSERT(patch->getSubMeshCount() == 1);
+
+	// Transforms
+	Array<Mat4, MAX_INSTANCES> trfs;
+	Array<Mat4, MAX_INSTANCES> prevTrfs;
+	Bool moved = false;
+	for(U i = 0; i < userData.getSize(); ++i)
 	{
-		const ModelPatch* patch = m_model->getModelPatches()[m_modelPatchIdx];
-
-		// That will not work on multi-draw and instanced at the same time. Make sure that there is no multi-draw
-		// anywhere
-		ANKI_ASSERT(patch->getSubMeshCount() == 1);
-
-		// Transforms
-		Array<Mat4, MAX_INSTANCES> trfs;
-		Array<Mat4, MAX_INSTANCES> prevTrfs;
-		const MoveComponent& movec = getComponent<MoveComponent>();
-		trfs[0] = Mat4(movec.getWorldTransform());
-		prevTrfs[0] = Mat4(movec.getPreviousWorldTransform());
-		Bool moved = trfs[0] != prevTrfs[0];
-		for(U i = 1; i < userData.getSize(); ++i)
+		if(fromSnapshots)
 		{
-			const ModelNode& self2 = *static_cast<const ModelNode*>(userData[i]);
-			const MoveComponent& movec = self2.getComponent<MoveComponent>();
+			const RenderSnapshot& snapshot = *static_cast<const RenderSnapshot*>(userData[i]);
+			trfs[i] = snapshot.m_worldTransform;
+			prevTrfs[i] = snapshot.m_prevWorldTransform;
+		}
+		else
+		{
+			const MoveComponent& movec = static_cast<const ModelNode*>(userData[i])->getComponent<MoveComponent>();
 			trfs[i] = Mat4(movec.getWorldTransform());
 			prevTrfs[i] = Mat4(movec.getPreviousWorldTransform());
-
-			moved = moved || (trfs[i] != prevTrfs[i]);
 		}
 
-		ctx.m_key.m_velocity = moved && ctx.m_key.m_pass == Pass::GB;
-		ModelRenderingInfo modelInf;
-		patch->getRenderingDataSub(ctx.m_key, WeakArray<U8>(), modelInf);
+		moved = moved || (trfs[i] != prevTrfs[i]);
+	}
+
+	ctx.m_key.m_velocity = moved && ctx.m_key.m_pass == Pass::GB;
 
-		// Bones storage
-		if(m_model->getSkeleton())
-		{
-			const SkinComponent& skinc = getComponentAt<SkinComponent>(0);
-			StagingGpuMemoryToken token;
-			void* trfs = ctx.m_stagingGpuAllocator->allocateFrame(
-				skinc.getBoneTransforms().getSize() * sizeof(Mat4), StagingGpuMemoryType::STORAGE, token);
-			memcpy(trfs, &skinc.getBoneTransforms()[0], skinc.getBoneTransforms().getSize() * sizeof(Mat4));
+	const MaterialRenderComponent& renderc =
+		static_cast<const MaterialRenderComponent&>(getComponent<RenderComponent>());
 
-			cmdb->bindStorageBuffer(0, modelInf.m_bindingCount, token.m_buffer, token.m_offset, token.m_range);
+	// Let the texture streaming know how big the instances are on the screen. The shadows don't need fine mips
+	if(ctx.m_key.m_pass == Pass::GB || ctx.m_key.m_pass == Pass::FS)
+	{
+		const Vec4 cameraOrigin = ctx.m_cameraTransform.getTranslationPart().xyz0();
+		F32 screenSpaceSize = 0.0f;
+		for(U i = 0; i < userData.getSize(); ++i)
+		{
+			const Obb& obb = getInstanceObb(userData[i], fromSnapshots);
+			const F32 radius = obb.getExtend().xyz().getLength();
+			const F32 distance = max(radius, (obb.getCenter().xyz0() - cameraOrigin).getLength());
+			screenSpaceSize = max(screenSpaceSize, radius * ctx.m_projectionMatrix(1, 1) / distance);
 		}
 
-		// Program
-		cmdb->bindShaderProgram(modelInf.m_program);
+		renderc.reportTextureUsage(screenSpaceSize);
+	}
 
-		// Uniforms
-		static_cast<const MaterialRenderComponent&>(getComponent<RenderComponent>())
-			.allocateAndSetupUniforms(patch->getMaterial()->getDescriptorSetIndex(),
-				ctx,
-				ConstWeakArray<Mat4>(&trfs[0], userData.getSize()),
-				ConstWeakArray<Mat4>(&prevTrfs[0], userData.getSize()),
-				*ctx.m_stagingGpuAllocator);
+	ModelRenderingInfo modelInf;
+	patch->getRenderingDataSub(ctx.m_key, WeakArray<U8>(), modelInf);
 
-		// Set attributes
-		for(U i = 0; i < modelInf.m_vertexAttributeCount; ++i)
-		{
-			const VertexAttributeInfo& attrib = modelInf.m_vertexAttributes[i];
-			ANKI_ASSERT(attrib.m_format != Format::NONE);
-			cmdb->setVertexAttribute(
-				U32(attrib.m_location), attrib.m_bufferBinding, attrib.m_format, attrib.m_relativeOffset);
-		}
+	// Bones storage
+	if(m_model->getSkeleton())
+	{
+		const ConstWeakArray<Mat4> boneTrfs =
+			(fromSnapshots) ? static_cast<const RenderSnapshot*>(userData[0])->m_boneTransforms
+							: ConstWeakArray<Mat4>(getComponentAt<SkinComponent>(0).getBoneTransforms());
+		StagingGpuMemoryToken token;
+		void* trfs = ctx.m_stagingGpuAllocator->allocateFrame(
+			boneTrfs.getSize() * sizeof(Mat4), StagingGpuMemoryType::STORAGE, token);
+		memcpy(trfs, &boneTrfs[0], boneTrfs.getSize() * sizeof(Mat4));
+
+		cmdb->bindStorageBuffer(0, modelInf.m_bindingCount, token.m_buffer, token.m_offset, token.m_range);
+	}
 
-		// Set vertex buffers
-		for(U i = 0; i < modelInf.m_vertexBufferBindingCount; ++i)
-		{
-			const VertexBufferBinding& binding = modelInf.m_vertexBufferBindings[i];
-			cmdb->bindVertexBuffer(i, binding.m_buffer, binding.m_offset, binding.m_stride, VertexStepRate::VERTEX);
-		}
+	// Program
+	cmdb->bindShaderProgram(modelInf.m_program);
+
+	// Uniforms
+	renderc.allocateAndSetupUniforms(patch->getMaterial()->getDescriptorSetIndex(),
+		ctx,
+		ConstWeakArray<Mat4>(&trfs[0], userData.getSize()),
+		ConstWeakArray<Mat4>(&prevTrfs[0], userData.getSize()),
+		*ctx.m_stagingGpuAllocator);
 
-		// Index buffer
-		cmdb->bindIndexBuffer(modelInf.m_indexBuffer, 0, IndexType::U16);
+	// Set attributes
+	for(U i = 0; i < modelInf.m_vertexAttributeCount; ++i)
+	{
+		const VertexAttributeInfo& attrib = modelInf.m_vertexAttributes[i];
+		ANKI_ASSERT(attrib.m_format != Format::NONE);
+		cmdb->setVertexAttribute(
+			U32(attrib.m_location), attrib.m_bufferBinding, attrib.m_format, attrib.m_relativeOffset);
+	}
 
-		// Draw
+	// Set vertex buffers
+	for(U i = 0; i < modelInf.m_vertexBufferBindingCount; ++i)
+	{
+		const VertexBufferBinding& binding = modelInf.m_vertexBufferBindings[i];
+		cmdb->bindVertexBuffer(i, binding.m_buffer, binding.m_offset, binding.m_stride, VertexStepRate::VERTEX);
+	}
+
+	// Index buffer. The batched draws share the one of the UnifiedGeometryMemoryPool that the caller bound
+	PtrSize indexOffset = 0;
+	if(batched)
+	{
+		ANKI_ASSERT(m_batchKey != 0);
+		indexOffset = modelInf.m_indexBufferOffset;
+	}
+	else
+	{
+		cmdb->bindIndexBuffer(modelInf.m_indexBuffer, modelInf.m_indexBufferOffset, modelInf.m_indexType);
+	}
+	const PtrSize indexSize = (modelInf.m_indexType == IndexType::U16) ? sizeof(U16) : sizeof(U32);
+
+	// Draw. If the visibility tests culled some meshlets of the first LOD draw only the rest
+	if(ctx.m_drawRanges.getSize() > 0 && min<U>(ctx.m_key.m_lod, patch->getMeshCount() - 1) == 0)
+	{
+		ANKI_ASSERT(userData.getSize() == 1);
+		for(const RenderableDrawRange& range : ctx.m_drawRanges)
+		{
+			cmdb->drawElements(PrimitiveTopology::TRIANGLES, range.m_indexCount, 1, range.m_firstIndex, 0, 0);
+		}
+	}
+	else
+	{
 		cmdb->drawElements(PrimitiveTopology::TRIANGLES,
 			modelInf.m_indicesCountArray[0],
 			userData.getSize(),
-			modelInf.m_indicesOffsetArray[0] / sizeof(U16),
+			U32((indexOffset + modelInf.m_indicesOffsetArray[0]) / indexSize),
 			0,
 			0);
 	}
+}
+
+void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData, Bool fromSnapshots) const
+{
+	ANKI_ASSERT(userData.getSize() > 0 && userData.getSize() <= MAX_INSTANCES);
+	ANKI_ASSERT(ctx.m_key.m_instanceCount == userData.getSize());
+
+	CommandBufferPtr& cmdb = ctx.m_commandBuffer;
+
+	if(!ctx.m_debugDraw)
+	{
+		// The instances are sorted on the merge key. Split them to runs of the same model patch
+		const U32 instanceCount = userData.getSize();
+		U32 runBegin = 0;
+		while(runBegin < instanceCount)
+		{
+			const ModelNode& node = getInstanceNode(userData[runBegin], fromSnapshots);
+
+			U32 runEnd = runBegin + 1;
+			while(runEnd < instanceCount
+				  && getInstanceNode(userData[runEnd], fromSnapshots).m_mergeKey == node.m_mergeKey)
+			{
+				++runEnd;
+			}
+
+			// More than one runs means that the drawer batched different meshes of the UnifiedGeometryMemoryPool. Bind
+			// its index buffer once and offset the draws into it
+			const Bool batched = runBegin > 0 || runEnd < instanceCount;
+			if(batched && runBegin == 0)
+			{
+				ANKI_ASSERT(m_batchKey != 0);
+				const ModelPatch* patch = m_model->getModelPatches()[m_modelPatchIdx];
+				RenderingKey meshKey = ctx.m_key;
+				meshKey.m_lod = min<U>(ctx.m_key.m_lod, patch->getMeshCount() - 1);
+
+				BufferPtr indexBuff;
+				PtrSize indexBuffOffset;
+				U32 indexCount;
+				IndexType indexType;
+				patch->getMesh(meshKey).getIndexBufferInfo(indexBuff, indexBuffOffset, indexCount, indexType);
+				cmdb->bindIndexBuffer(indexBuff, 0, indexType);
+			}
+
+			const ConstWeakArray<void*> runUserData(&userData[runBegin], runEnd - runBegin);
+			ctx.m_key.m_instanceCount = runUserData.getSize();
+			node.drawInstances(ctx, runUserData, fromSnapshots, batched);
+
+			runBegin = runEnd;
+		}
+	}
 	else
 	{
 		// Draw the bounding volumes
@@ -266,11 +448,11 @@ void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData
 
 		for(U i = 0; i < userData.getSize(); ++i)
 		{
-			const ModelNode& self2 = *static_cast<const ModelNode*>(userData[i]);
+			const Obb& obb = getInstanceObb(userData[i], fromSnapshots);
 
-			Mat3 rot = self2.m_obb.getRotation().getRotationPart();
-			const Vec4 tsl = self2.m_obb.getCenter().xyz1();
-			const Vec3 scale = self2.m_obb.getExtend().xyz();
+			Mat3 rot = obb.getRotation().getRotationPart();
+			const Vec4 tsl = obb.getCenter().xyz1();
+			const Vec3 scale = obb.getExtend().xyz();
 
 			// Set non uniform scale. Add a margin to avoid flickering
 			const F32 MARGIN = 1.02;
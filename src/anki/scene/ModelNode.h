@@ -41,30 +41,62 @@ private:
 	class MoveFeedbackComponent;
 	class MyRenderComponent;
 
+	/// The state of the node that the draw callbacks need. If the frames are pipelined it's copied to the frame
+	/// allocator in the visibility tests because the scene may update the next frame while the renderer draws this one.
+	class RenderSnapshot
+	{
+	public:
+		const ModelNode* m_node;
+		Mat4 m_worldTransform;
+		Mat4 m_prevWorldTransform;
+		Obb m_obb;
+		ConstWeakArray<Mat4> m_boneTransforms;
+	};
+
 	ModelResourcePtr m_model; ///< The resource
 
 	Obb m_obb;
 	U64 m_mergeKey = 0;
+	U64 m_batchKey = 0;
 	U32 m_modelPatchIdx = 0;
 
 	ShaderProgramResourcePtr m_dbgProg;
 
 	void onMoveComponentUpdate(const MoveComponent& move);
 
-	void draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData) const;
+	/// @param userData The RenderSnapshot of every instance if fromSnapshots is true or the ModelNode otherwise. The
+	///                 instances can be of different model patches if they have the same batch key.
+	void draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData, Bool fromSnapshots) const;
+
+	/// Draw instances of this model patch.
+	/// @param batched If true the caller has bound the index buffer of the UnifiedGeometryMemoryPool.
+	void drawInstances(
+		RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData, Bool fromSnapshots, Bool batched) const;
 
 	static void drawCallback(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData)
 	{
-		const ModelNode& self = *static_cast<const ModelNode*>(userData[0]);
-		self.draw(ctx, userData);
+		static_cast<const ModelNode*>(userData[0])->draw(ctx, userData, false);
+	}
+
+	static void drawSnapshotCallback(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData)
+	{
+		const RenderSnapshot& snapshot = *static_cast<const RenderSnapshot*>(userData[0]);
+		snapshot.m_node->draw(ctx, userData, true);
 	}
 
-	void setupRenderableQueueElement(RenderableQueueElement& el) const
+	static const ModelNode& getInstanceNode(const void* userData, Bool fromSnapshot)
 	{
-		el.m_callback = drawCallback;
-		el.m_userData = this;
-		el.m_mergeKey = m_mergeKey;
+		return (fromSnapshot) ? *static_cast<const RenderSnapshot*>(userData)->m_node
+							  : *static_cast<const ModelNode*>(userData);
 	}
+
+	static const Obb& getInstanceObb(const void* userData, Bool fromSnapshot)
+	{
+		return (fromSnapshot) ? static_cast<const RenderSnapshot*>(userData)->m_obb
+							  : static_cast<const ModelNode*>(userData)->m_obb;
+	}
+
+	void setupRenderableQueueElement(RenderableQueueElement& el) const;
 };
 /// @}
 
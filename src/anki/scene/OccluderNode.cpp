@@ -62,7 +62,7 @@ Error OccluderNode::init(const CString& meshFname)
 	}
 
 	// Create the components
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 	newComponent<MoveFeedbackComponent>();
 	newComponent<OccluderComponent>();
 
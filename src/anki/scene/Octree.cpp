@@ -383,6 +383,68 @@ void Octree::gatherVisibleRecursive(const Plane frustumPlanes[6],
 	}
 }
 
+Bool Octree::testFrustumPlanes(const Plane frustumPlanes[6], const Aabb& box, Bool& inside)
+{
+	// Test the center of the box against the planes moved by the projection of the extend on their normals
+	const Vec4 center = (box.getMax() + box.getMin()) * 0.5f;
+	const Vec4 extend = (box.getMax() - box.getMin()) * 0.5f;
+
+	inside = true;
+	for(U i = 0; i < 6; ++i)
+	{
+		const Plane& plane = frustumPlanes[i];
+		const F32 dist = plane.getNormal().dot(center) - plane.getOffset();
+		const F32 radius = plane.getNormal().abs().dot(extend);
+		if(dist < -radius)
+		{
+			inside = false;
+			return false;
+		}
+
+		inside = inside && dist > radius;
+	}
+
+	return true;
+}
+
+void Octree::gatherVisibleMulti(
+	ConstWeakArray<Array<Plane, 6>> frustumPlanes, U32 firstTestId, WeakArray<DynamicArrayAuto<void*>*> out)
+{
+	ANKI_ASSERT(frustumPlanes.getSize() > 0 && frustumPlanes.getSize() <= 64);
+	ANKI_ASSERT(out.getSize() == frustumPlanes.getSize());
+
+	auto testFunc = [&](U64 testMask, const Aabb& box, U64& insideMask) -> U64 {
+		U64 visibleMask = 0;
+		while(testMask)
+		{
+			const U32 i = getLsb(testMask);
+			const U64 bit = U64(1) << U64(i);
+			testMask &= ~bit;
+
+			Bool inside;
+			if(testFrustumPlanes(&frustumPlanes[i][0], box, inside))
+			{
+				visibleMask |= bit;
+				insideMask |= (inside) ? bit : 0;
+			}
+		}
+
+		return visibleMask;
+	};
+
+	auto newPlaceableFunc = [&](U64 testMask, void* placeableUserData) {
+		while(testMask)
+		{
+			const U32 i = getLsb(testMask);
+			testMask &= ~(U64(1) << U64(i));
+			out[i]->emplaceBack(placeableUserData);
+		}
+	};
+
+	const U64 testMask = (frustumPlanes.getSize() == 64) ? MAX_U64 : (U64(1) << frustumPlanes.getSize()) - 1;
+	walkTreeMulti(firstTestId, testMask, testFunc, newPlaceableFunc);
+}
+
 void Octree::cleanupRecursive(Leaf* leaf, Bool& canDeleteLeafUponReturn)
 {
 	ANKI_ASSERT(leaf);
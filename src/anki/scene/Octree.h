@@ -99,6 +99,40 @@ public:
 		walkTreeInternal(*m_rootLeaf, testId, testFunc, newPlaceableFunc);
 	}
 
+	/// Walk the tree once for many tests. The tests that see a leaf are kept in a bitmask and only they test the
+	/// children of the leaf. The tests that see the whole leaf don't test the children at all.
+	/// @tparam TTestAabbFunc The lambda that will test an Aabb against some of the tests. It returns the tests of
+	///                       testMask that see the box and sets in insideMask the tests that see all of it.
+	///                       Signature: U64(*)(U64 testMask, const Aabb& leafBox, U64& insideMask).
+	/// @tparam TNewPlaceableFunc The lambda to do something with a visible placeable. testMask has the tests that
+	///                           visit the placeable for the first time.
+	///                           Signature: void(*)(U64 testMask, void* placeableUserData).
+	/// @param firstTestId The test index of the 1st bit of the masks. The Nth bit is the test firstTestId + N.
+	/// @param testMask The tests to do.
+	/// @param testFunc See TTestAabbFunc.
+	/// @param newPlaceableFunc See TNewPlaceableFunc.
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTreeMulti(U32 firstTestId, U64 testMask, TTestAabbFunc testFunc, TNewPlaceableFunc newPlaceableFunc)
+	{
+		ANKI_ASSERT(m_rootLeaf);
+		ANKI_ASSERT(testMask != 0 && firstTestId + getMsb(testMask) < 64);
+		walkTreeMultiInternal(*m_rootLeaf, firstTestId, testMask, 0, testFunc, newPlaceableFunc);
+	}
+
+	/// Gather the visible placeables of many frusta with one walk of the tree.
+	/// @param frustumPlanes The planes of the frusta. 6 per frustum.
+	/// @param firstTestId The test index of the 1st frustum. The rest get the next indices.
+	/// @param out The output of the tests. One per frustum.
+	/// @note It's thread-safe against other gatherVisible calls.
+	void gatherVisibleMulti(ConstWeakArray<Array<Plane, 6>> frustumPlanes,
+		U32 firstTestId,
+		WeakArray<DynamicArrayAuto<void*>*> out);
+
+	/// Test a box against the planes of a frustum. A helper for the test functions of walkTreeMulti.
+	/// @param[out] inside True if the box is inside all the planes.
+	/// @return True if the box is not outside of any plane.
+	static Bool testFrustumPlanes(const Plane frustumPlanes[6], const Aabb& box, Bool& inside);
+
 	/// Debug draw.
 	void debugDraw(OctreeDebugDrawer& drawer) const
 	{
@@ -289,6 +323,14 @@ private:
 
 	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
 	void walkTreeInternal(Leaf& leaf, U32 testId, TTestAabbFunc testFunc, TNewPlaceableFunc newPlaceableFunc);
+
+	template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+	void walkTreeMultiInternal(Leaf& leaf,
+		U32 firstTestId,
+		U64 testMask,
+		U64 insideMask,
+		TTestAabbFunc& testFunc,
+		TNewPlaceableFunc& newPlaceableFunc);
 };
 
 /// An entity that can be placed in octrees.
@@ -317,6 +359,15 @@ private:
 		const U64 prev = m_visitedMask.fetchOr(testMask);
 		return !!(testMask & prev);
 	}
+
+	/// Mark many tests as visited.
+	/// @note It's thread-safe.
+	/// @return The tests of testMask that didn't visit it before.
+	U64 notVisitedYet(U64 testMask)
+	{
+		const U64 prev = m_visitedMask.fetchOr(testMask);
+		return testMask & ~prev;
+	}
 };
 
 template<typename TTestAabbFunc, typename TNewPlaceableFunc>
@@ -351,6 +402,63 @@ inline void Octree::walkTreeInternal(Leaf& leaf, U32 testId, TTestAabbFunc testF
 
 	ANKI_TRACE_INC_COUNTER(OCTREE_VISIBLE_LEAFS, visibleLeafs);
 }
+
+template<typename TTestAabbFunc, typename TNewPlaceableFunc>
+inline void Octree::walkTreeMultiInternal(Leaf& leaf,
+	U32 firstTestId,
+	U64 testMask,
+	U64 insideMask,
+	TTestAabbFunc& testFunc,
+	TNewPlaceableFunc& newPlaceableFunc)
+{
+	ANKI_ASSERT(testMask && (insideMask & testMask) == insideMask);
+
+	// Visit the placeables that belong to that leaf. One atomic for all tests
+	for(PlaceableNode& placeableNode : leaf.m_placeables)
+	{
+		const U64 newMask = placeableNode.m_placeable->notVisitedYet(testMask << firstTestId) >> firstTestId;
+		if(newMask)
+		{
+			ANKI_ASSERT(placeableNode.m_placeable->m_userData);
+			newPlaceableFunc(newMask, placeableNode.m_placeable->m_userData);
+		}
+	}
+
+	// The tests that see the whole leaf see all the children
+	const U64 testChildrenMask = testMask & ~insideMask;
+
+	Aabb aabb;
+	U visibleLeafs = 0;
+	(void)visibleLeafs;
+	for(Leaf* child : leaf.m_children)
+	{
+		if(child)
+		{
+			U64 childInsideMask = 0;
+			U64 childMask = insideMask;
+			if(testChildrenMask)
+			{
+				aabb.setMin(child->m_aabbMin);
+				aabb.setMax(child->m_aabbMax);
+				childMask |= testFunc(testChildrenMask, aabb, childInsideMask);
+				ANKI_ASSERT((childMask & testMask) == childMask);
+			}
+
+			if(childMask)
+			{
+				++visibleLeafs;
+				walkTreeMultiInternal(*child,
+					firstTestId,
+					childMask,
+					insideMask | (childInsideMask & childMask),
+					testFunc,
+					newPlaceableFunc);
+			}
+		}
+	}
+
+	ANKI_TRACE_INC_COUNTER(OCTREE_VISIBLE_LEAFS, visibleLeafs);
+}
 /// @}
 
 } // end namespace anki
@@ -265,7 +265,7 @@ Error ParticleEmitterNode::init(const CString& filename)
 	ANKI_CHECK(getResourceManager().loadResource(filename, m_particleEmitterResource));
 
 	// Move component
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Move component feedback
 	newComponent<MoveFeedbackComponent>();
@@ -303,14 +303,28 @@ Error ParticleEmitterNode::init(const CString& filename)
 	return Error::NONE;
 }
 
+void ParticleEmitterNode::setupRenderableQueueElement(RenderableQueueElement& el) const
+{
+	RenderSnapshot* snapshot = getSceneGraph().getFrameAllocator().newInstance<RenderSnapshot>();
+	snapshot->m_node = this;
+	snapshot->m_verts = m_verts;
+	snapshot->m_aliveParticlesCount = m_aliveParticlesCount;
+
+	el.m_callback = drawCallback;
+	el.m_mergeKey = 0;
+	el.m_batchKey = 0;
+	el.m_userData = snapshot;
+}
+
 void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData)
 {
 	ANKI_ASSERT(userData.getSize() == 1);
 
-	const ParticleEmitterNode& self = *static_cast<const ParticleEmitterNode*>(userData[0]);
+	const RenderSnapshot& snapshot = *static_cast<const RenderSnapshot*>(userData[0]);
+	const ParticleEmitterNode& self = *snapshot.m_node;
 
 	// Early exit
-	if(ANKI_UNLIKELY(self.m_aliveParticlesCount == 0))
+	if(ANKI_UNLIKELY(snapshot.m_aliveParticlesCount == 0))
 	{
 		return;
 	}
@@ -322,8 +336,8 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 		// Load verts
 		StagingGpuMemoryToken token;
 		void* gpuStorage = ctx.m_stagingGpuAllocator->allocateFrame(
-			self.m_aliveParticlesCount * VERTEX_SIZE, StagingGpuMemoryType::VERTEX, token);
-		memcpy(gpuStorage, self.m_verts, self.m_aliveParticlesCount * VERTEX_SIZE);
+			snapshot.m_aliveParticlesCount * VERTEX_SIZE, StagingGpuMemoryType::VERTEX, token);
+		memcpy(gpuStorage, snapshot.m_verts, snapshot.m_aliveParticlesCount * VERTEX_SIZE);
 
 		// Program
 		ShaderProgramPtr prog;
@@ -348,7 +362,7 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 				*ctx.m_stagingGpuAllocator);
 
 		// Draw
-		cmdb->drawArrays(PrimitiveTopology::TRIANGLE_STRIP, 4, self.m_aliveParticlesCount, 0, 0);
+		cmdb->drawArrays(PrimitiveTopology::TRIANGLE_STRIP, 4, snapshot.m_aliveParticlesCount, 0, 0);
 	}
 	else
 	{
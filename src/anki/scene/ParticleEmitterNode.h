@@ -48,6 +48,17 @@ private:
 		PHYSICS_ENGINE
 	};
 
+	/// The state of the node that the draw callback needs. It's taken in the visibility tests because the next
+	/// frameUpdate() may run while the renderer draws this frame. The vertices are in the frame allocator and they are
+	/// not written after frameUpdate() so only the pointer is kept.
+	class RenderSnapshot
+	{
+	public:
+		const ParticleEmitterNode* m_node;
+		const void* m_verts;
+		U32 m_aliveParticlesCount;
+	};
+
 	/// Size of a single vertex.
 	static const U VERTEX_SIZE = 5 * sizeof(F32);
 
@@ -74,12 +85,7 @@ private:
 
 	void onMoveComponentUpdate(MoveComponent& move);
 
-	void setupRenderableQueueElement(RenderableQueueElement& el) const
-	{
-		el.m_callback = drawCallback;
-		el.m_mergeKey = 0;
-		el.m_userData = this;
-	}
+	void setupRenderableQueueElement(RenderableQueueElement& el) const;
 
 	static void drawCallback(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData);
 };
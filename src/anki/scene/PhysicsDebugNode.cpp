@@ -39,6 +39,7 @@ public:
 	{
 		el.m_callback = drawCallback;
 		el.m_mergeKey = 1;
+		el.m_batchKey = 0;
 		el.m_userData = this;
 	}
 
@@ -134,7 +134,7 @@ Error PlayerNode::init(const Vec4& position)
 	newComponent<FeedbackComponent>();
 
 	// Move component
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Feedback component #2
 	newComponent<FeedbackComponent2>();
@@ -58,7 +58,7 @@ Error ReflectionProbeNode::init(const Vec4& aabbMinLSpace, const Vec4& aabbMaxLS
 	effectiveDistance = max(effectiveDistance, getSceneGraph().getLimits().m_reflectionProbeEffectiveDistance);
 
 	// Move component first
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 
 	// Feedback component
 	newComponent<MoveFeedbackComponent>();
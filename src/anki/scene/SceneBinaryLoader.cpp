@@ -0,0 +1,289 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/SceneBinaryLoader.h>
+#include <anki/scene/SceneGraph.h>
+#include <anki/scene/ModelNode.h>
+#include <anki/scene/StaticCollisionNode.h>
+#include <anki/scene/ParticleEmitterNode.h>
+#include <anki/scene/ReflectionProbeNode.h>
+#include <anki/scene/OccluderNode.h>
+#include <anki/scene/LightNode.h>
+#include <anki/scene/components/MoveComponent.h>
+#include <anki/scene/components/LightComponent.h>
+#include <anki/resource/ResourceManager.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+class SceneBinaryLoader::Ctx
+{
+public:
+	static const U32 BATCH_SIZE = 16; ///< Nodes that a task takes at once.
+
+	const SceneBinaryLoader* m_loader = nullptr;
+	Atomic<U32> m_crntNode = {0};
+
+	SpinLock m_errLock;
+	Error m_err = Error::NONE; ///< The first error.
+};
+
+Error SceneBinaryLoader::load(const ResourceFilename& filename)
+{
+	ResourceFilePtr file;
+	ANKI_CHECK(m_scene->getResourceManager().getFilesystem().openFile(filename, file));
+	const PtrSize size = file->getSize();
+	if(size == 0)
+	{
+		ANKI_SCENE_LOGE("Scene file is empty: %s", filename.cstr());
+		return Error::USER_DATA;
+	}
+
+	// Use the file in place if it can be mapped. If not read it in a buffer that is aligned like the nodes
+	const void* data;
+	ANKI_CHECK(file->map(data));
+
+	DynamicArrayAuto<Vec4> buffer(m_scene->getAllocator());
+	if(data == nullptr)
+	{
+		buffer.create((size + sizeof(Vec4) - 1) / sizeof(Vec4));
+		ANKI_CHECK(file->read(&buffer[0], size));
+		data = &buffer[0];
+	}
+
+	const Error err = load(data, size);
+	if(err)
+	{
+		ANKI_SCENE_LOGE("Failed to load scene file: %s", filename.cstr());
+	}
+
+	return err;
+}
+
+Error SceneBinaryLoader::load(const void* data, PtrSize dataSize)
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_LOAD);
+	ANKI_CHECK(parse(data, dataSize));
+
+	// Create the nodes in parallel. The tasks grab batches of nodes until there are no more
+	Ctx ctx;
+	ctx.m_loader = this;
+
+	ThreadHive& hive = m_scene->getThreadHive();
+	Array<ThreadHiveTask, ThreadHive::MAX_THREADS> tasks;
+	for(U i = 0; i < hive.getThreadCount(); ++i)
+	{
+		tasks[i] = ANKI_THREAD_HIVE_TASK(
+			{
+				const U32 nodeCount = self->m_loader->m_nodes.getSize();
+				while(true)
+				{
+					const U32 begin = self->m_crntNode.fetchAdd(Ctx::BATCH_SIZE);
+					if(begin >= nodeCount)
+					{
+						break;
+					}
+
+					const U32 end = min(nodeCount, begin + Ctx::BATCH_SIZE);
+					for(U32 nodeIdx = begin; nodeIdx < end; ++nodeIdx)
+					{
+						const Error err = self->m_loader->createNode(self->m_loader->m_nodes[nodeIdx]);
+						if(err)
+						{
+							LockGuard<SpinLock> lock(self->m_errLock);
+							if(!self->m_err)
+							{
+								self->m_err = err;
+							}
+
+							// Stop the other tasks as well
+							self->m_crntNode.store(nodeCount);
+							break;
+						}
+					}
+				}
+			},
+			&ctx,
+			nullptr,
+			nullptr);
+	}
+
+	hive.submitTasks(&tasks[0], hive.getThreadCount());
+	hive.waitAllTasks();
+
+	return ctx.m_err;
+}
+
+Bool SceneBinaryLoader::isValidString(U32 offset, Bool optional) const
+{
+	// The table ends with a null character so any offset inside it is a valid string
+	return (offset == SceneBinaryFile::NO_STRING) ? optional : (offset < m_stringTableSize);
+}
+
+Error SceneBinaryLoader::parse(const void* data, PtrSize dataSize)
+{
+	using File = SceneBinaryFile;
+
+	ANKI_ASSERT(data);
+	if(!isAligned(alignof(File::Node), data))
+	{
+		ANKI_SCENE_LOGE("The scene data are not aligned");
+		return Error::USER_DATA;
+	}
+
+	const U8* mem = static_cast<const U8*>(data);
+
+	// Header
+	if(dataSize < sizeof(File::Header))
+	{
+		ANKI_SCENE_LOGE("Scene file is too small");
+		return Error::USER_DATA;
+	}
+
+	const File::Header& header = *reinterpret_cast<const File::Header*>(mem);
+	if(memcmp(&header.m_magic[0], File::MAGIC, 8) != 0)
+	{
+		ANKI_SCENE_LOGE("Wrong magic word");
+		return Error::USER_DATA;
+	}
+
+	const PtrSize expectedSize =
+		sizeof(File::Header) + PtrSize(header.m_nodeCount) * sizeof(File::Node) + header.m_stringTableSize;
+	if(dataSize != expectedSize)
+	{
+		ANKI_SCENE_LOGE("Wrong scene file size. Expected %lu got %lu", expectedSize, dataSize);
+		return Error::USER_DATA;
+	}
+
+	mem += sizeof(File::Header);
+	m_nodes = ConstWeakArray<File::Node>(reinterpret_cast<const File::Node*>(mem), header.m_nodeCount);
+
+	// String table
+	mem += PtrSize(header.m_nodeCount) * sizeof(File::Node);
+	m_strings = reinterpret_cast<const char*>(mem);
+	m_stringTableSize = header.m_stringTableSize;
+	if(m_stringTableSize > 0 && m_strings[m_stringTableSize - 1] != '\0')
+	{
+		ANKI_SCENE_LOGE("The string table should end with a null character");
+		return Error::USER_DATA;
+	}
+
+	// Check the nodes before creating anything
+	for(const File::Node& node : m_nodes)
+	{
+		if(node.m_type >= File::NodeType::COUNT || !!(node.m_flags & ~File::NodeFlag::ALL))
+		{
+			ANKI_SCENE_LOGE("Wrong node type or flags");
+			return Error::USER_DATA;
+		}
+
+		const Bool needsResource = node.m_type == File::NodeType::MODEL
+								   || node.m_type == File::NodeType::STATIC_COLLISION
+								   || node.m_type == File::NodeType::PARTICLE_EMITTER
+								   || node.m_type == File::NodeType::OCCLUDER;
+		if(!isValidString(node.m_name, true) || !isValidString(node.m_resource, !needsResource))
+		{
+			ANKI_SCENE_LOGE("Wrong string offset");
+			return Error::USER_DATA;
+		}
+	}
+
+	return Error::NONE;
+}
+
+Error SceneBinaryLoader::createNode(const SceneBinaryFile::Node& node) const
+{
+	using File = SceneBinaryFile;
+
+	const CString name = getString(node.m_name);
+	const CString resource = getString(node.m_resource);
+	const Transform trf(node.m_origin.xyz0(), Mat3x4(node.m_rotation), node.m_scale);
+
+	SceneNode* out = nullptr;
+	LightComponent* light = nullptr;
+	switch(node.m_type)
+	{
+	case File::NodeType::MODEL:
+	{
+		ModelNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n, resource));
+		out = n;
+		break;
+	}
+	case File::NodeType::STATIC_COLLISION:
+	{
+		// It takes the transform at init time and it can't move
+		StaticCollisionNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n, resource, trf));
+		return Error::NONE;
+	}
+	case File::NodeType::PARTICLE_EMITTER:
+	{
+		ParticleEmitterNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n, resource));
+		out = n;
+		break;
+	}
+	case File::NodeType::REFLECTION_PROBE:
+	{
+		ReflectionProbeNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n, node.m_params[0], node.m_params[1]));
+		out = n;
+		break;
+	}
+	case File::NodeType::OCCLUDER:
+	{
+		OccluderNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n, resource));
+		out = n;
+		break;
+	}
+	case File::NodeType::POINT_LIGHT:
+	{
+		PointLightNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n));
+		light = &n->getComponent<LightComponent>();
+		light->setRadius(node.m_params[1].x());
+		out = n;
+		break;
+	}
+	case File::NodeType::SPOT_LIGHT:
+	{
+		SpotLightNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n));
+		light = &n->getComponent<LightComponent>();
+		light->setInnerAngle(node.m_params[1].x());
+		light->setOuterAngle(node.m_params[1].y());
+		light->setDistance(node.m_params[1].z());
+		out = n;
+		break;
+	}
+	case File::NodeType::DIRECTIONAL_LIGHT:
+	{
+		DirectionalLightNode* n;
+		ANKI_CHECK(m_scene->newSceneNode(name, n));
+		light = &n->getComponent<LightComponent>();
+		out = n;
+		break;
+	}
+	default:
+		ANKI_ASSERT(!"parse() should have caught it");
+		return Error::USER_DATA;
+	}
+
+	if(light)
+	{
+		light->setDiffuseColor(node.m_params[0]);
+		light->setShadowEnabled(!!(node.m_flags & File::NodeFlag::SHADOW));
+	}
+
+	// Other tasks keep creating transforms so don't edit it in place
+	out->getComponent<MoveComponent>().setLocalTransform(trf);
+	return Error::NONE;
+}
+
+} // end namespace anki
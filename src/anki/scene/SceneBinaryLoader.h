@@ -0,0 +1,122 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/resource/Common.h>
+#include <anki/Math.h>
+#include <anki/util/Enum.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+/// @addtogroup scene
+/// @{
+
+/// Information to decode scene binary files. The file is a Header followed by an array of Node and then by a table of
+/// null terminated strings. The nodes reference the strings by their offset in the table. Everything is laid out the
+/// way it is in memory so the file can be used straight from a memory mapping.
+class SceneBinaryFile
+{
+public:
+	static constexpr const char* MAGIC = "ANKISCN1";
+
+	static const U32 NO_STRING = MAX_U32;
+
+	enum class NodeType : U32
+	{
+		MODEL,
+		STATIC_COLLISION,
+		PARTICLE_EMITTER,
+		REFLECTION_PROBE,
+		OCCLUDER,
+		POINT_LIGHT,
+		SPOT_LIGHT,
+		DIRECTIONAL_LIGHT,
+
+		COUNT
+	};
+
+	enum class NodeFlag : U32
+	{
+		NONE = 0,
+		SHADOW = 1 << 0, ///< The light casts shadows.
+
+		ALL = SHADOW
+	};
+	ANKI_ENUM_ALLOW_NUMERIC_OPERATIONS(NodeFlag, friend)
+
+	struct Node
+	{
+		NodeType m_type;
+		NodeFlag m_flags;
+		U32 m_name; ///< Offset in the string table.
+		U32 m_resource; ///< Offset in the string table or NO_STRING.
+
+		Vec3 m_origin;
+		F32 m_scale;
+		Mat3 m_rotation;
+		U32 _padding[3];
+
+		/// The parameters of the node's components:
+		/// - REFLECTION_PROBE: The min and the max of the AABB in local space.
+		/// - POINT_LIGHT: The diffuse color and the radius in the x of the second.
+		/// - SPOT_LIGHT: The diffuse color and the inner angle, outer angle and distance in the second.
+		/// - DIRECTIONAL_LIGHT: The diffuse color.
+		Array<Vec4, 2> m_params;
+	};
+
+	struct Header
+	{
+		char m_magic[8]; ///< Magic word.
+		U32 m_nodeCount;
+		U32 m_stringTableSize;
+	};
+};
+
+static_assert(sizeof(SceneBinaryFile::Header) == 16, "The nodes should start aligned");
+static_assert(sizeof(SceneBinaryFile::Node) == 112, "The file layout depends on it");
+
+/// Loads scene binary files. The nodes are created in parallel on the ThreadHive of the SceneGraph.
+class SceneBinaryLoader
+{
+public:
+	SceneBinaryLoader(SceneGraph* scene)
+		: m_scene(scene)
+	{
+		ANKI_ASSERT(scene);
+	}
+
+	/// Load a file and create its nodes. Don't call it from a ThreadHive task.
+	ANKI_USE_RESULT Error load(const ResourceFilename& filename);
+
+	/// Create the nodes of a file that is already in memory. Don't call it from a ThreadHive task.
+	ANKI_USE_RESULT Error load(const void* data, PtrSize dataSize);
+
+private:
+	class Ctx;
+
+	SceneGraph* m_scene;
+	ConstWeakArray<SceneBinaryFile::Node> m_nodes;
+	const char* m_strings = nullptr;
+	U32 m_stringTableSize = 0;
+
+	ANKI_USE_RESULT Error parse(const void* data, PtrSize dataSize);
+
+	ANKI_USE_RESULT Error createNode(const SceneBinaryFile::Node& node) const;
+
+	CString getString(U32 offset) const
+	{
+		ANKI_ASSERT(offset == SceneBinaryFile::NO_STRING || offset < m_stringTableSize);
+		return (offset == SceneBinaryFile::NO_STRING) ? CString() : CString(m_strings + offset);
+	}
+
+	Bool isValidString(U32 offset, Bool optional) const;
+};
+/// @}
+
+} // end namespace anki
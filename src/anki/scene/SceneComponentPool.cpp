@@ -0,0 +1,75 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/SceneComponentPool.h>
+
+namespace anki
+{
+
+SceneComponentPool::~SceneComponentPool()
+{
+	ANKI_ASSERT(m_componentCount == 0 && "Some components are still alive");
+
+	for(Chunk& chunk : m_chunks)
+	{
+		m_alloc.getMemoryPool().free(chunk.m_memory);
+	}
+
+	m_chunks.destroy(m_alloc);
+}
+
+void* SceneComponentPool::allocate(PtrSize size, U32 alignment, SceneNode* node, U32& handle)
+{
+	ANKI_ASSERT(node);
+	LockGuard<Mutex> lock(m_mtx);
+
+	if(m_componentSize == 0)
+	{
+		m_componentSize = getAlignedRoundUp(alignment, size);
+		m_componentAlignment = alignment;
+	}
+	ANKI_ASSERT(getAlignedRoundUp(alignment, size) == m_componentSize && alignment == m_componentAlignment);
+
+	// Find a chunk with a free slot or create one
+	while(m_firstNonFullChunk < m_chunks.getSize() && m_chunks[m_firstNonFullChunk].m_liveMask == MAX_U64)
+	{
+		++m_firstNonFullChunk;
+	}
+
+	if(m_firstNonFullChunk == m_chunks.getSize())
+	{
+		Chunk& chunk = *m_chunks.emplaceBack(m_alloc);
+		chunk.m_memory =
+			static_cast<U8*>(m_alloc.getMemoryPool().allocate(m_componentSize * COMPONENTS_PER_CHUNK, alignment));
+		chunk.m_liveMask = 0;
+	}
+
+	Chunk& chunk = m_chunks[m_firstNonFullChunk];
+	const U32 idx = getLsb(~chunk.m_liveMask);
+	chunk.m_liveMask |= U64(1) << U64(idx);
+	chunk.m_nodes[idx] = node;
+	++m_componentCount;
+
+	handle = m_firstNonFullChunk * COMPONENTS_PER_CHUNK + idx;
+	return chunk.m_memory + idx * m_componentSize;
+}
+
+void SceneComponentPool::free(U32 handle)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	const U32 chunkIdx = handle / COMPONENTS_PER_CHUNK;
+	const U64 bit = U64(1) << U64(handle % COMPONENTS_PER_CHUNK);
+	Chunk& chunk = m_chunks[chunkIdx];
+	ANKI_ASSERT(chunk.m_liveMask & bit);
+
+	chunk.m_liveMask &= ~bit;
+	chunk.m_nodes[handle % COMPONENTS_PER_CHUNK] = nullptr;
+	--m_componentCount;
+
+	m_firstNonFullChunk = min(m_firstNonFullChunk, chunkIdx);
+}
+
+} // end namespace anki
@@ -0,0 +1,98 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class SceneComponent;
+
+/// @addtogroup scene
+/// @{
+
+/// Contiguous storage for the components of a single class. The components are allocated in chunks so their addresses
+/// never change. A component is identified by a handle that is its index in the pool.
+class SceneComponentPool : public NonCopyable
+{
+public:
+	static const U32 COMPONENTS_PER_CHUNK = 64;
+
+	SceneComponentPool()
+	{
+	}
+
+	~SceneComponentPool();
+
+	void init(SceneAllocator<U8> alloc)
+	{
+		m_alloc = alloc;
+	}
+
+	/// Allocate memory for a component. All the components of the pool should have the same size and alignment.
+	/// @param size The size of the component.
+	/// @param alignment The alignment of the component.
+	/// @param node The owner of the component.
+	/// @param[out] handle The handle of the component.
+	/// @note It's thread-safe against allocate() and free().
+	void* allocate(PtrSize size, U32 alignment, SceneNode* node, U32& handle);
+
+	/// Free the memory of a component. It doesn't call the destructor.
+	/// @note It's thread-safe against allocate() and free().
+	void free(U32 handle);
+
+	U32 getComponentCount() const
+	{
+		return m_componentCount;
+	}
+
+	U32 getChunkCount() const
+	{
+		return U32(m_chunks.getSize());
+	}
+
+	/// Iterate the live components of a chunk.
+	/// @param chunkIdx The chunk.
+	/// @param func A functor with signature void(SceneComponent& comp, SceneNode& node).
+	template<typename TFunc>
+	void iterateChunk(U32 chunkIdx, TFunc func)
+	{
+		const Chunk& chunk = m_chunks[chunkIdx];
+		U64 mask = chunk.m_liveMask;
+		while(mask)
+		{
+			const U32 idx = getLsb(mask);
+			mask &= mask - 1;
+			func(*reinterpret_cast<SceneComponent*>(chunk.m_memory + idx * m_componentSize), *chunk.m_nodes[idx]);
+		}
+	}
+
+private:
+	class Chunk
+	{
+	public:
+		U8* m_memory;
+		U64 m_liveMask;
+		Array<SceneNode*, COMPONENTS_PER_CHUNK> m_nodes;
+	};
+
+	static_assert(COMPONENTS_PER_CHUNK == sizeof(U64) * 8, "The live components of a chunk are a U64 mask");
+
+	SceneAllocator<U8> m_alloc;
+	DynamicArray<Chunk> m_chunks;
+	PtrSize m_componentSize = 0; ///< The size of the components rounded up to their alignment.
+	U32 m_componentAlignment = 0;
+	U32 m_componentCount = 0;
+	U32 m_firstNonFullChunk = 0; ///< The chunks before that are full.
+	Mutex m_mtx;
+};
+/// @}
+
+} // end namespace anki
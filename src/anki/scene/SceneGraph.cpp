@@ -8,13 +8,18 @@
 #include <anki/scene/PhysicsDebugNode.h>
 #include <anki/scene/ModelNode.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/Bvh.h>
+#include <anki/scene/TransformHierarchy.h>
 #include <anki/scene/components/FrustumComponent.h>
+#include <anki/scene/components/SkinComponent.h>
+#include <anki/scene/components/SpatialComponent.h>
 #include <anki/core/Trace.h>
 #include <anki/physics/PhysicsWorld.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/renderer/MainRenderer.h>
 #include <anki/misc/ConfigSet.h>
 #include <anki/util/ThreadHive.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
 
 namespace anki
 {
@@ -47,10 +52,9 @@ SceneGraph::~SceneGraph()
 
 	deleteNodesMarkedForDeletion();
 
-	if(m_octree)
-	{
-		m_alloc.deleteInstance(m_octree);
-	}
+	m_alloc.deleteInstance(m_octree);
+	m_alloc.deleteInstance(m_bvh);
+	m_alloc.deleteInstance(m_transforms);
 }
 
 Error SceneGraph::init(AllocAlignedCallback allocCb,
@@ -70,8 +74,13 @@ Error SceneGraph::init(AllocAlignedCallback allocCb,
 	m_input = input;
 	m_scriptManager = scriptManager;
 
-	m_alloc = SceneAllocator<U8>(allocCb, allocCbData);
-	m_frameAlloc = SceneFrameAllocator<U8>(allocCb, allocCbData, 1 * 1024 * 1024);
+	m_alloc = SceneAllocator<U8>(allocCb, allocCbData, true);
+	for(SceneFrameAllocator<U8>& frameAlloc : m_frameAllocs)
+	{
+		// The visibility tests allocate from many threads at once. Give them their own arenas
+		frameAlloc = SceneFrameAllocator<U8>(
+			allocCb, allocCbData, 1 * 1024 * 1024, 2.0f, 0, true, ANKI_SAFE_ALIGNMENT, 16 * 1024);
+	}
 
 	// Limits
 	m_limits.m_earlyZDistance = config.getNumber("scene.earlyZDistance");
@@ -81,8 +90,23 @@ Error SceneGraph::init(AllocAlignedCallback allocCb,
 
 	ANKI_CHECK(m_events.init(this));
 
-	m_octree = m_alloc.newInstance<Octree>(m_alloc);
-	m_octree->init(m_sceneMin, m_sceneMax, 5); // TODO
+	m_transforms = m_alloc.newInstance<TransformHierarchy>(m_alloc);
+
+	for(SceneComponentPool& pool : m_componentPools)
+	{
+		pool.init(m_alloc);
+	}
+
+	if(config.getNumber("scene.bvh"))
+	{
+		m_bvh = m_alloc.newInstance<Bvh>(m_alloc);
+		m_bvh->init(config.getNumber("scene.bvhFatMargin"));
+	}
+	else
+	{
+		m_octree = m_alloc.newInstance<Octree>(m_alloc);
+		m_octree->init(m_sceneMin, m_sceneMax, 5); // TODO
+	}
 
 	// Init the default main camera
 	ANKI_CHECK(newSceneNode<PerspectiveCameraNode>("mainCamera", m_defaultMainCam));
@@ -99,6 +123,7 @@ Error SceneGraph::init(AllocAlignedCallback allocCb,
 Error SceneGraph::registerNode(SceneNode* node)
 {
 	ANKI_ASSERT(node);
+	LockGuard<Mutex> lock(m_nodesMtx);
 
 	// Add to dict if it has a name
 	if(node->getName())
@@ -121,6 +146,8 @@ Error SceneGraph::registerNode(SceneNode* node)
 
 void SceneGraph::unregisterNode(SceneNode* node)
 {
+	LockGuard<Mutex> lock(m_nodesMtx);
+
 	// Remove from the graph
 	m_nodes.erase(node);
 	--m_nodesCount;
@@ -191,14 +218,19 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 	m_timestamp = *m_globalTimestamp;
 	ANKI_ASSERT(m_timestamp > 0);
 
-	// Reset the framepool
-	m_frameAlloc.getMemoryPool().reset();
+	// Move to the next frame allocator and reset it. The previous one might still be used by the renderer
+	const U32 frameAllocIdx = (m_crntFrameAlloc.load(AtomicMemoryOrder::RELAXED) + 1) % m_frameAllocs.getSize();
+	m_frameAllocs[frameAllocIdx].getMemoryPool().reset();
+	m_crntFrameAlloc.store(frameAllocIdx, AtomicMemoryOrder::RELAXED);
 
 	// Delete stuff
 	{
 		ANKI_TRACE_SCOPED_EVENT(SCENE_MARKED_FOR_DELETION);
 		m_events.deleteEventsMarkedForDeletion();
-		deleteNodesMarkedForDeletion();
+		if(!m_pipelinedFrames)
+		{
+			deleteNodesMarkedForDeletion();
+		}
 	}
 
 	// Update
@@ -213,6 +245,11 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 		ANKI_TRACE_SCOPED_EVENT(SCENE_NODES_UPDATE);
 		ANKI_CHECK(m_events.updateAllEvents(prevUpdateTime, crntTime));
 
+		// The world transforms of the nodes that moved by the physics, the events or in the previous frame. The rest
+		// will be computed while updating the nodes. It may sort the transforms. That's fine even if the previous frame
+		// still renders because the draw callbacks read the copies that the visibility tests made
+		m_transforms->update(*m_threadHive);
+
 		// Then the rest
 		Array<ThreadHiveTask, ThreadHive::MAX_THREADS> tasks;
 		UpdateSceneNodesCtx updateCtx;
@@ -237,12 +274,34 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 
 		m_threadHive->submitTasks(&tasks[0], m_threadHive->getThreadCount());
 		m_threadHive->waitAllTasks();
+
+		// Then the components that are updated per type
+		ANKI_CHECK(updateComponentsOfType<SkinComponent>(prevUpdateTime, crntTime));
+		ANKI_CHECK(updateComponentsOfType<SpatialComponent>(prevUpdateTime, crntTime));
+	}
+
+	// Apply the placements of the spatial components. The visibility tests and the scene bounds see them after that
+	if(m_bvh)
+	{
+		m_bvh->refit();
 	}
 
 	m_stats.m_updateTime = HighRezTimer::getCurrentTime() - m_stats.m_updateTime;
 	return Error::NONE;
 }
 
+void SceneGraph::getActualSceneBounds(Vec3& min, Vec3& max) const
+{
+	if(m_bvh)
+	{
+		m_bvh->getActualSceneBounds(min, max);
+	}
+	else
+	{
+		m_octree->getActualSceneBounds(min, max);
+	}
+}
+
 void SceneGraph::doVisibilityTests(RenderQueue& rqueue)
 {
 	m_stats.m_visibilityTestsTime = HighRezTimer::getCurrentTime();
@@ -250,6 +309,14 @@ void SceneGraph::doVisibilityTests(RenderQueue& rqueue)
 	m_stats.m_visibilityTestsTime = HighRezTimer::getCurrentTime() - m_stats.m_visibilityTestsTime;
 }
 
+/// The pooled components of some classes are updated per type after all nodes are updated. Nothing else in their
+/// nodes should depend on their update.
+static Bool isUpdatedPerType(const SceneComponent& comp)
+{
+	return comp.getPoolHandle() != MAX_U32
+		   && (comp.getType() == SceneComponentType::SKIN || comp.getType() == SceneComponentType::SPATIAL);
+}
+
 Error SceneGraph::updateNode(Second prevTime, Second crntTime, SceneNode& node)
 {
 	ANKI_TRACE_INC_COUNTER(SCENE_NODES_UPDATED, 1);
@@ -259,6 +326,11 @@ Error SceneGraph::updateNode(Second prevTime, Second crntTime, SceneNode& node)
 	// Components update
 	Timestamp componentTimestamp = 0;
 	err = node.iterateComponents([&](SceneComponent& comp) -> Error {
+		if(isUpdatedPerType(comp))
+		{
+			return Error::NONE;
+		}
+
 		Bool updated = false;
 		Error e = comp.update(node, prevTime, crntTime, updated);
 
@@ -347,4 +419,40 @@ Error SceneGraph::updateNodes(UpdateSceneNodesCtx& ctx) const
 	return err;
 }
 
+template<typename TComponent>
+Error SceneGraph::updateComponentsOfType(Second prevTime, Second crntTime)
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_COMPONENTS_UPDATE);
+
+	SceneComponentPool& pool = m_componentPools[TComponent::CLASS_TYPE];
+	const U32 CHUNKS_PER_TASK = 4;
+	SpinLock errLock;
+	Error firstErr = Error::NONE;
+	parallelFor(*m_threadHive, 0, pool.getChunkCount(), CHUNKS_PER_TASK, [&](U32 begin, U32 end, U32 threadId) {
+		for(U32 chunk = begin; chunk < end; ++chunk)
+		{
+			pool.iterateChunk(chunk, [&](SceneComponent& comp, SceneNode& node) {
+				// The pool has only that class so skip the virtual call
+				Bool updated = false;
+				const Error err = static_cast<TComponent&>(comp).TComponent::update(node, prevTime, crntTime, updated);
+				if(err)
+				{
+					LockGuard<SpinLock> lock(errLock);
+					if(!firstErr)
+					{
+						firstErr = err;
+					}
+				}
+				else if(updated)
+				{
+					comp.setTimestamp(m_timestamp);
+					node.setComponentMaxTimestamp(m_timestamp);
+				}
+			});
+		}
+	});
+
+	return firstErr;
+}
+
 } // end namespace anki
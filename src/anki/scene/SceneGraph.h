@@ -7,11 +7,13 @@
 
 #include <anki/scene/Common.h>
 #include <anki/scene/SceneNode.h>
+#include <anki/scene/SceneComponentPool.h>
 #include <anki/Math.h>
 #include <anki/util/Singleton.h>
 #include <anki/util/HighRezTimer.h>
 #include <anki/util/HashMap.h>
 #include <anki/core/App.h>
+#include <anki/core/FramePipeline.h>
 #include <anki/scene/events/EventManager.h>
 
 namespace anki
@@ -26,6 +28,8 @@ class ConfigSet;
 class PerspectiveCameraNode;
 class UpdateSceneNodesCtx;
 class Octree;
+class Bvh;
+class TransformHierarchy;
 
 /// @addtogroup scene
 /// @{
@@ -37,6 +41,7 @@ public:
 	Second m_updateTime ANKI_DEBUG_CODE(= 0.0);
 	Second m_visibilityTestsTime ANKI_DEBUG_CODE(= 0.0);
 	Second m_physicsUpdate ANKI_DEBUG_CODE(= 0.0);
+	U32 m_culledTriangleCount = 0; ///< The triangles that the meshlet culling removed in the last visibility tests.
 };
 
 /// SceneGraph limits.
@@ -79,10 +84,12 @@ public:
 		return m_alloc;
 	}
 
+	/// Get the allocator of the frame that is being updated. There is one allocator per frame in flight and each gets
+	/// reset when its frame starts updating again.
 	/// @note Return a copy
 	SceneFrameAllocator<U8> getFrameAllocator() const
 	{
-		return m_frameAlloc;
+		return m_frameAllocs[m_crntFrameAlloc.load(AtomicMemoryOrder::RELAXED)];
 	}
 
 	SceneNode& getActiveCameraNode()
@@ -125,6 +132,22 @@ public:
 
 	ANKI_USE_RESULT Error update(Second prevUpdateTime, Second crntTime);
 
+	/// Set if a previous frame renders while this one updates. If true update() won't delete the nodes marked for
+	/// deletion because the rendering frame might reference them. The caller should call
+	/// deleteNodesMarkedForDeletion() when nothing renders. The draw callbacks also need snapshots of their nodes.
+	void setPipelinedFrames(Bool pipelined)
+	{
+		m_pipelinedFrames = pipelined;
+	}
+
+	Bool getPipelinedFrames() const
+	{
+		return m_pipelinedFrames;
+	}
+
+	/// Delete the nodes marked for deletion. No scene threads or rendering should be running at that point.
+	void deleteNodesMarkedForDeletion();
+
 	void doVisibilityTests(RenderQueue& rqueue);
 
 	SceneNode& findSceneNode(const CString& name);
@@ -150,7 +173,7 @@ public:
 	template<typename Func>
 	ANKI_USE_RESULT Error iterateSceneNodes(PtrSize begin, PtrSize end, Func func);
 
-	/// Create a new SceneNode
+	/// Create a new SceneNode. It's thread-safe against other newSceneNode() calls.
 	template<typename Node, typename... Args>
 	ANKI_USE_RESULT Error newSceneNode(const CString& name, Node*& node, Args&&... args);
 
@@ -228,6 +251,34 @@ public:
 		return *m_octree;
 	}
 
+	/// Use the BVH instead of the octree. It's chosen at init time from the config.
+	Bool isUsingBvh() const
+	{
+		return m_bvh != nullptr;
+	}
+
+	Bvh& getBvh()
+	{
+		ANKI_ASSERT(m_bvh);
+		return *m_bvh;
+	}
+
+	/// The transforms of the MoveComponents.
+	TransformHierarchy& getTransformHierarchy()
+	{
+		ANKI_ASSERT(m_transforms);
+		return *m_transforms;
+	}
+
+	/// The storage of the components of a type. Only some classes are pooled, see SceneComponent::PooledClass.
+	SceneComponentPool& getComponentPool(SceneComponentType type)
+	{
+		return m_componentPools[type];
+	}
+
+	/// Get the bounds of the scene as calculated by the objects that were placed in the octree or the BVH.
+	void getActualSceneBounds(Vec3& min, Vec3& max) const;
+
 private:
 	class UpdateSceneNodesCtx;
 
@@ -243,11 +294,14 @@ private:
 	ScriptManager* m_scriptManager = nullptr;
 
 	SceneAllocator<U8> m_alloc;
-	SceneFrameAllocator<U8> m_frameAlloc;
+	Array<SceneFrameAllocator<U8>, FramePipeline::FRAME_SLOT_COUNT> m_frameAllocs;
+	Atomic<U32> m_crntFrameAlloc = {0};
+	Bool m_pipelinedFrames = false;
 
 	IntrusiveList<SceneNode> m_nodes;
 	U32 m_nodesCount = 0;
 	HashMap<CString, SceneNode*> m_nodesDict;
+	Mutex m_nodesMtx; ///< Protects m_nodes and m_nodesDict when nodes are created in parallel.
 
 	SceneNode* m_mainCam = nullptr;
 	Timestamp m_activeCameraChangeTimestamp = 0;
@@ -256,6 +310,9 @@ private:
 	EventManager m_events;
 
 	Octree* m_octree = nullptr;
+	Bvh* m_bvh = nullptr;
+	TransformHierarchy* m_transforms = nullptr;
+	Array<SceneComponentPool, U(SceneComponentType::COUNT)> m_componentPools;
 
 	Vec3 m_sceneMin = {-1000.0f, -200.0f, -1000.0f};
 	Vec3 m_sceneMax = {1000.0f, 200.0f, 1000.0f};
@@ -271,12 +328,13 @@ private:
 	ANKI_USE_RESULT Error registerNode(SceneNode* node);
 	void unregisterNode(SceneNode* node);
 
-	/// Delete the nodes that are marked for deletion
-	void deleteNodesMarkedForDeletion();
-
 	ANKI_USE_RESULT Error updateNodes(UpdateSceneNodesCtx& ctx) const;
 	ANKI_USE_RESULT static Error updateNode(Second prevTime, Second crntTime, SceneNode& node);
 
+	/// Update the pooled components of a class in parallel.
+	template<typename TComponent>
+	ANKI_USE_RESULT Error updateComponentsOfType(Second prevTime, Second crntTime);
+
 	/// Do visibility tests.
 	static void doVisibilityTests(SceneNode& frustumable, SceneGraph& scene, RenderQueue& rqueue);
 };
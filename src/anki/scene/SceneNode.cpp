@@ -5,6 +5,7 @@
 
 #include <anki/scene/SceneNode.h>
 #include <anki/scene/SceneGraph.h>
+#include <anki/scene/components/MoveComponent.h>
 
 namespace anki
 {
@@ -28,7 +29,17 @@ SceneNode::~SceneNode()
 	for(; it != end; ++it)
 	{
 		SceneComponent* comp = *it;
-		alloc.deleteInstance(comp);
+		const U32 poolHandle = comp->getPoolHandle();
+		if(poolHandle != MAX_U32)
+		{
+			const SceneComponentType type = comp->getType();
+			comp->~SceneComponent();
+			m_scene->getComponentPool(type).free(poolHandle);
+		}
+		else
+		{
+			alloc.deleteInstance(comp);
+		}
 	}
 
 	Base::destroy(alloc);
@@ -53,6 +64,23 @@ void SceneNode::setMarkedForDeletion()
 	(void)err;
 }
 
+void SceneNode::addChild(SceneNode* obj)
+{
+	Base::addChild(getAllocator(), obj);
+
+	// Link the transforms
+	MoveComponent* move = obj->tryGetComponent<MoveComponent>();
+	if(move)
+	{
+		move->updateParent(*obj);
+	}
+}
+
+void* SceneNode::allocatePooledComponent(SceneComponentType type, PtrSize size, U32 alignment, U32& handle)
+{
+	return m_scene->getComponentPool(type).allocate(size, alignment, this, handle);
+}
+
 Timestamp SceneNode::getGlobalTimestamp() const
 {
 	return m_scene->getGlobalTimestamp();
@@ -11,6 +11,7 @@
 #include <anki/util/BitSet.h>
 #include <anki/util/List.h>
 #include <anki/util/Enum.h>
+#include <anki/util/Atomic.h>
 #include <anki/scene/components/SceneComponent.h>
 
 namespace anki
@@ -68,23 +69,20 @@ public:
 
 	Timestamp getComponentMaxTimestamp() const
 	{
-		return m_maxComponentTimestamp;
+		return m_maxComponentTimestamp.load();
 	}
 
 	void setComponentMaxTimestamp(Timestamp maxComponentTimestamp)
 	{
 		ANKI_ASSERT(maxComponentTimestamp > 0);
-		m_maxComponentTimestamp = maxComponentTimestamp;
+		m_maxComponentTimestamp.store(maxComponentTimestamp);
 	}
 
 	SceneAllocator<U8> getAllocator() const;
 
 	SceneFrameAllocator<U8> getFrameAllocator() const;
 
-	void addChild(SceneNode* obj)
-	{
-		Base::addChild(getAllocator(), obj);
-	}
+	void addChild(SceneNode* obj);
 
 	/// This is called by the scene every frame after logic and before rendering. By default it does nothing.
 	/// @param prevUpdateTime Timestamp of the previous update
@@ -206,7 +204,8 @@ protected:
 	template<typename TComponent, typename... TArgs>
 	TComponent* newComponent(TArgs&&... args)
 	{
-		TComponent* comp = getAllocator().newInstance<TComponent>(std::forward<TArgs>(args)...);
+		TComponent* comp = newComponentInternal<TComponent>(
+			std::is_same<TComponent, typename TComponent::PooledClass>(), std::forward<TArgs>(args)...);
 		m_components.emplaceBack(getAllocator(), comp);
 		return comp;
 	}
@@ -220,9 +219,28 @@ private:
 
 	DynamicArray<SceneComponent*> m_components;
 
-	Timestamp m_maxComponentTimestamp = 0;
+	Atomic<Timestamp> m_maxComponentTimestamp = {0}; ///< Atomic because the components get updated per type as well.
 
 	Bool m_markedForDeletion = false;
+
+	/// Create a component in the pool of its class.
+	template<typename TComponent, typename... TArgs>
+	TComponent* newComponentInternal(std::true_type pooled, TArgs&&... args)
+	{
+		U32 handle;
+		void* mem = allocatePooledComponent(TComponent::CLASS_TYPE, sizeof(TComponent), alignof(TComponent), handle);
+		TComponent* comp = ::new(mem) TComponent(std::forward<TArgs>(args)...);
+		comp->setPoolHandle(handle);
+		return comp;
+	}
+
+	template<typename TComponent, typename... TArgs>
+	TComponent* newComponentInternal(std::false_type pooled, TArgs&&... args)
+	{
+		return getAllocator().newInstance<TComponent>(std::forward<TArgs>(args)...);
+	}
+
+	void* allocatePooledComponent(SceneComponentType type, PtrSize size, U32 alignment, U32& handle);
 };
 /// @}
 
@@ -6,6 +6,7 @@
 #include <anki/scene/SoftwareRasterizer.h>
 #include <anki/collision/Aabb.h>
 #include <anki/collision/Functions.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
 #include <anki/core/Trace.h>
 
 namespace anki
@@ -20,17 +21,51 @@ void SoftwareRasterizer::prepare(const Mat4& mv, const Mat4& p, U width, U heigh
 	extractClipPlanes(p, m_planesL);
 	extractClipPlanes(m_mvp, m_planesW);
 
-	// Reset z buffer
 	ANKI_ASSERT(width > 0 && height > 0);
 	m_width = width;
 	m_height = height;
-	U size = width * height;
+	m_tileCountX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_tileCountY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+	// Reset z buffer
+	m_zbufferStride = getAlignedRoundUp(4, m_width);
+	const U32 size = m_zbufferStride * m_height;
 	if(m_zbuffer.getSize() < size)
 	{
 		m_zbuffer.destroy(m_alloc);
 		m_zbuffer.create(m_alloc, size);
 	}
-	memset(&m_zbuffer[0], 0xFF, sizeof(m_zbuffer[0]) * size);
+
+	for(U32 i = 0; i < size; ++i)
+	{
+		m_zbuffer[i] = 1.0f;
+	}
+
+	// Compute the HiZ levels. Every level is the half of the previous rounded up till it reaches 1x1
+	m_hizLevels[0].m_size = UVec2(m_width, m_height);
+	m_hizLevels[0].m_offset = 0;
+	m_hizLevelCount = 1;
+	U32 hizSize = 0;
+	while(m_hizLevelCount < MAX_HIZ_LEVELS
+		  && (m_hizLevels[m_hizLevelCount - 1].m_size.x() > 1 || m_hizLevels[m_hizLevelCount - 1].m_size.y() > 1))
+	{
+		const UVec2& prevSize = m_hizLevels[m_hizLevelCount - 1].m_size;
+		HiZLevel& level = m_hizLevels[m_hizLevelCount++];
+		level.m_size = UVec2((prevSize.x() + 1) / 2, (prevSize.y() + 1) / 2);
+		level.m_offset = hizSize;
+		hizSize += level.m_size.x() * level.m_size.y();
+	}
+
+	if(m_hizMax.getSize() < hizSize)
+	{
+		m_hizMax.destroy(m_alloc);
+		m_hizMax.create(m_alloc, hizSize);
+		m_hizMin.destroy(m_alloc);
+		m_hizMin.create(m_alloc, hizSize);
+	}
+
+	// Reset the triangles
+	m_triCount = 0;
 }
 
 void SoftwareRasterizer::clipTriangle(const Vec4* inVerts, Vec4* outVerts, U& outVertCount) const
@@ -169,6 +204,12 @@ void SoftwareRasterizer::draw(const F32* verts, U vertCount, U stride, Bool back
 	ANKI_ASSERT(verts && vertCount > 0 && (vertCount % 3) == 0);
 	ANKI_ASSERT(stride >= sizeof(F32) * 3 && (stride % sizeof(F32)) == 0);
 
+	// Set up the triangles in a local batch to touch the shared storage less often
+	const U32 BATCH_SIZE = 32;
+	Array<Triangle, BATCH_SIZE> batch;
+	Array<Vec4, BATCH_SIZE> batchBoxes;
+	U32 batchCount = 0;
+
 	U floatStride = stride / sizeof(F32);
 	const F32* vertsEnd = verts + vertCount * floatStride;
 	while(verts != vertsEnd)
@@ -204,7 +245,7 @@ void SoftwareRasterizer::draw(const F32* verts, U vertCount, U stride, Bool back
 			continue;
 		}
 
-		// Rasterize
+		// Set up
 		Array<Vec4, 3> clip;
 		for(U j = 0; j < clippedCount; j += 3)
 		{
@@ -214,87 +255,353 @@ void SoftwareRasterizer::draw(const F32* verts, U vertCount, U stride, Bool back
 				ANKI_ASSERT(clip[k].w() > 0.0f);
 			}
 
-			rasterizeTriangle(&clip[0]);
+			if(setupTriangle(&clip[0], batch[batchCount], batchBoxes[batchCount]))
+			{
+				++batchCount;
+			}
+
+			if(batchCount == BATCH_SIZE)
+			{
+				storeTriangles(&batch[0], &batchBoxes[0], batchCount);
+				batchCount = 0;
+			}
 		}
 	}
+
+	if(batchCount)
+	{
+		storeTriangles(&batch[0], &batchBoxes[0], batchCount);
+	}
 }
 
-Bool SoftwareRasterizer::computeBarycetrinc(const Vec2& a, const Vec2& b, const Vec2& c, const Vec2& p, Vec3& uvw) const
+Bool SoftwareRasterizer::setupTriangle(const Vec4* clip, Triangle& tri, Vec4& box) const
 {
-	Vec2 dca = c - a;
-	Vec2 dba = b - a;
-	Vec2 dap = a - p;
+	ANKI_ASSERT(clip);
 
-	Vec3 n(dca.x(), dba.x(), dap.x());
-	Vec3 m(dca.y(), dba.y(), dap.y());
+	// To window space
+	const Vec2 windowSize(m_width, m_height);
+	Array<Vec2, 3> window;
+	Array<F32, 3> z;
+	Vec2 bboxMin(MAX_F32), bboxMax(MIN_F32);
+	for(U i = 0; i < 3; i++)
+	{
+		const Vec3 ndc = clip[i].xyz() / clip[i].w();
+		window[i] = (ndc.xy() / 2.0f + 0.5f) * windowSize;
+		z[i] = ndc.z();
+
+		bboxMin = bboxMin.min(window[i]);
+		bboxMax = bboxMax.max(window[i]);
+	}
 
-	Vec3 k = n.cross(m);
+	// The pixels that the triangle may cover
+	for(U i = 0; i < 2; i++)
+	{
+		bboxMin[i] = clamp(floorf(bboxMin[i]), 0.0f, windowSize[i]);
+		bboxMax[i] = clamp(ceilf(bboxMax[i]), 0.0f, windowSize[i]);
+	}
 
-	Bool skip = false;
-	if(!isZero(k.z()))
+	if(bboxMin.x() >= bboxMax.x() || bboxMin.y() >= bboxMax.y())
 	{
-		uvw = Vec3(1.0 - (k.x() + k.y()) / k.z(), k.y() / k.z(), k.x() / k.z());
+		return false;
+	}
 
-		if(uvw.x() < 0.0f || uvw.y() < 0.0f || uvw.z() < 0.0f)
+	const Vec2 d1 = window[1] - window[0];
+	const Vec2 d2 = window[2] - window[0];
+	const F32 area = d1.x() * d2.y() - d2.x() * d1.y();
+	if(absolute(area) < EPSILON)
+	{
+		// Degenerate
+		return false;
+	}
+
+	// Edge equations. Flip them for clockwise triangles so the inside is always positive
+	const F32 sign = (area > 0.0f) ? 1.0f : -1.0f;
+	for(U i = 0; i < 3; i++)
+	{
+		const Vec2& a = window[i];
+		const Vec2& b = window[(i + 1) % 3];
+
+		const F32 A = -(b.y() - a.y()) * sign;
+		const F32 B = (b.x() - a.x()) * sign;
+		tri.m_edges[i] = Vec3(A, B, -(A * a.x() + B * a.y()));
+	}
+
+	// Depth plane
+	const F32 dz1 = z[1] - z[0];
+	const F32 dz2 = z[2] - z[0];
+	const F32 A = (dz1 * d2.y() - dz2 * d1.y()) / area;
+	const F32 B = (dz2 * d1.x() - dz1 * d2.x()) / area;
+	tri.m_depthPlane = Vec3(A, B, z[0] - A * window[0].x() - B * window[0].y());
+
+	box = Vec4(bboxMin, bboxMax);
+	return true;
+}
+
+void SoftwareRasterizer::storeTriangles(const Triangle* tris, const Vec4* boxes, U32 count)
+{
+	ANKI_ASSERT(tris && boxes && count > 0);
+
+	LockGuard<SpinLock> lock(m_trisLock);
+
+	if(m_triCount + count > m_tris.getSize())
+	{
+		// Grow. Keep the box streams padded to a multiple of 4 for the SIMD binning
+		const U32 newSize = getAlignedRoundUp(4, max<U32>(m_triCount + count, m_tris.getSize() * 2));
+		m_tris.resize(m_alloc, newSize);
+		for(DynamicArray<F32>& stream : m_triBoxes)
 		{
-			skip = true;
+			stream.resize(m_alloc, newSize, 0.0f);
 		}
 	}
-	else
+
+	for(U32 i = 0; i < count; ++i)
 	{
-		skip = true;
+		m_tris[m_triCount] = tris[i];
+		for(U j = 0; j < 4; ++j)
+		{
+			m_triBoxes[j][m_triCount] = boxes[i][j];
+		}
+
+		++m_triCount;
+	}
+}
+
+void SoftwareRasterizer::rasterizeTile(U32 tileIdx)
+{
+	ANKI_ASSERT(tileIdx < getTileCount());
+	ANKI_TRACE_SCOPED_EVENT(SCENE_RASTERIZER_TILE);
+
+	const U32 tileX = tileIdx % m_tileCountX;
+	const U32 tileY = tileIdx / m_tileCountX;
+	const U32 x0 = tileX * TILE_SIZE;
+	const U32 y0 = tileY * TILE_SIZE;
+	const U32 x1 = min(x0 + TILE_SIZE, m_width);
+	const U32 y1 = min(y0 + TILE_SIZE, m_height);
+
+	// Bin and rasterize
+#if ANKI_SIMD == ANKI_SIMD_SSE
+	const __m128 tileMinX = _mm_set1_ps(F32(x0));
+	const __m128 tileMinY = _mm_set1_ps(F32(y0));
+	const __m128 tileMaxX = _mm_set1_ps(F32(x1));
+	const __m128 tileMaxY = _mm_set1_ps(F32(y1));
+
+	for(U32 i = 0; i < m_triCount; i += 4)
+	{
+		const __m128 minX = _mm_loadu_ps(&m_triBoxes[0][i]);
+		const __m128 minY = _mm_loadu_ps(&m_triBoxes[1][i]);
+		const __m128 maxX = _mm_loadu_ps(&m_triBoxes[2][i]);
+		const __m128 maxY = _mm_loadu_ps(&m_triBoxes[3][i]);
+
+		__m128 overlaps = _mm_and_ps(_mm_cmplt_ps(minX, tileMaxX), _mm_cmpgt_ps(maxX, tileMinX));
+		overlaps = _mm_and_ps(overlaps, _mm_and_ps(_mm_cmplt_ps(minY, tileMaxY), _mm_cmpgt_ps(maxY, tileMinY)));
+
+		U32 mask = _mm_movemask_ps(overlaps);
+		const U32 remaining = m_triCount - i;
+		if(remaining < 4)
+		{
+			mask &= (1u << remaining) - 1u;
+		}
+
+		while(mask)
+		{
+			const U32 t = i + getLsb(mask);
+			mask &= mask - 1u;
+
+			rasterizeTriangle(m_tris[t],
+				max(x0, U32(m_triBoxes[0][t])),
+				max(y0, U32(m_triBoxes[1][t])),
+				min(x1, U32(m_triBoxes[2][t])),
+				min(y1, U32(m_triBoxes[3][t])));
+		}
 	}
+#else
+	for(U32 t = 0; t < m_triCount; ++t)
+	{
+		const U32 minX = max(x0, U32(m_triBoxes[0][t]));
+		const U32 minY = max(y0, U32(m_triBoxes[1][t]));
+		const U32 maxX = min(x1, U32(m_triBoxes[2][t]));
+		const U32 maxY = min(y1, U32(m_triBoxes[3][t]));
 
-	return skip;
+		if(minX < maxX && minY < maxY)
+		{
+			rasterizeTriangle(m_tris[t], minX, minY, maxX, maxY);
+		}
+	}
+#endif
+
+	// Build the part of the HiZ that this tile owns. TILE_SIZE is a power of two so the texels of the levels up to
+	// TILE_HIZ_LEVELS don't cross tile boundaries
+	const U32 levelCount = min(m_hizLevelCount, TILE_HIZ_LEVELS + 1);
+	for(U32 level = 1; level < levelCount; ++level)
+	{
+		const UVec2& size = m_hizLevels[level].m_size;
+		buildHiZRect(level,
+			x0 >> level,
+			y0 >> level,
+			min((x0 + TILE_SIZE) >> level, size.x()),
+			min((y0 + TILE_SIZE) >> level, size.y()));
+	}
 }
 
-void SoftwareRasterizer::rasterizeTriangle(const Vec4* tri)
+void SoftwareRasterizer::rasterizeTriangle(const Triangle& tri, U32 x0, U32 y0, U32 x1, U32 y1)
 {
-	ANKI_ASSERT(tri);
+	ANKI_ASSERT(x0 < x1 && y0 < y1 && x1 <= m_width && y1 <= m_height);
+
+	const Vec3& e0 = tri.m_edges[0];
+	const Vec3& e1 = tri.m_edges[1];
+	const Vec3& e2 = tri.m_edges[2];
+	const Vec3& dp = tri.m_depthPlane;
+
+#if ANKI_SIMD == ANKI_SIMD_SSE
+	// Process 4 pixels at a time. Start from a multiple of 4 and mask the pixels outside [x0, x1). The tiles and the
+	// rows of the z buffer are multiples of 4 so that never touches the pixels of another tile
+	const U32 xStart = x0 & ~3u;
+
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 laneX = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	const __m128 rectMinX = _mm_set1_ps(F32(x0));
+	const __m128 rectMaxX = _mm_set1_ps(F32(x1));
+
+	const __m128 e0A = _mm_set1_ps(e0.x());
+	const __m128 e1A = _mm_set1_ps(e1.x());
+	const __m128 e2A = _mm_set1_ps(e2.x());
+	const __m128 dpA = _mm_set1_ps(dp.x());
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for(U32 y = y0; y < y1; ++y)
+	{
+		const F32 pixelY = F32(y) + 0.5f;
+		const __m128 e0Row = _mm_set1_ps(e0.y() * pixelY + e0.z());
+		const __m128 e1Row = _mm_set1_ps(e1.y() * pixelY + e1.z());
+		const __m128 e2Row = _mm_set1_ps(e2.y() * pixelY + e2.z());
+		const __m128 dpRow = _mm_set1_ps(dp.y() * pixelY + dp.z());
 
-	const Vec2 windowSize(m_width, m_height);
-	Array<Vec3, 3> ndc;
-	Array<Vec2, 3> window;
-	Vec2 bboxMin(MAX_F32), bboxMax(MIN_F32);
-	for(U i = 0; i < 3; i++)
+		F32* row = &m_zbuffer[y * m_zbufferStride];
+
+		for(U32 x = xStart; x < x1; x += 4)
+		{
+			const __m128 xs = _mm_add_ps(_mm_set1_ps(F32(x)), laneX);
+			const __m128 pixelX = _mm_add_ps(_mm_set1_ps(F32(x)), laneOffsets);
+
+			// Inside the rect
+			__m128 mask = _mm_and_ps(_mm_cmpge_ps(xs, rectMinX), _mm_cmplt_ps(xs, rectMaxX));
+
+			// Inside the triangle
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e0A, pixelX), e0Row), zero));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e1A, pixelX), e1Row), zero));
+			mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e2A, pixelX), e2Row), zero));
+
+			if(_mm_movemask_ps(mask) == 0)
+			{
+				continue;
+			}
+
+			// Depth test and write. The z buffer is not guaranteed to be 16 bytes aligned
+			__m128 depth = _mm_add_ps(_mm_mul_ps(dpA, pixelX), dpRow);
+			depth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+
+			const __m128 prevDepth = _mm_loadu_ps(row + x);
+			_mm_storeu_ps(row + x, _mm_blendv_ps(prevDepth, _mm_min_ps(prevDepth, depth), mask));
+		}
+	}
+#else
+	for(U32 y = y0; y < y1; ++y)
 	{
-		ndc[i] = tri[i].xyz() / tri[i].w();
-		window[i] = (ndc[i].xy() / 2.0 + 0.5) * windowSize;
+		const F32 pixelY = F32(y) + 0.5f;
+		F32* row = &m_zbuffer[y * m_zbufferStride];
 
-		for(U j = 0; j < 2; j++)
+		for(U32 x = x0; x < x1; ++x)
 		{
-			bboxMin[j] = floor(min(bboxMin[j], window[i][j]));
-			bboxMin[j] = clamp(bboxMin[j], 0.0f, windowSize[j]);
+			const F32 pixelX = F32(x) + 0.5f;
 
-			bboxMax[j] = ceil(max(bboxMax[j], window[i][j]));
-			bboxMax[j] = clamp(bboxMax[j], 0.0f, windowSize[j]);
+			if(e0.x() * pixelX + (e0.y() * pixelY + e0.z()) >= 0.0f
+				&& e1.x() * pixelX + (e1.y() * pixelY + e1.z()) >= 0.0f
+				&& e2.x() * pixelX + (e2.y() * pixelY + e2.z()) >= 0.0f)
+			{
+				const F32 depth = clamp(dp.x() * pixelX + (dp.y() * pixelY + dp.z()), 0.0f, 1.0f);
+				row[x] = min(row[x], depth);
+			}
 		}
 	}
+#endif
+}
+
+void SoftwareRasterizer::buildHiZRect(U32 level, U32 x0, U32 y0, U32 x1, U32 y1)
+{
+	ANKI_ASSERT(level > 0 && level < m_hizLevelCount);
+	const UVec2& prevSize = m_hizLevels[level - 1].m_size;
 
-	for(F32 y = bboxMin.y() + 0.5; y < bboxMax.y() + 0.5; y += 1.0)
+	for(U32 y = y0; y < y1; ++y)
 	{
-		for(F32 x = bboxMin.x() + 0.5; x < bboxMax.x() + 0.5; x += 1.0)
+		const U32 prevY0 = y * 2;
+		const U32 prevY1 = min(prevY0 + 1, prevSize.y() - 1);
+
+		for(U32 x = x0; x < x1; ++x)
 		{
-			Vec2 p(x, y);
-			Vec3 bc;
-			if(!computeBarycetrinc(window[0], window[1], window[2], p, bc))
-			{
-				const F32 z0 = ndc[0].z();
-				const F32 z1 = ndc[1].z();
-				const F32 z2 = ndc[2].z();
+			const U32 prevX0 = x * 2;
+			const U32 prevX1 = min(prevX0 + 1, prevSize.x() - 1);
+
+			F32 maxDepth, minDepth;
+			getHiZRectMinMax(level - 1, prevX0, prevY0, prevX1, prevY1, maxDepth, minDepth);
+
+			const U32 idx = getHiZIndex(level, x, y);
+			m_hizMax[idx] = maxDepth;
+			m_hizMin[idx] = minDepth;
+		}
+	}
+}
 
-				F32 depth = z0 * bc[0] + z1 * bc[1] + z2 * bc[2];
-				ANKI_ASSERT(depth >= 0.0 && depth <= 1.0);
+void SoftwareRasterizer::getHiZRectMinMax(
+	U32 level, U32 x0, U32 y0, U32 x1, U32 y1, F32& maxDepth, F32& minDepth) const
+{
+	ANKI_ASSERT(x0 <= x1 && y0 <= y1);
 
-				// Clamp it to a bit less that 1.0f because 1.0f will produce a 0 depthi
-				depth = min(depth, 1.0f - EPSILON);
+	maxDepth = 0.0f;
+	minDepth = 1.0f;
+	for(U32 y = y0; y <= y1; ++y)
+	{
+		for(U32 x = x0; x <= x1; ++x)
+		{
+			F32 texelMax, texelMin;
+			getHiZ(level, x, y, texelMax, texelMin);
+			maxDepth = max(maxDepth, texelMax);
+			minDepth = min(minDepth, texelMin);
+		}
+	}
+}
+
+void SoftwareRasterizer::buildCoarseHiZ()
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_RASTERIZER_HIZ);
 
-				// Store the min of the current value and new one
-				const U32 depthi = depth * MAX_U32;
-				m_zbuffer[U(y) * m_width + U(x)].min(depthi);
+	for(U32 level = TILE_HIZ_LEVELS + 1; level < m_hizLevelCount; ++level)
+	{
+		const UVec2& size = m_hizLevels[level].m_size;
+		buildHiZRect(level, 0, 0, size.x(), size.y());
+	}
+}
+
+void SoftwareRasterizer::rasterize(ThreadHive* hive)
+{
+	if(hive)
+	{
+		parallelFor(*hive, 0, getTileCount(), 1, [this](U32 begin, U32 end, U32 threadId) {
+			for(U32 i = begin; i < end; ++i)
+			{
+				rasterizeTile(i);
 			}
+		});
+	}
+	else
+	{
+		for(U32 i = 0; i < getTileCount(); ++i)
+		{
+			rasterizeTile(i);
 		}
 	}
+
+	buildCoarseHiZ();
 }
 
 Bool SoftwareRasterizer::visibilityTest(const Aabb& aabb) const
@@ -359,28 +666,47 @@ Bool SoftwareRasterizer::visibilityTestInternal(const Aabb& aabb) const
 	}
 
 	// Fix the bounds
-	bboxMin.x() = floorf(bboxMin.x());
-	bboxMin.x() = clamp(bboxMin.x(), 0.0f, F32(m_width));
-
-	bboxMax.x() = ceilf(bboxMax.x());
-	bboxMax.x() = clamp(bboxMax.x(), 0.0f, F32(m_width));
+	const U32 x0 = U32(clamp(floorf(bboxMin.x()), 0.0f, F32(m_width)));
+	const U32 x1 = U32(clamp(ceilf(bboxMax.x()), 0.0f, F32(m_width)));
+	const U32 y0 = U32(clamp(floorf(bboxMin.y()), 0.0f, F32(m_height)));
+	const U32 y1 = U32(clamp(ceilf(bboxMax.y()), 0.0f, F32(m_height)));
+	if(x0 >= x1 || y0 >= y1)
+	{
+		return false;
+	}
 
-	bboxMin.y() = floorf(bboxMin.y());
-	bboxMin.y() = clamp(bboxMin.y(), 0.0f, F32(m_height));
+	// Find the level where the box covers 2x2 texels at most
+	U32 level = 0;
+	while(level + 1 < m_hizLevelCount
+		  && (((x1 - 1) >> level) - (x0 >> level) > 1 || ((y1 - 1) >> level) - (y0 >> level) > 1))
+	{
+		++level;
+	}
 
-	bboxMax.y() = ceilf(bboxMax.y());
-	bboxMax.y() = clamp(bboxMax.y(), 0.0f, F32(m_height));
+	// The texels cover more pixels than the box does so that's conservative in both ways
+	const F32 minZ = bboxMin.z();
+	F32 maxDepth, minDepth;
+	getHiZRectMinMax(level, x0 >> level, y0 >> level, (x1 - 1) >> level, (y1 - 1) >> level, maxDepth, minDepth);
+	if(minZ >= maxDepth)
+	{
+		// Behind everything
+		return false;
+	}
+	else if(minZ < minDepth)
+	{
+		// In front of everything
+		return true;
+	}
 
-	// Loop the tiles
-	F32 minZ = bboxMin.z();
-	for(U y = bboxMin.y(); y < bboxMax.y(); y += 1.0f)
+	// Not sure, refine in a finer level
+	level = (level >= 2) ? (level - 2) : 0;
+	for(U32 y = y0 >> level; y <= (y1 - 1) >> level; ++y)
 	{
-		for(U x = bboxMin.x(); x < bboxMax.x(); x += 1.0f)
+		for(U32 x = x0 >> level; x <= (x1 - 1) >> level; ++x)
 		{
-			U idx = U(y) * m_width + U(x);
-			U32 depthi = m_zbuffer[idx].get();
-			F32 depthf = depthi / F32(MAX_U32);
-			if(minZ < depthf)
+			F32 texelMax, texelMin;
+			getHiZ(level, x, y, texelMax, texelMin);
+			if(minZ < texelMax)
 			{
 				return true;
 			}
@@ -392,18 +718,16 @@ Bool SoftwareRasterizer::visibilityTestInternal(const Aabb& aabb) const
 
 void SoftwareRasterizer::fillDepthBuffer(ConstWeakArray<F32> depthValues)
 {
-	ANKI_ASSERT(m_zbuffer.getSize() == depthValues.getSize());
+	ANKI_ASSERT(depthValues.getSize() == m_width * m_height);
 
-	U count = depthValues.getSize();
-	while(count--)
+	for(U32 y = 0; y < m_height; ++y)
 	{
-		F32 depth = depthValues[count];
-		ANKI_ASSERT(depth >= 0.0f && depth <= 1.0f);
-
-		depth = min(depth, 1.0f - EPSILON); // See a few lines above why is that
-
-		const U32 depthi = depth * MAX_U32;
-		m_zbuffer[count].set(depthi);
+		for(U32 x = 0; x < m_width; ++x)
+		{
+			const F32 depth = depthValues[y * m_width + x];
+			ANKI_ASSERT(depth >= 0.0f && depth <= 1.0f);
+			m_zbuffer[y * m_zbufferStride + x] = depth;
+		}
 	}
 }
 
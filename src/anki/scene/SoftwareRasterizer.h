@@ -9,17 +9,38 @@
 #include <anki/Math.h>
 #include <anki/collision/Plane.h>
 #include <anki/util/WeakArray.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/Thread.h>
 
 namespace anki
 {
 
+// Forward
+class ThreadHive;
+
 /// @addtogroup scene
 /// @{
 
 /// Software rasterizer for visibility tests.
+///
+/// The screen is split in tiles. draw() only transforms, clips and sets up the triangles. rasterizeTile() then bins the
+/// triangles that touch a tile, rasterizes them 4 pixels at a time and builds the tile's part of a min/max
+/// hierarchical Z pyramid. Different tiles can be processed in parallel. buildCoarseHiZ() builds the levels of the
+/// pyramid that are coarser than a tile. The visibility tests sample the pyramid at the level where the AABB covers
+/// 2x2 texels at most.
+///
+/// Typical usage:
+/// @code
+/// r.prepare(mv, p, width, height);
+/// r.draw(...); // or r.fillDepthBuffer(...);
+/// r.rasterize(&hive); // or call rasterizeTile() for all tiles and then buildCoarseHiZ()
+/// Bool visible = r.visibilityTest(aabb);
+/// @endcode
 class SoftwareRasterizer
 {
 public:
+	static const U32 TILE_SIZE = 32; ///< In pixels. It's a power of two.
+
 	SoftwareRasterizer()
 	{
 	}
@@ -27,6 +48,13 @@ public:
 	~SoftwareRasterizer()
 	{
 		m_zbuffer.destroy(m_alloc);
+		m_hizMax.destroy(m_alloc);
+		m_hizMin.destroy(m_alloc);
+		m_tris.destroy(m_alloc);
+		for(DynamicArray<F32>& stream : m_triBoxes)
+		{
+			stream.destroy(m_alloc);
+		}
 	}
 
 	/// Initialize.
@@ -38,7 +66,7 @@ public:
 	/// Prepare for rendering. Call it before every draw.
 	void prepare(const Mat4& mv, const Mat4& p, U width, U height);
 
-	/// Render some verts.
+	/// Render some verts. The triangles are only set up, rasterizeTile() will rasterize them.
 	/// @param[in] verts Pointer to the first vertex to draw.
 	/// @param vertCount The number of verts to draw.
 	/// @param stride The stride (in bytes) of the next vertex.
@@ -49,31 +77,129 @@ public:
 	/// Fill the depth buffer with some values.
 	void fillDepthBuffer(ConstWeakArray<F32> depthValues);
 
+	/// Get the number of tiles.
+	U32 getTileCount() const
+	{
+		return m_tileCountX * m_tileCountY;
+	}
+
+	/// Rasterize the triangles that touch a tile and build the part of the HiZ pyramid that belongs to the tile.
+	/// @note It's thread-safe against rasterizeTile() calls for other tiles.
+	void rasterizeTile(U32 tileIdx);
+
+	/// Build the HiZ levels that are coarser than a tile. Call it after all tiles are rasterized.
+	void buildCoarseHiZ();
+
+	/// Rasterize all the tiles and build the HiZ pyramid.
+	/// @param hive If it's not nullptr the tiles will be rasterized in parallel. Don't call it from a hive task then.
+	void rasterize(ThreadHive* hive);
+
 	/// Perform visibility tests.
 	/// @param aabb The Aabb in of the cs in world space.
 	/// @return Return true if it's visible and false otherwise.
+	/// @note It's thread-safe against other visibilityTest() calls.
 	Bool visibilityTest(const Aabb& aabb) const;
 
+	/// Get the depth of a pixel. Useful for debugging and tests.
+	F32 getDepth(U32 x, U32 y) const
+	{
+		ANKI_ASSERT(x < m_width && y < m_height);
+		return m_zbuffer[y * m_zbufferStride + x];
+	}
+
+	/// Get the number of HiZ levels. Level 0 is the depth buffer.
+	U32 getHiZLevelCount() const
+	{
+		return m_hizLevelCount;
+	}
+
+	/// Get the max and min depth of a HiZ texel. Useful for debugging and tests.
+	void getHiZ(U32 level, U32 x, U32 y, F32& maxDepth, F32& minDepth) const
+	{
+		const U32 idx = getHiZIndex(level, x, y);
+		maxDepth = (level == 0) ? m_zbuffer[idx] : m_hizMax[idx];
+		minDepth = (level == 0) ? m_zbuffer[idx] : m_hizMin[idx];
+	}
+
+	/// Get the size of a HiZ level.
+	UVec2 getHiZLevelSize(U32 level) const
+	{
+		ANKI_ASSERT(level < m_hizLevelCount);
+		return m_hizLevels[level].m_size;
+	}
+
 private:
+	static const U32 MAX_HIZ_LEVELS = 16;
+	static const U32 TILE_HIZ_LEVELS = 5; ///< log2(TILE_SIZE). The levels that can be built per tile.
+
+	/// A triangle ready for rasterization.
+	class Triangle
+	{
+	public:
+		Array<Vec3, 3> m_edges; ///< Edge equations. A pixel is inside if x * A + y * B + C >= 0 for all of them.
+		Vec3 m_depthPlane; ///< depth = x * A + y * B + C
+	};
+
+	class HiZLevel
+	{
+	public:
+		UVec2 m_size;
+		U32 m_offset; ///< Offset in m_hizMax and m_hizMin.
+	};
+
 	GenericMemoryPoolAllocator<U8> m_alloc;
 	Mat4 m_mv; ///< ModelView.
 	Mat4 m_p; ///< Projection.
 	Mat4 m_mvp;
 	Array<Plane, 6> m_planesL; ///< In view space.
 	Array<Plane, 6> m_planesW; ///< In world space.
-	U32 m_width;
-	U32 m_height;
-	DynamicArray<Atomic<U32>> m_zbuffer;
+	U32 m_width = 0;
+	U32 m_height = 0;
+	U32 m_tileCountX = 0;
+	U32 m_tileCountY = 0;
+
+	DynamicArray<F32> m_zbuffer; ///< Level 0 of the HiZ. Its rows are padded to a multiple of 4.
+	U32 m_zbufferStride = 0;
 
-	/// @param tri In clip space.
-	void rasterizeTriangle(const Vec4* tri);
+	DynamicArray<F32> m_hizMax; ///< Levels 1 and up.
+	DynamicArray<F32> m_hizMin; ///< Levels 1 and up.
+	Array<HiZLevel, MAX_HIZ_LEVELS> m_hizLevels;
+	U32 m_hizLevelCount = 0;
 
-	Bool computeBarycetrinc(const Vec2& a, const Vec2& b, const Vec2& c, const Vec2& p, Vec3& uvw) const;
+	DynamicArray<Triangle> m_tris;
+	Array<DynamicArray<F32>, 4> m_triBoxes; ///< Min x, min y, max x, max y of the triangles in pixels. For binning.
+	U32 m_triCount = 0;
+	SpinLock m_trisLock;
+
+	/// Set up a triangle.
+	/// @param clip The vertices in clip space.
+	/// @return False if it doesn't cover any pixel.
+	Bool setupTriangle(const Vec4* clip, Triangle& tri, Vec4& box) const;
+
+	/// Append triangles to m_tris.
+	void storeTriangles(const Triangle* tris, const Vec4* boxes, U32 count);
+
+	/// Rasterize a triangle inside a rectangle.
+	void rasterizeTriangle(const Triangle& tri, U32 x0, U32 y0, U32 x1, U32 y1);
 
 	/// Clip triangle in the near plane.
 	/// @note Triangles in view space.
 	void clipTriangle(const Vec4* inTriangle, Vec4* outTriangles, U& outTriangleCount) const;
 
+	/// Build a rectangle of a HiZ level from the level before it.
+	void buildHiZRect(U32 level, U32 x0, U32 y0, U32 x1, U32 y1);
+
+	U32 getHiZIndex(U32 level, U32 x, U32 y) const
+	{
+		ANKI_ASSERT(level < m_hizLevelCount);
+		const HiZLevel& l = m_hizLevels[level];
+		ANKI_ASSERT(x < l.m_size.x() && y < l.m_size.y());
+		return (level == 0) ? (y * m_zbufferStride + x) : (l.m_offset + y * l.m_size.x() + x);
+	}
+
+	/// Get the max and the min depth of a rectangle of a HiZ level.
+	void getHiZRectMinMax(U32 level, U32 x0, U32 y0, U32 x1, U32 y1, F32& maxDepth, F32& minDepth) const;
+
 	Bool visibilityTestInternal(const Aabb& aabb) const;
 };
 /// @}
@@ -0,0 +1,397 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/TransformHierarchy.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+/// The levels with less transforms are not worth a parallel loop. The consecutive small levels are updated together.
+static const U32 MIN_TRANSFORMS_PER_PARALLEL_LEVEL = 2048;
+
+/// The transforms that a task of the parallel loop updates at once.
+static const U32 TRANSFORMS_PER_TASK = 256;
+
+/// Re-order an array. @a oldSlots has the old slot of every new slot.
+template<typename T>
+static void reorder(SceneAllocator<U8> alloc, const DynamicArrayAuto<U32>& oldSlots, DynamicArray<T>& arr)
+{
+	DynamicArray<T> newArr;
+	newArr.create(alloc, arr.getSize());
+	for(U32 i = 0; i < oldSlots.getSize(); ++i)
+	{
+		newArr[i] = arr[oldSlots[i]];
+	}
+
+	arr.destroy(alloc);
+	arr = std::move(newArr);
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+	ANKI_ASSERT(m_handles.getSize() == 0 && "Some transforms are still alive");
+
+	m_localTrfs.destroy(m_alloc);
+	m_worldTrfs.destroy(m_alloc);
+	m_prevWorldTrfs.destroy(m_alloc);
+	m_parentSlots.destroy(m_alloc);
+	m_flags.destroy(m_alloc);
+	m_handles.destroy(m_alloc);
+
+	m_slots.destroy(m_alloc);
+	m_parents.destroy(m_alloc);
+	m_firstChildren.destroy(m_alloc);
+	m_nextSiblings.destroy(m_alloc);
+	m_prevSiblings.destroy(m_alloc);
+
+	m_freeHandles.destroy(m_alloc);
+	m_levelOffsets.destroy(m_alloc);
+}
+
+U32 TransformHierarchy::newTransform(Bool ignoreLocalTransform)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Get a handle
+	U32 handle;
+	if(m_freeHandles.getSize())
+	{
+		handle = m_freeHandles.getBack();
+		m_freeHandles.resize(m_alloc, m_freeHandles.getSize() - 1);
+	}
+	else
+	{
+		handle = U32(m_slots.getSize());
+		m_slots.emplaceBack(m_alloc);
+		m_parents.emplaceBack(m_alloc);
+		m_firstChildren.emplaceBack(m_alloc);
+		m_nextSiblings.emplaceBack(m_alloc);
+		m_prevSiblings.emplaceBack(m_alloc);
+	}
+
+	// Append a slot. The next update() will put it in its level
+	const U32 slot = U32(m_handles.getSize());
+	m_localTrfs.emplaceBack(m_alloc, Transform::getIdentity());
+	m_worldTrfs.emplaceBack(m_alloc, Transform::getIdentity());
+	m_prevWorldTrfs.emplaceBack(m_alloc, Transform::getIdentity());
+	m_parentSlots.emplaceBack(m_alloc, MAX_U32);
+	m_flags.emplaceBack(m_alloc, U8(0));
+	if(ignoreLocalTransform)
+	{
+		m_flags[slot] |= IGNORE_LOCAL_TRANSFORM;
+	}
+	m_handles.emplaceBack(m_alloc, handle);
+
+	m_slots[handle] = slot;
+	m_parents[handle] = MAX_U32;
+	m_firstChildren[handle] = MAX_U32;
+	m_nextSiblings[handle] = MAX_U32;
+	m_prevSiblings[handle] = MAX_U32;
+
+	markDirty(slot);
+	m_sortNeeded = true;
+
+	return handle;
+}
+
+void TransformHierarchy::deleteTransform(U32 handle)
+{
+	LockGuard<Mutex> lock(m_mtx);
+	ANKI_ASSERT(m_slots[handle] != MAX_U32);
+
+	// Orphan the children
+	U32 child = m_firstChildren[handle];
+	while(child != MAX_U32)
+	{
+		const U32 next = m_nextSiblings[child];
+
+		m_parents[child] = MAX_U32;
+		m_nextSiblings[child] = MAX_U32;
+		m_prevSiblings[child] = MAX_U32;
+		m_parentSlots[m_slots[child]] = MAX_U32;
+		markDirty(m_slots[child]);
+
+		child = next;
+	}
+	m_firstChildren[handle] = MAX_U32;
+
+	unlinkFromParent(handle);
+
+	// Move the last slot in the place of the removed one
+	const U32 slot = m_slots[handle];
+	const U32 lastSlot = U32(m_handles.getSize() - 1);
+	if(slot != lastSlot)
+	{
+		const U32 lastHandle = m_handles[lastSlot];
+
+		m_localTrfs[slot] = m_localTrfs[lastSlot];
+		m_worldTrfs[slot] = m_worldTrfs[lastSlot];
+		m_prevWorldTrfs[slot] = m_prevWorldTrfs[lastSlot];
+		m_parentSlots[slot] = m_parentSlots[lastSlot];
+		m_flags[slot] = m_flags[lastSlot];
+		m_handles[slot] = lastHandle;
+		m_slots[lastHandle] = slot;
+
+		for(child = m_firstChildren[lastHandle]; child != MAX_U32; child = m_nextSiblings[child])
+		{
+			m_parentSlots[m_slots[child]] = slot;
+		}
+	}
+
+	m_localTrfs.resize(m_alloc, lastSlot);
+	m_worldTrfs.resize(m_alloc, lastSlot);
+	m_prevWorldTrfs.resize(m_alloc, lastSlot);
+	m_parentSlots.resize(m_alloc, lastSlot);
+	m_flags.resize(m_alloc, lastSlot);
+	m_handles.resize(m_alloc, lastSlot);
+
+	m_slots[handle] = MAX_U32;
+	m_freeHandles.emplaceBack(m_alloc, handle);
+	m_sortNeeded = true;
+}
+
+void TransformHierarchy::setParent(U32 handle, U32 parent)
+{
+	LockGuard<Mutex> lock(m_mtx);
+	ANKI_ASSERT(m_slots[handle] != MAX_U32);
+	ANKI_ASSERT(handle != parent);
+
+	unlinkFromParent(handle);
+
+	const U32 slot = m_slots[handle];
+	if(parent != MAX_U32)
+	{
+		ANKI_ASSERT(m_slots[parent] != MAX_U32);
+
+		// Push it to the front of the children of the parent
+		const U32 next = m_firstChildren[parent];
+		if(next != MAX_U32)
+		{
+			m_prevSiblings[next] = handle;
+		}
+
+		m_nextSiblings[handle] = next;
+		m_firstChildren[parent] = handle;
+		m_parents[handle] = parent;
+		m_parentSlots[slot] = m_slots[parent];
+	}
+
+	markDirty(slot);
+	m_sortNeeded = true;
+}
+
+U32 TransformHierarchy::getParent(U32 handle) const
+{
+	LockGuard<Mutex> lock(m_mtx);
+	return m_parents[handle];
+}
+
+void TransformHierarchy::setLocalTransform(U32 handle, const Transform& trf)
+{
+	LockGuard<Mutex> lock(m_mtx);
+	ANKI_ASSERT(m_slots[handle] != MAX_U32);
+	const U32 slot = m_slots[handle];
+	m_localTrfs[slot] = trf;
+	markDirty(slot);
+}
+
+void TransformHierarchy::unlinkFromParent(U32 handle)
+{
+	const U32 parent = m_parents[handle];
+	if(parent == MAX_U32)
+	{
+		return;
+	}
+
+	const U32 prev = m_prevSiblings[handle];
+	const U32 next = m_nextSiblings[handle];
+	if(prev != MAX_U32)
+	{
+		m_nextSiblings[prev] = next;
+	}
+	else
+	{
+		ANKI_ASSERT(m_firstChildren[parent] == handle);
+		m_firstChildren[parent] = next;
+	}
+
+	if(next != MAX_U32)
+	{
+		m_prevSiblings[next] = prev;
+	}
+
+	m_parents[handle] = MAX_U32;
+	m_prevSiblings[handle] = MAX_U32;
+	m_nextSiblings[handle] = MAX_U32;
+	m_parentSlots[m_slots[handle]] = MAX_U32;
+}
+
+void TransformHierarchy::updateWorldTransform(U32 handle)
+{
+	const U32 slot = m_slots[handle];
+	computeWorldTransform(slot);
+
+	if(!(m_flags[slot] & UPDATED))
+	{
+		m_flags[slot] |= UPDATED;
+		m_updatedCount.fetchAdd(1);
+	}
+	m_flags[slot] &= ~DIRTY;
+
+	for(U32 child = m_firstChildren[handle]; child != MAX_U32; child = m_nextSiblings[child])
+	{
+		markDirty(m_slots[child]);
+	}
+}
+
+U32 TransformHierarchy::updateSlots(U32 begin, U32 end)
+{
+	U32 updatedCount = 0;
+	for(U32 slot = begin; slot < end; ++slot)
+	{
+		U8 flags = m_flags[slot];
+
+		// The previous world transform is the world transform at the end of the previous frame. It's already that if
+		// it didn't get updated
+		if(flags & UPDATED)
+		{
+			m_prevWorldTrfs[slot] = m_worldTrfs[slot];
+			flags &= ~UPDATED;
+		}
+
+		// The parent is in a previous level so its flags are final
+		const U32 parentSlot = m_parentSlots[slot];
+		if((flags & DIRTY) || (parentSlot != MAX_U32 && (m_flags[parentSlot] & UPDATED)))
+		{
+			computeWorldTransform(slot);
+			flags = (flags & ~DIRTY) | UPDATED;
+			++updatedCount;
+		}
+
+		m_flags[slot] = flags;
+	}
+
+	return updatedCount;
+}
+
+void TransformHierarchy::update(ThreadHive& hive)
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_TRANSFORMS_UPDATE);
+
+	if(m_sortNeeded)
+	{
+		sort();
+	}
+
+	// Nothing to do if nothing got dirty and there are no previous transforms to update
+	if(m_dirtyCount.load() == 0 && m_updatedCount.load() == 0)
+	{
+		return;
+	}
+
+	m_dirtyCount.set(0);
+
+	const U32 levelCount = (m_levelOffsets.getSize()) ? U32(m_levelOffsets.getSize() - 1) : 0;
+	Atomic<U32> updatedCount = {0};
+	U32 level = 0;
+	while(level < levelCount)
+	{
+		const U32 begin = m_levelOffsets[level];
+		U32 end = m_levelOffsets[level + 1];
+
+		if(end - begin >= MIN_TRANSFORMS_PER_PARALLEL_LEVEL && hive.getThreadCount() > 1)
+		{
+			parallelFor(hive, begin, end, TRANSFORMS_PER_TASK, [&](U32 rangeBegin, U32 rangeEnd, U32 threadId) {
+				updatedCount.fetchAdd(updateSlots(rangeBegin, rangeEnd));
+			});
+
+			++level;
+		}
+		else
+		{
+			// Update this and the next small levels in one go. The order of the slots is the order of the levels
+			++level;
+			while(level < levelCount
+				  && m_levelOffsets[level + 1] - m_levelOffsets[level] < MIN_TRANSFORMS_PER_PARALLEL_LEVEL)
+			{
+				++level;
+			}
+
+			end = m_levelOffsets[level];
+			updatedCount.fetchAdd(updateSlots(begin, end));
+		}
+	}
+
+	m_updatedCount.set(updatedCount.load());
+}
+
+void TransformHierarchy::sort()
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_TRANSFORMS_SORT);
+
+	// Walk the hierarchy breadth first starting from the roots. That gives the slots of the levels one after the other
+	const U32 count = U32(m_handles.getSize());
+	DynamicArrayAuto<U32> handles(m_alloc);
+	handles.create(count);
+	U32 handleCount = 0;
+	for(U32 slot = 0; slot < count; ++slot)
+	{
+		if(m_parentSlots[slot] == MAX_U32)
+		{
+			handles[handleCount++] = m_handles[slot];
+		}
+	}
+
+	m_levelOffsets.destroy(m_alloc);
+	U32 levelBegin = 0;
+	while(levelBegin < handleCount)
+	{
+		m_levelOffsets.emplaceBack(m_alloc, levelBegin);
+
+		const U32 levelEnd = handleCount;
+		for(U32 i = levelBegin; i < levelEnd; ++i)
+		{
+			for(U32 child = m_firstChildren[handles[i]]; child != MAX_U32; child = m_nextSiblings[child])
+			{
+				handles[handleCount++] = child;
+			}
+		}
+
+		levelBegin = levelEnd;
+	}
+	m_levelOffsets.emplaceBack(m_alloc, handleCount);
+	ANKI_ASSERT(handleCount == count);
+
+	// Re-order the slots
+	DynamicArrayAuto<U32> oldSlots(m_alloc);
+	oldSlots.create(count);
+	for(U32 i = 0; i < count; ++i)
+	{
+		oldSlots[i] = m_slots[handles[i]];
+	}
+
+	reorder(m_alloc, oldSlots, m_localTrfs);
+	reorder(m_alloc, oldSlots, m_worldTrfs);
+	reorder(m_alloc, oldSlots, m_prevWorldTrfs);
+	reorder(m_alloc, oldSlots, m_flags);
+
+	for(U32 i = 0; i < count; ++i)
+	{
+		m_handles[i] = handles[i];
+		m_slots[handles[i]] = i;
+	}
+
+	for(U32 i = 0; i < count; ++i)
+	{
+		const U32 parent = m_parents[m_handles[i]];
+		m_parentSlots[i] = (parent != MAX_U32) ? m_slots[parent] : MAX_U32;
+	}
+
+	m_sortNeeded = false;
+}
+
+} // end namespace anki
@@ -0,0 +1,187 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/Math.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/Atomic.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class ThreadHive;
+
+/// @addtogroup scene
+/// @{
+
+/// The local and world transforms of all the movable scene nodes. The data are stored in arrays (local, world, parent,
+/// flags) that are sorted on the depth of the hierarchy so the world transforms can be computed one level at a time
+/// and the transforms of a level in parallel. A level sees the world transforms of the previous one already computed.
+///
+/// The transforms are referenced by handles that don't change when the arrays get sorted.
+///
+/// The arrays move when they get sorted or grow so the renderer shouldn't read them while the scene updates the next
+/// frame. The draw callbacks use copies of the transforms taken during the visibility tests.
+class TransformHierarchy : public NonCopyable
+{
+public:
+	TransformHierarchy(SceneAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~TransformHierarchy();
+
+	/// Add a transform without parent. It's identity and dirty.
+	/// @param ignoreLocalTransform The world transform is the parent's world transform.
+	/// @note It's thread-safe against the other methods that add, remove and re-parent transforms.
+	U32 newTransform(Bool ignoreLocalTransform = false);
+
+	/// Remove a transform. Its children lose their parent.
+	/// @note It's thread-safe against the other methods that add, remove and re-parent transforms.
+	void deleteTransform(U32 handle);
+
+	/// Set the parent of a transform. MAX_U32 removes it.
+	/// @note It's thread-safe against the other methods that add, remove and re-parent transforms.
+	void setParent(U32 handle, U32 parent);
+
+	/// @note It's thread-safe against the other methods that add, remove and re-parent transforms.
+	U32 getParent(U32 handle) const;
+
+	/// Set the local transform. It marks it dirty.
+	/// @note It's thread-safe against the other methods that add, remove and re-parent transforms. Use it instead of
+	///       editLocalTransform() while other threads create transforms.
+	void setLocalTransform(U32 handle, const Transform& trf);
+
+	const Transform& getLocalTransform(U32 handle) const
+	{
+		return m_localTrfs[m_slots[handle]];
+	}
+
+	/// Get the local transform to change it. It marks it dirty.
+	/// @note Different transforms can be edited from different threads but not while other threads add or remove
+	///       transforms because the arrays may grow.
+	Transform& editLocalTransform(U32 handle)
+	{
+		markDirty(m_slots[handle]);
+		return m_localTrfs[m_slots[handle]];
+	}
+
+	const Transform& getWorldTransform(U32 handle) const
+	{
+		return m_worldTrfs[m_slots[handle]];
+	}
+
+	/// The world transform at the end of the previous frame.
+	const Transform& getPreviousWorldTransform(U32 handle) const
+	{
+		return m_prevWorldTrfs[m_slots[handle]];
+	}
+
+	/// The local transform changed after update() and the world transform is stale.
+	Bool isDirty(U32 handle) const
+	{
+		return !!(m_flags[m_slots[handle]] & DIRTY);
+	}
+
+	/// The world transform changed in this frame.
+	Bool wasUpdated(U32 handle) const
+	{
+		return !!(m_flags[m_slots[handle]] & UPDATED);
+	}
+
+	/// Compute the world transform of a transform that got dirty after update(). Its children become dirty so they
+	/// should be updated after it.
+	/// @note The transforms of different subtrees can be updated from different threads.
+	void updateWorldTransform(U32 handle);
+
+	/// Compute the world transforms of the dirty transforms and their children. Call it once at the start of every
+	/// frame and not from a ThreadHive task. The big levels of the hierarchy are processed in parallel.
+	void update(ThreadHive& hive);
+
+	U32 getTransformCount() const
+	{
+		return U32(m_handles.getSize());
+	}
+
+private:
+	/// @name Flags
+	/// @{
+	static const U8 DIRTY = 1 << 0;
+	static const U8 UPDATED = 1 << 1;
+	static const U8 IGNORE_LOCAL_TRANSFORM = 1 << 2;
+	/// @}
+
+	SceneAllocator<U8> m_alloc;
+
+	/// @name Indexed by slot. Sorted on depth after update()
+	/// @{
+	DynamicArray<Transform> m_localTrfs;
+	DynamicArray<Transform> m_worldTrfs;
+	DynamicArray<Transform> m_prevWorldTrfs;
+	DynamicArray<U32> m_parentSlots; ///< MAX_U32 if there is no parent.
+	DynamicArray<U8> m_flags;
+	DynamicArray<U32> m_handles; ///< The handle of every slot.
+	/// @}
+
+	/// @name Indexed by handle
+	/// @{
+	DynamicArray<U32> m_slots; ///< MAX_U32 if the handle is free.
+	DynamicArray<U32> m_parents;
+	DynamicArray<U32> m_firstChildren;
+	DynamicArray<U32> m_nextSiblings;
+	DynamicArray<U32> m_prevSiblings;
+	/// @}
+
+	DynamicArray<U32> m_freeHandles;
+	DynamicArray<U32> m_levelOffsets; ///< Where every level starts in the slots. One more than the levels.
+
+	Bool m_sortNeeded = false;
+	Atomic<U32> m_dirtyCount = {0}; ///< How many got dirty since the last update().
+	Atomic<U32> m_updatedCount = {0}; ///< How many got updated since the last update().
+	mutable Mutex m_mtx; ///< Protects the structure of the hierarchy.
+
+	void markDirty(U32 slot)
+	{
+		if(!(m_flags[slot] & DIRTY))
+		{
+			m_flags[slot] |= DIRTY;
+			m_dirtyCount.fetchAdd(1);
+		}
+	}
+
+	/// Compute the world transform of a slot from its parent's.
+	void computeWorldTransform(U32 slot)
+	{
+		const U32 parentSlot = m_parentSlots[slot];
+		if(parentSlot == MAX_U32)
+		{
+			m_worldTrfs[slot] = m_localTrfs[slot];
+		}
+		else if(m_flags[slot] & IGNORE_LOCAL_TRANSFORM)
+		{
+			m_worldTrfs[slot] = m_worldTrfs[parentSlot];
+		}
+		else
+		{
+			m_worldTrfs[slot] = m_worldTrfs[parentSlot].combineTransformations(m_localTrfs[slot]);
+		}
+	}
+
+	/// Update the slots of some levels. Return how many got updated.
+	U32 updateSlots(U32 begin, U32 end);
+
+	void unlinkFromParent(U32 handle);
+
+	/// Sort the slots on depth.
+	void sort();
+};
+/// @}
+
+} // end namespace anki
@@ -51,7 +51,7 @@ Error TriggerNode::init(F32 sphereRadius)
 	m_trigger = getSceneGraph().getPhysicsWorld().newInstance<PhysicsTrigger>(m_shape);
 	m_trigger->setUserData(this);
 
-	newComponent<MoveComponent>();
+	newComponent<MoveComponent>(this);
 	newComponent<MoveFeedbackComponent>();
 	newComponent<TriggerComponent>(this, m_trigger);
 
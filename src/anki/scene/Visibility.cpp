@@ -17,7 +17,8 @@
 #include <anki/scene/components/SpatialComponent.h>
 #include <anki/renderer/MainRenderer.h>
 #include <anki/util/Logger.h>
-#include <anki/util/ThreadHive.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/RadixSort.h>
 
 namespace anki
 {
@@ -45,13 +46,53 @@ static Bool spatialInsideFrustum(const FrustumComponent& frc, const SpatialCompo
 }
 
 void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue& rqueue, ThreadHive& hive)
+{
+	const FrustumComponent* frcs[] = {&frc};
+	RenderQueue* rqueues[] = {&rqueue};
+	submitNewWork(ConstWeakArray<const FrustumComponent*>(frcs, 1), ConstWeakArray<RenderQueue*>(rqueues, 1), hive);
+}
+
+void VisibilityContext::submitNewWork(
+	ConstWeakArray<const FrustumComponent*> frcs, ConstWeakArray<RenderQueue*> rqueues, ThreadHive& hive)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_SUBMIT_WORK);
+	ANKI_ASSERT(frcs.getSize() == rqueues.getSize() && frcs.getSize() <= MAX_FRUSTA_PER_GATHER);
+
+	// The frusta that wait for their S/W rasterizer gather alone. The rest walk the octree together
+	Array<FrustumVisibilityContext*, MAX_FRUSTA_PER_GATHER> frcCtxs;
+	U32 frcCtxCount = 0;
+	for(U32 i = 0; i < frcs.getSize(); ++i)
+	{
+		ThreadHiveSemaphore* prepareRasterizerSem = nullptr;
+		FrustumVisibilityContext* frcCtx = prepareNewWork(*frcs[i], *rqueues[i], hive, prepareRasterizerSem);
+		if(frcCtx == nullptr)
+		{
+			continue;
+		}
+
+		if(prepareRasterizerSem)
+		{
+			submitGatherWork(ConstWeakArray<FrustumVisibilityContext*>(&frcCtx, 1), prepareRasterizerSem, hive);
+		}
+		else
+		{
+			frcCtxs[frcCtxCount++] = frcCtx;
+		}
+	}
+
+	if(frcCtxCount)
+	{
+		submitGatherWork(ConstWeakArray<FrustumVisibilityContext*>(&frcCtxs[0], frcCtxCount), nullptr, hive);
+	}
+}
 
+FrustumVisibilityContext* VisibilityContext::prepareNewWork(
+	const FrustumComponent& frc, RenderQueue& rqueue, ThreadHive& hive, ThreadHiveSemaphore*& prepareRasterizerSem)
+{
 	// Check enabled and make sure that the results are null (this can happen on multiple on circular viewing)
 	if(ANKI_UNLIKELY(!frc.anyVisibilityTestEnabled()))
 	{
-		return;
+		return nullptr;
 	}
 
 	rqueue.m_cameraTransform = Mat4(frc.getTransform());
@@ -74,7 +115,7 @@ void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue&
 		{
 			if(x == &frc)
 			{
-				return;
+				return nullptr;
 			}
 		}
 
@@ -94,18 +135,24 @@ void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue&
 	//
 
 	// Software rasterizer task
-	ThreadHiveSemaphore* prepareRasterizerSem = nullptr;
+	prepareRasterizerSem = nullptr;
 	if(frc.visibilityTestsEnabled(FrustumComponentVisibilityTestFlag::OCCLUDERS) && frc.hasCoverageBuffer())
 	{
-		// Gather triangles task
-		ThreadHiveTask fillDepthTask = ANKI_THREAD_HIVE_TASK({ self->fill(); },
-			alloc.newInstance<FillRasterizerWithCoverageTask>(frcCtx),
-			nullptr,
-			hive.newSemaphore(1));
+		// Fill the depth buffer task. It will spawn the tasks that rasterize the tiles and those will signal the same
+		// semaphore
+		FillRasterizerWithCoverageTask* fillTask = alloc.newInstance<FillRasterizerWithCoverageTask>(frcCtx);
+		ThreadHiveTask fillDepthTask =
+			ANKI_THREAD_HIVE_TASK({ self->fill(hive, signalSemaphore); }, fillTask, nullptr, hive.newSemaphore(1));
 
 		hive.submitTasks(&fillDepthTask, 1);
 
-		prepareRasterizerSem = fillDepthTask.m_signalSemaphore;
+		// Build the coarse HiZ levels when all the tiles are done
+		ThreadHiveTask hizTask = ANKI_THREAD_HIVE_TASK(
+			{ self->buildCoarseHiZ(); }, fillTask, fillDepthTask.m_signalSemaphore, hive.newSemaphore(1));
+
+		hive.submitTasks(&hizTask, 1);
+
+		prepareRasterizerSem = hizTask.m_signalSemaphore;
 	}
 
 	if(frc.visibilityTestsEnabled(FrustumComponentVisibilityTestFlag::OCCLUDERS))
@@ -114,21 +161,34 @@ void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue&
 		rqueue.m_fillCoverageBufferCallbackUserData = static_cast<void*>(const_cast<FrustumComponent*>(&frc));
 	}
 
-	// Gather visibles from the octree. No need to signal anything because it will spawn new tasks
-	ThreadHiveTask gatherTask = ANKI_THREAD_HIVE_TASK({ self->gather(hive); },
-		alloc.newInstance<GatherVisiblesFromOctreeTask>(frcCtx),
-		prepareRasterizerSem,
-		nullptr);
-	hive.submitTasks(&gatherTask, 1);
-
 	// Combind results task
 	ANKI_ASSERT(frcCtx->m_visTestsSignalSem);
 	ThreadHiveTask combineTask = ANKI_THREAD_HIVE_TASK(
-		{ self->combine(); }, alloc.newInstance<CombineResultsTask>(frcCtx), frcCtx->m_visTestsSignalSem, nullptr);
+		{ self->combine(hive); }, alloc.newInstance<CombineResultsTask>(frcCtx), frcCtx->m_visTestsSignalSem, nullptr);
 	hive.submitTasks(&combineTask, 1);
+
+	return frcCtx;
+}
+
+void VisibilityContext::submitGatherWork(
+	ConstWeakArray<FrustumVisibilityContext*> frcCtxs, ThreadHiveSemaphore* waitSem, ThreadHive& hive)
+{
+	auto alloc = m_scene->getFrameAllocator();
+
+	WeakArray<GatherVisiblesFromOctreeTask::Frustum> frusta(
+		alloc.newArray<GatherVisiblesFromOctreeTask::Frustum>(frcCtxs.getSize()), frcCtxs.getSize());
+	for(U32 i = 0; i < frcCtxs.getSize(); ++i)
+	{
+		frusta[i].m_frcCtx = frcCtxs[i];
+	}
+
+	// Gather visibles from the octree. No need to signal anything because it will spawn new tasks
+	ThreadHiveTask gatherTask = ANKI_THREAD_HIVE_TASK(
+		{ self->gather(hive); }, alloc.newInstance<GatherVisiblesFromOctreeTask>(frusta), waitSem, nullptr);
+	hive.submitTasks(&gatherTask, 1);
 }
 
-void FillRasterizerWithCoverageTask::fill()
+void FillRasterizerWithCoverageTask::fill(ThreadHive& hive, ThreadHiveSemaphore* tilesSem)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_FILL_DEPTH);
 
@@ -148,68 +208,219 @@ void FillRasterizerWithCoverageTask::fill()
 
 	// Do the work
 	m_frcCtx->m_r->fillDepthBuffer(depthBuff);
+
+	// Rasterize the tiles in parallel. Increase the semaphore to block the HiZ task
+	const U32 tileCount = m_frcCtx->m_r->getTileCount();
+	tilesSem->increaseSemaphore(tileCount);
+	for(U32 i = 0; i < tileCount; ++i)
+	{
+		ThreadHiveTask task = ANKI_THREAD_HIVE_TASK(
+			{ self->rasterize(); }, alloc.newInstance<RasterizeTileTask>(m_frcCtx, i), nullptr, tilesSem);
+		hive.submitTasks(&task, 1);
+	}
+}
+
+void FillRasterizerWithCoverageTask::buildCoarseHiZ()
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_FILL_DEPTH);
+	m_frcCtx->m_r->buildCoarseHiZ();
+}
+
+void RasterizeTileTask::rasterize()
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_FILL_DEPTH);
+	m_frcCtx->m_r->rasterizeTile(m_tileIdx);
 }
 
 void GatherVisiblesFromOctreeTask::gather(ThreadHive& hive)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_OCTREE);
 
-	U testIdx = m_frcCtx->m_visCtx->m_testsCount.fetchAdd(1);
+	VisibilityContext& visCtx = *m_frusta[0].m_frcCtx->m_visCtx;
+	const U32 frustumCount = m_frusta.getSize();
+	const U32 firstTestIdx = visCtx.m_testsCount.fetchAdd(frustumCount);
+
+	auto testFunc = [&](U64 testMask, const Aabb& box, U64& insideMask) -> U64 {
+		U64 visibleMask = 0;
+		while(testMask)
+		{
+			const U32 i = getLsb(testMask);
+			const U64 bit = U64(1) << U64(i);
+			testMask &= ~bit;
+
+			const FrustumVisibilityContext& frcCtx = *m_frusta[i].m_frcCtx;
+			Bool inside;
+			Bool visible = Octree::testFrustumPlanes(&frcCtx.m_frc->getViewPlanes()[0], box, inside);
+			if(visible && frcCtx.m_r)
+			{
+				// The occluders might hide the children of a box that is inside the frustum
+				visible = frcCtx.m_r->visibilityTest(box);
+				inside = false;
+			}
 
-	// Walk the tree
-	m_frcCtx->m_visCtx->m_scene->getOctree().walkTree(testIdx,
-		[&](const Aabb& box) {
-			Bool visible = m_frcCtx->m_frc->insideFrustum(box);
-			if(visible && m_frcCtx->m_r)
+			if(visible)
 			{
-				visible = m_frcCtx->m_r->visibilityTest(box);
+				visibleMask |= bit;
+				insideMask |= (inside) ? bit : 0;
 			}
+		}
 
-			return visible;
-		},
-		[&](void* placeableUserData) {
-			ANKI_ASSERT(placeableUserData);
-			SpatialComponent* scomp = static_cast<SpatialComponent*>(placeableUserData);
+		return visibleMask;
+	};
 
-			ANKI_ASSERT(m_spatialCount < m_spatials.getSize());
+	auto newPlaceableFunc = [&](U64 testMask, void* placeableUserData) {
+		ANKI_ASSERT(placeableUserData);
+		SpatialComponent* scomp = static_cast<SpatialComponent*>(placeableUserData);
+
+		while(testMask)
+		{
+			const U32 i = getLsb(testMask);
+			testMask &= ~(U64(1) << U64(i));
 
-			m_spatials[m_spatialCount++] = scomp;
+			Frustum& frustum = m_frusta[i];
+			ANKI_ASSERT(frustum.m_spatialCount < frustum.m_spatials.getSize());
+			frustum.m_spatials[frustum.m_spatialCount++] = scomp;
 
-			if(m_spatialCount == m_spatials.getSize())
+			if(frustum.m_spatialCount == frustum.m_spatials.getSize())
 			{
-				flush(hive);
+				flush(hive, frustum);
 			}
-		});
+		}
+	};
 
-	// Flush the remaining
-	flush(hive);
+	// Walk the tree once for all frusta
+	const U64 testMask = (frustumCount == 64) ? MAX_U64 : (U64(1) << U64(frustumCount)) - 1;
+	SceneGraph& scene = *visCtx.m_scene;
+	if(scene.isUsingBvh())
+	{
+		scene.getBvh().walkTreeMulti(firstTestIdx, testMask, testFunc, newPlaceableFunc);
+	}
+	else
+	{
+		scene.getOctree().walkTreeMulti(firstTestIdx, testMask, testFunc, newPlaceableFunc);
+	}
 
-	// Fire an additional dummy task to decrease the semaphore to zero
 	GatherVisiblesFromOctreeTask* pself = this; // MSVC workaround
-	ThreadHiveTask task = ANKI_THREAD_HIVE_TASK({}, pself, nullptr, m_frcCtx->m_visTestsSignalSem);
-	hive.submitTasks(&task, 1);
+	for(Frustum& frustum : m_frusta)
+	{
+		// Flush the remaining
+		flush(hive, frustum);
+
+		// Fire an additional dummy task to decrease the semaphore to zero
+		ThreadHiveTask task = ANKI_THREAD_HIVE_TASK({}, pself, nullptr, frustum.m_frcCtx->m_visTestsSignalSem);
+		hive.submitTasks(&task, 1);
+	}
 }
 
-void GatherVisiblesFromOctreeTask::flush(ThreadHive& hive)
+Bool VisibilityTestTask::cullMeshlets(
+	const RenderComponent& rc, Bool backfaceCulling, ConstWeakArray<RenderableDrawRange>& visibleRanges) const
 {
-	if(m_spatialCount)
+	visibleRanges = ConstWeakArray<RenderableDrawRange>();
+
+	ConstWeakArray<MeshResource::Meshlet> meshlets;
+	Transform trf;
+	if(!rc.getMeshlets(meshlets, trf))
 	{
+		return true;
+	}
+
+	const FrustumComponent& frc = *m_frcCtx->m_frc;
+	const Vec4 frustumOrigin = frc.getTransform().getOrigin().xyz0();
+	backfaceCulling = backfaceCulling && frc.getFrustumType() == FrustumType::PERSPECTIVE;
+
+	// Merge the visible meshlets that are next to each other. If there are too many ranges merge the new ones with the
+	// last and draw the culled meshlets in between
+	Array<RenderableDrawRange, MAX_MESHLET_DRAW_RANGES> ranges;
+	U32 rangeCount = 0;
+	U32 culledIndexCount = 0;
+	for(const MeshResource::Meshlet& meshlet : meshlets)
+	{
+		const Vec4 center = trf.transform(meshlet.m_sphere.xyz0());
+		const F32 radius = meshlet.m_sphere.w() * trf.getScale();
+
+		Bool visible = frc.insideFrustum(Sphere(center, radius));
+
+		if(visible && backfaceCulling)
+		{
+			const Vec4 axis = (trf.getRotation() * meshlet.m_cone.xyz0()).xyz0();
+			const Vec4 dir = center - frustumOrigin;
+			visible = dir.dot(axis) < meshlet.m_cone.w() * dir.getLength() + radius;
+		}
+
+		if(visible)
+		{
+			const Vec4 extend(radius, radius, radius, 0.0f);
+			visible = testAgainstRasterizer(Aabb(center - extend, center + extend));
+		}
+
+		if(!visible)
+		{
+			culledIndexCount += meshlet.m_indexCount;
+			continue;
+		}
+
+		if(rangeCount > 0
+			&& (ranges[rangeCount - 1].m_firstIndex + ranges[rangeCount - 1].m_indexCount == meshlet.m_firstIndex
+				   || rangeCount == MAX_MESHLET_DRAW_RANGES))
+		{
+			RenderableDrawRange& range = ranges[rangeCount - 1];
+			culledIndexCount -= meshlet.m_firstIndex - (range.m_firstIndex + range.m_indexCount);
+			range.m_indexCount = meshlet.m_firstIndex + meshlet.m_indexCount - range.m_firstIndex;
+		}
+		else
+		{
+			ranges[rangeCount].m_firstIndex = meshlet.m_firstIndex;
+			ranges[rangeCount].m_indexCount = meshlet.m_indexCount;
+			++rangeCount;
+		}
+	}
+
+	if(culledIndexCount)
+	{
+		m_frcCtx->m_visCtx->m_culledTriangleCount.fetchAdd(culledIndexCount / 3);
+		ANKI_TRACE_INC_COUNTER(SCENE_CULLED_TRIANGLES, culledIndexCount / 3);
+	}
+
+	if(rangeCount == 0)
+	{
+		return false;
+	}
+
+	if(culledIndexCount)
+	{
+		RenderableDrawRange* out = m_frcCtx->m_visCtx->m_scene->getFrameAllocator().newArray<RenderableDrawRange>(
+			rangeCount);
+		memcpy(out, &ranges[0], sizeof(ranges[0]) * rangeCount);
+		visibleRanges = ConstWeakArray<RenderableDrawRange>(out, rangeCount);
+	}
+
+	return true;
+}
+
+void GatherVisiblesFromOctreeTask::flush(ThreadHive& hive, Frustum& frustum)
+{
+	if(frustum.m_spatialCount)
+	{
+		FrustumVisibilityContext* frcCtx = frustum.m_frcCtx;
+
 		// Create the task
 		VisibilityTestTask* vis =
-			m_frcCtx->m_visCtx->m_scene->getFrameAllocator().newInstance<VisibilityTestTask>(m_frcCtx);
-		memcpy(&vis->m_spatialsToTest[0], &m_spatials[0], sizeof(m_spatials[0]) * m_spatialCount);
-		vis->m_spatialToTestCount = m_spatialCount;
+			frcCtx->m_visCtx->m_scene->getFrameAllocator().newInstance<VisibilityTestTask>(frcCtx);
+		memcpy(&vis->m_spatialsToTest[0],
+			&frustum.m_spatials[0],
+			sizeof(frustum.m_spatials[0]) * frustum.m_spatialCount);
+		vis->m_spatialToTestCount = frustum.m_spatialCount;
 
 		// Increase the semaphore to block the CombineResultsTask
-		m_frcCtx->m_visTestsSignalSem->increaseSemaphore(1);
+		frcCtx->m_visTestsSignalSem->increaseSemaphore(1);
 
 		// Submit task
 		ThreadHiveTask task =
-			ANKI_THREAD_HIVE_TASK({ self->test(hive, threadId); }, vis, nullptr, m_frcCtx->m_visTestsSignalSem);
+			ANKI_THREAD_HIVE_TASK({ self->test(hive, threadId); }, vis, nullptr, frcCtx->m_visTestsSignalSem);
 		hive.submitTasks(&task, 1);
 
 		// Clear count
-		m_spatialCount = 0;
+		frustum.m_spatialCount = 0;
 	}
 }
 
@@ -249,16 +460,49 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 	const Bool wantsEarlyZ = testedFrc.visibilityTestsEnabled(FrustumComponentVisibilityTestFlag::EARLY_Z)
 							 && m_frcCtx->m_visCtx->m_earlyZDist > 0.0f;
 
+	// Cull the AABBs of all spatials in one go to skip most of the invisible ones early
+	AabbSoaArray<MAX_SPATIALS_PER_VIS_TEST> aabbs;
+	for(U i = 0; i < m_spatialToTestCount; ++i)
+	{
+		aabbs.pushBack(m_spatialsToTest[i]->getAabb());
+	}
+
+	Array<U32, MAX_SPATIALS_PER_VIS_TEST> visibleIndices;
+	const U32 visibleCount = cullAabbSoa(testedFrc.getViewPlanes(), aabbs.getView(), WeakArray<U32>(visibleIndices));
+
+	// The frusta of the visible lights and probes. They are submitted together so they walk the octree once
+	Array<const FrustumComponent*, MAX_FRUSTA_PER_GATHER> newFrcs;
+	Array<RenderQueue*, MAX_FRUSTA_PER_GATHER> newRenderQueues;
+	U32 newFrcCount = 0;
+	auto submitNewFrusta = [&]() {
+		if(newFrcCount)
+		{
+			m_frcCtx->m_visCtx->submitNewWork(ConstWeakArray<const FrustumComponent*>(&newFrcs[0], newFrcCount),
+				ConstWeakArray<RenderQueue*>(&newRenderQueues[0], newFrcCount),
+				hive);
+			newFrcCount = 0;
+		}
+	};
+
+	auto addNewFrustum = [&](const FrustumComponent& frc, RenderQueue& rqueue) {
+		newFrcs[newFrcCount] = &frc;
+		newRenderQueues[newFrcCount] = &rqueue;
+		if(++newFrcCount == MAX_FRUSTA_PER_GATHER)
+		{
+			submitNewFrusta();
+		}
+	};
+
 	// Iterate
 	RenderQueueView& result = m_frcCtx->m_queueViews[taskId];
-	for(U i = 0; i < m_spatialToTestCount; ++i)
+	for(U i = 0; i < visibleCount; ++i)
 	{
-		SpatialComponent* spatialC = m_spatialsToTest[i];
+		SpatialComponent* spatialC = m_spatialsToTest[visibleIndices[i]];
 		ANKI_ASSERT(spatialC);
 		SceneNode& node = spatialC->getSceneNode();
 
-		// Skip if it is the same
-		if(ANKI_UNLIKELY(&testedNode == &node))
+		// Skip if it is the same or if it's about to be deleted
+		if(ANKI_UNLIKELY(&testedNode == &node || node.getMarkedForDeletion()))
 		{
 			continue;
 		}
@@ -271,6 +515,12 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 
 		wantNode |= wantsShadowCasters && (rc = node.tryGetComponent<RenderComponent>()) && rc->getCastsShadow();
 
+		// Not ready renderables are skipped in every frustum so they start drawing in all passes at the same frame
+		if(rc && !rc->isReadyForRendering())
+		{
+			rc = nullptr;
+		}
+
 		const LightComponent* lc = nullptr;
 		wantNode |= wantsLightComponents && (lc = node.tryGetComponent<LightComponent>());
 
@@ -339,6 +589,13 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 		WeakArray<RenderQueue> nextQueues;
 		WeakArray<FrustumComponent> nextQueueFrustumComponents; // Optional
 
+		// Cull the meshlets of the renderable. The shadows might come from the back faces
+		ConstWeakArray<RenderableDrawRange> drawRanges;
+		if(rc && !cullMeshlets(*rc, !wantsShadowCasters, drawRanges))
+		{
+			rc = nullptr;
+		}
+
 		if(rc)
 		{
 			RenderableQueueElement* el;
@@ -352,15 +609,21 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 			}
 
 			rc->setupRenderableQueueElement(*el);
+			el->m_drawRanges = (drawRanges.getSize()) ? &drawRanges[0] : nullptr;
+			el->m_drawRangeCount = drawRanges.getSize();
 
 			// Compute distance from the frustum
 			const Plane& nearPlane = testedFrc.getViewPlanes()[FrustumPlaneType::NEAR];
 			el->m_distanceFromCamera = max(0.0f, testPlane(nearPlane, sps[0].m_sp->getAabb()));
 
+			el->m_sortKey =
+				(rc->isForwardShading()) ? computeRevDistanceSortKey(*el) : computeMaterialDistanceSortKey(*el);
+
 			if(wantsEarlyZ && el->m_distanceFromCamera < m_frcCtx->m_visCtx->m_earlyZDist && !rc->isForwardShading())
 			{
 				RenderableQueueElement* el2 = result.m_earlyZRenderables.newElement(alloc);
 				*el2 = *el;
+				el2->m_sortKey = computeDistanceSortKey(*el2);
 			}
 		}
 
@@ -549,7 +812,7 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 			if(ANKI_LIKELY(nextQueueFrustumComponents.getSize() == 0))
 			{
 				err = node.iterateComponentsOfType<FrustumComponent>([&](FrustumComponent& frc) {
-					m_frcCtx->m_visCtx->submitNewWork(frc, nextQueues[count++], hive);
+					addNewFrustum(frc, nextQueues[count++]);
 					return Error::NONE;
 				});
 				(void)err;
@@ -558,7 +821,7 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 			{
 				for(FrustumComponent& frc : nextQueueFrustumComponents)
 				{
-					m_frcCtx->m_visCtx->submitNewWork(frc, nextQueues[count++], hive);
+					addNewFrustum(frc, nextQueues[count++]);
 				}
 			}
 		}
@@ -566,9 +829,11 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 		// Update timestamp
 		timestamp = max(timestamp, node.getComponentMaxTimestamp());
 	} // end for
+
+	submitNewFrusta();
 }
 
-void CombineResultsTask::combine()
+void CombineResultsTask::combine(ThreadHive& hive)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_COMBINE_RESULTS);
 
@@ -616,9 +881,6 @@ void CombineResultsTask::combine()
 			&results.ptrMember_); \
 	}
 
-	ANKI_VIS_COMBINE(RenderableQueueElement, m_renderables);
-	ANKI_VIS_COMBINE(RenderableQueueElement, m_earlyZRenderables);
-	ANKI_VIS_COMBINE(RenderableQueueElement, m_forwardShadingRenderables);
 	ANKI_VIS_COMBINE_AND_PTR(PointLightQueueElement, m_pointLights, m_shadowPointLights);
 	ANKI_VIS_COMBINE_AND_PTR(SpotLightQueueElement, m_spotLights, m_shadowSpotLights);
 	ANKI_VIS_COMBINE(ReflectionProbeQueueElement, m_reflectionProbes);
@@ -649,16 +911,28 @@ void CombineResultsTask::combine()
 	}
 #endif
 
-	// Sort some of the arrays
-	std::sort(results.m_renderables.getBegin(), results.m_renderables.getEnd(), MaterialDistanceSortFunctor(20.0f));
+	// Sort the renderables of every thread in parallel and then merge the sorted lists. Each list is merged in its own
+	// task
+	ThreadHiveTaskGraph graph(hive);
+	FrustumVisibilityContext* frcCtx = m_frcCtx;
+	ThreadHiveTaskGraphNode* sortNode = graph.newParallelFor(0,
+		threadCount * RENDERABLE_LIST_COUNT,
+		1,
+		[frcCtx](U32 begin, U32 end, U32 threadId) {
+			for(U32 i = begin; i < end; ++i)
+			{
+				sortRenderables(*frcCtx, i / RENDERABLE_LIST_COUNT, i % RENDERABLE_LIST_COUNT);
+			}
+		});
 
-	std::sort(results.m_earlyZRenderables.getBegin(),
-		results.m_earlyZRenderables.getEnd(),
-		DistanceSortFunctor<RenderableQueueElement>());
+	for(U32 list = 0; list < RENDERABLE_LIST_COUNT; ++list)
+	{
+		ThreadHiveTaskGraphNode* mergeNode =
+			graph.newTask([frcCtx, list](U32 threadId) { mergeRenderables(*frcCtx, list); });
+		graph.addDependency(mergeNode, sortNode);
+	}
 
-	std::sort(results.m_forwardShadingRenderables.getBegin(),
-		results.m_forwardShadingRenderables.getEnd(),
-		RevDistanceSortFunctor<RenderableQueueElement>());
+	graph.submit();
 
 	// Cleanup
 	if(m_frcCtx->m_r)
@@ -667,6 +941,79 @@ void CombineResultsTask::combine()
 	}
 }
 
+const Array<TRenderQueueElementStorage<RenderableQueueElement> RenderQueueView::*,
+	CombineResultsTask::RENDERABLE_LIST_COUNT>
+	CombineResultsTask::VIEW_RENDERABLE_LISTS = {{&RenderQueueView::m_renderables,
+		&RenderQueueView::m_earlyZRenderables,
+		&RenderQueueView::m_forwardShadingRenderables}};
+
+const Array<WeakArray<RenderableQueueElement> RenderQueue::*, CombineResultsTask::RENDERABLE_LIST_COUNT>
+	CombineResultsTask::RENDERABLE_LISTS = {
+		{&RenderQueue::m_renderables, &RenderQueue::m_earlyZRenderables, &RenderQueue::m_forwardShadingRenderables}};
+
+void CombineResultsTask::sortRenderables(FrustumVisibilityContext& frcCtx, U32 threadIdx, U32 list)
+{
+	TRenderQueueElementStorage<RenderableQueueElement>& storage =
+		frcCtx.m_queueViews[threadIdx].*VIEW_RENDERABLE_LISTS[list];
+	if(storage.m_elementCount < 2)
+	{
+		return;
+	}
+
+	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_SORT);
+
+	// The elements are big so sort the keys and move the elements once. Point the storage to the sorted elements
+	auto alloc = frcCtx.m_visCtx->m_scene->getFrameAllocator();
+	RenderableQueueElement* sorted = alloc.newArray<RenderableQueueElement>(storage.m_elementCount);
+	RadixSortKeyIndex* scratch = alloc.newArray<RadixSortKeyIndex>(storage.m_elementCount * 2);
+	radixSortIndirect(storage.m_elements,
+		sorted,
+		storage.m_elementCount,
+		scratch,
+		[](const RenderableQueueElement& el) { return el.m_sortKey; });
+
+	storage.m_elements = sorted;
+	storage.m_elementStorage = storage.m_elementCount;
+}
+
+void CombineResultsTask::mergeRenderables(FrustumVisibilityContext& frcCtx, U32 list)
+{
+	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_MERGE);
+
+	Array<ConstWeakArray<RenderableQueueElement>, ThreadHive::MAX_THREADS> runs;
+	U32 runCount = 0;
+	U32 totalElCount = 0;
+	for(RenderQueueView& view : frcCtx.m_queueViews)
+	{
+		const TRenderQueueElementStorage<RenderableQueueElement>& storage = view.*VIEW_RENDERABLE_LISTS[list];
+		if(storage.m_elementCount)
+		{
+			runs[runCount++] = ConstWeakArray<RenderableQueueElement>(storage.m_elements, storage.m_elementCount);
+			totalElCount += storage.m_elementCount;
+		}
+	}
+
+	WeakArray<RenderableQueueElement>& combined = frcCtx.m_renderQueue->*RENDERABLE_LISTS[list];
+	if(runCount == 0)
+	{
+		return;
+	}
+	else if(runCount == 1)
+	{
+		// Already sorted, use the storage of the thread
+		combined = WeakArray<RenderableQueueElement>(
+			const_cast<RenderableQueueElement*>(&runs[0][0]), runs[0].getSize());
+		return;
+	}
+
+	RenderableQueueElement* out =
+		frcCtx.m_visCtx->m_scene->getFrameAllocator().newArray<RenderableQueueElement>(totalElCount);
+	mergeSortedRuns(ConstWeakArray<ConstWeakArray<RenderableQueueElement>>(&runs[0], runCount),
+		out,
+		[](const RenderableQueueElement& el) { return el.m_sortKey; });
+	combined = WeakArray<RenderableQueueElement>(out, totalElCount);
+}
+
 template<typename T>
 void CombineResultsTask::combineQueueElements(SceneFrameAllocator<U8>& alloc,
 	WeakArray<TRenderQueueElementStorage<T>> subStorages,
@@ -776,6 +1123,8 @@ void SceneGraph::doVisibilityTests(SceneNode& fsn, SceneGraph& scene, RenderQueu
 
 	hive.waitAllTasks();
 	ctx.m_testedFrcs.destroy(scene.getFrameAllocator());
+
+	scene.m_stats.m_culledTriangleCount = ctx.m_culledTriangleCount.load();
 }
 
 } // end namespace anki
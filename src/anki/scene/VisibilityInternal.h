@@ -9,6 +9,7 @@
 #include <anki/scene/SoftwareRasterizer.h>
 #include <anki/scene/components/FrustumComponent.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/Bvh.h>
 #include <anki/util/Thread.h>
 #include <anki/core/Trace.h>
 #include <anki/renderer/RenderQueue.h>
@@ -16,61 +17,47 @@
 namespace anki
 {
 
+// Forward
+class RenderComponent;
+class FrustumVisibilityContext;
+
 /// @addtogroup scene
 /// @{
 
 static const U32 MAX_SPATIALS_PER_VIS_TEST = 48; ///< Num of spatials to test in a single ThreadHive task.
 static const U32 SW_RASTERIZER_WIDTH = 80;
 static const U32 SW_RASTERIZER_HEIGHT = 50;
+static const U32 MAX_MESHLET_DRAW_RANGES = 32; ///< Max draw calls of a renderable with culled meshlets.
+static const U32 MAX_FRUSTA_PER_GATHER = 64; ///< Max frusta that walk the octree together. The bits of a U64.
 
-/// Sort objects on distance
-template<typename T>
-class DistanceSortFunctor
-{
-public:
-	Bool operator()(const T& a, const T& b)
-	{
-		return a.m_distanceFromCamera < b.m_distanceFromCamera;
-	}
-};
+static const F32 MATERIAL_SORT_DISTANCE_GRANULARITY = 20.0f; ///< The G-buffer renderables are sorted in such classes.
 
-template<typename T>
-class RevDistanceSortFunctor
+/// The sort key of the renderables that populate the G-buffer. The renderables are sorted on distance classes. Inside
+/// a class the ones with the same callback and batch key end up next to each other and inside a batch the ones with
+/// the same merge key.
+inline U64 computeMaterialDistanceSortKey(const RenderableQueueElement& el)
 {
-public:
-	Bool operator()(const T& a, const T& b)
-	{
-		return a.m_distanceFromCamera > b.m_distanceFromCamera;
-	}
-};
-
-/// Material and distance sort.
-class MaterialDistanceSortFunctor
+	const U64 distClass =
+		min<U64>(U64(el.m_distanceFromCamera * (1.0f / MATERIAL_SORT_DISTANCE_GRANULARITY)), MAX_U16);
+	const U64 batchHash = (el.m_batchKey ^ ptrToNumber(el.m_callback)) * 0x9E3779B97F4A7C15;
+	const U64 mergeHash = (el.m_mergeKey ^ ptrToNumber(el.m_callback)) * 0x9E3779B97F4A7C15;
+	return (distClass << 32) | ((batchHash >> 48) << 16) | (mergeHash >> 48);
+}
+
+/// Sort key for front to back. The bits of a positive float have the same order as the float.
+inline U64 computeDistanceSortKey(const RenderableQueueElement& el)
 {
-public:
-	MaterialDistanceSortFunctor(F32 distanceGranularity)
-		: m_distGranularity(1.0f / distanceGranularity)
-	{
-	}
-
-	Bool operator()(const RenderableQueueElement& a, const RenderableQueueElement& b)
-	{
-		const U aClass = a.m_distanceFromCamera * m_distGranularity;
-		const U bClass = b.m_distanceFromCamera * m_distGranularity;
-
-		if(aClass == bClass && a.m_callback == b.m_callback)
-		{
-			return a.m_mergeKey < b.m_mergeKey;
-		}
-		else
-		{
-			return a.m_distanceFromCamera < b.m_distanceFromCamera;
-		}
-	}
-
-private:
-	F32 m_distGranularity;
-};
+	ANKI_ASSERT(el.m_distanceFromCamera >= 0.0f);
+	U32 bits;
+	memcpy(&bits, &el.m_distanceFromCamera, sizeof(bits));
+	return bits;
+}
+
+/// Sort key for back to front.
+inline U64 computeRevDistanceSortKey(const RenderableQueueElement& el)
+{
+	return MAX_U32 - computeDistanceSortKey(el);
+}
 
 /// Storage for a single element type.
 template<typename T, U INITIAL_STORAGE_SIZE = 32, U STORAGE_GROW_RATE = 4>
@@ -132,6 +119,7 @@ class VisibilityContext
 public:
 	SceneGraph* m_scene = nullptr;
 	Atomic<U32> m_testsCount = {0};
+	Atomic<U32> m_culledTriangleCount = {0}; ///< The triangles of the meshlets that got culled in all frusta.
 
 	F32 m_earlyZDist = -1.0f; ///< Cache this.
 
@@ -139,6 +127,22 @@ public:
 	Mutex m_mtx;
 
 	void submitNewWork(const FrustumComponent& frc, RenderQueue& result, ThreadHive& hive);
+
+	/// Submit the work of many frusta. The frusta that don't use occluders walk the octree once for all of them.
+	void submitNewWork(
+		ConstWeakArray<const FrustumComponent*> frcs, ConstWeakArray<RenderQueue*> results, ThreadHive& hive);
+
+private:
+	/// Create the context of a frustum and submit all of its work but the gather.
+	/// @param[out] prepareRasterizerSem The semaphore that the gather should wait. nullptr if there are no occluders.
+	/// @return nullptr if the frustum doesn't need tests.
+	FrustumVisibilityContext* prepareNewWork(const FrustumComponent& frc,
+		RenderQueue& result,
+		ThreadHive& hive,
+		ThreadHiveSemaphore*& prepareRasterizerSem);
+
+	void submitGatherWork(
+		ConstWeakArray<FrustumVisibilityContext*> frcCtxs, ThreadHiveSemaphore* waitSem, ThreadHive& hive);
 };
 
 /// A context for a specific test of a frustum component.
@@ -174,31 +178,59 @@ public:
 		ANKI_ASSERT(m_frcCtx);
 	}
 
-	void fill();
+	/// Fill the depth buffer and spawn the RasterizeTileTask tasks.
+	void fill(ThreadHive& hive, ThreadHiveSemaphore* tilesSem);
+
+	/// Build the HiZ levels that don't belong to a single tile. Runs after all the RasterizeTileTask tasks.
+	void buildCoarseHiZ();
 };
 static_assert(
 	std::is_trivially_destructible<FillRasterizerWithCoverageTask>::value == true, "Should be trivially destructible");
 
-/// ThreadHive task to get visible nodes from the octree.
-class GatherVisiblesFromOctreeTask
+/// ThreadHive task to rasterize a tile of the S/W rasterizer.
+class RasterizeTileTask
 {
 public:
 	FrustumVisibilityContext* m_frcCtx = nullptr;
+	U32 m_tileIdx = MAX_U32;
 
-	GatherVisiblesFromOctreeTask(FrustumVisibilityContext* frcCtx)
+	RasterizeTileTask(FrustumVisibilityContext* frcCtx, U32 tileIdx)
 		: m_frcCtx(frcCtx)
+		, m_tileIdx(tileIdx)
 	{
 		ANKI_ASSERT(m_frcCtx);
 	}
 
+	void rasterize();
+};
+static_assert(std::is_trivially_destructible<RasterizeTileTask>::value == true, "Should be trivially destructible");
+
+/// ThreadHive task to get visible nodes from the octree. It walks the octree once for many frusta.
+class GatherVisiblesFromOctreeTask
+{
+public:
+	/// The gather state of a frustum.
+	class Frustum
+	{
+	public:
+		FrustumVisibilityContext* m_frcCtx = nullptr;
+		Array<SpatialComponent*, MAX_SPATIALS_PER_VIS_TEST> m_spatials;
+		U32 m_spatialCount = 0;
+	};
+
+	WeakArray<Frustum> m_frusta;
+
+	GatherVisiblesFromOctreeTask(WeakArray<Frustum> frusta)
+		: m_frusta(frusta)
+	{
+		ANKI_ASSERT(m_frusta.getSize() > 0 && m_frusta.getSize() <= MAX_FRUSTA_PER_GATHER);
+	}
+
 	void gather(ThreadHive& hive);
 
 private:
-	Array<SpatialComponent*, MAX_SPATIALS_PER_VIS_TEST> m_spatials;
-	U32 m_spatialCount = 0;
-
-	/// Submit tasks to test the m_spatials.
-	void flush(ThreadHive& hive);
+	/// Submit tasks to test the spatials of a frustum.
+	void flush(ThreadHive& hive, Frustum& frustum);
 };
 static_assert(
 	std::is_trivially_destructible<GatherVisiblesFromOctreeTask>::value == true, "Should be trivially destructible");
@@ -225,6 +257,13 @@ private:
 	{
 		return (m_frcCtx->m_r) ? m_frcCtx->m_r->visibilityTest(aabb) : true;
 	}
+
+	/// Test the meshlets of a renderable against the frustum and the S/W rasterizer.
+	/// @param backfaceCulling Also cull the meshlets that face away from the frustum.
+	/// @param[out] visibleRanges The ranges of the indices of the visible meshlets. It's empty if nothing was culled.
+	/// @return False if all the meshlets got culled.
+	ANKI_USE_RESULT Bool cullMeshlets(
+		const RenderComponent& rc, Bool backfaceCulling, ConstWeakArray<RenderableDrawRange>& visibleRanges) const;
 };
 static_assert(std::is_trivially_destructible<VisibilityTestTask>::value == true, "Should be trivially destructible");
 
@@ -240,9 +279,20 @@ public:
 		ANKI_ASSERT(m_frcCtx);
 	}
 
-	void combine();
+	void combine(ThreadHive& hive);
 
 private:
+	static const U32 RENDERABLE_LIST_COUNT = 3;
+	static const Array<TRenderQueueElementStorage<RenderableQueueElement> RenderQueueView::*, RENDERABLE_LIST_COUNT>
+		VIEW_RENDERABLE_LISTS;
+	static const Array<WeakArray<RenderableQueueElement> RenderQueue::*, RENDERABLE_LIST_COUNT> RENDERABLE_LISTS;
+
+	/// Radix sort one renderable list of a RenderQueueView on RenderableQueueElement::m_sortKey.
+	static void sortRenderables(FrustumVisibilityContext& frcCtx, U32 threadIdx, U32 list);
+
+	/// Merge the sorted lists of all RenderQueueViews into the RenderQueue.
+	static void mergeRenderables(FrustumVisibilityContext& frcCtx, U32 list);
+
 	template<typename T>
 	static void combineQueueElements(SceneFrameAllocator<U8>& alloc,
 		WeakArray<TRenderQueueElementStorage<T>> subStorages,
@@ -33,8 +33,6 @@ LightComponent::LightComponent(LightComponentType type, U64 uuid)
 		m_spot.m_textureMat = Mat4::getIdentity();
 		break;
 	case LightComponentType::DIRECTIONAL:
-		m_dir.m_sceneMax = Vec3(MIN_F32);
-		m_dir.m_sceneMin = Vec3(MAX_F32);
 		break;
 	default:
 		ANKI_ASSERT(0);
@@ -65,12 +63,6 @@ Error LightComponent::update(SceneNode& node, Second prevTime, Second crntTime,
 
 	m_flags.unset(DIRTY | TRF_DIRTY);
 
-	// Update the scene bounds always
-	if(m_type == LightComponentType::DIRECTIONAL)
-	{
-		node.getSceneGraph().getOctree().getActualSceneBounds(m_dir.m_sceneMin, m_dir.m_sceneMax);
-	}
-
 	return Error::NONE;
 }
 
@@ -99,6 +91,10 @@ void LightComponent::setupDirectionalLightQueueElement(const FrustumComponent& f
 	const Mat4 lightTrf(m_trf);
 	if(frustumComp.getFrustumType() == FrustumType::PERSPECTIVE)
 	{
+		// Get the scene bounds here and not in update(). The spatial components are placed after the lights update
+		Vec3 actualSceneMin, actualSceneMax;
+		frustumComp.getSceneNode().getSceneGraph().getActualSceneBounds(actualSceneMin, actualSceneMax);
+
 		// Get some stuff
 		const F32 fovX = frustumComp.getFovX();
 		const F32 fovY = frustumComp.getFovY();
@@ -152,8 +148,8 @@ void LightComponent::setupDirectionalLightQueueElement(const FrustumComponent& f
 			const Vec3 sphereCenter = sphere.getCenter().xyz();
 			const F32 sphereRadius = sphere.getRadius();
 			const Vec3& lightDir = el.m_direction;
-			const Vec3 sceneMin = m_dir.m_sceneMin - Vec3(sphereRadius); // Push the bounds a bit
-			const Vec3 sceneMax = m_dir.m_sceneMax + Vec3(sphereRadius);
+			const Vec3 sceneMin = actualSceneMin - Vec3(sphereRadius); // Push the bounds a bit
+			const Vec3 sceneMax = actualSceneMax + Vec3(sphereRadius);
 
 			// Compute the intersections with the scene bounds
 			Vec3 eye;
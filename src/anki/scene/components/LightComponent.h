@@ -28,6 +28,7 @@ class LightComponent : public SceneComponent
 {
 public:
 	static const SceneComponentType CLASS_TYPE = SceneComponentType::LIGHT;
+	using PooledClass = LightComponent;
 
 	LightComponent(LightComponentType type, U64 uuid);
 
@@ -178,17 +179,10 @@ private:
 		F32 m_innerAngle;
 	};
 
-	struct Dir
-	{
-		Vec3 m_sceneMin;
-		Vec3 m_sceneMax;
-	};
-
 	union
 	{
 		Point m_point;
 		Spot m_spot;
-		Dir m_dir;
 	};
 
 	enum
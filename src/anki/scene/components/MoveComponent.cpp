@@ -5,88 +5,67 @@
 
 #include <anki/scene/components/MoveComponent.h>
 #include <anki/scene/SceneNode.h>
+#include <anki/scene/SceneGraph.h>
 
 namespace anki
 {
 
-MoveComponent::MoveComponent(MoveComponentFlag flags)
+MoveComponent::MoveComponent(SceneNode* node, MoveComponentFlag flags)
 	: SceneComponent(CLASS_TYPE)
+	, m_transforms(&node->getSceneGraph().getTransformHierarchy())
 	, m_flags(flags)
 {
-	markForUpdate();
+	m_handle = m_transforms->newTransform(m_flags.get(MoveComponentFlag::IGNORE_LOCAL_TRANSFORM));
+	updateParent(*node);
+
+	// The children may be added before the component
+	Error err = node->visitChildrenMaxDepth(1, [](SceneNode& childNode) -> Error {
+		MoveComponent* childMove = childNode.tryGetComponent<MoveComponent>();
+		if(childMove)
+		{
+			childMove->updateParent(childNode);
+		}
+
+		return Error::NONE;
+	});
+	(void)err;
 }
 
 MoveComponent::~MoveComponent()
 {
+	m_transforms->deleteTransform(m_handle);
 }
 
 Error MoveComponent::update(SceneNode& node, Second prevTime, Second crntTime, Bool& updated)
 {
-	updated = updateWorldTransform(node);
+	// The world transforms are computed by the TransformHierarchy at the start of the frame. Compute it again if the
+	// local transform changed after that
+	if(m_transforms->isDirty(m_handle))
+	{
+		m_transforms->updateWorldTransform(m_handle);
+	}
+
+	updated = m_transforms->wasUpdated(m_handle);
 	return Error::NONE;
 }
 
-Bool MoveComponent::updateWorldTransform(SceneNode& node)
+void MoveComponent::updateParent(const SceneNode& node)
 {
-	m_prevWTrf = m_wtrf;
-	const Bool dirty = m_flags.get(MoveComponentFlag::MARKED_FOR_UPDATE);
-
-	// If dirty then update world transform
-	if(dirty)
+	U32 parentHandle = MAX_U32;
+	const SceneNode* parent = node.getParent();
+	if(parent && !m_flags.get(MoveComponentFlag::IGNORE_PARENT_TRANSFORM))
 	{
-		const SceneNode* parent = node.getParent();
-
-		if(parent)
+		const MoveComponent* parentMove = parent->tryGetComponent<MoveComponent>();
+		if(parentMove)
 		{
-			const MoveComponent* parentMove = parent->tryGetComponent<MoveComponent>();
-
-			if(parentMove == nullptr)
-			{
-				// Parent not movable
-				m_wtrf = m_ltrf;
-			}
-			else if(m_flags.get(MoveComponentFlag::IGNORE_PARENT_TRANSFORM))
-			{
-				m_wtrf = m_ltrf;
-			}
-			else if(m_flags.get(MoveComponentFlag::IGNORE_LOCAL_TRANSFORM))
-			{
-				m_wtrf = parentMove->getWorldTransform();
-			}
-			else
-			{
-				m_wtrf = parentMove->getWorldTransform().combineTransformations(m_ltrf);
-			}
+			parentHandle = parentMove->m_handle;
 		}
-		else
-		{
-			// No parent
-
-			m_wtrf = m_ltrf;
-		}
-
-		// Now it's a good time to cleanse parent
-		m_flags.unset(MoveComponentFlag::MARKED_FOR_UPDATE);
 	}
 
-	// If this is dirty then make children dirty as well. Don't walk the whole tree because you will re-walk it later
-	if(dirty)
+	if(m_transforms->getParent(m_handle) != parentHandle)
 	{
-		Error err = node.visitChildrenMaxDepth(1, [](SceneNode& childNode) -> Error {
-			Error e = childNode.iterateComponentsOfType<MoveComponent>([](MoveComponent& mov) -> Error {
-				mov.markForUpdate();
-				return Error::NONE;
-			});
-
-			(void)e;
-
-			return Error::NONE;
-		});
-
-		(void)err;
+		m_transforms->setParent(m_handle, parentHandle);
 	}
-
-	return dirty;
 }
 
 } // end namespace anki
@@ -7,6 +7,7 @@
 
 #include <anki/scene/Common.h>
 #include <anki/scene/components/SceneComponent.h>
+#include <anki/scene/TransformHierarchy.h>
 #include <anki/util/BitMask.h>
 #include <anki/util/Enum.h>
 #include <anki/Math.h>
@@ -26,154 +27,142 @@ enum class MoveComponentFlag : U8
 
 	/// Ignore parent's transform
 	IGNORE_PARENT_TRANSFORM = 1 << 2,
-
-	/// If dirty then is marked for update
-	MARKED_FOR_UPDATE = 1 << 3,
 };
 ANKI_ENUM_ALLOW_NUMERIC_OPERATIONS(MoveComponentFlag, inline)
 
-/// Interface for movable scene nodes
+/// Interface for movable scene nodes. The transforms live in the TransformHierarchy of the scene and the component is
+/// a handle to them.
 class MoveComponent : public SceneComponent
 {
 public:
 	static const SceneComponentType CLASS_TYPE = SceneComponentType::MOVE;
+	using PooledClass = MoveComponent;
 
 	/// The one and only constructor
+	/// @param node The owner node.
 	/// @param flags The flags
-	MoveComponent(MoveComponentFlag flags = MoveComponentFlag::NONE);
+	MoveComponent(SceneNode* node, MoveComponentFlag flags = MoveComponentFlag::NONE);
 
 	~MoveComponent();
 
 	const Transform& getLocalTransform() const
 	{
-		return m_ltrf;
+		return m_transforms->getLocalTransform(m_handle);
 	}
 
+	/// @note It's safe to call it while other threads create nodes.
 	void setLocalTransform(const Transform& x)
 	{
-		m_ltrf = x;
-		markForUpdate();
+		m_transforms->setLocalTransform(m_handle, x);
 	}
 
 	void setLocalOrigin(const Vec4& x)
 	{
-		m_ltrf.setOrigin(x);
-		markForUpdate();
+		editLocalTransform().setOrigin(x);
 	}
 
 	const Vec4& getLocalOrigin() const
 	{
-		return m_ltrf.getOrigin();
+		return getLocalTransform().getOrigin();
 	}
 
 	void setLocalRotation(const Mat3x4& x)
 	{
-		m_ltrf.setRotation(x);
-		markForUpdate();
+		editLocalTransform().setRotation(x);
 	}
 
 	const Mat3x4& getLocalRotation() const
 	{
-		return m_ltrf.getRotation();
+		return getLocalTransform().getRotation();
 	}
 
 	void setLocalScale(F32 x)
 	{
-		m_ltrf.setScale(x);
-		markForUpdate();
+		editLocalTransform().setScale(x);
 	}
 
 	F32 getLocalScale() const
 	{
-		return m_ltrf.getScale();
+		return getLocalTransform().getScale();
 	}
 
 	const Transform& getWorldTransform() const
 	{
-		return m_wtrf;
+		return m_transforms->getWorldTransform(m_handle);
 	}
 
 	const Transform& getPreviousWorldTransform() const
 	{
-		return m_prevWTrf;
+		return m_transforms->getPreviousWorldTransform(m_handle);
 	}
 
 	ANKI_USE_RESULT Error update(SceneNode& node, Second prevTime, Second crntTime, Bool& updated) override;
 
+	/// Link the transform to the transform of the parent node. Call it when the parent of the node changes.
+	void updateParent(const SceneNode& node);
+
 	/// @name Mess with the local transform
 	/// @{
 	void rotateLocalX(F32 angDegrees)
 	{
-		m_ltrf.getRotation().rotateXAxis(angDegrees);
-		markForUpdate();
+		editLocalTransform().getRotation().rotateXAxis(angDegrees);
 	}
 	void rotateLocalY(F32 angDegrees)
 	{
-		m_ltrf.getRotation().rotateYAxis(angDegrees);
-		markForUpdate();
+		editLocalTransform().getRotation().rotateYAxis(angDegrees);
 	}
 	void rotateLocalZ(F32 angDegrees)
 	{
-		m_ltrf.getRotation().rotateZAxis(angDegrees);
-		markForUpdate();
+		editLocalTransform().getRotation().rotateZAxis(angDegrees);
 	}
 	void moveLocalX(F32 distance)
 	{
-		Vec3 x_axis = m_ltrf.getRotation().getColumn(0);
-		m_ltrf.getOrigin() += Vec4(x_axis, 0.0) * distance;
-		markForUpdate();
+		Transform& ltrf = editLocalTransform();
+		Vec3 x_axis = ltrf.getRotation().getColumn(0);
+		ltrf.getOrigin() += Vec4(x_axis, 0.0) * distance;
 	}
 	void moveLocalY(F32 distance)
 	{
-		Vec3 y_axis = m_ltrf.getRotation().getColumn(1);
-		m_ltrf.getOrigin() += Vec4(y_axis, 0.0) * distance;
-		markForUpdate();
+		Transform& ltrf = editLocalTransform();
+		Vec3 y_axis = ltrf.getRotation().getColumn(1);
+		ltrf.getOrigin() += Vec4(y_axis, 0.0) * distance;
 	}
 	void moveLocalZ(F32 distance)
 	{
-		Vec3 z_axis = m_ltrf.getRotation().getColumn(2);
-		m_ltrf.getOrigin() += Vec4(z_axis, 0.0) * distance;
-		markForUpdate();
+		Transform& ltrf = editLocalTransform();
+		Vec3 z_axis = ltrf.getRotation().getColumn(2);
+		ltrf.getOrigin() += Vec4(z_axis, 0.0) * distance;
 	}
 	void scale(F32 s)
 	{
-		m_ltrf.getScale() *= s;
-		markForUpdate();
+		editLocalTransform().getScale() *= s;
 	}
 
 	void lookAtPoint(const Vec4& point)
 	{
 		ANKI_ASSERT(point.w() == 0.0f);
+		Transform& ltrf = editLocalTransform();
 		const Vec4 j = Vec4(0.0f, 1.0f, 0.0f, 0.0f);
-		const Vec4 vdir = (point - m_ltrf.getOrigin()).getNormalized();
+		const Vec4 vdir = (point - ltrf.getOrigin()).getNormalized();
 		const Vec4 vup = j - vdir * j.dot(vdir);
 		const Vec4 vside = vdir.cross(vup);
 
-		Mat3x4& rot = m_ltrf.getRotation();
+		Mat3x4& rot = ltrf.getRotation();
 		rot.setColumns(vside.xyz(), vup.xyz(), (-vdir).xyz());
-		markForUpdate();
 	}
 	/// @}
 
 private:
-	/// The transformation in local space
-	Transform m_ltrf = Transform::getIdentity();
-
-	/// The transformation in world space (local combined with parent's transformation)
-	Transform m_wtrf = Transform::getIdentity();
-
-	/// Keep the previous transformation for checking if it moved
-	Transform m_prevWTrf = Transform::getIdentity();
+	TransformHierarchy* m_transforms;
+	U32 m_handle; ///< The handle to the transforms.
 
 	BitMask<MoveComponentFlag> m_flags;
 
-	void markForUpdate()
+	/// Get the local transform to change it. It marks it for update.
+	Transform& editLocalTransform()
 	{
-		m_flags.set(MoveComponentFlag::MARKED_FOR_UPDATE);
+		return m_transforms->editLocalTransform(m_handle);
 	}
-
-	/// Called every frame. It updates the @a m_wtrf if @a shouldUpdateWTrf is true. Then it moves to the children.
-	Bool updateWorldTransform(SceneNode& node);
 };
 /// @}
 
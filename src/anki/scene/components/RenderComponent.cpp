@@ -35,6 +35,21 @@ MaterialRenderComponent::~MaterialRenderComponent()
 	m_vars.destroy(m_node->getAllocator());
 }
 
+void MaterialRenderComponent::reportTextureUsage(F32 screenSpaceSize) const
+{
+	for(const MaterialRenderComponentVariable& var : m_vars)
+	{
+		const MaterialVariable& mvar = var.getMaterialVariable();
+		const ShaderVariableDataType type = mvar.getShaderProgramResourceInputVariable().getShaderVariableDataType();
+
+		if(type >= ShaderVariableDataType::TEXTURE_FIRST && type <= ShaderVariableDataType::TEXTURE_LAST
+			&& mvar.getBuiltin() == BuiltinMaterialVariableId::NONE)
+		{
+			mvar.getValue<TextureResourcePtr>()->reportScreenSpaceUsage(screenSpaceSize);
+		}
+	}
+}
+
 void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 	const RenderQueueDrawContext& ctx,
 	ConstWeakArray<Mat4> transforms,
@@ -136,8 +151,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			{
 				ANKI_ASSERT(transforms.getSize() > 0);
 
-				DynamicArrayAuto<Mat3> normMats(m_node->getFrameAllocator());
-				normMats.create(transforms.getSize());
+				Array<Mat3, MAX_INSTANCES> normMats;
 
 				for(U i = 0; i < transforms.getSize(); i++)
 				{
@@ -154,8 +168,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			{
 				ANKI_ASSERT(transforms.getSize() > 0);
 
-				DynamicArrayAuto<Mat3> rots(m_node->getFrameAllocator());
-				rots.create(transforms.getSize());
+				Array<Mat3, MAX_INSTANCES> rots;
 
 				for(U i = 0; i < transforms.getSize(); i++)
 				{
@@ -191,8 +204,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			{
 				ANKI_ASSERT(transforms.getSize() > 0);
 
-				DynamicArrayAuto<Mat4> mvp(m_node->getFrameAllocator());
-				mvp.create(transforms.getSize());
+				Array<Mat4, MAX_INSTANCES> mvp;
 
 				for(U i = 0; i < transforms.getSize(); i++)
 				{
@@ -206,8 +218,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			{
 				ANKI_ASSERT(prevTransforms.getSize() > 0);
 
-				DynamicArrayAuto<Mat4> mvp(m_node->getFrameAllocator());
-				mvp.create(prevTransforms.getSize());
+				Array<Mat4, MAX_INSTANCES> mvp;
 
 				for(U i = 0; i < prevTransforms.getSize(); i++)
 				{
@@ -222,8 +233,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			{
 				ANKI_ASSERT(transforms.getSize() > 0);
 
-				DynamicArrayAuto<Mat4> mv(m_node->getFrameAllocator());
-				mv.create(transforms.getSize());
+				Array<Mat4, MAX_INSTANCES> mv;
 
 				for(U i = 0; i < transforms.getSize(); i++)
 				{
@@ -8,6 +8,7 @@
 #include <anki/scene/Common.h>
 #include <anki/scene/components/SceneComponent.h>
 #include <anki/resource/MaterialResource.h>
+#include <anki/resource/MeshResource.h>
 #include <anki/core/StagingGpuMemoryManager.h>
 #include <anki/renderer/RenderQueue.h>
 
@@ -38,11 +39,27 @@ public:
 		return m_isForwardShading;
 	}
 
+	/// If it's false the visibility tests skip the renderable in all frustums.
+	Bool isReadyForRendering() const
+	{
+		return m_readyForRendering;
+	}
+
 	virtual void setupRenderableQueueElement(RenderableQueueElement& el) const = 0;
 
+	/// Get the meshlets of the first LOD that the visibility tests can cull. It's optional.
+	/// @param[out] meshlets The meshlets in local space.
+	/// @param[out] worldTransform The transform of the meshlets.
+	/// @return False if the renderable doesn't have meshlets.
+	virtual Bool getMeshlets(ConstWeakArray<MeshResource::Meshlet>& meshlets, Transform& worldTransform) const
+	{
+		return false;
+	}
+
 protected:
 	Bool m_castsShadow = false;
 	Bool m_isForwardShading = false;
+	Bool m_readyForRendering = true;
 };
 
 /// A wrapper on top of MaterialVariable
@@ -136,6 +153,10 @@ public:
 		ConstWeakArray<Mat4> prevTransforms,
 		StagingGpuMemoryManager& alloc) const;
 
+	/// Let the texture streaming know how big the textures of the material are on the screen.
+	/// @param screenSpaceSize The size of the object relative to the height of the screen.
+	void reportTextureUsage(F32 screenSpaceSize) const;
+
 private:
 	SceneNode* m_node;
 	Variables m_vars;
@@ -44,6 +44,10 @@ enum class SceneComponentType : U16
 class SceneComponent
 {
 public:
+	/// The classes that set it to themselves are allocated from the component pools of the SceneGraph. Their
+	/// sub-classes are not.
+	using PooledClass = void;
+
 	/// Construct the scene component.
 	SceneComponent(SceneComponentType type)
 		: m_type(type)
@@ -78,6 +82,18 @@ public:
 	/// Called only by the SceneGraph
 	ANKI_USE_RESULT Error updateReal(SceneNode& node, Second prevTime, Second crntTime, Bool& updated);
 
+	/// The handle of the component in its SceneComponentPool. MAX_U32 if it's not pooled.
+	U32 getPoolHandle() const
+	{
+		return m_poolHandle;
+	}
+
+	/// Don't call it.
+	void setPoolHandle(U32 handle)
+	{
+		m_poolHandle = handle;
+	}
+
 	/// Don't call it.
 	void setTimestamp(Timestamp timestamp)
 	{
@@ -89,6 +105,7 @@ public:
 private:
 	Timestamp m_timestamp = 1; ///< Indicates when an update happened
 	SceneComponentType m_type;
+	U32 m_poolHandle = MAX_U32;
 };
 /// @}
 
@@ -29,13 +29,43 @@ SkinComponent::SkinComponent(SceneNode* node, SkeletonResourcePtr skeleton)
 SkinComponent::~SkinComponent()
 {
 	m_boneTrfs.destroy(m_node->getAllocator());
+
+	for(Track& track : m_tracks)
+	{
+		track.m_cursor.destroy(m_node->getAllocator());
+		track.m_channelBones.destroy(m_node->getAllocator());
+	}
 }
 
 void SkinComponent::playAnimation(U track, AnimationResourcePtr anim, Second startTime, Bool repeat)
 {
-	m_tracks[track].m_anim = anim;
-	m_tracks[track].m_time = startTime;
-	m_tracks[track].m_repeat = repeat;
+	Track& t = m_tracks[track];
+	t.m_cursor.destroy(m_node->getAllocator());
+	t.m_channelBones.destroy(m_node->getAllocator());
+
+	t.m_anim = anim;
+	t.m_time = startTime;
+	t.m_repeat = repeat;
+
+	if(!anim.isCreated())
+	{
+		return;
+	}
+
+	// Find the bones of the channels once
+	const AnimationClip& clip = anim->getClip();
+	t.m_cursor.create(m_node->getAllocator(), clip);
+	t.m_channelBones.create(m_node->getAllocator(), clip.getChannelCount());
+	for(U32 i = 0; i < clip.getChannelCount(); ++i)
+	{
+		const Bone* bone = m_skeleton->tryFindBone(clip.getChannelName(i));
+		if(!bone)
+		{
+			ANKI_SCENE_LOGW("Animation is referencing unknown bone \"%s\"", clip.getChannelName(i).cstr());
+		}
+
+		t.m_channelBones[i] = (bone) ? U16(bone->getIndex()) : MAX_U16;
+	}
 }
 
 Error SkinComponent::update(SceneNode& node, Second prevTime, Second crntTime, Bool& updated)
@@ -57,27 +87,34 @@ Error SkinComponent::update(SceneNode& node, Second prevTime, Second crntTime, B
 		const Second animTime = track.m_time;
 		track.m_time += timeDiff;
 
-		// Iterate the animation channels and interpolate
+		// Interpolate all the animation channels
+		const AnimationClip& clip = track.m_anim->getClip();
+		const U32 channelCount = clip.getChannelCount();
+		DynamicArrayAuto<Vec3> positions(m_node->getFrameAllocator());
+		positions.create(channelCount);
+		DynamicArrayAuto<Quat> rotations(m_node->getFrameAllocator());
+		rotations.create(channelCount);
+		DynamicArrayAuto<F32> scales(m_node->getFrameAllocator());
+		scales.create(channelCount);
+		clip.sampleAll(animTime,
+			track.m_cursor,
+			WeakArray<Vec3>(positions),
+			WeakArray<Quat>(rotations),
+			WeakArray<F32>(scales));
+
+		// Store
 		BitSet<128> bonesAnimated(false);
-		for(U i = 0; i < track.m_anim->getChannels().getSize(); ++i)
+		for(U32 i = 0; i < channelCount; ++i)
 		{
-			const AnimationChannel& channel = track.m_anim->getChannels()[i];
-			const Bone* bone = m_skeleton->tryFindBone(channel.m_name.toCString());
-			if(!bone)
+			const U32 boneIdx = track.m_channelBones[i];
+			if(boneIdx == MAX_U16)
 			{
-				ANKI_SCENE_LOGW("Animation is referencing unknown bone \"%s\"", &channel.m_name[0]);
 				continue;
 			}
 
-			// Interpolate
-			Vec3 position;
-			Quat rotation;
-			F32 scale;
-			track.m_anim->interpolate(i, animTime, position, rotation, scale);
-
-			// Store
-			bonesAnimated.set(bone->getIndex());
-			m_boneTrfs[bone->getIndex()] = Mat4(position.xyz1(), Mat3(rotation), 1.0f) * bone->getVertexTransform();
+			const Bone& bone = m_skeleton->getBones()[boneIdx];
+			bonesAnimated.set(boneIdx);
+			m_boneTrfs[boneIdx] = Mat4(positions[i].xyz1(), Mat3(rotations[i]), scales[i]) * bone.getVertexTransform();
 		}
 
 		// Walk the bone hierarchy to add additional transforms
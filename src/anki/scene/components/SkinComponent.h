@@ -7,6 +7,7 @@
 
 #include <anki/scene/components/SceneComponent.h>
 #include <anki/resource/Forward.h>
+#include <anki/resource/AnimationClip.h>
 #include <anki/util/Forward.h>
 #include <anki/Math.h>
 
@@ -21,6 +22,7 @@ class SkinComponent : public SceneComponent
 {
 public:
 	static const SceneComponentType CLASS_TYPE = SceneComponentType::SKIN;
+	using PooledClass = SkinComponent;
 	static const U MAX_ANIMATION_TRACKS = 2;
 
 	SkinComponent(SceneNode* node, SkeletonResourcePtr skeleton);
@@ -41,6 +43,8 @@ private:
 	{
 	public:
 		AnimationResourcePtr m_anim;
+		AnimationCursor m_cursor;
+		DynamicArray<U16> m_channelBones; ///< The bone of every channel of the animation. MAX_U16 if there is none.
 		F64 m_time;
 		Bool m_repeat;
 	};
@@ -18,6 +18,7 @@ SpatialComponent::SpatialComponent(SceneNode* node, const Obb* obb)
 	ANKI_ASSERT(obb);
 	markForUpdate();
 	m_octreeInfo.m_userData = this;
+	m_bvhInfo.m_userData = this;
 	m_obb = obb;
 	m_collisionObjectType = obb->CLASS_TYPE;
 }
@@ -30,6 +31,7 @@ SpatialComponent::SpatialComponent(SceneNode* node, const Aabb* aabb)
 	ANKI_ASSERT(aabb);
 	markForUpdate();
 	m_octreeInfo.m_userData = this;
+	m_bvhInfo.m_userData = this;
 	m_aabb = aabb;
 	m_collisionObjectType = aabb->CLASS_TYPE;
 }
@@ -42,6 +44,7 @@ SpatialComponent::SpatialComponent(SceneNode* node, const Sphere* sphere)
 	ANKI_ASSERT(sphere);
 	markForUpdate();
 	m_octreeInfo.m_userData = this;
+	m_bvhInfo.m_userData = this;
 	m_sphere = sphere;
 	m_collisionObjectType = sphere->CLASS_TYPE;
 }
@@ -54,6 +57,7 @@ SpatialComponent::SpatialComponent(SceneNode* node, const ConvexHullShape* hull)
 	ANKI_ASSERT(hull);
 	markForUpdate();
 	m_octreeInfo.m_userData = this;
+	m_bvhInfo.m_userData = this;
 	m_hull = hull;
 	m_collisionObjectType = hull->CLASS_TYPE;
 }
@@ -62,7 +66,15 @@ SpatialComponent::~SpatialComponent()
 {
 	if(m_placed)
 	{
-		m_node->getSceneGraph().getOctree().remove(m_octreeInfo);
+		SceneGraph& scene = m_node->getSceneGraph();
+		if(scene.isUsingBvh())
+		{
+			scene.getBvh().remove(m_bvhInfo);
+		}
+		else
+		{
+			scene.getOctree().remove(m_octreeInfo);
+		}
 	}
 }
 
@@ -94,7 +106,15 @@ Error SpatialComponent::update(SceneNode& node, Second prevTime, Second crntTime
 
 		m_markedForUpdate = false;
 
-		m_node->getSceneGraph().getOctree().place(m_derivedAabb, &m_octreeInfo, m_updateOctreeBounds);
+		SceneGraph& scene = m_node->getSceneGraph();
+		if(scene.isUsingBvh())
+		{
+			scene.getBvh().place(m_derivedAabb, &m_bvhInfo, m_updateOctreeBounds);
+		}
+		else
+		{
+			scene.getOctree().place(m_derivedAabb, &m_octreeInfo, m_updateOctreeBounds);
+		}
 		m_placed = true;
 	}
 
@@ -7,6 +7,7 @@
 
 #include <anki/scene/components/SceneComponent.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/Bvh.h>
 #include <anki/Collision.h>
 #include <anki/util/BitMask.h>
 #include <anki/util/Enum.h>
@@ -23,6 +24,7 @@ class SpatialComponent : public SceneComponent
 {
 public:
 	static const SceneComponentType CLASS_TYPE = SceneComponentType::SPATIAL;
+	using PooledClass = SpatialComponent;
 
 	SpatialComponent(SceneNode* node, const Obb* obb);
 
@@ -80,7 +82,7 @@ public:
 		m_markedForUpdate = true;
 	}
 
-	/// Update the "actual scene bounds" of the octree or not.
+	/// Update the "actual scene bounds" of the octree (or the BVH) or not.
 	void setUpdateOctreeBounds(Bool update)
 	{
 		m_updateOctreeBounds = update;
@@ -109,6 +111,7 @@ private:
 	Vec4 m_origin = Vec4(MAX_F32, MAX_F32, MAX_F32, 0.0f);
 
 	OctreePlaceable m_octreeInfo;
+	BvhPlaceable m_bvhInfo;
 
 	Bool m_markedForUpdate = false;
 	Bool m_placed = false;
@@ -9,6 +9,12 @@
 #include <anki/util/Assert.h>
 #include <cstring>
 #include <cstdarg>
+#if ANKI_POSIX
+#	include <sys/mman.h>
+#elif ANKI_OS == ANKI_OS_WINDOWS
+#	include <windows.h>
+#	include <io.h>
+#endif
 
 namespace anki
 {
@@ -31,6 +37,7 @@ File& File::operator=(File&& b)
 		m_type = b.m_type;
 		m_flags = b.m_flags;
 		m_size = b.m_size;
+		m_mappedMem = b.m_mappedMem;
 	}
 
 	b.zero();
@@ -198,6 +205,15 @@ void File::close()
 	{
 		if(m_type == Type::C)
 		{
+			if(m_mappedMem)
+			{
+#if ANKI_POSIX
+				munmap(m_mappedMem, m_size);
+#elif ANKI_OS == ANKI_OS_WINDOWS
+				UnmapViewOfFile(m_mappedMem);
+#endif
+			}
+
 			fclose(ANKI_CFILE);
 		}
 #if ANKI_OS == ANKI_OS_ANDROID
@@ -305,6 +321,77 @@ PtrSize File::getSize() const
 	return out;
 }
 
+Error File::map(const void*& data)
+{
+	ANKI_ASSERT(m_file);
+	ANKI_ASSERT((m_flags & FileOpenFlag::READ) != FileOpenFlag::NONE);
+
+	if(m_mappedMem)
+	{
+		data = m_mappedMem;
+		return Error::NONE;
+	}
+
+	if(m_size == 0)
+	{
+		ANKI_UTIL_LOGE("Can't map an empty file");
+		return Error::USER_DATA;
+	}
+
+	if(m_type == Type::C)
+	{
+#if ANKI_POSIX
+		void* mem = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fileno(ANKI_CFILE), 0);
+		if(mem == MAP_FAILED)
+		{
+			ANKI_UTIL_LOGE("mmap() failed");
+			return Error::FUNCTION_FAILED;
+		}
+#elif ANKI_OS == ANKI_OS_WINDOWS
+		HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(ANKI_CFILE)));
+		HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mapping == nullptr)
+		{
+			ANKI_UTIL_LOGE("CreateFileMappingA() failed");
+			return Error::FUNCTION_FAILED;
+		}
+
+		// The view keeps the mapping alive
+		void* mem = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if(mem == nullptr)
+		{
+			ANKI_UTIL_LOGE("MapViewOfFile() failed");
+			return Error::FUNCTION_FAILED;
+		}
+#else
+#	error "Unimplemented"
+#endif
+		m_mappedMem = mem;
+	}
+#if ANKI_OS == ANKI_OS_ANDROID
+	else if(m_type == Type::SPECIAL)
+	{
+		// The asset manager owns that memory
+		const void* mem = AAsset_getBuffer(ANKI_AFILE);
+		if(mem == nullptr)
+		{
+			ANKI_UTIL_LOGE("AAsset_getBuffer() failed");
+			return Error::FUNCTION_FAILED;
+		}
+
+		m_mappedMem = const_cast<void*>(mem);
+	}
+#endif
+	else
+	{
+		ANKI_ASSERT(0);
+	}
+
+	data = m_mappedMem;
+	return Error::NONE;
+}
+
 Error File::readU32(U32& out)
 {
 	ANKI_ASSERT(m_file);
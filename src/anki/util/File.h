@@ -107,6 +107,11 @@ public:
 	/// The the size of the file.
 	PtrSize getSize() const;
 
+	/// Map the whole file to memory. The file should be open for reading. The mapping is released when the file is
+	/// closed.
+	/// @param[out] data The contents of the file.
+	ANKI_USE_RESULT Error map(const void*& data);
+
 private:
 	/// Internal filetype
 	enum class Type : U8
@@ -120,6 +125,7 @@ private:
 	Type m_type = Type::NONE;
 	FileOpenFlag m_flags = FileOpenFlag::NONE; ///< All the flags. Set on open
 	U32 m_size = 0;
+	void* m_mappedMem = nullptr; ///< Set by map()
 
 	/// Get the current machine's endianness
 	static FileOpenFlag getMachineEndianness();
@@ -145,6 +151,7 @@ private:
 		m_type = Type::NONE;
 		m_flags = FileOpenFlag::NONE;
 		m_size = 0;
+		m_mappedMem = nullptr;
 	}
 };
 /// @}
@@ -72,6 +72,58 @@ inline Int nextPowerOfTwo(Int x)
 	return pow(2, ceil(log(x) / log(2)));
 }
 
+/// Get the index of the least significant set bit. The number shouldn't be zero.
+inline U32 getLsb(U32 x)
+{
+	ANKI_ASSERT(x != 0);
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, x);
+	return U32(idx);
+#else
+	return U32(__builtin_ctz(x));
+#endif
+}
+
+/// Get the index of the least significant set bit. The number shouldn't be zero.
+inline U32 getLsb(U64 x)
+{
+	ANKI_ASSERT(x != 0);
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward64(&idx, x);
+	return U32(idx);
+#else
+	return U32(__builtin_ctzll(x));
+#endif
+}
+
+/// Get the index of the most significant set bit. The number shouldn't be zero.
+inline U32 getMsb(U32 x)
+{
+	ANKI_ASSERT(x != 0);
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanReverse(&idx, x);
+	return U32(idx);
+#else
+	return 31u - U32(__builtin_clz(x));
+#endif
+}
+
+/// Get the index of the most significant set bit. The number shouldn't be zero.
+inline U32 getMsb(U64 x)
+{
+	ANKI_ASSERT(x != 0);
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanReverse64(&idx, x);
+	return U32(idx);
+#else
+	return 63u - U32(__builtin_clzll(x));
+#endif
+}
+
 /// Get the aligned number rounded up.
 /// @param alignment The bytes of alignment
 /// @param value The value to align
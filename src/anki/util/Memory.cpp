@@ -186,6 +186,512 @@ void BaseMemoryPool::free(void* ptr)
 	}
 }
 
+/// The thread-local front-end of HeapMemoryPool and ChainMemoryPool. Every thread gets its own free lists of small
+/// blocks, one for each size class. Allocations and frees touch only the thread's lists. When a list runs dry it takes
+/// a batch of blocks from a shared list or carves a new slab from the backing pool. When it grows too much it gives a
+/// batch back to the shared list. Every block has a small header that holds its size class so free() doesn't need the
+/// size.
+class MemoryPoolThreadCache
+{
+public:
+	MemoryPoolThreadCache(BaseMemoryPool* pool)
+		: m_pool(pool)
+	{
+		for(Atomic<ThreadCache*>& slot : m_threadCaches)
+		{
+			slot.set(nullptr);
+		}
+	}
+
+	~MemoryPoolThreadCache();
+
+	void* allocate(PtrSize size, PtrSize alignment);
+
+	void free(void* ptr);
+
+	I64 getAllocationsCount() const;
+
+	ThreadCacheStats getStats() const;
+
+private:
+	static const U32 MAX_THREADS = 128;
+	static const U32 SIZE_CLASS_COUNT = 20; ///< 16 to 256 every 16 bytes, then 512, 1K, 2K and 4K.
+	static const PtrSize MAX_CACHED_SIZE = 4096;
+	static const PtrSize HEADER_SIZE = 16;
+	static const U32 LARGE_SIZE_CLASS = MAX_U32;
+	static const PtrSize BATCH_SIZE = 8 * 1024; ///< Roughly the memory moved between the lists at once.
+
+	class alignas(HEADER_SIZE) Header
+	{
+	public:
+		/// When the block is free it's the next free block. When it's allocated it's the start of the allocation.
+		void* m_ptr;
+		U32 m_sizeClass;
+	};
+	static_assert(sizeof(Header) == HEADER_SIZE, "See file");
+
+	class FreeList
+	{
+	public:
+		Header* m_head = nullptr;
+		U32 m_count = 0;
+	};
+
+	class ThreadCache
+	{
+	public:
+		Array<FreeList, SIZE_CLASS_COUNT> m_lists;
+
+		// Only the owner thread writes them so they don't need atomic operations, only atomic loads and stores
+		Atomic<U64> m_allocationCount = {0};
+		Atomic<U64> m_freeCount = {0};
+		Atomic<U64> m_hitCount = {0};
+		Atomic<U64> m_missCount = {0};
+	};
+
+	class SharedList
+	{
+	public:
+		SpinLock m_lock;
+		FreeList m_list;
+	};
+
+	BaseMemoryPool* m_pool;
+	Array<Atomic<ThreadCache*>, MAX_THREADS> m_threadCaches;
+	Array<SharedList, SIZE_CLASS_COUNT> m_sharedLists;
+
+	SpinLock m_slabLock;
+	Header* m_slabs = nullptr; ///< Linked with Header::m_ptr.
+	Atomic<PtrSize> m_cachedMemory = {0};
+
+	Atomic<I64> m_sharedAllocationCount = {0}; ///< Allocations that didn't go through a ThreadCache.
+	Atomic<U64> m_largeAllocationCount = {0};
+
+	static void increment(Atomic<U64>& a)
+	{
+		a.store(a.load() + 1);
+	}
+
+	static U32 computeSizeClass(PtrSize size)
+	{
+		ANKI_ASSERT(size <= MAX_CACHED_SIZE);
+		if(size <= 256)
+		{
+			return (max<U32>(size, 1) + 15) / 16 - 1;
+		}
+		else
+		{
+			// ceil(log2(size)) - log2(512)
+			return 16 + getMsb(U64(size - 1)) + 1 - 9;
+		}
+	}
+
+	static PtrSize computeBlockSize(U32 sizeClass)
+	{
+		ANKI_ASSERT(sizeClass < SIZE_CLASS_COUNT);
+		const PtrSize size = (sizeClass < 16) ? (sizeClass + 1) * 16 : (PtrSize(512) << (sizeClass - 16));
+		return size + HEADER_SIZE;
+	}
+
+	static U32 computeBatchCount(U32 sizeClass)
+	{
+		return clamp<U32>(BATCH_SIZE / computeBlockSize(sizeClass), 4, 64);
+	}
+
+	void* backendAllocate(PtrSize size, PtrSize alignment);
+
+	void backendFree(void* ptr);
+
+	ThreadCache* getThreadCache();
+
+	/// Fill an empty list.
+	Bool refill(U32 sizeClass, FreeList& list);
+
+	/// Give half of a list to the shared list.
+	void drain(U32 sizeClass, FreeList& list);
+
+	static void moveBlocks(FreeList& from, FreeList& to, U32 count)
+	{
+		ANKI_ASSERT(count <= from.m_count);
+		for(U32 i = 0; i < count; ++i)
+		{
+			Header* block = from.m_head;
+			from.m_head = static_cast<Header*>(block->m_ptr);
+			block->m_ptr = to.m_head;
+			to.m_head = block;
+		}
+
+		from.m_count -= count;
+		to.m_count += count;
+	}
+};
+
+/// Hands out the IDs that index MemoryPoolThreadCache::m_threadCaches and StackMemoryPool::m_threadArenas. A thread
+/// releases its ID when it exits.
+class MemoryPoolThreadId
+{
+public:
+	U32 m_id = MAX_U32;
+	Bool m_initialized = false;
+
+	static const U32 MAX_IDS = 128;
+	static Array<Atomic<U64>, MAX_IDS / 64> m_usedIds;
+
+	~MemoryPoolThreadId()
+	{
+		if(m_id != MAX_U32)
+		{
+			m_usedIds[m_id / 64].fetchAnd(~(U64(1) << (m_id % 64)));
+		}
+
+		// The ID may belong to another thread from now on. Pools used later in the exit of this thread bypass the
+		// caches instead of taking an ID that no one will release
+		m_id = MAX_U32;
+		m_initialized = true;
+	}
+
+	U32 get()
+	{
+		if(ANKI_UNLIKELY(!m_initialized))
+		{
+			m_initialized = true;
+			m_id = acquire();
+			if(m_id == MAX_U32)
+			{
+				ANKI_UTIL_LOGW("Out of memory pool thread IDs. The thread will bypass the thread caches and arenas");
+			}
+		}
+
+		return m_id;
+	}
+
+private:
+	static U32 acquire()
+	{
+		for(U32 i = 0; i < m_usedIds.getSize(); ++i)
+		{
+			U64 used = m_usedIds[i].load();
+			while(used != MAX_U64)
+			{
+				const U32 bit = getLsb(~used);
+				if(m_usedIds[i].compareExchange(used, used | (U64(1) << bit)))
+				{
+					return i * 64 + bit;
+				}
+			}
+		}
+
+		return MAX_U32;
+	}
+};
+
+Array<Atomic<U64>, MemoryPoolThreadId::MAX_IDS / 64> MemoryPoolThreadId::m_usedIds;
+static thread_local MemoryPoolThreadId g_memoryPoolThreadId;
+
+MemoryPoolThreadCache::~MemoryPoolThreadCache()
+{
+	Header* slab = m_slabs;
+	while(slab)
+	{
+		Header* next = static_cast<Header*>(slab->m_ptr);
+		backendFree(slab);
+		slab = next;
+	}
+
+	for(Atomic<ThreadCache*>& slot : m_threadCaches)
+	{
+		ThreadCache* cache = slot.load();
+		if(cache)
+		{
+			cache->~ThreadCache();
+			m_pool->m_allocCb(m_pool->m_allocCbUserData, cache, 0, 0);
+		}
+	}
+}
+
+void* MemoryPoolThreadCache::backendAllocate(PtrSize size, PtrSize alignment)
+{
+	if(m_pool->m_type == BaseMemoryPool::Type::HEAP)
+	{
+		return static_cast<HeapMemoryPool*>(m_pool)->allocateInternal(size, alignment);
+	}
+	else
+	{
+		ANKI_ASSERT(m_pool->m_type == BaseMemoryPool::Type::CHAIN);
+		return static_cast<ChainMemoryPool*>(m_pool)->allocateInternal(size, alignment);
+	}
+}
+
+void MemoryPoolThreadCache::backendFree(void* ptr)
+{
+	if(m_pool->m_type == BaseMemoryPool::Type::HEAP)
+	{
+		static_cast<HeapMemoryPool*>(m_pool)->freeInternal(ptr);
+	}
+	else
+	{
+		ANKI_ASSERT(m_pool->m_type == BaseMemoryPool::Type::CHAIN);
+		static_cast<ChainMemoryPool*>(m_pool)->freeInternal(ptr);
+	}
+}
+
+MemoryPoolThreadCache::ThreadCache* MemoryPoolThreadCache::getThreadCache()
+{
+	const U32 id = g_memoryPoolThreadId.get();
+	if(ANKI_UNLIKELY(id == MAX_U32))
+	{
+		return nullptr;
+	}
+
+	// Only this thread writes to this slot so no need for CAS
+	ThreadCache* cache = m_threadCaches[id].load(AtomicMemoryOrder::ACQUIRE);
+	if(ANKI_UNLIKELY(cache == nullptr))
+	{
+		cache = static_cast<ThreadCache*>(
+			m_pool->m_allocCb(m_pool->m_allocCbUserData, nullptr, sizeof(ThreadCache), alignof(ThreadCache)));
+		if(cache == nullptr)
+		{
+			ANKI_OOM_ACTION();
+			return nullptr;
+		}
+
+		::new(cache) ThreadCache();
+		m_threadCaches[id].store(cache, AtomicMemoryOrder::RELEASE);
+	}
+
+	return cache;
+}
+
+Bool MemoryPoolThreadCache::refill(U32 sizeClass, FreeList& list)
+{
+	ANKI_ASSERT(list.m_count == 0);
+	const U32 batchCount = computeBatchCount(sizeClass);
+
+	// Try the shared list first
+	{
+		SharedList& shared = m_sharedLists[sizeClass];
+		LockGuard<SpinLock> lock(shared.m_lock);
+		moveBlocks(shared.m_list, list, min(batchCount, shared.m_list.m_count));
+	}
+
+	if(list.m_count > 0)
+	{
+		return true;
+	}
+
+	// Carve a new slab. Its first block is reserved to link it with the rest of the slabs
+	const PtrSize blockSize = computeBlockSize(sizeClass);
+	const PtrSize slabSize = HEADER_SIZE + blockSize * batchCount;
+	U8* mem = static_cast<U8*>(backendAllocate(slabSize, HEADER_SIZE));
+	if(mem == nullptr)
+	{
+		return false;
+	}
+
+	ANKI_ASSERT(isAligned(HEADER_SIZE, mem));
+	m_cachedMemory.fetchAdd(slabSize);
+
+	Header* slab = reinterpret_cast<Header*>(mem);
+	{
+		LockGuard<SpinLock> lock(m_slabLock);
+		slab->m_ptr = m_slabs;
+		m_slabs = slab;
+	}
+
+	mem += HEADER_SIZE;
+	for(U32 i = 0; i < batchCount; ++i)
+	{
+		Header* block = reinterpret_cast<Header*>(mem + blockSize * (batchCount - i - 1));
+		block->m_ptr = list.m_head;
+		block->m_sizeClass = sizeClass;
+		list.m_head = block;
+	}
+	list.m_count = batchCount;
+
+	return true;
+}
+
+void MemoryPoolThreadCache::drain(U32 sizeClass, FreeList& list)
+{
+	SharedList& shared = m_sharedLists[sizeClass];
+	LockGuard<SpinLock> lock(shared.m_lock);
+	moveBlocks(list, shared.m_list, list.m_count / 2);
+}
+
+void* MemoryPoolThreadCache::allocate(PtrSize size, PtrSize alignment)
+{
+	ThreadCache* cache;
+	if(ANKI_LIKELY(size <= MAX_CACHED_SIZE && alignment <= HEADER_SIZE) && (cache = getThreadCache()) != nullptr)
+	{
+		const U32 sizeClass = computeSizeClass(size);
+		FreeList& list = cache->m_lists[sizeClass];
+
+		increment(cache->m_allocationCount);
+		if(ANKI_LIKELY(list.m_count > 0))
+		{
+			increment(cache->m_hitCount);
+		}
+		else
+		{
+			increment(cache->m_missCount);
+			if(!refill(sizeClass, list))
+			{
+				return nullptr;
+			}
+		}
+
+		Header* block = list.m_head;
+		list.m_head = static_cast<Header*>(block->m_ptr);
+		--list.m_count;
+
+		ANKI_ASSERT(block->m_sizeClass == sizeClass);
+		block->m_ptr = block;
+		return block + 1;
+	}
+
+	// Large or over-aligned. Go to the backing pool and leave room for the header before the returned memory
+	alignment = max(alignment, PtrSize(HEADER_SIZE));
+	U8* mem = static_cast<U8*>(backendAllocate(size + alignment, alignment));
+	if(mem == nullptr)
+	{
+		return nullptr;
+	}
+
+	m_largeAllocationCount.fetchAdd(1);
+	m_sharedAllocationCount.fetchAdd(1);
+
+	Header* header = reinterpret_cast<Header*>(mem + alignment) - 1;
+	header->m_ptr = mem;
+	header->m_sizeClass = LARGE_SIZE_CLASS;
+	return header + 1;
+}
+
+void MemoryPoolThreadCache::free(void* ptr)
+{
+	Header* block = static_cast<Header*>(ptr) - 1;
+
+	if(block->m_sizeClass == LARGE_SIZE_CLASS)
+	{
+		m_sharedAllocationCount.fetchSub(1);
+		backendFree(block->m_ptr);
+		return;
+	}
+
+	const U32 sizeClass = block->m_sizeClass;
+	ANKI_ASSERT(sizeClass < SIZE_CLASS_COUNT && block->m_ptr == block && "Not a block of this cache");
+
+	ThreadCache* cache = getThreadCache();
+	if(ANKI_UNLIKELY(cache == nullptr))
+	{
+		// The thread doesn't have a cache, give the block to the shared list
+		m_sharedAllocationCount.fetchSub(1);
+		SharedList& shared = m_sharedLists[sizeClass];
+		LockGuard<SpinLock> lock(shared.m_lock);
+		block->m_ptr = shared.m_list.m_head;
+		shared.m_list.m_head = block;
+		++shared.m_list.m_count;
+		return;
+	}
+
+	increment(cache->m_freeCount);
+
+	FreeList& list = cache->m_lists[sizeClass];
+	block->m_ptr = list.m_head;
+	list.m_head = block;
+	++list.m_count;
+
+	if(ANKI_UNLIKELY(list.m_count > computeBatchCount(sizeClass) * 2))
+	{
+		drain(sizeClass, list);
+	}
+}
+
+I64 MemoryPoolThreadCache::getAllocationsCount() const
+{
+	I64 count = m_sharedAllocationCount.load();
+	for(const Atomic<ThreadCache*>& slot : m_threadCaches)
+	{
+		const ThreadCache* cache = slot.load(AtomicMemoryOrder::ACQUIRE);
+		if(cache)
+		{
+			count += I64(cache->m_allocationCount.load()) - I64(cache->m_freeCount.load());
+		}
+	}
+
+	return count;
+}
+
+ThreadCacheStats MemoryPoolThreadCache::getStats() const
+{
+	ThreadCacheStats stats;
+	for(const Atomic<ThreadCache*>& slot : m_threadCaches)
+	{
+		const ThreadCache* cache = slot.load(AtomicMemoryOrder::ACQUIRE);
+		if(cache)
+		{
+			stats.m_allocationCount += cache->m_allocationCount.load();
+			stats.m_freeCount += cache->m_freeCount.load();
+			stats.m_hitCount += cache->m_hitCount.load();
+			stats.m_missCount += cache->m_missCount.load();
+			++stats.m_threadCount;
+		}
+	}
+
+	stats.m_largeAllocationCount = m_largeAllocationCount.load();
+	stats.m_cachedMemory = m_cachedMemory.load();
+	return stats;
+}
+
+U32 BaseMemoryPool::getAllocationsCount() const
+{
+	if(m_threadCache)
+	{
+		return U32(m_threadCache->getAllocationsCount());
+	}
+	else if(m_type == Type::STACK)
+	{
+		return static_cast<const StackMemoryPool*>(this)->getAllocationsCountInternal();
+	}
+	else
+	{
+		return m_allocationsCount.load();
+	}
+}
+
+ThreadCacheStats BaseMemoryPool::getThreadCacheStats() const
+{
+	return (m_threadCache) ? m_threadCache->getStats() : ThreadCacheStats();
+}
+
+void BaseMemoryPool::createThreadCache()
+{
+	ANKI_ASSERT(isCreated() && !m_threadCache);
+	m_threadCache = static_cast<MemoryPoolThreadCache*>(
+		m_allocCb(m_allocCbUserData, nullptr, sizeof(MemoryPoolThreadCache), alignof(MemoryPoolThreadCache)));
+	if(!m_threadCache)
+	{
+		ANKI_CREATION_OOM_ACTION();
+	}
+
+	::new(m_threadCache) MemoryPoolThreadCache(this);
+}
+
+void BaseMemoryPool::destroyThreadCache()
+{
+	if(m_threadCache)
+	{
+		const U32 count = getAllocationsCount();
+		if(count != 0)
+		{
+			ANKI_UTIL_LOGW("Memory pool destroyed before all memory being released (%u deallocations missed)", count);
+		}
+
+		m_threadCache->~MemoryPoolThreadCache();
+		m_allocCb(m_allocCbUserData, m_threadCache, 0, 0);
+		m_threadCache = nullptr;
+	}
+}
+
 HeapMemoryPool::HeapMemoryPool()
 	: BaseMemoryPool(Type::HEAP)
 {
@@ -193,6 +699,8 @@ HeapMemoryPool::HeapMemoryPool()
 
 HeapMemoryPool::~HeapMemoryPool()
 {
+	destroyThreadCache();
+
 	U count = m_allocationsCount.load();
 	if(count != 0)
 	{
@@ -202,7 +710,7 @@ HeapMemoryPool::~HeapMemoryPool()
 	}
 }
 
-void HeapMemoryPool::create(AllocAlignedCallback allocCb, void* allocCbUserData)
+void HeapMemoryPool::create(AllocAlignedCallback allocCb, void* allocCbUserData, Bool threadCache)
 {
 	ANKI_ASSERT(!isCreated());
 	ANKI_ASSERT(m_allocCb == nullptr);
@@ -214,11 +722,37 @@ void HeapMemoryPool::create(AllocAlignedCallback allocCb, void* allocCbUserData)
 	m_signature = computeSignature(this);
 	m_headerSize = getAlignedRoundUp(MAX_ALIGNMENT, sizeof(Signature));
 #endif
+
+	if(threadCache)
+	{
+		createThreadCache();
+	}
 }
 
 void* HeapMemoryPool::allocate(PtrSize size, PtrSize alignment)
 {
 	ANKI_ASSERT(isCreated());
+	return (m_threadCache) ? m_threadCache->allocate(size, alignment) : allocateInternal(size, alignment);
+}
+
+void HeapMemoryPool::free(void* ptr)
+{
+	ANKI_ASSERT(isCreated());
+	if(m_threadCache)
+	{
+		if(ptr)
+		{
+			m_threadCache->free(ptr);
+		}
+	}
+	else
+	{
+		freeInternal(ptr);
+	}
+}
+
+void* HeapMemoryPool::allocateInternal(PtrSize size, PtrSize alignment)
+{
 #if ANKI_MEM_SIGNATURES
 	ANKI_ASSERT(alignment <= MAX_ALIGNMENT && "Wrong assumption");
 	size += m_headerSize;
@@ -246,10 +780,8 @@ void* HeapMemoryPool::allocate(PtrSize size, PtrSize alignment)
 	return mem;
 }
 
-void HeapMemoryPool::free(void* ptr)
+void HeapMemoryPool::freeInternal(void* ptr)
 {
-	ANKI_ASSERT(isCreated());
-
 #if ANKI_MEM_SIGNATURES
 	U8* memU8 = static_cast<U8*>(ptr);
 	memU8 -= m_headerSize;
@@ -267,19 +799,25 @@ void HeapMemoryPool::free(void* ptr)
 StackMemoryPool::StackMemoryPool()
 	: BaseMemoryPool(Type::STACK)
 {
+	for(Atomic<Chunk*, AtomicMemoryOrder::SEQ_CST>& slot : m_chunks)
+	{
+		slot.set(nullptr);
+	}
 }
 
 StackMemoryPool::~StackMemoryPool()
 {
 	// Iterate all until you find an unused
-	for(Chunk& ch : m_chunks)
+	for(Atomic<Chunk*, AtomicMemoryOrder::SEQ_CST>& slot : m_chunks)
 	{
-		if(ch.m_baseMem != nullptr)
+		Chunk* ch = slot.load();
+		if(ch != nullptr)
 		{
-			ch.check();
+			ch->check();
 
-			invalidateMemory(ch.m_baseMem, ch.m_size);
-			m_allocCb(m_allocCbUserData, ch.m_baseMem, 0, 0);
+			invalidateMemory(ch->m_baseMem, ch->m_size);
+			ch->~Chunk();
+			m_allocCb(m_allocCbUserData, ch, 0, 0);
 		}
 		else
 		{
@@ -288,11 +826,21 @@ StackMemoryPool::~StackMemoryPool()
 	}
 
 	// Do some error checks
-	auto allocCount = m_allocationsCount.load();
+	auto allocCount = getAllocationsCountInternal();
 	if(!m_ignoreDeallocationErrors && allocCount != 0)
 	{
 		ANKI_UTIL_LOGW("Forgot to deallocate");
 	}
+
+	if(m_threadArenas)
+	{
+		for(U32 i = 0; i < MemoryPoolThreadId::MAX_IDS; ++i)
+		{
+			m_threadArenas[i].~ThreadArena();
+		}
+
+		m_allocCb(m_allocCbUserData, m_threadArenas, 0, 0);
+	}
 }
 
 void StackMemoryPool::create(AllocAlignedCallback allocCb,
@@ -301,13 +849,15 @@ void StackMemoryPool::create(AllocAlignedCallback allocCb,
 	F32 nextChunkScale,
 	PtrSize nextChunkBias,
 	Bool ignoreDeallocationErrors,
-	PtrSize alignmentBytes)
+	PtrSize alignmentBytes,
+	PtrSize threadArenaSize)
 {
 	ANKI_ASSERT(!isCreated());
 	ANKI_ASSERT(allocCb);
 	ANKI_ASSERT(initialChunkSize > 0);
 	ANKI_ASSERT(nextChunkScale >= 1.0);
 	ANKI_ASSERT(alignmentBytes > 0);
+	ANKI_ASSERT(threadArenaSize <= initialChunkSize);
 
 	m_allocCb = allocCb;
 	m_allocCbUserData = allocCbUserData;
@@ -318,113 +868,167 @@ void StackMemoryPool::create(AllocAlignedCallback allocCb,
 	m_ignoreDeallocationErrors = ignoreDeallocationErrors;
 
 	// Create the first chunk
-	void* mem = m_allocCb(m_allocCbUserData, nullptr, m_initialChunkSize, m_alignmentBytes);
-
-	if(mem != nullptr)
+	Chunk* ch = newChunk(m_initialChunkSize);
+	if(ch != nullptr)
 	{
-		invalidateMemory(mem, m_initialChunkSize);
-
-		m_chunks[0].m_baseMem = static_cast<U8*>(mem);
-		m_chunks[0].m_mem.store(m_chunks[0].m_baseMem);
-		m_chunks[0].m_size = initialChunkSize;
-
+		m_chunks[0].store(ch);
 		ANKI_ASSERT(m_crntChunkIdx.load() == 0);
 	}
 	else
 	{
 		ANKI_CREATION_OOM_ACTION();
 	}
+
+	// Create the thread arenas
+	if(threadArenaSize > 0)
+	{
+		m_threadArenaSize = getAlignedRoundUp(m_alignmentBytes, threadArenaSize);
+
+		m_threadArenas = static_cast<ThreadArena*>(m_allocCb(m_allocCbUserData,
+			nullptr,
+			sizeof(ThreadArena) * MemoryPoolThreadId::MAX_IDS,
+			alignof(ThreadArena)));
+		if(m_threadArenas == nullptr)
+		{
+			ANKI_CREATION_OOM_ACTION();
+		}
+
+		for(U32 i = 0; i < MemoryPoolThreadId::MAX_IDS; ++i)
+		{
+			::new(&m_threadArenas[i]) ThreadArena();
+		}
+	}
 }
 
-void* StackMemoryPool::allocate(PtrSize size, PtrSize alignment)
+StackMemoryPool::Chunk* StackMemoryPool::newChunk(PtrSize size)
 {
-	ANKI_ASSERT(isCreated());
-	ANKI_ASSERT(alignment <= m_alignmentBytes);
-	(void)alignment;
+	const PtrSize headerSize = getAlignedRoundUp(m_alignmentBytes, sizeof(Chunk));
+	void* mem = m_allocCb(m_allocCbUserData, nullptr, headerSize + size, max(m_alignmentBytes, alignof(Chunk)));
+	if(mem == nullptr)
+	{
+		return nullptr;
+	}
 
-	size = getAlignedRoundUp(m_alignmentBytes, size);
+	Chunk* ch = ::new(mem) Chunk();
+	ch->m_baseMem = static_cast<U8*>(mem) + headerSize;
+	ch->m_mem.store(ch->m_baseMem);
+	ch->m_size = size;
+	invalidateMemory(ch->m_baseMem, size);
+
+	return ch;
+}
+
+U8* StackMemoryPool::allocateFromChunks(PtrSize size)
+{
+	ANKI_ASSERT(isAligned(m_alignmentBytes, size));
 	ANKI_ASSERT(size > 0);
 	ANKI_ASSERT(size <= m_initialChunkSize && "The chunks should have enough space to hold at least one allocation");
 
-	Chunk* crntChunk = nullptr;
-	Bool retry = true;
-	U8* out = nullptr;
-
-	do
+	while(true)
 	{
-		crntChunk = &m_chunks[m_crntChunkIdx.load()];
+		const U32 crntChunkIdx = m_crntChunkIdx.load();
+		Chunk* crntChunk = m_chunks[crntChunkIdx].load();
 		crntChunk->check();
 
-		out = crntChunk->m_mem.fetchAdd(size);
+		U8* out = crntChunk->m_mem.fetchAdd(size);
 		ANKI_ASSERT(out >= crntChunk->m_baseMem);
 
 		if(PtrSize(out + size - crntChunk->m_baseMem) <= crntChunk->m_size)
 		{
 			// All is fine, there is enough space in the chunk
+			return out;
+		}
+
+		// Need new chunk. Every thread that gets here tries to move to the next chunk. If the next chunk doesn't exist
+		// they all create one and the first to install it wins. The rest throw theirs away
 
-			retry = false;
-			m_allocationsCount.fetchAdd(1);
+		const U32 nextChunkIdx = crntChunkIdx + 1;
+		if(nextChunkIdx >= MAX_CHUNKS)
+		{
+			ANKI_UTIL_LOGE("Number of chunks is not enough");
+			return nullptr;
 		}
-		else
+
+		if(m_chunks[nextChunkIdx].load() == nullptr)
 		{
-			// Need new chunk
+			PtrSize newChunkSize = crntChunk->m_size * m_nextChunkScale + m_nextChunkBias;
+			alignRoundUp(m_alignmentBytes, newChunkSize);
 
-			LockGuard<Mutex> lock(m_lock);
+			Chunk* ch = newChunk(newChunkSize);
+			if(ch == nullptr)
+			{
+				ANKI_OOM_ACTION();
+				return nullptr;
+			}
 
-			// Make sure that only one thread will create a new chunk
-			if(&m_chunks[m_crntChunkIdx.load()] == crntChunk)
+			Chunk* expected = nullptr;
+			if(!m_chunks[nextChunkIdx].compareExchange(expected, ch))
 			{
-				// We can create a new chunk
+				// Someone else was faster
+				ch->~Chunk();
+				m_allocCb(m_allocCbUserData, ch, 0, 0);
+			}
+		}
+		else
+		{
+			// Recycle the one that reset() left behind
+			m_chunks[nextChunkIdx].load()->check();
+		}
 
-				PtrSize oldChunkSize = crntChunk->m_size;
-				++crntChunk;
-				if(crntChunk >= m_chunks.getEnd())
-				{
-					ANKI_UTIL_LOGE("Number of chunks is not enough. Expect a crash");
-				}
+		// It will fail if someone else moved it
+		U32 expectedIdx = crntChunkIdx;
+		m_crntChunkIdx.compareExchange(expectedIdx, nextChunkIdx);
+	}
+}
 
-				if(crntChunk->m_baseMem == nullptr)
-				{
-					// Need to create a new chunk
-
-					PtrSize newChunkSize = oldChunkSize * m_nextChunkScale + m_nextChunkBias;
-					alignRoundUp(m_alignmentBytes, newChunkSize);
-
-					void* mem = m_allocCb(m_allocCbUserData, nullptr, newChunkSize, m_alignmentBytes);
-
-					if(mem != nullptr)
-					{
-						invalidateMemory(mem, newChunkSize);
-
-						crntChunk->m_baseMem = static_cast<U8*>(mem);
-						crntChunk->m_mem.store(crntChunk->m_baseMem);
-						crntChunk->m_size = newChunkSize;
-
-						U idx = m_crntChunkIdx.fetchAdd(1);
-						ANKI_ASSERT(&m_chunks[idx] == crntChunk - 1);
-						(void)idx;
-					}
-					else
-					{
-						out = nullptr;
-						retry = false;
-						ANKI_OOM_ACTION();
-					}
-				}
-				else
-				{
-					// Need to recycle one
+void* StackMemoryPool::allocate(PtrSize size, PtrSize alignment)
+{
+	ANKI_ASSERT(isCreated());
+	ANKI_ASSERT(alignment <= m_alignmentBytes);
+	(void)alignment;
+
+	size = getAlignedRoundUp(m_alignmentBytes, size);
+	ANKI_ASSERT(size > 0);
 
-					crntChunk->checkReset();
-					invalidateMemory(crntChunk->m_baseMem, crntChunk->m_size);
+	// Try the thread's arena first. Only small allocations go there so the arenas don't waste much
+	U32 threadId;
+	if(m_threadArenas && size <= m_threadArenaSize / 4 && (threadId = g_memoryPoolThreadId.get()) != MAX_U32)
+	{
+		ThreadArena& arena = m_threadArenas[threadId];
 
-					U idx = m_crntChunkIdx.fetchAdd(1);
-					ANKI_ASSERT(&m_chunks[idx] == crntChunk - 1);
-					(void)idx;
-				}
+		const U32 epoch = m_epoch.load();
+		if(ANKI_UNLIKELY(arena.m_epoch != epoch))
+		{
+			// The pool was reset after the arena got its block
+			arena.m_mem = nullptr;
+			arena.m_end = nullptr;
+			arena.m_epoch = epoch;
+		}
+
+		if(ANKI_UNLIKELY(PtrSize(arena.m_end - arena.m_mem) < size))
+		{
+			// Get a new block. What's left of the old one is lost until the next reset()
+			U8* block = allocateFromChunks(m_threadArenaSize);
+			if(block == nullptr)
+			{
+				return nullptr;
 			}
+
+			arena.m_mem = block;
+			arena.m_end = block + m_threadArenaSize;
 		}
-	} while(retry);
+
+		U8* out = arena.m_mem;
+		arena.m_mem += size;
+		arena.m_allocationCount.store(arena.m_allocationCount.load() + 1);
+		return static_cast<void*>(out);
+	}
+
+	U8* out = allocateFromChunks(size);
+	if(out != nullptr)
+	{
+		m_allocationsCount.fetchAdd(1);
+	}
 
 	return static_cast<void*>(out);
 }
@@ -437,9 +1041,17 @@ void StackMemoryPool::free(void* ptr)
 	// allocated by this class
 	ANKI_ASSERT(ptr != nullptr && isAligned(m_alignmentBytes, ptr));
 
-	auto count = m_allocationsCount.fetchSub(1);
-	ANKI_ASSERT(count > 0);
-	(void)count;
+	U32 threadId;
+	if(m_threadArenas && (threadId = g_memoryPoolThreadId.get()) != MAX_U32)
+	{
+		// Count it in the thread's arena. The sum of all the counters is what matters
+		ThreadArena& arena = m_threadArenas[threadId];
+		arena.m_freeCount.store(arena.m_freeCount.load() + 1);
+	}
+	else
+	{
+		m_allocationsCount.fetchSub(1);
+	}
 }
 
 void StackMemoryPool::reset()
@@ -447,14 +1059,15 @@ void StackMemoryPool::reset()
 	ANKI_ASSERT(isCreated());
 
 	// Iterate all until you find an unused
-	for(Chunk& ch : m_chunks)
+	for(Atomic<Chunk*, AtomicMemoryOrder::SEQ_CST>& slot : m_chunks)
 	{
-		if(ch.m_baseMem != nullptr)
+		Chunk* ch = slot.load();
+		if(ch != nullptr)
 		{
-			ch.check();
-			ch.m_mem.store(ch.m_baseMem);
+			ch->check();
+			ch->m_mem.store(ch->m_baseMem);
 
-			invalidateMemory(ch.m_baseMem, ch.m_size);
+			invalidateMemory(ch->m_baseMem, ch->m_size);
 		}
 		else
 		{
@@ -463,15 +1076,28 @@ void StackMemoryPool::reset()
 	}
 
 	// Set the crnt chunk
-	m_chunks[0].checkReset();
+	m_chunks[0].load()->checkReset();
 	m_crntChunkIdx.store(0);
 
 	// Reset allocation count and do some error checks
-	auto allocCount = m_allocationsCount.exchange(0);
+	auto allocCount = getAllocationsCountInternal();
 	if(!m_ignoreDeallocationErrors && allocCount != 0)
 	{
 		ANKI_UTIL_LOGW("Forgot to deallocate");
 	}
+
+	m_allocationsCount.store(0);
+	if(m_threadArenas)
+	{
+		for(U32 i = 0; i < MemoryPoolThreadId::MAX_IDS; ++i)
+		{
+			m_threadArenas[i].m_allocationCount.store(0);
+			m_threadArenas[i].m_freeCount.store(0);
+		}
+
+		// Invalidate the blocks of the arenas
+		m_epoch.fetchAdd(1);
+	}
 }
 
 PtrSize StackMemoryPool::getMemoryCapacity() const
@@ -480,12 +1106,27 @@ PtrSize StackMemoryPool::getMemoryCapacity() const
 	U crntChunkIdx = m_crntChunkIdx.load();
 	for(U i = 0; i <= crntChunkIdx; ++i)
 	{
-		sum += m_chunks[i].m_size;
+		sum += m_chunks[i].load()->m_size;
 	}
 
 	return sum;
 }
 
+U32 StackMemoryPool::getAllocationsCountInternal() const
+{
+	// The frees of a thread may not match its allocations so do the math in signed
+	I64 count = I32(m_allocationsCount.load());
+	if(m_threadArenas)
+	{
+		for(U32 i = 0; i < MemoryPoolThreadId::MAX_IDS; ++i)
+		{
+			count += I64(m_threadArenas[i].m_allocationCount.load()) - I64(m_threadArenas[i].m_freeCount.load());
+		}
+	}
+
+	return U32(count);
+}
+
 ChainMemoryPool::ChainMemoryPool()
 	: BaseMemoryPool(Type::CHAIN)
 {
@@ -493,6 +1134,8 @@ ChainMemoryPool::ChainMemoryPool()
 
 ChainMemoryPool::~ChainMemoryPool()
 {
+	destroyThreadCache();
+
 	if(m_allocationsCount.load() != 0)
 	{
 		ANKI_UTIL_LOGW("Memory pool destroyed before all memory being released");
@@ -519,7 +1162,8 @@ void ChainMemoryPool::create(AllocAlignedCallback allocCb,
 	PtrSize initialChunkSize,
 	F32 nextChunkScale,
 	PtrSize nextChunkBias,
-	PtrSize alignmentBytes)
+	PtrSize alignmentBytes,
+	Bool threadCache)
 {
 	ANKI_ASSERT(!isCreated());
 	ANKI_ASSERT(initialChunkSize > 0);
@@ -550,11 +1194,38 @@ void ChainMemoryPool::create(AllocAlignedCallback allocCb,
 	{
 		ANKI_ASSERT(0 && "Wrong arg");
 	}
+
+	if(threadCache)
+	{
+		ANKI_ASSERT(m_alignmentBytes <= 16 && "The cache returns memory aligned to 16");
+		createThreadCache();
+	}
 }
 
 void* ChainMemoryPool::allocate(PtrSize size, PtrSize alignment)
 {
 	ANKI_ASSERT(isCreated());
+	return (m_threadCache) ? m_threadCache->allocate(size, alignment) : allocateInternal(size, alignment);
+}
+
+void ChainMemoryPool::free(void* ptr)
+{
+	ANKI_ASSERT(isCreated());
+	if(m_threadCache)
+	{
+		if(ptr)
+		{
+			m_threadCache->free(ptr);
+		}
+	}
+	else
+	{
+		freeInternal(ptr);
+	}
+}
+
+void* ChainMemoryPool::allocateInternal(PtrSize size, PtrSize alignment)
+{
 
 	Chunk* ch;
 	void* mem = nullptr;
@@ -589,9 +1260,8 @@ void* ChainMemoryPool::allocate(PtrSize size, PtrSize alignment)
 	return mem;
 }
 
-void ChainMemoryPool::free(void* ptr)
+void ChainMemoryPool::freeInternal(void* ptr)
 {
-	ANKI_ASSERT(isCreated());
 	if(ANKI_UNLIKELY(ptr == nullptr))
 	{
 		return;
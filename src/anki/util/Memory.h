@@ -18,6 +18,7 @@ namespace anki
 
 // Forward
 class SpinLock;
+class MemoryPoolThreadCache;
 
 /// @addtogroup util_memory
 /// @{
@@ -49,9 +50,24 @@ using AllocationSignature = U32;
 ///         returns nullptr
 void* allocAligned(void* userData, void* ptr, PtrSize size, PtrSize alignment);
 
+/// Statistics of the thread cache of a HeapMemoryPool or ChainMemoryPool.
+class ThreadCacheStats
+{
+public:
+	U64 m_allocationCount = 0; ///< Small allocations.
+	U64 m_freeCount = 0; ///< Small frees.
+	U64 m_hitCount = 0; ///< Small allocations served by the thread's own cache.
+	U64 m_missCount = 0; ///< Small allocations that had to go to the shared lists or the backing pool.
+	U64 m_largeAllocationCount = 0; ///< Allocations that bypassed the cache.
+	PtrSize m_cachedMemory = 0; ///< The memory the cache got from the backing pool.
+	U32 m_threadCount = 0; ///< The number of threads that have a cache.
+};
+
 /// Generic memory pool. The base of HeapMemoryPool or StackMemoryPool or ChainMemoryPool.
 class BaseMemoryPool : public NonCopyable
 {
+	friend class MemoryPoolThreadCache;
+
 public:
 	/// Pool type.
 	enum class Type : U8
@@ -104,10 +120,10 @@ public:
 	}
 
 	/// Return number of allocations
-	U32 getAllocationsCount() const
-	{
-		return m_allocationsCount.load();
-	}
+	U32 getAllocationsCount() const;
+
+	/// Get the stats of the thread cache. It's zero if the pool doesn't have one.
+	ThreadCacheStats getThreadCacheStats() const;
 
 protected:
 	/// User allocation function.
@@ -119,6 +135,13 @@ protected:
 	/// Allocations count.
 	Atomic<U32> m_allocationsCount = {0};
 
+	/// Optional thread-local front-end.
+	MemoryPoolThreadCache* m_threadCache = nullptr;
+
+	void createThreadCache();
+
+	void destroyThreadCache();
+
 	/// Check if already created.
 	Bool isCreated() const;
 
@@ -134,6 +157,8 @@ private:
 /// allocator template.
 class HeapMemoryPool : public BaseMemoryPool
 {
+	friend class MemoryPoolThreadCache;
+
 public:
 	/// Default constructor.
 	HeapMemoryPool();
@@ -144,7 +169,9 @@ public:
 	/// The real constructor.
 	/// @param allocCb The allocation function callback
 	/// @param allocCbUserData The user data to pass to the allocation function
-	void create(AllocAlignedCallback allocCb, void* allocCbUserData);
+	/// @param threadCache Put a thread-local cache of small blocks in front of the pool. The cache keeps the memory
+	///        it gets until the pool is destroyed.
+	void create(AllocAlignedCallback allocCb, void* allocCbUserData, Bool threadCache = false);
 
 	/// Allocate memory
 	void* allocate(PtrSize size, PtrSize alignment);
@@ -154,6 +181,10 @@ public:
 	void free(void* ptr);
 
 private:
+	void* allocateInternal(PtrSize size, PtrSize alignment);
+
+	void freeInternal(void* ptr);
+
 #if ANKI_MEM_USE_SIGNATURES
 	AllocationSignature m_signature = 0;
 	static const U32 MAX_ALIGNMENT = 64;
@@ -165,6 +196,8 @@ private:
 /// preallocated memory. It is mainly used by fast stack allocators
 class StackMemoryPool : public BaseMemoryPool
 {
+	friend class BaseMemoryPool;
+
 public:
 	/// The type of the pool's snapshot
 	using Snapshot = void*;
@@ -184,15 +217,18 @@ public:
 	/// @param ignoreDeallocationErrors Method free() may fail if the ptr is not in the top of the stack. Set that to
 	///        true to suppress such errors
 	/// @param alignmentBytes The maximum supported alignment for returned memory
+	/// @param threadArenaSize If it's not zero every thread carves blocks of that size from the pool and serves the
+	///        small allocations from them without touching any shared state.
 	void create(AllocAlignedCallback allocCb,
 		void* allocCbUserData,
 		PtrSize initialChunkSize,
 		F32 nextChunkScale = 2.0,
 		PtrSize nextChunkBias = 0,
 		Bool ignoreDeallocationErrors = true,
-		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT);
+		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT,
+		PtrSize threadArenaSize = 0);
 
-	/// Allocate aligned memory. The operation is thread safe
+	/// Allocate aligned memory. The operation is thread safe and lock-free
 	/// @param size The size to allocate
 	/// @param alignmentBytes The alignment of the returned address
 	/// @return The allocated memory or nullptr on failure
@@ -202,14 +238,15 @@ public:
 	/// @param[in, out] ptr Memory block to deallocate
 	void free(void* ptr);
 
-	/// Reinit the pool. All existing allocated memory will be lost
+	/// Reinit the pool. All existing allocated memory will be lost. It's not thread safe.
 	void reset();
 
 	/// Get the current capacity of the pool. It's not thread safe.
 	PtrSize getMemoryCapacity() const;
 
 private:
-	/// The memory chunk.
+	/// The memory chunk. It lives at the start of the memory it describes. It's fully initialized before it becomes
+	/// visible to other threads so they can grab it without locking.
 	class Chunk
 	{
 	public:
@@ -239,6 +276,19 @@ private:
 		}
 	};
 
+	/// A block of the pool that only one thread allocates from.
+	class alignas(ANKI_CACHE_LINE_SIZE) ThreadArena
+	{
+	public:
+		U8* m_mem = nullptr;
+		U8* m_end = nullptr;
+		U32 m_epoch = 0; ///< If it's not the pool's epoch the block is gone.
+
+		// Only the owner thread writes them so they don't need atomic operations, only atomic loads and stores
+		Atomic<U32> m_allocationCount = {0};
+		Atomic<U32> m_freeCount = {0};
+	};
+
 	/// Alignment of allocations
 	PtrSize m_alignmentBytes = 0;
 
@@ -261,16 +311,30 @@ private:
 	/// The max number of chunks.
 	static const U MAX_CHUNKS = 256;
 
-	/// The chunks.
-	Array<Chunk, MAX_CHUNKS> m_chunks;
+	/// The chunks. A thread that finds the current chunk full installs the next one with a CAS.
+	Array<Atomic<Chunk*, AtomicMemoryOrder::SEQ_CST>, MAX_CHUNKS> m_chunks;
+
+	/// The per-thread blocks. Indexed by the same thread IDs the thread caches use.
+	ThreadArena* m_threadArenas = nullptr;
+	PtrSize m_threadArenaSize = 0;
 
-	/// Protect the m_crntChunkIdx.
-	Mutex m_lock;
+	/// Bumped by reset() to invalidate the thread arenas.
+	Atomic<U32> m_epoch = {1};
+
+	/// Allocate from the chunks.
+	U8* allocateFromChunks(PtrSize size);
+
+	/// Allocate a new chunk.
+	Chunk* newChunk(PtrSize size);
+
+	U32 getAllocationsCountInternal() const;
 };
 
 /// Chain memory pool. Almost similar to StackMemoryPool but more flexible and at the same time a bit slower.
 class ChainMemoryPool : public BaseMemoryPool
 {
+	friend class MemoryPoolThreadCache;
+
 public:
 	/// Default constructor
 	ChainMemoryPool();
@@ -285,12 +349,14 @@ public:
 	/// @param nextChunkScale Value that controls the next chunk.
 	/// @param nextChunkBias Value that controls the next chunk.
 	/// @param alignmentBytes The maximum supported alignment for returned memory.
+	/// @param threadCache Put a thread-local cache of small blocks in front of the pool. See HeapMemoryPool::create.
 	void create(AllocAlignedCallback allocCb,
 		void* allocCbUserData,
 		PtrSize initialChunkSize,
 		F32 nextChunkScale = 2.0,
 		PtrSize nextChunkBias = 0,
-		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT);
+		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT,
+		Bool threadCache = false);
 
 	/// Allocate memory. This operation is thread safe
 	/// @param size The size to allocate
@@ -357,6 +423,10 @@ private:
 	/// Cache a value.
 	PtrSize m_headerSize = 0;
 
+	void* allocateInternal(PtrSize size, PtrSize alignment);
+
+	void freeInternal(void* ptr);
+
 	/// Compute the size for the next chunk.
 	/// @param size The current allocation size.
 	PtrSize computeNewChunkSize(PtrSize size) const;
@@ -0,0 +1,199 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/util/WeakArray.h>
+#include <anki/util/Array.h>
+#include <cstring>
+
+namespace anki
+{
+
+/// @addtogroup util_other
+/// @{
+
+/// Sort with a stable LSD radix sort of 8bit digits. A pass is skipped if all the keys have the same digit so the keys
+/// that use only their low bits need fewer passes.
+/// @param[in,out] elements The elements to sort.
+/// @param scratch Memory for @a count elements. The passes ping-pong between it and @a elements.
+/// @param getKey A functor with signature U64(const T&).
+/// @return Points to @a elements or @a scratch, whichever has the sorted elements.
+template<typename T, typename TGetKey>
+T* radixSort(T* elements, T* scratch, PtrSize count, TGetKey getKey)
+{
+	const U DIGIT_COUNT = sizeof(U64);
+
+	if(count < 2)
+	{
+		return elements;
+	}
+
+	// Count the digits of all the passes at once
+	Array2d<PtrSize, DIGIT_COUNT, 256> histograms;
+	memset(&histograms[0][0], 0, sizeof(histograms));
+	for(PtrSize i = 0; i < count; ++i)
+	{
+		const U64 key = getKey(elements[i]);
+		for(U digit = 0; digit < DIGIT_COUNT; ++digit)
+		{
+			++histograms[digit][(key >> (digit * 8)) & 0xFF];
+		}
+	}
+
+	T* in = elements;
+	T* out = scratch;
+	for(U digit = 0; digit < DIGIT_COUNT; ++digit)
+	{
+		const U shift = digit * 8;
+		Array<PtrSize, 256>& histogram = histograms[digit];
+
+		// Nothing to do if all keys have the same digit
+		if(histogram[(getKey(in[0]) >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// Histogram to offsets
+		PtrSize offset = 0;
+		for(PtrSize& bucket : histogram)
+		{
+			const PtrSize bucketCount = bucket;
+			bucket = offset;
+			offset += bucketCount;
+		}
+
+		for(PtrSize i = 0; i < count; ++i)
+		{
+			out[histogram[(getKey(in[i]) >> shift) & 0xFF]++] = in[i];
+		}
+
+		std::swap(in, out);
+	}
+
+	return in;
+}
+
+/// The key of an element and its index. Used by radixSortIndirect().
+class RadixSortKeyIndex
+{
+public:
+	U64 m_key;
+	U32 m_idx;
+};
+
+/// Radix sort elements that are too big to move in every pass. It sorts the keys with the indices of the elements and
+/// then it moves every element once.
+/// @param[in] elements The elements to sort.
+/// @param[out] out Memory for the sorted elements.
+/// @param count The number of elements. Up to MAX_U32.
+/// @param scratch Memory for 2 * @a count RadixSortKeyIndex.
+/// @param getKey A functor with signature U64(const T&).
+template<typename T, typename TGetKey>
+void radixSortIndirect(const T* elements, T* out, PtrSize count, RadixSortKeyIndex* scratch, TGetKey getKey)
+{
+	ANKI_ASSERT(count <= MAX_U32);
+	for(PtrSize i = 0; i < count; ++i)
+	{
+		scratch[i].m_key = getKey(elements[i]);
+		scratch[i].m_idx = U32(i);
+	}
+
+	const RadixSortKeyIndex* sorted =
+		radixSort(scratch, scratch + count, count, [](const RadixSortKeyIndex& k) { return k.m_key; });
+
+	for(PtrSize i = 0; i < count; ++i)
+	{
+		out[i] = elements[sorted[i].m_idx];
+	}
+}
+
+/// Merge runs that are sorted on the same keys. The equal keys keep the order of the runs.
+/// @param runs The sorted runs. Up to 64.
+/// @param[out] out Memory for the elements of all runs.
+/// @param getKey A functor with signature U64(const T&).
+template<typename T, typename TGetKey>
+void mergeSortedRuns(ConstWeakArray<ConstWeakArray<T>> runs, T* out, TGetKey getKey)
+{
+	// A binary min-heap with the first element of every run
+	class Head
+	{
+	public:
+		U64 m_key;
+		U32 m_run;
+		U32 m_idx;
+
+		Bool operator<(const Head& b) const
+		{
+			return m_key < b.m_key || (m_key == b.m_key && m_run < b.m_run);
+		}
+	};
+
+	Array<Head, 64> heapStorage;
+	Head* heap = &heapStorage[0];
+	U32 heapSize = 0;
+	ANKI_ASSERT(runs.getSize() <= heapStorage.getSize());
+
+	auto siftDown = [&](U32 i) {
+		const Head head = heap[i];
+		while(true)
+		{
+			U32 child = 2 * i + 1;
+			if(child >= heapSize)
+			{
+				break;
+			}
+
+			if(child + 1 < heapSize && heap[child + 1] < heap[child])
+			{
+				++child;
+			}
+
+			if(!(heap[child] < head))
+			{
+				break;
+			}
+
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = head;
+	};
+
+	for(U32 run = 0; run < runs.getSize(); ++run)
+	{
+		if(runs[run].getSize())
+		{
+			heap[heapSize++] = Head{getKey(runs[run][0]), run, 0};
+		}
+	}
+
+	for(U32 i = heapSize / 2; i > 0; --i)
+	{
+		siftDown(i - 1);
+	}
+
+	// Pop the smallest and replace it with the next of the same run
+	while(heapSize)
+	{
+		Head& top = heap[0];
+		const ConstWeakArray<T>& run = runs[top.m_run];
+		*out++ = run[top.m_idx++];
+
+		if(top.m_idx < run.getSize())
+		{
+			top.m_key = getKey(run[top.m_idx]);
+		}
+		else
+		{
+			top = heap[--heapSize];
+		}
+
+		siftDown(0);
+	}
+}
+/// @}
+
+} // end namespace anki
@@ -18,30 +18,206 @@ namespace anki
 #	define ANKI_HIVE_DEBUG_PRINT(...) ((void)0)
 #endif
 
+/// Spin a few times before going to sleep when the work-stealing scheduler runs out of work.
+static const U WS_SPIN_COUNT = 64;
+
+/// Special value for ThreadHiveSemaphore::m_waitingTasks that indicates that the semaphore has reached zero.
+static const PtrSize WS_SEMAPHORE_SIGNALED = MAX_PTR_SIZE;
+
+/// A Chase-Lev deque. The owner thread pushes and pops from the bottom and the other threads steal from the top.
+class ThreadHive::TaskDeque : public NonCopyable
+{
+public:
+	TaskDeque(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+		m_buffer.store(newBuffer(INITIAL_CAPACITY));
+	}
+
+	~TaskDeque()
+	{
+		Buffer* buff = m_buffer.load();
+		while(buff)
+		{
+			Buffer* prev = buff->m_prevBuffer;
+			m_alloc.deallocate(buff, 0);
+			buff = prev;
+		}
+	}
+
+	/// Push to the bottom. Only the owner can call this.
+	void push(Task* task)
+	{
+		const I64 b = m_bottom.load(AtomicMemoryOrder::RELAXED);
+		const I64 t = m_top.load(AtomicMemoryOrder::ACQUIRE);
+		Buffer* buff = m_buffer.load(AtomicMemoryOrder::RELAXED);
+
+		if(b - t > buff->m_capacity - 1)
+		{
+			buff = grow(buff, t, b);
+		}
+
+		buff->getElement(b).store(task, AtomicMemoryOrder::RELAXED);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(b + 1, AtomicMemoryOrder::RELAXED);
+	}
+
+	/// Pop from the bottom. Only the owner can call this.
+	Task* pop()
+	{
+		const I64 b = m_bottom.load(AtomicMemoryOrder::RELAXED) - 1;
+		Buffer* buff = m_buffer.load(AtomicMemoryOrder::RELAXED);
+		m_bottom.store(b, AtomicMemoryOrder::RELAXED);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		I64 t = m_top.load(AtomicMemoryOrder::RELAXED);
+
+		Task* task = nullptr;
+		if(t <= b)
+		{
+			task = buff->getElement(b).load(AtomicMemoryOrder::RELAXED);
+
+			if(t == b)
+			{
+				// Last element, race against the thieves
+				const I64 expected = t;
+				while(!m_top.compareExchange(t, t + 1, AtomicMemoryOrder::SEQ_CST))
+				{
+					if(t != expected)
+					{
+						// Lost the race
+						task = nullptr;
+						break;
+					}
+				}
+
+				m_bottom.store(b + 1, AtomicMemoryOrder::RELAXED);
+			}
+		}
+		else
+		{
+			// Empty
+			m_bottom.store(b + 1, AtomicMemoryOrder::RELAXED);
+		}
+
+		return task;
+	}
+
+	/// Steal from the top. Any thread can call this. It may fail if there is contention.
+	Task* steal()
+	{
+		I64 t = m_top.load(AtomicMemoryOrder::ACQUIRE);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const I64 b = m_bottom.load(AtomicMemoryOrder::ACQUIRE);
+
+		Task* task = nullptr;
+		if(t < b)
+		{
+			Buffer* buff = m_buffer.load(AtomicMemoryOrder::ACQUIRE);
+			task = buff->getElement(t).load(AtomicMemoryOrder::RELAXED);
+
+			if(!m_top.compareExchange(t, t + 1, AtomicMemoryOrder::SEQ_CST))
+			{
+				task = nullptr;
+			}
+		}
+
+		return task;
+	}
+
+private:
+	static const I64 INITIAL_CAPACITY = 256;
+
+	/// A circular buffer. Old buffers are kept alive until the deque dies because thieves might still read them.
+	class Buffer
+	{
+	public:
+		I64 m_capacity;
+		Buffer* m_prevBuffer;
+
+		Atomic<Task*>& getElement(I64 idx)
+		{
+			Atomic<Task*>* elements = reinterpret_cast<Atomic<Task*>*>(this + 1);
+			return elements[idx & (m_capacity - 1)];
+		}
+	};
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	Atomic<I64> m_top = {0};
+	Atomic<I64> m_bottom = {0};
+	Atomic<Buffer*> m_buffer;
+
+	Buffer* newBuffer(I64 capacity)
+	{
+		ANKI_ASSERT(isPowerOfTwo(capacity));
+		const PtrSize size = sizeof(Buffer) + sizeof(Atomic<Task*>) * capacity;
+		Buffer* buff = reinterpret_cast<Buffer*>(m_alloc.allocate(size, U32(alignof(Buffer))));
+		memset(buff, 0, size);
+		buff->m_capacity = capacity;
+		return buff;
+	}
+
+	Buffer* grow(Buffer* oldBuff, I64 top, I64 bottom)
+	{
+		Buffer* buff = newBuffer(oldBuff->m_capacity * 2);
+		buff->m_prevBuffer = oldBuff;
+
+		for(I64 i = top; i < bottom; ++i)
+		{
+			buff->getElement(i).store(oldBuff->getElement(i).load());
+		}
+
+		m_buffer.store(buff, AtomicMemoryOrder::RELEASE);
+		return buff;
+	}
+};
+
 class ThreadHive::Thread
 {
 public:
 	U32 m_id; ///< An ID
 	anki::Thread m_thread; ///< Runs the workingFunc
 	ThreadHive* m_hive;
+	TaskDeque* m_deque = nullptr; ///< Only in work-stealing mode.
+	U32 m_randomSeed; ///< Used to pick victims in work-stealing mode.
 
 	/// Constructor
-	Thread(U32 id, ThreadHive* hive, Bool pinToCores)
+	Thread(U32 id, ThreadHive* hive)
 		: m_id(id)
 		, m_thread("anki_threadhive")
 		, m_hive(hive)
+		, m_randomSeed(id * 2654435761u + 1u)
 	{
 		ANKI_ASSERT(hive);
+	}
+
+	void start(Bool pinToCores)
+	{
 		m_thread.start(this, threadCallback, (pinToCores) ? I(m_id) : -1);
 	}
 
+	/// Xorshift.
+	U32 nextRandom()
+	{
+		m_randomSeed ^= m_randomSeed << 13u;
+		m_randomSeed ^= m_randomSeed >> 17u;
+		m_randomSeed ^= m_randomSeed << 5u;
+		return m_randomSeed;
+	}
+
 private:
 	/// Thread callaback
 	static Error threadCallback(anki::ThreadCallbackInfo& info)
 	{
 		Thread& self = *static_cast<Thread*>(info.m_userData);
 
-		self.m_hive->threadRun(self.m_id);
+		if(self.m_hive->m_workStealing)
+		{
+			self.m_hive->threadRunWorkStealing(self.m_id);
+		}
+		else
+		{
+			self.m_hive->threadRun(self.m_id);
+		}
 		return Error::NONE;
 	}
 };
@@ -58,17 +234,31 @@ public:
 	ThreadHiveSemaphore* m_signalSemaphore;
 };
 
-ThreadHive::ThreadHive(U threadCount, GenericMemoryPoolAllocator<U8> alloc, Bool pinToCores)
+thread_local ThreadHive::Thread* ThreadHive::m_currentThread = nullptr;
+
+ThreadHive::ThreadHive(U threadCount, GenericMemoryPoolAllocator<U8> alloc, Bool pinToCores, Bool workStealing)
 	: m_slowAlloc(alloc)
 	, m_alloc(alloc.getMemoryPool().getAllocationCallback(),
 		  alloc.getMemoryPool().getAllocationCallbackUserData(),
 		  1024 * 4)
 	, m_threadCount(threadCount)
+	, m_workStealing(workStealing)
 {
 	m_threads = reinterpret_cast<Thread*>(m_slowAlloc.allocate(sizeof(Thread) * threadCount));
 	for(U i = 0; i < threadCount; ++i)
 	{
-		::new(&m_threads[i]) Thread(i, this, pinToCores);
+		::new(&m_threads[i]) Thread(i, this);
+
+		if(workStealing)
+		{
+			m_threads[i].m_deque = m_slowAlloc.newInstance<TaskDeque>(m_slowAlloc);
+		}
+	}
+
+	// Start the threads after all of them are created because in work-stealing mode they access each other's deques
+	for(U i = 0; i < threadCount; ++i)
+	{
+		m_threads[i].start(pinToCores);
 	}
 }
 
@@ -90,7 +280,13 @@ ThreadHive::~ThreadHive()
 		{
 			Error err = m_threads[threadCount].m_thread.join();
 			(void)err;
-			m_threads[threadCount].~Thread();
+		}
+
+		// Destroy after all threads are joined because thieves might be touching other deques
+		for(U i = 0; i < m_threadCount; ++i)
+		{
+			m_slowAlloc.deleteInstance(m_threads[i].m_deque);
+			m_threads[i].~Thread();
 		}
 
 		m_slowAlloc.deallocate(static_cast<void*>(m_threads), m_threadCount * sizeof(Thread));
@@ -125,6 +321,12 @@ void ThreadHive::submitTasks(ThreadHiveTask* tasks, const U taskCount)
 		prevTask = &outTask;
 	}
 
+	if(m_workStealing)
+	{
+		submitTasksWorkStealing(htasks, taskCount);
+		return;
+	}
+
 	// Push work
 	{
 		LockGuard<Mutex> lock(m_mtx);
@@ -254,6 +456,12 @@ void ThreadHive::waitAllTasks()
 {
 	ANKI_HIVE_DEBUG_PRINT("mt: waiting all\n");
 
+	if(m_workStealing)
+	{
+		waitAllTasksWorkStealing();
+		return;
+	}
+
 	LockGuard<Mutex> lock(m_mtx);
 	while(m_pendingTasks > 0)
 	{
@@ -267,4 +475,210 @@ void ThreadHive::waitAllTasks()
 	ANKI_HIVE_DEBUG_PRINT("mt: done waiting all\n");
 }
 
+void ThreadHive::submitTasksWorkStealing(Task* tasks, U taskCount)
+{
+	m_wsPendingTasks.fetchAdd(taskCount);
+
+	// If the caller is one of our threads push to its deque, else inject
+	Thread* thread = (m_currentThread && m_currentThread->m_hive == this) ? m_currentThread : nullptr;
+
+	for(U i = 0; i < taskCount; ++i)
+	{
+		pushTask(thread, &tasks[i]);
+	}
+
+	ANKI_HIVE_DEBUG_PRINT("submit tasks\n");
+}
+
+void ThreadHive::pushTask(Thread* thread, Task* task)
+{
+	if(task->m_waitSemaphore)
+	{
+		// Try to park it to the semaphore
+		Atomic<PtrSize, AtomicMemoryOrder::SEQ_CST>& waitingTasks = task->m_waitSemaphore->m_waitingTasks;
+		PtrSize head = waitingTasks.load();
+		while(head != WS_SEMAPHORE_SIGNALED)
+		{
+			task->m_next = numberToPtr<Task*>(head);
+			if(waitingTasks.compareExchange(head, ptrToNumber(task)))
+			{
+				// Parked, the thread that will signal the semaphore will make it ready
+				return;
+			}
+		}
+	}
+
+	pushReadyTask(thread, task);
+}
+
+void ThreadHive::pushReadyTask(Thread* thread, Task* task)
+{
+	// Count it before it becomes visible to the thieves
+	m_wsReadyTasks.fetchAdd(1);
+
+	if(thread)
+	{
+		thread->m_deque->push(task);
+	}
+	else
+	{
+		PtrSize head = m_injectedTasks.load();
+		do
+		{
+			task->m_next = numberToPtr<Task*>(head);
+		} while(!m_injectedTasks.compareExchange(head, ptrToNumber(task)));
+	}
+
+	if(m_wsSleepingThreads.load() > 0)
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		m_cvar.notifyOne();
+	}
+}
+
+ThreadHive::Task* ThreadHive::findTaskWorkStealing(Thread& thread)
+{
+	// First try the local deque
+	Task* task = thread.m_deque->pop();
+
+	// Then the tasks submitted from the outside. Take all of them and move the rest to the local deque
+	if(task == nullptr && m_injectedTasks.load() != 0)
+	{
+		task = numberToPtr<Task*>(m_injectedTasks.exchange(0));
+		if(task)
+		{
+			Task* other = task->m_next;
+			while(other)
+			{
+				Task* next = other->m_next;
+				thread.m_deque->push(other);
+				other = next;
+			}
+		}
+	}
+
+	// Then steal from random victims
+	if(task == nullptr && m_threadCount > 1)
+	{
+		for(U i = 0; i < m_threadCount && task == nullptr; ++i)
+		{
+			const U victim = thread.nextRandom() % m_threadCount;
+			if(victim != thread.m_id)
+			{
+				task = m_threads[victim].m_deque->steal();
+			}
+		}
+	}
+
+	if(task)
+	{
+		const U32 prevReady = m_wsReadyTasks.fetchSub(1);
+		(void)prevReady;
+		ANKI_ASSERT(prevReady > 0);
+	}
+
+	return task;
+}
+
+void ThreadHive::threadRunWorkStealing(U threadId)
+{
+	Thread& thread = m_threads[threadId];
+	m_currentThread = &thread;
+
+	U spinCount = 0;
+	while(true)
+	{
+		Task* task = findTaskWorkStealing(thread);
+
+		if(task == nullptr)
+		{
+			if(++spinCount < WS_SPIN_COUNT)
+			{
+				continue;
+			}
+
+			spinCount = 0;
+			if(sleepWorkStealing())
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		spinCount = 0;
+
+		// Run the task
+		ANKI_ASSERT(task->m_cb);
+		ANKI_HIVE_DEBUG_PRINT(
+			"tid: %lu will exec %p (udata: %p)\n", threadId, static_cast<void*>(task), static_cast<void*>(task->m_arg));
+		task->m_cb(task->m_arg, threadId, *this, task->m_signalSemaphore);
+
+#if ANKI_EXTRA_CHECKS
+		task->m_cb = nullptr;
+#endif
+
+		// Signal the semaphore and release the tasks that wait on it
+		if(task->m_signalSemaphore)
+		{
+			ThreadHiveSemaphore& sem = *task->m_signalSemaphore;
+			const U32 out = sem.m_atomic.fetchSub(1, AtomicMemoryOrder::ACQ_REL);
+			ANKI_ASSERT(out > 0u);
+
+			if(out == 1)
+			{
+				Task* waiting = numberToPtr<Task*>(sem.m_waitingTasks.exchange(WS_SEMAPHORE_SIGNALED));
+				ANKI_ASSERT(ptrToNumber(waiting) != WS_SEMAPHORE_SIGNALED && "Semaphore reached zero twice");
+
+				while(waiting)
+				{
+					Task* next = waiting->m_next;
+					pushReadyTask(&thread, waiting);
+					waiting = next;
+				}
+			}
+		}
+
+		// Complete the task
+		if(m_wsPendingTasks.fetchSub(1) == 1)
+		{
+			LockGuard<Mutex> lock(m_mtx);
+			m_wsDoneCvar.notifyAll();
+		}
+	}
+
+	m_currentThread = nullptr;
+	ANKI_HIVE_DEBUG_PRINT("tid: %lu thread quits!\n", threadId);
+}
+
+Bool ThreadHive::sleepWorkStealing()
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	m_wsSleepingThreads.fetchAdd(1);
+	while(!m_quit && m_wsReadyTasks.load() == 0)
+	{
+		m_cvar.wait(m_mtx);
+	}
+	m_wsSleepingThreads.fetchSub(1);
+
+	return m_quit;
+}
+
+void ThreadHive::waitAllTasksWorkStealing()
+{
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		while(m_wsPendingTasks.load() > 0)
+		{
+			m_wsDoneCvar.wait(m_mtx);
+		}
+	}
+
+	ANKI_ASSERT(m_wsReadyTasks.load() == 0 && m_injectedTasks.load() == 0);
+	m_alloc.getMemoryPool().reset();
+
+	ANKI_HIVE_DEBUG_PRINT("mt: done waiting all\n");
+}
+
 } // end namespace anki
@@ -8,6 +8,7 @@
 #include <anki/util/Thread.h>
 #include <anki/util/WeakArray.h>
 #include <anki/util/Allocator.h>
+#include <anki/util/Tracer.h>
 
 namespace anki
 {
@@ -26,6 +27,7 @@ class ThreadHiveSemaphore
 public:
 	/// Increase the value of the semaphore. It's easy to brake things with that.
 	/// @note It's thread-safe.
+	/// @note In work-stealing mode the semaphore shouldn't be increased after it reached zero.
 	void increaseSemaphore(U32 increase)
 	{
 		m_atomic.fetchAdd(increase);
@@ -34,6 +36,10 @@ public:
 private:
 	Atomic<U32> m_atomic;
 
+	/// Intrusive list of tasks waiting on this semaphore. Used only in work-stealing mode. It's a pointer to the first
+	/// task or a special value if the semaphore has reached zero.
+	Atomic<PtrSize, AtomicMemoryOrder::SEQ_CST> m_waitingTasks;
+
 	// No need to construct it or delete it
 	ThreadHiveSemaphore() = delete;
 	~ThreadHiveSemaphore() = delete;
@@ -62,6 +68,15 @@ public:
 	ThreadHiveSemaphore* m_signalSemaphore = nullptr;
 };
 
+/// Callbacks that the ThreadHive helpers use to report the timings of their tasks. @memberof ThreadHive
+class ThreadHiveTraceCallbacks
+{
+public:
+	TracerEventHandle (*m_beginEvent)(void* userData) = nullptr;
+	void (*m_endEvent)(void* userData, const char* eventName, TracerEventHandle event) = nullptr;
+	void* m_userData = nullptr;
+};
+
 /// Initialize a ThreadHiveTask.
 #define ANKI_THREAD_HIVE_TASK(callback_, argument_, waitSemaphore_, signalSemaphore_) \
 	{ \
@@ -75,13 +90,22 @@ public:
 
 /// A scheduler of small tasks. It takes a number of tasks and schedules them in one of the threads. The tasks can
 /// depend on previously submitted tasks or be completely independent.
+///
+/// It has two scheduling modes. The default one keeps a single global queue protected by a mutex. The work-stealing
+/// mode gives each thread a lock-free deque. Tasks submitted from a hive thread are pushed to its own deque, idle
+/// threads steal from random victims and tasks with pending dependencies are parked in their wait semaphore until it
+/// reaches zero.
 class ThreadHive : public NonCopyable
 {
 public:
 	static const U MAX_THREADS = 32;
 
 	/// Create the hive.
-	ThreadHive(U threadCount, GenericMemoryPoolAllocator<U8> alloc, Bool pinToCores = false);
+	/// @param threadCount The number of worker threads.
+	/// @param alloc The allocator for the internal structures.
+	/// @param pinToCores Pin each thread to a core.
+	/// @param workStealing Use the work-stealing scheduler instead of the global queue.
+	ThreadHive(U threadCount, GenericMemoryPoolAllocator<U8> alloc, Bool pinToCores = false, Bool workStealing = false);
 
 	~ThreadHive();
 
@@ -90,6 +114,11 @@ public:
 		return m_threadCount;
 	}
 
+	Bool isWorkStealing() const
+	{
+		return m_workStealing;
+	}
+
 	/// Create a new semaphore with some initial value.
 	/// @param initialValue  Can't be zero.
 	ThreadHiveSemaphore* newSemaphore(const U32 initialValue)
@@ -99,6 +128,7 @@ public:
 		ThreadHiveSemaphore* sem =
 			reinterpret_cast<ThreadHiveSemaphore*>(m_alloc.allocate(sizeof(ThreadHiveSemaphore), &alignment));
 		sem->m_atomic.set(initialValue);
+		sem->m_waitingTasks.set(0);
 		return sem;
 	}
 
@@ -129,16 +159,43 @@ public:
 	/// Wait for all tasks to finish. Will block.
 	void waitAllTasks();
 
+	/// Set the callbacks that will be used to trace tasks. Don't call it while there are tasks in flight.
+	void setTraceCallbacks(const ThreadHiveTraceCallbacks& callbacks)
+	{
+		ANKI_ASSERT(!!callbacks.m_beginEvent == !!callbacks.m_endEvent);
+		m_traceCallbacks = callbacks;
+	}
+
+	/// Begin a trace event using the ThreadHiveTraceCallbacks.
+	ANKI_USE_RESULT TracerEventHandle beginTraceEvent()
+	{
+		return (m_traceCallbacks.m_beginEvent) ? m_traceCallbacks.m_beginEvent(m_traceCallbacks.m_userData) : nullptr;
+	}
+
+	/// End a trace event that got started with beginTraceEvent().
+	void endTraceEvent(const char* eventName, TracerEventHandle event)
+	{
+		if(m_traceCallbacks.m_endEvent)
+		{
+			m_traceCallbacks.m_endEvent(m_traceCallbacks.m_userData, eventName, event);
+		}
+	}
+
 private:
 	class Thread;
 
 	/// Lightweight task.
 	class Task;
 
+	/// Lock-free work-stealing deque.
+	class TaskDeque;
+
 	GenericMemoryPoolAllocator<U8> m_slowAlloc;
 	StackAllocator<U8> m_alloc;
 	Thread* m_threads = nullptr;
 	U32 m_threadCount = 0;
+	Bool m_workStealing = false;
+	ThreadHiveTraceCallbacks m_traceCallbacks;
 
 	Task* m_head = nullptr; ///< Head of the task list.
 	Task* m_tail = nullptr; ///< Tail of the task list.
@@ -148,6 +205,17 @@ private:
 	Mutex m_mtx;
 	ConditionVariable m_cvar;
 
+	/// @name Work-stealing members
+	/// @{
+	Atomic<PtrSize, AtomicMemoryOrder::SEQ_CST> m_injectedTasks = {0}; ///< Tasks submitted from non-hive threads.
+	Atomic<U32, AtomicMemoryOrder::SEQ_CST> m_wsPendingTasks = {0}; ///< Tasks submitted but not completed.
+	Atomic<U32, AtomicMemoryOrder::SEQ_CST> m_wsReadyTasks = {0}; ///< Tasks that can run right now.
+	Atomic<U32, AtomicMemoryOrder::SEQ_CST> m_wsSleepingThreads = {0};
+	ConditionVariable m_wsDoneCvar; ///< Used to wake the waitAllTasks().
+
+	static thread_local Thread* m_currentThread;
+	/// @}
+
 	void threadRun(U threadId);
 
 	/// Wait for more tasks.
@@ -156,8 +224,27 @@ private:
 	/// Get new work from the queue.
 	Task* getNewTask();
 
-	/// Complete a task.
-	void completeTask(U taskId);
+	/// @name Work-stealing methods
+	/// @{
+	void threadRunWorkStealing(U threadId);
+
+	void submitTasksWorkStealing(Task* tasks, U taskCount);
+
+	/// Push a task that has no pending dependencies.
+	void pushReadyTask(Thread* thread, Task* task);
+
+	/// Push the task to the semaphore's waiting list or to the ready tasks if the semaphore has reached zero.
+	void pushTask(Thread* thread, Task* task);
+
+	/// Find a task to execute. Will return nullptr if nothing was found.
+	Task* findTaskWorkStealing(Thread& thread);
+
+	/// Sleep until there is some work or it's time to quit.
+	/// @return True if it's time to quit.
+	Bool sleepWorkStealing();
+
+	void waitAllTasksWorkStealing();
+	/// @}
 };
 /// @}
 
@@ -0,0 +1,105 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/util/ThreadHiveTaskGraph.h>
+
+namespace anki
+{
+
+void ThreadHiveTaskGraph::addDependency(ThreadHiveTaskGraphNode* node, ThreadHiveTaskGraphNode* dependency)
+{
+	ANKI_ASSERT(!m_submitted);
+	ANKI_ASSERT(node && dependency && node != dependency);
+	ANKI_ASSERT(node->m_hive == m_hive && dependency->m_hive == m_hive);
+
+	ThreadHiveTaskGraphNode::Dependent* dep =
+		static_cast<ThreadHiveTaskGraphNode::Dependent*>(m_hive->allocateScratchMemory(
+			sizeof(ThreadHiveTaskGraphNode::Dependent), alignof(ThreadHiveTaskGraphNode::Dependent)));
+	dep->m_node = node;
+	dep->m_next = dependency->m_dependents;
+	dependency->m_dependents = dep;
+
+	node->m_unresolvedDependencies.fetchAdd(1);
+}
+
+void ThreadHiveTaskGraph::submit()
+{
+	ANKI_ASSERT(!m_submitted);
+	m_submitted = true;
+
+	// Gather the roots first. Once a root is scheduled it might resolve the dependencies of other nodes and those
+	// shouldn't be scheduled twice
+	ThreadHiveTaskGraphNode* firstRoot = nullptr;
+	for(ThreadHiveTaskGraphNode* node = m_firstNode; node; node = node->m_nextNode)
+	{
+		if(node->m_unresolvedDependencies.load() == 0)
+		{
+			node->m_nextRoot = firstRoot;
+			firstRoot = node;
+		}
+	}
+
+	ANKI_ASSERT((firstRoot || !m_firstNode) && "The graph has a cycle");
+
+	while(firstRoot)
+	{
+		ThreadHiveTaskGraphNode* next = firstRoot->m_nextRoot;
+		scheduleNode(*firstRoot);
+		firstRoot = next;
+	}
+}
+
+void ThreadHiveTaskGraph::scheduleNode(ThreadHiveTaskGraphNode& node)
+{
+	Array<ThreadHiveTask, ThreadHive::MAX_THREADS> tasks;
+	ANKI_ASSERT(node.m_taskCount > 0 && node.m_taskCount <= tasks.getSize());
+
+	node.m_runningTasks.set(node.m_taskCount);
+
+	for(U i = 0; i < node.m_taskCount; ++i)
+	{
+		tasks[i].m_callback = nodeTaskCallback;
+		tasks[i].m_argument = &node;
+	}
+
+	node.m_hive->submitTasks(&tasks[0], node.m_taskCount);
+}
+
+void ThreadHiveTaskGraph::nodeTaskCallback(
+	void* userData, U32 threadId, ThreadHive& hive, ThreadHiveSemaphore* signalSemaphore)
+{
+	ThreadHiveTaskGraphNode& node = *static_cast<ThreadHiveTaskGraphNode*>(userData);
+
+	const TracerEventHandle event = (node.m_traceName) ? hive.beginTraceEvent() : nullptr;
+
+	U32 begin, end;
+	while(node.getNextRange(begin, end))
+	{
+		node.m_runCallback(node.m_func, begin, end, threadId);
+	}
+
+	if(node.m_traceName)
+	{
+		hive.endTraceEvent(node.m_traceName, event);
+	}
+
+	// The last task completes the node
+	if(node.m_runningTasks.fetchSub(1, AtomicMemoryOrder::ACQ_REL) != 1)
+	{
+		return;
+	}
+
+	node.m_destroyCallback(node.m_func);
+
+	for(ThreadHiveTaskGraphNode::Dependent* dep = node.m_dependents; dep; dep = dep->m_next)
+	{
+		if(dep->m_node->m_unresolvedDependencies.fetchSub(1, AtomicMemoryOrder::ACQ_REL) == 1)
+		{
+			scheduleNode(*dep->m_node);
+		}
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,205 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/util/ThreadHive.h>
+
+namespace anki
+{
+
+// Forward
+class ThreadHiveTaskGraph;
+
+/// @addtogroup util_thread
+/// @{
+
+/// A node of the ThreadHiveTaskGraph. It's a single task or a parallel for loop. @memberof ThreadHiveTaskGraph
+class ThreadHiveTaskGraphNode : public NonCopyable
+{
+	friend class ThreadHiveTaskGraph;
+
+private:
+	using RunCallback = void (*)(void* func, U32 begin, U32 end, U32 threadId);
+	using DestroyCallback = void (*)(void* func);
+
+	/// Linked list of the nodes that depend on a node.
+	class Dependent
+	{
+	public:
+		ThreadHiveTaskGraphNode* m_node;
+		Dependent* m_next;
+	};
+
+	ThreadHive* m_hive = nullptr;
+	void* m_func = nullptr;
+	RunCallback m_runCallback = nullptr;
+	DestroyCallback m_destroyCallback = nullptr;
+	const char* m_traceName = nullptr;
+
+	ThreadHiveTaskGraphNode* m_nextNode = nullptr; ///< All nodes of the graph.
+	ThreadHiveTaskGraphNode* m_nextRoot = nullptr; ///< Used during submission.
+	Dependent* m_dependents = nullptr;
+
+	Atomic<U32> m_unresolvedDependencies = {0};
+	Atomic<U32> m_runningTasks = {0};
+	Atomic<U32> m_crntIteration = {0};
+	U32 m_endIteration = 0;
+	U32 m_grainSize = 1;
+	U32 m_taskCount = 1;
+
+	ThreadHiveTaskGraphNode() = default;
+
+	/// Get the next range of iterations to process. The size of the range shrinks as the loop progresses so that the
+	/// threads finish at about the same time.
+	Bool getNextRange(U32& begin, U32& end)
+	{
+		U32 crnt = m_crntIteration.load();
+		do
+		{
+			if(crnt >= m_endIteration)
+			{
+				return false;
+			}
+
+			const U32 remaining = m_endIteration - crnt;
+			const U32 count = min(remaining, max(m_grainSize, remaining / (m_taskCount * 2)));
+			begin = crnt;
+			end = crnt + count;
+		} while(!m_crntIteration.compareExchange(crnt, end));
+
+		return true;
+	}
+};
+
+/// Builds a graph of tasks and parallel loops with dependencies between them and runs it on a ThreadHive. The nodes
+/// live in the hive's scratch memory so they are valid until ThreadHive::waitAllTasks() returns.
+/// @code
+/// ThreadHiveTaskGraph graph(hive);
+/// ThreadHiveTaskGraphNode* a = graph.newTask([&](U32 threadId) { ... }, "A");
+/// ThreadHiveTaskGraphNode* b = graph.newParallelFor(0, count, 0, [&](U32 begin, U32 end, U32 threadId) {...}, "B");
+/// graph.addDependency(b, a); // b waits for a
+/// graph.submitAndWait();
+/// @endcode
+class ThreadHiveTaskGraph : public NonCopyable
+{
+public:
+	ThreadHiveTaskGraph(ThreadHive& hive)
+		: m_hive(&hive)
+	{
+	}
+
+	~ThreadHiveTaskGraph()
+	{
+		ANKI_ASSERT((m_firstNode == nullptr || m_submitted) && "Forgot to submit the graph");
+	}
+
+	/// Add a single task.
+	/// @param func A functor with signature void(U32 threadId).
+	/// @param traceName The name of the event that will be sent to the tracer. Can be nullptr.
+	template<typename TFunc>
+	ThreadHiveTaskGraphNode* newTask(TFunc func, const char* traceName = nullptr);
+
+	/// Add a parallel for loop.
+	/// @param begin The first iteration.
+	/// @param end One past the last iteration.
+	/// @param grainSize The minimum number of iterations a task will process at once. If zero it will be computed
+	///                  automatically.
+	/// @param func A functor with signature void(U32 rangeBegin, U32 rangeEnd, U32 threadId).
+	/// @param traceName The name of the event that will be sent to the tracer. Can be nullptr.
+	template<typename TFunc>
+	ThreadHiveTaskGraphNode* newParallelFor(
+		U32 begin, U32 end, U32 grainSize, TFunc func, const char* traceName = nullptr);
+
+	/// Make @a node wait for @a dependency to finish.
+	void addDependency(ThreadHiveTaskGraphNode* node, ThreadHiveTaskGraphNode* dependency);
+
+	/// Submit the graph. The ThreadHiveTaskCallback callbacks can also call this.
+	void submit();
+
+	/// Submit the graph and wait for all the tasks of the hive to finish. Will block.
+	void submitAndWait()
+	{
+		submit();
+		m_hive->waitAllTasks();
+	}
+
+private:
+	ThreadHive* m_hive;
+	ThreadHiveTaskGraphNode* m_firstNode = nullptr;
+	Bool m_submitted = false;
+
+	template<typename TFunc>
+	ThreadHiveTaskGraphNode* newNode(const TFunc& func, const char* traceName);
+
+	static void scheduleNode(ThreadHiveTaskGraphNode& node);
+
+	static void nodeTaskCallback(void* userData, U32 threadId, ThreadHive& hive, ThreadHiveSemaphore* signalSemaphore);
+};
+
+/// Run a parallel for loop on the hive and wait for it to finish. It calls ThreadHive::waitAllTasks() so it can't be
+/// called from inside a ThreadHive task.
+/// @param func A functor with signature void(U32 rangeBegin, U32 rangeEnd, U32 threadId).
+/// @see ThreadHiveTaskGraph::newParallelFor
+template<typename TFunc>
+void parallelFor(ThreadHive& hive, U32 begin, U32 end, U32 grainSize, TFunc func, const char* traceName = nullptr)
+{
+	ThreadHiveTaskGraph graph(hive);
+	graph.newParallelFor(begin, end, grainSize, func, traceName);
+	graph.submitAndWait();
+}
+/// @}
+
+template<typename TFunc>
+ThreadHiveTaskGraphNode* ThreadHiveTaskGraph::newNode(const TFunc& func, const char* traceName)
+{
+	ANKI_ASSERT(!m_submitted);
+
+	ThreadHiveTaskGraphNode* node = static_cast<ThreadHiveTaskGraphNode*>(
+		m_hive->allocateScratchMemory(sizeof(ThreadHiveTaskGraphNode), alignof(ThreadHiveTaskGraphNode)));
+	::new(node) ThreadHiveTaskGraphNode();
+
+	node->m_hive = m_hive;
+	node->m_traceName = traceName;
+	node->m_func = m_hive->allocateScratchMemory(sizeof(TFunc), alignof(TFunc));
+	::new(node->m_func) TFunc(func);
+	node->m_destroyCallback = [](void* f) { static_cast<TFunc*>(f)->~TFunc(); };
+
+	node->m_nextNode = m_firstNode;
+	m_firstNode = node;
+
+	return node;
+}
+
+template<typename TFunc>
+ThreadHiveTaskGraphNode* ThreadHiveTaskGraph::newTask(TFunc func, const char* traceName)
+{
+	ThreadHiveTaskGraphNode* node = newNode(func, traceName);
+	node->m_runCallback = [](void* f, U32 begin, U32 end, U32 threadId) { (*static_cast<TFunc*>(f))(threadId); };
+	node->m_crntIteration.set(0);
+	node->m_endIteration = 1;
+	return node;
+}
+
+template<typename TFunc>
+ThreadHiveTaskGraphNode* ThreadHiveTaskGraph::newParallelFor(
+	U32 begin, U32 end, U32 grainSize, TFunc func, const char* traceName)
+{
+	ANKI_ASSERT(begin <= end);
+	const U32 count = end - begin;
+	const U32 threadCount = m_hive->getThreadCount();
+
+	ThreadHiveTaskGraphNode* node = newNode(func, traceName);
+	node->m_runCallback = [](void* f, U32 begin, U32 end, U32 threadId) {
+		(*static_cast<TFunc*>(f))(begin, end, threadId);
+	};
+	node->m_crntIteration.set(begin);
+	node->m_endIteration = end;
+	node->m_grainSize = (grainSize) ? grainSize : max(1u, count / (threadCount * 16));
+	node->m_taskCount = max(1u, min(threadCount, (count + node->m_grainSize - 1) / node->m_grainSize));
+	return node;
+}
+
+} // end namespace anki
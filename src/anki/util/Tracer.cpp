@@ -14,7 +14,11 @@ namespace anki
 class Tracer::Event
 {
 public:
-	const char* m_name;
+	union
+	{
+		const char* m_name;
+		EventsChunk* m_chunk; ///< In streaming mode it points to the owner chunk until the event ends.
+	};
 	Second m_timestamp;
 	Second m_duration;
 };
@@ -25,6 +29,14 @@ class Tracer::EventsChunk : public IntrusiveListEnabled<EventsChunk>
 public:
 	Array<Event, EVENTS_PER_CHUNK> m_events;
 	U32 m_eventCount = 0;
+
+	// Used in streaming mode
+	U64 m_frame = 0;
+	ThreadId m_tid = 0; ///< The thread that owns the chunk.
+
+	/// The events that have begun but not ended plus one while it's the current chunk of its thread. Events may end on
+	/// other threads. The one that drops it to zero submits the chunk.
+	Atomic<U32> m_refcount = {0};
 };
 
 /// A heavyweight event with more info.
@@ -51,6 +63,7 @@ class Tracer::CountersChunk : public IntrusiveListEnabled<CountersChunk>
 public:
 	U64 m_frame;
 	Second m_startFrameTime;
+	ThreadId m_tid = 0; ///< Used in streaming mode.
 	Array<Counter, COUNTERS_PER_CHUNK> m_counters;
 	U32 m_counterCount = 0;
 };
@@ -111,8 +124,88 @@ public:
 	}
 };
 
+/// The types of the records in the stream file.
+enum class TracerStreamRecordType : U32
+{
+	NAME,
+	EVENTS,
+	COUNTERS
+};
+
+static const Array<char, 8> TRACER_STREAM_MAGIC = {{'A', 'N', 'K', 'I', 'T', 'R', 'C', '1'}};
+
+ANKI_BEGIN_PACKED_STRUCT
+/// Every record of the stream file starts with that. If it's a NAME record the m_count is the length of the string
+/// that follows. Otherwise it's the number of TracerStreamEvent or TracerStreamCounter that follow.
+class TracerStreamRecordHeader
+{
+public:
+	TracerStreamRecordType m_type;
+	U32 m_count;
+	U64 m_tidOrNameIndex;
+	U64 m_frame;
+	U64 m_startFrameTimeNs;
+};
+
+class TracerStreamEvent
+{
+public:
+	U32 m_nameIndex;
+	U64 m_timestampNs;
+	U64 m_durationNs;
+};
+
+class TracerStreamCounter
+{
+public:
+	U32 m_nameIndex;
+	U64 m_value;
+};
+ANKI_END_PACKED_STRUCT
+
+static U64 secondsToNs(Second s)
+{
+	return U64(s * 1000000000.0);
+}
+
+/// Context for the streaming mode.
+class Tracer::StreamCtx
+{
+public:
+	File m_file;
+	Thread m_thread = {"anki_tracer"};
+
+	/// Protects m_submittedEventChunks, m_submittedCounterChunks and m_quit.
+	Mutex m_mtx;
+	ConditionVariable m_cvar;
+	IntrusiveList<EventsChunk> m_submittedEventChunks;
+	IntrusiveList<CountersChunk> m_submittedCounterChunks;
+	Bool m_quit = false;
+
+	SpinLock m_freeChunksMtx;
+	IntrusiveList<EventsChunk> m_freeEventChunks;
+	IntrusiveList<CountersChunk> m_freeCounterChunks;
+
+	SpinLock m_retiredChunksMtx;
+	IntrusiveList<EventsChunk> m_retiredEventChunks; ///< Chunks that are full but wait for their events to end.
+
+	Atomic<U64> m_droppedCount = {0};
+
+	// These are only touched by the streaming thread
+	HashMap<U64, U32> m_nameIndices;
+	U32 m_nameCount = 0;
+};
+
 Tracer::~Tracer()
 {
+	if(m_stream)
+	{
+		if(endStreaming())
+		{
+			ANKI_UTIL_LOGE("Failed to write the trace stream");
+		}
+	}
+
 	for(ThreadLocal* threadLocal : m_allThreadLocal)
 	{
 		while(!threadLocal->m_counterChunks.isEmpty())
@@ -133,6 +226,9 @@ Tracer::~Tracer()
 	}
 
 	m_allThreadLocal.destroy(m_alloc);
+
+	// The ThreadLocal of this thread is gone
+	m_threadLocal = nullptr;
 }
 
 void Tracer::newFrame(U64 frame)
@@ -167,30 +263,57 @@ TracerEventHandle Tracer::beginEvent()
 	ThreadLocal& threadLocal = getThreadLocal();
 
 	// Allocate new chunk
-	if(threadLocal.m_eventChunks.isEmpty() || threadLocal.m_eventChunks.getBack().m_eventCount >= EVENTS_PER_CHUNK)
+	if(threadLocal.m_eventChunks.isEmpty() || threadLocal.m_eventChunks.getBack().m_eventCount >= EVENTS_PER_CHUNK
+		|| (m_stream && threadLocal.m_eventChunks.getBack().m_frame != m_frame))
 	{
-		EventsChunk* chunk = m_alloc.newInstance<EventsChunk>();
-		threadLocal.m_eventChunks.pushBack(chunk);
+		if(ANKI_UNLIKELY(!newEventsChunk(threadLocal)))
+		{
+			return nullptr;
+		}
 	}
 
 	EventsChunk& chunk = threadLocal.m_eventChunks.getBack();
 	Event* event = &chunk.m_events[chunk.m_eventCount++];
 	event->m_timestamp = HighRezTimer::getCurrentTime();
 
+	if(m_stream)
+	{
+		// A negative duration marks the open streamed events
+		event->m_chunk = &chunk;
+		event->m_duration = -1.0;
+		chunk.m_refcount.fetchAdd(1);
+	}
+	else
+	{
+		event->m_duration = 0.0;
+	}
+
 	return event;
 }
 
 void Tracer::endEvent(const char* eventName, TracerEventHandle eventHandle)
 {
 	ANKI_ASSERT(eventName);
-	ANKI_ASSERT(eventHandle);
 
+	if(ANKI_UNLIKELY(eventHandle == nullptr))
+	{
+		// Dropped by the streaming
+		return;
+	}
+
+	// Don't check m_stream. The event might have begun before the streaming ended
 	Event* event = static_cast<Event*>(eventHandle);
+	EventsChunk* chunk = (event->m_duration < 0.0) ? event->m_chunk : nullptr;
 	event->m_name = eventName;
 	event->m_duration = HighRezTimer::getCurrentTime() - event->m_timestamp;
 
 	// Store a counter as well. In ns
-	increaseCounter(eventName, U64(event->m_duration * 1000000000.0));
+	increaseCounter(eventName, secondsToNs(event->m_duration));
+
+	if(chunk)
+	{
+		releaseEventsChunk(*chunk);
+	}
 }
 
 void Tracer::increaseCounter(const char* counterName, U64 value)
@@ -203,13 +326,9 @@ void Tracer::increaseCounter(const char* counterName, U64 value)
 	if(threadLocal.m_counterChunks.isEmpty() || threadLocal.m_counterChunks.getBack().m_frame != m_frame
 		|| threadLocal.m_counterChunks.getBack().m_counterCount >= COUNTERS_PER_CHUNK)
 	{
-		CountersChunk* newChunk = m_alloc.newInstance<CountersChunk>();
-		threadLocal.m_counterChunks.pushBack(newChunk);
-
+		if(ANKI_UNLIKELY(!newCountersChunk(threadLocal)))
 		{
-			LockGuard<SpinLock> lock(m_frameMtx);
-			newChunk->m_frame = m_frame;
-			newChunk->m_startFrameTime = m_startFrameTime;
+			return;
 		}
 	}
 
@@ -220,6 +339,147 @@ void Tracer::increaseCounter(const char* counterName, U64 value)
 	counter.m_value = value;
 }
 
+Bool Tracer::newEventsChunk(ThreadLocal& threadLocal)
+{
+	if(!m_stream)
+	{
+		threadLocal.m_eventChunks.pushBack(m_alloc.newInstance<EventsChunk>());
+		return true;
+	}
+
+	EventsChunk* chunk = nullptr;
+	{
+		LockGuard<SpinLock> lock(m_stream->m_freeChunksMtx);
+		if(!m_stream->m_freeEventChunks.isEmpty())
+		{
+			chunk = &m_stream->m_freeEventChunks.getFront();
+			m_stream->m_freeEventChunks.popFront();
+		}
+	}
+
+	if(ANKI_UNLIKELY(chunk == nullptr))
+	{
+		m_stream->m_droppedCount.fetchAdd(1);
+		return false;
+	}
+
+	// Retire the previous chunk. If it has no open events it can go to the disk right away
+	if(!threadLocal.m_eventChunks.isEmpty())
+	{
+		retireEventsChunk(threadLocal, threadLocal.m_eventChunks.getBack());
+	}
+
+	chunk->m_eventCount = 0;
+	chunk->m_frame = m_frame;
+	chunk->m_tid = threadLocal.m_tid;
+	chunk->m_refcount.store(1);
+	threadLocal.m_eventChunks.pushBack(chunk);
+
+	return true;
+}
+
+Bool Tracer::newCountersChunk(ThreadLocal& threadLocal)
+{
+	CountersChunk* chunk = nullptr;
+	if(!m_stream)
+	{
+		chunk = m_alloc.newInstance<CountersChunk>();
+	}
+	else
+	{
+		{
+			LockGuard<SpinLock> lock(m_stream->m_freeChunksMtx);
+			if(!m_stream->m_freeCounterChunks.isEmpty())
+			{
+				chunk = &m_stream->m_freeCounterChunks.getFront();
+				m_stream->m_freeCounterChunks.popFront();
+			}
+		}
+
+		if(ANKI_UNLIKELY(chunk == nullptr))
+		{
+			m_stream->m_droppedCount.fetchAdd(1);
+			return false;
+		}
+
+		// Counters are complete when they are written so the previous chunk can go
+		if(!threadLocal.m_counterChunks.isEmpty())
+		{
+			submitCountersChunk(threadLocal, threadLocal.m_counterChunks.getBack());
+		}
+
+		chunk->m_counterCount = 0;
+	}
+
+	threadLocal.m_counterChunks.pushBack(chunk);
+
+	{
+		LockGuard<SpinLock> lock(m_frameMtx);
+		chunk->m_frame = m_frame;
+		chunk->m_startFrameTime = m_startFrameTime;
+	}
+
+	return true;
+}
+
+void Tracer::retireEventsChunk(ThreadLocal& threadLocal, EventsChunk& chunk)
+{
+	ANKI_ASSERT(m_stream);
+	threadLocal.m_eventChunks.erase(&chunk);
+
+	// Push it to the retired list before dropping the reference of the thread so the release always finds it there
+	{
+		LockGuard<SpinLock> lock(m_stream->m_retiredChunksMtx);
+		m_stream->m_retiredEventChunks.pushBack(&chunk);
+	}
+
+	releaseEventsChunk(chunk);
+}
+
+void Tracer::releaseEventsChunk(EventsChunk& chunk)
+{
+	ANKI_ASSERT(chunk.m_refcount.load() > 0);
+	if(chunk.m_refcount.fetchSub(1) != 1)
+	{
+		return;
+	}
+
+	if(m_stream)
+	{
+		{
+			LockGuard<SpinLock> lock(m_stream->m_retiredChunksMtx);
+			m_stream->m_retiredEventChunks.erase(&chunk);
+		}
+
+		submitEventsChunk(chunk);
+	}
+	else
+	{
+		// The streaming ended while some of its events were open. Its other events are written already
+		m_alloc.deleteInstance(&chunk);
+	}
+}
+
+void Tracer::submitEventsChunk(EventsChunk& chunk)
+{
+	ANKI_ASSERT(m_stream);
+
+	LockGuard<Mutex> lock(m_stream->m_mtx);
+	m_stream->m_submittedEventChunks.pushBack(&chunk);
+	m_stream->m_cvar.notifyOne();
+}
+
+void Tracer::submitCountersChunk(ThreadLocal& threadLocal, CountersChunk& chunk)
+{
+	ANKI_ASSERT(m_stream);
+	threadLocal.m_counterChunks.erase(&chunk);
+	chunk.m_tid = threadLocal.m_tid;
+
+	LockGuard<Mutex> lock(m_stream->m_mtx);
+	m_stream->m_submittedCounterChunks.pushBack(&chunk);
+	m_stream->m_cvar.notifyOne();
+}
+
 void Tracer::gatherCounters(FlushCtx& ctx)
 {
 	// Iterate all the chunks and create the PerFrameCounters
@@ -549,6 +809,458 @@ Error Tracer::flush(CString filename)
 	return Error::NONE;
 }
 
+Error Tracer::beginStreaming(CString filename, U32 maxChunks)
+{
+	ANKI_ASSERT(isInitialized() && !m_stream);
+	ANKI_ASSERT(maxChunks > 0);
+	ANKI_ASSERT(m_allThreadLocal.getSize() == 0 && "Should be called before any tracing");
+
+	StreamCtx* stream = m_alloc.newInstance<StreamCtx>();
+
+	StringAuto fname(m_alloc);
+	fname.sprintf("%s.trace.bin", filename.cstr());
+	Error err = stream->m_file.open(fname.toCString(), FileOpenFlag::WRITE | FileOpenFlag::BINARY);
+	if(!err)
+	{
+		err = stream->m_file.write(&TRACER_STREAM_MAGIC[0], sizeof(TRACER_STREAM_MAGIC));
+	}
+
+	if(err)
+	{
+		m_alloc.deleteInstance(stream);
+		return err;
+	}
+
+	for(U32 i = 0; i < maxChunks; ++i)
+	{
+		stream->m_freeEventChunks.pushBack(m_alloc.newInstance<EventsChunk>());
+		stream->m_freeCounterChunks.pushBack(m_alloc.newInstance<CountersChunk>());
+	}
+
+	m_stream = stream;
+	m_stream->m_thread.start(this, streamingThreadCallback);
+
+	return Error::NONE;
+}
+
+Error Tracer::endStreaming()
+{
+	ANKI_ASSERT(m_stream);
+
+	// Submit what the threads still hold
+	{
+		LockGuard<Mutex> lock(m_threadLocalMtx);
+		for(ThreadLocal* threadLocal : m_allThreadLocal)
+		{
+			while(!threadLocal->m_eventChunks.isEmpty())
+			{
+				retireEventsChunk(*threadLocal, threadLocal->m_eventChunks.getFront());
+			}
+
+			while(!threadLocal->m_counterChunks.isEmpty())
+			{
+				submitCountersChunk(*threadLocal, threadLocal->m_counterChunks.getFront());
+			}
+		}
+	}
+
+	// Some chunks still have open events. Write copies of them without the open events. The chunks stay alive until
+	// their last event ends because the events live in them
+	{
+		LockGuard<SpinLock> lock(m_stream->m_retiredChunksMtx);
+		while(!m_stream->m_retiredEventChunks.isEmpty())
+		{
+			const EventsChunk& chunk = m_stream->m_retiredEventChunks.getFront();
+			m_stream->m_retiredEventChunks.popFront();
+
+			EventsChunk* copy = m_alloc.newInstance<EventsChunk>();
+			copy->m_events = chunk.m_events;
+			copy->m_eventCount = chunk.m_eventCount;
+			copy->m_frame = chunk.m_frame;
+			copy->m_tid = chunk.m_tid;
+			submitEventsChunk(*copy);
+		}
+	}
+
+	// Stop the thread
+	{
+		LockGuard<Mutex> lock(m_stream->m_mtx);
+		m_stream->m_quit = true;
+		m_stream->m_cvar.notifyOne();
+	}
+
+	const Error err = m_stream->m_thread.join();
+
+	// All chunks are back to the free lists, delete them
+	while(!m_stream->m_freeEventChunks.isEmpty())
+	{
+		EventsChunk& chunk = m_stream->m_freeEventChunks.getFront();
+		m_stream->m_freeEventChunks.popFront();
+		m_alloc.deleteInstance(&chunk);
+	}
+
+	while(!m_stream->m_freeCounterChunks.isEmpty())
+	{
+		CountersChunk& chunk = m_stream->m_freeCounterChunks.getFront();
+		m_stream->m_freeCounterChunks.popFront();
+		m_alloc.deleteInstance(&chunk);
+	}
+
+	m_stream->m_nameIndices.destroy(m_alloc);
+	m_alloc.deleteInstance(m_stream);
+	m_stream = nullptr;
+
+	return err;
+}
+
+U64 Tracer::getDroppedCount() const
+{
+	return (m_stream) ? m_stream->m_droppedCount.load() : 0;
+}
+
+Error Tracer::streamingThreadCallback(ThreadCallbackInfo& info)
+{
+	return static_cast<Tracer*>(info.m_userData)->streamingThreadRun();
+}
+
+Error Tracer::streamingThreadRun()
+{
+	StreamCtx& stream = *m_stream;
+	Error err = Error::NONE;
+	Bool quit = false;
+
+	while(!quit)
+	{
+		IntrusiveList<EventsChunk> eventChunks;
+		IntrusiveList<CountersChunk> counterChunks;
+
+		{
+			LockGuard<Mutex> lock(stream.m_mtx);
+
+			while(!stream.m_quit && stream.m_submittedEventChunks.isEmpty()
+				  && stream.m_submittedCounterChunks.isEmpty())
+			{
+				stream.m_cvar.wait(stream.m_mtx);
+			}
+
+			eventChunks = std::move(stream.m_submittedEventChunks);
+			counterChunks = std::move(stream.m_submittedCounterChunks);
+			quit = stream.m_quit;
+		}
+
+		// Write and recycle the chunks. On error keep recycling so the tracing threads won't run out of chunks
+		while(!eventChunks.isEmpty())
+		{
+			EventsChunk& chunk = eventChunks.getFront();
+			eventChunks.popFront();
+
+			if(!err)
+			{
+				err = writeStreamEventsChunk(chunk);
+			}
+
+			LockGuard<SpinLock> lock(stream.m_freeChunksMtx);
+			stream.m_freeEventChunks.pushBack(&chunk);
+		}
+
+		while(!counterChunks.isEmpty())
+		{
+			CountersChunk& chunk = counterChunks.getFront();
+			counterChunks.popFront();
+
+			if(!err)
+			{
+				err = writeStreamCountersChunk(chunk);
+			}
+
+			LockGuard<SpinLock> lock(stream.m_freeChunksMtx);
+			stream.m_freeCounterChunks.pushBack(&chunk);
+		}
+	}
+
+	if(!err)
+	{
+		err = stream.m_file.flush();
+	}
+
+	return err;
+}
+
+Error Tracer::writeStreamName(const char* name, U32& idx)
+{
+	StreamCtx& stream = *m_stream;
+
+	auto it = stream.m_nameIndices.find(ptrToNumber(name));
+	if(it != stream.m_nameIndices.getEnd())
+	{
+		idx = *it;
+		return Error::NONE;
+	}
+
+	idx = stream.m_nameCount++;
+	stream.m_nameIndices.emplace(m_alloc, ptrToNumber(name), idx);
+
+	TracerStreamRecordHeader header = {};
+	header.m_type = TracerStreamRecordType::NAME;
+	header.m_count = U32(strlen(name));
+	header.m_tidOrNameIndex = idx;
+	ANKI_CHECK(stream.m_file.write(&header, sizeof(header)));
+	ANKI_CHECK(stream.m_file.write(name, header.m_count));
+
+	return Error::NONE;
+}
+
+Error Tracer::writeStreamEventsChunk(const EventsChunk& chunk)
+{
+	Array<TracerStreamEvent, EVENTS_PER_CHUNK> events;
+	U32 count = 0;
+	for(U32 i = 0; i < chunk.m_eventCount; ++i)
+	{
+		const Event& inEvent = chunk.m_events[i];
+		if(inEvent.m_duration < 0.0)
+		{
+			// Never ended
+			continue;
+		}
+
+		U32 nameIdx;
+		ANKI_CHECK(writeStreamName(inEvent.m_name, nameIdx));
+
+		TracerStreamEvent& outEvent = events[count++];
+		outEvent.m_nameIndex = nameIdx;
+		outEvent.m_timestampNs = secondsToNs(inEvent.m_timestamp);
+		outEvent.m_durationNs = secondsToNs(inEvent.m_duration);
+	}
+
+	if(count == 0)
+	{
+		return Error::NONE;
+	}
+
+	TracerStreamRecordHeader header = {};
+	header.m_type = TracerStreamRecordType::EVENTS;
+	header.m_count = count;
+	header.m_tidOrNameIndex = chunk.m_tid;
+	header.m_frame = chunk.m_frame;
+	ANKI_CHECK(m_stream->m_file.write(&header, sizeof(header)));
+	ANKI_CHECK(m_stream->m_file.write(&events[0], sizeof(events[0]) * count));
+
+	return Error::NONE;
+}
+
+Error Tracer::writeStreamCountersChunk(const CountersChunk& chunk)
+{
+	if(chunk.m_counterCount == 0)
+	{
+		return Error::NONE;
+	}
+
+	Array<TracerStreamCounter, COUNTERS_PER_CHUNK> counters;
+	for(U32 i = 0; i < chunk.m_counterCount; ++i)
+	{
+		U32 nameIdx;
+		ANKI_CHECK(writeStreamName(chunk.m_counters[i].m_name, nameIdx));
+
+		counters[i].m_nameIndex = nameIdx;
+		counters[i].m_value = chunk.m_counters[i].m_value;
+	}
+
+	TracerStreamRecordHeader header = {};
+	header.m_type = TracerStreamRecordType::COUNTERS;
+	header.m_count = chunk.m_counterCount;
+	header.m_tidOrNameIndex = chunk.m_tid;
+	header.m_frame = chunk.m_frame;
+	header.m_startFrameTimeNs = secondsToNs(chunk.m_startFrameTime);
+	ANKI_CHECK(m_stream->m_file.write(&header, sizeof(header)));
+	ANKI_CHECK(m_stream->m_file.write(&counters[0], sizeof(counters[0]) * chunk.m_counterCount));
+
+	return Error::NONE;
+}
+
+Error Tracer::convertStreamToChromeJson(
+	GenericMemoryPoolAllocator<U8> alloc, CString streamFilename, CString jsonFilename)
+{
+	class FrameCounter
+	{
+	public:
+		U64 m_frame;
+		U64 m_startFrameTimeNs;
+		U32 m_nameIndex;
+		U64 m_value;
+	};
+
+	File in;
+	ANKI_CHECK(in.open(streamFilename, FileOpenFlag::READ | FileOpenFlag::BINARY));
+	const PtrSize fileSize = in.getSize();
+
+	Array<char, 8> magic;
+	if(fileSize < sizeof(magic))
+	{
+		ANKI_UTIL_LOGE("Trace stream file is too small: %s", streamFilename.cstr());
+		return Error::USER_DATA;
+	}
+
+	ANKI_CHECK(in.read(&magic[0], sizeof(magic)));
+	if(memcmp(&magic[0], &TRACER_STREAM_MAGIC[0], sizeof(magic)) != 0)
+	{
+		ANKI_UTIL_LOGE("Wrong magic in trace stream file: %s", streamFilename.cstr());
+		return Error::USER_DATA;
+	}
+
+	File out;
+	ANKI_CHECK(out.open(jsonFilename, FileOpenFlag::WRITE));
+	ANKI_CHECK(out.writeText("[\n"));
+
+	DynamicArrayAuto<char> nameStorage(alloc);
+	DynamicArrayAuto<PtrSize> nameOffsets(alloc);
+	DynamicArrayAuto<TracerStreamEvent> events(alloc);
+	DynamicArrayAuto<TracerStreamCounter> counters(alloc);
+	DynamicArrayAuto<FrameCounter> frameCounters(alloc);
+
+	PtrSize offset = sizeof(magic);
+	while(offset < fileSize)
+	{
+		TracerStreamRecordHeader header;
+		if(offset + sizeof(header) > fileSize)
+		{
+			ANKI_UTIL_LOGE("Truncated trace stream file: %s", streamFilename.cstr());
+			return Error::USER_DATA;
+		}
+
+		ANKI_CHECK(in.read(&header, sizeof(header)));
+		offset += sizeof(header);
+
+		switch(header.m_type)
+		{
+		case TracerStreamRecordType::NAME:
+		{
+			if(header.m_tidOrNameIndex != nameOffsets.getSize())
+			{
+				ANKI_UTIL_LOGE("Unexpected name index in trace stream file");
+				return Error::USER_DATA;
+			}
+
+			const PtrSize nameOffset = nameStorage.getSize();
+			nameOffsets.emplaceBack(nameOffset);
+			nameStorage.resize(nameOffset + header.m_count + 1);
+			ANKI_CHECK(in.read(&nameStorage[nameOffset], header.m_count));
+			nameStorage[nameOffset + header.m_count] = '\0';
+			offset += header.m_count;
+			break;
+		}
+		case TracerStreamRecordType::EVENTS:
+		{
+			if(header.m_count == 0)
+			{
+				break;
+			}
+
+			events.resize(header.m_count);
+			ANKI_CHECK(in.read(&events[0], sizeof(events[0]) * header.m_count));
+			offset += sizeof(events[0]) * header.m_count;
+
+			for(const TracerStreamEvent& event : events)
+			{
+				const U64 startMicroSec = event.m_timestampNs / 1000;
+				const U64 durMicroSec = event.m_durationNs / 1000;
+
+				if(durMicroSec == 0)
+				{
+					continue;
+				}
+
+				if(event.m_nameIndex >= nameOffsets.getSize())
+				{
+					ANKI_UTIL_LOGE("Unknown name index in trace stream file");
+					return Error::USER_DATA;
+				}
+
+				ANKI_CHECK(out.writeText("{\"name\": \"%s\", \"cat\": \"PERF\", \"ph\": \"X\", "
+										 "\"pid\": 1, \"tid\": %llu, \"ts\": %llu, \"dur\": %llu},\n",
+					&nameStorage[nameOffsets[event.m_nameIndex]],
+					header.m_tidOrNameIndex,
+					startMicroSec,
+					durMicroSec));
+			}
+			break;
+		}
+		case TracerStreamRecordType::COUNTERS:
+		{
+			if(header.m_count == 0)
+			{
+				break;
+			}
+
+			counters.resize(header.m_count);
+			ANKI_CHECK(in.read(&counters[0], sizeof(counters[0]) * header.m_count));
+			offset += sizeof(counters[0]) * header.m_count;
+
+			for(const TracerStreamCounter& counter : counters)
+			{
+				if(counter.m_nameIndex >= nameOffsets.getSize())
+				{
+					ANKI_UTIL_LOGE("Unknown name index in trace stream file");
+					return Error::USER_DATA;
+				}
+
+				FrameCounter& frameCounter = *frameCounters.emplaceBack();
+				frameCounter.m_frame = header.m_frame;
+				frameCounter.m_startFrameTimeNs = header.m_startFrameTimeNs;
+				frameCounter.m_nameIndex = counter.m_nameIndex;
+				frameCounter.m_value = counter.m_value;
+			}
+			break;
+		}
+		default:
+			ANKI_UTIL_LOGE("Unknown record in trace stream file");
+			return Error::USER_DATA;
+		}
+	}
+
+	// The counters of the same frame come from many threads and chunks. Merge them
+	std::sort(frameCounters.getBegin(), frameCounters.getEnd(), [](const FrameCounter& a, const FrameCounter& b) {
+		return (a.m_frame != b.m_frame) ? a.m_frame < b.m_frame : a.m_nameIndex < b.m_nameIndex;
+	});
+
+	U32 mergedCount = 0;
+	for(U32 i = 0; i < frameCounters.getSize(); ++i)
+	{
+		if(mergedCount > 0 && frameCounters[mergedCount - 1].m_frame == frameCounters[i].m_frame
+			&& frameCounters[mergedCount - 1].m_nameIndex == frameCounters[i].m_nameIndex)
+		{
+			frameCounters[mergedCount - 1].m_value += frameCounters[i].m_value;
+		}
+		else
+		{
+			frameCounters[mergedCount++] = frameCounters[i];
+		}
+	}
+
+	// Write the counters
+	const U64 lastFrame = (mergedCount > 0) ? frameCounters[mergedCount - 1].m_frame : 0;
+	for(U32 i = 0; i < mergedCount; ++i)
+	{
+		const FrameCounter& counter = frameCounters[i];
+
+		// The counters need a range in order to appear. Add a dummy counter for the last frame
+		const Array<U64, 2> timestamps = {{counter.m_startFrameTimeNs, counter.m_startFrameTimeNs + 1000000000}};
+		const U timestampCount = (counter.m_frame != lastFrame) ? 1 : 2;
+
+		for(U j = 0; j < timestampCount; ++j)
+		{
+			ANKI_CHECK(out.writeText("{\"name\": \"%s\", \"cat\": \"PERF\", \"ph\": \"C\", "
+									 "\"pid\": 1, \"ts\": %llu, \"args\": {\"val\": %llu}},\n",
+				&nameStorage[nameOffsets[counter.m_nameIndex]],
+				timestamps[j] / 1000,
+				counter.m_value));
+		}
+	}
+
+	ANKI_CHECK(out.writeText("{}\n]\n"));
+
+	return Error::NONE;
+}
+
 void Tracer::getSpreadsheetColumnName(U column, Array<char, 3>& arr)
 {
 	U major = column / 26;
@@ -8,6 +8,7 @@
 #include <anki/util/File.h>
 #include <anki/util/List.h>
 #include <anki/util/ObjectAllocator.h>
+#include <anki/util/Thread.h>
 
 namespace anki
 {
@@ -53,6 +54,29 @@ public:
 	/// Flush all results to a file. Don't call that more than once.
 	ANKI_USE_RESULT Error flush(CString filename);
 
+	/// Start streaming the events and the counters to a binary file (<filename>.trace.bin) from a background thread.
+	/// The chunks are written as soon as they fill up or the frame changes so the memory stays bounded. If the writer
+	/// can't keep up the new events are dropped. Call it before any thread starts tracing.
+	/// @param filename The base name of the file.
+	/// @param maxChunks The number of event chunks and the number of counter chunks that will be preallocated.
+	ANKI_USE_RESULT Error beginStreaming(CString filename, U32 maxChunks = 256);
+
+	/// Write everything that is left and stop the background thread. Don't call it while other threads are tracing.
+	/// The events that are still open can end later but they won't be written.
+	ANKI_USE_RESULT Error endStreaming();
+
+	Bool isStreaming() const
+	{
+		return m_stream != nullptr;
+	}
+
+	/// Get the number of events and counters that got dropped because there were no free chunks.
+	U64 getDroppedCount() const;
+
+	/// Convert a file written in streaming mode to a chrome trace file.
+	static ANKI_USE_RESULT Error convertStreamToChromeJson(
+		GenericMemoryPoolAllocator<U8> alloc, CString streamFilename, CString jsonFilename);
+
 private:
 	static const U32 EVENTS_PER_CHUNK = 256;
 	static const U32 COUNTERS_PER_CHUNK = 512;
@@ -68,6 +92,7 @@ private:
 	class ThreadLocal;
 	class PerFrameCounters;
 	class FlushCtx;
+	class StreamCtx;
 
 	GenericMemoryPoolAllocator<U8> m_alloc;
 
@@ -79,6 +104,8 @@ private:
 	DynamicArray<ThreadLocal*> m_allThreadLocal; ///< The Tracer should know about all the ThreadLocal.
 	Mutex m_threadLocalMtx;
 
+	StreamCtx* m_stream = nullptr;
+
 	/// Get the thread local ThreadLocal structure.
 	ThreadLocal& getThreadLocal();
 
@@ -95,6 +122,35 @@ private:
 	Error writeTraceJson(const FlushCtx& ctx);
 
 	static void getSpreadsheetColumnName(U column, Array<char, 3>& arr);
+
+	/// Get a new events chunk. In streaming mode it might fail.
+	Bool newEventsChunk(ThreadLocal& threadLocal);
+
+	/// Get a new counters chunk. In streaming mode it might fail.
+	Bool newCountersChunk(ThreadLocal& threadLocal);
+
+	/// Stop adding events to the current chunk of a thread. It's submitted when all its events end.
+	void retireEventsChunk(ThreadLocal& threadLocal, EventsChunk& chunk);
+
+	/// Drop a reference of a chunk. The last one submits it.
+	void releaseEventsChunk(EventsChunk& chunk);
+
+	/// Pass a chunk to the streaming thread.
+	void submitEventsChunk(EventsChunk& chunk);
+
+	/// Pass a chunk to the streaming thread.
+	void submitCountersChunk(ThreadLocal& threadLocal, CountersChunk& chunk);
+
+	static Error streamingThreadCallback(ThreadCallbackInfo& info);
+
+	Error streamingThreadRun();
+
+	/// Write the name to the stream if it hasn't been written already.
+	Error writeStreamName(const char* name, U32& idx);
+
+	Error writeStreamEventsChunk(const EventsChunk& chunk);
+
+	Error writeStreamCountersChunk(const CountersChunk& chunk);
 };
 /// @}
 
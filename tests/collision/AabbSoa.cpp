@@ -0,0 +1,194 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/collision/AabbSoa.h>
+#include <anki/collision/Functions.h>
+#include <anki/util/HighRezTimer.h>
+
+namespace anki
+{
+
+static Aabb randomAabb()
+{
+	const Vec3 min(randRange(-100.0f, 90.0f), randRange(-100.0f, 90.0f), randRange(-100.0f, 90.0f));
+	const Vec3 size(randRange(0.1f, 10.0f), randRange(0.1f, 10.0f), randRange(0.1f, 10.0f));
+	return Aabb(min, min + size);
+}
+
+/// Some random planes that look like a frustum.
+static void randomPlanes(Array<Plane, 6>& planes)
+{
+	for(Plane& plane : planes)
+	{
+		const Vec4 normal =
+			Vec4(randRange(-1.0f, 1.0f), randRange(-1.0f, 1.0f), randRange(-1.0f, 1.0f), 0.0f).getNormalized();
+		plane = Plane(normal, randRange(-60.0f, 10.0f));
+	}
+}
+
+/// A structure of arrays allocated on the heap.
+class AabbSoaHeapArray
+{
+public:
+	DynamicArrayAuto<F32> m_data;
+	U32 m_paddedCount = 0;
+	AabbSoaView m_view;
+
+	AabbSoaHeapArray(HeapAllocator<U8> alloc, ConstWeakArray<Aabb> aabbs)
+		: m_data(alloc)
+	{
+		m_paddedCount = (aabbs.getSize() + 3) & ~3u;
+		m_data.create(m_paddedCount * 6 + 4, 0.0f);
+
+		// Align the streams manually
+		F32* base = &m_data[0];
+		while(!isAligned(16, base))
+		{
+			++base;
+		}
+
+		Array<F32*, 6> streams;
+		for(U i = 0; i < 6; ++i)
+		{
+			streams[i] = base + i * m_paddedCount;
+		}
+
+		for(U i = 0; i < aabbs.getSize(); ++i)
+		{
+			streams[0][i] = aabbs[i].getMin().x();
+			streams[1][i] = aabbs[i].getMin().y();
+			streams[2][i] = aabbs[i].getMin().z();
+			streams[3][i] = aabbs[i].getMax().x();
+			streams[4][i] = aabbs[i].getMax().y();
+			streams[5][i] = aabbs[i].getMax().z();
+		}
+
+		m_view.m_minX = streams[0];
+		m_view.m_minY = streams[1];
+		m_view.m_minZ = streams[2];
+		m_view.m_maxX = streams[3];
+		m_view.m_maxY = streams[4];
+		m_view.m_maxZ = streams[5];
+		m_view.m_count = aabbs.getSize();
+	}
+};
+
+static Bool insidePlanes(ConstWeakArray<Plane> planes, const Aabb& aabb)
+{
+	for(const Plane& plane : planes)
+	{
+		if(testPlane(plane, aabb) < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ANKI_TEST(Collision, AabbSoa)
+{
+	// Fixed array, test all the counts around the batch size
+	for(U32 count = 0; count <= 13; ++count)
+	{
+		for(U iteration = 0; iteration < 50; ++iteration)
+		{
+			Array<Plane, 6> planes;
+			randomPlanes(planes);
+
+			AabbSoaArray<13> soa;
+			Array<Aabb, 13> aabbs;
+			for(U32 i = 0; i < count; ++i)
+			{
+				aabbs[i] = randomAabb();
+				soa.pushBack(aabbs[i]);
+			}
+			ANKI_TEST_EXPECT_EQ(soa.getSize(), count);
+
+			Array<U32, 13> visible;
+			const U32 visibleCount = cullAabbSoa(planes, soa.getView(), WeakArray<U32>(visible));
+
+			U32 expectedCount = 0;
+			for(U32 i = 0; i < count; ++i)
+			{
+				if(insidePlanes(planes, aabbs[i]))
+				{
+					ANKI_TEST_EXPECT_LT(expectedCount, visibleCount);
+					ANKI_TEST_EXPECT_EQ(visible[expectedCount], i);
+					++expectedCount;
+				}
+			}
+
+			ANKI_TEST_EXPECT_EQ(visibleCount, expectedCount);
+		}
+	}
+
+	// Box that touches the plane is visible
+	{
+		AabbSoaArray<1> soa;
+		soa.pushBack(Aabb(Vec3(-1.0f), Vec3(0.0f)));
+		const Plane plane(Vec4(1.0f, 0.0f, 0.0f, 0.0f), 0.0f);
+		Array<U32, 1> visible;
+		ANKI_TEST_EXPECT_EQ(cullAabbSoa(ConstWeakArray<Plane>(&plane, 1), soa.getView(), WeakArray<U32>(visible)), 1);
+	}
+}
+
+ANKI_TEST(Collision, AabbSoaBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 COUNT = 100000;
+	const U32 ITERATIONS = 20;
+
+	DynamicArrayAuto<Aabb> aabbs(alloc);
+	aabbs.create(COUNT);
+	for(Aabb& aabb : aabbs)
+	{
+		aabb = randomAabb();
+	}
+
+	Array<Plane, 6> planes;
+	randomPlanes(planes);
+
+	DynamicArrayAuto<U32> visible(alloc);
+	visible.create(COUNT);
+
+	// One at a time
+	U32 scalarCount = 0;
+	Second scalarTime = 0.0;
+	for(U i = 0; i < ITERATIONS; ++i)
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+		scalarCount = 0;
+		for(U32 j = 0; j < COUNT; ++j)
+		{
+			if(insidePlanes(planes, aabbs[j]))
+			{
+				visible[scalarCount++] = j;
+			}
+		}
+		scalarTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	// Batched
+	AabbSoaHeapArray soa(alloc, aabbs);
+	U32 batchCount = 0;
+	Second batchTime = 0.0;
+	for(U i = 0; i < ITERATIONS; ++i)
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+		batchCount = cullAabbSoa(planes, soa.m_view, WeakArray<U32>(visible));
+		batchTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	ANKI_TEST_EXPECT_EQ(scalarCount, batchCount);
+	ANKI_TEST_LOGI("Culling %u AABBs (%u visible): one at a time %fms, batched %fms",
+		COUNT,
+		batchCount,
+		scalarTime * 1000.0 / ITERATIONS,
+		batchTime * 1000.0 / ITERATIONS);
+}
+
+} // end namespace anki
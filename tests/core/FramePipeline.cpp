@@ -0,0 +1,163 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/core/FramePipeline.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+
+namespace anki
+{
+
+namespace
+{
+
+class FramePipelineTestCtx
+{
+public:
+	Array<U64, FramePipeline::FRAME_SLOT_COUNT> m_slotFrames;
+	U64 m_simulatedFrames = 0;
+	U64 m_renderedFrames = 0;
+	Bool m_inOrder = true;
+	U64 m_failFrame = MAX_U64;
+};
+
+} // end namespace
+
+static Error simulateTestFrame(void* userData, U32 frameSlot)
+{
+	FramePipelineTestCtx& ctx = *static_cast<FramePipelineTestCtx*>(userData);
+	ctx.m_slotFrames[frameSlot] = ctx.m_simulatedFrames;
+	return (ctx.m_simulatedFrames++ == ctx.m_failFrame) ? Error::FUNCTION_FAILED : Error::NONE;
+}
+
+static Error renderTestFrame(void* userData, U32 frameSlot)
+{
+	FramePipelineTestCtx& ctx = *static_cast<FramePipelineTestCtx*>(userData);
+	ctx.m_inOrder = ctx.m_inOrder && ctx.m_slotFrames[frameSlot] == ctx.m_renderedFrames;
+	++ctx.m_renderedFrames;
+	return Error::NONE;
+}
+
+ANKI_TEST(Core, FramePipeline)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	for(U i = 0; i < 2; ++i)
+	{
+		const Bool pipelined = i == 1;
+		const U FRAME_COUNT = 100;
+
+		// All frames should be rendered in order and pipelined mode should lag one frame behind
+		{
+			FramePipeline pipeline(alloc, pipelined);
+			FramePipelineTestCtx ctx;
+			for(U f = 0; f < FRAME_COUNT; ++f)
+			{
+				ANKI_TEST_EXPECT_NO_ERR(pipeline.runFrame(simulateTestFrame, renderTestFrame, &ctx));
+			}
+
+			ANKI_TEST_EXPECT_EQ(ctx.m_inOrder, true);
+			ANKI_TEST_EXPECT_EQ(ctx.m_simulatedFrames, FRAME_COUNT);
+			ANKI_TEST_EXPECT_EQ(ctx.m_renderedFrames, FRAME_COUNT - U(pipelined));
+			ANKI_TEST_EXPECT_EQ(pipeline.getSimulatedFrameCount(), FRAME_COUNT);
+		}
+
+		// Errors of the simulation should come out
+		{
+			FramePipeline pipeline(alloc, pipelined);
+			FramePipelineTestCtx ctx;
+			ctx.m_failFrame = 2;
+			ANKI_TEST_EXPECT_NO_ERR(pipeline.runFrame(simulateTestFrame, renderTestFrame, &ctx));
+			ANKI_TEST_EXPECT_NO_ERR(pipeline.runFrame(simulateTestFrame, renderTestFrame, &ctx));
+			ANKI_TEST_EXPECT_ANY_ERR(pipeline.runFrame(simulateTestFrame, renderTestFrame, &ctx));
+		}
+	}
+}
+
+namespace
+{
+
+/// Stands in for the scene and the renderer. Both burn CPU on their own hives and the renderer also blocks for a
+/// while like it would on the swapchain.
+class FramePipelineBenchCtx
+{
+public:
+	ThreadHive* m_sceneHive;
+	ThreadHive* m_renderHive;
+	Array<DynamicArrayAuto<F32>*, FramePipeline::FRAME_SLOT_COUNT> m_frameData;
+	F32 m_checksum = 0.0f;
+};
+
+} // end namespace
+
+static void burnCpu(ThreadHive& hive, DynamicArrayAuto<F32>& arr)
+{
+	parallelFor(hive, 0, U32(arr.getSize()), 0, [&](U32 begin, U32 end, U32 threadId) {
+		for(U32 i = begin; i < end; ++i)
+		{
+			arr[i] = sqrt(arr[i] + F32(i));
+		}
+	});
+}
+
+static Error simulateBenchFrame(void* userData, U32 frameSlot)
+{
+	FramePipelineBenchCtx& ctx = *static_cast<FramePipelineBenchCtx*>(userData);
+	burnCpu(*ctx.m_sceneHive, *ctx.m_frameData[frameSlot]);
+	return Error::NONE;
+}
+
+static Error renderBenchFrame(void* userData, U32 frameSlot)
+{
+	FramePipelineBenchCtx& ctx = *static_cast<FramePipelineBenchCtx*>(userData);
+	DynamicArrayAuto<F32>& arr = *ctx.m_frameData[frameSlot];
+	burnCpu(*ctx.m_renderHive, arr);
+	ctx.m_checksum += arr[0];
+
+	// Present
+	HighRezTimer::sleep(0.002);
+	return Error::NONE;
+}
+
+ANKI_TEST(Core, FramePipelineBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 threadCount = max(1u, getCpuCoresCount() / 2u);
+	const U FRAME_COUNT = 200;
+	const U32 ELEMENT_COUNT = 256 * 1024;
+
+	ThreadHive sceneHive(threadCount, alloc);
+	ThreadHive renderHive(threadCount, alloc);
+
+	DynamicArrayAuto<F32> frameData0(alloc);
+	DynamicArrayAuto<F32> frameData1(alloc);
+	frameData0.create(ELEMENT_COUNT, 1.0f);
+	frameData1.create(ELEMENT_COUNT, 1.0f);
+
+	Array<F64, 2> fps;
+	for(U i = 0; i < 2; ++i)
+	{
+		FramePipelineBenchCtx ctx;
+		ctx.m_sceneHive = &sceneHive;
+		ctx.m_renderHive = &renderHive;
+		ctx.m_frameData[0] = &frameData0;
+		ctx.m_frameData[1] = &frameData1;
+
+		FramePipeline pipeline(alloc, i == 1);
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRAME_COUNT; ++f)
+		{
+			ANKI_TEST_EXPECT_NO_ERR(pipeline.runFrame(simulateBenchFrame, renderBenchFrame, &ctx));
+		}
+		fps[i] = F64(FRAME_COUNT) / (HighRezTimer::getCurrentTime() - begin);
+	}
+
+	ANKI_TEST_LOGI("Frames per second: serial %f, pipelined %f", fps[0], fps[1]);
+}
+
+} // end namespace anki
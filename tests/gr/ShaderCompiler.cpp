@@ -4,6 +4,7 @@
 // http://www.anki3d.org/LICENSE
 
 #include <anki/gr/ShaderCompiler.h>
+#include <anki/util/Filesystem.h>
 #include <tests/framework/Framework.h>
 
 ANKI_TEST(Gr, ShaderCompiler)
@@ -21,3 +22,67 @@ void main()
 	options.m_outLanguage = ShaderLanguage::SPIRV;
 	ANKI_TEST_EXPECT_NO_ERR(cache.compile(SRC, nullptr, options, bin));
 }
+
+ANKI_TEST(Gr, ShaderBinaryArchive)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const CString dir = "./shader_archive_test";
+
+	if(directoryExists(dir))
+	{
+		ANKI_TEST_EXPECT_NO_ERR(removeDirectory(dir));
+	}
+	ANKI_TEST_EXPECT_NO_ERR(createDirectory(dir));
+
+	// Write some binaries the way ShaderCompilerCache does and some files that should be ignored
+	const Array<U64, 3> hashes = {{123, 7, 0xFFFFFFFFFFFFFFFFull}};
+	const Array<CString, 3> binaries = {{"first binary", "2nd", "the third one"}};
+	for(U i = 0; i < hashes.getSize(); ++i)
+	{
+		StringAuto fname(alloc);
+		fname.sprintf("%s/%llu.shdrbin", dir.cstr(), hashes[i]);
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open(fname.toCString(), FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(file.write(binaries[i].cstr(), binaries[i].getLength()));
+	}
+
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./shader_archive_test/notes.txt", FileOpenFlag::WRITE));
+		ANKI_TEST_EXPECT_NO_ERR(file.writeText("Not a shader"));
+	}
+
+	// Pack
+	StringAuto archiveFname(alloc);
+	archiveFname.sprintf("%s/%s", dir.cstr(), ShaderBinaryArchiveFile::DEFAULT_FILENAME);
+	U32 binaryCount;
+	ANKI_TEST_EXPECT_NO_ERR(ShaderBinaryArchive::pack(alloc, dir, archiveFname.toCString(), binaryCount));
+	ANKI_TEST_EXPECT_EQ(binaryCount, hashes.getSize());
+
+	// Read it back
+	ShaderBinaryArchive archive(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(archive.open(archiveFname.toCString()));
+	ANKI_TEST_EXPECT_EQ(archive.getBinaryCount(), hashes.getSize());
+
+	for(U i = 0; i < hashes.getSize(); ++i)
+	{
+		ConstWeakArray<U8> bin;
+		ANKI_TEST_EXPECT_EQ(archive.find(hashes[i], bin), true);
+		ANKI_TEST_EXPECT_EQ(bin.getSize(), binaries[i].getLength());
+		ANKI_TEST_EXPECT_EQ(memcmp(&bin[0], binaries[i].cstr(), bin.getSize()), 0);
+	}
+
+	ConstWeakArray<U8> bin;
+	ANKI_TEST_EXPECT_EQ(archive.find(8, bin), false);
+
+	// A truncated archive fails to open
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(
+			file.open("./shader_archive_test/truncated.ankisba", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(file.write("ANKI", 4));
+	}
+
+	ShaderBinaryArchive truncated(alloc);
+	ANKI_TEST_EXPECT_ERR(truncated.open("./shader_archive_test/truncated.ankisba"), Error::USER_DATA);
+}
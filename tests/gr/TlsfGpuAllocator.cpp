@@ -0,0 +1,274 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/gr/common/TlsfGpuAllocator.h>
+#include <anki/util/HighRezTimer.h>
+#include <tests/framework/Framework.h>
+#include <random>
+#include <algorithm>
+#include <cstring>
+
+namespace anki
+{
+
+/// An allocation that writes its ID in its memory.
+class TlsfTestAllocation
+{
+public:
+	TlsfGpuAllocatorHandle m_handle;
+	U8 m_id = 0;
+};
+
+static Bool tlsfMemoryIsValid(const std::vector<U8>& mem, const TlsfTestAllocation& a)
+{
+	for(PtrSize i = a.m_handle.m_offset; i < a.m_handle.m_offset + a.m_handle.m_size; ++i)
+	{
+		if(mem[i] != a.m_id)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ANKI_TEST(Gr, TlsfGpuAllocator)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const PtrSize SIZE = 32 * 1024 * 1024;
+
+	{
+		TlsfGpuAllocator talloc;
+		talloc.init(alloc, SIZE);
+		ANKI_TEST_EXPECT_EQ(talloc.getLargestFreeBlockSize(), SIZE);
+
+		// Everything
+		TlsfGpuAllocatorHandle handle;
+		ANKI_TEST_EXPECT_NO_ERR(talloc.allocate(SIZE, 16, nullptr, handle));
+		ANKI_TEST_EXPECT_EQ(handle.m_offset, 0);
+		ANKI_TEST_EXPECT_EQ(talloc.getLargestFreeBlockSize(), 0);
+
+		TlsfGpuAllocatorHandle handle2;
+		ANKI_TEST_EXPECT_ERR(talloc.allocate(16, 16, nullptr, handle2), Error::OUT_OF_MEMORY);
+
+		talloc.free(handle);
+		ANKI_TEST_EXPECT_EQ(Bool(handle), false);
+
+		// Too big
+		ANKI_TEST_EXPECT_ERR(talloc.allocate(SIZE + 16, 16, nullptr, handle), Error::OUT_OF_MEMORY);
+	}
+
+	// Random allocations and frees. Check the alignment and that nothing overlaps
+	{
+		TlsfGpuAllocator talloc;
+		talloc.init(alloc, SIZE);
+
+		std::mt19937 gen(0);
+		std::uniform_int_distribution<U32> sizeDis(1, 256 * 1024);
+		std::uniform_int_distribution<U32> alignmentDis(0, 8);
+
+		std::vector<U8> mem(SIZE, 0);
+		std::vector<TlsfTestAllocation> allocs;
+		U8 nextId = 1;
+
+		for(U32 i = 0; i < 50; ++i)
+		{
+			// Fill up
+			while(1)
+			{
+				TlsfTestAllocation a;
+				const U32 alignment = 1u << alignmentDis(gen);
+				if(talloc.allocate(sizeDis(gen), alignment, nullptr, a.m_handle))
+				{
+					break;
+				}
+
+				ANKI_TEST_EXPECT_EQ(a.m_handle.m_offset % alignment, 0);
+				ANKI_TEST_EXPECT_LEQ(a.m_handle.m_offset + a.m_handle.m_size, SIZE);
+
+				a.m_id = nextId;
+				nextId = (nextId == 255) ? 1 : (nextId + 1);
+				memset(&mem[a.m_handle.m_offset], a.m_id, a.m_handle.m_size);
+				allocs.push_back(a);
+			}
+
+			ANKI_TEST_EXPECT_GT(talloc.getAllocatedMemory(), SIZE * 3 / 4);
+
+			// Free some
+			std::shuffle(allocs.begin(), allocs.end(), gen);
+			const U32 keep = U32(allocs.size() / 2);
+			for(U32 j = keep; j < allocs.size(); ++j)
+			{
+				memset(&mem[allocs[j].m_handle.m_offset], 0, allocs[j].m_handle.m_size);
+				talloc.free(allocs[j].m_handle);
+			}
+			allocs.erase(allocs.begin() + keep, allocs.end());
+
+			for(const TlsfTestAllocation& a : allocs)
+			{
+				ANKI_TEST_EXPECT_EQ(tlsfMemoryIsValid(mem, a), true);
+			}
+		}
+
+		// Free everything. The free blocks should merge back to one
+		for(TlsfTestAllocation& a : allocs)
+		{
+			talloc.free(a.m_handle);
+		}
+
+		ANKI_TEST_EXPECT_EQ(talloc.getAllocatedMemory(), 0);
+		ANKI_TEST_EXPECT_EQ(talloc.getLargestFreeBlockSize(), SIZE);
+	}
+}
+
+ANKI_TEST(Gr, TlsfGpuAllocatorDefragment)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const PtrSize SIZE = 8 * 1024 * 1024;
+
+	TlsfGpuAllocator talloc;
+	talloc.init(alloc, SIZE);
+
+	std::mt19937 gen(1);
+	std::uniform_int_distribution<U32> sizeDis(1, 64 * 1024);
+
+	std::vector<U8> mem(SIZE, 0);
+	std::vector<TlsfTestAllocation*> allocs;
+	U8 nextId = 1;
+
+	// Fill up and free every other allocation to fragment the range
+	while(1)
+	{
+		TlsfTestAllocation* a = new TlsfTestAllocation();
+		if(talloc.allocate(sizeDis(gen), 64, a, a->m_handle))
+		{
+			delete a;
+			break;
+		}
+
+		a->m_id = nextId;
+		nextId = (nextId == 255) ? 1 : (nextId + 1);
+		memset(&mem[a->m_handle.m_offset], a->m_id, a->m_handle.m_size);
+		allocs.push_back(a);
+	}
+
+	std::vector<TlsfTestAllocation*> remaining;
+	for(U32 i = 0; i < allocs.size(); ++i)
+	{
+		if(i % 2)
+		{
+			talloc.free(allocs[i]->m_handle);
+			delete allocs[i];
+		}
+		else
+		{
+			remaining.push_back(allocs[i]);
+		}
+	}
+	allocs = remaining;
+
+	// The immovable allocations stay where they are
+	{
+		DynamicArrayAuto<TlsfGpuAllocatorMove> moves(alloc);
+		talloc.defragment(MAX_PTR_SIZE, moves);
+		ANKI_TEST_EXPECT_EQ(moves.getSize(), 0);
+	}
+
+	for(TlsfTestAllocation* a : allocs)
+	{
+		talloc.setMovable(a->m_handle, true);
+	}
+
+	const PtrSize freeMem = SIZE - talloc.getAllocatedMemory();
+	const PtrSize largestBefore = talloc.getLargestFreeBlockSize();
+	ANKI_TEST_EXPECT_LT(largestBefore, freeMem / 4);
+
+	// Defragment a few times like the users do every frame. Do the copies and free the old memory
+	for(U32 i = 0; i < 8; ++i)
+	{
+		DynamicArrayAuto<TlsfGpuAllocatorMove> moves(alloc);
+		talloc.defragment(SIZE / 4, moves);
+
+		for(TlsfGpuAllocatorMove& move : moves)
+		{
+			ANKI_TEST_EXPECT_LEQ(move.m_dstOffset + move.m_size, move.m_srcOffset);
+
+			TlsfTestAllocation& a = *static_cast<TlsfTestAllocation*>(move.m_userData);
+			ANKI_TEST_EXPECT_EQ(a.m_handle.m_offset, move.m_srcOffset);
+			memcpy(&mem[move.m_dstOffset], &mem[move.m_srcOffset], move.m_size);
+			a.m_handle.m_offset = move.m_dstOffset;
+
+			memset(&mem[move.m_srcOffset], 0, move.m_size);
+			talloc.free(move.m_src);
+		}
+	}
+
+	for(TlsfTestAllocation* a : allocs)
+	{
+		ANKI_TEST_EXPECT_EQ(tlsfMemoryIsValid(mem, *a), true);
+	}
+
+	const PtrSize largestAfter = talloc.getLargestFreeBlockSize();
+	ANKI_TEST_LOGI("Largest free block before %lu after %lu. Free memory %lu",
+		largestBefore,
+		largestAfter,
+		freeMem);
+	ANKI_TEST_EXPECT_EQ(SIZE - talloc.getAllocatedMemory(), freeMem);
+	ANKI_TEST_EXPECT_GT(largestAfter, freeMem / 2);
+
+	for(TlsfTestAllocation* a : allocs)
+	{
+		talloc.free(a->m_handle);
+		delete a;
+	}
+
+	ANKI_TEST_EXPECT_EQ(talloc.getLargestFreeBlockSize(), SIZE);
+}
+
+ANKI_TEST(Gr, TlsfGpuAllocatorBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const PtrSize SIZE = 256 * 1024 * 1024;
+	const U32 ALLOCATION_COUNT = 100000;
+
+	TlsfGpuAllocator talloc;
+	talloc.init(alloc, SIZE);
+
+	std::mt19937 gen(2);
+	std::uniform_int_distribution<U32> sizeDis(16, 4 * 1024);
+	std::vector<TlsfGpuAllocatorHandle> handles(ALLOCATION_COUNT);
+	std::vector<U32> sizes(ALLOCATION_COUNT);
+	for(U32& size : sizes)
+	{
+		size = sizeDis(gen);
+	}
+
+	HighRezTimer timer;
+	timer.start();
+	for(U32 round = 0; round < 10; ++round)
+	{
+		for(U32 i = 0; i < ALLOCATION_COUNT; ++i)
+		{
+			ANKI_TEST_EXPECT_NO_ERR(talloc.allocate(sizes[i], 64, nullptr, handles[i]));
+		}
+
+		for(U32 i = 0; i < ALLOCATION_COUNT; i += 2)
+		{
+			talloc.free(handles[i]);
+		}
+
+		for(U32 i = 1; i < ALLOCATION_COUNT; i += 2)
+		{
+			talloc.free(handles[i]);
+		}
+	}
+	timer.stop();
+
+	ANKI_TEST_LOGI("%u allocations and frees took %f ms",
+		ALLOCATION_COUNT * 10,
+		timer.getElapsedTime() * 1000.0);
+}
+
+} // end namespace anki
@@ -0,0 +1,282 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/renderer/ClusterBin.h>
+#include <anki/renderer/RenderQueue.h>
+#include <anki/core/Config.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+
+namespace anki
+{
+
+static const U32 CLUSTER_COUNT_X = 32;
+static const U32 CLUSTER_COUNT_Y = 26;
+static const U32 CLUSTER_COUNT_Z = 32;
+
+/// A synthetic scene with objects scattered in front of the camera.
+class ClusterBinScene
+{
+public:
+	RenderQueue m_rqueue;
+	DynamicArrayAuto<PointLightQueueElement> m_pointLights;
+	DynamicArrayAuto<SpotLightQueueElement> m_spotLights;
+	DynamicArrayAuto<ReflectionProbeQueueElement> m_probes;
+	DynamicArrayAuto<FogDensityQueueElement> m_fogVolumes;
+
+	ClusterBinScene(HeapAllocator<U8> alloc, U32 pointLightCount, U32 spotLightCount, U32 probeCount, U32 fogCount)
+		: m_pointLights(alloc)
+		, m_spotLights(alloc)
+		, m_probes(alloc)
+		, m_fogVolumes(alloc)
+	{
+		m_rqueue.m_cameraNear = 0.1f;
+		m_rqueue.m_cameraFar = 200.0f;
+		m_rqueue.m_cameraTransform = Mat4(Vec4(10.0f, 2.0f, -5.0f, 1.0f), Mat3(Euler(0.1f, 0.7f, 0.0f)), 1.0f);
+		m_rqueue.m_viewMatrix = m_rqueue.m_cameraTransform.getInverse();
+		m_rqueue.m_projectionMatrix = Mat4::calculatePerspectiveProjectionMatrix(
+			toRad(80.0f), toRad(60.0f), m_rqueue.m_cameraNear, m_rqueue.m_cameraFar);
+		m_rqueue.m_viewProjectionMatrix = m_rqueue.m_projectionMatrix * m_rqueue.m_viewMatrix;
+
+		// Scatter the objects in the frustum and a bit outside of it
+		m_pointLights.create(pointLightCount);
+		for(PointLightQueueElement& light : m_pointLights)
+		{
+			light.m_worldPosition = randomPosition();
+			light.m_radius = randRange(0.5f, 4.0f);
+		}
+
+		m_spotLights.create(spotLightCount);
+		for(SpotLightQueueElement& light : m_spotLights)
+		{
+			const Mat3 rot(Euler(randRange(0.0f, PI), randRange(0.0f, PI), randRange(0.0f, PI)));
+			light.m_worldTransform = Mat4(randomPosition().xyz1(), rot, 1.0f);
+			light.m_distance = randRange(1.0f, 8.0f);
+			light.m_outerAngle = randRange(toRad(10.0f), toRad(90.0f));
+			light.m_innerAngle = light.m_outerAngle / 2.0f;
+		}
+
+		m_probes.create(probeCount);
+		for(ReflectionProbeQueueElement& probe : m_probes)
+		{
+			probe.m_worldPosition = randomPosition();
+			probe.m_aabbMin = probe.m_worldPosition - Vec3(randRange(0.5f, 8.0f));
+			probe.m_aabbMax = probe.m_worldPosition + Vec3(randRange(0.5f, 8.0f));
+		}
+
+		m_fogVolumes.create(fogCount);
+		for(FogDensityQueueElement& fog : m_fogVolumes)
+		{
+			fog.m_isBox = (randRange(0.0f, 1.0f) < 0.5f);
+			fog.m_density = 1.0f;
+			if(fog.m_isBox)
+			{
+				const Vec3 center = randomPosition();
+				fog.m_aabbMin = center - Vec3(randRange(0.5f, 4.0f));
+				fog.m_aabbMax = center + Vec3(randRange(0.5f, 4.0f));
+			}
+			else
+			{
+				fog.m_sphereCenter = randomPosition();
+				fog.m_sphereRadius = randRange(0.5f, 4.0f);
+			}
+		}
+
+		m_rqueue.m_pointLights = WeakArray<PointLightQueueElement>(m_pointLights);
+		m_rqueue.m_spotLights = WeakArray<SpotLightQueueElement>(m_spotLights);
+		m_rqueue.m_reflectionProbes = WeakArray<ReflectionProbeQueueElement>(m_probes);
+		m_rqueue.m_fogDensityVolumes = WeakArray<FogDensityQueueElement>(m_fogVolumes);
+	}
+
+	Vec3 randomPosition() const
+	{
+		const F32 depth = randRange(1.0f, 120.0f);
+		const Vec4 viewPos(randRange(-depth, depth), randRange(-depth, depth) * 0.7f, -depth, 1.0f);
+		return (m_rqueue.m_cameraTransform * viewPos).xyz();
+	}
+};
+
+/// Walk the objects of a type in a cluster.
+static ConstWeakArray<U32> getClusterObjects(
+	ConstWeakArray<U32> clusters, ConstWeakArray<U32> indices, U32 clusterIdx, U32 objectType)
+{
+	U32 first = clusters[clusterIdx];
+	if(objectType > 0)
+	{
+		first = indices[first - TYPED_OBJECT_COUNT + objectType];
+	}
+
+	U32 count = 0;
+	while(indices[first + count] != MAX_U32)
+	{
+		++count;
+	}
+
+	return ConstWeakArray<U32>(&indices[first], count);
+}
+
+static Bool clusterHasObject(ConstWeakArray<U32> objects, U32 idx)
+{
+	for(U32 i : objects)
+	{
+		if(i == idx)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+ANKI_TEST(Renderer, ClusterBin)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	StackAllocator<U8> tempAlloc(allocAligned, nullptr, 1024 * 1024);
+	ThreadHive hive(4, alloc);
+
+	Config config;
+	config.set("r.avgObjectsPerCluster", 64);
+
+	ClusterBin clusterBin;
+	clusterBin.init(alloc, CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, config);
+
+	ClusterBinScene scene(alloc, 200, 50, 20, 20);
+
+	ClusterBinIn in;
+	in.m_threadHive = &hive;
+	in.m_tempAlloc = tempAlloc;
+	in.m_renderQueue = &scene.m_rqueue;
+	in.m_stagingMem = nullptr;
+	in.m_shadowsEnabled = false;
+
+	DynamicArrayAuto<U32> clusters(alloc);
+	clusters.create(clusterBin.getTotalClusterCount());
+	DynamicArrayAuto<U32> indices(alloc);
+	indices.create(clusterBin.getIndexCount());
+
+	ClusterBinOut out;
+	clusterBin.bin(in, out, WeakArray<U32>(clusters), WeakArray<U32>(indices));
+
+	// Pick points in the view frustum, find their cluster and check that the objects that touch them are in it
+	const F32 calcNearOpt = out.m_shaderMagicValues.m_val1.x();
+	const F32 near = out.m_shaderMagicValues.m_val1.y();
+	for(U i = 0; i < 20000; ++i)
+	{
+		const Vec3 pos = scene.randomPosition();
+
+		Vec4 ndc = scene.m_rqueue.m_viewProjectionMatrix * pos.xyz1();
+		ndc /= ndc.w();
+		if(absolute(ndc.x()) >= 1.0f || absolute(ndc.y()) >= 1.0f)
+		{
+			continue;
+		}
+
+		const U32 tileX = U32((ndc.x() * 0.5f + 0.5f) * CLUSTER_COUNT_X);
+		const U32 tileY = U32((ndc.y() * 0.5f + 0.5f) * CLUSTER_COUNT_Y);
+		const F32 depth = -(scene.m_rqueue.m_viewMatrix * pos.xyz1()).z();
+		const U32 k = min(U32(sqrt((depth - near) / calcNearOpt)), CLUSTER_COUNT_Z - 1);
+		const U32 clusterIdx = k * CLUSTER_COUNT_X * CLUSTER_COUNT_Y + tileY * CLUSTER_COUNT_X + tileX;
+
+		const ConstWeakArray<U32> pointLights = getClusterObjects(clusters, indices, clusterIdx, 0);
+		for(U32 l = 0; l < scene.m_pointLights.getSize(); ++l)
+		{
+			const PointLightQueueElement& light = scene.m_pointLights[l];
+			if((light.m_worldPosition - pos).getLength() < light.m_radius * 0.99f)
+			{
+				ANKI_TEST_EXPECT_EQ(clusterHasObject(pointLights, l), true);
+			}
+		}
+
+		const ConstWeakArray<U32> spotLights = getClusterObjects(clusters, indices, clusterIdx, 1);
+		for(U32 l = 0; l < scene.m_spotLights.getSize(); ++l)
+		{
+			const SpotLightQueueElement& light = scene.m_spotLights[l];
+			const Vec3 lightPos = light.m_worldTransform.getTranslationPart().xyz();
+			const Vec3 lightDir = -light.m_worldTransform.getRotationPart().getZAxis();
+			const Vec3 toPos = pos - lightPos;
+			const F32 dist = toPos.getLength();
+			if(dist < light.m_distance * 0.99f && dist > EPSILON
+				&& toPos.dot(lightDir) / dist > cos(light.m_outerAngle / 2.0f * 0.99f))
+			{
+				ANKI_TEST_EXPECT_EQ(clusterHasObject(spotLights, l), true);
+			}
+		}
+
+		const ConstWeakArray<U32> probes = getClusterObjects(clusters, indices, clusterIdx, 2);
+		for(U32 p = 0; p < scene.m_probes.getSize(); ++p)
+		{
+			const ReflectionProbeQueueElement& probe = scene.m_probes[p];
+			if(pos > probe.m_aabbMin && pos < probe.m_aabbMax)
+			{
+				ANKI_TEST_EXPECT_EQ(clusterHasObject(probes, p), true);
+			}
+		}
+
+		const ConstWeakArray<U32> fogVolumes = getClusterObjects(clusters, indices, clusterIdx, 4);
+		for(U32 f = 0; f < scene.m_fogVolumes.getSize(); ++f)
+		{
+			const FogDensityQueueElement& fog = scene.m_fogVolumes[f];
+			const Bool inside = (fog.m_isBox) ? (pos > fog.m_aabbMin && pos < fog.m_aabbMax)
+											  : ((fog.m_sphereCenter - pos).getLength() < fog.m_sphereRadius * 0.99f);
+			if(inside)
+			{
+				ANKI_TEST_EXPECT_EQ(clusterHasObject(fogVolumes, f), true);
+			}
+		}
+	}
+}
+
+ANKI_TEST(Renderer, ClusterBinBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	StackAllocator<U8> tempAlloc(allocAligned, nullptr, 1024 * 1024);
+	ThreadHive hive(getCpuCoresCount(), alloc);
+
+	Config config;
+	config.set("r.avgObjectsPerCluster", 128);
+
+	ClusterBin clusterBin;
+	clusterBin.init(alloc, CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z, config);
+
+	DynamicArrayAuto<U32> clusters(alloc);
+	clusters.create(clusterBin.getTotalClusterCount());
+	DynamicArrayAuto<U32> indices(alloc);
+	indices.create(clusterBin.getIndexCount());
+
+	const U32 ITERATIONS = 10;
+	const Array<U32, 3> lightCounts = {{100, 500, 2000}};
+	for(U32 lightCount : lightCounts)
+	{
+		ClusterBinScene scene(alloc, lightCount, lightCount / 4, 16, 16);
+
+		ClusterBinIn in;
+		in.m_threadHive = &hive;
+		in.m_tempAlloc = tempAlloc;
+		in.m_renderQueue = &scene.m_rqueue;
+		in.m_stagingMem = nullptr;
+		in.m_shadowsEnabled = false;
+
+		Second time = 0.0;
+		for(U32 i = 0; i < ITERATIONS; ++i)
+		{
+			ClusterBinOut out;
+			const Second begin = HighRezTimer::getCurrentTime();
+			clusterBin.bin(in, out, WeakArray<U32>(clusters), WeakArray<U32>(indices));
+			time += HighRezTimer::getCurrentTime() - begin;
+		}
+
+		ANKI_TEST_LOGI("Binning %u point lights and %u spot lights to %ux%ux%u clusters: %fms",
+			lightCount,
+			lightCount / 4,
+			CLUSTER_COUNT_X,
+			CLUSTER_COUNT_Y,
+			CLUSTER_COUNT_Z,
+			time * 1000.0 / ITERATIONS);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,397 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/AnimationClip.h>
+#include <anki/resource/ResourceFilesystem.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/File.h>
+#include <vector>
+
+namespace anki
+{
+
+namespace
+{
+
+/// A ResourceFile on top of a File.
+class TestResourceFile : public ResourceFile
+{
+public:
+	File m_file;
+
+	TestResourceFile(GenericMemoryPoolAllocator<U8> alloc)
+		: ResourceFile(alloc)
+	{
+	}
+
+	ANKI_USE_RESULT Error read(void* buff, PtrSize size) override
+	{
+		return m_file.read(buff, size);
+	}
+
+	ANKI_USE_RESULT Error readAllText(GenericMemoryPoolAllocator<U8> alloc, String& out) override
+	{
+		return m_file.readAllText(alloc, out);
+	}
+
+	ANKI_USE_RESULT Error readU32(U32& u) override
+	{
+		return m_file.readU32(u);
+	}
+
+	ANKI_USE_RESULT Error readF32(F32& f) override
+	{
+		return m_file.readF32(f);
+	}
+
+	ANKI_USE_RESULT Error seek(PtrSize offset, SeekOrigin origin) override
+	{
+		return m_file.seek(offset, origin);
+	}
+
+	PtrSize getSize() const override
+	{
+		return m_file.getSize();
+	}
+};
+
+} // end namespace
+
+/// Create channels with 30 keys per second. Every 4th channel has a linear position and no scale, every 8th one
+/// doesn't move and the rest move on curves.
+static void createChannels(
+	HeapAllocator<U8> alloc, U32 channelCount, Second duration, std::vector<AnimationChannel>& channels)
+{
+	const U32 keyCount = U32(duration * 30.0) + 1;
+	channels.resize(channelCount);
+	for(U32 c = 0; c < channelCount; ++c)
+	{
+		AnimationChannel& ch = channels[c];
+		ch.m_name.sprintf(alloc, "bone%u", c);
+
+		const Bool still = (c % 8) == 0;
+		const Bool linear = (c % 4) == 0;
+
+		ch.m_positions.create(alloc, keyCount);
+		ch.m_rotations.create(alloc, keyCount);
+		if(!linear)
+		{
+			ch.m_scales.create(alloc, keyCount);
+		}
+
+		for(U32 k = 0; k < keyCount; ++k)
+		{
+			const Second time = duration * Second(k) / Second(keyCount - 1);
+			const F32 t = (still) ? 0.0f : F32(time);
+
+			const Vec3 pos = (linear) ? Vec3(t * 0.5f, 1.0f, -t) : Vec3(sin(t * 2.0f + F32(c)), cos(t), 0.1f * F32(c));
+			ch.m_positions[k] = AnimationKeyframe<Vec3>(time, pos);
+
+			Mat3 rot = Mat3::getIdentity();
+			rot.rotateXAxis(sin(t + F32(c)));
+			rot.rotateYAxis(t * 0.7f);
+			ch.m_rotations[k] = AnimationKeyframe<Quat>(time, Quat(rot));
+
+			if(!linear)
+			{
+				ch.m_scales[k] = AnimationKeyframe<F32>(time, 1.0f + 0.2f * sin(t * 3.0f));
+			}
+		}
+	}
+}
+
+static void destroyChannels(HeapAllocator<U8> alloc, std::vector<AnimationChannel>& channels)
+{
+	for(AnimationChannel& ch : channels)
+	{
+		ch.destroy(alloc);
+	}
+}
+
+/// Sample a channel like the AnimationResource used to. It scans the keys from the first and uses slerp.
+static void sampleReference(const AnimationChannel& ch, Second time, Vec3& pos, Quat& rot, F32& scale)
+{
+	pos = Vec3(0.0f);
+	for(U32 i = 0; i + 1 < ch.m_positions.getSize(); ++i)
+	{
+		const AnimationKeyframe<Vec3>& left = ch.m_positions[i];
+		const AnimationKeyframe<Vec3>& right = ch.m_positions[i + 1];
+		if(time >= left.getTime() && time <= right.getTime())
+		{
+			const F32 u = F32((time - left.getTime()) / (right.getTime() - left.getTime()));
+			pos = linearInterpolate(left.getValue(), right.getValue(), u);
+			break;
+		}
+	}
+
+	rot = Quat::getIdentity();
+	for(U32 i = 0; i + 1 < ch.m_rotations.getSize(); ++i)
+	{
+		const AnimationKeyframe<Quat>& left = ch.m_rotations[i];
+		const AnimationKeyframe<Quat>& right = ch.m_rotations[i + 1];
+		if(time >= left.getTime() && time <= right.getTime())
+		{
+			const F32 u = F32((time - left.getTime()) / (right.getTime() - left.getTime()));
+			rot = left.getValue().slerp(right.getValue(), u);
+			break;
+		}
+	}
+
+	scale = 1.0f;
+	for(U32 i = 0; i + 1 < ch.m_scales.getSize(); ++i)
+	{
+		const AnimationKeyframe<F32>& left = ch.m_scales[i];
+		const AnimationKeyframe<F32>& right = ch.m_scales[i + 1];
+		if(time >= left.getTime() && time <= right.getTime())
+		{
+			const F32 u = F32((time - left.getTime()) / (right.getTime() - left.getTime()));
+			scale = linearInterpolate(left.getValue(), right.getValue(), u);
+			break;
+		}
+	}
+}
+
+/// The distance of two rotations. q and -q are the same rotation.
+static F32 rotationDistance(const Quat& a, const Quat& b)
+{
+	const Vec4 va(a.x(), a.y(), a.z(), a.w());
+	const Vec4 vb(b.x(), b.y(), b.z(), b.w());
+	return min((va - vb).getLength(), (va + vb).getLength());
+}
+
+ANKI_TEST(Resource, AnimationClip)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 CHANNEL_COUNT = 13;
+	const Second DURATION = 4.0;
+
+	std::vector<AnimationChannel> channels;
+	createChannels(alloc, CHANNEL_COUNT, DURATION, channels);
+
+	AnimationClip clip(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(clip.compress(ConstWeakArray<AnimationChannel>(&channels[0], channels.size())));
+	ANKI_TEST_EXPECT_EQ(clip.getChannelCount(), CHANNEL_COUNT);
+	ANKI_TEST_EXPECT_NEAR(clip.getStartingTime(), 0.0, 0.0001);
+	ANKI_TEST_EXPECT_NEAR(clip.getDuration(), DURATION, 0.0001);
+	ANKI_TEST_EXPECT_EQ(clip.getChannelName(3), CString("bone3"));
+
+	// The keys that can be interpolated are gone
+	U32 keyCount = 0;
+	for(const AnimationChannel& ch : channels)
+	{
+		keyCount += U32(ch.m_positions.getSize() + ch.m_rotations.getSize() + ch.m_scales.getSize());
+	}
+	ANKI_TEST_EXPECT_LT(clip.getKeyCount(), keyCount * 3 / 4);
+
+	// A channel that doesn't move has one key per track
+	{
+		AnimationClip still(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(still.compress(ConstWeakArray<AnimationChannel>(&channels[0], 1)));
+		ANKI_TEST_EXPECT_EQ(still.getKeyCount(), 3);
+	}
+
+	// Save and load it back
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./anim.ankianim", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(clip.save(file));
+	}
+
+	AnimationClip loaded(alloc);
+	{
+		TestResourceFile file(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(file.m_file.open("./anim.ankianim", FileOpenFlag::READ | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(loaded.load(file));
+	}
+	ANKI_TEST_EXPECT_EQ(loaded.getKeyCount(), clip.getKeyCount());
+
+	// Compare against the uncompressed channels. Play it more than once so the cursor wraps
+	AnimationCursor cursor;
+	cursor.create(alloc, loaded);
+	std::vector<Vec3> positions(CHANNEL_COUNT);
+	std::vector<Quat> rotations(CHANNEL_COUNT);
+	std::vector<F32> scales(CHANNEL_COUNT);
+
+	F32 maxPosError = 0.0f;
+	F32 maxRotError = 0.0f;
+	F32 maxScaleError = 0.0f;
+	F32 maxCursorError = 0.0f;
+	for(Second time = 0.0; time < DURATION * 2.5; time += 1.0 / 47.0)
+	{
+		loaded.sampleAll(time,
+			cursor,
+			WeakArray<Vec3>(&positions[0], CHANNEL_COUNT),
+			WeakArray<Quat>(&rotations[0], CHANNEL_COUNT),
+			WeakArray<F32>(&scales[0], CHANNEL_COUNT));
+
+		const Second wrappedTime = (time > DURATION) ? mod(time, DURATION) : time;
+		for(U32 c = 0; c < CHANNEL_COUNT; ++c)
+		{
+			Vec3 refPos, pos;
+			Quat refRot, rot;
+			F32 refScale, scale;
+			sampleReference(channels[c], wrappedTime, refPos, refRot, refScale);
+			loaded.sample(c, time, pos, rot, scale);
+
+			maxPosError = max(maxPosError, (pos - refPos).getLength());
+			maxRotError = max(maxRotError, rotationDistance(rot, refRot));
+			maxScaleError = max(maxScaleError, absolute(scale - refScale));
+
+			// The batch sampling with the cursor gets the same
+			maxCursorError = max(maxCursorError, (positions[c] - pos).getLength());
+			maxCursorError = max(maxCursorError, rotationDistance(rotations[c], rot));
+			maxCursorError = max(maxCursorError, absolute(scales[c] - scale));
+		}
+	}
+
+	ANKI_TEST_EXPECT_LT(maxPosError, AnimationClip::DEFAULT_POSITION_TOLERANCE * 1.01f);
+	ANKI_TEST_EXPECT_LT(maxRotError, 0.002f);
+	ANKI_TEST_EXPECT_LT(maxScaleError, 0.001f);
+	ANKI_TEST_EXPECT_LT(maxCursorError, 0.00001f);
+
+	cursor.destroy(alloc);
+	destroyChannels(alloc, channels);
+
+	// Channels that move far, like root motion, stay within the tolerance as well
+	{
+		std::vector<AnimationChannel> farChannels;
+		createChannels(alloc, 2, DURATION, farChannels);
+		for(AnimationChannel& ch : farChannels)
+		{
+			for(AnimationKeyframe<Vec3>& key : ch.m_positions)
+			{
+				key = AnimationKeyframe<Vec3>(key.getTime(), key.getValue() * 40.0f);
+			}
+		}
+
+		AnimationClip farClip(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(
+			farClip.compress(ConstWeakArray<AnimationChannel>(&farChannels[0], farChannels.size())));
+
+		F32 maxFarError = 0.0f;
+		for(Second time = 0.0; time < DURATION; time += 1.0 / 47.0)
+		{
+			for(U32 c = 0; c < farChannels.size(); ++c)
+			{
+				Vec3 refPos, pos;
+				Quat refRot, rot;
+				F32 refScale, scale;
+				sampleReference(farChannels[c], time, refPos, refRot, refScale);
+				farClip.sample(c, time, pos, rot, scale);
+				maxFarError = max(maxFarError, (pos - refPos).getLength());
+			}
+		}
+
+		ANKI_TEST_EXPECT_LT(maxFarError, AnimationClip::DEFAULT_POSITION_TOLERANCE * 1.01f);
+		destroyChannels(alloc, farChannels);
+	}
+}
+
+/// Sample 500 instances of a 200 bone animation the way the AnimationResource used to and with the compressed clip.
+ANKI_TEST(Resource, AnimationClipBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 BONE_COUNT = 200;
+	const U32 INSTANCE_COUNT = 500;
+	const U32 FRAME_COUNT = 20;
+	const Second DURATION = 10.0;
+
+	std::vector<AnimationChannel> channels;
+	createChannels(alloc, BONE_COUNT, DURATION, channels);
+
+	AnimationClip clip(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(clip.compress(ConstWeakArray<AnimationChannel>(&channels[0], channels.size())));
+
+	// The instances started playing at different times
+	std::vector<Second> startTimes(INSTANCE_COUNT);
+	std::vector<AnimationCursor> cursors(INSTANCE_COUNT);
+	for(U32 i = 0; i < INSTANCE_COUNT; ++i)
+	{
+		startTimes[i] = DURATION * Second(i) / Second(INSTANCE_COUNT);
+		cursors[i].create(alloc, clip);
+	}
+
+	std::vector<Vec3> positions(BONE_COUNT);
+	std::vector<Quat> rotations(BONE_COUNT);
+	std::vector<F32> scales(BONE_COUNT);
+	F32 sum = 0.0f;
+
+	Second scanTime = 0.0;
+	Second searchTime = 0.0;
+	Second cursorTime = 0.0;
+	for(U32 frame = 0; frame < FRAME_COUNT; ++frame)
+	{
+		const Second frameTime = Second(frame) / 60.0;
+
+		Second begin = HighRezTimer::getCurrentTime();
+		for(U32 i = 0; i < INSTANCE_COUNT; ++i)
+		{
+			const Second time = mod(startTimes[i] + frameTime, DURATION);
+			for(U32 b = 0; b < BONE_COUNT; ++b)
+			{
+				sampleReference(channels[b], time, positions[b], rotations[b], scales[b]);
+			}
+			sum += positions[BONE_COUNT - 1].x();
+		}
+		scanTime += HighRezTimer::getCurrentTime() - begin;
+
+		begin = HighRezTimer::getCurrentTime();
+		for(U32 i = 0; i < INSTANCE_COUNT; ++i)
+		{
+			for(U32 b = 0; b < BONE_COUNT; ++b)
+			{
+				clip.sample(b, startTimes[i] + frameTime, positions[b], rotations[b], scales[b]);
+			}
+			sum += positions[BONE_COUNT - 1].x();
+		}
+		searchTime += HighRezTimer::getCurrentTime() - begin;
+
+		begin = HighRezTimer::getCurrentTime();
+		for(U32 i = 0; i < INSTANCE_COUNT; ++i)
+		{
+			clip.sampleAll(startTimes[i] + frameTime,
+				cursors[i],
+				WeakArray<Vec3>(&positions[0], BONE_COUNT),
+				WeakArray<Quat>(&rotations[0], BONE_COUNT),
+				WeakArray<F32>(&scales[0], BONE_COUNT));
+			sum += positions[BONE_COUNT - 1].x();
+		}
+		cursorTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	PtrSize uncompressedSize = 0;
+	for(const AnimationChannel& ch : channels)
+	{
+		uncompressedSize += ch.m_positions.getSizeInBytes() + ch.m_rotations.getSizeInBytes();
+		uncompressedSize += ch.m_scales.getSizeInBytes();
+	}
+
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./bench.ankianim", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(clip.save(file));
+	}
+
+	File file;
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./bench.ankianim", FileOpenFlag::READ | FileOpenFlag::BINARY));
+
+	ANKI_TEST_LOGI("Sampling %u instances of %u bones: scan %fms, search %fms, cursor and batch %fms (%f)",
+		INSTANCE_COUNT,
+		BONE_COUNT,
+		scanTime / FRAME_COUNT * 1000.0,
+		searchTime / FRAME_COUNT * 1000.0,
+		cursorTime / FRAME_COUNT * 1000.0,
+		sum);
+	ANKI_TEST_LOGI("Keyframes: %fKB uncompressed, %fKB compressed", uncompressedSize / 1024.0, file.getSize() / 1024.0);
+
+	for(AnimationCursor& cursor : cursors)
+	{
+		cursor.destroy(alloc);
+	}
+	destroyChannels(alloc, channels);
+}
+
+} // end namespace anki
@@ -97,6 +97,43 @@ public:
 	}
 };
 
+/// Writes its ID to an array when it's executed.
+class OrderTask : public AsyncLoaderTask
+{
+public:
+	U32 m_id;
+	U32* m_order;
+	Atomic<U32>* m_count;
+	F32 m_sleepTime;
+
+	OrderTask(U32 id, U32* order, Atomic<U32>* count, F32 sleepTime = 0.0)
+		: m_id(id)
+		, m_order(order)
+		, m_count(count)
+		, m_sleepTime(sleepTime)
+	{
+	}
+
+	Error operator()(AsyncLoaderTaskContext& ctx)
+	{
+		if(m_sleepTime != 0.0)
+		{
+			HighRezTimer::sleep(m_sleepTime);
+		}
+
+		m_order[m_count->fetchAdd(1)] = m_id;
+		return Error::NONE;
+	}
+};
+
+static void waitForTasks(const AsyncLoader& a, U64 count)
+{
+	while(a.getCompletedTaskCount() < count)
+	{
+		HighRezTimer::sleep(0.001);
+	}
+}
+
 ANKI_TEST(Resource, AsyncLoader)
 {
 	HeapAllocator<U8> alloc(allocAligned, nullptr);
@@ -269,4 +306,156 @@ ANKI_TEST(Resource, AsyncLoader)
 	}
 }
 
+ANKI_TEST(Resource, AsyncLoaderPriorities)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 COUNT = 30;
+
+	// Priority order
+	{
+		AsyncLoader a;
+		a.init(alloc);
+		Array<U32, COUNT> order;
+		Atomic<U32> counter = {0};
+
+		// Submit paused so the order doesn't depend on timing
+		a.pause();
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			const AsyncLoaderTaskPriority prio = AsyncLoaderTaskPriority(i % U32(AsyncLoaderTaskPriority::COUNT));
+			a.submitTask(a.newTask<OrderTask>(i, &order[0], &counter), prio);
+		}
+		ANKI_TEST_EXPECT_EQ(a.getPendingTaskCount(), COUNT);
+		a.resume();
+		waitForTasks(a, COUNT);
+
+		// High first, then medium, then low. FIFO inside a priority
+		const U32 prioCount = U32(AsyncLoaderTaskPriority::COUNT);
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			const U32 perPrio = COUNT / prioCount;
+			ANKI_TEST_EXPECT_EQ(order[i], (i % perPrio) * prioCount + i / perPrio);
+		}
+
+		for(U32 prio = 0; prio < prioCount; ++prio)
+		{
+			const AsyncLoaderPriorityStats stats = a.getStats(AsyncLoaderTaskPriority(prio));
+			ANKI_TEST_EXPECT_EQ(stats.m_submittedCount, COUNT / prioCount);
+			ANKI_TEST_EXPECT_EQ(stats.m_completedCount, COUNT / prioCount);
+			ANKI_TEST_EXPECT_EQ(stats.m_failedCount, 0);
+			ANKI_TEST_EXPECT_EQ(stats.m_cancelledCount, 0);
+		}
+	}
+
+	// Re-prioritize
+	{
+		AsyncLoader a;
+		a.init(alloc);
+		Array<U32, COUNT> order;
+		Atomic<U32> counter = {0};
+
+		a.pause();
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			a.submitTask(a.newTask<OrderTask>(i, &order[0], &counter), AsyncLoaderTaskPriority::LOW);
+		}
+
+		// Move the odd ones to high, like when something comes closer to the camera
+		a.reprioritizePendingTasks([](const AsyncLoaderTask& task) {
+			return (static_cast<const OrderTask&>(task).m_id & 1) ? AsyncLoaderTaskPriority::HIGH
+																	: AsyncLoaderTaskPriority::LOW;
+		});
+		a.resume();
+		waitForTasks(a, COUNT);
+
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			const U32 expected = (i < COUNT / 2) ? (i * 2 + 1) : ((i - COUNT / 2) * 2);
+			ANKI_TEST_EXPECT_EQ(order[i], expected);
+		}
+	}
+
+	// Cancel
+	{
+		AsyncLoader a;
+		a.init(alloc, 2);
+		Array<U32, COUNT> order;
+		Atomic<U32> counter = {0};
+
+		a.pause();
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			a.submitTask(a.newTask<OrderTask>(i, &order[0], &counter), AsyncLoaderTaskPriority::MEDIUM);
+		}
+
+		const U32 cancelled = a.cancelPendingTasks([](const AsyncLoaderTask& task) {
+			// Cancel the last ones
+			return static_cast<const OrderTask&>(task).m_id >= 10;
+		});
+		ANKI_TEST_EXPECT_EQ(cancelled, COUNT - 10);
+		ANKI_TEST_EXPECT_EQ(a.getPendingTaskCount(), 10);
+		a.resume();
+		waitForTasks(a, 10);
+		a.pause();
+
+		ANKI_TEST_EXPECT_EQ(counter.load(), 10);
+		ANKI_TEST_EXPECT_EQ(a.getPendingTaskCount(), 0);
+		for(U32 i = 0; i < 10; ++i)
+		{
+			ANKI_TEST_EXPECT_LT(order[i], 10);
+		}
+
+		const AsyncLoaderPriorityStats stats = a.getStats(AsyncLoaderTaskPriority::MEDIUM);
+		ANKI_TEST_EXPECT_EQ(stats.m_completedCount, 10);
+		ANKI_TEST_EXPECT_EQ(stats.m_cancelledCount, COUNT - 10);
+	}
+
+	// Pause waits for all the running tasks
+	{
+		AsyncLoader a;
+		a.init(alloc, 4);
+		Array<U32, 4> order;
+		Atomic<U32> counter = {0};
+
+		for(U32 i = 0; i < 4; ++i)
+		{
+			a.submitNewTask<OrderTask>(i, &order[0], &counter, 0.2);
+		}
+
+		HighRezTimer::sleep(0.1);
+		a.pause();
+		ANKI_TEST_EXPECT_EQ(counter.load(), 4);
+		a.resume();
+	}
+}
+
+ANKI_TEST(Resource, AsyncLoaderThroughput)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 COUNT = 64;
+	const F32 TASK_TIME = 0.01f; // Sleep to simulate IO
+
+	Array<Second, 2> times;
+	Array<U32, 2> threadCounts = {{1, 4}};
+	for(U32 t = 0; t < 2; ++t)
+	{
+		AsyncLoader a;
+		a.init(alloc, threadCounts[t]);
+		Array<U32, COUNT> order;
+		Atomic<U32> counter = {0};
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			a.submitNewTask<OrderTask>(i, &order[0], &counter, TASK_TIME);
+		}
+		waitForTasks(a, COUNT);
+		times[t] = HighRezTimer::getCurrentTime() - begin;
+
+		printf("%u tasks with %u threads: %fms\n", COUNT, threadCounts[t], times[t] * 1000.0);
+	}
+
+	ANKI_TEST_EXPECT_LT(times[1], times[0]);
+}
+
 } // end namespace anki
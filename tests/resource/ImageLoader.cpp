@@ -0,0 +1,191 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/ImageLoader.h>
+#include <anki/resource/ResourceFilesystem.h>
+#include <anki/util/File.h>
+#include <anki/util/Filesystem.h>
+
+namespace anki
+{
+
+static const U TEX_SIZE = 64;
+static const U TEX_MIPS = 5;
+
+static U8 texelValue(U mip, U texel)
+{
+	return U8(mip * 32 + texel % 32);
+}
+
+/// Write a 64x64 RGBA8 raw texture. Every texel of a mip has a value that depends on the mip.
+static Error writeAnkiTexture(CString filename,
+	Bool version2,
+	Bool wrongMipSize = false,
+	ImageLoader::TextureType type = ImageLoader::TextureType::_2D)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	AnkiTextureFile::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header.m_magic[0], (version2) ? AnkiTextureFile::MAGIC : AnkiTextureFile::MAGIC_V1, 8);
+	header.m_width = TEX_SIZE;
+	header.m_height = TEX_SIZE;
+	header.m_depthOrLayerCount = 1;
+	header.m_type = type;
+	header.m_colorFormat = ImageLoader::ColorFormat::RGBA8;
+	header.m_compressionFormats = ImageLoader::DataCompression::RAW;
+	header.m_mipLevels = TEX_MIPS;
+
+	File file;
+	ANKI_CHECK(file.open(filename, FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_CHECK(file.write(&header, sizeof(header)));
+
+	// Version 2 has the mip infos and the mips are coarse to fine
+	Array<AnkiTextureFile::MipInfo, TEX_MIPS * AnkiTextureFile::COMPRESSION_COUNT> mipInfos;
+	memset(&mipInfos[0], 0, sizeof(mipInfos));
+	if(version2)
+	{
+		PtrSize offset = sizeof(header) + sizeof(mipInfos);
+		for(I mip = TEX_MIPS - 1; mip >= 0; --mip)
+		{
+			const PtrSize size = (TEX_SIZE >> mip) * (TEX_SIZE >> mip) * 4;
+			mipInfos[mip].m_offset = offset;
+			mipInfos[mip].m_size = (wrongMipSize) ? size / 2 : size;
+			offset += size;
+		}
+
+		ANKI_CHECK(file.write(&mipInfos[0], sizeof(mipInfos)));
+	}
+
+	for(U i = 0; i < TEX_MIPS; ++i)
+	{
+		const U mip = (version2) ? (TEX_MIPS - 1 - i) : i;
+		DynamicArrayAuto<U8> data(alloc);
+		data.create((TEX_SIZE >> mip) * (TEX_SIZE >> mip) * 4);
+		for(U texel = 0; texel < data.getSize(); ++texel)
+		{
+			data[texel] = texelValue(mip, texel);
+		}
+
+		ANKI_CHECK(file.write(&data[0], data.getSize()));
+	}
+
+	return Error::NONE;
+}
+
+static Bool checkSurface(const ImageLoader& loader, U mip, U fileMip)
+{
+	const ImageLoader::Surface& surf = loader.getSurface(mip, 0, 0);
+	if(surf.m_width != (TEX_SIZE >> fileMip) || surf.m_data.getSize() != surf.m_width * surf.m_width * 4)
+	{
+		return false;
+	}
+
+	for(U texel = 0; texel < surf.m_data.getSize(); ++texel)
+	{
+		if(surf.m_data[texel] != texelValue(fileMip, texel))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ANKI_TEST(Resource, ImageLoaderAnkiTexture)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const CString dir = "./ankitex_test";
+	if(directoryExists(dir))
+	{
+		ANKI_TEST_EXPECT_NO_ERR(removeDirectory(dir));
+	}
+	ANKI_TEST_EXPECT_NO_ERR(createDirectory(dir));
+	ANKI_TEST_EXPECT_NO_ERR(writeAnkiTexture("./ankitex_test/v1.ankitex", false));
+	ANKI_TEST_EXPECT_NO_ERR(writeAnkiTexture("./ankitex_test/v2.ankitex", true));
+	ANKI_TEST_EXPECT_NO_ERR(writeAnkiTexture("./ankitex_test/broken.ankitex", true, true));
+	ANKI_TEST_EXPECT_NO_ERR(
+		writeAnkiTexture("./ankitex_test/array.ankitex", true, false, ImageLoader::TextureType::_2D_ARRAY));
+
+	ResourceFilesystem fs(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(fs.addNewPath(dir));
+
+	for(CString fname : {CString("v1.ankitex"), CString("v2.ankitex")})
+	{
+		// All the mips
+		{
+			ResourceFilePtr file;
+			ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fname, file));
+			ImageLoader loader(alloc);
+			ANKI_TEST_EXPECT_NO_ERR(loader.load(file, fname));
+
+			ANKI_TEST_EXPECT_EQ(loader.getWidth(), TEX_SIZE);
+			ANKI_TEST_EXPECT_EQ(loader.getMipLevelsCount(), TEX_MIPS);
+			ANKI_TEST_EXPECT_EQ(loader.getFirstLoadedMipLevel(), 0);
+			for(U mip = 0; mip < TEX_MIPS; ++mip)
+			{
+				ANKI_TEST_EXPECT_EQ(checkSurface(loader, mip, mip), true);
+			}
+		}
+
+		// The mip tail
+		{
+			ResourceFilePtr file;
+			ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fname, file));
+			ImageLoader loader(alloc);
+			ANKI_TEST_EXPECT_NO_ERR(loader.load(file, fname, MAX_U32, 16));
+
+			ANKI_TEST_EXPECT_EQ(loader.getWidth(), TEX_SIZE);
+			ANKI_TEST_EXPECT_EQ(loader.getMipLevelsCount(), TEX_MIPS);
+			ANKI_TEST_EXPECT_EQ(loader.getFirstLoadedMipLevel(), 2);
+			for(U mip = 2; mip < TEX_MIPS; ++mip)
+			{
+				ANKI_TEST_EXPECT_EQ(checkSurface(loader, mip, mip), true);
+			}
+		}
+
+		// Drop the first mip because of the max texture size and load only the last
+		{
+			ResourceFilePtr file;
+			ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fname, file));
+			ImageLoader loader(alloc);
+			ANKI_TEST_EXPECT_NO_ERR(loader.load(file, fname, 32, 1));
+
+			ANKI_TEST_EXPECT_EQ(loader.getWidth(), 32);
+			ANKI_TEST_EXPECT_EQ(loader.getMipLevelsCount(), TEX_MIPS - 1);
+			ANKI_TEST_EXPECT_EQ(loader.getFirstLoadedMipLevel(), TEX_MIPS - 2);
+			ANKI_TEST_EXPECT_EQ(checkSurface(loader, TEX_MIPS - 2, TEX_MIPS - 1), true);
+		}
+	}
+
+	// Only 2D textures have a mip tail
+	{
+		ResourceFilePtr file;
+		ANKI_TEST_EXPECT_NO_ERR(fs.openFile("array.ankitex", file));
+		ImageLoader loader(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(loader.load(file, "array.ankitex", MAX_U32, 16));
+
+		ANKI_TEST_EXPECT_EQ(loader.getTextureType(), ImageLoader::TextureType::_2D_ARRAY);
+		ANKI_TEST_EXPECT_EQ(loader.getFirstLoadedMipLevel(), 0);
+		for(U mip = 0; mip < TEX_MIPS; ++mip)
+		{
+			ANKI_TEST_EXPECT_EQ(checkSurface(loader, mip, mip), true);
+		}
+	}
+
+	// Offsets that don't agree with the header
+	{
+		ResourceFilePtr file;
+		ANKI_TEST_EXPECT_NO_ERR(fs.openFile("broken.ankitex", file));
+		ImageLoader loader(alloc);
+		ANKI_TEST_EXPECT_ERR(loader.load(file, "broken.ankitex"), Error::USER_DATA);
+	}
+
+	ANKI_TEST_EXPECT_NO_ERR(removeDirectory(dir));
+}
+
+} // end namespace anki
@@ -0,0 +1,365 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/MeshOptimizer.h>
+#include <anki/util/HighRezTimer.h>
+#include <algorithm>
+
+namespace anki
+{
+
+/// Create a grid of quads in the XY plane. It's from 0 to 1.
+static void createGrid(
+	U32 quadsPerSide, F32 bumpiness, DynamicArrayAuto<Vec3>& positions, DynamicArrayAuto<U32>& indices)
+{
+	const U32 vertsPerSide = quadsPerSide + 1;
+	for(U32 y = 0; y < vertsPerSide; ++y)
+	{
+		for(U32 x = 0; x < vertsPerSide; ++x)
+		{
+			const F32 fx = F32(x) / F32(quadsPerSide);
+			const F32 fy = F32(y) / F32(quadsPerSide);
+			positions.emplaceBack(fx, fy, bumpiness * sin(fx * 10.0f) * cos(fy * 7.0f));
+		}
+	}
+
+	for(U32 y = 0; y < quadsPerSide; ++y)
+	{
+		for(U32 x = 0; x < quadsPerSide; ++x)
+		{
+			const U32 v = y * vertsPerSide + x;
+			const Array<U32, 6> quad = {{v, v + 1, v + vertsPerSide + 1, v, v + vertsPerSide + 1, v + vertsPerSide}};
+			for(U32 idx : quad)
+			{
+				indices.emplaceBack(idx);
+			}
+		}
+	}
+}
+
+/// Shuffle the triangles like a bad exporter would.
+static void shuffleTriangles(WeakArray<U32> indices)
+{
+	U32 seed = 1234;
+	const U32 triangleCount = indices.getSize() / 3;
+	for(U32 i = triangleCount - 1; i > 0; --i)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		const U32 j = (seed >> 8) % (i + 1);
+		for(U32 k = 0; k < 3; ++k)
+		{
+			std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+		}
+	}
+}
+
+/// Get the triangles in a form that doesn't depend on their order.
+static void sortedTriangles(ConstWeakArray<U32> indices, DynamicArrayAuto<U64>& out)
+{
+	for(U32 i = 0; i < indices.getSize(); i += 3)
+	{
+		// Rotate so the smallest index is first. It keeps the winding
+		U32 first = (indices[i] < indices[i + 1]) ? 0 : 1;
+		first = (indices[i + first] < indices[i + 2]) ? first : 2;
+		U64 key = 0;
+		for(U32 k = 0; k < 3; ++k)
+		{
+			key = (key << 21u) | indices[i + (first + k) % 3];
+		}
+		out.emplaceBack(key);
+	}
+
+	std::sort(out.getBegin(), out.getEnd());
+}
+
+static Bool sameTriangles(ConstWeakArray<U32> a, ConstWeakArray<U32> b, GenericMemoryPoolAllocator<U8> alloc)
+{
+	DynamicArrayAuto<U64> sortedA(alloc);
+	DynamicArrayAuto<U64> sortedB(alloc);
+	sortedTriangles(a, sortedA);
+	sortedTriangles(b, sortedB);
+	return a.getSize() == b.getSize() && memcmp(&sortedA[0], &sortedB[0], sortedA.getSizeInBytes()) == 0;
+}
+
+ANKI_TEST(Resource, MeshOptimizerStats)
+{
+	// A quad
+	const Array<U32, 6> quad = {{0, 1, 2, 0, 2, 3}};
+	MeshOptimizerStats stats = MeshOptimizer::computeStats(quad, 4, MeshOptimizer::CACHE_LINE_SIZE);
+	ANKI_TEST_EXPECT_EQ(stats.m_acmr, 2.0f);
+	ANKI_TEST_EXPECT_EQ(stats.m_atvr, 1.0f);
+	ANKI_TEST_EXPECT_EQ(stats.m_overfetch, 1.0f);
+
+	// The same vertices again after they have left the cache
+	DynamicArrayAuto<U32> indices(HeapAllocator<U8>(allocAligned, nullptr));
+	for(U32 i = 0; i < MeshOptimizer::VERTEX_CACHE_SIZE * 2; ++i)
+	{
+		indices.emplaceBack(i % (MeshOptimizer::VERTEX_CACHE_SIZE + 2));
+	}
+	indices.resize(indices.getSize() / 3 * 3);
+	stats = MeshOptimizer::computeStats(indices, MeshOptimizer::VERTEX_CACHE_SIZE + 2, 4);
+	ANKI_TEST_EXPECT_EQ(stats.m_acmr, 3.0f);
+	ANKI_TEST_EXPECT_GT(stats.m_atvr, 1.0f);
+
+	// Positions
+	ANKI_TEST_EXPECT_EQ(MeshOptimizer::choosePositionFormat(Vec3(-1.0f), Vec3(1.9f), 0.0005f),
+		Format::R16G16B16A16_SFLOAT);
+	ANKI_TEST_EXPECT_EQ(MeshOptimizer::choosePositionFormat(Vec3(-1.0f), Vec3(2.0f), 0.0005f),
+		Format::R32G32B32_SFLOAT);
+	ANKI_TEST_EXPECT_EQ(MeshOptimizer::choosePositionFormat(Vec3(-1.0f), Vec3(100.0f), 0.1f),
+		Format::R16G16B16A16_SFLOAT);
+	ANKI_TEST_EXPECT_EQ(MeshOptimizer::choosePositionFormat(Vec3(0.0f), Vec3(70000.0f), 1000.0f),
+		Format::R32G32B32_SFLOAT);
+}
+
+ANKI_TEST(Resource, MeshOptimizer)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	MeshOptimizer optimizer(alloc);
+
+	DynamicArrayAuto<Vec3> positions(alloc);
+	DynamicArrayAuto<U32> original(alloc);
+	createGrid(64, 0.0f, positions, original);
+	shuffleTriangles(WeakArray<U32>(original));
+	const U32 vertexSize = sizeof(Vec3);
+	const MeshOptimizerStats shuffledStats = MeshOptimizer::computeStats(original, positions.getSize(), vertexSize);
+	ANKI_TEST_EXPECT_GT(shuffledStats.m_acmr, 2.0f);
+
+	// Vertex cache
+	DynamicArrayAuto<U32> indices(alloc);
+	indices.create(original.getSize());
+	memcpy(&indices[0], &original[0], original.getSizeInBytes());
+	optimizer.optimizeVertexCache(WeakArray<U32>(indices), positions.getSize());
+	ANKI_TEST_EXPECT_EQ(sameTriangles(original, indices, alloc), true);
+
+	const MeshOptimizerStats cacheStats = MeshOptimizer::computeStats(indices, positions.getSize(), vertexSize);
+	ANKI_TEST_EXPECT_LT(cacheStats.m_acmr, 0.8f);
+	ANKI_TEST_EXPECT_LT(cacheStats.m_atvr, 1.45f);
+
+	// Overdraw
+	optimizer.optimizeOverdraw(WeakArray<U32>(indices), positions);
+	ANKI_TEST_EXPECT_EQ(sameTriangles(original, indices, alloc), true);
+
+	const MeshOptimizerStats overdrawStats = MeshOptimizer::computeStats(indices, positions.getSize(), vertexSize);
+	ANKI_TEST_EXPECT_LEQ(overdrawStats.m_acmr, cacheStats.m_acmr * 1.1f);
+
+	// Vertex fetch. The vertices should be used in order
+	DynamicArrayAuto<U32> cacheIndices(alloc);
+	cacheIndices.create(indices.getSize());
+	memcpy(&cacheIndices[0], &indices[0], indices.getSizeInBytes());
+
+	DynamicArrayAuto<U32> newToOld(alloc);
+	optimizer.optimizeVertexFetch(WeakArray<U32>(indices), positions.getSize(), newToOld);
+	ANKI_TEST_EXPECT_EQ(newToOld.getSize(), positions.getSize());
+
+	U32 nextNewVertex = 0;
+	for(U32 i = 0; i < indices.getSize(); ++i)
+	{
+		ANKI_TEST_EXPECT_LEQ(indices[i], nextNewVertex);
+		nextNewVertex = max(nextNewVertex, indices[i] + 1);
+		ANKI_TEST_EXPECT_EQ(newToOld[indices[i]], cacheIndices[i]);
+	}
+
+	const MeshOptimizerStats fetchStats = MeshOptimizer::computeStats(indices, positions.getSize(), vertexSize);
+	ANKI_TEST_EXPECT_EQ(fetchStats.m_acmr, overdrawStats.m_acmr);
+	ANKI_TEST_EXPECT_LEQ(fetchStats.m_overfetch, overdrawStats.m_overfetch);
+	ANKI_TEST_EXPECT_LT(fetchStats.m_overfetch, shuffledStats.m_overfetch);
+
+	// The vertices that are not used are dropped
+	DynamicArrayAuto<U32> half(alloc);
+	half.create(original.getSize() / 2);
+	memcpy(&half[0], &original[0], half.getSizeInBytes());
+	optimizer.optimize(WeakArray<U32>(half), positions, newToOld);
+	ANKI_TEST_EXPECT_LT(newToOld.getSize(), positions.getSize());
+	for(U32 idx : half)
+	{
+		ANKI_TEST_EXPECT_LT(idx, newToOld.getSize());
+	}
+}
+
+ANKI_TEST(Resource, MeshOptimizerSimplify)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	MeshOptimizer optimizer(alloc);
+
+	// A flat grid can lose all of its inner vertices without any error
+	{
+		DynamicArrayAuto<Vec3> positions(alloc);
+		DynamicArrayAuto<U32> indices(alloc);
+		createGrid(32, 0.0f, positions, indices);
+
+		DynamicArrayAuto<U32> lod(alloc);
+		const U32 target = indices.getSize() / 4;
+		const F32 error = optimizer.simplify(indices, positions, target, 0.001f, lod);
+		ANKI_TEST_EXPECT_LEQ(lod.getSize(), target);
+		ANKI_TEST_EXPECT_GT(lod.getSize(), 0u);
+		ANKI_TEST_EXPECT_LT(error, 0.001f);
+
+		// Nothing flipped and nothing is missing
+		F32 area = 0.0f;
+		for(U32 i = 0; i < lod.getSize(); i += 3)
+		{
+			const Vec3 normal =
+				(positions[lod[i + 1]] - positions[lod[i]]).cross(positions[lod[i + 2]] - positions[lod[i]]);
+			ANKI_TEST_EXPECT_GT(normal.z(), 0.0f);
+			area += normal.z() * 0.5f;
+		}
+		ANKI_TEST_EXPECT_NEAR(area, 1.0f, 0.0001f);
+	}
+
+	// A bumpy grid stops at the max error
+	{
+		DynamicArrayAuto<Vec3> positions(alloc);
+		DynamicArrayAuto<U32> indices(alloc);
+		createGrid(32, 0.1f, positions, indices);
+
+		DynamicArrayAuto<U32> lod(alloc);
+		const F32 error = optimizer.simplify(indices, positions, 0, 0.002f, lod);
+		ANKI_TEST_EXPECT_LEQ(error, 0.002f);
+		ANKI_TEST_EXPECT_LT(lod.getSize(), indices.getSize());
+		ANKI_TEST_EXPECT_GT(lod.getSize(), indices.getSize() / 8);
+
+		DynamicArrayAuto<U32> coarserLod(alloc);
+		optimizer.simplify(indices, positions, 0, 0.02f, coarserLod);
+		ANKI_TEST_EXPECT_LT(coarserLod.getSize(), lod.getSize());
+	}
+}
+
+ANKI_TEST(Resource, MeshOptimizerMeshlets)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	MeshOptimizer optimizer(alloc);
+
+	DynamicArrayAuto<Vec3> positions(alloc);
+	DynamicArrayAuto<U32> indices(alloc);
+	createGrid(32, 0.0f, positions, indices);
+
+	DynamicArrayAuto<U32> newToOld(alloc);
+	optimizer.optimize(WeakArray<U32>(indices), positions, newToOld);
+	DynamicArrayAuto<Vec3> newPositions(alloc);
+	for(U32 oldIdx : newToOld)
+	{
+		newPositions.emplaceBack(positions[oldIdx]);
+	}
+
+	DynamicArrayAuto<MeshBinaryFile::Meshlet> meshlets(alloc);
+	optimizer.buildMeshlets(indices, newPositions, meshlets);
+	ANKI_TEST_EXPECT_GEQ(meshlets.getSize(), indices.getSize() / (MeshBinaryFile::MAX_MESHLET_TRIANGLE_COUNT * 3));
+
+	DynamicArrayAuto<U32> vertexMeshlet(alloc);
+	vertexMeshlet.create(newPositions.getSize(), MAX_U32);
+	U32 nextFirstIndex = 0;
+	for(U32 m = 0; m < meshlets.getSize(); ++m)
+	{
+		const MeshBinaryFile::Meshlet& meshlet = meshlets[m];
+
+		// The meshlets cover the indices in order and they are in the limits
+		ANKI_TEST_EXPECT_EQ(meshlet.m_firstIndex, nextFirstIndex);
+		ANKI_TEST_EXPECT_GT(meshlet.m_indexCount, 0u);
+		ANKI_TEST_EXPECT_LEQ(meshlet.m_indexCount, MeshBinaryFile::MAX_MESHLET_TRIANGLE_COUNT * 3);
+		nextFirstIndex += meshlet.m_indexCount;
+
+		U32 vertexCount = 0;
+		for(U32 i = meshlet.m_firstIndex; i < meshlet.m_firstIndex + meshlet.m_indexCount; ++i)
+		{
+			if(vertexMeshlet[indices[i]] != m)
+			{
+				vertexMeshlet[indices[i]] = m;
+				++vertexCount;
+			}
+
+			// The sphere contains the triangles
+			const F32 dist = (newPositions[indices[i]] - meshlet.m_sphereCenter).getLength();
+			ANKI_TEST_EXPECT_LEQ(dist, meshlet.m_sphereRadius + EPSILON);
+		}
+		ANKI_TEST_EXPECT_LEQ(vertexCount, MeshBinaryFile::MAX_MESHLET_VERTEX_COUNT);
+
+		// The grid is flat so the cone is a line. It's culled from below and not from above
+		ANKI_TEST_EXPECT_NEAR(meshlet.m_coneAxis.z(), 1.0f, EPSILON);
+		ANKI_TEST_EXPECT_NEAR(meshlet.m_coneCutoff, 0.0f, 0.01f);
+
+		const Vec3 below = meshlet.m_sphereCenter - Vec3(0.0f, 0.0f, 10.0f);
+		const Vec3 dir = meshlet.m_sphereCenter - below;
+		ANKI_TEST_EXPECT_GEQ(
+			dir.dot(meshlet.m_coneAxis), meshlet.m_coneCutoff * dir.getLength() + meshlet.m_sphereRadius);
+
+		const Vec3 above = meshlet.m_sphereCenter + Vec3(0.3f, 0.0f, 10.0f);
+		const Vec3 dir2 = meshlet.m_sphereCenter - above;
+		ANKI_TEST_EXPECT_LT(
+			dir2.dot(meshlet.m_coneAxis), meshlet.m_coneCutoff * dir2.getLength() + meshlet.m_sphereRadius);
+	}
+	ANKI_TEST_EXPECT_EQ(nextFirstIndex, indices.getSize());
+
+	// A bumpy grid has wider cones
+	positions.destroy();
+	indices.destroy();
+	createGrid(32, 2.0f, positions, indices);
+	optimizer.buildMeshlets(indices, positions, meshlets);
+	Bool wideCone = false;
+	for(const MeshBinaryFile::Meshlet& meshlet : meshlets)
+	{
+		ANKI_TEST_EXPECT_GEQ(meshlet.m_coneCutoff, 0.0f);
+		ANKI_TEST_EXPECT_LEQ(meshlet.m_coneCutoff, 1.0f);
+		wideCone = wideCone || meshlet.m_coneCutoff > 0.5f;
+	}
+	ANKI_TEST_EXPECT_EQ(wideCone, true);
+}
+
+ANKI_TEST(Resource, MeshOptimizerBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	MeshOptimizer optimizer(alloc);
+
+	DynamicArrayAuto<Vec3> positions(alloc);
+	DynamicArrayAuto<U32> indices(alloc);
+	createGrid(256, 0.1f, positions, indices);
+	shuffleTriangles(WeakArray<U32>(indices));
+	const U32 vertexSize = 32;
+	const MeshOptimizerStats before = MeshOptimizer::computeStats(indices, positions.getSize(), vertexSize);
+
+	HighRezTimer timer;
+	timer.start();
+	DynamicArrayAuto<U32> newToOld(alloc);
+	optimizer.optimize(WeakArray<U32>(indices), positions, newToOld);
+	timer.stop();
+	const Second optimizeTime = timer.getElapsedTime();
+	const MeshOptimizerStats after = MeshOptimizer::computeStats(indices, positions.getSize(), vertexSize);
+
+	DynamicArrayAuto<Vec3> newPositions(alloc);
+	newPositions.create(newToOld.getSize());
+	for(U32 i = 0; i < newToOld.getSize(); ++i)
+	{
+		newPositions[i] = positions[newToOld[i]];
+	}
+
+	timer.start();
+	DynamicArrayAuto<MeshBinaryFile::Meshlet> meshlets(alloc);
+	optimizer.buildMeshlets(indices, newPositions, meshlets);
+	timer.stop();
+	const Second meshletTime = timer.getElapsedTime();
+
+	timer.start();
+	DynamicArrayAuto<U32> lod(alloc);
+	optimizer.simplify(indices, newPositions, indices.getSize() / 2, 0.01f, lod);
+	timer.stop();
+
+	ANKI_TEST_LOGI("%u triangles: optimize %fms, simplify to %u triangles %fms, %u meshlets %fms",
+		indices.getSize() / 3,
+		optimizeTime * 1000.0,
+		lod.getSize() / 3,
+		timer.getElapsedTime() * 1000.0,
+		meshlets.getSize(),
+		meshletTime * 1000.0);
+	ANKI_TEST_LOGI("ACMR %f -> %f, ATVR %f -> %f, overfetch %f -> %f",
+		before.m_acmr,
+		after.m_acmr,
+		before.m_atvr,
+		after.m_atvr,
+		before.m_overfetch,
+		after.m_overfetch);
+}
+
+} // end namespace anki
@@ -5,10 +5,160 @@
 
 #include "tests/framework/Framework.h"
 #include "anki/resource/ResourceFilesystem.h"
+#include "anki/resource/ZipArchive.h"
+#include "anki/core/Config.h"
+#include "anki/util/HighRezTimer.h"
+#include <zlib.h>
+#include <contrib/minizip/unzip.h>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
 
 namespace anki
 {
 
+/// Writes zip archives with stored, deflated and chunked deflated files.
+class TestZipWriter
+{
+public:
+	void addFile(const CString& name, const std::vector<U8>& contents, Bool compress, U32 chunkSize = 0)
+	{
+		std::vector<U8> data;
+		std::vector<U32> chunkOffsets;
+		if(!compress)
+		{
+			data = contents;
+		}
+		else
+		{
+			z_stream stream = {};
+			ANKI_TEST_EXPECT_EQ(deflateInit2(&stream, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY), Z_OK);
+
+			// Full flush at the start of every chunk so it can be decompressed on its own
+			const U32 size = U32(contents.size());
+			const U32 step = (chunkSize) ? chunkSize : size;
+			for(U32 begin = 0; begin < size; begin += step)
+			{
+				chunkOffsets.push_back(U32(data.size()));
+
+				const U32 end = min(begin + step, size);
+				stream.next_in = const_cast<Bytef*>(&contents[begin]);
+				stream.avail_in = end - begin;
+				const int flush = (end == size) ? Z_FINISH : Z_FULL_FLUSH;
+				do
+				{
+					U8 out[16 * 1024];
+					stream.next_out = out;
+					stream.avail_out = sizeof(out);
+					deflate(&stream, flush);
+					data.insert(data.end(), out, out + sizeof(out) - stream.avail_out);
+				} while(stream.avail_out == 0);
+			}
+
+			deflateEnd(&stream);
+		}
+
+		std::vector<U8> extra;
+		if(chunkSize)
+		{
+			append<U16>(extra, ZipArchive::CHUNKS_EXTRA_FIELD_ID);
+			append<U16>(extra, U16(sizeof(U32) + chunkOffsets.size() * sizeof(U32)));
+			append<U32>(extra, chunkSize);
+			for(U32 offset : chunkOffsets)
+			{
+				append<U32>(extra, offset);
+			}
+		}
+
+		const U32 crc = U32(crc32(0, contents.data(), uInt(contents.size())));
+		const U16 method = (compress) ? 8 : 0;
+		const U32 localHeaderOffset = U32(m_data.size());
+		const U16 nameLength = U16(name.getLength());
+
+		// Local header
+		append<U32>(m_data, 0x04034b50);
+		append<U16>(m_data, 20);
+		append<U16>(m_data, 0);
+		append<U16>(m_data, method);
+		append<U32>(m_data, 0);
+		append<U32>(m_data, crc);
+		append<U32>(m_data, U32(data.size()));
+		append<U32>(m_data, U32(contents.size()));
+		append<U16>(m_data, nameLength);
+		append<U16>(m_data, 0);
+		m_data.insert(m_data.end(), &name[0], &name[0] + nameLength);
+		m_data.insert(m_data.end(), data.begin(), data.end());
+
+		// Central directory header
+		append<U32>(m_cd, 0x02014b50);
+		append<U16>(m_cd, 20);
+		append<U16>(m_cd, 20);
+		append<U16>(m_cd, 0);
+		append<U16>(m_cd, method);
+		append<U32>(m_cd, 0);
+		append<U32>(m_cd, crc);
+		append<U32>(m_cd, U32(data.size()));
+		append<U32>(m_cd, U32(contents.size()));
+		append<U16>(m_cd, nameLength);
+		append<U16>(m_cd, U16(extra.size()));
+		append<U16>(m_cd, 0);
+		append<U16>(m_cd, 0);
+		append<U16>(m_cd, 0);
+		append<U32>(m_cd, 0);
+		append<U32>(m_cd, localHeaderOffset);
+		m_cd.insert(m_cd.end(), &name[0], &name[0] + nameLength);
+		m_cd.insert(m_cd.end(), extra.begin(), extra.end());
+
+		++m_fileCount;
+	}
+
+	void write(const CString& filename)
+	{
+		std::vector<U8> eocd;
+		append<U32>(eocd, 0x06054b50);
+		append<U16>(eocd, 0);
+		append<U16>(eocd, 0);
+		append<U16>(eocd, U16(m_fileCount));
+		append<U16>(eocd, U16(m_fileCount));
+		append<U32>(eocd, U32(m_cd.size()));
+		append<U32>(eocd, U32(m_data.size()));
+		append<U16>(eocd, 0);
+
+		FILE* file = fopen(&filename[0], "wb");
+		ANKI_TEST_EXPECT_NEQ(file, nullptr);
+		fwrite(m_data.data(), 1, m_data.size(), file);
+		fwrite(m_cd.data(), 1, m_cd.size(), file);
+		fwrite(eocd.data(), 1, eocd.size(), file);
+		fclose(file);
+	}
+
+private:
+	std::vector<U8> m_data;
+	std::vector<U8> m_cd;
+	U32 m_fileCount = 0;
+
+	template<typename T>
+	static void append(std::vector<U8>& vec, T value)
+	{
+		const U8* bytes = reinterpret_cast<const U8*>(&value);
+		vec.insert(vec.end(), bytes, bytes + sizeof(T));
+	}
+};
+
+/// Some data that compress a bit.
+static std::vector<U8> createTestFileContents(U32 size, U32 seed)
+{
+	std::mt19937 gen(seed);
+	std::vector<U8> contents(size);
+	for(U8& c : contents)
+	{
+		c = U8('a' + gen() % 8);
+	}
+
+	return contents;
+}
+
 ANKI_TEST(Resource, ResourceFilesystem)
 {
 	printf("Test requires the data dir\n");
@@ -35,4 +185,178 @@ ANKI_TEST(Resource, ResourceFilesystem)
 	}
 }
 
+ANKI_TEST(Resource, ResourceFilesystemArchive)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const CString archiveFname = "/tmp/anki_test_archive.ankizip";
+
+	const std::vector<U8> stored = createTestFileContents(1000, 0);
+	const std::vector<U8> deflated = createTestFileContents(100 * 1024, 1);
+	const std::vector<U8> chunked = createTestFileContents(1024 * 1024 + 100, 2);
+	{
+		TestZipWriter writer;
+		writer.addFile("stored.bin", stored, false);
+		writer.addFile("deflated.bin", deflated, true);
+		writer.addFile("dir/chunked.bin", chunked, true, 64 * 1024);
+		writer.write(archiveFname);
+	}
+
+	// Check the archive
+	{
+		ZipArchive archive(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(archive.open(archiveFname));
+		ANKI_TEST_EXPECT_EQ(archive.getEntryCount(), 3);
+		ANKI_TEST_EXPECT_EQ(archive.findEntry("missing.bin"), MAX_U32);
+
+		const U32 idx = archive.findEntry("dir/chunked.bin");
+		ANKI_TEST_EXPECT_NEQ(idx, MAX_U32);
+		ANKI_TEST_EXPECT_EQ(archive.getEntry(idx).m_chunkCount, 17);
+		ANKI_TEST_EXPECT_EQ(archive.getEntry(archive.findEntry("deflated.bin")).m_chunkCount, 1);
+
+		// Decompress only the last chunk
+		std::vector<U8> chunk(64 * 1024);
+		ANKI_TEST_EXPECT_NO_ERR(archive.decompressChunk(idx, 16, chunk.data()));
+		ANKI_TEST_EXPECT_EQ(memcmp(chunk.data(), &chunked[16 * 64 * 1024], 100), 0);
+	}
+
+	for(U32 threadCount = 0; threadCount < 3; ++threadCount)
+	{
+		Config config;
+		config.set("rsrc.dataPaths", archiveFname);
+		config.set("rsrc.archiveDecompressionThreadCount", threadCount);
+		ResourceFilesystem fs(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(fs.init(config, "/tmp"));
+
+		// The stored files are not copied
+		{
+			ResourceFilePtr file;
+			ANKI_TEST_EXPECT_NO_ERR(fs.openFile("stored.bin", file));
+			ANKI_TEST_EXPECT_EQ(file->getSize(), stored.size());
+
+			const void* data;
+			ANKI_TEST_EXPECT_NO_ERR(file->map(data));
+			ANKI_TEST_EXPECT_EQ(memcmp(data, stored.data(), stored.size()), 0);
+
+			U8 c;
+			ANKI_TEST_EXPECT_NO_ERR(file->seek(0, ResourceFile::SeekOrigin::END));
+			ANKI_TEST_EXPECT_ERR(file->read(&c, 1), Error::FILE_ACCESS);
+			ANKI_TEST_EXPECT_ERR(file->seek(1, ResourceFile::SeekOrigin::END), Error::FUNCTION_FAILED);
+		}
+
+		// Read the deflated files at random positions
+		const std::vector<U8>* contents[] = {&deflated, &chunked};
+		const CString fnames[] = {"deflated.bin", "dir/chunked.bin"};
+		std::mt19937 gen(threadCount);
+		for(U32 f = 0; f < 2; ++f)
+		{
+			for(U32 i = 0; i < 20; ++i)
+			{
+				ResourceFilePtr file;
+				ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fnames[f], file));
+				ANKI_TEST_EXPECT_EQ(file->getSize(), contents[f]->size());
+
+				const PtrSize offset = gen() % contents[f]->size();
+				const PtrSize size = min<PtrSize>(gen() % (200 * 1024), contents[f]->size() - offset);
+				std::vector<U8> buff(size + 1);
+				ANKI_TEST_EXPECT_NO_ERR(file->seek(offset, ResourceFile::SeekOrigin::BEGINNING));
+				ANKI_TEST_EXPECT_NO_ERR(file->read(buff.data(), size));
+				ANKI_TEST_EXPECT_EQ(memcmp(buff.data(), contents[f]->data() + offset, size), 0);
+				ANKI_TEST_EXPECT_ERR(
+					file->read(buff.data(), contents[f]->size() - offset - size + 1), Error::FILE_ACCESS);
+
+				// Some of them are destroyed before the threads are done with them
+				if(i % 2)
+				{
+					const void* data;
+					ANKI_TEST_EXPECT_NO_ERR(file->map(data));
+					ANKI_TEST_EXPECT_EQ(memcmp(data, contents[f]->data(), contents[f]->size()), 0);
+				}
+			}
+		}
+	}
+
+	remove(&archiveFname[0]);
+}
+
+/// Compare the archive reader with the way minizip reads: locate the file in the central directory and inflate it.
+ANKI_TEST(Resource, ResourceFilesystemArchiveBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const CString archiveFname = "/tmp/anki_test_bench.ankizip";
+	const U32 FILE_COUNT = 10000;
+	const U32 MINIZIP_FILE_COUNT = 500; // Minizip is too slow for all of them
+
+	// Half the files are compressed
+	std::vector<String> fnames(FILE_COUNT);
+	{
+		TestZipWriter writer;
+		for(U32 i = 0; i < FILE_COUNT; ++i)
+		{
+			fnames[i].sprintf(alloc, "assets/dir%u/file%u.bin", i % 100, i);
+			const std::vector<U8> contents = createTestFileContents(4 * 1024 + i % 1024, i);
+			writer.addFile(fnames[i].toCString(), contents, i % 2 == 0, (i % 4 == 0) ? 1024 : 0);
+		}
+
+		writer.write(archiveFname);
+	}
+
+	std::vector<U8> buff(8 * 1024);
+	std::mt19937 gen(0);
+
+	// Minizip
+	HighRezTimer timer;
+	timer.start();
+	for(U32 i = 0; i < MINIZIP_FILE_COUNT; ++i)
+	{
+		const U32 idx = gen() % FILE_COUNT;
+		unzFile archive = unzOpen(&archiveFname[0]);
+		ANKI_TEST_EXPECT_EQ(unzLocateFile(archive, &fnames[idx][0], 1), UNZ_OK);
+		ANKI_TEST_EXPECT_EQ(unzOpenCurrentFile(archive), UNZ_OK);
+		ANKI_TEST_EXPECT_GT(unzReadCurrentFile(archive, buff.data(), 4 * 1024), 0);
+		unzCloseCurrentFile(archive);
+		unzClose(archive);
+	}
+	timer.stop();
+	const F64 minizipTime = timer.getElapsedTime() / MINIZIP_FILE_COUNT;
+
+	// The archive reader
+	for(U32 threadCount = 0; threadCount < 3; threadCount += 2)
+	{
+		Config config;
+		config.set("rsrc.dataPaths", archiveFname);
+		config.set("rsrc.archiveDecompressionThreadCount", threadCount);
+		ResourceFilesystem fs(alloc);
+
+		timer.start();
+		ANKI_TEST_EXPECT_NO_ERR(fs.init(config, "/tmp"));
+		timer.stop();
+		const F64 indexTime = timer.getElapsedTime();
+
+		timer.start();
+		for(U32 i = 0; i < FILE_COUNT; ++i)
+		{
+			ResourceFilePtr file;
+			ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fnames[i].toCString(), file));
+			ANKI_TEST_EXPECT_NO_ERR(file->read(buff.data(), 4 * 1024));
+		}
+		timer.stop();
+		const F64 readTime = timer.getElapsedTime() / FILE_COUNT;
+
+		ANKI_TEST_LOGI("Open and read of %u files. Minizip %f us/file. Index %f ms, reader %f us/file. "
+					   "Speedup %fx",
+			FILE_COUNT,
+			minizipTime * 1000000.0,
+			indexTime * 1000.0,
+			readTime * 1000000.0,
+			minizipTime / readTime);
+	}
+
+	for(String& fname : fnames)
+	{
+		fname.destroy(alloc);
+	}
+
+	remove(&archiveFname[0]);
+}
+
 } // end namespace anki
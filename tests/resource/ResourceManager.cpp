@@ -7,6 +7,7 @@
 #include "anki/resource/DummyResource.h"
 #include "anki/resource/ResourceManager.h"
 #include "anki/core/Config.h"
+#include "anki/util/HighRezTimer.h"
 
 namespace anki
 {
@@ -87,4 +88,80 @@ ANKI_TEST(Resource, ResourceManager)
 	alloc.deleteInstance(resources);
 }
 
+ANKI_TEST(Resource, ResourceManagerStress)
+{
+	const U RESOURCE_COUNT = 50000;
+
+	Config config;
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	ResourceManagerInitInfo rinit;
+	rinit.m_gr = nullptr;
+	rinit.m_config = &config;
+	rinit.m_cacheDir = "/tmp/";
+	rinit.m_allocCallback = allocAligned;
+	rinit.m_allocCallbackData = nullptr;
+	ResourceManager* resources = alloc.newInstance<ResourceManager>();
+	ANKI_TEST_EXPECT_NO_ERR(resources->init(rinit));
+
+	{
+		DynamicArrayAuto<DummyResourcePtr> ptrs(alloc);
+		ptrs.create(RESOURCE_COUNT);
+		StringAuto fname(alloc);
+
+		// Load unique resources
+		Second begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < RESOURCE_COUNT; ++i)
+		{
+			fname.destroy();
+			fname.sprintf("textures/some_directory/texture_%u.ankitex", i);
+			ANKI_TEST_EXPECT_NO_ERR(resources->loadResource(fname.toCString(), ptrs[i]));
+		}
+		const Second loadTime = HighRezTimer::getCurrentTime() - begin;
+
+		// Load them again. They should be found
+		begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < RESOURCE_COUNT; ++i)
+		{
+			fname.destroy();
+			fname.sprintf("textures/some_directory/texture_%u.ankitex", i);
+			DummyResourcePtr ptr;
+			ANKI_TEST_EXPECT_NO_ERR(resources->loadResource(fname.toCString(), ptr));
+			ANKI_TEST_EXPECT_EQ(ptr.get(), ptrs[i].get());
+			ANKI_TEST_EXPECT_EQ(ptr->getRefcount().load(), 2);
+		}
+		const Second findTime = HighRezTimer::getCurrentTime() - begin;
+
+		// Release half of them and reload them
+		for(U i = 0; i < RESOURCE_COUNT; i += 2)
+		{
+			ptrs[i].reset(nullptr);
+		}
+
+		for(U i = 0; i < RESOURCE_COUNT; i += 2)
+		{
+			fname.destroy();
+			fname.sprintf("textures/some_directory/texture_%u.ankitex", i);
+			ANKI_TEST_EXPECT_NO_ERR(resources->loadResource(fname.toCString(), ptrs[i]));
+			ANKI_TEST_EXPECT_EQ(ptrs[i]->getRefcount().load(), 1);
+		}
+
+		// Release all
+		begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < RESOURCE_COUNT; ++i)
+		{
+			ptrs[i].reset(nullptr);
+		}
+		const Second releaseTime = HighRezTimer::getCurrentTime() - begin;
+
+		printf("%u resources: load %fms, find %fms, release %fms\n",
+			U32(RESOURCE_COUNT),
+			loadTime * 1000.0,
+			findTime * 1000.0,
+			releaseTime * 1000.0);
+	}
+
+	alloc.deleteInstance(resources);
+}
+
 } // end namespace anki
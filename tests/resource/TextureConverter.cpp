@@ -0,0 +1,371 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/TextureConverter.h>
+#include <anki/resource/ResourceFilesystem.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/File.h>
+#include <anki/util/Filesystem.h>
+#include <anki/util/System.h>
+
+namespace anki
+{
+
+static void createImage(U32 width, U32 height, U32 bpp, DynamicArrayAuto<U8>& data)
+{
+	data.create(width * height * bpp);
+	for(U32 y = 0; y < height; ++y)
+	{
+		for(U32 x = 0; x < width; ++x)
+		{
+			U8* texel = &data[(y * width + x) * bpp];
+			texel[0] = U8(x * 255 / (width - 1));
+			texel[1] = U8(y * 255 / (height - 1));
+			texel[2] = U8((x + y) * 255 / (width + height - 2));
+			if(bpp == 4)
+			{
+				texel[3] = U8((x / 8 + y / 8) % 2 * 200 + 30);
+			}
+		}
+	}
+}
+
+static void decodeRgb565(U16 c, Array<I32, 3>& out)
+{
+	const U32 r = (c >> 11) & 31;
+	const U32 g = (c >> 5) & 63;
+	const U32 b = c & 31;
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+/// Decode a BC1 block in 4 color mode and get the max error of the RGB against the RGBA8 texels.
+static I32 bc1Error(const U8* block, const U8* texels)
+{
+	U16 c0, c1;
+	U32 indices;
+	memcpy(&c0, block, 2);
+	memcpy(&c1, block + 2, 2);
+	memcpy(&indices, block + 4, 4);
+
+	Array<Array<I32, 3>, 4> palette;
+	decodeRgb565(c0, palette[0]);
+	decodeRgb565(c1, palette[1]);
+	for(U c = 0; c < 3; ++c)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+	}
+
+	I32 error = 0;
+	for(U i = 0; i < 16; ++i)
+	{
+		const U idx = (indices >> (i * 2)) & 3;
+		for(U c = 0; c < 3; ++c)
+		{
+			error = max(error, absolute(palette[idx][c] - I32(texels[i * 4 + c])));
+		}
+	}
+
+	return error;
+}
+
+ANKI_TEST(Resource, TextureConverterBlocks)
+{
+	Array<U8, 64> texels;
+	Array<U8, 16> block;
+
+	// Solid color
+	for(U i = 0; i < 16; ++i)
+	{
+		texels[i * 4 + 0] = 200;
+		texels[i * 4 + 1] = 100;
+		texels[i * 4 + 2] = 50;
+		texels[i * 4 + 3] = 255;
+	}
+	TextureConverter::encodeBc1Block(&texels[0], &block[0]);
+	ANKI_TEST_EXPECT_LEQ(bc1Error(&block[0], &texels[0]), 4);
+
+	// Two colors that are exact in RGB565
+	for(U i = 0; i < 16; ++i)
+	{
+		const U8 v = (i % 3) ? 0 : 255;
+		texels[i * 4 + 0] = v;
+		texels[i * 4 + 1] = v;
+		texels[i * 4 + 2] = 255 - v;
+		texels[i * 4 + 3] = U8(i * 17);
+	}
+	TextureConverter::encodeBc1Block(&texels[0], &block[0]);
+	ANKI_TEST_EXPECT_EQ(bc1Error(&block[0], &texels[0]), 0);
+
+	// The alpha of BC3. The 16 values are 17 apart and the palette is 255/7 apart
+	TextureConverter::encodeBc3Block(&texels[0], &block[0]);
+	ANKI_TEST_EXPECT_EQ(block[0], 255);
+	ANKI_TEST_EXPECT_EQ(block[1], 0);
+	ANKI_TEST_EXPECT_EQ(bc1Error(&block[8], &texels[0]), 0);
+
+	U64 alphaIndices = 0;
+	memcpy(&alphaIndices, &block[2], 6);
+	for(U i = 0; i < 16; ++i)
+	{
+		const I32 idx = (alphaIndices >> (i * 3)) & 7;
+		const I32 alpha = (idx == 0) ? 255 : (idx == 1) ? 0 : ((8 - idx) * 255) / 7;
+		ANKI_TEST_EXPECT_LEQ(absolute(alpha - I32(texels[i * 4 + 3])), 255 / 14 + 1);
+	}
+}
+
+ANKI_TEST(Resource, TextureConverterMips)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	TextureConverter converter(alloc);
+
+	// A black and white checkerboard. Averaging in linear space gives a brighter gray than averaging the sRGB values
+	Array<U8, 4 * 4 * 4> in;
+	for(U i = 0; i < 16; ++i)
+	{
+		const U8 v = ((i % 4 + i / 4) % 2) ? 255 : 0;
+		in[i * 4 + 0] = in[i * 4 + 1] = in[i * 4 + 2] = v;
+		in[i * 4 + 3] = v;
+	}
+
+	Array<U8, 2 * 2 * 4> out;
+	converter.generateMip(in, 4, 4, 1, true, false, WeakArray<U8>(out));
+	for(U i = 0; i < 4; ++i)
+	{
+		ANKI_TEST_EXPECT_EQ(out[i * 4 + 0], 188);
+		ANKI_TEST_EXPECT_EQ(out[i * 4 + 3], 128);
+	}
+
+	converter.generateMip(in, 4, 4, 1, false, false, WeakArray<U8>(out));
+	for(U i = 0; i < 4; ++i)
+	{
+		ANKI_TEST_EXPECT_EQ(out[i * 4 + 0], 128);
+		ANKI_TEST_EXPECT_EQ(out[i * 4 + 3], 128);
+	}
+
+	// Normals stay normalized
+	for(U i = 0; i < 16; ++i)
+	{
+		in[i * 4 + 0] = (i % 2) ? 255 : 128;
+		in[i * 4 + 1] = 128;
+		in[i * 4 + 2] = (i % 2) ? 128 : 255;
+	}
+	converter.generateMip(in, 4, 4, 1, false, true, WeakArray<U8>(out));
+	const Vec3 n = Vec3(F32(out[0]), F32(out[1]), F32(out[2])) / 255.0f * 2.0f - 1.0f;
+	ANKI_TEST_EXPECT_NEAR(n.getLength(), 1.0f, 0.02f);
+}
+
+ANKI_TEST(Resource, TextureConverter)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 SIZE = 64;
+	const U32 MIP_COUNT = 5; // Down to 4x4
+
+	const CString dir = "./texconv_test";
+	if(directoryExists(dir))
+	{
+		ANKI_TEST_EXPECT_NO_ERR(removeDirectory(dir));
+	}
+	ANKI_TEST_EXPECT_NO_ERR(createDirectory(dir));
+
+	DynamicArrayAuto<U8> rgba(alloc);
+	createImage(SIZE, SIZE, 4, rgba);
+	DynamicArrayAuto<U8> rgb(alloc);
+	createImage(SIZE, SIZE, 3, rgb);
+
+	TextureConverterImage image;
+	image.m_width = SIZE;
+	image.m_height = SIZE;
+	image.m_colorFormat = ImageLoader::ColorFormat::RGBA8;
+	image.m_data = rgba;
+
+	TextureConverterConfig config;
+	config.m_compressions = ImageLoader::DataCompression::RAW | ImageLoader::DataCompression::S3TC;
+
+	// The hive doesn't change the output
+	DynamicArrayAuto<U8> ankitex(alloc);
+	{
+		TextureConverter converter(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(converter.convert(ConstWeakArray<TextureConverterImage>(&image, 1), config, ankitex));
+
+		ThreadHive hive(4, alloc);
+		TextureConverter hiveConverter(alloc, &hive);
+		DynamicArrayAuto<U8> ankitex2(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(
+			hiveConverter.convert(ConstWeakArray<TextureConverterImage>(&image, 1), config, ankitex2));
+
+		ANKI_TEST_EXPECT_EQ(ankitex.getSize(), ankitex2.getSize());
+		ANKI_TEST_EXPECT_EQ(memcmp(&ankitex[0], &ankitex2[0], ankitex.getSize()), 0);
+	}
+
+	// The content hash
+	{
+		AnkiTextureFile::Header header;
+		memcpy(&header, &ankitex[0], sizeof(header));
+		ANKI_TEST_EXPECT_EQ(header.m_contentHash,
+			TextureConverter::computeContentHash(ConstWeakArray<TextureConverterImage>(&image, 1), config));
+		ANKI_TEST_EXPECT_EQ(header.m_mipLevels, MIP_COUNT);
+
+		TextureConverterConfig config2 = config;
+		config2.m_noAlpha = true;
+		ANKI_TEST_EXPECT_NEQ(header.m_contentHash,
+			TextureConverter::computeContentHash(ConstWeakArray<TextureConverterImage>(&image, 1), config2));
+
+		rgba[100] ^= 1;
+		ANKI_TEST_EXPECT_NEQ(header.m_contentHash,
+			TextureConverter::computeContentHash(ConstWeakArray<TextureConverterImage>(&image, 1), config));
+		rgba[100] ^= 1;
+	}
+
+	// Write the RGBA8 texture with both compressions, a RAW only version and an RGB8 version
+	File file;
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./texconv_test/rgba.ankitex", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_TEST_EXPECT_NO_ERR(file.write(&ankitex[0], ankitex.getSize()));
+	file.close();
+
+	TextureConverter converter(alloc);
+	config.m_compressions = ImageLoader::DataCompression::RAW;
+	config.m_sRgb = false;
+	ANKI_TEST_EXPECT_NO_ERR(converter.convert(ConstWeakArray<TextureConverterImage>(&image, 1), config, ankitex));
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./texconv_test/raw.ankitex", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_TEST_EXPECT_NO_ERR(file.write(&ankitex[0], ankitex.getSize()));
+	file.close();
+
+	image.m_colorFormat = ImageLoader::ColorFormat::RGB8;
+	image.m_data = rgb;
+	config.m_compressions = ImageLoader::DataCompression::S3TC;
+	ANKI_TEST_EXPECT_NO_ERR(converter.convert(ConstWeakArray<TextureConverterImage>(&image, 1), config, ankitex));
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./texconv_test/rgb.ankitex", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_TEST_EXPECT_NO_ERR(file.write(&ankitex[0], ankitex.getSize()));
+	file.close();
+
+	// Load them back
+	ResourceFilesystem fs(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(fs.addNewPath(dir));
+
+	// The RAW data are the input and the linear mips
+	{
+		ResourceFilePtr rfile;
+		ANKI_TEST_EXPECT_NO_ERR(fs.openFile("raw.ankitex", rfile));
+		ImageLoader loader(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(loader.load(rfile, "raw.ankitex"));
+
+		ANKI_TEST_EXPECT_EQ(loader.getCompression(), ImageLoader::DataCompression::RAW);
+		ANKI_TEST_EXPECT_EQ(loader.getColorFormat(), ImageLoader::ColorFormat::RGBA8);
+		ANKI_TEST_EXPECT_EQ(loader.getMipLevelsCount(), MIP_COUNT);
+		ANKI_TEST_EXPECT_EQ(memcmp(&loader.getSurface(0, 0, 0).m_data[0], &rgba[0], rgba.getSize()), 0);
+
+		const ImageLoader::Surface& mip1 = loader.getSurface(1, 0, 0);
+		ANKI_TEST_EXPECT_EQ(mip1.m_width, SIZE / 2);
+		const U x = 5, y = 9;
+		const U sum =
+			rgba[(2 * y * SIZE + 2 * x) * 4] + rgba[(2 * y * SIZE + 2 * x + 1) * 4]
+			+ rgba[((2 * y + 1) * SIZE + 2 * x) * 4] + rgba[((2 * y + 1) * SIZE + 2 * x + 1) * 4];
+		ANKI_TEST_EXPECT_EQ(mip1.m_data[(y * SIZE / 2 + x) * 4], (sum + 2) / 4);
+	}
+
+	// The S3TC data are close to the RAW ones
+	for(CString fname : {CString("rgba.ankitex"), CString("rgb.ankitex")})
+	{
+		const Bool alpha = fname == "rgba.ankitex";
+
+		ResourceFilePtr rfile;
+		ANKI_TEST_EXPECT_NO_ERR(fs.openFile(fname, rfile));
+		ImageLoader loader(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(loader.load(rfile, fname));
+
+		if(loader.getCompression() != ImageLoader::DataCompression::S3TC)
+		{
+			continue;
+		}
+
+		ANKI_TEST_EXPECT_EQ(loader.getMipLevelsCount(), MIP_COUNT);
+		ANKI_TEST_EXPECT_EQ(loader.getColorFormat(),
+			(alpha) ? ImageLoader::ColorFormat::RGBA8 : ImageLoader::ColorFormat::RGB8);
+
+		const ImageLoader::Surface& surf = loader.getSurface(0, 0, 0);
+		const U blockSize = (alpha) ? 16 : 8;
+		ANKI_TEST_EXPECT_EQ(surf.m_data.getSize(), (SIZE / 4) * (SIZE / 4) * blockSize);
+
+		I32 maxError = 0;
+		for(U by = 0; by < SIZE / 4; ++by)
+		{
+			for(U bx = 0; bx < SIZE / 4; ++bx)
+			{
+				Array<U8, 64> texels;
+				for(U i = 0; i < 16; ++i)
+				{
+					const U x = bx * 4 + i % 4;
+					const U y = by * 4 + i / 4;
+					memcpy(&texels[i * 4], &rgba[(y * SIZE + x) * 4], 4);
+				}
+
+				const U8* block = &surf.m_data[(by * (SIZE / 4) + bx) * blockSize + ((alpha) ? 8 : 0)];
+				maxError = max(maxError, bc1Error(block, &texels[0]));
+			}
+		}
+
+		ANKI_TEST_EXPECT_LEQ(maxError, 16);
+	}
+
+	ANKI_TEST_EXPECT_NO_ERR(removeDirectory(dir));
+}
+
+ANKI_TEST(Resource, TextureConverterBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 SIZE = 1024;
+	const U32 ITERATIONS = 4;
+
+	DynamicArrayAuto<U8> rgba(alloc);
+	createImage(SIZE, SIZE, 4, rgba);
+	DynamicArrayAuto<U8> mip(alloc);
+	mip.create(rgba.getSize() / 4);
+	DynamicArrayAuto<U8> blocks(alloc);
+	blocks.create((SIZE / 4) * (SIZE / 4) * 16);
+
+	ThreadHive hive(getCpuCoresCount(), alloc);
+	const F64 mpixels = F64(SIZE * SIZE) / 1000000.0;
+
+	for(ThreadHive* h : {static_cast<ThreadHive*>(nullptr), &hive})
+	{
+		TextureConverter converter(alloc, h);
+		const U32 threadCount = (h) ? h->getThreadCount() : 1;
+
+		for(Bool sRgb : {false, true})
+		{
+			const Second begin = HighRezTimer::getCurrentTime();
+			for(U i = 0; i < ITERATIONS; ++i)
+			{
+				converter.generateMip(rgba, SIZE, SIZE, 1, sRgb, false, WeakArray<U8>(mip));
+			}
+			const Second time = (HighRezTimer::getCurrentTime() - begin) / ITERATIONS;
+
+			ANKI_TEST_LOGI("Mip generation (%s, %u threads): %f MPixels/s",
+				(sRgb) ? "sRGB" : "linear",
+				threadCount,
+				mpixels / time);
+		}
+
+		for(Bool alpha : {false, true})
+		{
+			const PtrSize blocksSize = (SIZE / 4) * (SIZE / 4) * ((alpha) ? 16 : 8);
+			const Second begin = HighRezTimer::getCurrentTime();
+			for(U i = 0; i < ITERATIONS; ++i)
+			{
+				converter.encodeS3tc(rgba, SIZE, SIZE, 1, alpha, WeakArray<U8>(&blocks[0], blocksSize));
+			}
+			const Second time = (HighRezTimer::getCurrentTime() - begin) / ITERATIONS;
+
+			ANKI_TEST_LOGI(
+				"%s encoding (%u threads): %f MPixels/s", (alpha) ? "BC3" : "BC1", threadCount, mpixels / time);
+		}
+	}
+}
+
+} // end namespace anki
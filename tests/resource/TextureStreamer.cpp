@@ -0,0 +1,91 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/TextureStreamer.h>
+
+namespace anki
+{
+
+ANKI_TEST(Resource, TextureStreamingBudget)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// Like a 128x128 RGBA8 texture and a 32x32 one
+	const Array<PtrSize, 6> bigMips = {{65536, 16384, 4096, 1024, 256, 64}};
+	const Array<PtrSize, 3> smallMips = {{4096, 1024, 256}};
+	const PtrSize bigTail = 1024 + 256 + 64;
+	const PtrSize smallTail = 256;
+
+	Array<TextureStreamingRequest, 2> requests;
+	Array<U32, 2> mips;
+	WeakArray<U32> out(mips);
+
+	// Everything fits
+	{
+		requests[0].m_mipSizes = bigMips;
+		requests[0].m_firstTailMip = 3;
+		requests[0].m_wantedMip = 0;
+		requests[1].m_mipSizes = bigMips;
+		requests[1].m_firstTailMip = 3;
+		requests[1].m_wantedMip = 1;
+
+		const PtrSize mem = TextureStreamer::computeResidentMips(requests, 1_GB, alloc, out);
+		ANKI_TEST_EXPECT_EQ(mips[0], 0);
+		ANKI_TEST_EXPECT_EQ(mips[1], 1);
+		ANKI_TEST_EXPECT_EQ(mem, 2 * bigTail + 65536 + 2 * 16384 + 2 * 4096);
+	}
+
+	// The mip tails stay even if they don't fit. Textures that want less than the tail get the tail
+	{
+		requests[0].m_wantedMip = 0;
+		requests[1].m_wantedMip = 5;
+
+		const PtrSize mem = TextureStreamer::computeResidentMips(requests, 10, alloc, out);
+		ANKI_TEST_EXPECT_EQ(mips[0], 3);
+		ANKI_TEST_EXPECT_EQ(mips[1], 3);
+		ANKI_TEST_EXPECT_EQ(mem, 2 * bigTail);
+	}
+
+	// Textures that are equally blurry get finer mips in turns
+	{
+		requests[0].m_wantedMip = 0;
+		requests[1].m_wantedMip = 0;
+
+		const PtrSize budget = 2 * bigTail + 2 * 4096 + 16384;
+		const PtrSize mem = TextureStreamer::computeResidentMips(requests, budget, alloc, out);
+		ANKI_TEST_EXPECT_EQ(mips[0], 1);
+		ANKI_TEST_EXPECT_EQ(mips[1], 2);
+		ANKI_TEST_EXPECT_EQ(mem, budget);
+	}
+
+	// The blurriest texture goes first
+	{
+		requests[0].m_wantedMip = 2;
+		requests[1].m_wantedMip = 0;
+
+		const PtrSize budget = 2 * bigTail + 4096;
+		const PtrSize mem = TextureStreamer::computeResidentMips(requests, budget, alloc, out);
+		ANKI_TEST_EXPECT_EQ(mips[0], 3);
+		ANKI_TEST_EXPECT_EQ(mips[1], 2);
+		ANKI_TEST_EXPECT_EQ(mem, budget);
+	}
+
+	// A cheaper texture takes the memory that the other can't use
+	{
+		requests[0].m_wantedMip = 1;
+		requests[1].m_mipSizes = smallMips;
+		requests[1].m_firstTailMip = 2;
+		requests[1].m_wantedMip = 0;
+
+		const PtrSize budget = bigTail + smallTail + 1024 + 100;
+		const PtrSize mem = TextureStreamer::computeResidentMips(requests, budget, alloc, out);
+		ANKI_TEST_EXPECT_EQ(mips[0], 3);
+		ANKI_TEST_EXPECT_EQ(mips[1], 1);
+		ANKI_TEST_EXPECT_EQ(mem, bigTail + smallTail + 1024);
+	}
+}
+
+} // end namespace anki
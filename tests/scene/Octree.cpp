@@ -5,6 +5,9 @@
 
 #include <tests/framework/Framework.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/Bvh.h>
+#include <anki/collision/Functions.h>
+#include <anki/util/HighRezTimer.h>
 
 namespace anki
 {
@@ -86,4 +89,492 @@ ANKI_TEST(Scene, Octree)
 #endif
 }
 
+/// Create the planes of an axis aligned box.
+static void boxPlanes(const Vec3& min, const Vec3& max, Array<Plane, 6>& planes)
+{
+	planes[0] = Plane(Vec4(1.0f, 0.0f, 0.0f, 0.0f), min.x());
+	planes[1] = Plane(Vec4(-1.0f, 0.0f, 0.0f, 0.0f), -max.x());
+	planes[2] = Plane(Vec4(0.0f, 1.0f, 0.0f, 0.0f), min.y());
+	planes[3] = Plane(Vec4(0.0f, -1.0f, 0.0f, 0.0f), -max.y());
+	planes[4] = Plane(Vec4(0.0f, 0.0f, 1.0f, 0.0f), min.z());
+	planes[5] = Plane(Vec4(0.0f, 0.0f, -1.0f, 0.0f), -max.z());
+}
+
+static Aabb randomBox(F32 sceneSize, F32 maxBoxSize)
+{
+	const Vec3 min(randRange(-sceneSize, sceneSize - maxBoxSize),
+		randRange(-sceneSize, sceneSize - maxBoxSize),
+		randRange(-sceneSize, sceneSize - maxBoxSize));
+	const Vec3 size(randRange(0.1f, maxBoxSize), randRange(0.1f, maxBoxSize), randRange(0.1f, maxBoxSize));
+	return Aabb(min, min + size);
+}
+
+ANKI_TEST(Scene, Bvh)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const U COUNT = 2000;
+	const F32 SCENE_SIZE = 100.0f;
+
+	Bvh bvh(alloc);
+	bvh.init(0.5f);
+
+	std::vector<BvhPlaceable> placeables(COUNT);
+	std::vector<Aabb> boxes(COUNT);
+	std::vector<Bool> placed(COUNT, false);
+
+	auto check = [&]() {
+		// Frustum queries against brute force
+		for(U q = 0; q < 10; ++q)
+		{
+			const Aabb region = randomBox(SCENE_SIZE, SCENE_SIZE);
+			Array<Plane, 6> planes;
+			boxPlanes(region.getMin().xyz(), region.getMax().xyz(), planes);
+
+			DynamicArrayAuto<void*> visible(alloc);
+			bvh.gatherVisible(&planes[0], 0, nullptr, nullptr, visible);
+
+			U expectedCount = 0;
+			for(U i = 0; i < COUNT; ++i)
+			{
+				if(placed[i] && testCollision(boxes[i], region))
+				{
+					++expectedCount;
+					ANKI_TEST_EXPECT_NEQ(std::find(visible.getBegin(), visible.getEnd(), &placeables[i]),
+						visible.getEnd());
+				}
+			}
+			ANKI_TEST_EXPECT_EQ(visible.getSize(), expectedCount);
+		}
+
+		// Closest hit ray queries against brute force
+		Array<BvhRay, 100> rays;
+		Array<U, 100> closest;
+		for(BvhRay& ray : rays)
+		{
+			ray.m_origin = Vec3(randRange(-SCENE_SIZE, SCENE_SIZE), randRange(-SCENE_SIZE, SCENE_SIZE), -SCENE_SIZE);
+			ray.m_direction = Vec3(randRange(-0.5f, 0.5f), randRange(-0.5f, 0.5f), 1.0f);
+			ray.m_maxT = 2.0f * SCENE_SIZE;
+		}
+		for(U& c : closest)
+		{
+			c = MAX_U;
+		}
+
+		bvh.castRays(ConstWeakArray<BvhRay>(&rays[0], rays.getSize()),
+			[&](U32 rayIdx, void* userData, F32 tEnter, F32 maxT) {
+				closest[rayIdx] = static_cast<BvhPlaceable*>(userData) - &placeables[0];
+				return tEnter;
+			});
+
+		for(U r = 0; r < rays.getSize(); ++r)
+		{
+			F32 bestT = rays[r].m_maxT;
+			U best = MAX_U;
+			for(U i = 0; i < COUNT; ++i)
+			{
+				if(!placed[i])
+				{
+					continue;
+				}
+
+				// Slab test
+				Vec3 tmin(0.0f), tmax(0.0f);
+				for(U c = 0; c < 3; ++c)
+				{
+					const F32 t0 = (boxes[i].getMin()[c] - rays[r].m_origin[c]) / rays[r].m_direction[c];
+					const F32 t1 = (boxes[i].getMax()[c] - rays[r].m_origin[c]) / rays[r].m_direction[c];
+					tmin[c] = min(t0, t1);
+					tmax[c] = max(t0, t1);
+				}
+				const F32 t = max(max(tmin.x(), tmin.y()), max(tmin.z(), 0.0f));
+				const F32 tExit = min(min(tmax.x(), tmax.y()), tmax.z());
+				if(t <= tExit && t < bestT)
+				{
+					bestT = t;
+					best = i;
+				}
+			}
+
+			if(best != MAX_U)
+			{
+				ANKI_TEST_EXPECT_EQ(closest[r], best);
+			}
+		}
+	};
+
+	// Insert
+	for(U i = 0; i < COUNT; ++i)
+	{
+		placeables[i].m_userData = &placeables[i];
+		boxes[i] = randomBox(SCENE_SIZE, 5.0f);
+		bvh.place(boxes[i], &placeables[i], true);
+		placed[i] = true;
+	}
+	bvh.refit();
+	ANKI_TEST_EXPECT_EQ(bvh.getPlaceableCount(), COUNT);
+	check();
+
+	// Move some a bit and teleport others
+	for(U frame = 0; frame < 10; ++frame)
+	{
+		for(U i = 0; i < COUNT; i += 3)
+		{
+			if(i % 2)
+			{
+				const Vec4 offset(randRange(-1.0f, 1.0f), randRange(-1.0f, 1.0f), randRange(-1.0f, 1.0f), 0.0f);
+				boxes[i] = Aabb(boxes[i].getMin() + offset, boxes[i].getMax() + offset);
+			}
+			else
+			{
+				boxes[i] = randomBox(SCENE_SIZE, 5.0f);
+			}
+
+			bvh.place(boxes[i], &placeables[i], true);
+		}
+		bvh.refit();
+	}
+	check();
+
+	// Remove half. Some of them have pending placements
+	for(U i = 0; i < COUNT; i += 2)
+	{
+		if(i % 3 == 0)
+		{
+			bvh.place(boxes[i], &placeables[i], true);
+		}
+
+		bvh.remove(placeables[i]);
+		placed[i] = false;
+	}
+	bvh.refit();
+	ANKI_TEST_EXPECT_EQ(bvh.getPlaceableCount(), COUNT / 2);
+	check();
+
+	// Remove all
+	for(U i = 0; i < COUNT; ++i)
+	{
+		bvh.remove(placeables[i]);
+	}
+	ANKI_TEST_EXPECT_EQ(bvh.getPlaceableCount(), 0);
+}
+
+ANKI_TEST(Scene, OctreeVsBvhBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const U COUNT = 20000;
+	const U FRAMES = 20;
+	const U QUERIES_PER_FRAME = 8;
+	const F32 SCENE_SIZE = 1000.0f;
+
+	std::vector<Aabb> boxes(COUNT);
+	std::vector<Aabb> regions(QUERIES_PER_FRAME);
+	for(Aabb& box : boxes)
+	{
+		box = randomBox(SCENE_SIZE, 10.0f);
+	}
+
+	for(Aabb& region : regions)
+	{
+		region = randomBox(SCENE_SIZE, SCENE_SIZE);
+	}
+
+	// Move a quarter of the objects a bit every frame
+	auto moveBoxes = [&]() {
+		for(U i = 0; i < COUNT; i += 4)
+		{
+			const Vec4 offset(randRange(-0.5f, 0.5f), randRange(-0.5f, 0.5f), randRange(-0.5f, 0.5f), 0.0f);
+			boxes[i] = Aabb(boxes[i].getMin() + offset, boxes[i].getMax() + offset);
+		}
+	};
+
+	// Octree
+	{
+		Octree octree(alloc);
+		octree.init(Vec3(-SCENE_SIZE - 20.0f), Vec3(SCENE_SIZE + 20.0f), 5);
+		std::vector<OctreePlaceable> placeables(COUNT);
+
+		Second begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < COUNT; ++i)
+		{
+			placeables[i].m_userData = &placeables[i];
+			octree.place(boxes[i], &placeables[i], true);
+		}
+		const Second insertTime = HighRezTimer::getCurrentTime() - begin;
+
+		Second updateTime = 0.0;
+		Second queryTime = 0.0;
+		U visibleCount = 0;
+		for(U frame = 0; frame < FRAMES; ++frame)
+		{
+			moveBoxes();
+
+			begin = HighRezTimer::getCurrentTime();
+			for(U i = 0; i < COUNT; i += 4)
+			{
+				octree.place(boxes[i], &placeables[i], true);
+			}
+			updateTime += HighRezTimer::getCurrentTime() - begin;
+
+			begin = HighRezTimer::getCurrentTime();
+			for(OctreePlaceable& placeable : placeables)
+			{
+				placeable.reset();
+			}
+
+			for(U q = 0; q < QUERIES_PER_FRAME; ++q)
+			{
+				Array<Plane, 6> planes;
+				boxPlanes(regions[q].getMin().xyz(), regions[q].getMax().xyz(), planes);
+				DynamicArrayAuto<void*> visible(alloc);
+				octree.gatherVisible(&planes[0], q, nullptr, nullptr, visible);
+				visibleCount += visible.getSize();
+			}
+			queryTime += HighRezTimer::getCurrentTime() - begin;
+		}
+
+		ANKI_TEST_LOGI("Octree: insert %fms, update %fms/frame, query %fms/frame, visible %u/frame",
+			insertTime * 1000.0,
+			updateTime * 1000.0 / FRAMES,
+			queryTime * 1000.0 / FRAMES,
+			U32(visibleCount / FRAMES));
+
+		for(OctreePlaceable& placeable : placeables)
+		{
+			octree.remove(placeable);
+		}
+	}
+
+	// BVH
+	{
+		Bvh bvh(alloc);
+		bvh.init();
+		std::vector<BvhPlaceable> placeables(COUNT);
+
+		Second begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < COUNT; ++i)
+		{
+			placeables[i].m_userData = &placeables[i];
+			bvh.place(boxes[i], &placeables[i], true);
+		}
+		bvh.refit();
+		const Second insertTime = HighRezTimer::getCurrentTime() - begin;
+
+		Second updateTime = 0.0;
+		Second queryTime = 0.0;
+		U visibleCount = 0;
+		for(U frame = 0; frame < FRAMES; ++frame)
+		{
+			moveBoxes();
+
+			begin = HighRezTimer::getCurrentTime();
+			for(U i = 0; i < COUNT; i += 4)
+			{
+				bvh.place(boxes[i], &placeables[i], true);
+			}
+			bvh.refit();
+			updateTime += HighRezTimer::getCurrentTime() - begin;
+
+			begin = HighRezTimer::getCurrentTime();
+			for(U q = 0; q < QUERIES_PER_FRAME; ++q)
+			{
+				Array<Plane, 6> planes;
+				boxPlanes(regions[q].getMin().xyz(), regions[q].getMax().xyz(), planes);
+				DynamicArrayAuto<void*> visible(alloc);
+				bvh.gatherVisible(&planes[0], q, nullptr, nullptr, visible);
+				visibleCount += visible.getSize();
+			}
+			queryTime += HighRezTimer::getCurrentTime() - begin;
+		}
+
+		ANKI_TEST_LOGI("BVH: insert %fms, update %fms/frame, query %fms/frame, visible %u/frame, height %u",
+			insertTime * 1000.0,
+			updateTime * 1000.0 / FRAMES,
+			queryTime * 1000.0 / FRAMES,
+			U32(visibleCount / FRAMES),
+			bvh.computeHeight());
+
+		for(BvhPlaceable& placeable : placeables)
+		{
+			bvh.remove(placeable);
+		}
+	}
+}
+
+ANKI_TEST(Scene, OctreeMultiFrustum)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const U COUNT = 5000;
+	const U FRUSTUM_COUNT = 40;
+	const F32 SCENE_SIZE = 100.0f;
+
+	Octree octree(alloc);
+	octree.init(Vec3(-SCENE_SIZE - 10.0f), Vec3(SCENE_SIZE + 10.0f), 5);
+
+	std::vector<OctreePlaceable> placeables(COUNT);
+	std::vector<Aabb> boxes(COUNT);
+	for(U i = 0; i < COUNT; ++i)
+	{
+		placeables[i].m_userData = &placeables[i];
+		boxes[i] = randomBox(SCENE_SIZE, 5.0f);
+		octree.place(boxes[i], &placeables[i], true);
+	}
+
+	std::vector<Array<Plane, 6>> planes(FRUSTUM_COUNT);
+	std::vector<Aabb> regions(FRUSTUM_COUNT);
+	for(U f = 0; f < FRUSTUM_COUNT; ++f)
+	{
+		regions[f] = randomBox(SCENE_SIZE, SCENE_SIZE / 2.0f);
+		boxPlanes(regions[f].getMin().xyz(), regions[f].getMax().xyz(), planes[f]);
+	}
+
+	// Start from a test index other than zero to check the offsetting of the masks
+	const U32 firstTestId = 64 - FRUSTUM_COUNT;
+	std::vector<DynamicArrayAuto<void*>> visibles;
+	std::vector<DynamicArrayAuto<void*>*> outs(FRUSTUM_COUNT);
+	visibles.reserve(FRUSTUM_COUNT);
+	for(U f = 0; f < FRUSTUM_COUNT; ++f)
+	{
+		visibles.emplace_back(alloc);
+		outs[f] = &visibles[f];
+	}
+
+	octree.gatherVisibleMulti(ConstWeakArray<Array<Plane, 6>>(&planes[0], FRUSTUM_COUNT),
+		firstTestId,
+		WeakArray<DynamicArrayAuto<void*>*>(&outs[0], FRUSTUM_COUNT));
+
+	// Compare with brute force. The octree is conservative so it may return a few more
+	for(U f = 0; f < FRUSTUM_COUNT; ++f)
+	{
+		std::vector<Bool> found(COUNT, false);
+		for(void* placeable : visibles[f])
+		{
+			const U idx = static_cast<OctreePlaceable*>(placeable) - &placeables[0];
+			ANKI_TEST_EXPECT_EQ(found[idx], false);
+			found[idx] = true;
+		}
+
+		for(U i = 0; i < COUNT; ++i)
+		{
+			if(testCollision(boxes[i], regions[f]))
+			{
+				ANKI_TEST_EXPECT_EQ(found[i], true);
+			}
+		}
+	}
+
+	for(OctreePlaceable& placeable : placeables)
+	{
+		octree.remove(placeable);
+	}
+}
+
+ANKI_TEST(Scene, OctreeMultiFrustumBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const U COUNT = 50000;
+	const U FRUSTUM_COUNT = 64;
+	const U ITERATIONS = 20;
+	const F32 SCENE_SIZE = 1000.0f;
+
+	Octree octree(alloc);
+	octree.init(Vec3(-SCENE_SIZE - 20.0f), Vec3(SCENE_SIZE + 20.0f), 6);
+
+	std::vector<OctreePlaceable> placeables(COUNT);
+	for(OctreePlaceable& placeable : placeables)
+	{
+		placeable.m_userData = &placeable;
+		octree.place(randomBox(SCENE_SIZE, 10.0f), &placeable, true);
+	}
+
+	// Like the faces of point lights. Groups of frusta that split the space around a light
+	std::vector<Array<Plane, 6>> planes(FRUSTUM_COUNT);
+	for(U f = 0; f < FRUSTUM_COUNT; f += 8)
+	{
+		const F32 radius = 100.0f;
+		const Vec3 light(randRange(-SCENE_SIZE + radius, SCENE_SIZE - radius),
+			randRange(-SCENE_SIZE + radius, SCENE_SIZE - radius),
+			randRange(-SCENE_SIZE + radius, SCENE_SIZE - radius));
+
+		for(U i = 0; i < 8; ++i)
+		{
+			const Vec3 dir((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+			const Vec3 corner = light + dir * radius;
+			boxPlanes(light.min(corner), light.max(corner), planes[f + i]);
+		}
+	}
+
+	std::vector<DynamicArrayAuto<void*>> visibles;
+	std::vector<DynamicArrayAuto<void*>*> outs(FRUSTUM_COUNT);
+	visibles.reserve(FRUSTUM_COUNT);
+	for(U f = 0; f < FRUSTUM_COUNT; ++f)
+	{
+		visibles.emplace_back(alloc);
+		outs[f] = &visibles[f];
+	}
+
+	// One walk per frustum
+	Second singleTime = 0.0;
+	U singleVisibleCount = 0;
+	for(U it = 0; it < ITERATIONS; ++it)
+	{
+		for(OctreePlaceable& placeable : placeables)
+		{
+			placeable.reset();
+		}
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRUSTUM_COUNT; ++f)
+		{
+			visibles[f].destroy();
+			octree.gatherVisible(&planes[f][0], f, nullptr, nullptr, visibles[f]);
+			singleVisibleCount += visibles[f].getSize();
+		}
+		singleTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	// One walk for all
+	Second multiTime = 0.0;
+	U multiVisibleCount = 0;
+	for(U it = 0; it < ITERATIONS; ++it)
+	{
+		for(OctreePlaceable& placeable : placeables)
+		{
+			placeable.reset();
+		}
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U f = 0; f < FRUSTUM_COUNT; ++f)
+		{
+			visibles[f].destroy();
+		}
+
+		octree.gatherVisibleMulti(ConstWeakArray<Array<Plane, 6>>(&planes[0], FRUSTUM_COUNT),
+			0,
+			WeakArray<DynamicArrayAuto<void*>*>(&outs[0], FRUSTUM_COUNT));
+		multiTime += HighRezTimer::getCurrentTime() - begin;
+
+		for(U f = 0; f < FRUSTUM_COUNT; ++f)
+		{
+			multiVisibleCount += visibles[f].getSize();
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(singleVisibleCount, multiVisibleCount);
+	ANKI_TEST_LOGI("%u frusta over %u placeables: %fms with a walk per frustum, %fms with one walk. Visible %u",
+		U32(FRUSTUM_COUNT),
+		U32(COUNT),
+		singleTime * 1000.0 / ITERATIONS,
+		multiTime * 1000.0 / ITERATIONS,
+		U32(multiVisibleCount / ITERATIONS));
+
+	for(OctreePlaceable& placeable : placeables)
+	{
+		octree.remove(placeable);
+	}
+}
+
 } // end namespace anki
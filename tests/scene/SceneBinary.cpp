@@ -0,0 +1,157 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/core/Config.h>
+#include <anki/scene/SceneBinaryLoader.h>
+#include <anki/scene/SceneGraph.h>
+#include <anki/script/ScriptManager.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/System.h>
+#include <anki/util/StringList.h>
+#include <anki/util/HighRezTimer.h>
+
+namespace anki
+{
+
+/// Create the same nodes with a Lua script and with a binary scene and compare the times.
+ANKI_TEST(Scene, SceneBinaryLoad)
+{
+	const U NODE_COUNT = 10000;
+
+	Config cfg;
+	initConfig(cfg);
+	cfg.set("rsrc.dataPaths", "engine_data");
+
+	NativeWindow* win = createWindow(cfg);
+	GrManager* gr = createGrManager(cfg, win);
+	PhysicsWorld* physics;
+	ResourceFilesystem* fs;
+	ResourceManager* resource = createResourceManager(cfg, gr, physics, fs);
+
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive* hive = new ThreadHive(getCpuCoresCount(), alloc);
+	ScriptManager* script = new ScriptManager();
+	ANKI_TEST_EXPECT_NO_ERR(script->init(allocAligned, nullptr));
+	const Timestamp timestamp = 0;
+
+	// Generate the scenes. Half point lights and half reflection probes
+	StringListAuto lines(alloc);
+	lines.pushBackSprintf("local scene = getSceneGraph()");
+
+	SceneBinaryFile::Header header = {};
+	memcpy(&header.m_magic[0], SceneBinaryFile::MAGIC, sizeof(header.m_magic));
+	header.m_nodeCount = NODE_COUNT;
+
+	DynamicArrayAuto<SceneBinaryFile::Node> nodes(alloc);
+	nodes.create(NODE_COUNT);
+	StringListAuto names(alloc);
+	U32 stringTableSize = 0;
+
+	for(U i = 0; i < NODE_COUNT; ++i)
+	{
+		const Bool light = (i & 1) == 0;
+		const Vec3 origin(F32(i % 100), 1.0f, F32(i / 100));
+
+		SceneBinaryFile::Node& node = nodes[i];
+		memset(static_cast<void*>(&node), 0, sizeof(node));
+		node.m_name = stringTableSize;
+		node.m_resource = SceneBinaryFile::NO_STRING;
+		node.m_origin = origin;
+		node.m_scale = 1.0f;
+		node.m_rotation = Mat3::getIdentity();
+
+		names.pushBackSprintf("node%u", i);
+		stringTableSize += names.getBack().getLength() + 1;
+
+		if(light)
+		{
+			node.m_type = SceneBinaryFile::NodeType::POINT_LIGHT;
+			node.m_params[0] = Vec4(1.0f, 0.5f, 0.5f, 1.0f);
+			node.m_params[1] = Vec4(2.0f, 0.0f, 0.0f, 0.0f);
+
+			lines.pushBackSprintf("node = scene:newPointLightNode(\"node%u\")", i);
+			lines.pushBackSprintf("lcomp = node:getSceneNodeBase():getLightComponent()");
+			lines.pushBackSprintf("lcomp:setDiffuseColor(Vec4.new(1, 0.5, 0.5, 1))");
+			lines.pushBackSprintf("lcomp:setRadius(2)");
+		}
+		else
+		{
+			node.m_type = SceneBinaryFile::NodeType::REFLECTION_PROBE;
+			node.m_params[0] = Vec4(-1.0f, -1.0f, -1.0f, 0.0f);
+			node.m_params[1] = Vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+			lines.pushBackSprintf(
+				"node = scene:newReflectionProbeNode(\"node%u\", Vec4.new(-1, -1, -1, 0), Vec4.new(1, 1, 1, 0))", i);
+		}
+
+		// The same transform code the exporter writes
+		lines.pushBackSprintf("trf = Transform.new()");
+		lines.pushBackSprintf("trf:setOrigin(Vec4.new(%f, %f, %f, 0))", origin.x(), origin.y(), origin.z());
+		lines.pushBackSprintf("rot = Mat3x4.new()");
+		lines.pushBackSprintf("rot:setAll(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0)");
+		lines.pushBackSprintf("trf:setRotation(rot)");
+		lines.pushBackSprintf("trf:setScale(1)");
+		lines.pushBackSprintf("node:getSceneNodeBase():getMoveComponent():setLocalTransform(trf)");
+	}
+
+	StringAuto lua(alloc);
+	lines.join("\n", lua);
+
+	header.m_stringTableSize = stringTableSize;
+	DynamicArrayAuto<Vec4> binary(alloc);
+	const PtrSize binarySize = sizeof(header) + NODE_COUNT * sizeof(SceneBinaryFile::Node) + stringTableSize;
+	binary.create((binarySize + sizeof(Vec4) - 1) / sizeof(Vec4));
+	U8* mem = reinterpret_cast<U8*>(&binary[0]);
+	memcpy(mem, &header, sizeof(header));
+	mem += sizeof(header);
+	memcpy(mem, &nodes[0], NODE_COUNT * sizeof(SceneBinaryFile::Node));
+	mem += NODE_COUNT * sizeof(SceneBinaryFile::Node);
+	for(const String& name : names)
+	{
+		memcpy(mem, name.cstr(), name.getLength() + 1);
+		mem += name.getLength() + 1;
+	}
+
+	// Load them
+	for(U binaryScene = 0; binaryScene < 2; ++binaryScene)
+	{
+		SceneGraph* scene = new SceneGraph();
+		ANKI_TEST_EXPECT_NO_ERR(scene->init(allocAligned, nullptr, hive, resource, nullptr, script, &timestamp, cfg));
+		script->setSceneGraph(scene);
+		const U32 initialNodeCount = scene->getSceneNodesCount();
+
+		HighRezTimer timer;
+		timer.start();
+		if(binaryScene)
+		{
+			SceneBinaryLoader loader(scene);
+			ANKI_TEST_EXPECT_NO_ERR(loader.load(&binary[0], binarySize));
+		}
+		else
+		{
+			ANKI_TEST_EXPECT_NO_ERR(script->evalString(lua.toCString()));
+		}
+		timer.stop();
+
+		ANKI_TEST_EXPECT_EQ(scene->getSceneNodesCount(), initialNodeCount + NODE_COUNT);
+		ANKI_TEST_LOGI("%s: %u nodes loaded in %fms",
+			(binaryScene) ? "Binary" : "Lua",
+			U32(NODE_COUNT),
+			timer.getElapsedTime() * 1000.0);
+
+		delete scene;
+	}
+
+	delete script;
+	delete hive;
+	delete resource;
+	delete physics;
+	delete fs;
+	GrManager::deleteInstance(gr);
+	delete win;
+}
+
+} // end namespace anki
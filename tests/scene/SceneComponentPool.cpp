@@ -0,0 +1,302 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/scene/SceneComponentPool.h>
+#include <anki/scene/components/SceneComponent.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+#include <anki/Math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace anki
+{
+
+namespace
+{
+
+/// A component with a virtual update like the SceneComponent's.
+class BenchComponent : public SceneComponent
+{
+public:
+	BenchComponent(SceneComponentType type)
+		: SceneComponent(type)
+	{
+	}
+
+	virtual void benchUpdate() = 0;
+};
+
+/// Something like the SpatialComponent. It computes the AABB of a box.
+class BoxComponent final : public BenchComponent
+{
+public:
+	Transform m_trf = Transform::getIdentity();
+	Vec4 m_extend = Vec4(1.0f, 2.0f, 3.0f, 0.0f);
+	Vec4 m_aabbMin;
+	Vec4 m_aabbMax;
+
+	BoxComponent(U32 i)
+		: BenchComponent(SceneComponentType::SPATIAL)
+	{
+		m_trf.setOrigin(Vec4(F32(i), 0.0f, 0.0f, 0.0f));
+		m_trf.getRotation().rotateYAxis(F32(i));
+	}
+
+	void benchUpdate() override
+	{
+		m_aabbMin = Vec4(MAX_F32, MAX_F32, MAX_F32, 0.0f);
+		m_aabbMax = Vec4(MIN_F32, MIN_F32, MIN_F32, 0.0f);
+		for(U32 i = 0; i < 8; ++i)
+		{
+			const Vec4 corner((i & 1) ? m_extend.x() : -m_extend.x(),
+				(i & 2) ? m_extend.y() : -m_extend.y(),
+				(i & 4) ? m_extend.z() : -m_extend.z(),
+				0.0f);
+			const Vec4 point = m_trf.transform(corner);
+			m_aabbMin = m_aabbMin.min(point);
+			m_aabbMax = m_aabbMax.max(point);
+		}
+	}
+};
+
+/// Something like the LightComponent. It computes a texture matrix.
+class ProjectorComponent final : public BenchComponent
+{
+public:
+	Transform m_trf = Transform::getIdentity();
+	Mat4 m_textureMat;
+
+	ProjectorComponent(U32 i)
+		: BenchComponent(SceneComponentType::LIGHT)
+	{
+		m_trf.setOrigin(Vec4(0.0f, F32(i), 0.0f, 0.0f));
+	}
+
+	void benchUpdate() override
+	{
+		const Mat4 proj = Mat4::calculatePerspectiveProjectionMatrix(1.0f, 1.0f, 0.1f, 10.0f);
+		m_textureMat = proj * Mat4(m_trf.getInverse());
+	}
+};
+
+/// A node that owns its components like the SceneNode does.
+class BenchNode
+{
+public:
+	std::vector<SceneComponent*> m_components;
+};
+
+} // end namespace
+
+ANKI_TEST(Scene, SceneComponentPool)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	std::mt19937 rand(0);
+
+	SceneComponentPool pool;
+	pool.init(alloc);
+
+	// The nodes are only passed back by the iteration
+	std::vector<U8> nodesMem(1000);
+
+	class Allocation
+	{
+	public:
+		void* m_mem;
+		U32 m_handle;
+	};
+
+	std::vector<Allocation> allocations;
+	for(U32 round = 0; round < 10; ++round)
+	{
+		// Allocate some
+		const U32 newCount = U32(rand() % 500);
+		for(U32 i = 0; i < newCount; ++i)
+		{
+			Allocation a;
+			SceneNode* node = reinterpret_cast<SceneNode*>(&nodesMem[allocations.size() % nodesMem.size()]);
+			a.m_mem = pool.allocate(sizeof(BoxComponent), alignof(BoxComponent), node, a.m_handle);
+			ANKI_TEST_EXPECT_EQ(isAligned(alignof(BoxComponent), a.m_mem), true);
+			allocations.push_back(a);
+		}
+
+		// Free some
+		std::shuffle(allocations.begin(), allocations.end(), rand);
+		const U32 freeCount = U32(rand() % (allocations.size() + 1));
+		for(U32 i = 0; i < freeCount; ++i)
+		{
+			pool.free(allocations.back().m_handle);
+			allocations.pop_back();
+		}
+
+		// The iteration should see the live ones
+		ANKI_TEST_EXPECT_EQ(pool.getComponentCount(), allocations.size());
+		std::vector<void*> iterated;
+		for(U32 chunk = 0; chunk < pool.getChunkCount(); ++chunk)
+		{
+			pool.iterateChunk(chunk, [&](SceneComponent& comp, SceneNode& node) { iterated.push_back(&comp); });
+		}
+
+		std::vector<void*> expected;
+		for(const Allocation& a : allocations)
+		{
+			expected.push_back(a.m_mem);
+		}
+
+		std::sort(iterated.begin(), iterated.end());
+		std::sort(expected.begin(), expected.end());
+		ANKI_TEST_EXPECT_EQ(iterated == expected, true);
+
+		// No overlaps
+		for(U32 i = 1; i < expected.size(); ++i)
+		{
+			ANKI_TEST_EXPECT_GEQ(PtrSize(expected[i]) - PtrSize(expected[i - 1]), sizeof(BoxComponent));
+		}
+	}
+
+	for(const Allocation& a : allocations)
+	{
+		pool.free(a.m_handle);
+	}
+}
+
+/// Update the components of 100K nodes in node order through virtual calls and one type at a time from the pools.
+ANKI_TEST(Scene, SceneComponentPoolBench)
+{
+	const U32 NODE_COUNT = 100000;
+	const U32 ITERATIONS = 10;
+	const U32 CHUNKS_PER_TASK = 4;
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(getCpuCoresCount(), alloc, true);
+
+	// Every node has a box and half of them a projector. The components are allocated one by one with some other
+	// allocations in between like the nodes do
+	std::vector<BenchNode> nodes(NODE_COUNT);
+	std::vector<void*> otherAllocations;
+	for(U32 i = 0; i < NODE_COUNT; ++i)
+	{
+		nodes[i].m_components.push_back(alloc.newInstance<BoxComponent>(i));
+		otherAllocations.push_back(alloc.getMemoryPool().allocate(96, 16));
+		if(i % 2)
+		{
+			nodes[i].m_components.push_back(alloc.newInstance<ProjectorComponent>(i));
+			otherAllocations.push_back(alloc.getMemoryPool().allocate(160, 16));
+		}
+	}
+
+	SceneComponentPool boxPool;
+	boxPool.init(alloc);
+	SceneComponentPool projectorPool;
+	projectorPool.init(alloc);
+	std::vector<U8> nodesMem(NODE_COUNT);
+	std::vector<SceneComponent*> pooled;
+	for(U32 i = 0; i < NODE_COUNT; ++i)
+	{
+		SceneNode* node = reinterpret_cast<SceneNode*>(&nodesMem[i]);
+		U32 handle;
+		void* mem = boxPool.allocate(sizeof(BoxComponent), alignof(BoxComponent), node, handle);
+		pooled.push_back(::new(mem) BoxComponent(i));
+		pooled.back()->setPoolHandle(handle);
+
+		if(i % 2)
+		{
+			mem = projectorPool.allocate(
+				sizeof(ProjectorComponent), alignof(ProjectorComponent), node, handle);
+			pooled.push_back(::new(mem) ProjectorComponent(i));
+			pooled.back()->setPoolHandle(handle);
+		}
+	}
+
+	// Per node
+	Second nodeTime = 0.0;
+	for(U32 it = 0; it < ITERATIONS; ++it)
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(BenchNode& node : nodes)
+		{
+			for(SceneComponent* comp : node.m_components)
+			{
+				static_cast<BenchComponent*>(comp)->benchUpdate();
+			}
+		}
+		nodeTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	// Per type on one thread and then in parallel
+	auto updateBoxes = [&](U32 begin, U32 end, U32 threadId) {
+		for(U32 chunk = begin; chunk < end; ++chunk)
+		{
+			boxPool.iterateChunk(chunk, [](SceneComponent& comp, SceneNode& node) {
+				static_cast<BoxComponent&>(comp).BoxComponent::benchUpdate();
+			});
+		}
+	};
+
+	auto updateProjectors = [&](U32 begin, U32 end, U32 threadId) {
+		for(U32 chunk = begin; chunk < end; ++chunk)
+		{
+			projectorPool.iterateChunk(chunk, [](SceneComponent& comp, SceneNode& node) {
+				static_cast<ProjectorComponent&>(comp).ProjectorComponent::benchUpdate();
+			});
+		}
+	};
+
+	Second typeTime = 0.0;
+	Second parallelTypeTime = 0.0;
+	for(U32 it = 0; it < ITERATIONS; ++it)
+	{
+		Second begin = HighRezTimer::getCurrentTime();
+		updateBoxes(0, boxPool.getChunkCount(), 0);
+		updateProjectors(0, projectorPool.getChunkCount(), 0);
+		typeTime += HighRezTimer::getCurrentTime() - begin;
+
+		begin = HighRezTimer::getCurrentTime();
+		parallelFor(hive, 0, boxPool.getChunkCount(), CHUNKS_PER_TASK, updateBoxes);
+		parallelFor(hive, 0, projectorPool.getChunkCount(), CHUNKS_PER_TASK, updateProjectors);
+		parallelTypeTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	// Both got the same results
+	for(U32 i = 0; i < NODE_COUNT; i += 101)
+	{
+		const BoxComponent& a = *static_cast<const BoxComponent*>(nodes[i].m_components[0]);
+		const BoxComponent& b = *static_cast<const BoxComponent*>(pooled[i + i / 2]);
+		ANKI_TEST_EXPECT_EQ(a.m_aabbMin == b.m_aabbMin && a.m_aabbMax == b.m_aabbMax, true);
+	}
+
+	ANKI_TEST_LOGI("Updating the components of %u nodes: per node %fms, per type %fms, %u threads per type %fms",
+		NODE_COUNT,
+		nodeTime / ITERATIONS * 1000.0,
+		typeTime / ITERATIONS * 1000.0,
+		hive.getThreadCount(),
+		parallelTypeTime / ITERATIONS * 1000.0);
+
+	for(SceneComponent* comp : pooled)
+	{
+		const SceneComponentType type = comp->getType();
+		const U32 handle = comp->getPoolHandle();
+		comp->~SceneComponent();
+		((type == SceneComponentType::SPATIAL) ? boxPool : projectorPool).free(handle);
+	}
+
+	for(BenchNode& node : nodes)
+	{
+		for(SceneComponent* comp : node.m_components)
+		{
+			alloc.deleteInstance(comp);
+		}
+	}
+
+	for(void* mem : otherAllocations)
+	{
+		alloc.getMemoryPool().free(mem);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,345 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/scene/SoftwareRasterizer.h>
+#include <anki/collision/Aabb.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+
+namespace anki
+{
+
+/// A projection with 90 degrees FOV. A point (x, y, z) in view space is in the frustum if |x| <= -z and |y| <= -z.
+static Mat4 rastProjection()
+{
+	return Mat4::calculatePerspectiveProjectionMatrix(toRad(90.0f), toRad(90.0f), 1.0f, 20.0f);
+}
+
+static F32 rastDepth(F32 viewZ)
+{
+	const Vec4 p = rastProjection() * Vec4(0.0f, 0.0f, viewZ, 1.0f);
+	return p.z() / p.w();
+}
+
+/// A quad as 2 triangles. Every vertex is 4 floats to test the stride.
+static void pushQuad(DynamicArrayAuto<F32>& verts, const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& d)
+{
+	const Array<Vec3, 6> quad = {{a, b, c, a, c, d}};
+	for(const Vec3& v : quad)
+	{
+		verts.emplaceBack(v.x());
+		verts.emplaceBack(v.y());
+		verts.emplaceBack(v.z());
+		verts.emplaceBack(0.0f);
+	}
+}
+
+static void pushRandomTriangles(DynamicArrayAuto<F32>& verts, U32 count, F32 size)
+{
+	for(U32 i = 0; i < count; ++i)
+	{
+		const F32 z = randRange(-10.0f, -2.0f);
+		const Vec3 center(randRange(z, -z), randRange(z, -z), z);
+		for(U j = 0; j < 3; ++j)
+		{
+			verts.emplaceBack(center.x() + randRange(-size, size) * -z);
+			verts.emplaceBack(center.y() + randRange(-size, size) * -z);
+			verts.emplaceBack(center.z() + randRange(-0.5f, 0.5f));
+			verts.emplaceBack(0.0f);
+		}
+	}
+}
+
+/// The visibility test of a box against every pixel it covers.
+static Bool bruteForceVisibilityTest(
+	const SoftwareRasterizer& r, const Mat4& mvp, U32 width, U32 height, const Aabb& box)
+{
+	Vec4 bboxMin(MAX_F32);
+	Vec4 bboxMax(MIN_F32);
+	for(U i = 0; i < 8; ++i)
+	{
+		Vec4 p((i & 1) ? box.getMax().x() : box.getMin().x(),
+			(i & 2) ? box.getMax().y() : box.getMin().y(),
+			(i & 4) ? box.getMax().z() : box.getMin().z(),
+			1.0f);
+		p = mvp * p;
+		p /= p.w();
+		p = (p * Vec4(0.5f, 0.5f, 1.0f, 1.0f) + Vec4(0.5f, 0.5f, 0.0f, 0.0f)) * Vec4(width, height, 1.0f, 1.0f);
+		bboxMin = bboxMin.min(p);
+		bboxMax = bboxMax.max(p);
+	}
+
+	const U32 x0 = U32(clamp(floorf(bboxMin.x()), 0.0f, F32(width)));
+	const U32 x1 = U32(clamp(ceilf(bboxMax.x()), 0.0f, F32(width)));
+	const U32 y0 = U32(clamp(floorf(bboxMin.y()), 0.0f, F32(height)));
+	const U32 y1 = U32(clamp(ceilf(bboxMax.y()), 0.0f, F32(height)));
+	for(U32 y = y0; y < y1; ++y)
+	{
+		for(U32 x = x0; x < x1; ++x)
+		{
+			if(bboxMin.z() < r.getDepth(x, y))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+ANKI_TEST(Scene, SoftwareRasterizer)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 WIDTH = 100;
+	const U32 HEIGHT = 70;
+	const Mat4 proj = rastProjection();
+
+	// Golden depth of a quad that covers the screen
+	{
+		SoftwareRasterizer r;
+		r.init(alloc);
+		r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+
+		DynamicArrayAuto<F32> verts(alloc);
+		pushQuad(
+			verts, Vec3(-7.0f, -7.0f, -6.0f), Vec3(7.0f, -7.0f, -6.0f), Vec3(7.0f, 7.0f, -6.0f), Vec3(-7.0f, 7.0f, -6.0f));
+		r.draw(&verts[0], verts.getSize() / 4, sizeof(F32) * 4, true);
+		r.rasterize(nullptr);
+
+		for(U32 y = 0; y < HEIGHT; ++y)
+		{
+			for(U32 x = 0; x < WIDTH; ++x)
+			{
+				ANKI_TEST_EXPECT_NEAR(r.getDepth(x, y), rastDepth(-6.0f), 1.0e-5f);
+			}
+		}
+
+		// The coarsest level is 1x1
+		const UVec2 lastSize = r.getHiZLevelSize(r.getHiZLevelCount() - 1);
+		ANKI_TEST_EXPECT_EQ(lastSize.x(), 1);
+		ANKI_TEST_EXPECT_EQ(lastSize.y(), 1);
+
+		// A box behind the quad is occluded, one in front is not and one that crosses it is visible
+		ANKI_TEST_EXPECT_EQ(r.visibilityTest(Aabb(Vec3(-0.2f, -0.2f, -9.0f), Vec3(0.2f, 0.2f, -7.0f))), false);
+		ANKI_TEST_EXPECT_EQ(r.visibilityTest(Aabb(Vec3(-0.2f, -0.2f, -5.0f), Vec3(0.2f, 0.2f, -3.0f))), true);
+		ANKI_TEST_EXPECT_EQ(r.visibilityTest(Aabb(Vec3(-0.2f, -0.2f, -7.0f), Vec3(0.2f, 0.2f, -5.0f))), true);
+		ANKI_TEST_EXPECT_EQ(r.visibilityTest(Aabb(Vec3(-6.0f, -6.0f, -9.0f), Vec3(6.0f, 6.0f, -7.0f))), false);
+	}
+
+	// Golden depth of a tilted plane. Also backfacing
+	{
+		SoftwareRasterizer r;
+		r.init(alloc);
+		r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+
+		DynamicArrayAuto<F32> verts(alloc);
+		// The plane z = -6 - x / 2
+		pushQuad(verts,
+			Vec3(-5.0f, -15.0f, -3.5f),
+			Vec3(15.0f, -15.0f, -13.5f),
+			Vec3(15.0f, 15.0f, -13.5f),
+			Vec3(-5.0f, 15.0f, -3.5f));
+		pushQuad(
+			verts, Vec3(-1.0f, -1.0f, -2.0f), Vec3(-1.0f, 1.0f, -2.0f), Vec3(1.0f, 1.0f, -2.0f), Vec3(1.0f, -1.0f, -2.0f));
+		r.draw(&verts[0], verts.getSize() / 4, sizeof(F32) * 4, true);
+		r.rasterize(nullptr);
+
+		for(U32 y = 0; y < HEIGHT; ++y)
+		{
+			for(U32 x = 0; x < WIDTH; ++x)
+			{
+				const F32 ndcX = (F32(x) + 0.5f) / F32(WIDTH) * 2.0f - 1.0f;
+				const F32 viewZ = -6.0f / (1.0f - 0.5f * ndcX);
+				ANKI_TEST_EXPECT_NEAR(r.getDepth(x, y), rastDepth(viewZ), 1.0e-5f);
+			}
+		}
+	}
+
+	// Random triangles. Check the HiZ, the visibility tests and the parallel rasterization
+	{
+		DynamicArrayAuto<F32> verts(alloc);
+		pushRandomTriangles(verts, 200, 0.4f);
+
+		SoftwareRasterizer r;
+		r.init(alloc);
+		r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+		r.draw(&verts[0], verts.getSize() / 4, sizeof(F32) * 4, false);
+		r.rasterize(nullptr);
+
+		// The HiZ levels against the depth buffer
+		for(U32 level = 1; level < r.getHiZLevelCount(); ++level)
+		{
+			const UVec2 size = r.getHiZLevelSize(level);
+			for(U32 y = 0; y < size.y(); ++y)
+			{
+				for(U32 x = 0; x < size.x(); ++x)
+				{
+					F32 expectedMax = 0.0f;
+					F32 expectedMin = 1.0f;
+					for(U32 py = y << level; py < min((y + 1) << level, HEIGHT); ++py)
+					{
+						for(U32 px = x << level; px < min((x + 1) << level, WIDTH); ++px)
+						{
+							expectedMax = max(expectedMax, r.getDepth(px, py));
+							expectedMin = min(expectedMin, r.getDepth(px, py));
+						}
+					}
+
+					F32 maxDepth, minDepth;
+					r.getHiZ(level, x, y, maxDepth, minDepth);
+					ANKI_TEST_EXPECT_EQ(maxDepth, expectedMax);
+					ANKI_TEST_EXPECT_EQ(minDepth, expectedMin);
+				}
+			}
+		}
+
+		// The tests should never cull something that is visible
+		U32 culled = 0;
+		for(U i = 0; i < 2000; ++i)
+		{
+			const F32 z = randRange(-10.5f, -2.5f);
+			const Vec3 min(randRange(z * 1.2f, -z), randRange(z * 1.2f, -z), z);
+			const Vec3 size(randRange(0.01f, 0.5f), randRange(0.01f, 0.5f), randRange(0.01f, 1.0f));
+			const Aabb box(min, min + size * -z);
+
+			const Bool visible = r.visibilityTest(box);
+			const Bool expected = bruteForceVisibilityTest(r, proj, WIDTH, HEIGHT, box);
+			if(expected)
+			{
+				ANKI_TEST_EXPECT_EQ(visible, true);
+			}
+
+			culled += !visible;
+		}
+		ANKI_TEST_EXPECT_GT(culled, 0);
+
+		// The same with threads. It should be bit exact
+		ThreadHive hive(4, alloc);
+		SoftwareRasterizer r2;
+		r2.init(alloc);
+		r2.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+		const U32 vertCount = verts.getSize() / 4;
+		const U32 firstHalfVertCount = vertCount / 6 * 3;
+		r2.draw(&verts[0], firstHalfVertCount, sizeof(F32) * 4, false);
+		r2.draw(&verts[firstHalfVertCount * 4], vertCount - firstHalfVertCount, sizeof(F32) * 4, false);
+		r2.rasterize(&hive);
+
+		for(U32 y = 0; y < HEIGHT; ++y)
+		{
+			for(U32 x = 0; x < WIDTH; ++x)
+			{
+				ANKI_TEST_EXPECT_EQ(r.getDepth(x, y), r2.getDepth(x, y));
+			}
+		}
+	}
+
+	// Fill the depth buffer directly
+	{
+		SoftwareRasterizer r;
+		r.init(alloc);
+		r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+
+		DynamicArrayAuto<F32> depths(alloc);
+		depths.create(WIDTH * HEIGHT);
+		for(U32 i = 0; i < WIDTH * HEIGHT; ++i)
+		{
+			depths[i] = F32(i % WIDTH) / F32(WIDTH);
+		}
+
+		r.fillDepthBuffer(depths);
+		r.rasterize(nullptr);
+
+		for(U32 y = 0; y < HEIGHT; ++y)
+		{
+			for(U32 x = 0; x < WIDTH; ++x)
+			{
+				ANKI_TEST_EXPECT_EQ(r.getDepth(x, y), depths[y * WIDTH + x]);
+			}
+		}
+
+		F32 maxDepth, minDepth;
+		r.getHiZ(r.getHiZLevelCount() - 1, 0, 0, maxDepth, minDepth);
+		ANKI_TEST_EXPECT_EQ(maxDepth, depths[WIDTH - 1]);
+		ANKI_TEST_EXPECT_EQ(minDepth, 0.0f);
+	}
+}
+
+ANKI_TEST(Scene, SoftwareRasterizerBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 WIDTH = 512;
+	const U32 HEIGHT = 256;
+	const U32 TRIANGLE_COUNT = 20000;
+	const U32 BOX_COUNT = 50000;
+	const Mat4 proj = rastProjection();
+
+	DynamicArrayAuto<F32> verts(alloc);
+	pushRandomTriangles(verts, TRIANGLE_COUNT, 0.1f);
+
+	DynamicArrayAuto<Aabb> boxes(alloc);
+	boxes.create(BOX_COUNT);
+	for(Aabb& box : boxes)
+	{
+		const F32 z = randRange(-10.0f, -2.5f);
+		const Vec3 min(randRange(z, -z), randRange(z, -z), z);
+		box = Aabb(min, min + Vec3(randRange(0.01f, 0.2f), randRange(0.01f, 0.2f), randRange(0.01f, 0.2f)) * -z);
+	}
+
+	ThreadHive hive(getCpuCoresCount(), alloc);
+	SoftwareRasterizer r;
+	r.init(alloc);
+
+	// Serial
+	Second begin = HighRezTimer::getCurrentTime();
+	r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+	r.draw(&verts[0], verts.getSize() / 4, sizeof(F32) * 4, false);
+	r.rasterize(nullptr);
+	const Second serialTime = HighRezTimer::getCurrentTime() - begin;
+
+	// Parallel
+	begin = HighRezTimer::getCurrentTime();
+	r.prepare(Mat4::getIdentity(), proj, WIDTH, HEIGHT);
+	r.draw(&verts[0], verts.getSize() / 4, sizeof(F32) * 4, false);
+	r.rasterize(&hive);
+	const Second parallelTime = HighRezTimer::getCurrentTime() - begin;
+
+	// HiZ tests
+	U32 visibleCount = 0;
+	begin = HighRezTimer::getCurrentTime();
+	for(const Aabb& box : boxes)
+	{
+		visibleCount += r.visibilityTest(box);
+	}
+	const Second hizTime = HighRezTimer::getCurrentTime() - begin;
+
+	// Per pixel tests
+	U32 bruteVisibleCount = 0;
+	const Mat4 mvp = proj;
+	begin = HighRezTimer::getCurrentTime();
+	for(const Aabb& box : boxes)
+	{
+		bruteVisibleCount += bruteForceVisibilityTest(r, mvp, WIDTH, HEIGHT, box);
+	}
+	const Second bruteTime = HighRezTimer::getCurrentTime() - begin;
+
+	ANKI_TEST_EXPECT_GEQ(visibleCount, bruteVisibleCount);
+	ANKI_TEST_LOGI("Rasterizing %u triangles at %ux%u: serial %fms, %u threads %fms",
+		TRIANGLE_COUNT,
+		WIDTH,
+		HEIGHT,
+		serialTime * 1000.0,
+		hive.getThreadCount(),
+		parallelTime * 1000.0);
+	ANKI_TEST_LOGI("Testing %u boxes: HiZ %fms (%u visible), per pixel %fms (%u visible)",
+		BOX_COUNT,
+		hizTime * 1000.0,
+		visibleCount,
+		bruteTime * 1000.0,
+		bruteVisibleCount);
+}
+
+} // end namespace anki
@@ -0,0 +1,446 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/scene/TransformHierarchy.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace anki
+{
+
+namespace
+{
+
+/// A transform as the MoveComponent used to have it. The nodes point to their parents and children.
+class PointerTransform
+{
+public:
+	Transform m_local = Transform::getIdentity();
+	Transform m_world = Transform::getIdentity();
+	Transform m_prevWorld = Transform::getIdentity();
+	PointerTransform* m_parent = nullptr;
+	std::vector<PointerTransform*> m_children;
+	Bool m_dirty = true;
+
+	void update()
+	{
+		m_prevWorld = m_world;
+		if(m_dirty)
+		{
+			m_world = (m_parent) ? m_parent->m_world.combineTransformations(m_local) : m_local;
+			m_dirty = false;
+
+			for(PointerTransform* child : m_children)
+			{
+				child->m_dirty = true;
+			}
+		}
+
+		for(PointerTransform* child : m_children)
+		{
+			child->update();
+		}
+	}
+};
+
+/// The reference of the test. A transform that is created and never deleted.
+class RefTransform
+{
+public:
+	Transform m_local = Transform::getIdentity();
+	Transform m_world = Transform::getIdentity();
+	U32 m_handle = MAX_U32; ///< MAX_U32 if it's deleted.
+	U32 m_parent = MAX_U32; ///< Index of the parent RefTransform.
+	Bool m_ignoreLocal = false;
+};
+
+} // end namespace
+
+static Transform randomTransform(std::mt19937& rand)
+{
+	std::uniform_real_distribution<F32> dist(-1.0f, 1.0f);
+	Mat3x4 rot = Mat3x4::getIdentity();
+	rot.rotateXAxis(dist(rand));
+	rot.rotateYAxis(dist(rand));
+	return Transform(Vec4(dist(rand), dist(rand), dist(rand), 0.0f), rot, 1.0f + dist(rand) * 0.1f);
+}
+
+/// Compute the world transforms of the reference from the roots to the leafs. The parents have smaller indices.
+static void computeReference(std::vector<RefTransform>& refs)
+{
+	for(RefTransform& ref : refs)
+	{
+		if(ref.m_handle == MAX_U32)
+		{
+			continue;
+		}
+
+		if(ref.m_parent == MAX_U32)
+		{
+			ref.m_world = ref.m_local;
+		}
+		else if(ref.m_ignoreLocal)
+		{
+			ref.m_world = refs[ref.m_parent].m_world;
+		}
+		else
+		{
+			ref.m_world = refs[ref.m_parent].m_world.combineTransformations(ref.m_local);
+		}
+	}
+}
+
+ANKI_TEST(Scene, TransformHierarchy)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(getCpuCoresCount(), alloc, true);
+	std::mt19937 rand(0);
+
+	TransformHierarchy hierarchy(alloc);
+	std::vector<RefTransform> refs;
+
+	const U32 FRAME_COUNT = 20;
+	for(U32 frame = 0; frame < FRAME_COUNT; ++frame)
+	{
+		// Add some. Give them an older transform as parent to avoid cycles
+		const U32 newCount = (frame < 2) ? 3000 : 100;
+		for(U32 i = 0; i < newCount; ++i)
+		{
+			RefTransform ref;
+			ref.m_ignoreLocal = (rand() % 16) == 0;
+			ref.m_handle = hierarchy.newTransform(ref.m_ignoreLocal);
+			ref.m_local = randomTransform(rand);
+			hierarchy.editLocalTransform(ref.m_handle) = ref.m_local;
+
+			if(refs.size() && (rand() % 8) != 0)
+			{
+				const U32 parent = U32(rand() % refs.size());
+				if(refs[parent].m_handle != MAX_U32)
+				{
+					ref.m_parent = parent;
+					hierarchy.setParent(ref.m_handle, refs[parent].m_handle);
+				}
+			}
+
+			refs.push_back(ref);
+		}
+
+		// Move, re-parent and delete some
+		for(U32 i = 0; i < refs.size(); ++i)
+		{
+			RefTransform& ref = refs[i];
+			if(ref.m_handle == MAX_U32)
+			{
+				continue;
+			}
+
+			const U32 op = rand() % 100;
+			if(op < 10)
+			{
+				ref.m_local = randomTransform(rand);
+				hierarchy.editLocalTransform(ref.m_handle) = ref.m_local;
+			}
+			else if(op < 12 && i > 0)
+			{
+				const U32 parent = U32(rand() % i);
+				ref.m_parent = (refs[parent].m_handle != MAX_U32) ? parent : MAX_U32;
+				hierarchy.setParent(ref.m_handle, (ref.m_parent != MAX_U32) ? refs[parent].m_handle : MAX_U32);
+			}
+			else if(op < 13)
+			{
+				hierarchy.deleteTransform(ref.m_handle);
+				ref.m_handle = MAX_U32;
+
+				for(U32 j = i + 1; j < refs.size(); ++j)
+				{
+					if(refs[j].m_parent == i)
+					{
+						refs[j].m_parent = MAX_U32;
+					}
+				}
+			}
+		}
+
+		// Keep the world transforms of the previous frame
+		std::vector<Transform> prevWorlds;
+		for(const RefTransform& ref : refs)
+		{
+			prevWorlds.push_back(ref.m_world);
+		}
+
+		computeReference(refs);
+		hierarchy.update(hive);
+
+		U32 aliveCount = 0;
+		for(U32 i = 0; i < refs.size(); ++i)
+		{
+			const RefTransform& ref = refs[i];
+			if(ref.m_handle == MAX_U32)
+			{
+				continue;
+			}
+
+			++aliveCount;
+			ANKI_TEST_EXPECT_EQ(hierarchy.getWorldTransform(ref.m_handle) == ref.m_world, true);
+			ANKI_TEST_EXPECT_EQ(hierarchy.isDirty(ref.m_handle), false);
+
+			// The new ones don't have a previous transform yet
+			if(i < refs.size() - newCount)
+			{
+				ANKI_TEST_EXPECT_EQ(hierarchy.getPreviousWorldTransform(ref.m_handle) == prevWorlds[i], true);
+			}
+		}
+		ANKI_TEST_EXPECT_EQ(hierarchy.getTransformCount(), aliveCount);
+	}
+
+	// Move a transform after the update
+	{
+		U32 idx = 0;
+		while(refs[idx].m_handle == MAX_U32)
+		{
+			++idx;
+		}
+
+		RefTransform& ref = refs[idx];
+		ref.m_local = randomTransform(rand);
+		hierarchy.editLocalTransform(ref.m_handle) = ref.m_local;
+		ANKI_TEST_EXPECT_EQ(hierarchy.isDirty(ref.m_handle), true);
+
+		hierarchy.updateWorldTransform(ref.m_handle);
+		computeReference(refs);
+		ANKI_TEST_EXPECT_EQ(hierarchy.isDirty(ref.m_handle), false);
+		ANKI_TEST_EXPECT_EQ(hierarchy.wasUpdated(ref.m_handle), true);
+		ANKI_TEST_EXPECT_EQ(hierarchy.getWorldTransform(ref.m_handle) == ref.m_world, true);
+
+		for(const RefTransform& child : refs)
+		{
+			if(child.m_parent == idx && child.m_handle != MAX_U32)
+			{
+				ANKI_TEST_EXPECT_EQ(hierarchy.isDirty(child.m_handle), true);
+			}
+		}
+
+		// The next update catches up
+		hierarchy.update(hive);
+		for(const RefTransform& r : refs)
+		{
+			if(r.m_handle != MAX_U32)
+			{
+				ANKI_TEST_EXPECT_EQ(hierarchy.getWorldTransform(r.m_handle) == r.m_world, true);
+			}
+		}
+	}
+
+	for(const RefTransform& ref : refs)
+	{
+		if(ref.m_handle != MAX_U32)
+		{
+			hierarchy.deleteTransform(ref.m_handle);
+		}
+	}
+}
+
+/// Create transforms and set them from many threads at the same time like the scene loader does.
+ANKI_TEST(Scene, TransformHierarchyParallelCreate)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(4, alloc);
+
+	TransformHierarchy hierarchy(alloc);
+
+	class TaskCtx
+	{
+	public:
+		TransformHierarchy* m_hierarchy;
+		U32 m_seed;
+		std::vector<U32> m_handles;
+		std::vector<Transform> m_locals;
+	};
+
+	const U32 TASK_COUNT = 8;
+	const U32 COUNT_PER_TASK = 5000;
+	Array<TaskCtx, TASK_COUNT> ctxs;
+	Array<ThreadHiveTask, TASK_COUNT> tasks;
+	for(U32 i = 0; i < TASK_COUNT; ++i)
+	{
+		ctxs[i].m_hierarchy = &hierarchy;
+		ctxs[i].m_seed = i;
+
+		tasks[i].m_callback = [](void* ud, U32 threadId, ThreadHive& hive, ThreadHiveSemaphore* sem) {
+			TaskCtx& ctx = *static_cast<TaskCtx*>(ud);
+			std::mt19937 rand(ctx.m_seed);
+
+			for(U32 j = 0; j < COUNT_PER_TASK; ++j)
+			{
+				const U32 handle = ctx.m_hierarchy->newTransform();
+				if(ctx.m_hierarchy->getParent(handle) != MAX_U32)
+				{
+					ANKI_TEST_LOGF("A new transform has a parent");
+				}
+
+				const Transform trf = randomTransform(rand);
+				ctx.m_hierarchy->setLocalTransform(handle, trf);
+
+				ctx.m_handles.push_back(handle);
+				ctx.m_locals.push_back(trf);
+			}
+		};
+		tasks[i].m_argument = &ctxs[i];
+		tasks[i].m_waitSemaphore = nullptr;
+		tasks[i].m_signalSemaphore = nullptr;
+	}
+
+	hive.submitTasks(&tasks[0], TASK_COUNT);
+	hive.waitAllTasks();
+
+	ANKI_TEST_EXPECT_EQ(hierarchy.getTransformCount(), COUNT_PER_TASK * TASK_COUNT);
+	hierarchy.update(hive);
+
+	for(const TaskCtx& ctx : ctxs)
+	{
+		for(U32 j = 0; j < COUNT_PER_TASK; ++j)
+		{
+			const U32 handle = ctx.m_handles[j];
+			ANKI_TEST_EXPECT_EQ(hierarchy.getLocalTransform(handle) == ctx.m_locals[j], true);
+			ANKI_TEST_EXPECT_EQ(hierarchy.getWorldTransform(handle) == ctx.m_locals[j], true);
+			hierarchy.deleteTransform(handle);
+		}
+	}
+}
+
+/// Update 100K transforms with the TransformHierarchy and by walking the transforms that point to each other like the
+/// scene nodes used to do.
+ANKI_TEST(Scene, TransformHierarchyBench)
+{
+	const U32 COUNT = 100000;
+	const U32 ITERATIONS = 20;
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(getCpuCoresCount(), alloc, true);
+
+	// The parent of a transform. It's always a previous transform
+	using GetParentFunc = U32 (*)(U32 i);
+	const Array<GetParentFunc, 3> getParents = {{[](U32 i) { return (i % 100) ? i - (i % 100) : MAX_U32; },
+		[](U32 i) { return (i) ? (i - 1) / 2 : MAX_U32; },
+		[](U32 i) { return (i % 1000) ? i - 1 : MAX_U32; }}};
+	const Array<const char*, 3> shapeNames = {
+		{"shallow (1000 roots with 99 children)", "deep (binary tree)", "very deep (100 chains of 1000)"}};
+
+	std::mt19937 rand(1);
+	for(U32 shape = 0; shape < getParents.getSize(); ++shape)
+	{
+		// Create the pointer transforms in random order in memory
+		std::vector<U32> order(COUNT);
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), rand);
+
+		std::vector<PointerTransform*> ptrs(COUNT);
+		for(U32 i : order)
+		{
+			ptrs[i] = new PointerTransform();
+		}
+
+		std::vector<PointerTransform*> roots;
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			const U32 parent = getParents[shape](i);
+			if(parent != MAX_U32)
+			{
+				ptrs[i]->m_parent = ptrs[parent];
+				ptrs[parent]->m_children.push_back(ptrs[i]);
+			}
+			else
+			{
+				roots.push_back(ptrs[i]);
+			}
+		}
+
+		TransformHierarchy hierarchy(alloc);
+		std::vector<U32> handles(COUNT);
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			handles[i] = hierarchy.newTransform();
+			const U32 parent = getParents[shape](i);
+			if(parent != MAX_U32)
+			{
+				hierarchy.setParent(handles[i], handles[parent]);
+			}
+		}
+		hierarchy.update(hive);
+
+		// Move all the roots and then move a few random transforms
+		std::vector<U32> allRoots;
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			if(getParents[shape](i) == MAX_U32)
+			{
+				allRoots.push_back(i);
+			}
+		}
+
+		std::vector<U32> fewRandom(COUNT / 100);
+		for(U32& i : fewRandom)
+		{
+			i = rand() % COUNT;
+		}
+
+		const Array<const std::vector<U32>*, 2> moves = {{&allRoots, &fewRandom}};
+		const Array<const char*, 2> moveNames = {{"all move", "1% move"}};
+		for(U32 m = 0; m < moves.getSize(); ++m)
+		{
+			Second ptrTime = 0.0;
+			Second hierarchyTime = 0.0;
+			for(U32 it = 0; it < ITERATIONS; ++it)
+			{
+				const Transform trf(Vec4(F32(it), 0.0f, 0.0f, 0.0f), Mat3x4::getIdentity(), 1.0f);
+				for(U32 i : *moves[m])
+				{
+					ptrs[i]->m_local = trf;
+					ptrs[i]->m_dirty = true;
+					hierarchy.editLocalTransform(handles[i]) = trf;
+				}
+
+				Second begin = HighRezTimer::getCurrentTime();
+				for(PointerTransform* root : roots)
+				{
+					root->update();
+				}
+				ptrTime += HighRezTimer::getCurrentTime() - begin;
+
+				begin = HighRezTimer::getCurrentTime();
+				hierarchy.update(hive);
+				hierarchyTime += HighRezTimer::getCurrentTime() - begin;
+			}
+
+			for(U32 i = 0; i < COUNT; i += 97)
+			{
+				ANKI_TEST_EXPECT_EQ(hierarchy.getWorldTransform(handles[i]) == ptrs[i]->m_world, true);
+			}
+
+			ANKI_TEST_LOGI("Updating %u transforms, %s, %s: pointers %fms, %u threads hierarchy %fms",
+				COUNT,
+				shapeNames[shape],
+				moveNames[m],
+				ptrTime / ITERATIONS * 1000.0,
+				hive.getThreadCount(),
+				hierarchyTime / ITERATIONS * 1000.0);
+		}
+
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			hierarchy.deleteTransform(handles[i]);
+			delete ptrs[i];
+		}
+	}
+}
+
+} // end namespace anki
@@ -7,6 +7,8 @@
 #include "tests/util/Foo.h"
 #include "anki/util/Memory.h"
 #include "anki/util/ThreadPool.h"
+#include "anki/util/HighRezTimer.h"
+#include "anki/util/String.h"
 #include <type_traits>
 #include <cstring>
 
@@ -218,3 +220,360 @@ ANKI_TEST(Util, ChainMemoryPool)
 		ANKI_TEST_EXPECT_EQ(pool.getChunksCount(), 0);
 	}
 }
+
+ANKI_TEST(Util, MemoryPoolThreadCache)
+{
+	// Heap and chain with cache
+	for(U p = 0; p < 2; ++p)
+	{
+		HeapMemoryPool heapPool;
+		ChainMemoryPool chainPool;
+		BaseMemoryPool* pool;
+		if(p == 0)
+		{
+			heapPool.create(allocAligned, nullptr, true);
+			pool = &heapPool;
+		}
+		else
+		{
+			chainPool.create(allocAligned, nullptr, 1024, 2.0, 0, ANKI_SAFE_ALIGNMENT, true);
+			pool = &chainPool;
+		}
+
+		// Different sizes and alignments. Some will bypass the cache
+		const U COUNT = 1000;
+		Array<U8*, COUNT> ptrs;
+		Array<PtrSize, COUNT> sizes;
+		for(U i = 0; i < COUNT; ++i)
+		{
+			sizes[i] = (i % 10 == 0) ? (i * 17 % 9000 + 1) : (i * 13 % 600 + 1);
+			const PtrSize alignment = (p == 0 && i % 7 == 0) ? 64 : (PtrSize(1) << (i % 5));
+			ptrs[i] = static_cast<U8*>(pool->allocate(sizes[i], alignment));
+			ANKI_TEST_EXPECT_NEQ(ptrs[i], nullptr);
+			ANKI_TEST_EXPECT_EQ(isAligned(alignment, ptrs[i]), true);
+			memset(ptrs[i], U8(i), sizes[i]);
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool->getAllocationsCount(), COUNT);
+
+		for(U i = 0; i < COUNT; ++i)
+		{
+			for(PtrSize j = 0; j < sizes[i]; ++j)
+			{
+				if(ptrs[i][j] != U8(i))
+				{
+					ANKI_TEST_EXPECT_EQ(ptrs[i][j], U8(i));
+					break;
+				}
+			}
+
+			pool->free(ptrs[i]);
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool->getAllocationsCount(), 0);
+
+		// Allocate again, the cache should serve them
+		const ThreadCacheStats statsBefore = pool->getThreadCacheStats();
+		void* ptr = pool->allocate(100, 16);
+		pool->free(ptr);
+		const ThreadCacheStats statsAfter = pool->getThreadCacheStats();
+		ANKI_TEST_EXPECT_EQ(statsAfter.m_hitCount, statsBefore.m_hitCount + 1);
+		ANKI_TEST_EXPECT_EQ(statsAfter.m_threadCount, 1);
+		ANKI_TEST_EXPECT_GT(statsAfter.m_cachedMemory, 0);
+	}
+
+	// Allocate in one thread and free in another
+	{
+		HeapMemoryPool pool;
+		pool.create(allocAligned, nullptr, true);
+		const U THREAD_COUNT = 4;
+		const U ALLOC_COUNT = 1000;
+		ThreadPool threadPool(THREAD_COUNT);
+		Array<void*, THREAD_COUNT * ALLOC_COUNT> ptrs;
+
+		class Task : public ThreadPoolTask
+		{
+		public:
+			HeapMemoryPool* m_pool;
+			void** m_ptrs;
+			Bool m_free;
+
+			Error operator()(U32 taskId, PtrSize threadsCount)
+			{
+				for(U i = 0; i < ALLOC_COUNT; ++i)
+				{
+					void*& ptr = m_ptrs[i];
+					if(m_free)
+					{
+						m_pool->free(ptr);
+					}
+					else
+					{
+						ptr = m_pool->allocate(i % 300 + 1, 8);
+						memset(ptr, 0xAB, i % 300 + 1);
+					}
+				}
+
+				return Error::NONE;
+			}
+		};
+
+		Array<Task, THREAD_COUNT> tasks;
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_pool = &pool;
+			tasks[i].m_ptrs = &ptrs[i * ALLOC_COUNT];
+			tasks[i].m_free = false;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), THREAD_COUNT * ALLOC_COUNT);
+
+		// Every thread frees the allocations of another
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_ptrs = &ptrs[((i + 1) % THREAD_COUNT) * ALLOC_COUNT];
+			tasks[i].m_free = true;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+	}
+}
+
+ANKI_TEST(Util, MemoryPoolContention)
+{
+	const U THREAD_COUNT = 8;
+	const U ITERATION_COUNT = 200000;
+	const U LIVE_COUNT = 64;
+
+	class Task : public ThreadPoolTask
+	{
+	public:
+		BaseMemoryPool* m_pool;
+
+		Error operator()(U32 taskId, PtrSize threadsCount)
+		{
+			// Keep a ring of live allocations of mixed sizes like containers and small objects do
+			Array<void*, LIVE_COUNT> live;
+			for(void*& ptr : live)
+			{
+				ptr = nullptr;
+			}
+
+			U32 seed = taskId * 7919 + 1;
+			for(U i = 0; i < ITERATION_COUNT; ++i)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				const PtrSize size = 8 + (seed >> 16) % 256;
+
+				void*& slot = live[i % LIVE_COUNT];
+				if(slot)
+				{
+					m_pool->free(slot);
+				}
+
+				slot = m_pool->allocate(size, 8);
+				static_cast<U8*>(slot)[0] = U8(i);
+			}
+
+			for(void* ptr : live)
+			{
+				m_pool->free(ptr);
+			}
+
+			return Error::NONE;
+		}
+	};
+
+	ThreadPool threadPool(THREAD_COUNT);
+	Array<Task, THREAD_COUNT> tasks;
+
+	auto run = [&](BaseMemoryPool& pool, CString name) {
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_pool = &pool;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+		const Second time = HighRezTimer::getCurrentTime() - begin;
+
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+		const ThreadCacheStats stats = pool.getThreadCacheStats();
+		printf("%-24s %u threads x %u alloc/free: %8.3fms (cache hits %" PRIu64 ", misses %" PRIu64 ")\n",
+			name.cstr(),
+			U32(THREAD_COUNT),
+			U32(ITERATION_COUNT),
+			time * 1000.0,
+			stats.m_hitCount,
+			stats.m_missCount);
+	};
+
+	{
+		HeapMemoryPool pool;
+		pool.create(allocAligned, nullptr);
+		run(pool, "Heap");
+	}
+
+	{
+		HeapMemoryPool pool;
+		pool.create(allocAligned, nullptr, true);
+		run(pool, "Heap with thread cache");
+	}
+
+	{
+		ChainMemoryPool pool;
+		pool.create(allocAligned, nullptr, 64 * 1024);
+		run(pool, "Chain");
+	}
+
+	{
+		ChainMemoryPool pool;
+		pool.create(allocAligned, nullptr, 64 * 1024, 2.0, 0, ANKI_SAFE_ALIGNMENT, true);
+		run(pool, "Chain with thread cache");
+	}
+}
+
+ANKI_TEST(Util, StackMemoryPoolThreadArenas)
+{
+	const U THREAD_COUNT = 8;
+	const U ALLOC_COUNT = 1000;
+	ThreadPool threadPool(THREAD_COUNT);
+
+	class Task : public ThreadPoolTask
+	{
+	public:
+		StackMemoryPool* m_pool = nullptr;
+		Array<U8*, ALLOC_COUNT> m_ptrs;
+
+		Error operator()(U32 taskId, PtrSize threadsCount)
+		{
+			for(U i = 0; i < ALLOC_COUNT; ++i)
+			{
+				// Mix small allocations that go to the arena with bigger ones that don't
+				const PtrSize size = (i % 10 == 0) ? 3000 : 8 + i % 100;
+				m_ptrs[i] = static_cast<U8*>(m_pool->allocate(size, 16));
+				memset(m_ptrs[i], U8(taskId * 31 + i), size);
+			}
+
+			// Free half of them from this thread
+			for(U i = 0; i < ALLOC_COUNT; i += 2)
+			{
+				m_pool->free(m_ptrs[i]);
+			}
+
+			return Error::NONE;
+		}
+	};
+
+	StackMemoryPool pool;
+	pool.create(allocAligned, nullptr, 64 * 1024, 2.0, 0, false, 16, 8 * 1024);
+	Array<Task, THREAD_COUNT> tasks;
+
+	for(U frame = 0; frame < 3; ++frame)
+	{
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_pool = &pool;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+
+		// Nothing should overlap
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			for(U j = 0; j < ALLOC_COUNT; ++j)
+			{
+				const PtrSize size = (j % 10 == 0) ? 3000 : 8 + j % 100;
+				const U8 magic = U8(i * 31 + j);
+				for(U k = 0; k < size; ++k)
+				{
+					ANKI_TEST_EXPECT_EQ(tasks[i].m_ptrs[j][k], magic);
+				}
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), THREAD_COUNT * ALLOC_COUNT / 2);
+
+		// Free the rest from the main thread
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			for(U j = 1; j < ALLOC_COUNT; j += 2)
+			{
+				pool.free(tasks[i].m_ptrs[j]);
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+		pool.reset();
+	}
+}
+
+ANKI_TEST(Util, StackMemoryPoolContention)
+{
+	const U THREAD_COUNT = 8;
+	const U FRAME_COUNT = 20;
+	const U ALLOC_COUNT = 50000;
+
+	class Task : public ThreadPoolTask
+	{
+	public:
+		StackMemoryPool* m_pool;
+
+		Error operator()(U32 taskId, PtrSize threadsCount)
+		{
+			// Like the visibility tests, lots of small allocations and all threads start at the same moment
+			for(U i = 0; i < ALLOC_COUNT; ++i)
+			{
+				const PtrSize size = 16 + (i * 7 + taskId) % 64;
+				U8* ptr = static_cast<U8*>(m_pool->allocate(size, 16));
+				ptr[0] = U8(i);
+			}
+
+			return Error::NONE;
+		}
+	};
+
+	ThreadPool threadPool(THREAD_COUNT);
+	Array<Task, THREAD_COUNT> tasks;
+
+	auto run = [&](StackMemoryPool& pool, CString name) {
+		PtrSize capacity = 0;
+		const Second begin = HighRezTimer::getCurrentTime();
+		for(U frame = 0; frame < FRAME_COUNT; ++frame)
+		{
+			for(U i = 0; i < THREAD_COUNT; ++i)
+			{
+				tasks[i].m_pool = &pool;
+				threadPool.assignNewTask(i, &tasks[i]);
+			}
+			ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+
+			capacity = max(capacity, pool.getMemoryCapacity());
+			pool.reset();
+		}
+		const Second time = HighRezTimer::getCurrentTime() - begin;
+
+		printf("%-24s %u threads x %u frames x %u allocs: %8.3fms (capacity %" PRIu64 "KB)\n",
+			name.cstr(),
+			U32(THREAD_COUNT),
+			U32(FRAME_COUNT),
+			U32(ALLOC_COUNT),
+			time * 1000.0,
+			U64(capacity / 1024));
+	};
+
+	{
+		// Small first chunk so the pool has to grow in the first frame
+		StackMemoryPool pool;
+		pool.create(allocAligned, nullptr, 64 * 1024);
+		run(pool, "Stack");
+	}
+
+	{
+		StackMemoryPool pool;
+		pool.create(allocAligned, nullptr, 64 * 1024, 2.0, 0, true, ANKI_SAFE_ALIGNMENT, 16 * 1024);
+		run(pool, "Stack with thread arenas");
+	}
+}
@@ -0,0 +1,219 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/util/RadixSort.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace anki
+{
+
+namespace
+{
+
+/// Something as big as a RenderableQueueElement.
+class SortElement
+{
+public:
+	U64 m_key;
+	U32 m_idx;
+	Array<U8, 52> m_padding;
+};
+
+} // end namespace
+
+static U64 getSortElementKey(const SortElement& el)
+{
+	return el.m_key;
+}
+
+static Bool sortElementLess(const SortElement& a, const SortElement& b)
+{
+	return a.m_key < b.m_key;
+}
+
+ANKI_TEST(Util, RadixSort)
+{
+	std::mt19937_64 rand(0);
+
+	// The masks make some of the passes get skipped
+	const Array<U64, 4> keyMasks = {{MAX_U64, 0xFFFF, 0xFF00FF000000, 0}};
+	const Array<U32, 4> counts = {{0, 1, 100, 10000}};
+
+	for(U64 keyMask : keyMasks)
+	{
+		for(U32 count : counts)
+		{
+			std::vector<SortElement> elements(count);
+			std::vector<SortElement> scratch(count);
+			for(U32 i = 0; i < count; ++i)
+			{
+				elements[i].m_key = rand() & keyMask;
+				elements[i].m_idx = i;
+			}
+
+			std::vector<SortElement> expected = elements;
+			std::stable_sort(expected.begin(), expected.end(), sortElementLess);
+
+			// Indirect first since the other messes the input
+			std::vector<SortElement> indirectSorted(count);
+			std::vector<RadixSortKeyIndex> keyScratch(count * 2);
+			radixSortIndirect(
+				elements.data(), indirectSorted.data(), count, keyScratch.data(), getSortElementKey);
+
+			const SortElement* sorted = radixSort(elements.data(), scratch.data(), count, getSortElementKey);
+			ANKI_TEST_EXPECT_EQ(sorted == elements.data() || sorted == scratch.data(), true);
+
+			// Stable so the indices should match too
+			for(U32 i = 0; i < count; ++i)
+			{
+				ANKI_TEST_EXPECT_EQ(sorted[i].m_key, expected[i].m_key);
+				ANKI_TEST_EXPECT_EQ(sorted[i].m_idx, expected[i].m_idx);
+				ANKI_TEST_EXPECT_EQ(indirectSorted[i].m_idx, expected[i].m_idx);
+			}
+		}
+	}
+}
+
+ANKI_TEST(Util, MergeSortedRuns)
+{
+	std::mt19937_64 rand(1);
+
+	const U32 RUN_COUNT = 13;
+	std::vector<SortElement> elements;
+	Array<U32, RUN_COUNT + 1> runOffsets;
+	for(U32 run = 0; run < RUN_COUNT; ++run)
+	{
+		runOffsets[run] = U32(elements.size());
+
+		// Some empty runs and a small key range to have equal keys in different runs
+		const U32 count = (run % 4 == 1) ? 0 : U32(rand() % 1000);
+		for(U32 i = 0; i < count; ++i)
+		{
+			SortElement el;
+			el.m_key = rand() % 300;
+			el.m_idx = U32(elements.size());
+			elements.push_back(el);
+		}
+
+		std::stable_sort(elements.begin() + runOffsets[run], elements.end(), sortElementLess);
+	}
+	runOffsets[RUN_COUNT] = U32(elements.size());
+
+	Array<ConstWeakArray<SortElement>, RUN_COUNT> runs;
+	for(U32 run = 0; run < RUN_COUNT; ++run)
+	{
+		runs[run] = ConstWeakArray<SortElement>(
+			elements.data() + runOffsets[run], runOffsets[run + 1] - runOffsets[run]);
+	}
+
+	std::vector<SortElement> merged(elements.size());
+	mergeSortedRuns(ConstWeakArray<ConstWeakArray<SortElement>>(&runs[0], RUN_COUNT), merged.data(), getSortElementKey);
+
+	// The runs are consecutive parts of the input so it should be the same as a stable sort
+	std::vector<SortElement> expected = elements;
+	std::stable_sort(expected.begin(), expected.end(), sortElementLess);
+	for(U32 i = 0; i < expected.size(); ++i)
+	{
+		ANKI_TEST_EXPECT_EQ(merged[i].m_key, expected[i].m_key);
+		ANKI_TEST_EXPECT_EQ(merged[i].m_idx, expected[i].m_idx);
+	}
+}
+
+/// Sort the visible renderables like the visibility tests do. The threads sort their own lists and then the lists are
+/// merged.
+ANKI_TEST(Util, RadixSortBench)
+{
+	const U32 COUNT = 30000;
+	const U32 MATERIAL_COUNT = 500;
+	const U32 ITERATIONS = 20;
+	const U32 threadCount = getCpuCoresCount();
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(threadCount, alloc, true);
+
+	// Distance classes in the high bits and material hashes in the low
+	std::mt19937_64 rand(2);
+	std::vector<SortElement> input(COUNT);
+	for(U32 i = 0; i < COUNT; ++i)
+	{
+		const U64 distClass = rand() % 50;
+		const U64 materialHash = ((rand() % MATERIAL_COUNT) * 0x9E3779B97F4A7C15) >> 32;
+		input[i].m_key = (distClass << 32) | materialHash;
+		input[i].m_idx = i;
+	}
+
+	std::vector<SortElement> elements(COUNT);
+	std::vector<SortElement> sorted(COUNT);
+	std::vector<SortElement> merged(COUNT);
+	std::vector<RadixSortKeyIndex> scratch(COUNT * 2);
+
+	// std::sort of the combined list on one thread
+	Second stdTime = 0.0;
+	for(U32 it = 0; it < ITERATIONS; ++it)
+	{
+		elements = input;
+		const Second begin = HighRezTimer::getCurrentTime();
+		std::sort(elements.begin(), elements.end(), sortElementLess);
+		stdTime += HighRezTimer::getCurrentTime() - begin;
+	}
+
+	// Radix sort the combined list on one thread
+	Second radixTime = 0.0;
+	for(U32 it = 0; it < ITERATIONS; ++it)
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+		radixSortIndirect(input.data(), sorted.data(), COUNT, scratch.data(), getSortElementKey);
+		radixTime += HighRezTimer::getCurrentTime() - begin;
+
+		ANKI_TEST_EXPECT_EQ(std::is_sorted(sorted.begin(), sorted.end(), sortElementLess), true);
+	}
+
+	// Radix sort the list of every thread in parallel and merge
+	Second parallelTime = 0.0;
+	const U32 runSize = (COUNT + threadCount - 1) / threadCount;
+	Array<ConstWeakArray<SortElement>, ThreadHive::MAX_THREADS> runs;
+	for(U32 it = 0; it < ITERATIONS; ++it)
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+
+		ThreadHiveTaskGraph graph(hive);
+		ThreadHiveTaskGraphNode* sortNode =
+			graph.newParallelFor(0, threadCount, 1, [&](U32 rangeBegin, U32 rangeEnd, U32 threadId) {
+				for(U32 run = rangeBegin; run < rangeEnd; ++run)
+				{
+					const U32 first = min(run * runSize, COUNT);
+					const U32 count = min(runSize, COUNT - first);
+					radixSortIndirect(
+						&input[first], &sorted[first], count, &scratch[first * 2], getSortElementKey);
+					runs[run] = ConstWeakArray<SortElement>(&sorted[first], count);
+				}
+			});
+
+		ThreadHiveTaskGraphNode* mergeNode = graph.newTask([&](U32 threadId) {
+			mergeSortedRuns(
+				ConstWeakArray<ConstWeakArray<SortElement>>(&runs[0], threadCount), merged.data(), getSortElementKey);
+		});
+		graph.addDependency(mergeNode, sortNode);
+
+		graph.submitAndWait();
+		parallelTime += HighRezTimer::getCurrentTime() - begin;
+
+		ANKI_TEST_EXPECT_EQ(std::is_sorted(merged.begin(), merged.end(), sortElementLess), true);
+	}
+
+	ANKI_TEST_LOGI("Sorting %u elements: std::sort %fms, radix sort %fms, %u threads radix sort and merge %fms",
+		COUNT,
+		stdTime / ITERATIONS * 1000.0,
+		radixTime / ITERATIONS * 1000.0,
+		threadCount,
+		parallelTime / ITERATIONS * 1000.0);
+}
+
+} // end namespace anki
@@ -58,11 +58,11 @@ static void taskToWait(void* arg, U32 threadId, ThreadHive& hive, ThreadHiveSema
 	ANKI_TEST_EXPECT_GEQ(prev, 10);
 }
 
-ANKI_TEST(Util, ThreadHive)
+static void testThreadHive(Bool workStealing)
 {
 	const U32 threadCount = 4;
 	HeapAllocator<U8> alloc(allocAligned, nullptr);
-	ThreadHive hive(threadCount, alloc);
+	ThreadHive hive(threadCount, alloc, false, workStealing);
 
 	// Simple test
 	if(1)
@@ -169,26 +169,43 @@ ANKI_TEST(Util, ThreadHive)
 	}
 }
 
+ANKI_TEST(Util, ThreadHive)
+{
+	testThreadHive(false);
+}
+
+ANKI_TEST(Util, ThreadHiveWorkStealing)
+{
+	testThreadHive(true);
+}
+
 class FibTask
 {
 public:
 	Atomic<U64>* m_sum;
 	StackAllocator<U8> m_alloc;
 	U64 m_n;
+	Atomic<U64>* m_taskCount;
 
-	FibTask(Atomic<U64>* sum, StackAllocator<U8>& alloc, U64 n)
+	FibTask(Atomic<U64>* sum, StackAllocator<U8>& alloc, U64 n, Atomic<U64>* taskCount = nullptr)
 		: m_sum(sum)
 		, m_alloc(alloc)
 		, m_n(n)
+		, m_taskCount(taskCount)
 	{
 	}
 
 	void doWork(ThreadHive& hive)
 	{
+		if(m_taskCount)
+		{
+			m_taskCount->fetchAdd(1);
+		}
+
 		if(m_n > 1)
 		{
-			FibTask* a = m_alloc.newInstance<FibTask>(m_sum, m_alloc, m_n - 1);
-			FibTask* b = m_alloc.newInstance<FibTask>(m_sum, m_alloc, m_n - 2);
+			FibTask* a = m_alloc.newInstance<FibTask>(m_sum, m_alloc, m_n - 1, m_taskCount);
+			FibTask* b = m_alloc.newInstance<FibTask>(m_sum, m_alloc, m_n - 2, m_taskCount);
 
 			Array<ThreadHiveTask, 2> tasks;
 			tasks[0].m_callback = tasks[1].m_callback = FibTask::callback;
@@ -245,4 +262,63 @@ ANKI_TEST(Util, ThreadHiveBench)
 	ANKI_TEST_EXPECT_EQ(sum.get(), serialFib);
 }
 
+/// Compare the tasks per second of the global queue and the work-stealing scheduler.
+ANKI_TEST(Util, ThreadHiveWorkStealingBench)
+{
+	static const U FIB_N = 28;
+	static const U FLAT_TASK_COUNT = 100000;
+	static const U ITERATIONS = 4;
+
+	const U32 threadCount = getCpuCoresCount();
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	for(U mode = 0; mode < 2; ++mode)
+	{
+		const Bool workStealing = mode == 1;
+		ThreadHive hive(threadCount, alloc, true, workStealing);
+
+		// Nested spawning
+		Second nestedTime = 0.0;
+		U64 nestedTaskCount = 0;
+		for(U i = 0; i < ITERATIONS; ++i)
+		{
+			StackAllocator<U8> salloc(allocAligned, nullptr, 1024);
+			Atomic<U64> sum = {0};
+			Atomic<U64> taskCount = {0};
+			FibTask task(&sum, salloc, FIB_N, &taskCount);
+
+			const Second begin = HighRezTimer::getCurrentTime();
+			hive.submitTask(FibTask::callback, &task);
+			hive.waitAllTasks();
+			nestedTime += HighRezTimer::getCurrentTime() - begin;
+
+			nestedTaskCount += taskCount.get();
+			ANKI_TEST_EXPECT_EQ(sum.get(), fib(FIB_N));
+		}
+
+		// Flat fan-out from the main thread
+		Second flatTime = 0.0;
+		for(U i = 0; i < ITERATIONS; ++i)
+		{
+			ThreadHiveTestContext ctx;
+			ctx.m_countAtomic.set(0);
+
+			const Second begin = HighRezTimer::getCurrentTime();
+			for(U j = 0; j < FLAT_TASK_COUNT; ++j)
+			{
+				hive.submitTask(decNumber, &ctx);
+			}
+			hive.waitAllTasks();
+			flatTime += HighRezTimer::getCurrentTime() - begin;
+
+			ANKI_TEST_EXPECT_EQ(ctx.m_countAtomic.get(), -I32(FLAT_TASK_COUNT * 2));
+		}
+
+		ANKI_TEST_LOGI("%s: nested %.0f tasks/sec, flat %.0f tasks/sec",
+			(workStealing) ? "Work-stealing" : "Global queue",
+			F64(nestedTaskCount) / nestedTime,
+			F64(FLAT_TASK_COUNT * ITERATIONS) / flatTime);
+	}
+}
+
 } // end namespace anki
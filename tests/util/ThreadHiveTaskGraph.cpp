@@ -0,0 +1,158 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/util/ThreadHiveTaskGraph.h>
+#include <anki/util/HighRezTimer.h>
+#include <anki/util/System.h>
+
+namespace anki
+{
+
+static void testTaskGraph(Bool workStealing)
+{
+	const U32 threadCount = 4;
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(threadCount, alloc, false, workStealing);
+
+	// Parallel for
+	{
+		const U32 COUNT = 100000;
+		DynamicArrayAuto<U32> arr(alloc);
+		arr.create(COUNT, 0);
+
+		parallelFor(hive, 0, COUNT, 0, [&](U32 begin, U32 end, U32 threadId) {
+			ANKI_TEST_EXPECT_LT(threadId, threadCount);
+			for(U32 i = begin; i < end; ++i)
+			{
+				++arr[i];
+			}
+		});
+
+		for(U32 i = 0; i < COUNT; ++i)
+		{
+			ANKI_TEST_EXPECT_EQ(arr[i], 1);
+		}
+	}
+
+	// Empty range
+	{
+		Atomic<U32> calls = {0};
+		parallelFor(hive, 10, 10, 1, [&](U32 begin, U32 end, U32 threadId) { calls.fetchAdd(1); });
+		ANKI_TEST_EXPECT_EQ(calls.get(), 0);
+	}
+
+	// Dependencies: A -> (B, C) -> D
+	for(U iteration = 0; iteration < 100; ++iteration)
+	{
+		const U32 COUNT = 1000;
+		Atomic<U32> a = {0};
+		Atomic<U32> bc = {0};
+		Bool dOk = false;
+
+		ThreadHiveTaskGraph graph(hive);
+		ThreadHiveTaskGraphNode* nodeA = graph.newTask([&](U32 threadId) { a.fetchAdd(1); });
+
+		ThreadHiveTaskGraphNode* nodeB = graph.newParallelFor(0, COUNT, 1, [&](U32 begin, U32 end, U32 threadId) {
+			ANKI_TEST_EXPECT_EQ(a.load(), 1);
+			bc.fetchAdd(end - begin);
+		});
+
+		ThreadHiveTaskGraphNode* nodeC = graph.newTask([&](U32 threadId) {
+			ANKI_TEST_EXPECT_EQ(a.load(), 1);
+			bc.fetchAdd(1);
+		});
+
+		ThreadHiveTaskGraphNode* nodeD = graph.newTask([&](U32 threadId) { dOk = bc.load() == COUNT + 1; });
+
+		graph.addDependency(nodeB, nodeA);
+		graph.addDependency(nodeC, nodeA);
+		graph.addDependency(nodeD, nodeB);
+		graph.addDependency(nodeD, nodeC);
+
+		graph.submitAndWait();
+		ANKI_TEST_EXPECT_EQ(dOk, true);
+	}
+
+	// Nested graphs submitted from inside a task
+	{
+		Atomic<U32> count = {0};
+		ThreadHiveTaskGraph graph(hive);
+		graph.newParallelFor(0, 16, 1, [&](U32 begin, U32 end, U32 threadId) {
+			for(U32 i = begin; i < end; ++i)
+			{
+				ThreadHiveTaskGraph nested(hive);
+				nested.newParallelFor(0, 100, 10, [&](U32 b, U32 e, U32 tid) { count.fetchAdd(e - b); });
+				nested.submit();
+			}
+		});
+		graph.submitAndWait();
+
+		ANKI_TEST_EXPECT_EQ(count.get(), 16 * 100);
+	}
+}
+
+ANKI_TEST(Util, ThreadHiveTaskGraph)
+{
+	testTaskGraph(false);
+	testTaskGraph(true);
+}
+
+ANKI_TEST(Util, ThreadHiveParallelForBench)
+{
+	const U32 COUNT = 1024 * 1024 * 4;
+	const U32 threadCount = min<U32>(getCpuCoresCount(), ThreadHive::MAX_THREADS);
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(threadCount, alloc, true);
+
+	DynamicArrayAuto<F32> arr(alloc);
+	arr.create(COUNT, 1.0f);
+
+	auto work = [&](U32 begin, U32 end, U32 threadId) {
+		for(U32 i = begin; i < end; ++i)
+		{
+			arr[i] = sqrt(arr[i] + F32(i));
+		}
+	};
+
+	// Hand-rolled atomic counter like the rest of the codebase does
+	Second handRolledTime;
+	{
+		const U32 GRAIN = 1024;
+		Atomic<U32> counter = {0};
+		auto taskFunc = [&]() {
+			U32 begin;
+			while((begin = counter.fetchAdd(GRAIN)) < COUNT)
+			{
+				work(begin, min(begin + GRAIN, COUNT), 0);
+			}
+		};
+		using TaskFunc = decltype(taskFunc);
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		Array<ThreadHiveTask, ThreadHive::MAX_THREADS> tasks;
+		for(U i = 0; i < threadCount; ++i)
+		{
+			tasks[i].m_callback = [](void* ud, U32, ThreadHive&, ThreadHiveSemaphore*) {
+				(*static_cast<TaskFunc*>(ud))();
+			};
+			tasks[i].m_argument = &taskFunc;
+		}
+		hive.submitTasks(&tasks[0], threadCount);
+		hive.waitAllTasks();
+		handRolledTime = HighRezTimer::getCurrentTime() - begin;
+	}
+
+	Second parallelForTime;
+	{
+		const Second begin = HighRezTimer::getCurrentTime();
+		parallelFor(hive, 0, COUNT, 0, work);
+		parallelForTime = HighRezTimer::getCurrentTime() - begin;
+	}
+
+	ANKI_TEST_LOGI("Hand-rolled loop %fms, parallelFor %fms", handRolledTime * 1000.0, parallelForTime * 1000.0);
+}
+
+} // end namespace anki
@@ -50,3 +50,211 @@ ANKI_TEST(Util, Tracer)
 
 	ANKI_TEST_EXPECT_NO_ERR(tracer.flush("./1"));
 }
+
+namespace
+{
+
+class TracerStreamingCtx
+{
+public:
+	Tracer* m_tracer;
+	U32 m_eventCount;
+	TracerEventHandle* m_handles = nullptr;
+};
+
+} // end namespace
+
+static Error tracerStreamingThread(ThreadCallbackInfo& info)
+{
+	TracerStreamingCtx& ctx = *static_cast<TracerStreamingCtx*>(info.m_userData);
+
+	for(U32 i = 0; i < ctx.m_eventCount; ++i)
+	{
+		TracerEventHandle outer = ctx.m_tracer->beginEvent();
+		TracerEventHandle inner = ctx.m_tracer->beginEvent();
+		ctx.m_tracer->increaseCounter("counter", 1);
+		ctx.m_tracer->endEvent("inner", inner);
+		ctx.m_tracer->endEvent("outer", outer);
+	}
+
+	return Error::NONE;
+}
+
+/// Begin events on a thread and leave them open for another thread to end.
+static Error tracerStreamingBeginThread(ThreadCallbackInfo& info)
+{
+	TracerStreamingCtx& ctx = *static_cast<TracerStreamingCtx*>(info.m_userData);
+
+	for(U32 i = 0; i < ctx.m_eventCount; ++i)
+	{
+		ctx.m_handles[i] = ctx.m_tracer->beginEvent();
+	}
+
+	return Error::NONE;
+}
+
+static void runTracerStreaming(Tracer& tracer, U32 frameCount, U32 threadCount, U32 eventCount)
+{
+	TracerStreamingCtx ctx;
+	ctx.m_tracer = &tracer;
+	ctx.m_eventCount = eventCount;
+
+	for(U32 frame = 0; frame < frameCount; ++frame)
+	{
+		tracer.newFrame(frame);
+
+		// Keep an event open across the frame boundary on this thread
+		TracerEventHandle frameEvent = tracer.beginEvent();
+
+		Array<Thread*, 8> threads;
+		ANKI_TEST_EXPECT_LEQ(threadCount, threads.getSize());
+		for(U32 i = 0; i < threadCount; ++i)
+		{
+			threads[i] = new Thread("tracer");
+			threads[i]->start(&ctx, tracerStreamingThread);
+		}
+
+		for(U32 i = 0; i < threadCount; ++i)
+		{
+			ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+			delete threads[i];
+		}
+
+		if(frameEvent)
+		{
+			tracer.endEvent("frame", frameEvent);
+		}
+	}
+}
+
+ANKI_TEST(Util, TracerStreaming)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 FRAME_COUNT = 8;
+	const U32 THREAD_COUNT = 4;
+	const U32 EVENT_COUNT = 500;
+
+	// Enough chunks to hold everything
+	{
+		Tracer tracer;
+		tracer.init(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.beginStreaming("./stream", 1024));
+		runTracerStreaming(tracer, FRAME_COUNT, THREAD_COUNT, EVENT_COUNT);
+		ANKI_TEST_EXPECT_EQ(tracer.getDroppedCount(), 0);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.endStreaming());
+	}
+
+	ANKI_TEST_EXPECT_NO_ERR(Tracer::convertStreamToChromeJson(alloc, "./stream.trace.bin", "./stream.trace.json"));
+
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./stream.trace.json", FileOpenFlag::READ));
+		StringAuto txt(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(file.readAllText(txt));
+
+		// Sum the counter values. The last frame appears twice
+		U64 counterSum = 0;
+		const char* pattern = "{\"name\": \"counter\", \"cat\": \"PERF\", \"ph\": \"C\"";
+		const char* it = txt.cstr();
+		while((it = strstr(it, pattern)) != nullptr)
+		{
+			const char* val = strstr(it, "\"val\": ");
+			ANKI_TEST_EXPECT_NEQ(val, nullptr);
+			counterSum += strtoull(val + 7, nullptr, 10);
+			it = val;
+		}
+
+		ANKI_TEST_EXPECT_EQ(counterSum, (FRAME_COUNT + 1) * THREAD_COUNT * EVENT_COUNT);
+		ANKI_TEST_EXPECT_NEQ(strstr(txt.cstr(), "\"name\": \"frame\""), nullptr);
+	}
+
+	// Too few chunks, events will be dropped but nothing should break
+	{
+		Tracer tracer;
+		tracer.init(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.beginStreaming("./stream_small", 2));
+		runTracerStreaming(tracer, FRAME_COUNT, THREAD_COUNT, EVENT_COUNT);
+		ANKI_TEST_EXPECT_GT(tracer.getDroppedCount(), 0);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.endStreaming());
+	}
+
+	ANKI_TEST_EXPECT_NO_ERR(
+		Tracer::convertStreamToChromeJson(alloc, "./stream_small.trace.bin", "./stream_small.trace.json"));
+}
+
+/// End events on other threads than the ones that began them and end some after the streaming ended.
+ANKI_TEST(Util, TracerStreamingCrossThread)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 THREAD_COUNT = 4;
+	const U32 EVENT_COUNT = 1000; // Many chunks per thread
+
+	Array<Array<TracerEventHandle, EVENT_COUNT>, THREAD_COUNT> handles;
+	Array<TracerStreamingCtx, THREAD_COUNT> ctxs;
+	U32 endedCount = 0;
+
+	{
+		Tracer tracer;
+		tracer.init(alloc);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.beginStreaming("./stream_cross", 1024));
+		tracer.newFrame(0);
+
+		// Begin the events on some threads
+		Array<Thread*, THREAD_COUNT> threads;
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			ctxs[i].m_tracer = &tracer;
+			ctxs[i].m_eventCount = EVENT_COUNT;
+			ctxs[i].m_handles = &handles[i][0];
+			threads[i] = new Thread("tracer");
+			threads[i]->start(&ctxs[i], tracerStreamingBeginThread);
+		}
+
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+			delete threads[i];
+		}
+
+		// End them on this thread while it begins its own. Keep the last event of every thread open
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			for(U32 j = 0; j < EVENT_COUNT - 1; ++j)
+			{
+				TracerEventHandle own = tracer.beginEvent();
+				tracer.endEvent("cross", handles[i][j]);
+				tracer.endEvent("own", own);
+				++endedCount;
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(tracer.getDroppedCount(), 0);
+		ANKI_TEST_EXPECT_NO_ERR(tracer.endStreaming());
+
+		// End the rest after the streaming. They won't be written but nothing should break
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			tracer.endEvent("late", handles[i][EVENT_COUNT - 1]);
+		}
+	}
+
+	ANKI_TEST_EXPECT_NO_ERR(
+		Tracer::convertStreamToChromeJson(alloc, "./stream_cross.trace.bin", "./stream_cross.trace.json"));
+
+	File file;
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./stream_cross.trace.json", FileOpenFlag::READ));
+	StringAuto txt(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(file.readAllText(txt));
+
+	U32 crossCount = 0;
+	const char* pattern = "{\"name\": \"cross\", \"cat\": \"PERF\", \"ph\": \"X\"";
+	const char* it = txt.cstr();
+	while((it = strstr(it, pattern)) != nullptr)
+	{
+		++crossCount;
+		++it;
+	}
+
+	ANKI_TEST_EXPECT_EQ(crossCount, endedCount);
+	ANKI_TEST_EXPECT_EQ(strstr(txt.cstr(), "\"name\": \"late\""), nullptr);
+}
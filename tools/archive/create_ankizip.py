@@ -0,0 +1,111 @@
+#!/usr/bin/python3
+
+# Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+# All rights reserved.
+# Code licensed under the BSD License.
+# http://www.anki3d.org/LICENSE
+
+# Create an .ankizip archive from a directory. The files that compress well are deflated in chunks that the engine
+# can decompress independently (see ZipArchive.h). The rest are stored so the engine can read them without a copy.
+
+import argparse
+import os
+import struct
+import zlib
+
+CHUNKS_EXTRA_FIELD_ID = 0x4B41
+
+class Context:
+	input_dir = ""
+	out_file = ""
+	chunk_size = 0
+	min_saving = 0.0
+	verbose = False
+
+def parse_commandline():
+	ctx = Context()
+
+	parser = argparse.ArgumentParser(description="Create an .ankizip archive")
+	parser.add_argument("-i", "--input", required=True, help="the directory to archive")
+	parser.add_argument("-o", "--output", required=True, help="the output archive")
+	parser.add_argument("-c", "--chunk-size", type=int, default=64 * 1024,
+		help="the uncompressed size of the chunks. Zero doesn't chunk the files")
+	parser.add_argument("-s", "--min-saving", type=float, default=0.1,
+		help="store the files if deflate saves less than that fraction")
+	parser.add_argument("-v", "--verbose", action="store_true", help="verbose logging")
+	args = parser.parse_args()
+
+	ctx.input_dir = args.input
+	ctx.out_file = args.output
+	ctx.chunk_size = args.chunk_size
+	ctx.min_saving = args.min_saving
+	ctx.verbose = args.verbose
+	return ctx
+
+def deflate(ctx, data):
+	""" Raw deflate with a full flush every chunk. Return the compressed data and the offsets of the chunks """
+
+	compressor = zlib.compressobj(9, zlib.DEFLATED, -zlib.MAX_WBITS)
+	step = ctx.chunk_size if ctx.chunk_size > 0 else len(data)
+	out = bytearray()
+	offsets = []
+	for begin in range(0, len(data), step):
+		offsets.append(len(out))
+		out += compressor.compress(data[begin:begin + step])
+		out += compressor.flush(zlib.Z_FULL_FLUSH if begin + step < len(data) else zlib.Z_FINISH)
+
+	return bytes(out), offsets
+
+def main():
+	ctx = parse_commandline()
+
+	out = open(ctx.out_file, "wb")
+	central_dir = bytearray()
+	file_count = 0
+
+	for root, dirs, files in os.walk(ctx.input_dir):
+		dirs.sort()
+		for fname in sorted(files):
+			path = os.path.join(root, fname)
+			name = os.path.relpath(path, ctx.input_dir).replace(os.sep, "/").encode("utf-8")
+			data = open(path, "rb").read()
+			crc = zlib.crc32(data) & 0xFFFFFFFF
+
+			method = 0
+			stored_data = data
+			extra = b""
+			if len(data) > 0:
+				compressed, offsets = deflate(ctx, data)
+				if len(compressed) <= len(data) * (1.0 - ctx.min_saving):
+					method = 8
+					stored_data = compressed
+					if ctx.chunk_size > 0 and len(offsets) > 1:
+						extra = struct.pack("<HHI", CHUNKS_EXTRA_FIELD_ID, 4 + 4 * len(offsets), ctx.chunk_size)
+						extra += struct.pack("<%dI" % len(offsets), *offsets)
+
+			if ctx.verbose:
+				print("-- %s: %s %d -> %d" % (name.decode("utf-8"), "deflated" if method else "stored", len(data),
+					len(stored_data)))
+
+			offset = out.tell()
+			out.write(struct.pack("<IHHHHHIIIHH", 0x04034b50, 20, 0, method, 0, 0, crc, len(stored_data), len(data),
+				len(name), 0))
+			out.write(name)
+			out.write(stored_data)
+
+			central_dir += struct.pack("<IHHHHHHIIIHHHHHII", 0x02014b50, 20, 20, 0, method, 0, 0, crc,
+				len(stored_data), len(data), len(name), len(extra), 0, 0, 0, 0, offset)
+			central_dir += name
+			central_dir += extra
+			file_count += 1
+
+	central_dir_offset = out.tell()
+	out.write(central_dir)
+	out.write(struct.pack("<IHHHHIIH", 0x06054b50, 0, 0, file_count, file_count, len(central_dir),
+		central_dir_offset, 0))
+	out.close()
+
+	print("-- Archived %d files in %s" % (file_count, ctx.out_file))
+
+if __name__ == "__main__":
+	main()
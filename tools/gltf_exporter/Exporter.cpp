@@ -4,7 +4,7 @@
 // http://www.anki3d.org/LICENSE
 
 #include "Exporter.h"
-#include <anki/resource/MeshLoader.h>
+#include <anki/resource/MeshOptimizer.h>
 #include <anki/util/File.h>
 #include <string>
 
@@ -221,11 +221,12 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 	const tinygltf::Primitive& primitive = mesh.primitives[0];
 
 	// Get indices
-	DynamicArrayAuto<U16> indices(m_alloc);
+	DynamicArrayAuto<U32> indices(m_alloc);
 	{
 		const tinygltf::Accessor& accessor = m_model.accessors[primitive.indices];
 		const tinygltf::BufferView& bufferView = m_model.bufferViews[accessor.bufferView];
 		const tinygltf::Buffer& buffer = m_model.buffers[bufferView.buffer];
+		const U8* indexBuff = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
 
 		EXPORT_ASSERT((accessor.count % 3) == 0);
 		indices.create(accessor.count);
@@ -235,13 +236,13 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
 			for(U i = 0; i < indices.getSize(); ++i)
 			{
-				indices[i] = *reinterpret_cast<const U32*>(buffer.data[i * sizeof(U32)]);
+				indices[i] = *reinterpret_cast<const U32*>(&indexBuff[i * sizeof(U32)]);
 			}
 			break;
 		case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
 			for(U i = 0; i < indices.getSize(); ++i)
 			{
-				indices[i] = *reinterpret_cast<const U16*>(buffer.data[i * sizeof(U16)]);
+				indices[i] = *reinterpret_cast<const U16*>(&indexBuff[i * sizeof(U16)]);
 			}
 			break;
 		default:
@@ -271,15 +272,11 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 			aabbMin = aabbMin.min(positions[v]);
 			aabbMax = aabbMax.max(positions[v]);
 		}
-
-		aabbMax += EPSILON * 10.0f; // Bump it a bit
 	}
 
 	// Get normals and UVs
 	DynamicArrayAuto<Vec3> normals(m_alloc);
 	DynamicArrayAuto<Vec2> uvs(m_alloc);
-	F32 maxUvDistance = MIN_F32;
-	F32 minUvDistance = MAX_F32;
 	{
 		EXPORT_ASSERT(primitive.attributes.find("NORMAL") != primitive.attributes.end());
 		EXPORT_ASSERT(primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end());
@@ -303,9 +300,6 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		{
 			normals[v] = Vec3(reinterpret_cast<const F32*>(&normalBuff[v * normalStride]));
 			uvs[v] = Vec2(reinterpret_cast<const F32*>(&uvBuff[v * uvStride]));
-
-			maxUvDistance = max(maxUvDistance, max(uvs[v].x(), uvs[v].y()));
-			minUvDistance = min(minUvDistance, min(uvs[v].x(), uvs[v].y()));
 		}
 	}
 
@@ -425,11 +419,13 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 			w.m_boneIndices[2] = inIdxs[2];
 			w.m_boneIndices[3] = inIdxs[3];
 
-			const F32* inW = reinterpret_cast<const F32*>(&weights[v * weightsStride]);
+			const F32* inW = reinterpret_cast<const F32*>(&weightsBuff[v * weightsStride]);
 			w.m_weights[0] = inW[0] * 0xFF;
 			w.m_weights[1] = inW[1] * 0xFF;
 			w.m_weights[2] = inW[2] * 0xFF;
 			w.m_weights[3] = inW[3] * 0xFF;
+
+			weights[v] = w;
 		}
 	}
 
@@ -466,15 +462,121 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		}
 	}
 
+	// Optimize and write the mesh and its LODs. Every LOD has a copy of the vertices it uses
+	MeshOptimizer optimizer(m_alloc);
+	const F32 meshSize = (aabbMax - aabbMin).getLength();
+	U32 prevIndexCount = MAX_U32;
+	for(U32 lod = 0; lod < m_lodCount; ++lod)
+	{
+		DynamicArrayAuto<U32> lodIndices(m_alloc);
+		if(lod == 0)
+		{
+			lodIndices.create(indices.getSize());
+			memcpy(&lodIndices[0], &indices[0], indices.getSizeInBytes());
+		}
+		else
+		{
+			const U32 targetIndexCount = U32(F32(indices.getSize()) * pow(m_lodTriangleRatio, F32(lod))) / 3 * 3;
+			optimizer.simplify(indices, positions, targetIndexCount, m_lodMaxError * meshSize * F32(lod), lodIndices);
+
+			if(lodIndices.getSize() == 0 || F32(lodIndices.getSize()) > F32(prevIndexCount) * 0.9f)
+			{
+				ANKI_LOGI("Mesh %s can't be simplified to more than %u LODs", mesh.name.c_str(), lod);
+				break;
+			}
+		}
+		prevIndexCount = lodIndices.getSize();
+
+		const MeshOptimizerStats before = MeshOptimizer::computeStats(lodIndices, vertCount, sizeof(Vec3));
+		DynamicArrayAuto<U32> newToOld(m_alloc);
+		optimizer.optimize(WeakArray<U32>(lodIndices), positions, newToOld);
+		const MeshOptimizerStats after = MeshOptimizer::computeStats(lodIndices, newToOld.getSize(), sizeof(Vec3));
+		ANKI_LOGI("Mesh %s LOD %u: %u triangles, ACMR %f -> %f, ATVR %f -> %f",
+			mesh.name.c_str(),
+			lod,
+			lodIndices.getSize() / 3,
+			before.m_acmr,
+			after.m_acmr,
+			before.m_atvr,
+			after.m_atvr);
+
+		DynamicArrayAuto<Vec3> lodPositions(m_alloc);
+		DynamicArrayAuto<Vec3> lodNormals(m_alloc);
+		DynamicArrayAuto<Vec4> lodTangents(m_alloc);
+		DynamicArrayAuto<Vec2> lodUvs(m_alloc);
+		DynamicArrayAuto<WeightVertex> lodWeights(m_alloc);
+		for(U32 oldIdx : newToOld)
+		{
+			lodPositions.emplaceBack(positions[oldIdx]);
+			lodNormals.emplaceBack(normals[oldIdx]);
+			lodTangents.emplaceBack(tangents[oldIdx]);
+			lodUvs.emplaceBack(uvs[oldIdx]);
+			if(weights.getSize())
+			{
+				lodWeights.emplaceBack(weights[oldIdx]);
+			}
+		}
+
+		DynamicArrayAuto<MeshBinaryFile::Meshlet> meshlets(m_alloc);
+		optimizer.buildMeshlets(lodIndices, lodPositions, meshlets);
+
+		StringAuto filename(m_alloc);
+		if(lod == 0)
+		{
+			filename.sprintf("%s/%s.ankimesh", m_outputDirectory.cstr(), mesh.name.c_str());
+		}
+		else
+		{
+			filename.sprintf("%s/%s_lod%u.ankimesh", m_outputDirectory.cstr(), mesh.name.c_str(), lod);
+		}
+
+		// Only the first LOD is used by the physics
+		ANKI_CHECK(writeMesh(filename.toCString(),
+			lodIndices,
+			lodPositions,
+			lodNormals,
+			lodTangents,
+			lodUvs,
+			lodWeights,
+			meshlets,
+			convex && lod == 0));
+	}
+
+	return Error::NONE;
+}
+
+Error Exporter::writeMesh(CString filename,
+	ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	ConstWeakArray<Vec3> normals,
+	ConstWeakArray<Vec4> tangents,
+	ConstWeakArray<Vec2> uvs,
+	ConstWeakArray<WeightVertex> weights,
+	ConstWeakArray<MeshBinaryFile::Meshlet> meshlets,
+	Bool convex)
+{
+	const U32 vertCount = positions.getSize();
+
+	Vec3 aabbMin(MAX_F32), aabbMax(MIN_F32);
+	F32 maxUvDistance = MIN_F32;
+	F32 minUvDistance = MAX_F32;
+	for(U v = 0; v < vertCount; ++v)
+	{
+		aabbMin = aabbMin.min(positions[v]);
+		aabbMax = aabbMax.max(positions[v]);
+
+		maxUvDistance = max(maxUvDistance, max(uvs[v].x(), uvs[v].y()));
+		minUvDistance = min(minUvDistance, min(uvs[v].x(), uvs[v].y()));
+	}
+	aabbMax += EPSILON * 10.0f; // Bump it a bit
+
 	// Chose the formats of the attributes
 	MeshBinaryFile::Header header = {};
 	{
 		// Positions
-		Vec3 dist3d = aabbMin.abs().max(aabbMax.abs());
-		const F32 maxPositionDistance = max(max(dist3d.x(), dist3d.y()), dist3d.z());
 		auto& posa = header.m_vertexAttributes[VertexAttributeLocation::POSITION];
 		posa.m_bufferBinding = 0;
-		posa.m_format = (maxPositionDistance < 2.0) ? Format::R16G16B16A16_SFLOAT : Format::R32G32B32_SFLOAT;
+		posa.m_format = MeshOptimizer::choosePositionFormat(aabbMin, aabbMax, m_positionMaxError);
 		posa.m_relativeOffset = 0;
 		posa.m_scale = 1.0;
 
@@ -561,7 +663,11 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		{
 			header.m_flags |= MeshBinaryFile::Flag::CONVEX;
 		}
-		header.m_indexType = IndexType::U16;
+		if(meshlets.getSize())
+		{
+			header.m_flags |= MeshBinaryFile::Flag::MESHLETS;
+		}
+		header.m_indexType = (vertCount <= MAX_U16 + 1u) ? IndexType::U16 : IndexType::U32;
 		header.m_totalIndexCount = indices.getSize();
 		header.m_totalVertexCount = vertCount;
 		header.m_subMeshCount = 1;
@@ -571,9 +677,7 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 
 	// Open file
 	File file;
-	ANKI_CHECK(file.open(
-		StringAuto(m_alloc).sprintf("%s/%s.ankimesh", m_outputDirectory.cstr(), mesh.name.c_str()).toCString(),
-		FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_CHECK(file.open(filename, FileOpenFlag::WRITE | FileOpenFlag::BINARY));
 
 	// Write header
 	ANKI_CHECK(file.write(&header, sizeof(header)));
@@ -589,8 +693,30 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		ANKI_CHECK(file.write(&smesh, sizeof(smesh)));
 	}
 
+	// Write meshlets
+	if(meshlets.getSize())
+	{
+		const U32 meshletCount = meshlets.getSize();
+		ANKI_CHECK(file.write(&meshletCount, sizeof(meshletCount)));
+		ANKI_CHECK(file.write(&meshlets[0], meshlets.getSizeInBytes()));
+	}
+
 	// Write indices
-	ANKI_CHECK(file.write(&indices[0], indices.getSizeInBytes()));
+	if(header.m_indexType == IndexType::U16)
+	{
+		DynamicArrayAuto<U16> indices16(m_alloc);
+		indices16.create(indices.getSize());
+		for(U i = 0; i < indices.getSize(); ++i)
+		{
+			indices16[i] = U16(indices[i]);
+		}
+
+		ANKI_CHECK(file.write(&indices16[0], indices16.getSizeInBytes()));
+	}
+	else
+	{
+		ANKI_CHECK(file.write(&indices[0], indices.getSizeInBytes()));
+	}
 
 	// Write first vert buffer
 	{
@@ -6,11 +6,15 @@
 #pragma once
 
 #include <src/anki/AnKi.h>
+#include <anki/resource/MeshLoader.h>
 #include <tinygltf/tiny_gltf.h>
 
 namespace anki
 {
 
+// Forward
+class WeightVertex;
+
 class Exporter
 {
 public:
@@ -23,6 +27,18 @@ public:
 
 	F32 m_normalsMergeCosAngle = cos(toRad(30.0));
 
+	/// The number of LODs of every mesh. The LODs after the first are simplified versions of the mesh.
+	U32 m_lodCount = MAX_LOD_COUNT;
+
+	/// Every LOD has that many of the triangles of the previous one.
+	F32 m_lodTriangleRatio = 0.5f;
+
+	/// How far the surface of a LOD can move. It's a fraction of the size of the mesh and it's multiplied by the LOD.
+	F32 m_lodMaxError = 0.01f;
+
+	/// How far the positions can move because of the quantization.
+	F32 m_positionMaxError = 0.0005f;
+
 	tinygltf::TinyGLTF m_loader;
 	tinygltf::Model m_model;
 
@@ -34,6 +50,17 @@ public:
 private:
 	Error exportMesh(const tinygltf::Mesh& mesh);
 
+	/// Write a mesh to an ankimesh file.
+	Error writeMesh(CString filename,
+		ConstWeakArray<U32> indices,
+		ConstWeakArray<Vec3> positions,
+		ConstWeakArray<Vec3> normals,
+		ConstWeakArray<Vec4> tangents,
+		ConstWeakArray<Vec2> uvs,
+		ConstWeakArray<WeightVertex> weights,
+		ConstWeakArray<MeshBinaryFile::Meshlet> meshlets,
+		Bool convex);
+
 	void getAttributeInfo(const tinygltf::Primitive& primitive,
 		CString attribName,
 		const U8*& buff,
@@ -11,6 +11,9 @@ static const char* USAGE = R"(Usage: %s in_file out_dir [options]
 Options:
 -rpath <string>     : Replace all absolute paths of assets with that path
 -texrpath <string>  : Same as rpath but for textures
+-lods <number>      : The number of LODs of the meshes. Default is 3
+-lod-error <float>  : How far the surface of the LODs can move. It's a fraction of the mesh size. Default is 0.01
+-pos-error <float>  : How far the positions can move when they are quantized. Default is 0.0005
 )";
 
 static Error parseCommandLineArgs(int argc, char** argv, Exporter& exporter)
@@ -63,6 +66,31 @@ static Error parseCommandLineArgs(int argc, char** argv, Exporter& exporter)
 				return Error::USER_DATA;
 			}
 		}
+		else if(strcmp(argv[i], "-lods") == 0)
+		{
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			ANKI_CHECK(CString(argv[i]).toNumber(exporter.m_lodCount));
+			if(exporter.m_lodCount < 1 || exporter.m_lodCount > MAX_LOD_COUNT)
+			{
+				return Error::USER_DATA;
+			}
+		}
+		else if(strcmp(argv[i], "-lod-error") == 0 || strcmp(argv[i], "-pos-error") == 0)
+		{
+			F32& value = (strcmp(argv[i], "-lod-error") == 0) ? exporter.m_lodMaxError : exporter.m_positionMaxError;
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			ANKI_CHECK(CString(argv[i]).toNumber(value));
+		}
 		else
 		{
 			return Error::USER_DATA;
@@ -68,3 +68,8 @@ std::string getFilename(const std::string& path)
 
 	return out;
 }
+
+std::string getLodMeshName(const std::string& meshName, unsigned lod)
+{
+	return (lod == 0) ? meshName : meshName + "_lod" + std::to_string(lod);
+}
@@ -27,3 +27,6 @@ std::string replaceAllString(const std::string& str, const std::string& from, co
 
 /// From a path return only the filename
 std::string getFilename(const std::string& path);
+
+/// The name of a LOD of a mesh that the exporter generates.
+std::string getLodMeshName(const std::string& meshName, unsigned lod);
@@ -4,7 +4,14 @@
 // http://www.anki3d.org/LICENSE
 
 #include "Exporter.h"
+#include <anki/scene/SceneBinaryLoader.h>
+#include <anki/resource/AnimationClip.h>
+#include <anki/util/File.h>
 #include <iostream>
+#include <cstring>
+#include <unordered_map>
+
+using anki::SceneBinaryFile;
 
 static const char* XML_HEADER = R"(<?xml version="1.0" encoding="UTF-8" ?>)";
 
@@ -380,7 +387,7 @@ void Exporter::exportSkeleton(const aiMesh& mesh) const
 	file << "</skeleton>\n";
 }
 
-void Exporter::exportModel(const Model& model) const
+void Exporter::exportModel(const Model& model, unsigned lodCount) const
 {
 	std::string name = getModelName(model);
 	LOGI("Exporting model %s", name.c_str());
@@ -417,6 +424,15 @@ void Exporter::exportModel(const Model& model) const
 			ERROR("Couldn't find the LOD1 %s", model.m_lod1MeshName.c_str());
 		}
 	}
+	else
+	{
+		for(unsigned lod = 1; lod < lodCount; ++lod)
+		{
+			file << "\t\t\t<mesh" << lod << ">" << m_rpath
+				 << getLodMeshName(getMeshName(getMeshAt(model.m_meshIndex)), lod) << ".ankimesh</mesh" << lod
+				 << ">\n";
+		}
+	}
 
 	// Write material
 	const aiMaterial& mtl = *m_scene->mMaterials[model.m_materialIndex];
@@ -464,6 +480,18 @@ void Exporter::exportLight(const aiLight& light)
 		return;
 	}
 
+	// Lights with events or lens flares need Lua so they can't go to the binary scene
+	const bool hasExtras = light.mProperties.find("lens_flare") != light.mProperties.end()
+						   || light.mProperties.find("lens_flare_first_sprite_size") != light.mProperties.end()
+						   || light.mProperties.find("lens_flare_color") != light.mProperties.end()
+						   || light.mProperties.find("light_event_intensity") != light.mProperties.end()
+						   || light.mProperties.find("light_event_frequency") != light.mProperties.end();
+	if(m_binaryScene && !hasExtras)
+	{
+		exportBinaryLight(light);
+		return;
+	}
+
 	const char* lightType;
 	switch(light.mType)
 	{
@@ -618,6 +646,56 @@ void Exporter::exportLight(const aiLight& light)
 	}
 }
 
+void Exporter::exportBinaryLight(const aiLight& light)
+{
+	const aiNode* node = findNodeWithName(light.mName.C_Str(), m_scene->mRootNode);
+	if(node == nullptr)
+	{
+		ERROR("Couldn't find node for light %s", light.mName.C_Str());
+	}
+
+	aiMatrix4x4 rot;
+	aiMatrix4x4::RotationX(-3.1415 / 2.0, rot);
+
+	SceneBinaryFile::NodeType type;
+	std::array<float, 8> params = {{light.mColorDiffuse[0], light.mColorDiffuse[1], light.mColorDiffuse[2], 1.0f}};
+	switch(light.mType)
+	{
+	case aiLightSource_POINT:
+		type = SceneBinaryFile::NodeType::POINT_LIGHT;
+		params[4] = sqrt(light.mAttenuationConstant / light.mAttenuationQuadratic);
+		break;
+	case aiLightSource_SPOT:
+	{
+		type = SceneBinaryFile::NodeType::SPOT_LIGHT;
+
+		float outer = light.mAngleOuterCone;
+		float inner = light.mAngleInnerCone;
+		if(outer == inner)
+		{
+			inner = outer / 2.0;
+		}
+
+		params[4] = inner;
+		params[5] = outer;
+		params[6] = sqrt(light.mAttenuationConstant / light.mAttenuationQuadratic);
+		break;
+	}
+	default:
+		type = SceneBinaryFile::NodeType::DIRECTIONAL_LIGHT;
+		break;
+	}
+
+	addBinaryNode(uint32_t(type), light.mName.C_Str(), "", toAnkiMatrix(node->mTransformation * rot));
+
+	BinarySceneNode& bnode = m_binaryNodes.back();
+	bnode.m_params = params;
+	if(light.mProperties.find("shadow") != light.mProperties.end() && light.mProperties.at("shadow") == "true")
+	{
+		bnode.m_flags = uint32_t(SceneBinaryFile::NodeFlag::SHADOW);
+	}
+}
+
 void Exporter::exportAnimation(const aiAnimation& anim, unsigned index)
 {
 	// Get name
@@ -638,76 +716,84 @@ void Exporter::exportAnimation(const aiAnimation& anim, unsigned index)
 		}
 	}*/
 
-	std::fstream file;
-	LOGI("Exporting animation %s", name.c_str());
-
-	file.open(m_outputDirectory + name + ".ankianim", std::ios::out);
+	if(anim.mNumChannels == 0)
+	{
+		LOGW("Animation %s doesn't have channels", name.c_str());
+		return;
+	}
 
-	file << XML_HEADER << "\n";
-	file << "<animation>\n";
+	LOGI("Exporting animation %s", name.c_str());
 
-	file << "\t<channels>\n";
+	anki::HeapAllocator<anki::U8> alloc(anki::allocAligned, nullptr);
+	std::vector<anki::AnimationChannel> channels(anim.mNumChannels);
+	unsigned keyCount = 0;
 
 	for(uint32_t i = 0; i < anim.mNumChannels; i++)
 	{
 		const aiNodeAnim& nAnim = *anim.mChannels[i];
-
-		file << "\t\t<channel>\n";
+		anki::AnimationChannel& ch = channels[i];
 
 		// Name
-		file << "\t\t\t<name>" << nAnim.mNodeName.C_Str() << "</name>\n";
+		ch.m_name.create(alloc, nAnim.mNodeName.C_Str());
 
 		// Positions
-		file << "\t\t\t<positionKeys>\n";
+		ch.m_positions.create(alloc, nAnim.mNumPositionKeys);
 		for(uint32_t j = 0; j < nAnim.mNumPositionKeys; j++)
 		{
 			const aiVectorKey& key = nAnim.mPositionKeys[j];
 
+			anki::Vec3 value(key.mValue[0], key.mValue[1], key.mValue[2]);
 			if(m_flipyz)
 			{
-				file << "\t\t\t\t<key><time>" << key.mTime << "</time><value>" << key.mValue[0] << " " << key.mValue[2]
-					 << " " << -key.mValue[1] << "</value></key>\n";
-			}
-			else
-			{
-				file << "\t\t\t\t<key><time>" << key.mTime << "</time><value>" << key.mValue[0] << " " << key.mValue[1]
-					 << " " << key.mValue[2] << "</value></key>\n";
+				value = anki::Vec3(key.mValue[0], key.mValue[2], -key.mValue[1]);
 			}
+
+			ch.m_positions[j] = anki::AnimationKeyframe<anki::Vec3>(key.mTime, value);
 		}
-		file << "\t\t\t</positionKeys>\n";
 
 		// Rotations
-		file << "\t\t\t<rotationKeys>\n";
+		ch.m_rotations.create(alloc, nAnim.mNumRotationKeys);
 		for(uint32_t j = 0; j < nAnim.mNumRotationKeys; j++)
 		{
 			const aiQuatKey& key = nAnim.mRotationKeys[j];
 
 			aiMatrix3x3 mat = toAnkiMatrix(key.mValue.GetMatrix());
 			aiQuaternion quat(mat);
-			// aiQuaternion quat(key.mValue);
 
-			file << "\t\t\t\t<key><time>" << key.mTime << "</time>"
-				 << "<value>" << quat.x << " " << quat.y << " " << quat.z << " " << quat.w << "</value></key>\n";
+			ch.m_rotations[j] =
+				anki::AnimationKeyframe<anki::Quat>(key.mTime, anki::Quat(quat.x, quat.y, quat.z, quat.w));
 		}
-		file << "\t\t\t</rotationKeys>\n";
 
 		// Scale
-		file << "\t\t\t<scalingKeys>\n";
+		ch.m_scales.create(alloc, nAnim.mNumScalingKeys);
 		for(uint32_t j = 0; j < nAnim.mNumScalingKeys; j++)
 		{
 			const aiVectorKey& key = nAnim.mScalingKeys[j];
 
 			// Note: only uniform scale
-			file << "\t\t\t\t<key><time>" << key.mTime << "</time>"
-				 << "<value>" << ((key.mValue[0] + key.mValue[1] + key.mValue[2]) / 3.0) << "</value></key>\n";
+			const float scale = (key.mValue[0] + key.mValue[1] + key.mValue[2]) / 3.0f;
+			ch.m_scales[j] = anki::AnimationKeyframe<anki::F32>(key.mTime, scale);
 		}
-		file << "\t\t\t</scalingKeys>\n";
 
-		file << "\t\t</channel>\n";
+		keyCount += nAnim.mNumPositionKeys + nAnim.mNumRotationKeys + nAnim.mNumScalingKeys;
 	}
 
-	file << "\t</channels>\n";
-	file << "</animation>\n";
+	// Compress and write the binary file
+	anki::AnimationClip clip(alloc);
+	anki::File file;
+	const std::string filename = m_outputDirectory + name + ".ankianim";
+	if(clip.compress(anki::ConstWeakArray<anki::AnimationChannel>(&channels[0], channels.size()))
+		|| file.open(filename.c_str(), anki::FileOpenFlag::WRITE | anki::FileOpenFlag::BINARY) || clip.save(file))
+	{
+		ERROR("Failed to write animation %s", filename.c_str());
+	}
+
+	LOGI("Animation %s has %u keys after compression, %u before", name.c_str(), clip.getKeyCount(), keyCount);
+
+	for(anki::AnimationChannel& ch : channels)
+	{
+		ch.destroy(alloc);
+	}
 }
 
 void Exporter::exportCamera(const aiCamera& cam)
@@ -980,6 +1066,11 @@ void Exporter::exportAll()
 		 << "local inst\n"
 		 << "local lcomp\n";
 
+	if(m_binaryScene)
+	{
+		file << "-- Most of the nodes are in scene.ankiscene\n";
+	}
+
 	//
 	// Get all node/model data
 	//
@@ -993,11 +1084,17 @@ void Exporter::exportAll()
 		exportMesh(*m_scene->mMeshes[n.m_meshIndex], nullptr, 3);
 		exportCollisionMesh(n.m_meshIndex);
 
-		file << "\n";
-		writeTransform(n.m_transform);
-
 		std::string name = getMeshName(getMeshAt(n.m_meshIndex));
 		std::string fname = m_rpath + name + ".ankicl";
+
+		if(m_binaryScene)
+		{
+			addBinaryNode(uint32_t(SceneBinaryFile::NodeType::STATIC_COLLISION), name, fname, n.m_transform);
+			continue;
+		}
+
+		file << "\n";
+		writeTransform(n.m_transform);
 		file << "node = scene:newStaticCollisionNode(\"" << name << "\", \"" << fname << "\", trf)\n";
 	}
 
@@ -1008,10 +1105,16 @@ void Exporter::exportAll()
 	for(const ParticleEmitter& p : m_particleEmitters)
 	{
 		std::string name = "particles" + std::to_string(i);
-		file << "\nnode = scene:newParticleEmitterNode(\"" << name << "\", \"" << p.m_filename << "\")\n";
+		++i;
 
+		if(m_binaryScene)
+		{
+			addBinaryNode(uint32_t(SceneBinaryFile::NodeType::PARTICLE_EMITTER), name, p.m_filename, p.m_transform);
+			continue;
+		}
+
+		file << "\nnode = scene:newParticleEmitterNode(\"" << name << "\", \"" << p.m_filename << "\")\n";
 		writeNodeTransform("node", p.m_transform);
-		++i;
 	}
 
 	//
@@ -1021,15 +1124,30 @@ void Exporter::exportAll()
 	for(const ReflectionProbe& probe : m_reflectionProbes)
 	{
 		std::string name = "reflprobe" + std::to_string(i);
-		file << "\nnode = scene:newReflectionProbeNode(\"" << name << "\", Vec4.new(" << probe.m_aabbMin.x << ", "
-			 << probe.m_aabbMin.y << ", " << probe.m_aabbMin.z << ", 0), Vec4.new(" << probe.m_aabbMax.x << ", "
-			 << probe.m_aabbMax.y << ", " << probe.m_aabbMax.z << ", 0))\n";
+		++i;
 
 		aiMatrix4x4 trf;
 		aiMatrix4x4::Translation(probe.m_position, trf);
 
+		if(m_binaryScene)
+		{
+			addBinaryNode(uint32_t(SceneBinaryFile::NodeType::REFLECTION_PROBE), name, "", trf);
+			m_binaryNodes.back().m_params = {{probe.m_aabbMin.x,
+				probe.m_aabbMin.y,
+				probe.m_aabbMin.z,
+				0.0f,
+				probe.m_aabbMax.x,
+				probe.m_aabbMax.y,
+				probe.m_aabbMax.z,
+				0.0f}};
+			continue;
+		}
+
+		file << "\nnode = scene:newReflectionProbeNode(\"" << name << "\", Vec4.new(" << probe.m_aabbMin.x << ", "
+			 << probe.m_aabbMin.y << ", " << probe.m_aabbMin.z << ", 0), Vec4.new(" << probe.m_aabbMax.x << ", "
+			 << probe.m_aabbMax.y << ", " << probe.m_aabbMax.z << ", 0))\n";
+
 		writeNodeTransform("node", trf);
-		++i;
 	}
 
 	//
@@ -1059,6 +1177,17 @@ void Exporter::exportAll()
 		exportMesh(mesh, nullptr, 3);
 
 		std::string name = "occluder" + std::to_string(i);
+
+		if(m_binaryScene)
+		{
+			addBinaryNode(uint32_t(SceneBinaryFile::NodeType::OCCLUDER),
+				name,
+				m_rpath + mesh.mName.C_Str() + ".ankimesh",
+				occluder.m_transform);
+			++i;
+			continue;
+		}
+
 		file << "\nnode = scene:newOccluderNode(\"" << name << "\", \"" << m_rpath << mesh.mName.C_Str()
 			 << ".ankimesh\")\n";
 
@@ -1100,17 +1229,29 @@ void Exporter::exportAll()
 		Model& model = m_models[node.m_modelIndex];
 
 		// TODO If static bake transform
-		exportMesh(*m_scene->mMeshes[model.m_meshIndex], nullptr, 3);
+		const unsigned lodCount = exportMesh(
+			*m_scene->mMeshes[model.m_meshIndex], nullptr, 3, (model.m_lod1MeshName.empty()) ? m_lodCount : 1);
 
 		exportMaterial(*m_scene->mMaterials[model.m_materialIndex]);
 
-		exportModel(model);
+		exportModel(model, lodCount);
 		std::string modelName = getModelName(model);
 		std::string nodeName = modelName + node.m_group + std::to_string(i);
 
 		// Write the main node
-		file << "\nnode = scene:newModelNode(\"" << nodeName << "\", \"" << m_rpath << modelName << ".ankimdl\")\n";
-		writeNodeTransform("node", node.m_transform);
+		if(m_binaryScene)
+		{
+			addBinaryNode(uint32_t(SceneBinaryFile::NodeType::MODEL),
+				nodeName,
+				m_rpath + modelName + ".ankimdl",
+				node.m_transform);
+		}
+		else
+		{
+			file << "\nnode = scene:newModelNode(\"" << nodeName << "\", \"" << m_rpath << modelName
+				 << ".ankimdl\")\n";
+			writeNodeTransform("node", node.m_transform);
+		}
 
 		// Write the collision node
 		if(!node.m_collisionMesh.empty())
@@ -1137,7 +1278,18 @@ void Exporter::exportAll()
 				exportCollisionMesh(i);
 
 				std::string fname = m_rpath + getMeshName(getMeshAt(i)) + ".ankicl";
-				file << "node = scene:newStaticCollisionNode(\"" << nodeName << "_cl\", \"" << fname << "\", trf)\n";
+				if(m_binaryScene)
+				{
+					addBinaryNode(uint32_t(SceneBinaryFile::NodeType::STATIC_COLLISION),
+						nodeName + "_cl",
+						fname,
+						node.m_transform);
+				}
+				else
+				{
+					file << "node = scene:newStaticCollisionNode(\"" << nodeName << "_cl\", \"" << fname
+						 << "\", trf)\n";
+				}
 			}
 			else
 			{
@@ -1170,5 +1322,90 @@ void Exporter::exportAll()
 		exportCamera(*m_scene->mCameras[i]);
 	}
 
+	if(m_binaryScene)
+	{
+		exportBinaryScene();
+	}
+
 	LOGI("Done exporting scene!");
 }
+
+void Exporter::addBinaryNode(
+	uint32_t type, const std::string& name, const std::string& resource, const aiMatrix4x4& trf)
+{
+	BinarySceneNode node;
+	node.m_type = type;
+	node.m_name = name;
+	node.m_resource = resource;
+	node.m_transform = trf;
+	m_binaryNodes.push_back(node);
+}
+
+void Exporter::exportBinaryScene() const
+{
+	LOGI("Exporting binary scene (%u nodes)", unsigned(m_binaryNodes.size()));
+
+	// Gather the strings. Share the ones that repeat (mostly the resources)
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+	auto addString = [&](const std::string& str) -> uint32_t {
+		auto it = stringOffsets.find(str);
+		if(it != stringOffsets.end())
+		{
+			return it->second;
+		}
+
+		const uint32_t offset = strings.size();
+		strings += str;
+		strings.push_back('\0');
+		stringOffsets[str] = offset;
+		return offset;
+	};
+
+	std::vector<SceneBinaryFile::Node> nodes(m_binaryNodes.size());
+	for(unsigned n = 0; n < m_binaryNodes.size(); ++n)
+	{
+		const BinarySceneNode& in = m_binaryNodes[n];
+		SceneBinaryFile::Node& out = nodes[n];
+		memset(static_cast<void*>(&out), 0, sizeof(out));
+
+		out.m_type = SceneBinaryFile::NodeType(in.m_type);
+		out.m_flags = SceneBinaryFile::NodeFlag(in.m_flags);
+		out.m_name = addString(in.m_name);
+		out.m_resource = (in.m_resource.empty()) ? SceneBinaryFile::NO_STRING : addString(in.m_resource);
+
+		aiMatrix4x4 mat = in.m_transform;
+		out.m_origin = anki::Vec3(mat[0][3], mat[1][3], mat[2][3]);
+		out.m_scale = getUniformScale(mat);
+		removeScale(mat);
+		for(unsigned j = 0; j < 3; j++)
+		{
+			for(unsigned i = 0; i < 3; i++)
+			{
+				out.m_rotation(j, i) = mat[j][i];
+			}
+		}
+
+		out.m_params[0] = anki::Vec4(in.m_params[0], in.m_params[1], in.m_params[2], in.m_params[3]);
+		out.m_params[1] = anki::Vec4(in.m_params[4], in.m_params[5], in.m_params[6], in.m_params[7]);
+	}
+
+	SceneBinaryFile::Header header;
+	memcpy(&header.m_magic[0], SceneBinaryFile::MAGIC, sizeof(header.m_magic));
+	header.m_nodeCount = nodes.size();
+	header.m_stringTableSize = strings.size();
+
+	std::string fname = m_outputDirectory + "scene.ankiscene";
+	std::ofstream file(fname, std::ios::binary);
+	if(!file)
+	{
+		ERROR("Failed to open %s", fname.c_str());
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if(!nodes.empty())
+	{
+		file.write(reinterpret_cast<const char*>(&nodes[0]), nodes.size() * sizeof(nodes[0]));
+	}
+	file.write(strings.data(), strings.size());
+}
@@ -98,6 +98,18 @@ public:
 	std::array<float, 2> m_factors = {{1.0, 1.0}};
 };
 
+/// A node of the binary scene file. See anki::SceneBinaryFile.
+class BinarySceneNode
+{
+public:
+	uint32_t m_type;
+	uint32_t m_flags = 0;
+	std::string m_name;
+	std::string m_resource;
+	aiMatrix4x4 m_transform;
+	std::array<float, 8> m_params = {};
+};
+
 /// AnKi exporter.
 class Exporter
 {
@@ -108,6 +120,13 @@ public:
 	std::string m_texrpath;
 
 	bool m_flipyz = false;
+	bool m_binaryScene = false; ///< Write most of the nodes to scene.ankiscene instead of scene.lua.
+
+	/// The number of LODs of the meshes of the models that don't have a "lod1" mesh.
+	unsigned m_lodCount = 3;
+	float m_lodTriangleRatio = 0.5f; ///< Every LOD has that many of the triangles of the previous one.
+	float m_lodMaxError = 0.01f; ///< How far the surface of a LOD can move. It's a fraction of the mesh size.
+	float m_positionMaxError = 0.0005f; ///< How far the positions can move because of the quantization.
 
 	const aiScene* m_scene = nullptr;
 	const aiScene* m_sceneNoTriangles = nullptr;
@@ -125,6 +144,7 @@ public:
 	std::vector<ReflectionProxy> m_reflectionProxies;
 	std::vector<OccluderNode> m_occluders;
 	std::vector<DecalNode> m_decals;
+	std::vector<BinarySceneNode> m_binaryNodes;
 
 	/// Load the scene.
 	void load();
@@ -153,11 +173,17 @@ private:
 
 	/// Visits the node hierarchy and gathers models and nodes.
 	void visitNode(const aiNode* ainode);
+
+	/// Add a node to the binary scene file.
+	void addBinaryNode(uint32_t type, const std::string& name, const std::string& resource, const aiMatrix4x4& trf);
 	/// @}
 
 	/// Export a mesh.
 	/// @param transform If not nullptr then transform the vertices using that.
-	void exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsigned vertCountPerFace) const;
+	/// @param lodCount Write that many LODs. The LODs after the first are simplified versions of the mesh.
+	/// @return The number of LODs that were written.
+	unsigned exportMesh(
+		const aiMesh& mesh, const aiMatrix4x4* transform, unsigned vertCountPerFace, unsigned lodCount = 1) const;
 
 	/// Export a skeleton.
 	void exportSkeleton(const aiMesh& mesh) const;
@@ -166,11 +192,15 @@ private:
 	void exportMaterial(const aiMaterial& mtl) const;
 
 	/// Export a model.
-	void exportModel(const Model& model) const;
+	/// @param lodCount The number of LODs that exportMesh() wrote for the mesh of the model.
+	void exportModel(const Model& model, unsigned lodCount) const;
 
 	/// Export a light.
 	void exportLight(const aiLight& light);
 
+	/// Add a light to the binary scene.
+	void exportBinaryLight(const aiLight& light);
+
 	/// Export a camera.
 	void exportCamera(const aiCamera& cam);
 
@@ -180,6 +210,9 @@ private:
 	/// Export a static collision mesh.
 	void exportCollisionMesh(uint32_t meshIdx);
 
+	/// Write the nodes gathered by addBinaryNode() to scene.ankiscene.
+	void exportBinaryScene() const;
+
 	/// Helper.
 	static std::string getMaterialName(const aiMaterial& mtl);
 };
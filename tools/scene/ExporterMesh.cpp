@@ -5,6 +5,7 @@
 
 #include "Exporter.h"
 #include <anki/resource/MeshLoader.h>
+#include <anki/resource/MeshOptimizer.h>
 #include <anki/Collision.h>
 #include <anki/Math.h>
 #include <cmath>
@@ -12,183 +13,56 @@
 
 using namespace anki;
 
-void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsigned vertCountPerFace) const
+struct WeightVertex
 {
-	std::string name = mesh.mName.C_Str();
-	LOGI("Exporting mesh %s", name.c_str());
+	uint16_t m_boneIndices[4] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+	uint8_t m_weights[4] = {0, 0, 0, 0};
+};
 
-	const bool hasBoneWeights = mesh.mNumBones > 0;
+struct NTVertex
+{
+	float m_n[3];
+	float m_t[4];
+	float m_uv[2];
+};
+
+static void writeMesh(const std::string& filename,
+	unsigned vertCountPerFace,
+	bool convex,
+	float positionMaxError,
+	const std::vector<uint32_t>& indices,
+	const std::vector<Vec3>& positions,
+	const std::vector<NTVertex>& ntVerts,
+	const std::vector<WeightVertex>& bweights,
+	const std::vector<MeshBinaryFile::Meshlet>& meshlets)
+{
+	const bool hasBoneWeights = !bweights.empty();
+	const unsigned vertCount = positions.size();
 
 	MeshBinaryFile::Header header;
 	memset(&header, 0, sizeof(header));
 
-	// Checks
-	if(mesh.mNumFaces == 0)
-	{
-		ERROR("Incorrect face number");
-	}
-
-	if(mesh.mVertices == 0)
-	{
-		ERROR("Incorrect vertex count number");
-	}
-
-	if(!mesh.HasPositions())
-	{
-		ERROR("Missing positions");
-	}
-
-	if(!mesh.HasNormals())
-	{
-		ERROR("Missing normals");
-	}
-
-	if(!mesh.HasTangentsAndBitangents())
-	{
-		ERROR("Missing tangents");
-	}
-
-	if(!mesh.HasTextureCoords(0))
-	{
-		ERROR("Missing UVs");
-	}
-
-	//
-	// Gather the attributes
-	//
-	struct WeightVertex
-	{
-		uint16_t m_boneIndices[4] = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
-		uint8_t m_weights[4] = {0, 0, 0, 0};
-	};
-	std::vector<WeightVertex> bweights;
-
-	std::vector<float> positions;
-
-	struct NTVertex
-	{
-		float m_n[3];
-		float m_t[4];
-		float m_uv[2];
-	};
-
-	std::vector<NTVertex> ntVerts;
-
-	float maxPositionDistance = 0.0; // Distance of positions from zero
 	float maxUvDistance = -FLT_MAX, minUvDistance = FLT_MAX;
 	Vec3 aabbMin(MAX_F32), aabbMax(MIN_F32);
-
+	for(unsigned i = 0; i < vertCount; ++i)
 	{
-		const aiMatrix3x3 normalMat = (transform) ? aiMatrix3x3(*transform) : aiMatrix3x3();
-
-		const unsigned vertCount = mesh.mNumVertices;
-
-		positions.resize(vertCount * 3);
-		ntVerts.resize(vertCount);
-
-		for(unsigned i = 0; i < vertCount; i++)
-		{
-			aiVector3D pos = mesh.mVertices[i];
-			aiVector3D n = mesh.mNormals[i];
-			aiVector3D t = mesh.mTangents[i];
-			aiVector3D b = mesh.mBitangents[i];
-			const aiVector3D& uv = mesh.mTextureCoords[0][i];
-
-			if(transform)
-			{
-				pos = (*transform) * pos;
-				n = normalMat * n;
-				t = normalMat * t;
-				b = normalMat * b;
-			}
-
-			if(m_flipyz)
-			{
-				static const aiMatrix4x4 toLefthanded(1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 0, 0, 1);
-
-				pos = toLefthanded * pos;
-				n = toLefthanded * n;
-				t = toLefthanded * t;
-				b = toLefthanded * b;
-			}
-
-			positions[i * 3 + 0] = pos.x;
-			positions[i * 3 + 1] = pos.y;
-			positions[i * 3 + 2] = pos.z;
-			for(int d = 0; d < 3; ++d)
-			{
-				maxPositionDistance = std::max<float>(maxPositionDistance, fabs(pos[d]));
-				aabbMin[d] = std::min(aabbMin[d], pos[d]);
-				aabbMax[d] = std::max(aabbMax[d], pos[d]);
-			}
-
-			ntVerts[i].m_n[0] = n.x;
-			ntVerts[i].m_n[1] = n.y;
-			ntVerts[i].m_n[2] = n.z;
-
-			ntVerts[i].m_t[0] = t.x;
-			ntVerts[i].m_t[1] = t.y;
-			ntVerts[i].m_t[2] = t.z;
-			ntVerts[i].m_t[3] = ((n ^ t) * b < 0.0) ? 1.0 : -1.0;
-
-			ntVerts[i].m_uv[0] = uv.x;
-			ntVerts[i].m_uv[1] = uv.y;
-			maxUvDistance = std::max(maxUvDistance, std::max(uv.x, uv.y));
-			minUvDistance = std::min(minUvDistance, std::min(uv.x, uv.y));
-		}
+		aabbMin = aabbMin.min(positions[i]);
+		aabbMax = aabbMax.max(positions[i]);
 
-		if(hasBoneWeights)
-		{
-			bweights.resize(vertCount);
-
-			for(unsigned i = 0; i < mesh.mNumBones; ++i)
-			{
-				const aiBone& bone = *mesh.mBones[i];
-				for(unsigned j = 0; j < bone.mNumWeights; ++j)
-				{
-					const aiVertexWeight& aiWeight = bone.mWeights[j];
-					assert(aiWeight.mVertexId < bweights.size());
-
-					WeightVertex& vert = bweights[aiWeight.mVertexId];
-
-					unsigned idx;
-					if(vert.m_boneIndices[0] == 0xFFFF)
-					{
-						idx = 0;
-					}
-					else if(vert.m_boneIndices[1] == 0xFFFF)
-					{
-						idx = 1;
-					}
-					else if(vert.m_boneIndices[2] == 0xFFFF)
-					{
-						idx = 2;
-					}
-					else if(vert.m_boneIndices[3] == 0xFFFF)
-					{
-						idx = 3;
-					}
-					else
-					{
-						ERROR("Vertex has more than 4 bone weights");
-					}
-
-					vert.m_boneIndices[idx] = i;
-					vert.m_weights[idx] = aiWeight.mWeight * 0xFF;
-				}
-			}
-		}
-
-		// Bump aabbMax a bit
-		aabbMax += EPSILON * 10.0f;
+		const float* uv = ntVerts[i].m_uv;
+		maxUvDistance = std::max(maxUvDistance, std::max(uv[0], uv[1]));
+		minUvDistance = std::min(minUvDistance, std::min(uv[0], uv[1]));
 	}
 
+	// Bump aabbMax a bit
+	aabbMax += EPSILON * 10.0f;
+
 	// Chose the formats of the attributes
 	{
 		// Positions
 		auto& posa = header.m_vertexAttributes[VertexAttributeLocation::POSITION];
 		posa.m_bufferBinding = 0;
-		posa.m_format = (maxPositionDistance < 2.0) ? Format::R16G16B16A16_SFLOAT : Format::R32G32B32_SFLOAT;
+		posa.m_format = MeshOptimizer::choosePositionFormat(aabbMin, aabbMax, positionMaxError);
 		posa.m_relativeOffset = 0;
 		posa.m_scale = 1.0;
 
@@ -267,46 +141,6 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		}
 	}
 
-	// Find if it's a convex shape
-	Bool convex = true;
-	for(unsigned i = 0; i < mesh.mNumFaces && vertCountPerFace == 3; i++)
-	{
-		const aiFace& face = mesh.mFaces[i];
-
-		Vec3 triangle[3];
-
-		for(unsigned j = 0; j < 3; j++)
-		{
-			unsigned idx = face.mIndices[j];
-			triangle[j].x() = positions[idx * 3 + 0];
-			triangle[j].y() = positions[idx * 3 + 1];
-			triangle[j].z() = positions[idx * 3 + 2];
-		}
-
-		// Check that all positions are behind the plane
-		Plane plane(triangle[0].xyz0(), triangle[1].xyz0(), triangle[2].xyz0());
-
-		for(unsigned j = 0; j < positions.size(); j += 3)
-		{
-			Vec3 pos;
-			pos.x() = positions[j + 0];
-			pos.y() = positions[j + 1];
-			pos.z() = positions[j + 2];
-
-			F32 test = testPlane(plane, pos.xyz0());
-			if(test > EPSILON)
-			{
-				convex = false;
-				break;
-			}
-		}
-
-		if(convex == false)
-		{
-			break;
-		}
-	}
-
 	// Write some other header stuff
 	{
 		memcpy(&header.m_magic[0], MeshBinaryFile::MAGIC, 8);
@@ -315,9 +149,13 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		{
 			header.m_flags |= MeshBinaryFile::Flag::CONVEX;
 		}
-		header.m_indexType = IndexType::U16;
-		header.m_totalIndexCount = mesh.mNumFaces * vertCountPerFace;
-		header.m_totalVertexCount = mesh.mNumVertices;
+		if(!meshlets.empty())
+		{
+			header.m_flags |= MeshBinaryFile::Flag::MESHLETS;
+		}
+		header.m_indexType = (vertCount <= 0x10000) ? IndexType::U16 : IndexType::U32;
+		header.m_totalIndexCount = indices.size();
+		header.m_totalVertexCount = vertCount;
 		header.m_subMeshCount = 1;
 		header.m_aabbMin = aabbMin;
 		header.m_aabbMax = aabbMax;
@@ -325,7 +163,7 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 
 	// Open file
 	std::fstream file;
-	file.open(m_outputDirectory + name + ".ankimesh", std::ios::out | std::ios::binary);
+	file.open(filename, std::ios::out | std::ios::binary);
 
 	// Write header
 	file.write(reinterpret_cast<char*>(&header), sizeof(header));
@@ -341,29 +179,23 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		file.write(reinterpret_cast<char*>(&smesh), sizeof(smesh));
 	}
 
-	// Write indices
-	for(unsigned i = 0; i < mesh.mNumFaces; i++)
+	// Write meshlets
+	if(!meshlets.empty())
 	{
-		const aiFace& face = mesh.mFaces[i];
-
-		if(face.mNumIndices != vertCountPerFace)
-		{
-			ERROR("For some reason assimp returned wrong number of verts for a face (face.mNumIndices=%d). Probably"
-				  "degenerates in input file",
-				face.mNumIndices);
-		}
-
-		for(unsigned j = 0; j < vertCountPerFace; j++)
-		{
-			uint32_t index32 = face.mIndices[j];
-			if(index32 > 0xFFFF)
-			{
-				ERROR("Index too big");
-			}
+		const uint32_t meshletCount = meshlets.size();
+		file.write(reinterpret_cast<const char*>(&meshletCount), sizeof(meshletCount));
+		file.write(reinterpret_cast<const char*>(&meshlets[0]), meshlets.size() * sizeof(meshlets[0]));
+	}
 
-			uint16_t index = index32;
-			file.write(reinterpret_cast<char*>(&index), sizeof(index));
-		}
+	// Write indices
+	if(header.m_indexType == IndexType::U16)
+	{
+		std::vector<uint16_t> indices16(indices.begin(), indices.end());
+		file.write(reinterpret_cast<const char*>(&indices16[0]), indices16.size() * sizeof(indices16[0]));
+	}
+	else
+	{
+		file.write(reinterpret_cast<const char*>(&indices[0]), indices.size() * sizeof(indices[0]));
 	}
 
 	// Write first vert buffer
@@ -371,24 +203,21 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		const auto& posa = header.m_vertexAttributes[VertexAttributeLocation::POSITION];
 		if(posa.m_format == Format::R32G32B32_SFLOAT)
 		{
-			file.write(reinterpret_cast<char*>(&positions[0]), positions.size() * sizeof(positions[0]));
+			file.write(reinterpret_cast<const char*>(&positions[0]), positions.size() * sizeof(positions[0]));
 		}
 		else if(posa.m_format == Format::R16G16B16A16_SFLOAT)
 		{
 			std::vector<uint16_t> pos16;
-			pos16.resize(mesh.mNumVertices * 4);
+			pos16.resize(vertCount * 4);
 
-			const float* p32 = &positions[0];
-			const float* p32end = p32 + positions.size();
 			uint16_t* p16 = &pos16[0];
-			while(p32 != p32end)
+			for(const Vec3& p32 : positions)
 			{
-				p16[0] = F16(p32[0]).toU16();
-				p16[1] = F16(p32[1]).toU16();
-				p16[2] = F16(p32[2]).toU16();
+				p16[0] = F16(p32.x()).toU16();
+				p16[1] = F16(p32.y()).toU16();
+				p16[2] = F16(p32.z()).toU16();
 				p16[3] = F16(0.0f).toU16();
 
-				p32 += 3;
 				p16 += 4;
 			}
 
@@ -410,9 +239,9 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		};
 
 		std::vector<Vert> verts;
-		verts.resize(mesh.mNumVertices);
+		verts.resize(vertCount);
 
-		for(unsigned i = 0; i < mesh.mNumVertices; ++i)
+		for(unsigned i = 0; i < vertCount; ++i)
 		{
 			const auto& inVert = ntVerts[i];
 
@@ -444,6 +273,278 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 	// Write 3rd vert buffer
 	if(hasBoneWeights)
 	{
-		file.write(reinterpret_cast<char*>(&bweights[0]), bweights.size() * sizeof(bweights[0]));
+		file.write(reinterpret_cast<const char*>(&bweights[0]), bweights.size() * sizeof(bweights[0]));
+	}
+}
+
+unsigned Exporter::exportMesh(
+	const aiMesh& mesh, const aiMatrix4x4* transform, unsigned vertCountPerFace, unsigned lodCount) const
+{
+	std::string name = mesh.mName.C_Str();
+	LOGI("Exporting mesh %s", name.c_str());
+
+	const bool hasBoneWeights = mesh.mNumBones > 0;
+
+	// Checks
+	if(mesh.mNumFaces == 0)
+	{
+		ERROR("Incorrect face number");
+	}
+
+	if(mesh.mVertices == 0)
+	{
+		ERROR("Incorrect vertex count number");
+	}
+
+	if(!mesh.HasPositions())
+	{
+		ERROR("Missing positions");
+	}
+
+	if(!mesh.HasNormals())
+	{
+		ERROR("Missing normals");
+	}
+
+	if(!mesh.HasTangentsAndBitangents())
+	{
+		ERROR("Missing tangents");
+	}
+
+	if(!mesh.HasTextureCoords(0))
+	{
+		ERROR("Missing UVs");
+	}
+
+	//
+	// Gather the attributes
+	//
+	std::vector<WeightVertex> bweights;
+	std::vector<Vec3> positions;
+	std::vector<NTVertex> ntVerts;
+	Vec3 aabbMin(MAX_F32), aabbMax(MIN_F32);
+
+	{
+		const aiMatrix3x3 normalMat = (transform) ? aiMatrix3x3(*transform) : aiMatrix3x3();
+
+		const unsigned vertCount = mesh.mNumVertices;
+
+		positions.resize(vertCount);
+		ntVerts.resize(vertCount);
+
+		for(unsigned i = 0; i < vertCount; i++)
+		{
+			aiVector3D pos = mesh.mVertices[i];
+			aiVector3D n = mesh.mNormals[i];
+			aiVector3D t = mesh.mTangents[i];
+			aiVector3D b = mesh.mBitangents[i];
+			const aiVector3D& uv = mesh.mTextureCoords[0][i];
+
+			if(transform)
+			{
+				pos = (*transform) * pos;
+				n = normalMat * n;
+				t = normalMat * t;
+				b = normalMat * b;
+			}
+
+			if(m_flipyz)
+			{
+				static const aiMatrix4x4 toLefthanded(1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 0, 0, 1);
+
+				pos = toLefthanded * pos;
+				n = toLefthanded * n;
+				t = toLefthanded * t;
+				b = toLefthanded * b;
+			}
+
+			positions[i] = Vec3(pos.x, pos.y, pos.z);
+			aabbMin = aabbMin.min(positions[i]);
+			aabbMax = aabbMax.max(positions[i]);
+
+			ntVerts[i].m_n[0] = n.x;
+			ntVerts[i].m_n[1] = n.y;
+			ntVerts[i].m_n[2] = n.z;
+
+			ntVerts[i].m_t[0] = t.x;
+			ntVerts[i].m_t[1] = t.y;
+			ntVerts[i].m_t[2] = t.z;
+			ntVerts[i].m_t[3] = ((n ^ t) * b < 0.0) ? 1.0 : -1.0;
+
+			ntVerts[i].m_uv[0] = uv.x;
+			ntVerts[i].m_uv[1] = uv.y;
+		}
+
+		if(hasBoneWeights)
+		{
+			bweights.resize(vertCount);
+
+			for(unsigned i = 0; i < mesh.mNumBones; ++i)
+			{
+				const aiBone& bone = *mesh.mBones[i];
+				for(unsigned j = 0; j < bone.mNumWeights; ++j)
+				{
+					const aiVertexWeight& aiWeight = bone.mWeights[j];
+					assert(aiWeight.mVertexId < bweights.size());
+
+					WeightVertex& vert = bweights[aiWeight.mVertexId];
+
+					unsigned idx;
+					if(vert.m_boneIndices[0] == 0xFFFF)
+					{
+						idx = 0;
+					}
+					else if(vert.m_boneIndices[1] == 0xFFFF)
+					{
+						idx = 1;
+					}
+					else if(vert.m_boneIndices[2] == 0xFFFF)
+					{
+						idx = 2;
+					}
+					else if(vert.m_boneIndices[3] == 0xFFFF)
+					{
+						idx = 3;
+					}
+					else
+					{
+						ERROR("Vertex has more than 4 bone weights");
+					}
+
+					vert.m_boneIndices[idx] = i;
+					vert.m_weights[idx] = aiWeight.mWeight * 0xFF;
+				}
+			}
+		}
+	}
+
+	// Gather the indices
+	std::vector<uint32_t> indices;
+	indices.reserve(mesh.mNumFaces * vertCountPerFace);
+	for(unsigned i = 0; i < mesh.mNumFaces; i++)
+	{
+		const aiFace& face = mesh.mFaces[i];
+
+		if(face.mNumIndices != vertCountPerFace)
+		{
+			ERROR("For some reason assimp returned wrong number of verts for a face (face.mNumIndices=%d). Probably"
+				  "degenerates in input file",
+				face.mNumIndices);
+		}
+
+		for(unsigned j = 0; j < vertCountPerFace; j++)
+		{
+			indices.push_back(face.mIndices[j]);
+		}
 	}
+
+	// Find if it's a convex shape
+	Bool convex = true;
+	for(unsigned i = 0; i < indices.size() && vertCountPerFace == 3; i += 3)
+	{
+		// Check that all positions are behind the plane
+		Plane plane(positions[indices[i]].xyz0(), positions[indices[i + 1]].xyz0(), positions[indices[i + 2]].xyz0());
+
+		for(const Vec3& pos : positions)
+		{
+			F32 test = testPlane(plane, pos.xyz0());
+			if(test > EPSILON)
+			{
+				convex = false;
+				break;
+			}
+		}
+
+		if(convex == false)
+		{
+			break;
+		}
+	}
+
+	// Optimize and write the mesh and its LODs. Every LOD has a copy of the vertices it uses. The quads are patches and
+	// they are written as they are
+	if(vertCountPerFace != 3)
+	{
+		writeMesh(m_outputDirectory + name + ".ankimesh",
+			vertCountPerFace,
+			convex,
+			m_positionMaxError,
+			indices,
+			positions,
+			ntVerts,
+			bweights,
+			std::vector<MeshBinaryFile::Meshlet>());
+		return 1;
+	}
+
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	MeshOptimizer optimizer(alloc);
+	const ConstWeakArray<U32> allIndices(&indices[0], indices.size());
+	const ConstWeakArray<Vec3> allPositions(&positions[0], positions.size());
+	const float meshSize = (aabbMax - aabbMin).getLength();
+	unsigned prevIndexCount = MAX_U32;
+	unsigned lod;
+	for(lod = 0; lod < lodCount; ++lod)
+	{
+		DynamicArrayAuto<U32> lodIndices(alloc);
+		if(lod == 0)
+		{
+			lodIndices.create(indices.size());
+			memcpy(&lodIndices[0], &indices[0], lodIndices.getSizeInBytes());
+		}
+		else
+		{
+			const unsigned targetIndexCount = unsigned(indices.size() * pow(m_lodTriangleRatio, float(lod))) / 3 * 3;
+			optimizer.simplify(allIndices, allPositions, targetIndexCount, m_lodMaxError * meshSize * lod, lodIndices);
+
+			if(lodIndices.getSize() == 0 || lodIndices.getSize() > prevIndexCount * 0.9f)
+			{
+				LOGI("Mesh %s can't be simplified to more than %u LODs", name.c_str(), lod);
+				break;
+			}
+		}
+		prevIndexCount = lodIndices.getSize();
+
+		const MeshOptimizerStats before = MeshOptimizer::computeStats(lodIndices, positions.size(), sizeof(Vec3));
+		DynamicArrayAuto<U32> newToOld(alloc);
+		optimizer.optimize(WeakArray<U32>(lodIndices), allPositions, newToOld);
+		const MeshOptimizerStats after = MeshOptimizer::computeStats(lodIndices, newToOld.getSize(), sizeof(Vec3));
+		LOGI("Mesh %s LOD %u: %u triangles, ACMR %f -> %f, ATVR %f -> %f",
+			name.c_str(),
+			lod,
+			lodIndices.getSize() / 3,
+			before.m_acmr,
+			after.m_acmr,
+			before.m_atvr,
+			after.m_atvr);
+
+		std::vector<Vec3> lodPositions;
+		std::vector<NTVertex> lodNtVerts;
+		std::vector<WeightVertex> lodBweights;
+		for(U32 oldIdx : newToOld)
+		{
+			lodPositions.push_back(positions[oldIdx]);
+			lodNtVerts.push_back(ntVerts[oldIdx]);
+			if(hasBoneWeights)
+			{
+				lodBweights.push_back(bweights[oldIdx]);
+			}
+		}
+
+		DynamicArrayAuto<MeshBinaryFile::Meshlet> meshlets(alloc);
+		optimizer.buildMeshlets(lodIndices, ConstWeakArray<Vec3>(&lodPositions[0], lodPositions.size()), meshlets);
+
+		// Only the first LOD is used by the physics
+		writeMesh(m_outputDirectory + getLodMeshName(name, lod) + ".ankimesh",
+			vertCountPerFace,
+			convex && lod == 0,
+			m_positionMaxError,
+			std::vector<uint32_t>(lodIndices.getBegin(), lodIndices.getEnd()),
+			lodPositions,
+			lodNtVerts,
+			lodBweights,
+			std::vector<MeshBinaryFile::Meshlet>(meshlets.getBegin(), meshlets.getEnd()));
+	}
+
+	return lod;
 }
@@ -4,6 +4,7 @@
 // http://www.anki3d.org/LICENSE
 
 #include "Exporter.h"
+#include <anki/resource/Common.h>
 
 static void parseCommandLineArgs(int argc, char** argv, Exporter& exporter)
 {
@@ -12,6 +13,10 @@ Options:
 -rpath <string>     : Replace all absolute paths of assets with that path
 -texrpath <string>  : Same as rpath but for textures
 -flipyz             : Flip y with z (For blender exports)
+-binary             : Write the nodes to a binary scene.ankiscene. What it can't hold stays in scene.lua
+-lods <number>      : The number of LODs of the meshes that don't have a lod1. Default is 3
+-lod-error <float>  : How far the surface of the LODs can move. It's a fraction of the mesh size. Default is 0.01
+-pos-error <float>  : How far the positions can move when they are quantized. Default is 0.0005
 )";
 
 	bool rpathFound = false;
@@ -66,6 +71,35 @@ Options:
 		{
 			exporter.m_flipyz = true;
 		}
+		else if(strcmp(argv[i], "-binary") == 0)
+		{
+			exporter.m_binaryScene = true;
+		}
+		else if(strcmp(argv[i], "-lods") == 0)
+		{
+			++i;
+			if(i >= argc)
+			{
+				goto error;
+			}
+
+			exporter.m_lodCount = atoi(argv[i]);
+			if(exporter.m_lodCount < 1 || exporter.m_lodCount > anki::MAX_LOD_COUNT)
+			{
+				goto error;
+			}
+		}
+		else if(strcmp(argv[i], "-lod-error") == 0 || strcmp(argv[i], "-pos-error") == 0)
+		{
+			float& value = (strcmp(argv[i], "-lod-error") == 0) ? exporter.m_lodMaxError : exporter.m_positionMaxError;
+			++i;
+			if(i >= argc)
+			{
+				goto error;
+			}
+
+			value = atof(argv[i]);
+		}
 		else
 		{
 			goto error;
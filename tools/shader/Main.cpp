@@ -0,0 +1,215 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/AnKi.h>
+#include <anki/gr/ShaderCompiler.h>
+#include <cstdio>
+
+using namespace anki;
+
+static const char* USAGE = R"(Compile shader variants and pack them to the shader binary archive of the cache directory
+Usage: %s [options] file0 [file1 ...]
+Files:
+*.ankiprog          : Compile all the mutator permutations. Programs with constants need a material
+*.ankimtl           : Compile all the variants of the material
+Options:
+-data <string>      : The data paths. Default is ".:.."
+-pack-only          : Don't compile anything. Only pack what is in the cache directory
+
+The renderer's programs are always compiled. Use generate_program_permutations.py to create the material programs.
+)";
+
+class CmdLineArgs
+{
+public:
+	HeapAllocator<U8> m_alloc;
+	StringAuto m_dataPaths;
+	StringListAuto m_files;
+	Bool m_packOnly = false;
+
+	CmdLineArgs()
+		: m_alloc(allocAligned, nullptr)
+		, m_dataPaths(m_alloc)
+		, m_files(m_alloc)
+	{
+	}
+};
+
+static Error parseCommandLineArgs(int argc, char** argv, CmdLineArgs& info)
+{
+	info.m_dataPaths.create(".:..");
+
+	for(I i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-data") == 0)
+		{
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			info.m_dataPaths.destroy();
+			info.m_dataPaths.create(argv[i]);
+		}
+		else if(strcmp(argv[i], "-pack-only") == 0)
+		{
+			info.m_packOnly = true;
+		}
+		else
+		{
+			info.m_files.pushBack(argv[i]);
+		}
+	}
+
+	return Error::NONE;
+}
+
+/// Compile all the variants of a program that doesn't have constants.
+static Error compileProgram(HeapAllocator<U8> alloc, ResourceManager& resources, CString filename)
+{
+	ShaderProgramResourcePtr prog;
+	ANKI_CHECK(resources.loadResource(filename, prog, false));
+
+	for(const ShaderProgramResourceInputVariable& in : prog->getInputVariables())
+	{
+		if(in.isConstant())
+		{
+			ANKI_LOGW("Skipping %s. It has constants so compile the materials that use it", filename.cstr());
+			return Error::NONE;
+		}
+	}
+
+	const U mutatorCount = prog->getMutators().getSize();
+	DynamicArrayAuto<ShaderProgramResourceMutation> mutations(alloc);
+	DynamicArrayAuto<U32> valueIndices(alloc);
+	if(mutatorCount)
+	{
+		mutations.create(mutatorCount);
+		valueIndices.create(mutatorCount, 0);
+		for(U i = 0; i < mutatorCount; ++i)
+		{
+			mutations[i].m_mutator = &prog->getMutators()[i];
+		}
+	}
+
+	// Go through the permutations like an odometer
+	U variantCount = 0;
+	Bool done = false;
+	while(!done)
+	{
+		for(U i = 0; i < mutatorCount; ++i)
+		{
+			mutations[i].m_value = prog->getMutators()[i].getValues()[valueIndices[i]];
+		}
+
+		const ShaderProgramResourceVariant* variant;
+		prog->getOrCreateVariant(
+			ConstWeakArray<ShaderProgramResourceMutation>((mutatorCount) ? &mutations[0] : nullptr, mutatorCount),
+			variant);
+		++variantCount;
+
+		done = true;
+		for(U i = 0; i < mutatorCount; ++i)
+		{
+			if(++valueIndices[i] < prog->getMutators()[i].getValues().getSize())
+			{
+				done = false;
+				break;
+			}
+			valueIndices[i] = 0;
+		}
+	}
+
+	ANKI_LOGI("Compiled %u variants of %s", variantCount, filename.cstr());
+	return Error::NONE;
+}
+
+static Error work(const CmdLineArgs& info)
+{
+	HeapAllocator<U8> alloc = info.m_alloc;
+
+	// The cache directory is the one of the App
+	StringAuto home(alloc);
+	ANKI_CHECK(getHomeDirectory(alloc, home));
+	StringAuto cacheDir(alloc);
+	cacheDir.sprintf("%s/.anki/cache", home.cstr());
+	StringAuto archiveFname(alloc);
+	archiveFname.sprintf("%s/%s", cacheDir.cstr(), ShaderBinaryArchiveFile::DEFAULT_FILENAME);
+
+	if(!info.m_packOnly)
+	{
+		// Remove the old archive or else the shaders that are in it won't be written to the cache directory. The
+		// shaders that were compiled before are still in the cache directory so it won't take long
+		if(fileExists(archiveFname.toCString()) && std::remove(archiveFname.cstr()) != 0)
+		{
+			ANKI_LOGE("Failed to remove %s", archiveFname.cstr());
+			return Error::FILE_ACCESS;
+		}
+
+		Config config;
+		config.set("window.fullscreen", false);
+		config.set("window.debugContext", 0);
+		config.set("core.clearCaches", false);
+		config.set("rsrc.dataPaths", info.m_dataPaths.toCString());
+
+		// The renderer will compile its programs
+		App* app = new App();
+		Error err = app->init(config, allocAligned, nullptr);
+
+		for(auto it = info.m_files.getBegin(); it != info.m_files.getEnd() && !err; ++it)
+		{
+			StringAuto ext(alloc);
+			getFilepathExtension(it->toCString(), ext);
+
+			if(ext == "ankiprog")
+			{
+				err = compileProgram(alloc, app->getResourceManager(), it->toCString());
+			}
+			else if(ext == "ankimtl")
+			{
+				MaterialResourcePtr mtl;
+				err = app->getResourceManager().loadResource(it->toCString(), mtl, false);
+				if(!err)
+				{
+					mtl->createAllVariants();
+					ANKI_LOGI("Compiled the variants of %s", it->cstr());
+				}
+			}
+			else
+			{
+				ANKI_LOGE("Unknown file type: %s", it->cstr());
+				err = Error::USER_DATA;
+			}
+		}
+
+		delete app;
+		ANKI_CHECK(err);
+	}
+
+	U32 binaryCount;
+	ANKI_CHECK(ShaderBinaryArchive::pack(alloc, cacheDir.toCString(), archiveFname.toCString(), binaryCount));
+	ANKI_LOGI("Packed %u shader binaries to %s", binaryCount, archiveFname.cstr());
+
+	return Error::NONE;
+}
+
+int main(int argc, char** argv)
+{
+	CmdLineArgs info;
+	if(parseCommandLineArgs(argc, argv, info))
+	{
+		ANKI_LOGE(USAGE, argv[0]);
+		return 1;
+	}
+
+	if(work(info))
+	{
+		ANKI_LOGE("Failed");
+		return 1;
+	}
+
+	return 0;
+}
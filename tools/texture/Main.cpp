@@ -0,0 +1,315 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/AnKi.h>
+#include <anki/resource/TextureConverter.h>
+#include <anki/util/ThreadHive.h>
+
+using namespace anki;
+
+static const char* USAGE = R"(Convert TGA images to an AnKi texture
+Usage: %s [options] -o out.ankitex in0.tga [in1.tga ...]
+Options:
+-t <2D|Cube|2DArray> : The texture type. Default is 2D
+-normal              : The image is a normal map
+-linear              : The image is not sRGB
+-to-linear-rgb       : Convert the sRGB image to linear RGB
+-no-alpha            : Remove the alpha channel
+-store-raw           : Store uncompressed data
+-no-s3tc             : Don't store S3TC compressed data
+-mips <number>       : Max number of mips
+-j <number>          : Number of threads. Default is the number of cores
+-force               : Convert even if the output is up to date
+
+ETC2 compressed data can be created with convert_image.py.
+)";
+
+class CmdLineArgs
+{
+public:
+	HeapAllocator<U8> m_alloc;
+	StringListAuto m_inputs;
+	StringAuto m_output;
+	TextureConverterConfig m_config;
+	U32 m_threadCount = 0;
+	Bool m_force = false;
+
+	CmdLineArgs()
+		: m_alloc(allocAligned, nullptr)
+		, m_inputs(m_alloc)
+		, m_output(m_alloc)
+	{
+	}
+};
+
+/// A ResourceFile that reads a file outside of the data paths.
+class ImageFile final : public ResourceFile
+{
+public:
+	File m_file;
+
+	ImageFile(GenericMemoryPoolAllocator<U8> alloc)
+		: ResourceFile(alloc)
+	{
+	}
+
+	ANKI_USE_RESULT Error read(void* buff, PtrSize size) override
+	{
+		return m_file.read(buff, size);
+	}
+
+	ANKI_USE_RESULT Error readAllText(GenericMemoryPoolAllocator<U8> alloc, String& out) override
+	{
+		return m_file.readAllText(alloc, out);
+	}
+
+	ANKI_USE_RESULT Error readU32(U32& u) override
+	{
+		return m_file.readU32(u);
+	}
+
+	ANKI_USE_RESULT Error readF32(F32& f) override
+	{
+		return m_file.readF32(f);
+	}
+
+	ANKI_USE_RESULT Error seek(PtrSize offset, SeekOrigin origin) override
+	{
+		return m_file.seek(offset, origin);
+	}
+
+	PtrSize getSize() const override
+	{
+		return m_file.getSize();
+	}
+};
+
+static Error parseCommandLineArgs(int argc, char** argv, CmdLineArgs& info)
+{
+	TextureConverterConfig& config = info.m_config;
+	Bool s3tc = true;
+	Bool raw = false;
+
+	for(I i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-o") == 0)
+		{
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			info.m_output.destroy();
+			info.m_output.create(argv[i]);
+		}
+		else if(strcmp(argv[i], "-t") == 0)
+		{
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			if(strcmp(argv[i], "2D") == 0)
+			{
+				config.m_type = ImageLoader::TextureType::_2D;
+			}
+			else if(strcmp(argv[i], "Cube") == 0)
+			{
+				config.m_type = ImageLoader::TextureType::CUBE;
+			}
+			else if(strcmp(argv[i], "2DArray") == 0)
+			{
+				config.m_type = ImageLoader::TextureType::_2D_ARRAY;
+			}
+			else
+			{
+				return Error::USER_DATA;
+			}
+		}
+		else if(strcmp(argv[i], "-normal") == 0)
+		{
+			config.m_normal = true;
+			config.m_sRgb = false;
+		}
+		else if(strcmp(argv[i], "-linear") == 0)
+		{
+			config.m_sRgb = false;
+		}
+		else if(strcmp(argv[i], "-to-linear-rgb") == 0)
+		{
+			config.m_toLinearRgb = true;
+		}
+		else if(strcmp(argv[i], "-no-alpha") == 0)
+		{
+			config.m_noAlpha = true;
+		}
+		else if(strcmp(argv[i], "-store-raw") == 0)
+		{
+			raw = true;
+		}
+		else if(strcmp(argv[i], "-no-s3tc") == 0)
+		{
+			s3tc = false;
+		}
+		else if(strcmp(argv[i], "-mips") == 0 || strcmp(argv[i], "-j") == 0)
+		{
+			const Bool mips = strcmp(argv[i], "-mips") == 0;
+			++i;
+			if(i >= argc)
+			{
+				return Error::USER_DATA;
+			}
+
+			U32 number;
+			ANKI_CHECK(CString(argv[i]).toNumber(number));
+			if(mips)
+			{
+				config.m_maxMipCount = number;
+			}
+			else
+			{
+				info.m_threadCount = number;
+			}
+		}
+		else if(strcmp(argv[i], "-force") == 0)
+		{
+			info.m_force = true;
+		}
+		else
+		{
+			info.m_inputs.pushBack(argv[i]);
+		}
+	}
+
+	config.m_compressions = ImageLoader::DataCompression::NONE;
+	if(raw)
+	{
+		config.m_compressions |= ImageLoader::DataCompression::RAW;
+	}
+	if(s3tc)
+	{
+		config.m_compressions |= ImageLoader::DataCompression::S3TC;
+	}
+
+	if(info.m_inputs.isEmpty() || info.m_output.isEmpty() || !config.m_compressions)
+	{
+		return Error::USER_DATA;
+	}
+
+	return Error::NONE;
+}
+
+/// Check if the output was created out of the same images and options.
+static Bool isUpToDate(CString filename, U64 contentHash)
+{
+	if(!fileExists(filename))
+	{
+		return false;
+	}
+
+	File file;
+	AnkiTextureFile::Header header;
+	if(file.open(filename, FileOpenFlag::READ | FileOpenFlag::BINARY) || file.read(&header, sizeof(header)))
+	{
+		return false;
+	}
+
+	return memcmp(&header.m_magic[0], AnkiTextureFile::MAGIC, sizeof(header.m_magic)) == 0
+		&& header.m_contentHash == contentHash;
+}
+
+static Error work(const CmdLineArgs& info)
+{
+	HeapAllocator<U8> alloc = info.m_alloc;
+
+	// Load the images
+	DynamicArrayAuto<ImageLoader*> loaders(alloc);
+	DynamicArrayAuto<TextureConverterImage> images(alloc);
+	Error err = Error::NONE;
+	for(auto it = info.m_inputs.getBegin(); it != info.m_inputs.getEnd() && !err; ++it)
+	{
+		ImageFile* file = alloc.newInstance<ImageFile>(alloc);
+		ResourceFilePtr filePtr(file);
+		err = file->m_file.open(it->toCString(), FileOpenFlag::READ | FileOpenFlag::BINARY);
+
+		ImageLoader* loader = alloc.newInstance<ImageLoader>(alloc);
+		loaders.emplaceBack(loader);
+		if(!err)
+		{
+			err = loader->load(filePtr, it->toCString());
+		}
+
+		if(!err)
+		{
+			TextureConverterImage& image = *images.emplaceBack();
+			const ImageLoader::Surface& surf = loader->getSurface(0, 0, 0);
+			image.m_width = surf.m_width;
+			image.m_height = surf.m_height;
+			image.m_colorFormat = loader->getColorFormat();
+			image.m_data = surf.m_data;
+		}
+	}
+
+	// Convert
+	const U64 contentHash = TextureConverter::computeContentHash(images, info.m_config);
+	if(!err && !info.m_force && isUpToDate(info.m_output.toCString(), contentHash))
+	{
+		ANKI_LOGI("%s is up to date", info.m_output.cstr());
+	}
+	else if(!err)
+	{
+		ThreadHive hive((info.m_threadCount) ? info.m_threadCount : getCpuCoresCount(), alloc);
+		TextureConverter converter(alloc, &hive);
+		DynamicArrayAuto<U8> ankitex(alloc);
+
+		const Second begin = HighRezTimer::getCurrentTime();
+		err = converter.convert(images, info.m_config, ankitex);
+		const Second time = HighRezTimer::getCurrentTime() - begin;
+
+		File file;
+		if(!err)
+		{
+			err = file.open(info.m_output.toCString(), FileOpenFlag::WRITE | FileOpenFlag::BINARY);
+		}
+
+		if(!err)
+		{
+			err = file.write(&ankitex[0], ankitex.getSize());
+		}
+
+		if(!err)
+		{
+			const F64 mpixels = F64(images[0].m_width * images[0].m_height * images.getSize()) / 1000000.0;
+			ANKI_LOGI("Wrote %s in %fms (%f MPixels/s)", info.m_output.cstr(), time * 1000.0, mpixels / time);
+		}
+	}
+
+	for(ImageLoader* loader : loaders)
+	{
+		alloc.deleteInstance(loader);
+	}
+
+	return err;
+}
+
+int main(int argc, char** argv)
+{
+	CmdLineArgs info;
+	if(parseCommandLineArgs(argc, argv, info))
+	{
+		ANKI_LOGE(USAGE, argv[0]);
+		return 1;
+	}
+
+	if(work(info))
+	{
+		ANKI_LOGE("Failed");
+		return 1;
+	}
+
+	return 0;
+}
@@ -629,7 +629,7 @@ def convert(config):
 		data_compression = data_compression | DC_RAW
 
 	buff = struct.pack(ak_format,
-			b"ANKITEX1",
+			b"ANKITEX2",
 			width,
 			height,
 			len(config.in_files),
@@ -650,14 +650,21 @@ def convert(config):
 	for i in range(0, header_padding_size):
 		tex_file.write('\0')
 
+	# Write a placeholder for the mip infos. For each compression and mip the offset in the file and the size
+	mip_count = len(mips_fnames)
+	mip_infos_offset = tex_file.tell()
+	mip_infos = [(0, 0)] * (3 * mip_count)
+	for i in range(0, len(mip_infos)):
+		tex_file.write(struct.pack("QQ", 0, 0))
+
 	# For each compression
 	for compression in range(0, 3):
 
-		tmp_width = width
-		tmp_height = height
-
-		# For each level
-		for i in range(0, len(mips_fnames)):
+		# For each level. Write them coarse to fine so the mip tail can be loaded first
+		for i in reversed(range(0, mip_count)):
+			tmp_width = width >> i
+			tmp_height = height >> i
+			mip_offset = tex_file.tell()
 
 			# For each image
 			for in_file in config.in_files:
@@ -674,8 +681,14 @@ def convert(config):
 				elif compression == 2 and (config.compressed_formats & DC_ETC2):
 					write_etc(tex_file, in_base_fname + "_flip.pkm", tmp_width, tmp_height, color_format)
 
-			tmp_width = tmp_width / 2
-			tmp_height = tmp_height / 2
+			mip_size = tex_file.tell() - mip_offset
+			if mip_size > 0:
+				mip_infos[compression * mip_count + i] = (mip_offset, mip_size)
+
+	# Write the mip infos
+	tex_file.seek(mip_infos_offset)
+	for mip_info in mip_infos:
+		tex_file.write(struct.pack("QQ", mip_info[0], mip_info[1]))
 
 def main():
 	""" The main """
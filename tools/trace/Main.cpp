@@ -0,0 +1,30 @@
+// Copyright (C) 2009-2019, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/util/Tracer.h>
+
+using namespace anki;
+
+static const char* USAGE = R"(Convert a trace stream file to a chrome trace file
+Usage: %s in_file.trace.bin out_file.trace.json
+)";
+
+int main(int argc, char** argv)
+{
+	if(argc != 3)
+	{
+		ANKI_LOGE(USAGE, argv[0]);
+		return 1;
+	}
+
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	if(Tracer::convertStreamToChromeJson(alloc, argv[1], argv[2]))
+	{
+		ANKI_LOGE("Conversion failed");
+		return 1;
+	}
+
+	return 0;
+}